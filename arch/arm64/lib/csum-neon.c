@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * NEON body loop for do_csum()
+ */
+
+#include <linux/types.h>
+#include <asm/neon-intrinsics.h>
+
+u64 do_csum_neon(const u64 *ptr, unsigned long blocks);
+
+/*
+ * Sum @blocks 64 byte blocks as 32-bit words. Since 2^32 == 1 modulo
+ * 0xffff, a plain sum of the halves of each word folds to the same
+ * 16-bit ones' complement result as the scalar 64-bit accumulation, and
+ * the pairwise widening adds cannot overflow for any int sized length.
+ * Must be called inside kernel_neon_begin()/kernel_neon_end().
+ */
+u64 do_csum_neon(const u64 *ptr, unsigned long blocks)
+{
+	const u32 *p = (const u32 *)ptr;
+	uint64x2_t s0 = vdupq_n_u64(0);
+	uint64x2_t s1 = s0, s2 = s0, s3 = s0;
+
+	do {
+		s0 = vpadalq_u32(s0, vld1q_u32(p + 0));
+		s1 = vpadalq_u32(s1, vld1q_u32(p + 4));
+		s2 = vpadalq_u32(s2, vld1q_u32(p + 8));
+		s3 = vpadalq_u32(s3, vld1q_u32(p + 12));
+		p += 16;
+	} while (--blocks);
+
+	s0 = vaddq_u64(vaddq_u64(s0, s1), vaddq_u64(s2, s3));
+
+	return vgetq_lane_u64(s0, 0) + vgetq_lane_u64(s0, 1);
+}
@@ -7,6 +7,14 @@
 
 #include <net/checksum.h>
 
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* Below this, saving the FPSIMD state costs more than the vector loop saves */
+#define CSUM_NEON_MIN_LEN	1024
+
+u64 do_csum_neon(const u64 *ptr, unsigned long blocks);
+
 /* Looks dumb, but generates nice-ish code */
 static u64 accumulate(u64 sum, u64 data)
 {
@@ -59,6 +67,18 @@ unsigned int __no_sanitize_address do_csum(const unsigned char *buff, int len)
 	 * main loop strictly excludes the tail, so the second loop will always
 	 * run at least once.
 	 */
+	if (IS_ENABLED(CONFIG_KERNEL_MODE_NEON) && len > CSUM_NEON_MIN_LEN &&
+	    may_use_simd()) {
+		/* Same tail as the scalar loop below: 1..64 bytes */
+		unsigned long blocks = (len - 1) / 64;
+
+		kernel_neon_begin();
+		sum64 = do_csum_neon(ptr, blocks);
+		kernel_neon_end();
+
+		len -= blocks * 64;
+		ptr += blocks * 8;
+	}
 	while (unlikely(len > 64)) {
 		__uint128_t tmp1, tmp2, tmp3, tmp4;
 
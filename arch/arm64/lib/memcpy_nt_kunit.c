@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * KUnit tests for the arm64 memcpy()/memmove() large copy paths.
+ *
+ * Copies of NT_THRESHOLD bytes or more may take the non-temporal loop in
+ * memcpy.S, which is only correct when source and destination do not
+ * overlap. Check overlapping moves in both directions around that size.
+ */
+
+#include <kunit/test.h>
+#include <linux/sizes.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+/* Keep in sync with NT_THRESHOLD in memcpy.S */
+#define NT_THRESHOLD	SZ_1M
+
+/* Room for the largest copy plus the largest offset */
+#define BUF_SIZE	(NT_THRESHOLD + SZ_64K + SZ_8K)
+
+static u8 pattern(size_t i)
+{
+	return i ^ (i >> 8) ^ (i >> 16);
+}
+
+static void fill(u8 *buf)
+{
+	size_t i;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = pattern(i);
+}
+
+/* memmove() @len bytes from @src to @dst offset within the buffer */
+static void check_move(struct kunit *test, u8 *buf, size_t dst, size_t src,
+		       size_t len)
+{
+	size_t i;
+
+	fill(buf);
+	memmove(buf + dst, buf + src, len);
+
+	for (i = 0; i < len; i++) {
+		if (buf[dst + i] != pattern(src + i)) {
+			KUNIT_FAIL(test,
+				   "len %zu dst %zu src %zu: byte %zu is %#x, expected %#x",
+				   len, dst, src, i, buf[dst + i],
+				   pattern(src + i));
+			return;
+		}
+	}
+}
+
+static const size_t lens[] = {
+	NT_THRESHOLD - 64, NT_THRESHOLD, NT_THRESHOLD + 1,
+	NT_THRESHOLD + 4095,
+};
+
+static const size_t dists[] = { 1, 16, 63, 64, 65, 4096, SZ_64K };
+
+static void memmove_overlap_forward_test(struct kunit *test)
+{
+	unsigned int l, d;
+	u8 *buf;
+
+	buf = vmalloc(BUF_SIZE);
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+
+	/* dst below src: a forward copy must read ahead of its writes */
+	for (l = 0; l < ARRAY_SIZE(lens); l++)
+		for (d = 0; d < ARRAY_SIZE(dists); d++)
+			check_move(test, buf, 3, 3 + dists[d], lens[l]);
+
+	vfree(buf);
+}
+
+static void memmove_overlap_backward_test(struct kunit *test)
+{
+	unsigned int l, d;
+	u8 *buf;
+
+	buf = vmalloc(BUF_SIZE);
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+
+	for (l = 0; l < ARRAY_SIZE(lens); l++)
+		for (d = 0; d < ARRAY_SIZE(dists); d++)
+			check_move(test, buf, 3 + dists[d], 3, lens[l]);
+
+	vfree(buf);
+}
+
+static void memcpy_large_test(struct kunit *test)
+{
+	unsigned int l;
+	u8 *src, *dst;
+	size_t i;
+
+	src = vmalloc(BUF_SIZE);
+	dst = vmalloc(BUF_SIZE);
+	KUNIT_ASSERT_NOT_NULL(test, src);
+	KUNIT_ASSERT_NOT_NULL(test, dst);
+
+	fill(src);
+	for (l = 0; l < ARRAY_SIZE(lens); l++) {
+		memset(dst, 0, BUF_SIZE);
+		memcpy(dst + 5, src + 3, lens[l]);
+		for (i = 0; i < lens[l]; i++)
+			if (dst[5 + i] != src[3 + i])
+				break;
+		KUNIT_EXPECT_EQ_MSG(test, i, lens[l], "len %zu", lens[l]);
+	}
+
+	vfree(dst);
+	vfree(src);
+}
+
+static struct kunit_case memcpy_test_cases[] = {
+	KUNIT_CASE(memcpy_large_test),
+	KUNIT_CASE(memmove_overlap_forward_test),
+	KUNIT_CASE(memmove_overlap_backward_test),
+	{},
+};
+
+static struct kunit_suite memcpy_test_suite = {
+	.name = "arm64_memcpy",
+	.test_cases = memcpy_test_cases,
+};
+
+kunit_test_suites(&memcpy_test_suite);
+
+MODULE_DESCRIPTION("KUnit tests for the arm64 large memcpy()/memmove() paths");
+MODULE_LICENSE("GPL");
@@ -0,0 +1,279 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Deduplication of identical pages stored in zram.
+ *
+ * Every compressed object is indexed by the checksum of its uncompressed
+ * contents. A page whose checksum matches an existing object, and whose
+ * contents really are identical, takes a reference on that object instead
+ * of being compressed and stored again.
+ */
+
+#include <linux/highmem.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/xxhash.h>
+
+#include "zram_drv.h"
+
+/* One hash bucket for this many pages of disk */
+#define ZRAM_HASH_PAGES_SHIFT	4
+
+static struct zram_hash *zram_dedup_bucket(struct zram *zram, u32 checksum)
+{
+	return &zram->hash[checksum & (zram->hash_size - 1)];
+}
+
+u32 zram_dedup_checksum(struct page *page)
+{
+	void *mem;
+	u32 checksum;
+
+	mem = kmap_atomic(page);
+	checksum = xxh32(mem, PAGE_SIZE, 0);
+	kunmap_atomic(mem);
+
+	return checksum;
+}
+
+static bool zram_dedup_match(struct zram *zram, struct zram_dedup_entry *entry,
+			     struct page *page)
+{
+	struct zcomp *comp = zram->comps[ZRAM_PRIMARY_COMP];
+	struct zcomp_strm *zstrm;
+	void *src, *mem;
+	bool match;
+
+	if (entry->len == PAGE_SIZE) {
+		src = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+		mem = kmap_atomic(page);
+		match = !memcmp(mem, src, PAGE_SIZE);
+		kunmap_atomic(mem);
+		zs_unmap_object(zram->mem_pool, entry->handle);
+		return match;
+	}
+
+	zstrm = zcomp_stream_get(comp);
+	src = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	match = !zcomp_decompress(zstrm, src, entry->len, zstrm->buffer);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+	if (match) {
+		mem = kmap_atomic(page);
+		match = !memcmp(mem, zstrm->buffer, PAGE_SIZE);
+		kunmap_atomic(mem);
+	}
+	zcomp_stream_put(comp);
+
+	return match;
+}
+
+/* First object with @checksum in @hash, called with the bucket lock held */
+static struct zram_dedup_entry *zram_dedup_first(struct zram_hash *hash,
+						 u32 checksum)
+{
+	struct zram_dedup_entry *entry;
+	struct rb_node *rb_node, *prev;
+
+	rb_node = hash->rb_root.rb_node;
+	while (rb_node) {
+		entry = rb_entry(rb_node, struct zram_dedup_entry, rb_node);
+		if (checksum == entry->checksum)
+			break;
+		if (checksum < entry->checksum)
+			rb_node = rb_node->rb_left;
+		else
+			rb_node = rb_node->rb_right;
+	}
+
+	if (!rb_node)
+		return NULL;
+
+	/* Objects with colliding checksums sit next to each other */
+	while ((prev = rb_prev(rb_node))) {
+		entry = rb_entry(prev, struct zram_dedup_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+		rb_node = prev;
+	}
+
+	return rb_entry(rb_node, struct zram_dedup_entry, rb_node);
+}
+
+/* Next object with the same checksum as @entry, called with the lock held */
+static struct zram_dedup_entry *zram_dedup_next(struct zram_dedup_entry *entry)
+{
+	struct rb_node *rb_node = rb_next(&entry->rb_node);
+	struct zram_dedup_entry *next;
+
+	if (!rb_node)
+		return NULL;
+
+	next = rb_entry(rb_node, struct zram_dedup_entry, rb_node);
+	if (next->checksum != entry->checksum)
+		return NULL;
+
+	return next;
+}
+
+static void zram_dedup_free(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	zs_free(zram->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+	kfree(entry);
+}
+
+/*
+ * Drop a reference taken only to compare against @entry. Unlike
+ * zram_dedup_put() no slot was ever accounted as sharing the object.
+ */
+static void zram_dedup_unref(struct zram *zram, struct zram_hash *hash,
+			     struct zram_dedup_entry *entry)
+{
+	spin_lock(&hash->lock);
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		return;
+	}
+	rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	zram_dedup_free(zram, entry);
+}
+
+/*
+ * Look for an object holding the same data as @page. On success a reference
+ * is taken on the object for the caller.
+ *
+ * Comparing may decompress the object, so it is done outside the bucket
+ * lock. A reference on each candidate keeps it alive, and on the tree, in
+ * the meantime.
+ */
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram, struct page *page,
+					 u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, checksum);
+	struct zram_dedup_entry *entry, *next;
+	bool shared;
+
+	spin_lock(&hash->lock);
+	entry = zram_dedup_first(hash, checksum);
+	if (entry)
+		entry->refcount++;
+	spin_unlock(&hash->lock);
+
+	while (entry) {
+		if (zram_dedup_match(zram, entry, page)) {
+			spin_lock(&hash->lock);
+			shared = ++entry->slots > 1;
+			spin_unlock(&hash->lock);
+			if (shared)
+				atomic64_add(entry->len,
+					     &zram->stats.dup_data_size);
+			return entry;
+		}
+
+		spin_lock(&hash->lock);
+		next = zram_dedup_next(entry);
+		if (next)
+			next->refcount++;
+		spin_unlock(&hash->lock);
+
+		zram_dedup_unref(zram, hash, entry);
+		entry = next;
+	}
+
+	return NULL;
+}
+
+/*
+ * Make a newly stored object available to later writes. Returns NULL if no
+ * memory is available; the caller then has to fail the write, as slots of a
+ * deduplicating device always point to an entry.
+ */
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+					   unsigned long handle,
+					   unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, checksum);
+	struct zram_dedup_entry *entry, *cur;
+	struct rb_node **rb_node, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->refcount = 1;
+	entry->slots = 1;
+	entry->handle = handle;
+
+	spin_lock(&hash->lock);
+	rb_node = &hash->rb_root.rb_node;
+	while (*rb_node) {
+		parent = *rb_node;
+		cur = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		if (checksum < cur->checksum)
+			rb_node = &parent->rb_left;
+		else
+			rb_node = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, rb_node);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+
+	return entry;
+}
+
+/*
+ * Drop a slot's reference on @entry, freeing the object with the last one.
+ */
+void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_bucket(zram, entry->checksum);
+	bool shared;
+
+	spin_lock(&hash->lock);
+	shared = --entry->slots > 0;
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		if (shared)
+			atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return;
+	}
+	rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	zram_dedup_free(zram, entry);
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	if (!zram->use_dedup)
+		return 0;
+
+	zram->hash_size = rounddown_pow_of_two(max_t(size_t,
+				num_pages >> ZRAM_HASH_PAGES_SHIFT, 1));
+	zram->hash = vzalloc(array_size(zram->hash_size, sizeof(*zram->hash)));
+	if (!zram->hash)
+		return -ENOMEM;
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
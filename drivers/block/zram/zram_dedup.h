@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+
+struct zram;
+struct page;
+
+/*
+ * A compressed object shared by all the slots that store identical pages.
+ * ->refcount counts those slots plus writers comparing against the object,
+ * ->slots only the former. Both are protected by the lock of the hash bucket
+ * the object is on.
+ */
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned int len;
+	unsigned long refcount;
+	unsigned long slots;
+	unsigned long handle;
+};
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(struct page *page);
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram, struct page *page,
+					 u32 checksum);
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+					   unsigned long handle,
+					   unsigned int len, u32 checksum);
+void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry);
+
+int zram_dedup_init(struct zram *zram, size_t num_pages);
+void zram_dedup_fini(struct zram *zram);
+#else
+static inline u32 zram_dedup_checksum(struct page *page) { return 0; }
+static inline struct zram_dedup_entry *
+zram_dedup_find(struct zram *zram, struct page *page, u32 checksum)
+{
+	return NULL;
+}
+static inline struct zram_dedup_entry *
+zram_dedup_insert(struct zram *zram, unsigned long handle, unsigned int len,
+		  u32 checksum)
+{
+	return NULL;
+}
+static inline void zram_dedup_put(struct zram *zram,
+				  struct zram_dedup_entry *entry) {}
+
+static inline int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return 0;
+}
+static inline void zram_dedup_fini(struct zram *zram) {}
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
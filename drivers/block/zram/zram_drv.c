@@ -33,6 +33,7 @@
 #include <linux/debugfs.h>
 #include <linux/cpuhotplug.h>
 #include <linux/part_stat.h>
+#include <linux/sched/mm.h>
 
 #include "zram_drv.h"
 
@@ -50,6 +51,8 @@ static unsigned int num_devices = 1;
  * uncompressed in memory.
  */
 static size_t huge_class_size;
+/* Workers compressing the chunks of large write bios */
+static struct workqueue_struct *zram_write_wq;
 
 static const struct block_device_operations zram_devops;
 
@@ -92,6 +95,26 @@ static void zram_set_handle(struct zram *zram, u32 index, unsigned long handle)
 	zram->table[index].handle = handle;
 }
 
+static struct zram_dedup_entry *zram_get_entry(struct zram *zram, u32 index)
+{
+	return zram->table[index].entry;
+}
+
+static void zram_set_entry(struct zram *zram, u32 index,
+			   struct zram_dedup_entry *entry)
+{
+	zram->table[index].entry = entry;
+}
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+#ifdef CONFIG_ZRAM_DEDUP
+	return zram->hash;
+#else
+	return false;
+#endif
+}
+
 /* flag operations require table entry bit_spin_lock() being held */
 static bool zram_test_flag(struct zram *zram, u32 index,
 			enum zram_pageflags flag)
@@ -962,6 +985,68 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	return len;
 }
 
+static ssize_t parallel_write_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			 READ_ONCE(zram->parallel_write_pages));
+}
+
+static ssize_t parallel_write_pages_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val))
+		return -EINVAL;
+
+	/* A single page can't be split */
+	if (val == 1)
+		return -EINVAL;
+
+	WRITE_ONCE(zram->parallel_write_pages, val);
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+#endif
+
 static void comp_algorithm_set(struct zram *zram, u32 prio, const char *alg)
 {
 	/* Do not free statically defined compression algorithms */
@@ -1155,7 +1240,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -1164,7 +1249,9 @@ static ssize_t mm_stat_show(struct device *dev,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			atomic_long_read(&pool_stats.pages_compacted),
 			(u64)atomic64_read(&zram->stats.huge_pages),
-			(u64)atomic64_read(&zram->stats.huge_pages_since));
+			(u64)atomic64_read(&zram->stats.huge_pages_since),
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1224,6 +1311,7 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
 	vfree(zram->table);
 }
@@ -1243,6 +1331,12 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 		return false;
 	}
 
+	if (zram_dedup_init(zram, num_pages)) {
+		zs_destroy_pool(zram->mem_pool);
+		vfree(zram->table);
+		return false;
+	}
+
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
@@ -1293,6 +1387,13 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
+	/* The object goes away with the last slot sharing it */
+	if (zram_dedup_enabled(zram)) {
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		zram_dedup_put(zram, zram_get_entry(zram, index));
+		goto out;
+	}
+
 	zs_free(zram->mem_pool, handle);
 
 	atomic64_sub(zram_get_obj_size(zram, index),
@@ -1331,6 +1432,9 @@ static int zram_read_from_zspool(struct zram *zram, struct page *page,
 		return 0;
 	}
 
+	if (zram_dedup_enabled(zram))
+		handle = zram_get_entry(zram, index)->handle;
+
 	size = zram_get_obj_size(zram, index);
 
 	if (size != PAGE_SIZE) {
@@ -1419,6 +1523,9 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	struct zcomp_strm *zstrm;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
+	struct zram_dedup_entry *entry = NULL;
+	bool shared = false;
+	u32 checksum = 0;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1430,6 +1537,16 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	}
 	kunmap_atomic(mem);
 
+	if (zram_dedup_enabled(zram)) {
+		checksum = zram_dedup_checksum(page);
+		entry = zram_dedup_find(zram, page, checksum);
+		if (entry) {
+			comp_len = entry->len;
+			shared = true;
+			goto out;
+		}
+	}
+
 compress_again:
 	zstrm = zcomp_stream_get(zram->comps[ZRAM_PRIMARY_COMP]);
 	src = kmap_atomic(page);
@@ -1506,6 +1623,15 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	if (zram_dedup_enabled(zram)) {
+		entry = zram_dedup_insert(zram, handle, comp_len, checksum);
+		if (!entry) {
+			zs_free(zram->mem_pool, handle);
+			atomic64_sub(comp_len, &zram->stats.compr_data_size);
+			return -ENOMEM;
+		}
+	}
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1523,6 +1649,11 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	if (flags) {
 		zram_set_flag(zram, index, flags);
 		zram_set_element(zram, index, element);
+	} else if (entry) {
+		if (shared)
+			zram_set_flag(zram, index, ZRAM_DEDUP);
+		zram_set_entry(zram, index, entry);
+		zram_set_obj_size(zram, index, comp_len);
 	}  else {
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
@@ -1762,6 +1893,12 @@ static ssize_t recompress_store(struct device *dev,
 		goto release_init_lock;
 	}
 
+	/* Deduplicated objects are only ever compared in the primary format */
+	if (zram_dedup_enabled(zram)) {
+		ret = -EOPNOTSUPP;
+		goto release_init_lock;
+	}
+
 	if (algo) {
 		bool found = false;
 
@@ -1899,11 +2036,9 @@ static void zram_bio_read(struct zram *zram, struct bio *bio)
 	bio_endio(bio);
 }
 
-static void zram_bio_write(struct zram *zram, struct bio *bio)
+static int zram_bio_write_iter(struct zram *zram, struct bio *bio,
+			       struct bvec_iter iter)
 {
-	unsigned long start_time = bio_start_io_acct(bio);
-	struct bvec_iter iter = bio->bi_iter;
-
 	do {
 		u32 index = iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
 		u32 offset = (iter.bi_sector & (SECTORS_PER_PAGE - 1)) <<
@@ -1914,8 +2049,7 @@ static void zram_bio_write(struct zram *zram, struct bio *bio)
 
 		if (zram_bvec_write(zram, &bv, index, offset, bio) < 0) {
 			atomic64_inc(&zram->stats.failed_writes);
-			bio->bi_status = BLK_STS_IOERR;
-			break;
+			return -EIO;
 		}
 
 		zram_slot_lock(zram, index);
@@ -1925,6 +2059,89 @@ static void zram_bio_write(struct zram *zram, struct bio *bio)
 		bio_advance_iter_single(bio, &iter, bv.bv_len);
 	} while (iter.bi_size);
 
+	return 0;
+}
+
+static void zram_write_work_fn(struct work_struct *work)
+{
+	struct zram_write_work *zw = container_of(work,
+					struct zram_write_work, work);
+	unsigned int noreclaim_flag;
+
+	/*
+	 * The submitter may be swapping out from reclaim and waits for this
+	 * work, so the work must not recurse into reclaim itself, just as the
+	 * submitter's own allocations can't.
+	 */
+	noreclaim_flag = memalloc_noreclaim_save();
+	zw->error = zram_bio_write_iter(zw->zram, zw->bio, zw->iter);
+	memalloc_noreclaim_restore(noreclaim_flag);
+}
+
+/*
+ * Split a large, page aligned write into one chunk per CPU. The submitter
+ * compresses the first chunk itself while the others run on zram_write_wq,
+ * and the bio is only completed once every chunk is stored. The chunks
+ * cover disjoint slots, so they need no ordering among themselves.
+ *
+ * Returns false if the bio should be handled inline instead.
+ */
+static bool zram_bio_write_parallel(struct zram *zram, struct bio *bio)
+{
+	unsigned int min_pages = READ_ONCE(zram->parallel_write_pages);
+	unsigned int nr_pages = bio->bi_iter.bi_size >> PAGE_SHIFT;
+	struct bvec_iter iter = bio->bi_iter;
+	struct bvec_iter first;
+	unsigned int chunk, nr, i;
+	int ret;
+
+	if (!min_pages || nr_pages < min_pages || !zram->nr_write_works)
+		return false;
+	if ((bio->bi_iter.bi_sector & (SECTORS_PER_PAGE - 1)) ||
+	    !PAGE_ALIGNED(bio->bi_iter.bi_size))
+		return false;
+	if (!mutex_trylock(&zram->write_works_lock))
+		return false;
+
+	nr = min(nr_pages, zram->nr_write_works + 1);
+	chunk = DIV_ROUND_UP(nr_pages, nr) << PAGE_SHIFT;
+
+	first = iter;
+	first.bi_size = chunk;
+	bio_advance_iter(bio, &iter, chunk);
+
+	for (nr = 0; iter.bi_size; nr++) {
+		struct zram_write_work *zw = &zram->write_works[nr];
+
+		zw->bio = bio;
+		zw->iter = iter;
+		zw->iter.bi_size = min(iter.bi_size, chunk);
+		bio_advance_iter(bio, &iter, zw->iter.bi_size);
+		queue_work(zram_write_wq, &zw->work);
+	}
+
+	ret = zram_bio_write_iter(zram, bio, first);
+
+	for (i = 0; i < nr; i++) {
+		flush_work(&zram->write_works[i].work);
+		if (zram->write_works[i].error)
+			ret = zram->write_works[i].error;
+	}
+	mutex_unlock(&zram->write_works_lock);
+
+	if (ret)
+		bio->bi_status = BLK_STS_IOERR;
+	return true;
+}
+
+static void zram_bio_write(struct zram *zram, struct bio *bio)
+{
+	unsigned long start_time = bio_start_io_acct(bio);
+
+	if (!zram_bio_write_parallel(zram, bio) &&
+	    zram_bio_write_iter(zram, bio, bio->bi_iter))
+		bio->bi_status = BLK_STS_IOERR;
+
 	bio_end_io_acct(bio, start_time);
 	bio_endio(bio);
 }
@@ -1985,6 +2202,35 @@ static void zram_destroy_comps(struct zram *zram)
 	}
 }
 
+static int zram_create_write_works(struct zram *zram)
+{
+	unsigned int nr = num_possible_cpus() - 1;
+	unsigned int i;
+
+	if (!nr)
+		return 0;
+
+	zram->write_works = kcalloc(nr, sizeof(*zram->write_works),
+				    GFP_KERNEL);
+	if (!zram->write_works)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		zram->write_works[i].zram = zram;
+		INIT_WORK(&zram->write_works[i].work, zram_write_work_fn);
+	}
+	zram->nr_write_works = nr;
+
+	return 0;
+}
+
+static void zram_destroy_write_works(struct zram *zram)
+{
+	kfree(zram->write_works);
+	zram->write_works = NULL;
+	zram->nr_write_works = 0;
+}
+
 static void zram_reset_device(struct zram *zram)
 {
 	down_write(&zram->init_lock);
@@ -2003,6 +2249,7 @@ static void zram_reset_device(struct zram *zram)
 	zram_meta_free(zram, zram->disksize);
 	zram->disksize = 0;
 	zram_destroy_comps(zram);
+	zram_destroy_write_works(zram);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	reset_bdev(zram);
 
@@ -2051,6 +2298,11 @@ static ssize_t disksize_store(struct device *dev,
 		zram->comps[prio] = comp;
 		zram->num_active_comps++;
 	}
+
+	err = zram_create_write_works(zram);
+	if (err)
+		goto out_free_comps;
+
 	zram->disksize = disksize;
 	set_capacity_and_notify(zram->disk, zram->disksize >> SECTOR_SHIFT);
 	up_write(&zram->init_lock);
@@ -2132,6 +2384,10 @@ static DEVICE_ATTR_WO(mem_limit);
 static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
+static DEVICE_ATTR_RW(parallel_write_pages);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
 static DEVICE_ATTR_RW(comp_algorithm);
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
@@ -2153,6 +2409,10 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_mem_used_max.attr,
 	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
+	&dev_attr_parallel_write_pages.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
 	&dev_attr_comp_algorithm.attr,
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
@@ -2194,6 +2454,7 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	mutex_init(&zram->write_works_lock);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
 #endif
@@ -2395,6 +2656,7 @@ static void destroy_devices(void)
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
 	cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+	destroy_workqueue(zram_write_wq);
 }
 
 static int __init zram_init(void)
@@ -2403,15 +2665,24 @@ static int __init zram_init(void)
 
 	BUILD_BUG_ON(__NR_ZRAM_PAGEFLAGS > BITS_PER_LONG);
 
+	/* Runs on the swap-out path, so must make forward progress */
+	zram_write_wq = alloc_workqueue("zram_write",
+					WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!zram_write_wq)
+		return -ENOMEM;
+
 	ret = cpuhp_setup_state_multi(CPUHP_ZCOMP_PREPARE, "block/zram:prepare",
 				      zcomp_cpu_up_prepare, zcomp_cpu_dead);
-	if (ret < 0)
+	if (ret < 0) {
+		destroy_workqueue(zram_write_wq);
 		return ret;
+	}
 
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		destroy_workqueue(zram_write_wq);
 		return ret;
 	}
 
@@ -2421,6 +2692,7 @@ static int __init zram_init(void)
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		destroy_workqueue(zram_write_wq);
 		return -EBUSY;
 	}
 
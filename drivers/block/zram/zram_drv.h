@@ -16,10 +16,14 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/rwsem.h>
+#include <linux/mutex.h>
+#include <linux/bvec.h>
+#include <linux/workqueue.h>
 #include <linux/zsmalloc.h>
 #include <linux/crypto.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 #define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
 #define SECTORS_PER_PAGE	(1 << SECTORS_PER_PAGE_SHIFT)
@@ -53,6 +57,7 @@ enum zram_pageflags {
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
 	ZRAM_INCOMPRESSIBLE, /* none of the algorithms could compress it */
+	ZRAM_DEDUP,	/* page was stored by sharing an existing object */
 
 	ZRAM_COMP_PRIORITY_BIT1, /* First bit of comp priority index */
 	ZRAM_COMP_PRIORITY_BIT2, /* Second bit of comp priority index */
@@ -67,6 +72,7 @@ struct zram_table_entry {
 	union {
 		unsigned long handle;
 		unsigned long element;
+		struct zram_dedup_entry *entry;
 	};
 	unsigned long flags;
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
@@ -86,6 +92,8 @@ struct zram_stats {
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
 	atomic64_t miss_free;		/* no. of missed free */
+	atomic64_t dup_data_size;	/* compressed size of deduplicated pages */
+	atomic64_t meta_data_size;	/* size of deduplication metadata */
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
@@ -103,6 +111,14 @@ struct zram_stats {
 #define ZRAM_MAX_COMPS	1U
 #endif
 
+struct zram_write_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct bio *bio;
+	struct bvec_iter iter;
+	int error;
+};
+
 struct zram {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
@@ -127,6 +143,15 @@ struct zram {
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by disk->open_mutex */
+	/*
+	 * Writes of at least this many pages are split across the
+	 * write_works; 0 keeps all compression in the submitter's context
+	 */
+	unsigned int parallel_write_pages;
+	struct zram_write_work *write_works;
+	unsigned int nr_write_works;
+	/* Only one bio at a time may use the write_works */
+	struct mutex write_works_lock;
 #ifdef CONFIG_ZRAM_WRITEBACK
 	struct file *backing_dev;
 	spinlock_t wb_limit_lock;
@@ -139,5 +164,10 @@ struct zram {
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 };
 #endif
@@ -151,6 +151,39 @@ int __exit h4_deinit(void)
 	return hci_uart_unregister_proto(&h4p);
 }
 
+/*
+ * Return the length after the type octet of a packet that is entirely within
+ * buf, or 0 if it isn't all there (or is bad, which the caller's normal path
+ * will then report).
+ */
+static int h4_recv_whole_len(const struct h4_recv_pkt *pkt,
+			     const unsigned char *buf, int count)
+{
+	unsigned int dlen;
+
+	if (count < pkt->hlen)
+		return 0;
+
+	switch (pkt->lsize) {
+	case 0:
+		dlen = 0;
+		break;
+	case 1:
+		dlen = buf[pkt->loff];
+		break;
+	case 2:
+		dlen = get_unaligned_le16(buf + pkt->loff);
+		break;
+	default:
+		return 0;
+	}
+
+	if (pkt->hlen + dlen > pkt->maxlen || count < pkt->hlen + dlen)
+		return 0;
+
+	return pkt->hlen + dlen;
+}
+
 struct sk_buff *h4_recv_buf(struct hci_dev *hdev, struct sk_buff *skb,
 			    const unsigned char *buffer, int count,
 			    const struct h4_recv_pkt *pkts, int pkts_count)
@@ -174,23 +207,51 @@ struct sk_buff *h4_recv_buf(struct hci_dev *hdev, struct sk_buff *skb,
 			break;
 
 		if (!skb) {
+			const struct h4_recv_pkt *pkt = NULL;
+
 			for (i = 0; i < pkts_count; i++) {
-				if (buffer[0] != (&pkts[i])->type)
-					continue;
+				if (buffer[0] == (&pkts[i])->type) {
+					pkt = &pkts[i];
+					break;
+				}
+			}
 
-				skb = bt_skb_alloc((&pkts[i])->maxlen,
-						   GFP_ATOMIC);
+			/* Check for invalid packet type */
+			if (!pkt)
+				return ERR_PTR(-EILSEQ);
+
+			/*
+			 * At high baud rates most packets arrive whole, so
+			 * copy those straight into an skb of the right size
+			 * rather than reassembling header and payload.
+			 */
+			len = h4_recv_whole_len(pkt, buffer + 1, count - 1);
+			if (len) {
+				skb = bt_skb_alloc(len, GFP_ATOMIC);
 				if (!skb)
 					return ERR_PTR(-ENOMEM);
 
-				hci_skb_pkt_type(skb) = (&pkts[i])->type;
-				hci_skb_expect(skb) = (&pkts[i])->hlen;
-				break;
+				hci_skb_pkt_type(skb) = pkt->type;
+				hci_skb_expect(skb) = len;
+				skb_put_data(skb, buffer + 1, len);
+
+				count -= 1 + len;
+				buffer += 1 + len;
+
+				hu->padding = (len + 1) % alignment;
+				hu->padding = (alignment - hu->padding) % alignment;
+
+				pkt->recv(hdev, skb);
+				skb = NULL;
+				continue;
 			}
 
-			/* Check for invalid packet type */
+			skb = bt_skb_alloc(pkt->maxlen, GFP_ATOMIC);
 			if (!skb)
-				return ERR_PTR(-EILSEQ);
+				return ERR_PTR(-ENOMEM);
+
+			hci_skb_pkt_type(skb) = pkt->type;
+			hci_skb_expect(skb) = pkt->hlen;
 
 			count -= 1;
 			buffer += 1;
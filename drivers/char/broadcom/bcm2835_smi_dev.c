@@ -44,6 +44,10 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/fs.h>
+#include <linux/completion.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
 
 #include <linux/broadcom/bcm2835_smi.h>
 
@@ -60,15 +64,348 @@ struct bcm2835_smi_dev_instance {
 	struct device *dev;
 };
 
+/* A user buffer queued with BCM2835_SMI_IOC_SUBMIT */
+struct bcm2835_smi_dev_xfer {
+	struct bcm2835_smi_pinned_buf buf;
+	struct completion done;
+	u32 id;
+};
+
+/* Per open file state */
+struct bcm2835_smi_dev_file {
+	struct mutex lock;
+
+	/* Outstanding zero-copy buffers, completed in order */
+	struct bcm2835_smi_dev_xfer xfers[SMI_USER_XFER_MAX_BUFS];
+	unsigned int xfers_head, xfers_count;
+
+	/*
+	 * Continuous capture. A mapping holds a reference to the file, so
+	 * the ring and status page live until release().
+	 */
+	struct bcm2835_smi_stream stream;
+	struct smi_stream_status *stream_status;
+	wait_queue_head_t stream_wait;
+};
+
 static struct bcm2835_smi_instance *smi_inst;
 static struct bcm2835_smi_dev_instance *inst;
 
+/*
+ * SMI runs one transfer at a time. smi_io_lock is held for the whole of a
+ * read() or write(), and while starting a zero-copy transfer, whose owner
+ * is kept in smi_pinned_owner until its last buffer has completed.
+ */
+static DEFINE_MUTEX(smi_io_lock);
+static struct bcm2835_smi_dev_file *smi_pinned_owner;
+
+#define SMI_STREAM_MAX_RING_SIZE (16 * 1024 * 1024)
+
 static const char *const ioctl_names[] = {
 	"READ_SETTINGS",
 	"WRITE_SETTINGS",
-	"ADDRESS"
+	"ADDRESS",
+	"SUBMIT",
+	"COMPLETE",
+	"STREAM_SETUP",
+	"STREAM_START",
+	"STREAM_STOP"
 };
 
+/****************************************************************************
+*
+*   Zero-copy user DMA
+*
+***************************************************************************/
+
+/* DMA completion callback, run from the DMA driver's tasklet */
+static void smi_user_xfer_done(void *param)
+{
+	struct bcm2835_smi_dev_xfer *xfer =
+		container_of(param, struct bcm2835_smi_dev_xfer, buf);
+
+	complete(&xfer->done);
+}
+
+static void smi_pinned_release(void)
+{
+	mutex_lock(&smi_io_lock);
+	smi_pinned_owner = NULL;
+	mutex_unlock(&smi_io_lock);
+}
+
+/* Called with priv->lock held */
+static void smi_user_xfers_flush(struct bcm2835_smi_dev_file *priv)
+{
+	if (!priv->xfers_count)
+		return;
+
+	bcm2835_smi_user_dma_abort(smi_inst);
+	while (priv->xfers_count) {
+		bcm2835_smi_unpin_user_buf(smi_inst,
+					   &priv->xfers[priv->xfers_head].buf);
+		priv->xfers_head++;
+		priv->xfers_count--;
+	}
+	smi_pinned_release();
+}
+
+static long bcm2835_smi_user_submit(struct bcm2835_smi_dev_file *priv,
+				    void __user *arg)
+{
+	struct bcm2835_smi_pinned_buf *bufs[SMI_USER_XFER_MAX_BUFS];
+	enum dma_transfer_direction dma_dir;
+	struct smi_user_xfer req;
+	unsigned int i;
+	long ret;
+
+	if (copy_from_user(&req, arg, sizeof(req)))
+		return -EFAULT;
+	if (!req.num_bufs || req.num_bufs > SMI_USER_XFER_MAX_BUFS)
+		return -EINVAL;
+	dma_dir = req.write ? DMA_MEM_TO_DEV : DMA_DEV_TO_MEM;
+
+	mutex_lock(&priv->lock);
+	mutex_lock(&smi_io_lock);
+
+	/* SMI can only run one programmed transfer at a time */
+	if (smi_pinned_owner || bcm2835_smi_stream_active(smi_inst)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	for (i = 0; i < req.num_bufs; i++) {
+		struct bcm2835_smi_dev_xfer *xfer = &priv->xfers[i];
+
+		ret = bcm2835_smi_pin_user_buf(smi_inst, dma_dir,
+					       u64_to_user_ptr(req.bufs[i].ptr),
+					       req.bufs[i].len, &xfer->buf);
+		if (ret)
+			goto err_unpin;
+		init_completion(&xfer->done);
+		xfer->id = req.bufs[i].id;
+		bufs[i] = &xfer->buf;
+	}
+
+	ret = bcm2835_smi_user_dma_pinned(smi_inst, dma_dir, bufs,
+					  req.num_bufs, smi_user_xfer_done);
+	if (ret)
+		goto err_unpin;
+
+	priv->xfers_head = 0;
+	priv->xfers_count = req.num_bufs;
+	smi_pinned_owner = priv;
+	mutex_unlock(&smi_io_lock);
+	mutex_unlock(&priv->lock);
+	return 0;
+
+err_unpin:
+	while (i--)
+		bcm2835_smi_unpin_user_buf(smi_inst, &priv->xfers[i].buf);
+out:
+	mutex_unlock(&smi_io_lock);
+	mutex_unlock(&priv->lock);
+	return ret;
+}
+
+static long bcm2835_smi_user_complete(struct bcm2835_smi_dev_file *priv,
+				      void __user *arg)
+{
+	struct bcm2835_smi_dev_xfer *xfer;
+	struct smi_user_done done = { 0 };
+	long ret;
+
+	mutex_lock(&priv->lock);
+
+	if (!priv->xfers_count) {
+		mutex_unlock(&priv->lock);
+		return -EINVAL;
+	}
+
+	xfer = &priv->xfers[priv->xfers_head];
+	done.id = xfer->id;
+	ret = wait_for_completion_interruptible_timeout(&xfer->done,
+							msecs_to_jiffies(1000));
+	/*
+	 * The DMA of earlier buffers is finished with their pages once their
+	 * descriptor completes, but the last one must also wait for the bus.
+	 */
+	if (ret > 0 && priv->xfers_count == 1 &&
+	    bcm2835_smi_user_dma_wait_done(smi_inst))
+		ret = 0;
+
+	if (ret == -ERESTARTSYS) {
+		/* Still in flight - let user space try again */
+		mutex_unlock(&priv->lock);
+		return ret;
+	} else if (!ret) {
+		dev_err(inst->dev, "zero-copy DMA timed out");
+		done.status = -ETIMEDOUT;
+		smi_user_xfers_flush(priv);
+	} else {
+		done.len = xfer->buf.len;
+		bcm2835_smi_unpin_user_buf(smi_inst, &xfer->buf);
+		priv->xfers_head++;
+		if (!--priv->xfers_count)
+			smi_pinned_release();
+	}
+
+	mutex_unlock(&priv->lock);
+
+	if (copy_to_user(arg, &done, sizeof(done)))
+		return -EFAULT;
+	return 0;
+}
+
+/****************************************************************************
+*
+*   Continuous ring-buffer streaming
+*
+***************************************************************************/
+
+static void smi_stream_chunk_done(struct bcm2835_smi_stream *stream)
+{
+	struct bcm2835_smi_dev_file *priv =
+		container_of(stream, struct bcm2835_smi_dev_file, stream);
+	struct smi_stream_status *status = priv->stream_status;
+	u32 head = status->head + stream->chunk_size;
+
+	if (head == stream->ring_size)
+		head = 0;
+	/* Cyclic DMA can't be paused, so a full ring just gets overwritten */
+	if (head == READ_ONCE(status->tail))
+		status->overruns++;
+	smp_store_release(&status->head, head);
+
+	wake_up_interruptible(&priv->stream_wait);
+}
+
+/* Called with priv->lock held */
+static void smi_stream_teardown(struct bcm2835_smi_dev_file *priv)
+{
+	bcm2835_smi_stream_stop(smi_inst, &priv->stream);
+	bcm2835_smi_stream_free(smi_inst, &priv->stream);
+	if (priv->stream_status) {
+		free_page((unsigned long)priv->stream_status);
+		priv->stream_status = NULL;
+	}
+}
+
+static long bcm2835_smi_stream_setup(struct bcm2835_smi_dev_file *priv,
+				     void __user *arg)
+{
+	struct smi_stream_config config;
+	long ret;
+
+	if (copy_from_user(&config, arg, sizeof(config)))
+		return -EFAULT;
+	if (config.ring_size > SMI_STREAM_MAX_RING_SIZE)
+		return -EINVAL;
+
+	mutex_lock(&priv->lock);
+
+	/* The ring may be mapped, so it lives until the file is released */
+	if (priv->stream_status) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	priv->stream_status = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!priv->stream_status) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	priv->stream.ring_size = config.ring_size;
+	priv->stream.chunk_size = config.chunk_size;
+	priv->stream.chunk_done = smi_stream_chunk_done;
+	ret = bcm2835_smi_stream_alloc(smi_inst, &priv->stream);
+	if (ret) {
+		smi_stream_teardown(priv);
+		goto out;
+	}
+
+	priv->stream_status->ring_size = config.ring_size;
+	priv->stream_status->chunk_size = config.chunk_size;
+out:
+	mutex_unlock(&priv->lock);
+	return ret;
+}
+
+static long bcm2835_smi_stream_start_user(struct bcm2835_smi_dev_file *priv)
+{
+	long ret;
+
+	mutex_lock(&priv->lock);
+	mutex_lock(&smi_io_lock);
+	if (!priv->stream.ring) {
+		ret = -EINVAL;
+	} else if (smi_pinned_owner) {
+		ret = -EBUSY;
+	} else {
+		priv->stream_status->head = 0;
+		priv->stream_status->tail = 0;
+		priv->stream_status->overruns = 0;
+		ret = bcm2835_smi_stream_start(smi_inst, &priv->stream);
+	}
+	mutex_unlock(&smi_io_lock);
+	mutex_unlock(&priv->lock);
+
+	return ret;
+}
+
+static void bcm2835_smi_stream_stop_user(struct bcm2835_smi_dev_file *priv)
+{
+	mutex_lock(&priv->lock);
+	bcm2835_smi_stream_stop(smi_inst, &priv->stream);
+	mutex_unlock(&priv->lock);
+}
+
+static int bcm2835_smi_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct bcm2835_smi_dev_file *priv = file->private_data;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
+	int ret;
+
+	mutex_lock(&priv->lock);
+
+	if (!priv->stream_status) {
+		ret = -EINVAL;
+	} else if (offset == BCM2835_SMI_STREAM_STATUS_OFFSET) {
+		if (vma->vm_end - vma->vm_start != PAGE_SIZE)
+			ret = -EINVAL;
+		else
+			ret = remap_pfn_range(vma, vma->vm_start,
+				virt_to_phys(priv->stream_status) >> PAGE_SHIFT,
+				PAGE_SIZE, vma->vm_page_prot);
+	} else if (offset == BCM2835_SMI_STREAM_RING_OFFSET) {
+		ret = bcm2835_smi_stream_mmap(smi_inst, &priv->stream, vma);
+	} else {
+		ret = -EINVAL;
+	}
+
+	mutex_unlock(&priv->lock);
+	return ret;
+}
+
+static __poll_t bcm2835_smi_poll(struct file *file, poll_table *wait)
+{
+	struct bcm2835_smi_dev_file *priv = file->private_data;
+	struct smi_stream_status *status;
+
+	poll_wait(file, &priv->stream_wait, wait);
+
+	mutex_lock(&priv->lock);
+	status = priv->stream_status;
+	mutex_unlock(&priv->lock);
+	if (!status)
+		return EPOLLERR;
+
+	if (smp_load_acquire(&status->head) != READ_ONCE(status->tail))
+		return EPOLLIN | EPOLLRDNORM;
+	return 0;
+}
+
 /****************************************************************************
 *
 *   SMI chardev file ops
@@ -77,6 +414,7 @@ static const char *const ioctl_names[] = {
 static long
 bcm2835_smi_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
+	struct bcm2835_smi_dev_file *priv = file->private_data;
 	long ret = 0;
 
 	dev_info(inst->dev, "serving ioctl...");
@@ -108,6 +446,21 @@ bcm2835_smi_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		dev_info(inst->dev, "SMI address set: 0x%02x", (int)arg);
 		bcm2835_smi_set_address(smi_inst, arg);
 		break;
+	case BCM2835_SMI_IOC_SUBMIT:
+		ret = bcm2835_smi_user_submit(priv, (void __user *)arg);
+		break;
+	case BCM2835_SMI_IOC_COMPLETE:
+		ret = bcm2835_smi_user_complete(priv, (void __user *)arg);
+		break;
+	case BCM2835_SMI_IOC_STREAM_SETUP:
+		ret = bcm2835_smi_stream_setup(priv, (void __user *)arg);
+		break;
+	case BCM2835_SMI_IOC_STREAM_START:
+		ret = bcm2835_smi_stream_start_user(priv);
+		break;
+	case BCM2835_SMI_IOC_STREAM_STOP:
+		bcm2835_smi_stream_stop_user(priv);
+		break;
 	default:
 		dev_err(inst->dev, "invalid ioctl cmd: %d", cmd);
 		ret = -ENOTTY;
@@ -119,6 +472,7 @@ bcm2835_smi_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 static int bcm2835_smi_open(struct inode *inode, struct file *file)
 {
+	struct bcm2835_smi_dev_file *priv;
 	int dev = iminor(inode);
 
 	dev_dbg(inst->dev, "SMI device opened.");
@@ -130,11 +484,19 @@ static int bcm2835_smi_open(struct inode *inode, struct file *file)
 		return -ENXIO;
 	}
 
+	priv = kzalloc(sizeof(*priv), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+	mutex_init(&priv->lock);
+	init_waitqueue_head(&priv->stream_wait);
+	file->private_data = priv;
+
 	return 0;
 }
 
 static int bcm2835_smi_release(struct inode *inode, struct file *file)
 {
+	struct bcm2835_smi_dev_file *priv = file->private_data;
 	int dev = iminor(inode);
 
 	if (dev != DEVICE_MINOR) {
@@ -143,6 +505,14 @@ static int bcm2835_smi_release(struct inode *inode, struct file *file)
 		return -ENXIO;
 	}
 
+	/* Don't leave DMA running into pages we are about to unpin */
+	mutex_lock(&priv->lock);
+	smi_user_xfers_flush(priv);
+	smi_stream_teardown(priv);
+	mutex_unlock(&priv->lock);
+
+	kfree(priv);
+
 	return 0;
 }
 
@@ -194,6 +564,11 @@ bcm2835_read_file(struct file *f, char __user *user_ptr,
 	size_t count_check;
 
 	dev_dbg(inst->dev, "User reading %zu bytes from SMI.", count);
+	mutex_lock(&smi_io_lock);
+	if (smi_pinned_owner || bcm2835_smi_stream_active(smi_inst)) {
+		mutex_unlock(&smi_io_lock);
+		return -EBUSY;
+	}
 	/* We don't want to DMA a number of bytes % 4 != 0 (32 bit FIFO) */
 	if (count > DMA_THRESHOLD_BYTES)
 		odd_bytes = count & 0x3;
@@ -222,6 +597,7 @@ bcm2835_read_file(struct file *f, char __user *user_ptr,
 			dev_err(inst->dev, "copy_to_user() failed.");
 		count += odd_bytes - bytes_not_transferred;
 	}
+	mutex_unlock(&smi_io_lock);
 	return count;
 }
 
@@ -233,6 +609,11 @@ bcm2835_write_file(struct file *f, const char __user *user_ptr,
 	size_t count_check;
 
 	dev_dbg(inst->dev, "User writing %zu bytes to SMI.", count);
+	mutex_lock(&smi_io_lock);
+	if (smi_pinned_owner || bcm2835_smi_stream_active(smi_inst)) {
+		mutex_unlock(&smi_io_lock);
+		return -EBUSY;
+	}
 	if (count > DMA_THRESHOLD_BYTES)
 		odd_bytes = count & 0x3;
 	else
@@ -261,6 +642,7 @@ bcm2835_write_file(struct file *f, const char __user *user_ptr,
 			bcm2835_smi_write_buf(smi_inst, buf, odd_bytes);
 		count += odd_bytes - bytes_not_transferred;
 	}
+	mutex_unlock(&smi_io_lock);
 	return count;
 }
 
@@ -272,6 +654,8 @@ bcm2835_smi_fops = {
 	.release = bcm2835_smi_release,
 	.read = bcm2835_read_file,
 	.write = bcm2835_write_file,
+	.mmap = bcm2835_smi_mmap,
+	.poll = bcm2835_smi_poll,
 };
 
 
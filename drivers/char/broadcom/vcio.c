@@ -15,10 +15,14 @@
 #include <linux/init.h>
 #include <linux/ioctl.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/compat.h>
 #include <linux/miscdevice.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <soc/bcm2835/raspberrypi-firmware.h>
 
 #define MODULE_NAME "vcio"
@@ -28,11 +32,37 @@
 #define IOCTL_MBOX_PROPERTY32 _IOWR(VCIO_IOC_MAGIC, 0, compat_uptr_t)
 #endif
 
+/* Property buffers queued per open file, submitted or awaiting read() */
+#define VCIO_MAX_REQUESTS	64
+/* Upper bound on the tags coalesced into one firmware transaction */
+#define VCIO_BATCH_SIZE		PAGE_SIZE
+
 struct vcio_data {
 	struct rpi_firmware *fw;
 	struct miscdevice misc_dev;
 };
 
+/*
+ * A property buffer written to the device, in the same format as the one
+ * passed to IOCTL_MBOX_PROPERTY: size, request code, tags, end tag.
+ */
+struct vcio_request {
+	struct list_head node;
+	u32 size;
+	u32 buf[];
+};
+
+struct vcio_file {
+	struct vcio_data *vcio;
+	/* Protects the lists and count */
+	struct mutex lock;
+	struct list_head pending;
+	struct list_head done;
+	unsigned int count;
+	struct work_struct work;
+	wait_queue_head_t wait;
+};
+
 static int vcio_user_property_list(struct vcio_data *vcio, void *user)
 {
 	u32 *buf, size;
@@ -67,8 +97,221 @@ static int vcio_user_property_list(struct vcio_data *vcio, void *user)
 	return ret;
 }
 
+/*
+ * Submit everything queued so far, packing the tags of as many requests
+ * as fit in VCIO_BATCH_SIZE into a single firmware property transaction.
+ */
+static void vcio_work(struct work_struct *work)
+{
+	struct vcio_file *ctx = container_of(work, struct vcio_file, work);
+	struct vcio_request *req, *tmp;
+	LIST_HEAD(batch);
+	size_t tags, off;
+	u8 *data;
+	u32 status;
+	int ret;
+
+	for (;;) {
+		tags = 0;
+		mutex_lock(&ctx->lock);
+		list_for_each_entry_safe(req, tmp, &ctx->pending, node) {
+			if (!list_empty(&batch) &&
+			    tags + req->size - 12 > VCIO_BATCH_SIZE)
+				break;
+			tags += req->size - 12;
+			list_move_tail(&req->node, &batch);
+		}
+		mutex_unlock(&ctx->lock);
+
+		if (list_empty(&batch))
+			return;
+
+		status = RPI_FIRMWARE_STATUS_SUCCESS;
+		data = tags ? kmalloc(tags, GFP_KERNEL) : NULL;
+		if (tags && !data)
+			status = RPI_FIRMWARE_STATUS_ERROR;
+
+		if (data) {
+			off = 0;
+			list_for_each_entry(req, &batch, node) {
+				memcpy(data + off, &req->buf[2], req->size - 12);
+				off += req->size - 12;
+			}
+
+			ret = rpi_firmware_property_list(ctx->vcio->fw, data,
+							 tags);
+			if (ret)
+				status = RPI_FIRMWARE_STATUS_ERROR;
+		}
+
+		off = 0;
+		list_for_each_entry(req, &batch, node) {
+			if (data)
+				memcpy(&req->buf[2], data + off, req->size - 12);
+			off += req->size - 12;
+			req->buf[1] = status;
+		}
+		kfree(data);
+
+		mutex_lock(&ctx->lock);
+		list_splice_tail_init(&batch, &ctx->done);
+		mutex_unlock(&ctx->lock);
+		wake_up_interruptible(&ctx->wait);
+	}
+}
+
+/*
+ * Queue one or more property buffers, laid out back to back, for
+ * asynchronous submission. Results are returned by read() in order.
+ */
+static ssize_t vcio_device_write(struct file *file, const char __user *ubuf,
+				 size_t len, loff_t *ppos)
+{
+	struct vcio_file *ctx = file->private_data;
+	struct vcio_request *req, *tmp;
+	LIST_HEAD(reqs);
+	unsigned int n = 0;
+	size_t off = 0;
+	u32 size;
+	int ret;
+
+	while (off < len) {
+		ret = -EFAULT;
+		if (len - off < sizeof(size) ||
+		    copy_from_user(&size, ubuf + off, sizeof(size)))
+			goto err;
+
+		ret = -EINVAL;
+		if (size < 12 || size & 3 || size > len - off ||
+		    size - 12 > VCIO_BATCH_SIZE)
+			goto err;
+
+		ret = -ENOMEM;
+		req = kmalloc(struct_size(req, buf, size / 4), GFP_KERNEL);
+		if (!req)
+			goto err;
+		list_add_tail(&req->node, &reqs);
+
+		ret = -EFAULT;
+		if (copy_from_user(req->buf, ubuf + off, size))
+			goto err;
+		req->size = size;
+
+		off += size;
+		n++;
+	}
+
+	/* Could never fit, even with nothing else in flight */
+	ret = -EINVAL;
+	if (n > VCIO_MAX_REQUESTS)
+		goto err;
+
+	mutex_lock(&ctx->lock);
+	while (ctx->count + n > VCIO_MAX_REQUESTS) {
+		mutex_unlock(&ctx->lock);
+
+		ret = -EAGAIN;
+		if (file->f_flags & O_NONBLOCK)
+			goto err;
+
+		ret = wait_event_interruptible(ctx->wait,
+				READ_ONCE(ctx->count) + n <= VCIO_MAX_REQUESTS);
+		if (ret)
+			goto err;
+
+		mutex_lock(&ctx->lock);
+	}
+	ctx->count += n;
+	list_splice_tail(&reqs, &ctx->pending);
+	mutex_unlock(&ctx->lock);
+
+	queue_work(system_unbound_wq, &ctx->work);
+
+	return len;
+
+err:
+	list_for_each_entry_safe(req, tmp, &reqs, node)
+		kfree(req);
+	return ret;
+}
+
+static ssize_t vcio_device_read(struct file *file, char __user *ubuf,
+				size_t len, loff_t *ppos)
+{
+	struct vcio_file *ctx = file->private_data;
+	struct vcio_request *req;
+	ssize_t ret;
+
+	mutex_lock(&ctx->lock);
+	while (list_empty(&ctx->done)) {
+		mutex_unlock(&ctx->lock);
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(ctx->wait,
+					       !list_empty_careful(&ctx->done));
+		if (ret)
+			return ret;
+
+		mutex_lock(&ctx->lock);
+	}
+
+	req = list_first_entry(&ctx->done, struct vcio_request, node);
+	if (len < req->size) {
+		mutex_unlock(&ctx->lock);
+		return -EINVAL;
+	}
+	list_del(&req->node);
+	ctx->count--;
+	mutex_unlock(&ctx->lock);
+
+	/* A slot was freed for writers */
+	wake_up_interruptible(&ctx->wait);
+
+	ret = req->size;
+	if (copy_to_user(ubuf, req->buf, req->size))
+		ret = -EFAULT;
+	kfree(req);
+
+	return ret;
+}
+
+static __poll_t vcio_device_poll(struct file *file, poll_table *wait)
+{
+	struct vcio_file *ctx = file->private_data;
+	__poll_t mask = 0;
+
+	poll_wait(file, &ctx->wait, wait);
+
+	mutex_lock(&ctx->lock);
+	if (!list_empty(&ctx->done))
+		mask |= EPOLLIN | EPOLLRDNORM;
+	if (ctx->count < VCIO_MAX_REQUESTS)
+		mask |= EPOLLOUT | EPOLLWRNORM;
+	mutex_unlock(&ctx->lock);
+
+	return mask;
+}
+
 static int vcio_device_open(struct inode *inode, struct file *file)
 {
+	struct vcio_data *vcio = container_of(file->private_data,
+					      struct vcio_data, misc_dev);
+	struct vcio_file *ctx;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+
+	ctx->vcio = vcio;
+	mutex_init(&ctx->lock);
+	INIT_LIST_HEAD(&ctx->pending);
+	INIT_LIST_HEAD(&ctx->done);
+	INIT_WORK(&ctx->work, vcio_work);
+	init_waitqueue_head(&ctx->wait);
+	file->private_data = ctx;
+
 	try_module_get(THIS_MODULE);
 
 	return 0;
@@ -76,6 +319,17 @@ static int vcio_device_open(struct inode *inode, struct file *file)
 
 static int vcio_device_release(struct inode *inode, struct file *file)
 {
+	struct vcio_file *ctx = file->private_data;
+	struct vcio_request *req, *tmp;
+
+	cancel_work_sync(&ctx->work);
+
+	list_for_each_entry_safe(req, tmp, &ctx->pending, node)
+		kfree(req);
+	list_for_each_entry_safe(req, tmp, &ctx->done, node)
+		kfree(req);
+	kfree(ctx);
+
 	module_put(THIS_MODULE);
 
 	return 0;
@@ -84,8 +338,8 @@ static int vcio_device_release(struct inode *inode, struct file *file)
 static long vcio_device_ioctl(struct file *file, unsigned int ioctl_num,
 			      unsigned long ioctl_param)
 {
-	struct vcio_data *vcio = container_of(file->private_data,
-					      struct vcio_data, misc_dev);
+	struct vcio_file *ctx = file->private_data;
+	struct vcio_data *vcio = ctx->vcio;
 
 	switch (ioctl_num) {
 	case IOCTL_MBOX_PROPERTY:
@@ -100,8 +354,8 @@ static long vcio_device_ioctl(struct file *file, unsigned int ioctl_num,
 static long vcio_device_compat_ioctl(struct file *file, unsigned int ioctl_num,
 				     unsigned long ioctl_param)
 {
-	struct vcio_data *vcio = container_of(file->private_data,
-					      struct vcio_data, misc_dev);
+	struct vcio_file *ctx = file->private_data;
+	struct vcio_data *vcio = ctx->vcio;
 
 	switch (ioctl_num) {
 	case IOCTL_MBOX_PROPERTY32:
@@ -118,6 +372,9 @@ const struct file_operations vcio_fops = {
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = vcio_device_compat_ioctl,
 #endif
+	.read = vcio_device_read,
+	.write = vcio_device_write,
+	.poll = vcio_device_poll,
 	.open = vcio_device_open,
 	.release = vcio_device_release,
 };
@@ -70,25 +70,31 @@ static int bcm2835_rng_read(struct hwrng *rng, void *buf, size_t max,
 	u32 retries = 1000000/(RNG_FIFO_WORDS * RNG_US_PER_WORD);
 	struct bcm2835_rng_priv *priv = to_rng_priv(rng);
 	u32 max_words = max / sizeof(u32);
-	u32 num_words, count;
+	u32 num_words, count = 0, wanted;
 
-	num_words = rng_readl(priv, RNG_STATUS) >> 24;
-
-	while (!num_words) {
-		if (!wait || !retries)
-			return 0;
-		retries--;
-		usleep_range((u32)RNG_US_PER_WORD,
-			     (u32)RNG_US_PER_WORD * RNG_FIFO_WORDS);
+	/*
+	 * Drain whatever the FIFO holds, and when the caller is prepared to
+	 * wait keep refilling @buf, sleeping for roughly as long as the
+	 * generator needs to produce the missing words (at most a FIFO's
+	 * worth) instead of polling one word at a time.
+	 */
+	while (count < max_words) {
 		num_words = rng_readl(priv, RNG_STATUS) >> 24;
-	}
+		num_words = min(num_words, max_words - count);
 
-	num_words = min(num_words, max_words);
+		while (num_words--)
+			((u32 *)buf)[count++] = rng_readl(priv, RNG_DATA);
 
-	for (count = 0; count < num_words; count++)
-		((u32 *)buf)[count] = rng_readl(priv, RNG_DATA);
+		if (count == max_words || !wait || !retries)
+			break;
+		retries--;
+
+		wanted = min_t(u32, max_words - count, RNG_FIFO_WORDS);
+		usleep_range(wanted * RNG_US_PER_WORD,
+			     (wanted + 1) * RNG_US_PER_WORD);
+	}
 
-	return num_words * sizeof(u32);
+	return count * sizeof(u32);
 }
 
 static int bcm2835_rng_init(struct hwrng *rng)
@@ -13,6 +13,7 @@
 #include <linux/clkdev.h>
 #include <linux/clk-provider.h>
 #include <linux/io.h>
+#include <linux/jiffies.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 
@@ -40,6 +41,14 @@ static char *rpi_firmware_clk_names[] = {
 #define RPI_FIRMWARE_STATE_ENABLE_BIT	BIT(0)
 #define RPI_FIRMWARE_STATE_WAIT_BIT	BIT(1)
 
+/*
+ * How long a rate read back from (or acknowledged by) the firmware is
+ * trusted. The firmware may lower clocks on its own when throttling, so
+ * the cache only absorbs bursts of queries such as the recalc that
+ * follows every set_rate and back to back cpufreq reads.
+ */
+#define RPI_FIRMWARE_RATE_CACHE_MS	10
+
 struct raspberrypi_clk_variant;
 
 struct raspberrypi_clk {
@@ -55,10 +64,14 @@ struct raspberrypi_clk_data {
 	struct raspberrypi_clk_variant *variant;
 
 	struct raspberrypi_clk *rpi;
+
+	/* Protected by the clk framework prepare lock */
+	unsigned long cached_rate;
+	unsigned long cached_until;
 };
 
 static inline
-const struct raspberrypi_clk_data *clk_hw_to_data(const struct clk_hw *hw)
+struct raspberrypi_clk_data *clk_hw_to_data(struct clk_hw *hw)
 {
 	return container_of(hw, struct raspberrypi_clk_data, hw);
 }
@@ -188,7 +201,7 @@ static int raspberrypi_clock_property(struct rpi_firmware *firmware,
 
 static int raspberrypi_fw_is_prepared(struct clk_hw *hw)
 {
-	const struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
+	struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
 	struct raspberrypi_clk *rpi = data->rpi;
 	u32 val = 0;
 	int ret;
@@ -202,43 +215,67 @@ static int raspberrypi_fw_is_prepared(struct clk_hw *hw)
 }
 
 
+static void raspberrypi_fw_cache_rate(struct raspberrypi_clk_data *data,
+				      unsigned long rate)
+{
+	data->cached_rate = rate;
+	data->cached_until = jiffies +
+			     msecs_to_jiffies(RPI_FIRMWARE_RATE_CACHE_MS);
+}
+
 static unsigned long raspberrypi_fw_get_rate(struct clk_hw *hw,
 					     unsigned long parent_rate)
 {
-	const struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
+	struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
 	struct raspberrypi_clk *rpi = data->rpi;
 	u32 val = 0;
 	int ret;
 
+	if (data->cached_rate && time_before(jiffies, data->cached_until))
+		return data->cached_rate;
+
 	ret = raspberrypi_clock_property(rpi->firmware, data,
 					 RPI_FIRMWARE_GET_CLOCK_RATE, &val);
 	if (ret)
 		return 0;
 
+	raspberrypi_fw_cache_rate(data, val);
+
 	return val;
 }
 
 static int raspberrypi_fw_set_rate(struct clk_hw *hw, unsigned long rate,
 				   unsigned long parent_rate)
 {
-	const struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
+	struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
 	struct raspberrypi_clk *rpi = data->rpi;
 	u32 _rate = rate;
 	int ret;
 
+	data->cached_rate = 0;
+
 	ret = raspberrypi_clock_property(rpi->firmware, data,
 					 RPI_FIRMWARE_SET_CLOCK_RATE, &_rate);
-	if (ret)
+	if (ret) {
 		dev_err_ratelimited(rpi->dev, "Failed to change %s frequency: %d\n",
 				    clk_hw_get_name(hw), ret);
+		return ret;
+	}
 
-	return ret;
+	/*
+	 * The firmware answers with the rate it actually programmed, use it
+	 * for the recalc the clk core does right after set_rate instead of
+	 * asking again.
+	 */
+	raspberrypi_fw_cache_rate(data, _rate);
+
+	return 0;
 }
 
 static int raspberrypi_fw_dumb_determine_rate(struct clk_hw *hw,
 					      struct clk_rate_request *req)
 {
-	const struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
+	struct raspberrypi_clk_data *data = clk_hw_to_data(hw);
 	struct raspberrypi_clk_variant *variant = data->variant;
 
 	/*
@@ -246,6 +246,8 @@
 #define KHz				1000
 #define MHz				(KHz * KHz)
 #define LOCK_TIMEOUT_NS			100000000
+/* Largest VCO change a running PLL is retuned by in place */
+#define RETUNE_MAX_PPM			1000
 #define FC_TIMEOUT_NS			100000000
 
 #define MAX_CLK_PARENTS	16
@@ -321,6 +323,7 @@ struct rp1_pll_core_data {
 	u32 fbdiv_frac_reg;
 	unsigned long flags;
 	u32 fc0_src;
+	bool retune;
 };
 
 struct rp1_pll_data {
@@ -589,6 +592,63 @@ static inline unsigned long get_pll_core_divider(struct clk_hw *hw,
 	return calc_rate;
 }
 
+/*
+ * Trim a running PLL without stopping it. With the delta-sigma modulator
+ * already running the loop follows a new fractional divider, so every
+ * output glides to its new rate instead of being cut off and restarted.
+ *
+ * This is only done for PLLs that opt in, and only for changes of up to
+ * RETUNE_MAX_PPM that keep the integer divider. The integer and fractional
+ * halves live in separate registers, so the fraction is the only part
+ * that can change in a single write. Returns false if the change has to
+ * go through a full reprogram instead, including when the PLL fails to
+ * relock.
+ */
+static bool rp1_pll_core_retune(struct clk_hw *hw, u32 fbdiv_int,
+				u32 fbdiv_frac)
+{
+	struct rp1_pll_core *pll_core = container_of(hw, struct rp1_pll_core, hw);
+	struct rp1_clockman *clockman = pll_core->clockman;
+	const struct rp1_pll_core_data *data = pll_core->data;
+	u64 cur_div, new_div, delta;
+	ktime_t timeout;
+
+	if (!data->retune || !fbdiv_frac)
+		return false;
+
+	spin_lock(&clockman->regs_lock);
+	if (!(clockman_read(clockman, data->cs_reg) & PLL_CS_LOCK) ||
+	    clockman_read(clockman, data->pwr_reg) != 0 ||
+	    clockman_read(clockman, data->fbdiv_int_reg) != fbdiv_int) {
+		spin_unlock(&clockman->regs_lock);
+		return false;
+	}
+
+	cur_div = ((u64)fbdiv_int << 24) +
+		  clockman_read(clockman, data->fbdiv_frac_reg);
+	new_div = ((u64)fbdiv_int << 24) + fbdiv_frac;
+	delta = cur_div > new_div ? cur_div - new_div : new_div - cur_div;
+	if (delta * 1000000 > cur_div * RETUNE_MAX_PPM) {
+		spin_unlock(&clockman->regs_lock);
+		return false;
+	}
+
+	clockman_write(clockman, data->fbdiv_frac_reg, fbdiv_frac);
+	spin_unlock(&clockman->regs_lock);
+
+	timeout = ktime_add_ns(ktime_get(), LOCK_TIMEOUT_NS);
+	while (!(clockman_read(clockman, data->cs_reg) & PLL_CS_LOCK)) {
+		if (ktime_after(ktime_get(), timeout)) {
+			dev_warn(clockman->dev, "%s: lost lock, reprogramming\n",
+				 clk_hw_get_name(hw));
+			return false;
+		}
+		cpu_relax();
+	}
+
+	return true;
+}
+
 static int rp1_pll_core_set_rate(struct clk_hw *hw,
 				 unsigned long rate, unsigned long parent_rate)
 {
@@ -598,6 +658,14 @@ static int rp1_pll_core_set_rate(struct clk_hw *hw,
 	unsigned long calc_rate;
 	u32 fbdiv_int, fbdiv_frac;
 
+	calc_rate = get_pll_core_divider(hw, rate, parent_rate,
+					 &fbdiv_int, &fbdiv_frac);
+
+	if (rp1_pll_core_retune(hw, fbdiv_int, fbdiv_frac)) {
+		pll_core->cached_rate = calc_rate;
+		return 0;
+	}
+
 	// todo: is this needed??
 	//rp1_pll_off(hw);
 
@@ -607,9 +675,6 @@ static int rp1_pll_core_set_rate(struct clk_hw *hw,
 	clockman_write(clockman, data->fbdiv_frac_reg, 0);
 	spin_unlock(&clockman->regs_lock);
 
-	calc_rate = get_pll_core_divider(hw, rate, parent_rate,
-					 &fbdiv_int, &fbdiv_frac);
-
 	spin_lock(&clockman->regs_lock);
 	clockman_write(clockman, data->pwr_reg, fbdiv_frac ? 0 : PLL_PWR_DSMPD);
 	clockman_write(clockman, data->fbdiv_int_reg, fbdiv_int);
@@ -1219,10 +1284,35 @@ static unsigned long calc_core_pll_rate(struct clk_hw *pll_hw,
 	unsigned long best_rate = core_max + 1;
 	int best_div_prim = 1, best_div_clk = 1;
 	unsigned long core_rate = 0;
+	struct clk_hw *core = clk_hw_get_parent(pll_hw);
 	int div_int, div_frac;
 	u64 div;
 	int i;
 
+	/*
+	 * If the PLL is already running I2S, keep both dividers and move
+	 * only the VCO when that can reach the new rate. Small clk_set_rate()
+	 * trims, as used to rate-match against another clock, then retune
+	 * the feedback divider in place and the stream keeps running. Larger
+	 * steps such as 44.1k/48k family changes still reprogram the PLL.
+	 */
+	if (core && clk_hw_is_prepared(core) &&
+	    clk_hw_get_parent(clk_i2s) == pll_hw &&
+	    clk_hw_get_rate(pll_hw) && clk_hw_get_rate(clk_i2s)) {
+		int div_prim = DIV_NEAREST(clk_hw_get_rate(core),
+					   clk_hw_get_rate(pll_hw));
+		int div_clk = DIV_NEAREST(clk_hw_get_rate(pll_hw),
+					  clk_hw_get_rate(clk_i2s));
+
+		core_rate = target_rate * div_clk * div_prim;
+		if (core_rate >= core_min && core_rate < core_max) {
+			best_rate = core_rate;
+			best_div_prim = div_prim;
+			best_div_clk = div_clk;
+			goto found;
+		}
+	}
+
 	/* Given the target rate, choose a set of divisors/multipliers */
 	for (i = 0; i < ARRAY_SIZE(prim_divs); i++) {
 		int div_prim = prim_divs[i];
@@ -1241,6 +1331,7 @@ static unsigned long calc_core_pll_rate(struct clk_hw *pll_hw,
 		}
 	}
 
+found:
 	if (best_rate < core_max) {
 		div = ((best_rate << 24) + xosc_rate / 2) / xosc_rate;
 		div_int = div >> 24;
@@ -1691,6 +1782,7 @@ static const struct rp1_clk_desc clk_desc_array[] = {
 				.pwr_reg = PLL_AUDIO_PWR,
 				.fbdiv_int_reg = PLL_AUDIO_FBDIV_INT,
 				.fbdiv_frac_reg = PLL_AUDIO_FBDIV_FRAC,
+				.retune = true,
 				),
 
 	[RP1_PLL_VIDEO_CORE] = REGISTER_PLL_CORE(
@@ -440,6 +440,7 @@ void cpufreq_freq_transition_begin(struct cpufreq_policy *policy,
 
 	spin_unlock(&policy->transition_lock);
 
+	cpufreq_stats_record_begin(policy);
 	cpufreq_notify_transition(policy, freqs, CPUFREQ_PRECHANGE);
 }
 EXPORT_SYMBOL_GPL(cpufreq_freq_transition_begin);
@@ -450,6 +451,7 @@ void cpufreq_freq_transition_end(struct cpufreq_policy *policy,
 	if (WARN_ON(!policy->transition_ongoing))
 		return;
 
+	cpufreq_stats_record_end(policy);
 	cpufreq_notify_post_transition(policy, freqs, transition_failed);
 
 	arch_set_freq_scale(policy->related_cpus,
@@ -2167,7 +2169,9 @@ unsigned int cpufreq_driver_fast_switch(struct cpufreq_policy *policy,
 	int cpu;
 
 	target_freq = clamp_val(target_freq, policy->min, policy->max);
+	cpufreq_stats_record_begin(policy);
 	freq = cpufreq_driver->fast_switch(policy, target_freq);
+	cpufreq_stats_record_end(policy);
 
 	if (!freq)
 		return 0;
@@ -2336,6 +2340,8 @@ int __cpufreq_driver_target(struct cpufreq_policy *policy,
 	    !(cpufreq_driver->flags & CPUFREQ_NEED_UPDATE_LIMITS))
 		return 0;
 
+	cpufreq_stats_record_request(policy);
+
 	if (cpufreq_driver->target) {
 		/*
 		 * If the driver hasn't setup a single inefficient frequency,
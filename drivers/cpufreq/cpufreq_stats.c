@@ -8,9 +8,14 @@
 
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
+#include <linux/log2_hist.h>
 #include <linux/module.h>
 #include <linux/sched/clock.h>
 #include <linux/slab.h>
+#include <linux/timekeeping.h>
+
+/* log2(usecs) buckets, the last one collects everything from 2^14us up */
+#define CPUFREQ_STATS_HIST_BUCKETS	16
 
 struct cpufreq_stats {
 	unsigned int total_trans;
@@ -22,6 +27,13 @@ struct cpufreq_stats {
 	unsigned int *freq_table;
 	unsigned int *trans_table;
 
+	/* Frequency change timing, see cpufreq_stats_record_begin/end() */
+	unsigned long long request_time;
+	unsigned long long begin_time;
+	unsigned int wait_hist[CPUFREQ_STATS_HIST_BUCKETS];
+	unsigned int latency_hist[CPUFREQ_STATS_HIST_BUCKETS];
+	unsigned long long max_latency;
+
 	/* Deferred reset */
 	unsigned int reset_pending;
 	unsigned long long reset_time;
@@ -42,6 +54,9 @@ static void cpufreq_stats_reset_table(struct cpufreq_stats *stats)
 
 	memset(stats->time_in_state, 0, count * sizeof(u64));
 	memset(stats->trans_table, 0, count * count * sizeof(int));
+	memset(stats->wait_hist, 0, sizeof(stats->wait_hist));
+	memset(stats->latency_hist, 0, sizeof(stats->latency_hist));
+	stats->max_latency = 0;
 	stats->last_time = local_clock();
 	stats->total_trans = 0;
 
@@ -170,11 +185,57 @@ static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 }
 cpufreq_freq_attr_ro(trans_table);
 
+static ssize_t show_hist(struct cpufreq_stats *stats, unsigned int *hist,
+			 char *buf)
+{
+	bool pending = READ_ONCE(stats->reset_pending);
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < CPUFREQ_STATS_HIST_BUCKETS; i++)
+		len += sysfs_emit_at(buf, len, "%s%u %u\n",
+				     i == CPUFREQ_STATS_HIST_BUCKETS - 1 ? ">=" : "<",
+				     i == CPUFREQ_STATS_HIST_BUCKETS - 1 ?
+				     1U << (i - 1) : 1U << i,
+				     pending ? 0 : hist[i]);
+
+	return len;
+}
+
+static ssize_t show_transition_latency(struct cpufreq_policy *policy,
+				       char *buf)
+{
+	return show_hist(policy->stats, policy->stats->latency_hist, buf);
+}
+cpufreq_freq_attr_ro(transition_latency);
+
+static ssize_t show_request_wait(struct cpufreq_policy *policy, char *buf)
+{
+	return show_hist(policy->stats, policy->stats->wait_hist, buf);
+}
+cpufreq_freq_attr_ro(request_wait);
+
+static ssize_t show_max_transition_latency(struct cpufreq_policy *policy,
+					   char *buf)
+{
+	struct cpufreq_stats *stats = policy->stats;
+
+	if (READ_ONCE(stats->reset_pending))
+		return sprintf(buf, "%d\n", 0);
+	else
+		return sprintf(buf, "%llu\n",
+			       div_u64(stats->max_latency, NSEC_PER_USEC));
+}
+cpufreq_freq_attr_ro(max_transition_latency);
+
 static struct attribute *default_attrs[] = {
 	&total_trans.attr,
 	&time_in_state.attr,
 	&reset.attr,
 	&trans_table.attr,
+	&transition_latency.attr,
+	&request_wait.attr,
+	&max_transition_latency.attr,
 	NULL
 };
 static const struct attribute_group stats_attr_group = {
@@ -287,3 +348,55 @@ void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 	stats->trans_table[old_index * stats->max_state + new_index]++;
 	stats->total_trans++;
 }
+
+static void cpufreq_stats_hist_add(unsigned int *hist, unsigned long long ns)
+{
+	hist[log2_hist_bucket(div_u64(ns, NSEC_PER_USEC), 0,
+			      CPUFREQ_STATS_HIST_BUCKETS)]++;
+}
+
+/*
+ * A governor asked for a new frequency. The time until the transition
+ * actually starts, including waiting for one still in flight, is accounted
+ * as request wait by cpufreq_stats_record_begin().
+ */
+void cpufreq_stats_record_request(struct cpufreq_policy *policy)
+{
+	struct cpufreq_stats *stats = policy->stats;
+
+	if (stats)
+		stats->request_time = ktime_get_ns();
+}
+
+void cpufreq_stats_record_begin(struct cpufreq_policy *policy)
+{
+	struct cpufreq_stats *stats = policy->stats;
+	unsigned long long now;
+
+	if (unlikely(!stats))
+		return;
+
+	now = ktime_get_ns();
+	if (stats->request_time) {
+		cpufreq_stats_hist_add(stats->wait_hist,
+				       now - stats->request_time);
+		stats->request_time = 0;
+	}
+	stats->begin_time = now;
+}
+
+void cpufreq_stats_record_end(struct cpufreq_policy *policy)
+{
+	struct cpufreq_stats *stats = policy->stats;
+	unsigned long long latency;
+
+	if (unlikely(!stats || !stats->begin_time))
+		return;
+
+	latency = ktime_get_ns() - stats->begin_time;
+	stats->begin_time = 0;
+
+	cpufreq_stats_hist_add(stats->latency_hist, latency);
+	if (latency > stats->max_latency)
+		stats->max_latency = latency;
+}
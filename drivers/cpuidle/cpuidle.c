@@ -21,6 +21,7 @@
 #include <linux/cpuidle.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
+#include <linux/log2_hist.h>
 #include <linux/module.h>
 #include <linux/suspend.h>
 #include <linux/tick.h>
@@ -202,6 +203,45 @@ int cpuidle_enter_s2idle(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 }
 #endif /* CONFIG_SUSPEND */
 
+#ifdef CONFIG_CPU_IDLE_EXIT_LATENCY_STATS
+/*
+ * If the CPU stayed idle at least until its next timer was due, that timer
+ * is what woke it up: account how much later than the expiry it came back.
+ */
+static void cpuidle_account_exit_latency(struct cpuidle_state_usage *usage,
+					 s64 residency_ns, s64 expected_ns)
+{
+	s64 late_ns = residency_ns - expected_ns;
+	unsigned int bucket;
+
+	if (expected_ns <= 0 || late_ns < 0)
+		return;
+
+	bucket = log2_hist_bucket(div_u64(late_ns, NSEC_PER_USEC), 0,
+				  CPUIDLE_EXIT_HIST_BUCKETS);
+	usage->exit_hist[bucket]++;
+	if (late_ns > usage->exit_max_ns)
+		usage->exit_max_ns = late_ns;
+}
+
+static s64 cpuidle_expected_residency(struct cpuidle_device *dev)
+{
+	ktime_t next = READ_ONCE(dev->next_hrtimer);
+
+	return next ? ktime_to_ns(ktime_sub(next, ktime_get())) : 0;
+}
+#else
+static inline void cpuidle_account_exit_latency(struct cpuidle_state_usage *usage,
+						s64 residency_ns, s64 expected_ns)
+{
+}
+
+static inline s64 cpuidle_expected_residency(struct cpuidle_device *dev)
+{
+	return 0;
+}
+#endif
+
 /**
  * cpuidle_enter_state - enter the state and update stats
  * @dev: cpuidle device for this cpu
@@ -217,6 +257,7 @@ noinstr int cpuidle_enter_state(struct cpuidle_device *dev,
 	struct cpuidle_state *target_state = &drv->states[index];
 	bool broadcast = !!(target_state->flags & CPUIDLE_FLAG_TIMER_STOP);
 	ktime_t time_start, time_end;
+	s64 expected_ns;
 
 	instrumentation_begin();
 
@@ -243,6 +284,7 @@ noinstr int cpuidle_enter_state(struct cpuidle_device *dev,
 	sched_idle_set_state(target_state);
 
 	trace_cpu_idle(index, dev->cpu);
+	expected_ns = cpuidle_expected_residency(dev);
 	time_start = ns_to_ktime(local_clock_noinstr());
 
 	stop_critical_timings();
@@ -302,6 +344,8 @@ noinstr int cpuidle_enter_state(struct cpuidle_device *dev,
 		dev->last_residency_ns = diff;
 		dev->states_usage[entered_state].time_ns += diff;
 		dev->states_usage[entered_state].usage++;
+		cpuidle_account_exit_latency(&dev->states_usage[entered_state],
+					     diff, expected_ns);
 
 		if (diff < drv->states[entered_state].target_residency_ns) {
 			for (i = entered_state - 1; i >= 0; i--) {
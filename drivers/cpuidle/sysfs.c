@@ -269,6 +269,25 @@ define_show_state_str_function(desc)
 define_show_state_ull_function(above)
 define_show_state_ull_function(below)
 
+#ifdef CONFIG_CPU_IDLE_EXIT_LATENCY_STATS
+define_show_state_ull_function(exit_max_ns)
+
+static ssize_t show_state_exit_hist(struct cpuidle_state *state,
+				    struct cpuidle_state_usage *state_usage,
+				    char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < CPUIDLE_EXIT_HIST_BUCKETS; i++)
+		len += sysfs_emit_at(buf, len, i ? " %llu" : "%llu",
+				     state_usage->exit_hist[i]);
+	len += sysfs_emit_at(buf, len, "\n");
+
+	return len;
+}
+#endif
+
 static ssize_t show_state_time(struct cpuidle_state *state,
 			       struct cpuidle_state_usage *state_usage,
 			       char *buf)
@@ -326,6 +345,10 @@ define_one_state_rw(disable, show_state_disable, store_state_disable);
 define_one_state_ro(above, show_state_above);
 define_one_state_ro(below, show_state_below);
 define_one_state_ro(default_status, show_state_default_status);
+#ifdef CONFIG_CPU_IDLE_EXIT_LATENCY_STATS
+define_one_state_ro(exit_latency_hist, show_state_exit_hist);
+define_one_state_ro(exit_latency_max_ns, show_state_exit_max_ns);
+#endif
 
 static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_name.attr,
@@ -340,6 +363,10 @@ static struct attribute *cpuidle_state_default_attrs[] = {
 	&attr_above.attr,
 	&attr_below.attr,
 	&attr_default_status.attr,
+#ifdef CONFIG_CPU_IDLE_EXIT_LATENCY_STATS
+	&attr_exit_latency_hist.attr,
+	&attr_exit_latency_max_ns.attr,
+#endif
 	NULL
 };
 ATTRIBUTE_GROUPS(cpuidle_state_default);
@@ -1440,6 +1440,147 @@ int dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 }
 EXPORT_SYMBOL_NS_GPL(dma_buf_end_cpu_access, DMA_BUF);
 
+static bool dma_buf_range_valid(struct dma_buf *dmabuf, unsigned int offset,
+				unsigned int len)
+{
+	return len && offset < dmabuf->size && len <= dmabuf->size - offset;
+}
+
+/**
+ * dma_buf_begin_cpu_access_partial - Must be called before accessing part of
+ * a dma_buf from the cpu in the kernel context.
+ * @dmabuf:	[in]	buffer to prepare cpu access for.
+ * @direction:	[in]	direction of access.
+ * @offset:	[in]	offset of the range accessed, in bytes.
+ * @len:	[in]	length of the range accessed, in bytes.
+ *
+ * Like dma_buf_begin_cpu_access(), but coherency is only guaranteed for the
+ * given range, which lets exporters skip cache maintenance on the rest of the
+ * buffer. Exporters without &dma_buf_ops.begin_cpu_access_partial get the
+ * whole buffer synced instead.
+ *
+ * Can return negative error values, returns 0 on success.
+ */
+int dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+				     enum dma_data_direction direction,
+				     unsigned int offset, unsigned int len)
+{
+	int ret = 0;
+
+	if (WARN_ON(!dmabuf))
+		return -EINVAL;
+
+	if (!dma_buf_range_valid(dmabuf, offset, len))
+		return -EINVAL;
+
+	might_lock(&dmabuf->resv->lock.base);
+
+	if (dmabuf->ops->begin_cpu_access_partial)
+		ret = dmabuf->ops->begin_cpu_access_partial(dmabuf, direction,
+							    offset, len);
+	else if (dmabuf->ops->begin_cpu_access)
+		ret = dmabuf->ops->begin_cpu_access(dmabuf, direction);
+
+	if (ret == 0)
+		ret = __dma_buf_begin_cpu_access(dmabuf, direction);
+
+	return ret;
+}
+EXPORT_SYMBOL_NS_GPL(dma_buf_begin_cpu_access_partial, DMA_BUF);
+
+/**
+ * dma_buf_end_cpu_access_partial - Must be called after accessing part of a
+ * dma_buf from the cpu in the kernel context.
+ * @dmabuf:	[in]	buffer to complete cpu access for.
+ * @direction:	[in]	direction of access.
+ * @offset:	[in]	offset of the range accessed, in bytes.
+ * @len:	[in]	length of the range accessed, in bytes.
+ *
+ * This terminates CPU access started with dma_buf_begin_cpu_access_partial().
+ *
+ * Can return negative error values, returns 0 on success.
+ */
+int dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+				   enum dma_data_direction direction,
+				   unsigned int offset, unsigned int len)
+{
+	int ret = 0;
+
+	if (WARN_ON(!dmabuf))
+		return -EINVAL;
+
+	if (!dma_buf_range_valid(dmabuf, offset, len))
+		return -EINVAL;
+
+	might_lock(&dmabuf->resv->lock.base);
+
+	if (dmabuf->ops->end_cpu_access_partial)
+		ret = dmabuf->ops->end_cpu_access_partial(dmabuf, direction,
+							  offset, len);
+	else if (dmabuf->ops->end_cpu_access)
+		ret = dmabuf->ops->end_cpu_access(dmabuf, direction);
+
+	return ret;
+}
+EXPORT_SYMBOL_NS_GPL(dma_buf_end_cpu_access_partial, DMA_BUF);
+
+/**
+ * dma_buf_sync_sgtable_range - sync part of a mapped sg_table
+ * @dev:	[in]	device the table is mapped for.
+ * @sgt:	[in]	table mapped with dma_map_sgtable() or dma_map_sg().
+ * @direction:	[in]	direction of access.
+ * @offset:	[in]	offset of the range in the buffer, in bytes.
+ * @len:	[in]	length of the range, in bytes.
+ * @for_cpu:	[in]	sync for the cpu rather than for the device.
+ *
+ * Helper for exporters implementing &dma_buf_ops.begin_cpu_access_partial and
+ * &dma_buf_ops.end_cpu_access_partial. Only DMA segments that each cover a
+ * single entry of the table can be synced in part. If the mapping merged
+ * entries, the whole table is synced.
+ */
+void dma_buf_sync_sgtable_range(struct device *dev, struct sg_table *sgt,
+				enum dma_data_direction direction,
+				unsigned int offset, unsigned int len,
+				bool for_cpu)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (sgt->nents != sgt->orig_nents) {
+		if (for_cpu)
+			dma_sync_sg_for_cpu(dev, sgt->sgl, sgt->orig_nents,
+					    direction);
+		else
+			dma_sync_sg_for_device(dev, sgt->sgl, sgt->orig_nents,
+					       direction);
+		return;
+	}
+
+	for_each_sgtable_dma_sg(sgt, sg, i) {
+		unsigned int seg_len = sg_dma_len(sg);
+		unsigned int n;
+
+		if (offset >= seg_len) {
+			offset -= seg_len;
+			continue;
+		}
+
+		n = min(seg_len - offset, len);
+		if (for_cpu)
+			dma_sync_single_range_for_cpu(dev, sg_dma_address(sg),
+						      offset, n, direction);
+		else
+			dma_sync_single_range_for_device(dev,
+							 sg_dma_address(sg),
+							 offset, n, direction);
+		len -= n;
+		if (!len)
+			break;
+		offset = 0;
+	}
+}
+EXPORT_SYMBOL_NS_GPL(dma_buf_sync_sgtable_range, DMA_BUF);
+
 
 /**
  * dma_buf_mmap - Setup up a userspace mmap with the given vma
@@ -367,7 +367,7 @@ void __dma_fence_might_wait(void)
 int dma_fence_signal_timestamp_locked(struct dma_fence *fence,
 				      ktime_t timestamp)
 {
-	struct dma_fence_cb *cur, *tmp;
+	struct dma_fence_cb *cur, *tmp, *single = NULL;
 	struct list_head cb_list;
 
 	lockdep_assert_held(fence->lock);
@@ -376,13 +376,27 @@ int dma_fence_signal_timestamp_locked(struct dma_fence *fence,
 				      &fence->flags)))
 		return -EINVAL;
 
-	/* Stash the cb_list before replacing it with the timestamp */
-	list_replace(&fence->cb_list, &cb_list);
+	/*
+	 * Stash the cb_list before replacing it with the timestamp. Most
+	 * fences have exactly one waiter, so take that one off directly
+	 * instead of splicing the list only to walk a single entry.
+	 */
+	if (list_is_singular(&fence->cb_list))
+		single = list_first_entry(&fence->cb_list,
+					  struct dma_fence_cb, node);
+	else
+		list_replace(&fence->cb_list, &cb_list);
 
 	fence->timestamp = timestamp;
 	set_bit(DMA_FENCE_FLAG_TIMESTAMP_BIT, &fence->flags);
 	trace_dma_fence_signaled(fence);
 
+	if (single) {
+		INIT_LIST_HEAD(&single->node);
+		single->func(fence, single);
+		return 0;
+	}
+
 	list_for_each_entry_safe(cur, tmp, &cb_list, node) {
 		INIT_LIST_HEAD(&cur->node);
 		cur->func(fence, cur);
@@ -415,6 +429,10 @@ int dma_fence_signal_timestamp(struct dma_fence *fence, ktime_t timestamp)
 	if (!fence)
 		return -EINVAL;
 
+	/* The signaled bit never clears, no need to take the lock */
+	if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &fence->flags))
+		return -EINVAL;
+
 	spin_lock_irqsave(fence->lock, flags);
 	ret = dma_fence_signal_timestamp_locked(fence, timestamp);
 	spin_unlock_irqrestore(fence->lock, flags);
@@ -467,6 +485,10 @@ int dma_fence_signal(struct dma_fence *fence)
 	if (!fence)
 		return -EINVAL;
 
+	/* The signaled bit never clears, no need to take the lock */
+	if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &fence->flags))
+		return -EINVAL;
+
 	tmp = dma_fence_begin_signalling();
 
 	spin_lock_irqsave(fence->lock, flags);
@@ -19,17 +19,38 @@
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/shrinker.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
+/*
+ * Released buffers are kept in a per-heap pool, up to pool_max_kb, and
+ * handed out again to allocations of the same size. This avoids the
+ * page migration cma_alloc() may have to do, which shows up as
+ * multi-millisecond stalls when frame buffers are reallocated. Buffers
+ * are zeroed in the background before they are reused, and the pool is
+ * given back to CMA under memory pressure. A limit of 0 disables it.
+ */
+static unsigned long pool_max_kb;
+module_param(pool_max_kb, ulong, 0644);
+MODULE_PARM_DESC(pool_max_kb, "Maximum size of the recycled buffer pool in KiB per heap (0 = disabled)");
 
 struct cma_heap {
 	struct dma_heap *heap;
 	struct cma *cma;
+
+	struct mutex pool_lock;
+	struct list_head pool_clean;	/* zeroed, ready for reuse */
+	struct list_head pool_dirty;	/* waiting for pool_work */
+	unsigned long pool_pages;
+	struct work_struct pool_work;
+	struct shrinker pool_shrinker;
 };
 
 struct cma_heap_buffer {
 	struct cma_heap *heap;
+	struct list_head pool_node;
 	struct list_head attachments;
 	struct mutex lock;
 	unsigned long len;
@@ -160,6 +181,54 @@ static int cma_heap_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 	return 0;
 }
 
+static int cma_heap_dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+						     enum dma_data_direction direction,
+						     unsigned int offset,
+						     unsigned int len)
+{
+	struct cma_heap_buffer *buffer = dmabuf->priv;
+	struct dma_heap_attachment *a;
+
+	mutex_lock(&buffer->lock);
+
+	if (buffer->vmap_cnt)
+		invalidate_kernel_vmap_range(buffer->vaddr + offset, len);
+
+	list_for_each_entry(a, &buffer->attachments, list) {
+		if (!a->mapped)
+			continue;
+		dma_buf_sync_sgtable_range(a->dev, &a->table, direction,
+					   offset, len, true);
+	}
+	mutex_unlock(&buffer->lock);
+
+	return 0;
+}
+
+static int cma_heap_dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+						   enum dma_data_direction direction,
+						   unsigned int offset,
+						   unsigned int len)
+{
+	struct cma_heap_buffer *buffer = dmabuf->priv;
+	struct dma_heap_attachment *a;
+
+	mutex_lock(&buffer->lock);
+
+	if (buffer->vmap_cnt)
+		flush_kernel_vmap_range(buffer->vaddr + offset, len);
+
+	list_for_each_entry(a, &buffer->attachments, list) {
+		if (!a->mapped)
+			continue;
+		dma_buf_sync_sgtable_range(a->dev, &a->table, direction,
+					   offset, len, false);
+	}
+	mutex_unlock(&buffer->lock);
+
+	return 0;
+}
+
 static vm_fault_t cma_heap_vm_fault(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
@@ -242,22 +311,171 @@ static void cma_heap_vunmap(struct dma_buf *dmabuf, struct iosys_map *map)
 	iosys_map_clear(map);
 }
 
+static int cma_heap_clear_pages(struct page *cma_pages, pgoff_t pagecount,
+				bool killable)
+{
+	if (PageHighMem(cma_pages)) {
+		unsigned long nr_clear_pages = pagecount;
+		struct page *page = cma_pages;
+
+		while (nr_clear_pages > 0) {
+			void *vaddr = kmap_atomic(page);
+
+			memset(vaddr, 0, PAGE_SIZE);
+			kunmap_atomic(vaddr);
+			/*
+			 * Avoid wasting time zeroing memory if the process
+			 * has been killed by by SIGKILL
+			 */
+			if (killable && fatal_signal_pending(current))
+				return -EINTR;
+			page++;
+			nr_clear_pages--;
+		}
+	} else {
+		memset(page_address(cma_pages), 0, pagecount << PAGE_SHIFT);
+	}
+
+	return 0;
+}
+
+static void cma_heap_buffer_free(struct cma_heap_buffer *buffer)
+{
+	/* free page list */
+	kfree(buffer->pages);
+	/* release memory */
+	cma_release(buffer->heap->cma, buffer->cma_pages, buffer->pagecount);
+	kfree(buffer);
+}
+
+static void cma_heap_pool_put(struct cma_heap *cma_heap,
+			      struct cma_heap_buffer *buffer)
+{
+	unsigned long max_pages = READ_ONCE(pool_max_kb) >> (PAGE_SHIFT - 10);
+
+	mutex_lock(&cma_heap->pool_lock);
+	if (cma_heap->pool_pages + buffer->pagecount > max_pages) {
+		mutex_unlock(&cma_heap->pool_lock);
+		cma_heap_buffer_free(buffer);
+		return;
+	}
+	list_add_tail(&buffer->pool_node, &cma_heap->pool_dirty);
+	cma_heap->pool_pages += buffer->pagecount;
+	mutex_unlock(&cma_heap->pool_lock);
+
+	queue_work(system_unbound_wq, &cma_heap->pool_work);
+}
+
+static struct cma_heap_buffer *cma_heap_pool_get(struct cma_heap *cma_heap,
+						 pgoff_t pagecount)
+{
+	struct cma_heap_buffer *buffer;
+	bool dirty = false;
+
+	mutex_lock(&cma_heap->pool_lock);
+	list_for_each_entry(buffer, &cma_heap->pool_clean, pool_node)
+		if (buffer->pagecount == pagecount)
+			goto found;
+	/* Still cheaper to zero it here than to go through cma_alloc() */
+	dirty = true;
+	list_for_each_entry(buffer, &cma_heap->pool_dirty, pool_node)
+		if (buffer->pagecount == pagecount)
+			goto found;
+	mutex_unlock(&cma_heap->pool_lock);
+
+	return NULL;
+
+found:
+	list_del(&buffer->pool_node);
+	cma_heap->pool_pages -= pagecount;
+	mutex_unlock(&cma_heap->pool_lock);
+
+	if (dirty && cma_heap_clear_pages(buffer->cma_pages, pagecount, true)) {
+		cma_heap_pool_put(cma_heap, buffer);
+		return ERR_PTR(-EINTR);
+	}
+
+	return buffer;
+}
+
+static void cma_heap_pool_work(struct work_struct *work)
+{
+	struct cma_heap *cma_heap = container_of(work, struct cma_heap,
+						 pool_work);
+	struct cma_heap_buffer *buffer;
+
+	mutex_lock(&cma_heap->pool_lock);
+	while ((buffer = list_first_entry_or_null(&cma_heap->pool_dirty,
+						  struct cma_heap_buffer,
+						  pool_node))) {
+		/* Stays accounted in pool_pages while it is being zeroed */
+		list_del(&buffer->pool_node);
+		mutex_unlock(&cma_heap->pool_lock);
+
+		cma_heap_clear_pages(buffer->cma_pages, buffer->pagecount, false);
+		cond_resched();
+
+		mutex_lock(&cma_heap->pool_lock);
+		list_add_tail(&buffer->pool_node, &cma_heap->pool_clean);
+	}
+	mutex_unlock(&cma_heap->pool_lock);
+}
+
+static unsigned long cma_heap_pool_count(struct shrinker *shrinker,
+					 struct shrink_control *sc)
+{
+	struct cma_heap *cma_heap = container_of(shrinker, struct cma_heap,
+						 pool_shrinker);
+
+	return READ_ONCE(cma_heap->pool_pages) ? : SHRINK_EMPTY;
+}
+
+static unsigned long cma_heap_pool_scan(struct shrinker *shrinker,
+					struct shrink_control *sc)
+{
+	struct cma_heap *cma_heap = container_of(shrinker, struct cma_heap,
+						 pool_shrinker);
+	struct cma_heap_buffer *buffer, *tmp;
+	unsigned long freed = 0;
+	LIST_HEAD(list);
+
+	if (!mutex_trylock(&cma_heap->pool_lock))
+		return SHRINK_STOP;
+
+	/* Drop buffers that still need zeroing first */
+	list_for_each_entry_safe(buffer, tmp, &cma_heap->pool_dirty, pool_node) {
+		if (freed >= sc->nr_to_scan)
+			break;
+		list_move(&buffer->pool_node, &list);
+		freed += buffer->pagecount;
+	}
+	list_for_each_entry_safe(buffer, tmp, &cma_heap->pool_clean, pool_node) {
+		if (freed >= sc->nr_to_scan)
+			break;
+		list_move(&buffer->pool_node, &list);
+		freed += buffer->pagecount;
+	}
+	cma_heap->pool_pages -= freed;
+	mutex_unlock(&cma_heap->pool_lock);
+
+	list_for_each_entry_safe(buffer, tmp, &list, pool_node)
+		cma_heap_buffer_free(buffer);
+
+	return freed;
+}
+
 static void cma_heap_dma_buf_release(struct dma_buf *dmabuf)
 {
 	struct cma_heap_buffer *buffer = dmabuf->priv;
-	struct cma_heap *cma_heap = buffer->heap;
 
 	if (buffer->vmap_cnt > 0) {
 		WARN(1, "%s: buffer still mapped in the kernel\n", __func__);
 		vunmap(buffer->vaddr);
 		buffer->vaddr = NULL;
+		buffer->vmap_cnt = 0;
 	}
 
-	/* free page list */
-	kfree(buffer->pages);
-	/* release memory */
-	cma_release(cma_heap->cma, buffer->cma_pages, buffer->pagecount);
-	kfree(buffer);
+	cma_heap_pool_put(buffer->heap, buffer);
 }
 
 static const struct dma_buf_ops cma_heap_buf_ops = {
@@ -267,12 +485,29 @@ static const struct dma_buf_ops cma_heap_buf_ops = {
 	.unmap_dma_buf = cma_heap_unmap_dma_buf,
 	.begin_cpu_access = cma_heap_dma_buf_begin_cpu_access,
 	.end_cpu_access = cma_heap_dma_buf_end_cpu_access,
+	.begin_cpu_access_partial = cma_heap_dma_buf_begin_cpu_access_partial,
+	.end_cpu_access_partial = cma_heap_dma_buf_end_cpu_access_partial,
 	.mmap = cma_heap_mmap,
 	.vmap = cma_heap_vmap,
 	.vunmap = cma_heap_vunmap,
 	.release = cma_heap_dma_buf_release,
 };
 
+static struct dma_buf *cma_heap_export(struct dma_heap *heap,
+				       struct cma_heap_buffer *buffer,
+				       unsigned long fd_flags)
+{
+	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
+
+	exp_info.exp_name = dma_heap_get_name(heap);
+	exp_info.ops = &cma_heap_buf_ops;
+	exp_info.size = buffer->len;
+	exp_info.flags = fd_flags;
+	exp_info.priv = buffer;
+
+	return dma_buf_export(&exp_info);
+}
+
 static struct dma_buf *cma_heap_allocate(struct dma_heap *heap,
 					 unsigned long len,
 					 unsigned long fd_flags,
@@ -280,7 +515,6 @@ static struct dma_buf *cma_heap_allocate(struct dma_heap *heap,
 {
 	struct cma_heap *cma_heap = dma_heap_get_drvdata(heap);
 	struct cma_heap_buffer *buffer;
-	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
 	size_t size = PAGE_ALIGN(len);
 	pgoff_t pagecount = size >> PAGE_SHIFT;
 	unsigned long align = get_order(size);
@@ -289,6 +523,16 @@ static struct dma_buf *cma_heap_allocate(struct dma_heap *heap,
 	int ret = -ENOMEM;
 	pgoff_t pg;
 
+	buffer = cma_heap_pool_get(cma_heap, pagecount);
+	if (IS_ERR(buffer))
+		return ERR_CAST(buffer);
+	if (buffer) {
+		dmabuf = cma_heap_export(heap, buffer, fd_flags);
+		if (IS_ERR(dmabuf))
+			cma_heap_pool_put(cma_heap, buffer);
+		return dmabuf;
+	}
+
 	buffer = kzalloc(sizeof(*buffer), GFP_KERNEL);
 	if (!buffer)
 		return ERR_PTR(-ENOMEM);
@@ -305,27 +549,8 @@ static struct dma_buf *cma_heap_allocate(struct dma_heap *heap,
 		goto free_buffer;
 
 	/* Clear the cma pages */
-	if (PageHighMem(cma_pages)) {
-		unsigned long nr_clear_pages = pagecount;
-		struct page *page = cma_pages;
-
-		while (nr_clear_pages > 0) {
-			void *vaddr = kmap_atomic(page);
-
-			memset(vaddr, 0, PAGE_SIZE);
-			kunmap_atomic(vaddr);
-			/*
-			 * Avoid wasting time zeroing memory if the process
-			 * has been killed by by SIGKILL
-			 */
-			if (fatal_signal_pending(current))
-				goto free_cma;
-			page++;
-			nr_clear_pages--;
-		}
-	} else {
-		memset(page_address(cma_pages), 0, size);
-	}
+	if (cma_heap_clear_pages(cma_pages, pagecount, true))
+		goto free_cma;
 
 	buffer->pages = kmalloc_array(pagecount, sizeof(*buffer->pages), GFP_KERNEL);
 	if (!buffer->pages) {
@@ -341,12 +566,7 @@ static struct dma_buf *cma_heap_allocate(struct dma_heap *heap,
 	buffer->pagecount = pagecount;
 
 	/* create the dmabuf */
-	exp_info.exp_name = dma_heap_get_name(heap);
-	exp_info.ops = &cma_heap_buf_ops;
-	exp_info.size = buffer->len;
-	exp_info.flags = fd_flags;
-	exp_info.priv = buffer;
-	dmabuf = dma_buf_export(&exp_info);
+	dmabuf = cma_heap_export(heap, buffer, fd_flags);
 	if (IS_ERR(dmabuf)) {
 		ret = PTR_ERR(dmabuf);
 		goto free_pages;
@@ -371,11 +591,26 @@ static int __add_cma_heap(struct cma *cma, void *data)
 {
 	struct cma_heap *cma_heap;
 	struct dma_heap_export_info exp_info;
+	int ret;
 
 	cma_heap = kzalloc(sizeof(*cma_heap), GFP_KERNEL);
 	if (!cma_heap)
 		return -ENOMEM;
 	cma_heap->cma = cma;
+	mutex_init(&cma_heap->pool_lock);
+	INIT_LIST_HEAD(&cma_heap->pool_clean);
+	INIT_LIST_HEAD(&cma_heap->pool_dirty);
+	INIT_WORK(&cma_heap->pool_work, cma_heap_pool_work);
+
+	cma_heap->pool_shrinker.count_objects = cma_heap_pool_count;
+	cma_heap->pool_shrinker.scan_objects = cma_heap_pool_scan;
+	cma_heap->pool_shrinker.seeks = DEFAULT_SEEKS;
+	ret = register_shrinker(&cma_heap->pool_shrinker, "dmabuf-cma-%s",
+				cma_get_name(cma));
+	if (ret) {
+		kfree(cma_heap);
+		return ret;
+	}
 
 	exp_info.name = cma_get_name(cma);
 	exp_info.ops = &cma_heap_ops;
@@ -383,8 +618,8 @@ static int __add_cma_heap(struct cma *cma, void *data)
 
 	cma_heap->heap = dma_heap_add(&exp_info);
 	if (IS_ERR(cma_heap->heap)) {
-		int ret = PTR_ERR(cma_heap->heap);
-
+		ret = PTR_ERR(cma_heap->heap);
+		unregister_shrinker(&cma_heap->pool_shrinker);
 		kfree(cma_heap);
 		return ret;
 	}
@@ -40,6 +40,8 @@
 #define BCM2835_DMA_CHAN_NAME_SIZE 8
 #define BCM2835_DMA_BULK_MASK  BIT(0)
 #define BCM2711_DMA_MEMCPY_CHAN 14
+/* copies up to this size are left to lite channels if one is free */
+#define BCM2835_DMA_MEMCPY_LITE_LEN (SZ_64K - 4)
 
 struct bcm2835_dma_cfg_data {
 	u64	dma_mask;
@@ -351,6 +353,13 @@ static inline size_t bcm2835_dma_frames_for_length(size_t len,
 	return DIV_ROUND_UP(len, max_len);
 }
 
+/* whether the channel can address @addr (legacy channels are 32-bit) */
+static inline bool bcm2835_dma_can_reach(struct bcm2835_chan *c,
+					 dma_addr_t addr)
+{
+	return c->is_40bit_channel || c->is_2712 || !upper_32_bits(addr);
+}
+
 static inline struct bcm2835_dmadev *to_bcm2835_dma_dev(struct dma_device *d)
 {
 	return container_of(d, struct bcm2835_dmadev, ddev);
@@ -985,6 +994,10 @@ static struct dma_async_tx_descriptor *bcm2835_dma_prep_dma_memcpy(
 	if (!src || !dst || !len)
 		return NULL;
 
+	if (!bcm2835_dma_can_reach(c, src + len - 1) ||
+	    !bcm2835_dma_can_reach(c, dst + len - 1))
+		return NULL;
+
 	/* calculate number of frames */
 	frames = bcm2835_dma_frames_for_length(len, max_len);
 
@@ -998,6 +1011,69 @@ static struct dma_async_tx_descriptor *bcm2835_dma_prep_dma_memcpy(
 	return vchan_tx_prep(&c->vc, &d->vd, flags);
 }
 
+/*
+ * Point the source of a memset control block at a spare word of the control
+ * block itself holding the fill pattern, read without incrementing.
+ */
+static void bcm2835_dma_cb_set_pattern(struct bcm2835_chan *c,
+				       struct bcm2835_cb_entry *cb_entry,
+				       u32 info, u32 pattern)
+{
+	dma_addr_t src;
+
+	if (c->is_40bit_channel) {
+		struct bcm2711_dma40_scb *scb =
+			(struct bcm2711_dma40_scb *)cb_entry->cb;
+
+		scb->rsvd = pattern;
+		src = cb_entry->paddr + offsetof(struct bcm2711_dma40_scb, rsvd);
+		scb->src = lower_32_bits(src);
+		scb->srci = upper_32_bits(src) | to_bcm2711_srci(info);
+	} else {
+		struct bcm2835_dma_cb *cb = cb_entry->cb;
+
+		cb->pad[0] = pattern;
+		src = cb_entry->paddr + offsetof(struct bcm2835_dma_cb, pad);
+		cb->src = lower_32_bits(src);
+		if (c->is_2712)
+			cb->stride = (cb->stride & ~0xff) | upper_32_bits(src);
+	}
+}
+
+static struct dma_async_tx_descriptor *bcm2835_dma_prep_dma_memset(
+	struct dma_chan *chan, dma_addr_t dst, int value, size_t len,
+	unsigned long flags)
+{
+	struct bcm2835_chan *c = to_bcm2835_dma_chan(chan);
+	struct bcm2835_desc *d;
+	u32 info = BCM2835_DMA_D_INC | WAIT_RESP(c->dreq) |
+		   WIDE_DEST(c->dreq) | BURST_LENGTH(c->dreq);
+	u32 extra = BCM2835_DMA_INT_EN;
+	size_t max_len = bcm2835_dma_max_frame_length(c);
+	u32 pattern = (value & 0xff) * 0x01010101;
+	size_t frames, i;
+
+	if (!dst || !len)
+		return NULL;
+
+	if (!bcm2835_dma_can_reach(c, dst + len - 1))
+		return NULL;
+
+	frames = bcm2835_dma_frames_for_length(len, max_len);
+
+	/* the source is filled in per control block below */
+	d = bcm2835_dma_create_cb_chain(c, DMA_MEM_TO_MEM, false,
+					info, extra, frames,
+					0, dst, len, 0, GFP_KERNEL);
+	if (!d)
+		return NULL;
+
+	for (i = 0; i < d->frames; i++)
+		bcm2835_dma_cb_set_pattern(c, &d->cb_list[i], info, pattern);
+
+	return vchan_tx_prep(&c->vc, &d->vd, flags);
+}
+
 static struct dma_async_tx_descriptor *bcm2835_dma_prep_slave_sg(
 	struct dma_chan *chan,
 	struct scatterlist *sgl, unsigned int sg_len,
@@ -1275,6 +1351,70 @@ void bcm2711_dma40_memcpy(dma_addr_t dst, dma_addr_t src, size_t size)
 }
 EXPORT_SYMBOL(bcm2711_dma40_memcpy);
 
+struct bcm2835_dma_memcpy_req {
+	size_t len;
+	dma_addr_t max_addr;
+	bool preferred_only;
+};
+
+static bool bcm2835_dma_memcpy_filter(struct dma_chan *chan, void *param)
+{
+	struct bcm2835_dma_memcpy_req *req = param;
+	struct bcm2835_chan *c;
+
+	if (chan->device->device_prep_dma_memcpy != bcm2835_dma_prep_dma_memcpy)
+		return false;
+
+	c = to_bcm2835_dma_chan(chan);
+	if (!bcm2835_dma_can_reach(c, req->max_addr))
+		return false;
+
+	if (!req->preferred_only)
+		return true;
+
+	/*
+	 * Lite channels have half the bandwidth and a 64K frame limit, which
+	 * doesn't matter for small copies, so keep the others for large ones.
+	 */
+	if (req->len <= BCM2835_DMA_MEMCPY_LITE_LEN)
+		return c->is_lite_channel;
+
+	return !c->is_lite_channel;
+}
+
+/**
+ * bcm2835_dma_request_memcpy_chan - request a channel for memcpy/memset
+ * @len: typical size of the copies to be done
+ * @max_addr: highest bus address on either side of the copies
+ *
+ * Returns a channel able to reach @max_addr, preferring a lite channel for
+ * small copies and a full or 40-bit channel for large ones, and falling
+ * back to any free channel otherwise. Release with dma_release_channel().
+ */
+struct dma_chan *bcm2835_dma_request_memcpy_chan(size_t len,
+						 dma_addr_t max_addr)
+{
+	struct bcm2835_dma_memcpy_req req = {
+		.len = len,
+		.max_addr = max_addr,
+		.preferred_only = true,
+	};
+	struct dma_chan *chan;
+	dma_cap_mask_t mask;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_MEMCPY, mask);
+
+	chan = dma_request_channel(mask, bcm2835_dma_memcpy_filter, &req);
+	if (chan)
+		return chan;
+
+	req.preferred_only = false;
+
+	return dma_request_channel(mask, bcm2835_dma_memcpy_filter, &req);
+}
+EXPORT_SYMBOL(bcm2835_dma_request_memcpy_chan);
+
 static const struct of_device_id bcm2835_dma_of_match[] = {
 	{ .compatible = "brcm,bcm2835-dma", .data = &bcm2835_dma_cfg },
 	{ .compatible = "brcm,bcm2711-dma", .data = &bcm2711_dma_cfg },
@@ -1354,6 +1494,7 @@ static int bcm2835_dma_probe(struct platform_device *pdev)
 	dma_cap_set(DMA_PRIVATE, od->ddev.cap_mask);
 	dma_cap_set(DMA_CYCLIC, od->ddev.cap_mask);
 	dma_cap_set(DMA_MEMCPY, od->ddev.cap_mask);
+	dma_cap_set(DMA_MEMSET, od->ddev.cap_mask);
 	od->ddev.device_alloc_chan_resources = bcm2835_dma_alloc_chan_resources;
 	od->ddev.device_free_chan_resources = bcm2835_dma_free_chan_resources;
 	od->ddev.device_tx_status = bcm2835_dma_tx_status;
@@ -1361,6 +1502,7 @@ static int bcm2835_dma_probe(struct platform_device *pdev)
 	od->ddev.device_prep_dma_cyclic = bcm2835_dma_prep_dma_cyclic;
 	od->ddev.device_prep_slave_sg = bcm2835_dma_prep_slave_sg;
 	od->ddev.device_prep_dma_memcpy = bcm2835_dma_prep_dma_memcpy;
+	od->ddev.device_prep_dma_memset = bcm2835_dma_prep_dma_memset;
 	od->ddev.device_config = bcm2835_dma_slave_config;
 	od->ddev.device_terminate_all = bcm2835_dma_terminate_all;
 	od->ddev.device_synchronize = bcm2835_dma_synchronize;
@@ -283,13 +283,84 @@ static struct axi_dma_desc *axi_desc_alloc(u32 num)
 	return desc;
 }
 
+/*
+ * Descriptors are prepared and freed at a high rate for audio and SPI
+ * streams, so LLIs go through a per-channel cache rather than straight back
+ * to the DMA pool.
+ */
+static bool axi_lli_cache_get(struct axi_dma_chan *chan,
+			      struct axi_dma_lli **lli, dma_addr_t *phys)
+{
+	unsigned long flags;
+	bool found = false;
+
+	spin_lock_irqsave(&chan->lli_cache_lock, flags);
+	if (chan->lli_cache_count) {
+		struct axi_dma_lli_cache *entry =
+			&chan->lli_cache[--chan->lli_cache_count];
+
+		*lli = entry->lli;
+		*phys = entry->llp;
+		found = true;
+	}
+	spin_unlock_irqrestore(&chan->lli_cache_lock, flags);
+
+	return found;
+}
+
+static bool axi_lli_cache_put(struct axi_dma_chan *chan,
+			      struct axi_dma_lli *lli, dma_addr_t phys)
+{
+	unsigned long flags;
+	bool cached = false;
+
+	spin_lock_irqsave(&chan->lli_cache_lock, flags);
+	if (chan->lli_cache_count < DMAC_LLI_CACHE_SIZE) {
+		struct axi_dma_lli_cache *entry =
+			&chan->lli_cache[chan->lli_cache_count++];
+
+		entry->lli = lli;
+		entry->llp = phys;
+		cached = true;
+	}
+	spin_unlock_irqrestore(&chan->lli_cache_lock, flags);
+
+	return cached;
+}
+
+static void axi_lli_cache_prealloc(struct axi_dma_chan *chan)
+{
+	struct axi_dma_lli *lli;
+	dma_addr_t phys;
+	int i;
+
+	for (i = 0; i < DMAC_LLI_PREALLOC; i++) {
+		lli = dma_pool_alloc(chan->desc_pool, GFP_KERNEL, &phys);
+		if (!lli)
+			break;
+		axi_lli_cache_put(chan, lli, phys);
+	}
+}
+
+static void axi_lli_cache_drain(struct axi_dma_chan *chan)
+{
+	struct axi_dma_lli *lli;
+	dma_addr_t phys;
+
+	while (axi_lli_cache_get(chan, &lli, &phys))
+		dma_pool_free(chan->desc_pool, lli, phys);
+}
+
 static struct axi_dma_lli *axi_desc_get(struct axi_dma_chan *chan,
 					dma_addr_t *addr)
 {
 	struct axi_dma_lli *lli;
 	dma_addr_t phys;
 
-	lli = dma_pool_zalloc(chan->desc_pool, GFP_NOWAIT, &phys);
+	if (axi_lli_cache_get(chan, &lli, &phys))
+		memset(lli, 0, sizeof(*lli));
+	else
+		lli = dma_pool_zalloc(chan->desc_pool, GFP_NOWAIT, &phys);
 	if (unlikely(!lli)) {
 		dev_err(chan2dev(chan), "%s: not enough descriptors available\n",
 			axi_chan_name(chan));
@@ -311,7 +382,8 @@ static void axi_desc_put(struct axi_dma_desc *desc)
 
 	for (descs_put = 0; descs_put < count; descs_put++) {
 		hw_desc = &desc->hw_desc[descs_put];
-		dma_pool_free(chan->desc_pool, hw_desc->lli, hw_desc->llp);
+		if (!axi_lli_cache_put(chan, hw_desc->lli, hw_desc->llp))
+			dma_pool_free(chan->desc_pool, hw_desc->lli, hw_desc->llp);
 	}
 
 	kfree(desc->hw_desc);
@@ -561,6 +633,7 @@ static int dma_chan_alloc_chan_resources(struct dma_chan *dchan)
 		dev_err(chan2dev(chan), "No memory for descriptors\n");
 		return -ENOMEM;
 	}
+	axi_lli_cache_prealloc(chan);
 	dev_vdbg(dchan2dev(dchan), "%s: allocating\n", axi_chan_name(chan));
 
 	pm_runtime_get(chan->chip->dev);
@@ -582,6 +655,7 @@ static void dma_chan_free_chan_resources(struct dma_chan *dchan)
 
 	vchan_free_chan_resources(&chan->vc);
 
+	axi_lli_cache_drain(chan);
 	dma_pool_destroy(chan->desc_pool);
 	chan->desc_pool = NULL;
 	dev_vdbg(dchan2dev(dchan),
@@ -1544,6 +1618,7 @@ static int dw_probe(struct platform_device *pdev)
 		chan->id = i;
 		chan->chan_regs = chip->regs + COMMON_REG_LEN + i * CHAN_REG_LEN;
 		atomic_set(&chan->descs_allocated, 0);
+		spin_lock_init(&chan->lli_cache_lock);
 
 		chan->vc.desc_free = vchan_desc_put;
 		vchan_init(&chan->vc, &dw->dma);
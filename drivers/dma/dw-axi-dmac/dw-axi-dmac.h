@@ -22,6 +22,10 @@
 #define DMAC_MAX_MASTERS	2
 #define DMAC_MAX_BLK_SIZE	0x200000
 
+/* LLIs kept by each channel for reuse, and preallocated on channel request */
+#define DMAC_LLI_CACHE_SIZE	64
+#define DMAC_LLI_PREALLOC	16
+
 struct dw_axi_dma_hcfg {
 	u32	nr_channels;
 	u32	nr_masters;
@@ -36,6 +40,11 @@ struct dw_axi_dma_hcfg {
 	bool	use_cfg2;
 };
 
+struct axi_dma_lli_cache {
+	struct axi_dma_lli		*lli;
+	dma_addr_t			llp;
+};
+
 struct axi_dma_chan {
 	struct axi_dma_chip		*chip;
 	void __iomem			*chan_regs;
@@ -44,6 +53,10 @@ struct axi_dma_chan {
 	atomic_t			descs_allocated;
 
 	struct dma_pool			*desc_pool;
+	/* LLIs freed back from descriptors, protected by lli_cache_lock */
+	spinlock_t			lli_cache_lock;
+	struct axi_dma_lli_cache	lli_cache[DMAC_LLI_CACHE_SIZE];
+	unsigned int			lli_cache_count;
 	struct virt_dma_chan		vc;
 
 	struct axi_dma_desc		*desc;
@@ -631,10 +631,11 @@ static void linereq_put_event(struct linereq *lr,
 		kfifo_skip(&lr->events);
 	}
 	kfifo_in(&lr->events, le, 1);
-	spin_unlock(&lr->wait.lock);
+	/* the waitqueue lock is already held, don't take it again to wake */
 	if (!overflow)
-		wake_up_poll(&lr->wait, EPOLLIN);
-	else
+		wake_up_locked_poll(&lr->wait, EPOLLIN);
+	spin_unlock(&lr->wait.lock);
+	if (overflow)
 		pr_debug_ratelimited("event FIFO is full - event dropped\n");
 }
 
@@ -1511,14 +1512,16 @@ static ssize_t linereq_read_unlocked(struct file *file, char __user *buf,
 				     size_t count, loff_t *f_ps)
 {
 	struct linereq *lr = file->private_data;
-	struct gpio_v2_line_event le;
+	/* drain the FIFO in batches rather than one event per lock round */
+	struct gpio_v2_line_event le[8];
 	ssize_t bytes_read = 0;
+	unsigned int n;
 	int ret;
 
 	if (!lr->gdev->chip)
 		return -ENODEV;
 
-	if (count < sizeof(le))
+	if (count < sizeof(le[0]))
 		return -EINVAL;
 
 	do {
@@ -1542,9 +1545,11 @@ static ssize_t linereq_read_unlocked(struct file *file, char __user *buf,
 			}
 		}
 
-		ret = kfifo_out(&lr->events, &le, 1);
+		n = min_t(size_t, ARRAY_SIZE(le),
+			  (count - bytes_read) / sizeof(le[0]));
+		n = kfifo_out(&lr->events, le, n);
 		spin_unlock(&lr->wait.lock);
-		if (ret != 1) {
+		if (!n) {
 			/*
 			 * This should never happen - we were holding the
 			 * lock from the moment we learned the fifo is no
@@ -1554,10 +1559,10 @@ static ssize_t linereq_read_unlocked(struct file *file, char __user *buf,
 			break;
 		}
 
-		if (copy_to_user(buf + bytes_read, &le, sizeof(le)))
+		if (copy_to_user(buf + bytes_read, le, n * sizeof(le[0])))
 			return -EFAULT;
-		bytes_read += sizeof(le);
-	} while (count >= bytes_read + sizeof(le));
+		bytes_read += n * sizeof(le[0]);
+	} while (count >= bytes_read + sizeof(le[0]));
 
 	return bytes_read;
 }
@@ -12,6 +12,7 @@
 #include <linux/module.h>
 #include <linux/regulator/consumer.h>
 #include <linux/spi/spi.h>
+#include <linux/workqueue.h>
 
 #include <drm/drm_connector.h>
 #include <drm/drm_damage_helper.h>
@@ -251,6 +252,21 @@ static void mipi_dbi_set_window_address(struct mipi_dbi_dev *dbidev,
 			 ys & 0xff, (ye >> 8) & 0xff, ye & 0xff);
 }
 
+#if IS_ENABLED(CONFIG_SPI)
+static int mipi_dbi_typec3_write_memory_banded(struct mipi_dbi_dev *dbidev,
+					       struct iosys_map *src,
+					       struct drm_framebuffer *fb,
+					       struct drm_rect *rect);
+#else
+static int mipi_dbi_typec3_write_memory_banded(struct mipi_dbi_dev *dbidev,
+					       struct iosys_map *src,
+					       struct drm_framebuffer *fb,
+					       struct drm_rect *rect)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 static void mipi_dbi_fb_dirty(struct iosys_map *src, struct drm_framebuffer *fb,
 			      struct drm_rect *rect)
 {
@@ -267,8 +283,16 @@ static void mipi_dbi_fb_dirty(struct iosys_map *src, struct drm_framebuffer *fb,
 
 	DRM_DEBUG_KMS("Flushing [FB:%d] " DRM_RECT_FMT "\n", fb->base.id, DRM_RECT_ARG(rect));
 
+	mipi_dbi_set_window_address(dbidev, rect->x1, rect->x2 - 1, rect->y1,
+				    rect->y2 - 1);
+
 	if (!dbi->dc || !full || swap ||
 	    fb->format->format == DRM_FORMAT_XRGB8888) {
+		/* Overlap the conversion with the transfer where possible */
+		ret = mipi_dbi_typec3_write_memory_banded(dbidev, src, fb, rect);
+		if (ret != -EOPNOTSUPP)
+			goto err_msg;
+
 		tr = dbidev->tx_buf;
 		ret = mipi_dbi_buf_copy(tr, src, fb, rect, swap);
 		if (ret)
@@ -277,9 +301,6 @@ static void mipi_dbi_fb_dirty(struct iosys_map *src, struct drm_framebuffer *fb,
 		tr = src->vaddr; /* TODO: Use mapping abstraction properly */
 	}
 
-	mipi_dbi_set_window_address(dbidev, rect->x1, rect->x2 - 1, rect->y1,
-				    rect->y2 - 1);
-
 	ret = mipi_dbi_command_buf(dbi, MIPI_DCS_WRITE_MEMORY_START, tr,
 				   width * height * 2);
 err_msg:
@@ -1200,6 +1221,127 @@ static int mipi_dbi_typec3_command(struct mipi_dbi *dbi, u8 *cmd,
 	return ret;
 }
 
+/*
+ * Size of the bands a converted framebuffer update is split into, so that
+ * the conversion of one band can run while the previous one is on the wire.
+ */
+#define MIPI_DBI_BAND_SIZE	SZ_16K
+
+struct mipi_dbi_band_copy {
+	struct work_struct work;
+	struct iosys_map *src;
+	struct drm_framebuffer *fb;
+	struct drm_rect clip;
+	void *dst;
+	bool swap;
+	int ret;
+};
+
+static void mipi_dbi_band_copy_work(struct work_struct *work)
+{
+	struct mipi_dbi_band_copy *copy =
+		container_of(work, struct mipi_dbi_band_copy, work);
+
+	copy->ret = mipi_dbi_buf_copy(copy->dst, copy->src, copy->fb,
+				      &copy->clip, copy->swap);
+}
+
+/*
+ * Sends a framebuffer update that needs converting into &mipi_dbi_dev.tx_buf
+ * as one MIPI_DCS_WRITE_MEMORY_START, using the two halves of tx_buf in turn.
+ * While one band is transferred, the next one is converted on another CPU.
+ *
+ * Returns -EOPNOTSUPP if the interface or the update is not suited to it.
+ */
+static int mipi_dbi_typec3_write_memory_banded(struct mipi_dbi_dev *dbidev,
+					       struct iosys_map *src,
+					       struct drm_framebuffer *fb,
+					       struct drm_rect *rect)
+{
+	struct mipi_dbi *dbi = &dbidev->dbi;
+	struct spi_device *spi = dbi->spi;
+	unsigned int width = drm_rect_width(rect);
+	unsigned int height = drm_rect_height(rect);
+	unsigned int band_lines = max_t(unsigned int,
+					MIPI_DBI_BAND_SIZE / (width * 2), 1);
+	size_t band_len = band_lines * width * 2;
+	struct mipi_dbi_band_copy copy;
+	unsigned int bpw = dbi->swap_bytes ? 8 : 16;
+	struct drm_rect band;
+	u32 speed_hz;
+	u8 *cmdbuf;
+	int ret;
+
+	/* Drivers with their own command function handle the bus themselves */
+	if (dbi->command != mipi_dbi_typec3_command || height < 2 * band_lines)
+		return -EOPNOTSUPP;
+
+	/* SPI requires dma-safe buffers */
+	cmdbuf = kmalloc(1, GFP_KERNEL);
+	if (!cmdbuf)
+		return -ENOMEM;
+	*cmdbuf = MIPI_DCS_WRITE_MEMORY_START;
+
+	copy.src = src;
+	copy.fb = fb;
+	copy.swap = dbi->swap_bytes;
+	copy.dst = dbidev->tx_buf;
+	copy.clip = *rect;
+	copy.clip.y2 = rect->y1 + band_lines;
+	INIT_WORK_ONSTACK(&copy.work, mipi_dbi_band_copy_work);
+
+	ret = mipi_dbi_buf_copy(copy.dst, src, fb, &copy.clip, copy.swap);
+	if (ret)
+		goto out_free;
+
+	mutex_lock(&dbi->cmdlock);
+	MIPI_DBI_DEBUG_COMMAND(*cmdbuf, NULL, (size_t)width * height * 2);
+
+	spi_bus_lock(spi->controller);
+	gpiod_set_value_cansleep(dbi->dc, 0);
+	speed_hz = mipi_dbi_spi_cmd_max_speed(spi, 1);
+	ret = mipi_dbi_spi_transfer(spi, speed_hz, 8, cmdbuf, 1);
+	if (ret)
+		goto out_unlock;
+
+	gpiod_set_value_cansleep(dbi->dc, 1);
+	speed_hz = mipi_dbi_spi_cmd_max_speed(spi, width * height * 2);
+
+	do {
+		void *buf = copy.dst;
+		bool more;
+
+		band = copy.clip;
+		more = band.y2 < rect->y2;
+		if (more) {
+			copy.dst = buf == (void *)dbidev->tx_buf ?
+				   (void *)dbidev->tx_buf + band_len :
+				   (void *)dbidev->tx_buf;
+			copy.clip.y1 = band.y2;
+			copy.clip.y2 = min(band.y2 + band_lines, rect->y2);
+			queue_work(system_unbound_wq, &copy.work);
+		}
+
+		ret = mipi_dbi_spi_transfer(spi, speed_hz, bpw, buf,
+					    drm_rect_height(&band) * width * 2);
+
+		if (more) {
+			flush_work(&copy.work);
+			if (!ret)
+				ret = copy.ret;
+		}
+	} while (!ret && band.y2 < rect->y2);
+
+out_unlock:
+	spi_bus_unlock(spi->controller);
+	mutex_unlock(&dbi->cmdlock);
+out_free:
+	destroy_work_on_stack(&copy.work);
+	kfree(cmdbuf);
+
+	return ret;
+}
+
 /**
  * mipi_dbi_spi_init - Initialize MIPI DBI SPI interface
  * @spi: SPI device
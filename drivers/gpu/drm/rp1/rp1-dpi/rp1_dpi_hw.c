@@ -244,6 +244,11 @@ struct rp1dpi_ipixfmt {
 				 BITS(DPI_DMA_SHIFT_OG, g) | \
 				 BITS(DPI_DMA_SHIFT_OB, b))
 
+/*
+ * Formats come in RGB/BGR pairs: rp1dpi_hw_setup() flips the low bit of
+ * the index to swap red and blue for BGR buses. Alpha is ignored, and
+ * the padding bits of packed formats are simply masked off.
+ */
 static const struct rp1dpi_ipixfmt my_formats[] = {
 	{
 	  .format = DRM_FORMAT_XRGB8888,
@@ -282,6 +287,42 @@ static const struct rp1dpi_ipixfmt my_formats[] = {
 	  .shift  = ISHIFT_RGB(4, 10, 15),
 	  .rgbsz  = BITS(DPI_DMA_RGBSZ_R, 5) | BITS(DPI_DMA_RGBSZ_G, 6) |
 		    BITS(DPI_DMA_RGBSZ_B, 5) | BITS(DPI_DMA_RGBSZ_BPP, 1),
+	},
+	{
+	  .format = DRM_FORMAT_ARGB8888,
+	  .mask	  = IMASK_RGB(0x3fc, 0x3fc, 0x3fc),
+	  .shift  = ISHIFT_RGB(23, 15, 7),
+	  .rgbsz  = BITS(DPI_DMA_RGBSZ_BPP, 3),
+	},
+	{
+	  .format = DRM_FORMAT_ABGR8888,
+	  .mask	  = IMASK_RGB(0x3fc, 0x3fc, 0x3fc),
+	  .shift  = ISHIFT_RGB(7, 15, 23),
+	  .rgbsz  = BITS(DPI_DMA_RGBSZ_BPP, 3),
+	},
+	{
+	  .format = DRM_FORMAT_RGBX8888,
+	  .mask	  = IMASK_RGB(0x3fc, 0x3fc, 0x3fc),
+	  .shift  = ISHIFT_RGB(31, 23, 15),
+	  .rgbsz  = BITS(DPI_DMA_RGBSZ_BPP, 3),
+	},
+	{
+	  .format = DRM_FORMAT_BGRX8888,
+	  .mask	  = IMASK_RGB(0x3fc, 0x3fc, 0x3fc),
+	  .shift  = ISHIFT_RGB(15, 23, 31),
+	  .rgbsz  = BITS(DPI_DMA_RGBSZ_BPP, 3),
+	},
+	{
+	  .format = DRM_FORMAT_XRGB2101010,
+	  .mask	  = IMASK_RGB(0x3ff, 0x3ff, 0x3ff),
+	  .shift  = ISHIFT_RGB(29, 19, 9),
+	  .rgbsz  = BITS(DPI_DMA_RGBSZ_BPP, 3),
+	},
+	{
+	  .format = DRM_FORMAT_XBGR2101010,
+	  .mask	  = IMASK_RGB(0x3ff, 0x3ff, 0x3ff),
+	  .shift  = ISHIFT_RGB(9, 19, 29),
+	  .rgbsz  = BITS(DPI_DMA_RGBSZ_BPP, 3),
 	}
 };
 
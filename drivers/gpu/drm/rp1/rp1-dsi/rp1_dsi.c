@@ -103,7 +103,6 @@ static void rp1dsi_pipe_update(struct drm_simple_display_pipe *pipe,
 			       struct drm_plane_state *old_state)
 {
 	struct drm_pending_vblank_event *event;
-	unsigned long flags;
 	struct drm_framebuffer *fb = pipe->plane.state->fb;
 	struct rp1_dsi *dsi = pipe->crtc.dev->dev_private;
 	struct drm_gem_object *gem = fb ? drm_gem_fb_get_obj(fb, 0) : NULL;
@@ -126,20 +125,26 @@ static void rp1dsi_pipe_update(struct drm_simple_display_pipe *pipe,
 			dsi->cur_fmt  = fb->format->format;
 			drm_crtc_vblank_on(&pipe->crtc);
 		}
-		rp1dsi_dma_update(dsi, dma_obj->dma_addr, fb->offsets[0], fb->pitches[0]);
 	}
 
-	/* Arm VBLANK event (or call it immediately in some error cases) */
-	spin_lock_irqsave(&pipe->crtc.dev->event_lock, flags);
+	/*
+	 * Queue the VBLANK event with the flip, to be sent once the DMA has
+	 * latched the new address (or call it immediately in some error cases).
+	 */
 	event = pipe->crtc.state->event;
-	if (event) {
-		pipe->crtc.state->event = NULL;
-		if (can_update && drm_crtc_vblank_get(&pipe->crtc) == 0)
-			drm_crtc_arm_vblank_event(&pipe->crtc, event);
-		else
-			drm_crtc_send_vblank_event(&pipe->crtc, event);
+	pipe->crtc.state->event = NULL;
+	if (event && !(can_update && drm_crtc_vblank_get(&pipe->crtc) == 0)) {
+		unsigned long flags;
+
+		spin_lock_irqsave(&pipe->crtc.dev->event_lock, flags);
+		drm_crtc_send_vblank_event(&pipe->crtc, event);
+		spin_unlock_irqrestore(&pipe->crtc.dev->event_lock, flags);
+		event = NULL;
 	}
-	spin_unlock_irqrestore(&pipe->crtc.dev->event_lock, flags);
+
+	if (can_update)
+		rp1dsi_dma_update(dsi, dma_obj->dma_addr, fb->offsets[0], fb->pitches[0],
+				  event);
 }
 
 static inline struct rp1_dsi *
@@ -426,6 +431,7 @@ static int rp1dsi_platform_probe(struct platform_device *pdev)
 		goto err_free_drm;
 	}
 	init_completion(&dsi->finished);
+	spin_lock_init(&dsi->flip_lock);
 	dsi->drm = drm;
 	dsi->pdev = pdev;
 	drm->dev_private = dsi;
@@ -9,12 +9,14 @@
 
 #include <linux/clk.h>
 #include <linux/io.h>
+#include <linux/spinlock.h>
 #include <linux/types.h>
 
 #include <drm/drm_bridge.h>
 #include <drm/drm_device.h>
 #include <drm/drm_mipi_dsi.h>
 #include <drm/drm_simple_kms_helper.h>
+#include <drm/drm_vblank.h>
 
 #define MODULE_NAME "drm-rp1-dsi"
 #define DRIVER_NAME "drm-rp1-dsi"
@@ -54,6 +56,14 @@ struct rp1_dsi {
 	bool dsi_running, dma_running, pipe_enabled;
 	struct completion finished;
 
+	/*
+	 * Page flip event waiting for the DMA to latch the new address,
+	 * and the number of frame starts until it has. Protected by flip_lock.
+	 */
+	spinlock_t flip_lock;
+	struct drm_pending_vblank_event *flip_event;
+	unsigned int flip_wait;
+
 	/* Attached display parameters (from mipi_dsi_device) */
 	unsigned long display_flags, display_hs_rate, display_lp_rate;
 	enum mipi_dsi_pixel_format display_format;
@@ -70,7 +80,8 @@ struct rp1_dsi {
 void rp1dsi_dma_setup(struct rp1_dsi *dsi,
 		      u32 in_format, enum mipi_dsi_pixel_format out_format,
 		      struct drm_display_mode const *mode);
-void rp1dsi_dma_update(struct rp1_dsi *dsi, dma_addr_t addr, u32 offset, u32 stride);
+void rp1dsi_dma_update(struct rp1_dsi *dsi, dma_addr_t addr, u32 offset, u32 stride,
+		       struct drm_pending_vblank_event *event);
 void rp1dsi_dma_stop(struct rp1_dsi *dsi);
 int rp1dsi_dma_busy(struct rp1_dsi *dsi);
 irqreturn_t rp1dsi_dma_isr(int irq, void *dev);
@@ -380,18 +380,67 @@ void rp1dsi_dma_setup(struct rp1_dsi *dsi,
 			 BITS(DPI_DMA_CONTROL_VSYNC_EN, 1));
 }
 
-void rp1dsi_dma_update(struct rp1_dsi *dsi, dma_addr_t addr, u32 offset, u32 stride)
+static void rp1dsi_dma_send_flip_event(struct rp1_dsi *dsi,
+				       struct drm_pending_vblank_event *event)
+{
+	struct drm_crtc *crtc = &dsi->pipe.crtc;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dsi->drm->event_lock, flags);
+	drm_crtc_send_vblank_event(crtc, event);
+	spin_unlock_irqrestore(&dsi->drm->event_lock, flags);
+	drm_crtc_vblank_put(crtc);
+}
+
+void rp1dsi_dma_update(struct rp1_dsi *dsi, dma_addr_t addr, u32 offset, u32 stride,
+		       struct drm_pending_vblank_event *event)
 {
 	/*
 	 * Update STRIDE, DMAH and DMAL only. When called after rp1dsi_dma_setup(),
 	 * DMA starts immediately; if already running, the buffer will flip at
 	 * the next vertical sync event.
+	 *
+	 * The registers are shadowed and latched by the DMA at DMA_READY, so
+	 * the flip completes at the first DMA_READY known to come after the
+	 * write. If the flag is already raised once the registers have been
+	 * written, we can't tell which side of the latch the write landed
+	 * on, so wait for the one after. The caller must hold a vblank
+	 * reference for the event, which is dropped when it is sent.
 	 */
+	struct drm_pending_vblank_event *stale = NULL;
 	u64 a = addr + offset;
+	unsigned long flags;
 
+	spin_lock_irqsave(&dsi->flip_lock, flags);
 	rp1dsi_dma_write(dsi, DPI_DMA_DMA_STRIDE, stride);
 	rp1dsi_dma_write(dsi, DPI_DMA_DMA_ADDR_H, a >> 32);
 	rp1dsi_dma_write(dsi, DPI_DMA_DMA_ADDR_L, a & 0xFFFFFFFFu);
+	if (event) {
+		stale = dsi->flip_event;
+		dsi->flip_event = event;
+		dsi->flip_wait = (rp1dsi_dma_read(dsi, DPI_DMA_IRQ_FLAGS) &
+				  DPI_DMA_IRQ_FLAGS_DMA_READY_MASK) ? 2 : 1;
+	}
+	spin_unlock_irqrestore(&dsi->flip_lock, flags);
+
+	if (WARN_ON(stale))
+		rp1dsi_dma_send_flip_event(dsi, stale);
+}
+
+/* Complete any flip still outstanding, when DMA has stopped. */
+static void rp1dsi_dma_flush_flip(struct rp1_dsi *dsi)
+{
+	struct drm_pending_vblank_event *event;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dsi->flip_lock, flags);
+	event = dsi->flip_event;
+	dsi->flip_event = NULL;
+	dsi->flip_wait = 0;
+	spin_unlock_irqrestore(&dsi->flip_lock, flags);
+
+	if (event)
+		rp1dsi_dma_send_flip_event(dsi, event);
 }
 
 void rp1dsi_dma_stop(struct rp1_dsi *dsi)
@@ -410,6 +459,7 @@ void rp1dsi_dma_stop(struct rp1_dsi *dsi)
 	if (!wait_for_completion_timeout(&dsi->finished, HZ / 10))
 		drm_err(dsi->drm, "%s: timed out waiting for idle\n", __func__);
 	rp1dsi_dma_write(dsi, DPI_DMA_IRQ_EN, 0);
+	rp1dsi_dma_flush_flip(dsi);
 }
 
 void rp1dsi_dma_vblank_ctrl(struct rp1_dsi *dsi, int enable)
@@ -424,20 +474,33 @@ void rp1dsi_dma_vblank_ctrl(struct rp1_dsi *dsi, int enable)
 irqreturn_t rp1dsi_dma_isr(int irq, void *dev)
 {
 	struct rp1_dsi *dsi = dev;
-	u32 u = rp1dsi_dma_read(dsi, DPI_DMA_IRQ_FLAGS);
+	struct drm_pending_vblank_event *event = NULL;
+	u32 u;
 
+	/* Flags are read and cleared under flip_lock; see rp1dsi_dma_update() */
+	spin_lock(&dsi->flip_lock);
+	u = rp1dsi_dma_read(dsi, DPI_DMA_IRQ_FLAGS);
 	if (u) {
 		rp1dsi_dma_write(dsi, DPI_DMA_IRQ_FLAGS, u);
-		if (dsi) {
-			if (u & DPI_DMA_IRQ_FLAGS_UNDERFLOW_MASK)
-				drm_err_ratelimited(dsi->drm,
-						    "Underflow! (panics=0x%08x)\n",
-						    rp1dsi_dma_read(dsi, DPI_DMA_PANICS));
-			if (u & DPI_DMA_IRQ_FLAGS_DMA_READY_MASK)
-				drm_crtc_handle_vblank(&dsi->pipe.crtc);
-			if (u & DPI_DMA_IRQ_FLAGS_AFIFO_EMPTY_MASK)
-				complete(&dsi->finished);
+		if ((u & DPI_DMA_IRQ_FLAGS_DMA_READY_MASK) &&
+		    dsi->flip_wait && !--dsi->flip_wait) {
+			event = dsi->flip_event;
+			dsi->flip_event = NULL;
 		}
 	}
+	spin_unlock(&dsi->flip_lock);
+
+	if (u) {
+		if (u & DPI_DMA_IRQ_FLAGS_UNDERFLOW_MASK)
+			drm_err_ratelimited(dsi->drm,
+					    "Underflow! (panics=0x%08x)\n",
+					    rp1dsi_dma_read(dsi, DPI_DMA_PANICS));
+		if (u & DPI_DMA_IRQ_FLAGS_DMA_READY_MASK)
+			drm_crtc_handle_vblank(&dsi->pipe.crtc);
+		if (event)
+			rp1dsi_dma_send_flip_event(dsi, event);
+		if (u & DPI_DMA_IRQ_FLAGS_AFIFO_EMPTY_MASK)
+			complete(&dsi->finished);
+	}
 	return u ? IRQ_HANDLED : IRQ_NONE;
 }
@@ -66,6 +66,13 @@ int drm_sched_entity_init(struct drm_sched_entity *entity,
 		return -EINVAL;
 
 	memset(entity, 0, sizeof(struct drm_sched_entity));
+
+	entity->stats = kzalloc(sizeof(*entity->stats), GFP_KERNEL);
+	if (!entity->stats)
+		return -ENOMEM;
+	kref_init(&entity->stats->kref);
+	drm_sched_stats_init(&entity->stats->stats);
+
 	INIT_LIST_HEAD(&entity->list);
 	entity->rq = NULL;
 	entity->guilty = guilty;
@@ -319,6 +326,9 @@ void drm_sched_entity_fini(struct drm_sched_entity *entity)
 
 	dma_fence_put(rcu_dereference_check(entity->last_scheduled, true));
 	RCU_INIT_POINTER(entity->last_scheduled, NULL);
+
+	drm_sched_entity_stats_put(entity->stats);
+	entity->stats = NULL;
 }
 EXPORT_SYMBOL(drm_sched_entity_fini);
 
@@ -336,6 +346,41 @@ void drm_sched_entity_destroy(struct drm_sched_entity *entity)
 }
 EXPORT_SYMBOL(drm_sched_entity_destroy);
 
+static void drm_sched_entity_stats_release(struct kref *kref)
+{
+	kfree(container_of(kref, struct drm_sched_entity_stats, kref));
+}
+
+/**
+ * drm_sched_entity_stats_put - drop a reference to entity statistics
+ * @stats: statistics to release, may be NULL
+ */
+void drm_sched_entity_stats_put(struct drm_sched_entity_stats *stats)
+{
+	if (stats)
+		kref_put(&stats->kref, drm_sched_entity_stats_release);
+}
+EXPORT_SYMBOL(drm_sched_entity_stats_put);
+
+/**
+ * drm_sched_entity_print_stats - print the job latency histograms
+ * @entity: scheduler entity
+ * @p: printer to output to, typically the driver's fdinfo printer
+ * @prefix: key prefix, e.g. "v3d-render"
+ *
+ * Emits "<prefix>-{dep-wait,queue-wait,exec}-{total,max,hist}" keys in
+ * the fdinfo key/value format. Totals and maxima are in nanoseconds, the
+ * histogram is a space separated list of counts per log2(usecs) bucket as
+ * described for &struct drm_sched_hist.
+ */
+void drm_sched_entity_print_stats(struct drm_sched_entity *entity,
+				  struct drm_printer *p, const char *prefix)
+{
+	if (entity->stats)
+		drm_sched_stats_print(&entity->stats->stats, p, prefix);
+}
+EXPORT_SYMBOL(drm_sched_entity_print_stats);
+
 /* drm_sched_entity_clear_dep - callback to clear the entities dependency */
 static void drm_sched_entity_clear_dep(struct dma_fence *f,
 				       struct dma_fence_cb *cb)
@@ -461,8 +506,29 @@ struct drm_sched_job *drm_sched_entity_pop_job(struct drm_sched_entity *entity)
 			drm_sched_job_dependency(sched_job, entity))) {
 		trace_drm_sched_job_wait_dep(sched_job, entity->dependency);
 
-		if (drm_sched_entity_add_dependency_cb(entity))
+		if (drm_sched_entity_add_dependency_cb(entity)) {
+			if (!sched_job->dep_ts)
+				sched_job->dep_ts = ktime_get();
 			return NULL;
+		}
+	}
+
+	if (sched_job->entity_stats) {
+		struct drm_sched_stats *stats = &sched_job->entity_stats->stats;
+		struct drm_sched_stats *sched_stats = &sched_job->sched->stats;
+		ktime_t now = ktime_get();
+		u64 dep_ns = 0, wait_ns;
+
+		wait_ns = ktime_to_ns(ktime_sub(now, sched_job->submit_ts));
+		if (sched_job->dep_ts)
+			dep_ns = ktime_to_ns(ktime_sub(now, sched_job->dep_ts));
+		dep_ns = min(dep_ns, wait_ns);
+
+		drm_sched_stats_add(stats, &stats->dep_wait, dep_ns);
+		drm_sched_stats_add(stats, &stats->queue_wait, wait_ns - dep_ns);
+		drm_sched_stats_add(sched_stats, &sched_stats->dep_wait, dep_ns);
+		drm_sched_stats_add(sched_stats, &sched_stats->queue_wait,
+				    wait_ns - dep_ns);
 	}
 
 	/* skip jobs from entity that marked guilty */
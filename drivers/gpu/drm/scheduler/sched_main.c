@@ -49,6 +49,7 @@
  */
 
 #include <linux/kthread.h>
+#include <linux/log2_hist.h>
 #include <linux/wait.h>
 #include <linux/sched.h>
 #include <linux/completion.h>
@@ -270,6 +271,16 @@ static void drm_sched_job_done(struct drm_sched_job *s_job, int result)
 	atomic_dec(&sched->hw_rq_count);
 	atomic_dec(sched->score);
 
+	if (s_job->run_ts) {
+		u64 ns = ktime_to_ns(ktime_sub(ktime_get(), s_job->run_ts));
+
+		if (s_job->entity_stats)
+			drm_sched_stats_add(&s_job->entity_stats->stats,
+					    &s_job->entity_stats->stats.exec, ns);
+		drm_sched_stats_add(&sched->stats, &sched->stats.exec, ns);
+		s_job->run_ts = 0;
+	}
+
 	trace_drm_sched_process_job(s_fence);
 
 	dma_fence_get(&s_fence->finished);
@@ -318,6 +329,96 @@ void drm_sched_fault(struct drm_gpu_scheduler *sched)
 }
 EXPORT_SYMBOL(drm_sched_fault);
 
+/**
+ * drm_sched_stats_init - initialize job latency statistics
+ * @stats: statistics to initialize
+ */
+void drm_sched_stats_init(struct drm_sched_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	spin_lock_init(&stats->lock);
+}
+EXPORT_SYMBOL(drm_sched_stats_init);
+
+/**
+ * drm_sched_stats_add - account one sample
+ * @stats: statistics @hist belongs to
+ * @hist: histogram to add the sample to
+ * @ns: sample in nanoseconds
+ *
+ * Safe to call from fence signalling (interrupt) context.
+ */
+void drm_sched_stats_add(struct drm_sched_stats *stats,
+			 struct drm_sched_hist *hist, u64 ns)
+{
+	unsigned int bucket;
+	unsigned long flags;
+
+	bucket = log2_hist_bucket(div_u64(ns, NSEC_PER_USEC), 0,
+				  DRM_SCHED_HIST_BUCKETS);
+
+	spin_lock_irqsave(&stats->lock, flags);
+	hist->buckets[bucket]++;
+	hist->total_ns += ns;
+	hist->max_ns = max(hist->max_ns, ns);
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+EXPORT_SYMBOL(drm_sched_stats_add);
+
+static void drm_sched_hist_print(struct drm_printer *p, const char *prefix,
+				 const char *name,
+				 const struct drm_sched_hist *hist)
+{
+	unsigned int i;
+
+	drm_printf(p, "%s-%s-total:\t%llu ns\n", prefix, name, hist->total_ns);
+	drm_printf(p, "%s-%s-max:\t%llu ns\n", prefix, name, hist->max_ns);
+	drm_printf(p, "%s-%s-hist:\t", prefix, name);
+	for (i = 0; i < DRM_SCHED_HIST_BUCKETS; i++)
+		drm_printf(p, i ? " %llu" : "%llu", hist->buckets[i]);
+	drm_printf(p, "\n");
+}
+
+/**
+ * drm_sched_stats_print - print job latency statistics
+ * @stats: statistics to print
+ * @p: printer to output to
+ * @prefix: key prefix
+ *
+ * See drm_sched_entity_print_stats() for the output format.
+ */
+void drm_sched_stats_print(struct drm_sched_stats *stats,
+			   struct drm_printer *p, const char *prefix)
+{
+	struct drm_sched_stats snap;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	snap = *stats;
+	spin_unlock_irqrestore(&stats->lock, flags);
+
+	drm_sched_hist_print(p, prefix, "dep-wait", &snap.dep_wait);
+	drm_sched_hist_print(p, prefix, "queue-wait", &snap.queue_wait);
+	drm_sched_hist_print(p, prefix, "exec", &snap.exec);
+}
+EXPORT_SYMBOL(drm_sched_stats_print);
+
+/**
+ * drm_sched_print_stats - print job latency statistics of a scheduler
+ * @sched: scheduler instance
+ * @p: printer to output to, e.g. a debugfs seq_file printer
+ * @prefix: key prefix, defaults to the scheduler name when NULL
+ *
+ * Prints the histograms aggregated over all entities that submitted to
+ * @sched, in the format described for drm_sched_entity_print_stats().
+ */
+void drm_sched_print_stats(struct drm_gpu_scheduler *sched,
+			   struct drm_printer *p, const char *prefix)
+{
+	drm_sched_stats_print(&sched->stats, p, prefix ?: sched->name);
+}
+EXPORT_SYMBOL(drm_sched_print_stats);
+
 /**
  * drm_sched_suspend_timeout - Suspend scheduler job timeout
  *
@@ -636,6 +737,9 @@ int drm_sched_job_init(struct drm_sched_job *job,
 		return -ENOENT;
 
 	job->entity = entity;
+	job->entity_stats = NULL;
+	job->dep_ts = 0;
+	job->run_ts = 0;
 	job->s_fence = drm_sched_fence_alloc(entity, owner);
 	if (!job->s_fence)
 		return -ENOMEM;
@@ -674,6 +778,11 @@ void drm_sched_job_arm(struct drm_sched_job *job)
 	job->s_priority = entity->rq - sched->sched_rq;
 	job->id = atomic64_inc_return(&sched->job_id_count);
 
+	if (entity->stats) {
+		kref_get(&entity->stats->kref);
+		job->entity_stats = entity->stats;
+	}
+
 	drm_sched_fence_init(job->s_fence, job->entity);
 }
 EXPORT_SYMBOL(drm_sched_job_arm);
@@ -844,6 +953,8 @@ void drm_sched_job_cleanup(struct drm_sched_job *job)
 	}
 	xa_destroy(&job->dependencies);
 
+	drm_sched_entity_stats_put(job->entity_stats);
+	job->entity_stats = NULL;
 }
 EXPORT_SYMBOL(drm_sched_job_cleanup);
 
@@ -1041,6 +1152,7 @@ static int drm_sched_main(void *param)
 		drm_sched_job_begin(sched_job);
 
 		trace_drm_run_job(sched_job, entity);
+		sched_job->run_ts = ktime_get();
 		fence = sched->ops->run_job(sched_job);
 		complete_all(&entity->entity_idle);
 		drm_sched_fence_scheduled(s_fence, fence);
@@ -1101,6 +1213,7 @@ int drm_sched_init(struct drm_gpu_scheduler *sched,
 		drm_sched_rq_init(sched, &sched->sched_rq[i]);
 
 	init_waitqueue_head(&sched->wake_up_worker);
+	drm_sched_stats_init(&sched->stats);
 	init_waitqueue_head(&sched->job_scheduled);
 	INIT_LIST_HEAD(&sched->pending_list);
 	spin_lock_init(&sched->job_list_lock);
@@ -17,28 +17,37 @@
  * Long term, we should support evicting pages from the MMU when under
  * memory pressure (thus the v3d_bo_get_pages() refcounting), but
  * that's not a high priority since our systems tend to not have swap.
+ *
+ * Since shmem allocation and the MMU updates are slow compared to the
+ * rate at which userspace creates and frees transient BOs, we keep a
+ * cache of recently freed BOs, which stay mapped in the MMU, that we
+ * can reuse (after zeroing) instead of building new ones.  Cached BOs
+ * are released after a second, or when the shrinker asks us to.
  */
 
 #include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/highmem.h>
 #include <linux/pfn_t.h>
 
 #include "v3d_drv.h"
 #include "uapi/drm/v3d_drm.h"
 
-/* Called DRM core on the last userspace/kernel unreference of the
- * BO.
- */
-void v3d_free_object(struct drm_gem_object *obj)
+static uint32_t bo_page_index(size_t size)
 {
+	return (size / PAGE_SIZE) - 1;
+}
+
+/* Frees a BO whose PTEs have already been removed. */
+static void __v3d_bo_destroy(struct v3d_bo *bo)
+{
+	struct drm_gem_object *obj = &bo->base.base;
 	struct v3d_dev *v3d = to_v3d_dev(obj->dev);
-	struct v3d_bo *bo = to_v3d_bo(obj);
 
-	v3d_mmu_remove_ptes(bo);
+	lockdep_assert_held(&v3d->bo_lock);
 
-	mutex_lock(&v3d->bo_lock);
 	v3d->bo_stats.num_allocated--;
 	v3d->bo_stats.pages_allocated -= obj->size >> V3D_MMU_PAGE_SHIFT;
-	mutex_unlock(&v3d->bo_lock);
 
 	spin_lock(&v3d->mm_lock);
 	drm_mm_remove_node(&bo->node);
@@ -50,6 +59,216 @@ void v3d_free_object(struct drm_gem_object *obj)
 	drm_gem_shmem_free(&bo->base);
 }
 
+static void v3d_bo_destroy(struct v3d_bo *bo)
+{
+	v3d_mmu_remove_ptes(bo);
+	__v3d_bo_destroy(bo);
+}
+
+/* Frees a list of BOs (linked through unref_head), with a single MMU
+ * flush for all of them.
+ */
+static void v3d_bo_destroy_list(struct v3d_dev *v3d, struct list_head *list)
+{
+	struct v3d_bo *bo, *save;
+
+	if (list_empty(list))
+		return;
+
+	list_for_each_entry(bo, list, unref_head)
+		v3d_mmu_clear_ptes(bo);
+
+	v3d_mmu_flush(v3d);
+
+	list_for_each_entry_safe(bo, save, list, unref_head) {
+		list_del(&bo->unref_head);
+		__v3d_bo_destroy(bo);
+	}
+}
+
+static void v3d_bo_remove_from_cache(struct v3d_bo *bo)
+{
+	struct v3d_dev *v3d = to_v3d_dev(bo->base.base.dev);
+
+	lockdep_assert_held(&v3d->bo_lock);
+	list_del(&bo->unref_head);
+	list_del(&bo->size_head);
+
+	v3d->bo_cache.num_cached--;
+	v3d->bo_cache.pages_cached -= bo->base.base.size >> PAGE_SHIFT;
+}
+
+static struct list_head *v3d_get_cache_list_for_size(struct v3d_dev *v3d,
+						     size_t size)
+{
+	uint32_t page_index = bo_page_index(size);
+
+	if (v3d->bo_cache.size_list_size <= page_index) {
+		uint32_t new_size = max(v3d->bo_cache.size_list_size * 2,
+					page_index + 1);
+		struct list_head *new_list;
+		uint32_t i;
+
+		new_list = kmalloc_array(new_size, sizeof(struct list_head),
+					 GFP_KERNEL);
+		if (!new_list)
+			return NULL;
+
+		/* Rebase the old cached BO lists to their new list
+		 * head locations.
+		 */
+		for (i = 0; i < v3d->bo_cache.size_list_size; i++) {
+			struct list_head *old_list =
+				&v3d->bo_cache.size_list[i];
+
+			if (list_empty(old_list))
+				INIT_LIST_HEAD(&new_list[i]);
+			else
+				list_replace(old_list, &new_list[i]);
+		}
+		/* And initialize the brand new BO list heads. */
+		for (i = v3d->bo_cache.size_list_size; i < new_size; i++)
+			INIT_LIST_HEAD(&new_list[i]);
+
+		kfree(v3d->bo_cache.size_list);
+		v3d->bo_cache.size_list = new_list;
+		v3d->bo_cache.size_list_size = new_size;
+	}
+
+	return &v3d->bo_cache.size_list[page_index];
+}
+
+/* Frees cached BOs, oldest first, until at least nr_pages pages have
+ * been released.  Returns the number of pages freed.
+ */
+static unsigned long v3d_bo_cache_free_pages(struct v3d_dev *v3d,
+					     unsigned long nr_pages)
+{
+	unsigned long freed = 0;
+	LIST_HEAD(free_list);
+
+	lockdep_assert_held(&v3d->bo_lock);
+
+	while (freed < nr_pages && !list_empty(&v3d->bo_cache.time_list)) {
+		struct v3d_bo *bo = list_last_entry(&v3d->bo_cache.time_list,
+						    struct v3d_bo, unref_head);
+
+		freed += bo->base.base.size >> PAGE_SHIFT;
+		v3d_bo_remove_from_cache(bo);
+		list_add(&bo->unref_head, &free_list);
+	}
+
+	v3d_bo_destroy_list(v3d, &free_list);
+
+	return freed;
+}
+
+static void v3d_bo_cache_purge(struct v3d_dev *v3d)
+{
+	mutex_lock(&v3d->bo_lock);
+	v3d_bo_cache_free_pages(v3d, ULONG_MAX);
+	mutex_unlock(&v3d->bo_lock);
+}
+
+static void v3d_bo_cache_free_old(struct v3d_dev *v3d)
+{
+	unsigned long expire_time = jiffies - msecs_to_jiffies(1000);
+	LIST_HEAD(free_list);
+
+	lockdep_assert_held(&v3d->bo_lock);
+
+	while (!list_empty(&v3d->bo_cache.time_list)) {
+		struct v3d_bo *bo = list_last_entry(&v3d->bo_cache.time_list,
+						    struct v3d_bo, unref_head);
+		if (time_before(expire_time, bo->free_time)) {
+			mod_timer(&v3d->bo_cache.time_timer,
+				  round_jiffies_up(jiffies +
+						   msecs_to_jiffies(1000)));
+			break;
+		}
+
+		v3d_bo_remove_from_cache(bo);
+		list_add(&bo->unref_head, &free_list);
+	}
+
+	v3d_bo_destroy_list(v3d, &free_list);
+}
+
+static struct v3d_bo *v3d_bo_get_from_cache(struct v3d_dev *v3d, size_t size)
+{
+	uint32_t page_index = bo_page_index(size);
+	struct v3d_bo *bo = NULL;
+
+	mutex_lock(&v3d->bo_lock);
+	if (page_index >= v3d->bo_cache.size_list_size)
+		goto out;
+
+	if (list_empty(&v3d->bo_cache.size_list[page_index]))
+		goto out;
+
+	bo = list_first_entry(&v3d->bo_cache.size_list[page_index],
+			      struct v3d_bo, size_head);
+	v3d_bo_remove_from_cache(bo);
+	kref_init(&bo->base.base.refcount);
+
+out:
+	mutex_unlock(&v3d->bo_lock);
+	return bo;
+}
+
+/* Clears the contents of a BO coming out of the cache, since it may
+ * have belonged to another client.  The BO is mapped write-combined
+ * elsewhere, so push our cached writes out to memory before the GPU
+ * or userspace can see it.
+ */
+static void v3d_bo_clear(struct v3d_bo *bo)
+{
+	struct drm_gem_object *obj = &bo->base.base;
+	pgoff_t i;
+
+	for (i = 0; i < obj->size >> PAGE_SHIFT; i++)
+		clear_highpage(bo->base.pages[i]);
+
+	dma_sync_sgtable_for_device(obj->dev->dev, bo->base.sgt,
+				    DMA_TO_DEVICE);
+}
+
+/* Called DRM core on the last userspace/kernel unreference of the
+ * BO.  Returns it to the BO cache if possible, otherwise frees it.
+ */
+void v3d_free_object(struct drm_gem_object *obj)
+{
+	struct v3d_dev *v3d = to_v3d_dev(obj->dev);
+	struct v3d_bo *bo = to_v3d_bo(obj);
+	struct list_head *cache_list;
+
+	mutex_lock(&v3d->bo_lock);
+	/* If the object references someone else's memory, we can't
+	 * cache it.
+	 */
+	if (obj->import_attach) {
+		v3d_bo_destroy(bo);
+		goto out;
+	}
+
+	cache_list = v3d_get_cache_list_for_size(v3d, obj->size);
+	if (!cache_list) {
+		v3d_bo_destroy(bo);
+		goto out;
+	}
+
+	bo->free_time = jiffies;
+	list_add(&bo->size_head, cache_list);
+	list_add(&bo->unref_head, &v3d->bo_cache.time_list);
+	v3d->bo_cache.num_cached++;
+	v3d->bo_cache.pages_cached += obj->size >> PAGE_SHIFT;
+
+	v3d_bo_cache_free_old(v3d);
+
+out:
+	mutex_unlock(&v3d->bo_lock);
+}
+
 static const struct drm_gem_object_funcs v3d_gem_funcs = {
 	.free = v3d_free_object,
 	.print_info = drm_gem_shmem_object_print_info,
@@ -123,14 +342,13 @@ v3d_bo_create_finish(struct drm_gem_object *obj)
 	return 0;
 }
 
-struct v3d_bo *v3d_bo_create(struct drm_device *dev, struct drm_file *file_priv,
-			     size_t unaligned_size)
+static struct v3d_bo *__v3d_bo_create(struct drm_device *dev, size_t size)
 {
 	struct drm_gem_shmem_object *shmem_obj;
 	struct v3d_bo *bo;
 	int ret;
 
-	shmem_obj = drm_gem_shmem_create(dev, unaligned_size);
+	shmem_obj = drm_gem_shmem_create(dev, size);
 	if (IS_ERR(shmem_obj))
 		return ERR_CAST(shmem_obj);
 	bo = to_v3d_bo(&shmem_obj->base);
@@ -146,6 +364,35 @@ struct v3d_bo *v3d_bo_create(struct drm_device *dev, struct drm_file *file_priv,
 	return ERR_PTR(ret);
 }
 
+struct v3d_bo *v3d_bo_create(struct drm_device *dev, struct drm_file *file_priv,
+			     size_t unaligned_size)
+{
+	struct v3d_dev *v3d = to_v3d_dev(dev);
+	size_t size = PAGE_ALIGN(unaligned_size);
+	struct v3d_bo *bo;
+
+	if (size == 0)
+		return ERR_PTR(-EINVAL);
+
+	/* First, try to get a v3d_bo from the kernel BO cache. */
+	bo = v3d_bo_get_from_cache(v3d, size);
+	if (bo) {
+		v3d_bo_clear(bo);
+		return bo;
+	}
+
+	bo = __v3d_bo_create(dev, size);
+	if (IS_ERR(bo)) {
+		/* The cached BOs hold on to both memory and GPU
+		 * address space, so drop them and try again.
+		 */
+		v3d_bo_cache_purge(v3d);
+		bo = __v3d_bo_create(dev, size);
+	}
+
+	return bo;
+}
+
 struct drm_gem_object *
 v3d_prime_import_sg_table(struct drm_device *dev,
 			  struct dma_buf_attachment *attach,
@@ -233,3 +480,84 @@ int v3d_get_bo_offset_ioctl(struct drm_device *dev, void *data,
 	drm_gem_object_put(gem_obj);
 	return 0;
 }
+
+static void v3d_bo_cache_time_work(struct work_struct *work)
+{
+	struct v3d_dev *v3d =
+		container_of(work, struct v3d_dev, bo_cache.time_work);
+
+	mutex_lock(&v3d->bo_lock);
+	v3d_bo_cache_free_old(v3d);
+	mutex_unlock(&v3d->bo_lock);
+}
+
+static void v3d_bo_cache_time_timer(struct timer_list *t)
+{
+	struct v3d_dev *v3d = from_timer(v3d, t, bo_cache.time_timer);
+
+	schedule_work(&v3d->bo_cache.time_work);
+}
+
+static unsigned long
+v3d_bo_cache_shrinker_count(struct shrinker *shrinker,
+			    struct shrink_control *sc)
+{
+	struct v3d_dev *v3d =
+		container_of(shrinker, struct v3d_dev, bo_cache.shrinker);
+
+	return READ_ONCE(v3d->bo_cache.pages_cached) ?: SHRINK_EMPTY;
+}
+
+static unsigned long
+v3d_bo_cache_shrinker_scan(struct shrinker *shrinker,
+			   struct shrink_control *sc)
+{
+	struct v3d_dev *v3d =
+		container_of(shrinker, struct v3d_dev, bo_cache.shrinker);
+	unsigned long freed;
+
+	/* bo_lock may be held by whoever is allocating and got us
+	 * here, so don't wait for it.
+	 */
+	if (!mutex_trylock(&v3d->bo_lock))
+		return SHRINK_STOP;
+
+	freed = v3d_bo_cache_free_pages(v3d, sc->nr_to_scan);
+	mutex_unlock(&v3d->bo_lock);
+
+	return freed ?: SHRINK_STOP;
+}
+
+int v3d_bo_cache_init(struct v3d_dev *v3d)
+{
+	INIT_LIST_HEAD(&v3d->bo_cache.time_list);
+
+	INIT_WORK(&v3d->bo_cache.time_work, v3d_bo_cache_time_work);
+	timer_setup(&v3d->bo_cache.time_timer, v3d_bo_cache_time_timer, 0);
+
+	v3d->bo_cache.shrinker.count_objects = v3d_bo_cache_shrinker_count;
+	v3d->bo_cache.shrinker.scan_objects = v3d_bo_cache_shrinker_scan;
+	v3d->bo_cache.shrinker.seeks = DEFAULT_SEEKS;
+
+	return register_shrinker(&v3d->bo_cache.shrinker, "drm-v3d_bo_cache");
+}
+
+void v3d_bo_cache_destroy(struct v3d_dev *v3d)
+{
+	unregister_shrinker(&v3d->bo_cache.shrinker);
+
+	/*
+	 * The work re-arms the timer and the timer queues the work. Stop the
+	 * work first, then shut the timer down for good and cancel any work
+	 * it queued in between.
+	 */
+	cancel_work_sync(&v3d->bo_cache.time_work);
+	timer_shutdown_sync(&v3d->bo_cache.time_timer);
+	cancel_work_sync(&v3d->bo_cache.time_work);
+
+	v3d_bo_cache_purge(v3d);
+
+	kfree(v3d->bo_cache.size_list);
+	v3d->bo_cache.size_list = NULL;
+	v3d->bo_cache.size_list_size = 0;
+}
@@ -9,6 +9,7 @@
 #include <linux/sched/clock.h>
 
 #include <drm/drm_debugfs.h>
+#include <drm/drm_print.h>
 
 #include "v3d_drv.h"
 #include "v3d_regs.h"
@@ -221,6 +222,10 @@ static int v3d_debugfs_bo_stats(struct seq_file *m, void *unused)
 		   v3d->bo_stats.num_allocated);
 	seq_printf(m, "allocated bo size (kb): %ld\n",
 		   (long)v3d->bo_stats.pages_allocated << (V3D_MMU_PAGE_SHIFT - 10));
+	seq_printf(m, "cached bos:             %d\n",
+		   v3d->bo_cache.num_cached);
+	seq_printf(m, "cached bo size (kb):    %ld\n",
+		   (long)v3d->bo_cache.pages_cached << (PAGE_SHIFT - 10));
 	mutex_unlock(&v3d->bo_lock);
 
 	return 0;
@@ -302,6 +307,25 @@ static int v3d_debugfs_gpu_pid_usage(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static int v3d_debugfs_sched_latency(struct seq_file *m, void *unused)
+{
+	struct drm_debugfs_entry *entry = m->private;
+	struct drm_device *dev = entry->dev;
+	struct v3d_dev *v3d = to_v3d_dev(dev);
+	struct drm_printer p = drm_seq_file_printer(m);
+	enum v3d_queue queue;
+
+	for (queue = 0; queue < V3D_MAX_QUEUES; queue++) {
+		if (!v3d->queue[queue].sched.ready)
+			continue;
+
+		drm_sched_print_stats(&v3d->queue[queue].sched, &p,
+				      v3d_queue_to_string(queue));
+	}
+
+	return 0;
+}
+
 static int v3d_measure_clock(struct seq_file *m, void *unused)
 {
 	struct drm_debugfs_entry *entry = m->private;
@@ -345,6 +369,7 @@ static const struct drm_debugfs_info v3d_debugfs_list[] = {
 	{"bo_stats", v3d_debugfs_bo_stats, 0},
 	{"gpu_usage", v3d_debugfs_gpu_usage, 0},
 	{"gpu_pid_usage", v3d_debugfs_gpu_pid_usage, 0},
+	{"sched_latency", v3d_debugfs_sched_latency, 0},
 };
 
 void
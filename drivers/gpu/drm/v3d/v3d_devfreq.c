@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Load based V3D clock scaling.
+ *
+ * The V3D clock is owned by the firmware, and the firmware clock driver
+ * always runs it at the minimum rate it has been asked for, so scaling
+ * is done by moving the clock's minimum rate between the CPRMAN floor
+ * and the firmware maximum. Utilisation comes from the time any queue
+ * has a job on the hardware.
+ *
+ * Based on lima_devfreq.c.
+ */
+
+#include <linux/clk.h>
+#include <linux/devfreq.h>
+#include <linux/pm_opp.h>
+
+#include "v3d_drv.h"
+
+/* Number of evenly spaced operating points between the floor and max */
+#define V3D_DEVFREQ_STEPS	5
+
+static void v3d_devfreq_update_utilization(struct v3d_dev *v3d)
+{
+	ktime_t now = ktime_get();
+	ktime_t delta = ktime_sub(now, v3d->devfreq.time_last_update);
+
+	if (v3d->devfreq.busy_mask)
+		v3d->devfreq.busy_time = ktime_add(v3d->devfreq.busy_time, delta);
+	else
+		v3d->devfreq.idle_time = ktime_add(v3d->devfreq.idle_time, delta);
+
+	v3d->devfreq.time_last_update = now;
+}
+
+void v3d_devfreq_record_busy(struct v3d_dev *v3d, enum v3d_queue queue)
+{
+	unsigned long irqflags;
+
+	if (!v3d->devfreq.devfreq)
+		return;
+
+	spin_lock_irqsave(&v3d->devfreq.lock, irqflags);
+	v3d_devfreq_update_utilization(v3d);
+	v3d->devfreq.busy_mask |= BIT(queue);
+	spin_unlock_irqrestore(&v3d->devfreq.lock, irqflags);
+}
+
+void v3d_devfreq_record_idle(struct v3d_dev *v3d, enum v3d_queue queue)
+{
+	unsigned long irqflags;
+
+	if (!v3d->devfreq.devfreq)
+		return;
+
+	spin_lock_irqsave(&v3d->devfreq.lock, irqflags);
+	v3d_devfreq_update_utilization(v3d);
+	v3d->devfreq.busy_mask &= ~BIT(queue);
+	spin_unlock_irqrestore(&v3d->devfreq.lock, irqflags);
+}
+
+static int v3d_devfreq_target(struct device *dev, unsigned long *freq,
+			      u32 flags)
+{
+	struct v3d_dev *v3d = to_v3d_dev(dev_get_drvdata(dev));
+	struct dev_pm_opp *opp;
+
+	opp = devfreq_recommended_opp(dev, freq, flags);
+	if (IS_ERR(opp))
+		return PTR_ERR(opp);
+	dev_pm_opp_put(opp);
+
+	return clk_set_min_rate(v3d->clk, *freq);
+}
+
+static int v3d_devfreq_get_dev_status(struct device *dev,
+				      struct devfreq_dev_status *status)
+{
+	struct v3d_dev *v3d = to_v3d_dev(dev_get_drvdata(dev));
+	unsigned long irqflags;
+
+	status->current_frequency = clk_get_rate(v3d->clk);
+
+	spin_lock_irqsave(&v3d->devfreq.lock, irqflags);
+	v3d_devfreq_update_utilization(v3d);
+	status->total_time = ktime_to_ns(ktime_add(v3d->devfreq.busy_time,
+						   v3d->devfreq.idle_time));
+	status->busy_time = ktime_to_ns(v3d->devfreq.busy_time);
+	v3d->devfreq.busy_time = 0;
+	v3d->devfreq.idle_time = 0;
+	spin_unlock_irqrestore(&v3d->devfreq.lock, irqflags);
+
+	return 0;
+}
+
+void v3d_devfreq_fini(struct v3d_dev *v3d)
+{
+	struct device *dev = v3d->drm.dev;
+
+	if (v3d->devfreq.devfreq) {
+		devm_devfreq_remove_device(dev, v3d->devfreq.devfreq);
+		v3d->devfreq.devfreq = NULL;
+	}
+
+	dev_pm_opp_remove_all_dynamic(dev);
+}
+
+/*
+ * Optional: when devfreq or the simple_ondemand governor is unavailable
+ * the driver keeps its fixed up/down clocking.
+ */
+int v3d_devfreq_init(struct v3d_dev *v3d)
+{
+	struct device *dev = v3d->drm.dev;
+	unsigned long rate, min = v3d->clk_down_rate, max = v3d->clk_up_rate;
+	struct devfreq *devfreq;
+	int i, ret;
+
+	if (!max || max <= min)
+		return 0;
+
+	spin_lock_init(&v3d->devfreq.lock);
+	v3d->devfreq.time_last_update = ktime_get();
+
+	for (i = 0; i < V3D_DEVFREQ_STEPS; i++) {
+		rate = min + (max - min) / (V3D_DEVFREQ_STEPS - 1) * i;
+		if (i == V3D_DEVFREQ_STEPS - 1)
+			rate = max;
+
+		ret = dev_pm_opp_add(dev, rate, 0);
+		if (ret)
+			goto err;
+	}
+
+	v3d->devfreq.profile = (struct devfreq_dev_profile) {
+		.timer = DEVFREQ_TIMER_DELAYED,
+		.polling_ms = 50, /* ~3 frames */
+		.initial_freq = min,
+		.target = v3d_devfreq_target,
+		.get_dev_status = v3d_devfreq_get_dev_status,
+	};
+
+	devfreq = devm_devfreq_add_device(dev, &v3d->devfreq.profile,
+					  DEVFREQ_GOV_SIMPLE_ONDEMAND, NULL);
+	if (IS_ERR(devfreq)) {
+		ret = PTR_ERR(devfreq);
+		goto err;
+	}
+
+	v3d->devfreq.devfreq = devfreq;
+
+	return 0;
+
+err:
+	dev_info(dev, "devfreq unavailable (%d), using fixed clocking\n", ret);
+	dev_pm_opp_remove_all_dynamic(dev);
+	return 0;
+}
@@ -20,6 +20,7 @@
 #include <linux/of_platform.h>
 #include <linux/platform_device.h>
 #include <linux/reset.h>
+#include <linux/sched.h>
 
 #include <drm/drm_drv.h>
 #include <drm/drm_managed.h>
@@ -99,31 +100,63 @@ static int v3d_get_param_ioctl(struct drm_device *dev, void *data,
 	}
 }
 
+/* Clients that have been allowed a negative nice value (such as the
+ * display server) get their jobs scheduled ahead of everyone else's,
+ * and clients that have been niced down get scheduled behind.
+ */
+static enum drm_sched_priority
+v3d_client_priority(void)
+{
+	int nice = task_nice(current);
+
+	if (nice < 0)
+		return DRM_SCHED_PRIORITY_HIGH;
+	if (nice > 0)
+		return DRM_SCHED_PRIORITY_MIN;
+	return DRM_SCHED_PRIORITY_NORMAL;
+}
+
 static int
 v3d_open(struct drm_device *dev, struct drm_file *file)
 {
 	struct v3d_dev *v3d = to_v3d_dev(dev);
 	struct v3d_file_priv *v3d_priv;
 	struct drm_gpu_scheduler *sched;
-	int i;
+	int i, ret;
 
 	v3d_priv = kzalloc(sizeof(*v3d_priv), GFP_KERNEL);
 	if (!v3d_priv)
 		return -ENOMEM;
 
 	v3d_priv->v3d = v3d;
+	v3d_priv->priority = v3d_client_priority();
+
+	v3d_priv->stats = v3d_client_stats_create();
+	if (!v3d_priv->stats) {
+		kfree(v3d_priv);
+		return -ENOMEM;
+	}
 
 	for (i = 0; i < V3D_MAX_QUEUES; i++) {
 		sched = &v3d->queue[i].sched;
-		drm_sched_entity_init(&v3d_priv->sched_entity[i],
-				      DRM_SCHED_PRIORITY_NORMAL, &sched,
-				      1, NULL);
+		ret = drm_sched_entity_init(&v3d_priv->sched_entity[i],
+					    v3d_priv->priority, &sched,
+					    1, NULL);
+		if (ret)
+			goto err_entities;
 	}
 
 	v3d_perfmon_open_file(v3d_priv);
 	file->driver_priv = v3d_priv;
 
 	return 0;
+
+err_entities:
+	while (i--)
+		drm_sched_entity_destroy(&v3d_priv->sched_entity[i]);
+	v3d_client_stats_put(v3d_priv->stats);
+	kfree(v3d_priv);
+	return ret;
 }
 
 static void
@@ -136,6 +169,7 @@ v3d_postclose(struct drm_device *dev, struct drm_file *file)
 		drm_sched_entity_destroy(&v3d_priv->sched_entity[q]);
 
 	v3d_perfmon_close_file(v3d_priv);
+	v3d_client_stats_put(v3d_priv->stats);
 	kfree(v3d_priv);
 }
 
@@ -168,6 +202,7 @@ static const struct drm_driver v3d_drm_driver = {
 
 	.open = v3d_open,
 	.postclose = v3d_postclose,
+	.show_fdinfo = v3d_show_fdinfo,
 
 #if defined(CONFIG_DEBUG_FS)
 	.debugfs_init = v3d_debugfs_init,
@@ -311,15 +346,19 @@ static int v3d_platform_drm_probe(struct platform_device *pdev)
 	if (ret)
 		goto gem_destroy;
 
-	ret = drm_dev_register(drm, 0);
-	if (ret)
-		goto irq_disable;
-
 	ret = clk_set_min_rate(v3d->clk, v3d->clk_down_rate);
 	WARN_ON_ONCE(ret != 0);
 
+	v3d_devfreq_init(v3d);
+
+	ret = drm_dev_register(drm, 0);
+	if (ret)
+		goto devfreq_fini;
+
 	return 0;
 
+devfreq_fini:
+	v3d_devfreq_fini(v3d);
 irq_disable:
 	v3d_irq_disable(v3d);
 gem_destroy:
@@ -336,6 +375,7 @@ static void v3d_platform_drm_remove(struct platform_device *pdev)
 
 	drm_dev_unregister(drm);
 
+	v3d_devfreq_fini(v3d);
 	v3d_gem_destroy(drm);
 
 	dma_free_wc(v3d->drm.dev, 4096, v3d->mmu_scratch,
@@ -2,8 +2,11 @@
 /* Copyright (C) 2015-2018 Broadcom */
 
 #include <linux/delay.h>
+#include <linux/devfreq.h>
 #include <linux/mutex.h>
+#include <linux/shrinker.h>
 #include <linux/spinlock_types.h>
+#include <linux/timer.h>
 #include <linux/workqueue.h>
 
 #include <drm/drm_encoder.h>
@@ -135,6 +138,19 @@ struct v3d_dev {
 	u32 clk_refcount;
 	bool clk_up;
 
+	/* Load based clock scaling, replaces clk_up/clk_down when active */
+	struct {
+		struct devfreq *devfreq;
+		struct devfreq_dev_profile profile;
+		/* Protects the fields below, taken from the IRQ handlers */
+		spinlock_t lock;
+		/* Queues with a job currently on the hardware */
+		unsigned long busy_mask;
+		ktime_t busy_time;
+		ktime_t idle_time;
+		ktime_t time_last_update;
+	} devfreq;
+
 	struct reset_control *reset;
 
 	/* Virtual and DMA addresses of the single shared page table. */
@@ -150,6 +166,9 @@ struct v3d_dev {
 	/* virtual address bits from V3D to the MMU. */
 	int va_width;
 
+	/* Set when PTEs have been inserted without flushing the MMU. */
+	atomic_t mmu_flush_pending;
+
 	/* Number of V3D cores. */
 	u32 cores;
 
@@ -173,10 +192,17 @@ struct v3d_dev {
 	 */
 	spinlock_t job_lock;
 
+	/* HW fence of the last high priority bin or render job sent
+	 * to the GPU.  Lower priority bin and CSD jobs wait for it
+	 * before starting.  Protected by urgent_lock.
+	 */
+	struct dma_fence *urgent_fence;
+	spinlock_t urgent_lock;
+
 	/* Used to track the active perfmon if any. */
 	struct v3d_perfmon *active_perfmon;
 
-	/* Protects bo_stats */
+	/* Protects bo_stats and bo_cache */
 	struct mutex bo_lock;
 
 	/* Lock taken when resetting the GPU, to keep multiple
@@ -201,6 +227,32 @@ struct v3d_dev {
 		u32 pages_allocated;
 	} bo_stats;
 
+	/* Cache of freed BOs that are still mapped in the MMU, so that
+	 * transient allocations don't go through shmem and a PTE
+	 * insertion and flush every time.
+	 */
+	struct v3d_bo_cache {
+		/* Array of list heads for entries in the BO cache,
+		 * based on number of pages, so we can do O(1) lookups
+		 * in the cache when allocating.
+		 */
+		struct list_head *size_list;
+		u32 size_list_size;
+
+		/* List of all BOs in the cache, ordered by age, so we
+		 * can do O(1) lookups when trying to free old
+		 * buffers.
+		 */
+		struct list_head time_list;
+		struct work_struct time_work;
+		struct timer_list time_timer;
+
+		struct shrinker shrinker;
+
+		u32 num_cached;
+		u32 pages_cached;
+	} bo_cache;
+
 	struct v3d_queue_stats gpu_queue_stats[V3D_MAX_QUEUES];
 };
 
@@ -218,16 +270,37 @@ v3d_has_csd(struct v3d_dev *v3d)
 
 #define v3d_to_pdev(v3d) to_platform_device((v3d)->drm.dev)
 
+/* GPU time used by the jobs of one fd, reported through fdinfo.  It is
+ * refcounted by the fd and by each of its jobs, since jobs can still be
+ * running on the GPU after the fd has been closed.
+ */
+struct v3d_client_stats {
+	struct kref refcount;
+
+	/* Protects the arrays, which are updated from the IRQ handlers. */
+	spinlock_t lock;
+
+	/* local_clock() when the current job started, or 0 if idle. */
+	u64 start_ns[V3D_MAX_QUEUES];
+	u64 enabled_ns[V3D_MAX_QUEUES];
+	u64 jobs_completed[V3D_MAX_QUEUES];
+};
+
 /* The per-fd struct, which tracks the MMU mappings. */
 struct v3d_file_priv {
 	struct v3d_dev *v3d;
 
+	struct v3d_client_stats *stats;
+
 	struct {
 		struct idr idr;
 		struct mutex lock;
 	} perfmon;
 
 	struct drm_sched_entity sched_entity[V3D_MAX_QUEUES];
+
+	/* Priority of the fd's scheduler entities, set at open. */
+	enum drm_sched_priority priority;
 };
 
 struct v3d_bo {
@@ -236,9 +309,15 @@ struct v3d_bo {
 	struct drm_mm_node node;
 
 	/* List entry for the BO's position in
-	 * v3d_render_job->unref_list
+	 * v3d_render_job->unref_list or v3d_dev->bo_cache.time_list
 	 */
 	struct list_head unref_head;
+
+	/* Time in jiffies when the BO was put in v3d->bo_cache. */
+	unsigned long free_time;
+
+	/* List entry for the BO's position in v3d_dev->bo_cache.size_list */
+	struct list_head size_head;
 };
 
 static inline struct v3d_bo *
@@ -304,6 +383,12 @@ struct v3d_job {
 	 */
 	pid_t client_pid;
 
+	/* Scheduling priority of the fd that submitted the job. */
+	enum drm_sched_priority priority;
+
+	/* GPU time accounting of the fd that submitted the job. */
+	struct v3d_client_stats *client_stats;
+
 	/* Callback for the freeing of the job on refcount going to 0. */
 	void (*free)(struct kref *ref);
 };
@@ -424,6 +509,8 @@ int v3d_mmap_bo_ioctl(struct drm_device *dev, void *data,
 		      struct drm_file *file_priv);
 int v3d_get_bo_offset_ioctl(struct drm_device *dev, void *data,
 			    struct drm_file *file_priv);
+int v3d_bo_cache_init(struct v3d_dev *v3d);
+void v3d_bo_cache_destroy(struct v3d_dev *v3d);
 struct drm_gem_object *v3d_prime_import_sg_table(struct drm_device *dev,
 						 struct dma_buf_attachment *attach,
 						 struct sg_table *sgt);
@@ -431,6 +518,21 @@ struct drm_gem_object *v3d_prime_import_sg_table(struct drm_device *dev,
 /* v3d_debugfs.c */
 void v3d_debugfs_init(struct drm_minor *minor);
 
+/* v3d_devfreq.c */
+#ifdef CONFIG_PM_DEVFREQ
+int v3d_devfreq_init(struct v3d_dev *v3d);
+void v3d_devfreq_fini(struct v3d_dev *v3d);
+void v3d_devfreq_record_busy(struct v3d_dev *v3d, enum v3d_queue queue);
+void v3d_devfreq_record_idle(struct v3d_dev *v3d, enum v3d_queue queue);
+#else
+static inline int v3d_devfreq_init(struct v3d_dev *v3d) { return 0; }
+static inline void v3d_devfreq_fini(struct v3d_dev *v3d) { }
+static inline void v3d_devfreq_record_busy(struct v3d_dev *v3d,
+					   enum v3d_queue queue) { }
+static inline void v3d_devfreq_record_idle(struct v3d_dev *v3d,
+					   enum v3d_queue queue) { }
+#endif
+
 /* v3d_fence.c */
 extern const struct dma_fence_ops v3d_fence_ops;
 struct dma_fence *v3d_fence_create(struct v3d_dev *v3d, enum v3d_queue queue);
@@ -462,13 +564,21 @@ void v3d_irq_reset(struct v3d_dev *v3d);
 int v3d_mmu_get_offset(struct drm_file *file_priv, struct v3d_bo *bo,
 		       u32 *offset);
 int v3d_mmu_set_page_table(struct v3d_dev *v3d);
+void v3d_mmu_flush(struct v3d_dev *v3d);
+void v3d_mmu_flush_deferred(struct v3d_dev *v3d);
 void v3d_mmu_insert_ptes(struct v3d_bo *bo);
+void v3d_mmu_clear_ptes(struct v3d_bo *bo);
 void v3d_mmu_remove_ptes(struct v3d_bo *bo);
 
 /* v3d_sched.c */
 int v3d_sched_init(struct v3d_dev *v3d);
 void v3d_sched_fini(struct v3d_dev *v3d);
 void v3d_sched_stats_update(struct v3d_queue_stats *queue_stats);
+struct v3d_client_stats *v3d_client_stats_create(void);
+void v3d_client_stats_put(struct v3d_client_stats *stats);
+void v3d_job_start_stats(struct v3d_job *job, enum v3d_queue queue);
+void v3d_job_update_stats(struct v3d_job *job, enum v3d_queue queue);
+void v3d_show_fdinfo(struct drm_printer *p, struct drm_file *file);
 
 /* v3d_perfmon.c */
 void v3d_perfmon_get(struct v3d_perfmon *perfmon);
@@ -34,6 +34,10 @@ v3d_clock_down_work(struct work_struct *work)
 static void
 v3d_clock_up_get(struct v3d_dev *v3d)
 {
+	/* devfreq scales the clock from the measured load instead */
+	if (v3d->devfreq.devfreq)
+		return;
+
 	mutex_lock(&v3d->clk_lock);
 	if (v3d->clk_refcount++ == 0) {
 		cancel_delayed_work_sync(&v3d->clk_down_work);
@@ -51,6 +55,9 @@ v3d_clock_up_get(struct v3d_dev *v3d)
 static void
 v3d_clock_up_put(struct v3d_dev *v3d)
 {
+	if (v3d->devfreq.devfreq)
+		return;
+
 	mutex_lock(&v3d->clk_lock);
 	if (--v3d->clk_refcount == 0) {
 		schedule_delayed_work(&v3d->clk_down_work,
@@ -155,6 +162,7 @@ void
 v3d_reset(struct v3d_dev *v3d)
 {
 	struct drm_device *dev = &v3d->drm;
+	enum v3d_queue q;
 
 	DRM_DEV_ERROR(dev->dev, "Resetting GPU for hang.\n");
 	DRM_DEV_ERROR(dev->dev, "V3D_ERR_STAT: 0x%08x\n",
@@ -173,6 +181,10 @@ v3d_reset(struct v3d_dev *v3d)
 
 	v3d_perfmon_stop(v3d, v3d->active_perfmon, false);
 
+	/* Jobs that were on the hardware won't signal completion */
+	for (q = 0; q < V3D_MAX_QUEUES; q++)
+		v3d_devfreq_record_idle(v3d, q);
+
 	trace_v3d_reset_end(dev);
 }
 
@@ -380,6 +392,9 @@ v3d_job_free(struct kref *ref)
 	if (job->perfmon)
 		v3d_perfmon_put(job->perfmon);
 
+	if (job->client_stats)
+		v3d_client_stats_put(job->client_stats);
+
 	kfree(job);
 }
 
@@ -464,6 +479,7 @@ v3d_job_init(struct v3d_dev *v3d, struct drm_file *file_priv,
 	job->v3d = v3d;
 	job->free = free;
 	job->client_pid = current->pid;
+	job->priority = v3d_priv->priority;
 
 	ret = drm_sched_job_init(&job->base, &v3d_priv->sched_entity[queue],
 				 v3d_priv);
@@ -497,6 +513,10 @@ v3d_job_init(struct v3d_dev *v3d, struct drm_file *file_priv,
 			goto fail_deps;
 	}
 
+	/* Dropped by v3d_job_free(), which the failure paths don't use. */
+	job->client_stats = v3d_priv->stats;
+	kref_get(&job->client_stats->refcount);
+
 	v3d_clock_up_get(v3d);
 	kref_init(&job->refcount);
 
@@ -1068,6 +1088,7 @@ v3d_gem_init(struct drm_device *dev)
 
 	spin_lock_init(&v3d->mm_lock);
 	spin_lock_init(&v3d->job_lock);
+	spin_lock_init(&v3d->urgent_lock);
 	ret = drmm_mutex_init(dev, &v3d->bo_lock);
 	if (ret)
 		return ret;
@@ -1104,14 +1125,24 @@ v3d_gem_init(struct drm_device *dev)
 		return -ENOMEM;
 	}
 
+	ret = v3d_bo_cache_init(v3d);
+	if (ret) {
+		drm_mm_takedown(&v3d->mm);
+		dma_free_coherent(v3d->drm.dev, 4096 * 1024, (void *)v3d->pt,
+				  v3d->pt_paddr);
+		return ret;
+	}
+
 	v3d_init_hw_state(v3d);
 	v3d_mmu_set_page_table(v3d);
 
 	ret = v3d_sched_init(v3d);
 	if (ret) {
+		v3d_bo_cache_destroy(v3d);
 		drm_mm_takedown(&v3d->mm);
 		dma_free_coherent(v3d->drm.dev, 4096 * 1024, (void *)v3d->pt,
 				  v3d->pt_paddr);
+		return ret;
 	}
 
 	return 0;
@@ -1130,6 +1161,9 @@ v3d_gem_destroy(struct drm_device *dev)
 	WARN_ON(v3d->bin_job);
 	WARN_ON(v3d->render_job);
 
+	/* The cached BOs still hold their GPU address space. */
+	v3d_bo_cache_destroy(v3d);
+
 	drm_mm_takedown(&v3d->mm);
 
 	dma_free_coherent(v3d->drm.dev, 4096 * 1024, (void *)v3d->pt,
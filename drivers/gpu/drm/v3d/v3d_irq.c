@@ -70,6 +70,11 @@ v3d_overflow_mem_work(struct work_struct *work)
 	list_add_tail(&bo->unref_head, &v3d->bin_job->render->unref_list);
 	spin_unlock_irqrestore(&v3d->job_lock, irqflags);
 
+	/* The binner is already running, so it will use the new
+	 * memory without waiting for the next job's flush.
+	 */
+	v3d_mmu_flush_deferred(v3d);
+
 	V3D_CORE_WRITE(0, V3D_PTB_BPOA, bo->node.start << V3D_MMU_PAGE_SHIFT);
 	V3D_CORE_WRITE(0, V3D_PTB_BPOS, obj->size);
 
@@ -103,6 +108,7 @@ v3d_irq(int irq, void *arg)
 		struct v3d_fence *fence =
 			to_v3d_fence(v3d->bin_job->base.irq_fence);
 		v3d->gpu_queue_stats[V3D_BIN].last_exec_end = local_clock();
+		v3d_job_update_stats(&v3d->bin_job->base, V3D_BIN);
 
 		trace_v3d_bcl_irq(&v3d->drm, fence->seqno);
 		dma_fence_signal(&fence->base);
@@ -113,6 +119,7 @@ v3d_irq(int irq, void *arg)
 		struct v3d_fence *fence =
 			to_v3d_fence(v3d->render_job->base.irq_fence);
 		v3d->gpu_queue_stats[V3D_RENDER].last_exec_end = local_clock();
+		v3d_job_update_stats(&v3d->render_job->base, V3D_RENDER);
 
 		trace_v3d_rcl_irq(&v3d->drm, fence->seqno);
 		dma_fence_signal(&fence->base);
@@ -124,6 +131,7 @@ v3d_irq(int irq, void *arg)
 		struct v3d_fence *fence =
 			to_v3d_fence(v3d->csd_job->base.irq_fence);
 		v3d->gpu_queue_stats[V3D_CSD].last_exec_end = local_clock();
+		v3d_job_update_stats(&v3d->csd_job->base, V3D_CSD);
 
 		trace_v3d_csd_irq(&v3d->drm, fence->seqno);
 		dma_fence_signal(&fence->base);
@@ -161,6 +169,7 @@ v3d_hub_irq(int irq, void *arg)
 		struct v3d_fence *fence =
 			to_v3d_fence(v3d->tfu_job->base.irq_fence);
 		v3d->gpu_queue_stats[V3D_TFU].last_exec_end = local_clock();
+		v3d_job_update_stats(&v3d->tfu_job->base, V3D_TFU);
 
 		trace_v3d_tfu_irq(&v3d->drm, fence->seqno);
 		dma_fence_signal(&fence->base);
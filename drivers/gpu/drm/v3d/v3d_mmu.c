@@ -16,15 +16,25 @@
  * To protect clients from each other, we should use the GMP to
  * quickly mask out (at 128kb granularity) what pages are available to
  * each client.  This is not yet implemented.
+ *
+ * Flushing the TLB stalls the MMU, so after inserting PTEs we only
+ * note that a flush is needed, and do it once before the next job is
+ * handed to the hardware.  A BO's new address can't be used by the
+ * GPU before then.  Removing PTEs still flushes immediately, since the
+ * pages are about to be freed.
+ *
+ * Runs of 64kb of physically contiguous, aligned memory are mapped as
+ * big pages to reduce TLB pressure.
  */
 
 #include "v3d_drv.h"
 #include "v3d_regs.h"
 
-/* Note: All PTEs for the 1MB superpage must be filled with the
- * superpage bit set.
+/* Note: All PTEs for the 1MB superpage or 64kb big page must be
+ * filled with the superpage or big page bit set.
  */
 #define V3D_PTE_SUPERPAGE BIT(31)
+#define V3D_PTE_BIGPAGE BIT(30)
 #define V3D_PTE_WRITEABLE BIT(29)
 #define V3D_PTE_VALID BIT(28)
 
@@ -62,6 +72,25 @@ static int v3d_mmu_flush_all(struct v3d_dev *v3d)
 	return ret;
 }
 
+/* Flushes the MMU, including any flush deferred by PTE insertion. */
+void v3d_mmu_flush(struct v3d_dev *v3d)
+{
+	atomic_set(&v3d->mmu_flush_pending, 0);
+
+	if (v3d_mmu_flush_all(v3d))
+		dev_err(v3d->drm.dev, "MMU flush timeout\n");
+}
+
+/* Called before handing a job to the hardware, to flush any PTEs
+ * inserted since the last flush.
+ */
+void v3d_mmu_flush_deferred(struct v3d_dev *v3d)
+{
+	if (atomic_xchg(&v3d->mmu_flush_pending, 0) &&
+	    v3d_mmu_flush_all(v3d))
+		dev_err(v3d->drm.dev, "MMU flush timeout\n");
+}
+
 int v3d_mmu_set_page_table(struct v3d_dev *v3d)
 {
 	V3D_WRITE(V3D_MMU_PT_PA_BASE, v3d->pt_paddr >> V3D_MMU_PAGE_SHIFT);
@@ -79,37 +108,62 @@ int v3d_mmu_set_page_table(struct v3d_dev *v3d)
 		  V3D_MMU_ILLEGAL_ADDR_ENABLE);
 	V3D_WRITE(V3D_MMUC_CONTROL, V3D_MMUC_CONTROL_ENABLE);
 
+	atomic_set(&v3d->mmu_flush_pending, 0);
+
 	return v3d_mmu_flush_all(v3d);
 }
 
+#define V3D_BIGPAGE_PAGES (SZ_64K >> V3D_MMU_PAGE_SHIFT)
+
 void v3d_mmu_insert_ptes(struct v3d_bo *bo)
 {
 	struct drm_gem_shmem_object *shmem_obj = &bo->base;
 	struct v3d_dev *v3d = to_v3d_dev(shmem_obj->base.dev);
 	u32 page = bo->node.start;
 	u32 page_prot = V3D_PTE_WRITEABLE | V3D_PTE_VALID;
-	struct sg_dma_page_iter dma_iter;
-
-	for_each_sgtable_dma_page(shmem_obj->sgt, &dma_iter, 0) {
-		dma_addr_t dma_addr = sg_page_iter_dma_address(&dma_iter);
-		u32 page_address = dma_addr >> V3D_MMU_PAGE_SHIFT;
-		u32 pte = page_prot | page_address;
-		u32 i;
-
-		BUG_ON(page_address + (PAGE_SIZE >> V3D_MMU_PAGE_SHIFT) >=
-		       BIT(24));
-		for (i = 0; i < PAGE_SIZE >> V3D_MMU_PAGE_SHIFT; i++)
-			v3d->pt[page++] = pte + i;
+	struct scatterlist *sgl;
+	unsigned int count;
+
+	for_each_sgtable_dma_sg(shmem_obj->sgt, sgl, count) {
+		u32 page_address = sg_dma_address(sgl) >> V3D_MMU_PAGE_SHIFT;
+		u32 npages = sg_dma_len(sgl) >> V3D_MMU_PAGE_SHIFT;
+
+		BUG_ON(page_address + npages >= BIT(24));
+
+		while (npages) {
+			u32 pte = page_prot | page_address;
+			u32 i, n = 1;
+
+			/* Both the GPU and bus addresses must be
+			 * aligned to the big page.
+			 */
+			if (npages >= V3D_BIGPAGE_PAGES &&
+			    IS_ALIGNED(page, V3D_BIGPAGE_PAGES) &&
+			    IS_ALIGNED(page_address, V3D_BIGPAGE_PAGES)) {
+				n = V3D_BIGPAGE_PAGES;
+				pte |= V3D_PTE_BIGPAGE;
+			}
+
+			for (i = 0; i < n; i++)
+				v3d->pt[page++] = pte + i;
+
+			page_address += n;
+			npages -= n;
+		}
 	}
 
 	WARN_ON_ONCE(page - bo->node.start !=
 		     shmem_obj->base.size >> V3D_MMU_PAGE_SHIFT);
 
-	if (v3d_mmu_flush_all(v3d))
-		dev_err(v3d->drm.dev, "MMU flush timeout\n");
+	/* Make the PTEs visible before anyone sees the flush request. */
+	wmb();
+	atomic_set(&v3d->mmu_flush_pending, 1);
 }
 
-void v3d_mmu_remove_ptes(struct v3d_bo *bo)
+/* Clears the BO's PTEs without flushing the MMU, so that several BOs
+ * can be unmapped with a single v3d_mmu_flush().
+ */
+void v3d_mmu_clear_ptes(struct v3d_bo *bo)
 {
 	struct v3d_dev *v3d = to_v3d_dev(bo->base.base.dev);
 	u32 npages = bo->base.base.size >> V3D_MMU_PAGE_SHIFT;
@@ -117,7 +171,10 @@ void v3d_mmu_remove_ptes(struct v3d_bo *bo)
 
 	for (page = bo->node.start; page < bo->node.start + npages; page++)
 		v3d->pt[page] = 0;
+}
 
-	if (v3d_mmu_flush_all(v3d))
-		dev_err(v3d->drm.dev, "MMU flush timeout\n");
+void v3d_mmu_remove_ptes(struct v3d_bo *bo)
+{
+	v3d_mmu_clear_ptes(bo);
+	v3d_mmu_flush(to_v3d_dev(bo->base.base.dev));
 }
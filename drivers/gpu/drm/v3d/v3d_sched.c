@@ -16,6 +16,16 @@
  * drm_sched_job_add_dependency() to manage the dependency between bin and
  * render, instead of having the clients submit jobs using the HW's
  * semaphores to interlock between them.
+ *
+ * Each fd's entities get a priority when it is opened (see
+ * v3d_client_priority()).  Within a queue the scheduler picks high
+ * priority entities first, but bin and CSD jobs from other clients
+ * would still compete with a high priority render for the QPUs.  So
+ * while a high priority bin or render job is on the GPU, lower
+ * priority bin and CSD jobs wait for it to complete before starting,
+ * which gives preemption at job boundaries.  Only jobs already on the
+ * hardware are waited for, which can't deadlock against dependencies
+ * between clients.
  */
 
 #include <linux/kthread.h>
@@ -63,6 +73,48 @@ v3d_sched_job_free(struct drm_sched_job *sched_job)
 	v3d_job_cleanup(job);
 }
 
+/* Records a high priority job's HW fence for v3d_sched_job_prepare(). */
+static void
+v3d_sched_set_urgent(struct v3d_job *job, struct dma_fence *fence)
+{
+	struct v3d_dev *v3d = job->v3d;
+	struct dma_fence *old;
+
+	if (job->priority < DRM_SCHED_PRIORITY_HIGH)
+		return;
+
+	spin_lock(&v3d->urgent_lock);
+	old = v3d->urgent_fence;
+	v3d->urgent_fence = dma_fence_get(fence);
+	spin_unlock(&v3d->urgent_lock);
+
+	dma_fence_put(old);
+}
+
+static struct dma_fence *
+v3d_sched_job_prepare(struct drm_sched_job *sched_job,
+		      struct drm_sched_entity *s_entity)
+{
+	struct v3d_job *job = to_v3d_job(sched_job);
+	struct v3d_dev *v3d = job->v3d;
+	struct dma_fence *fence;
+
+	if (job->priority >= DRM_SCHED_PRIORITY_HIGH)
+		return NULL;
+
+	spin_lock(&v3d->urgent_lock);
+	fence = dma_fence_get(v3d->urgent_fence);
+	spin_unlock(&v3d->urgent_lock);
+
+	/* Checked outside urgent_lock since it may take the fence lock. */
+	if (fence && dma_fence_is_signaled(fence)) {
+		dma_fence_put(fence);
+		fence = NULL;
+	}
+
+	return fence;
+}
+
 static void
 v3d_switch_perfmon(struct v3d_dev *v3d, struct v3d_job *job)
 {
@@ -73,6 +125,124 @@ v3d_switch_perfmon(struct v3d_dev *v3d, struct v3d_job *job)
 		v3d_perfmon_start(v3d, job->perfmon);
 }
 
+struct v3d_client_stats *v3d_client_stats_create(void)
+{
+	struct v3d_client_stats *stats;
+
+	stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return NULL;
+
+	kref_init(&stats->refcount);
+	spin_lock_init(&stats->lock);
+
+	return stats;
+}
+
+static void v3d_client_stats_release(struct kref *ref)
+{
+	kfree(container_of(ref, struct v3d_client_stats, refcount));
+}
+
+void v3d_client_stats_put(struct v3d_client_stats *stats)
+{
+	kref_put(&stats->refcount, v3d_client_stats_release);
+}
+
+/* Called just before the job is handed to the hardware. */
+void
+v3d_job_start_stats(struct v3d_job *job, enum v3d_queue queue)
+{
+	struct v3d_client_stats *stats = job->client_stats;
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&stats->lock, irqflags);
+	stats->start_ns[queue] = local_clock();
+	spin_unlock_irqrestore(&stats->lock, irqflags);
+
+	v3d_devfreq_record_busy(job->v3d, queue);
+
+	trace_v3d_job_start(&job->v3d->drm, queue, job->client_pid);
+}
+
+/* Called from the IRQ handlers when the job completes. */
+void
+v3d_job_update_stats(struct v3d_job *job, enum v3d_queue queue)
+{
+	struct v3d_client_stats *stats = job->client_stats;
+	unsigned long irqflags;
+	u64 runtime = 0;
+
+	spin_lock_irqsave(&stats->lock, irqflags);
+	if (stats->start_ns[queue]) {
+		runtime = local_clock() - stats->start_ns[queue];
+		stats->enabled_ns[queue] += runtime;
+		stats->jobs_completed[queue]++;
+		stats->start_ns[queue] = 0;
+	}
+	spin_unlock_irqrestore(&stats->lock, irqflags);
+
+	v3d_devfreq_record_idle(job->v3d, queue);
+
+	trace_v3d_job_end(&job->v3d->drm, queue, job->client_pid, runtime);
+}
+
+/*
+ * Called when the job was lost to a GPU reset, so that fdinfo doesn't keep
+ * counting it as running if it is never resubmitted.
+ */
+static void
+v3d_job_clear_stats(struct v3d_job *job, enum v3d_queue queue)
+{
+	struct v3d_client_stats *stats = job->client_stats;
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&stats->lock, irqflags);
+	stats->start_ns[queue] = 0;
+	spin_unlock_irqrestore(&stats->lock, irqflags);
+}
+
+/*
+ * Reports the GPU time used by the fd per queue, following the DRM
+ * client usage stats format, including any job still running.
+ */
+void
+v3d_show_fdinfo(struct drm_printer *p, struct drm_file *file)
+{
+	struct v3d_file_priv *v3d_priv = file->driver_priv;
+	struct v3d_client_stats *stats = v3d_priv->stats;
+	u64 enabled_ns[V3D_MAX_QUEUES], jobs[V3D_MAX_QUEUES];
+	unsigned long irqflags;
+	enum v3d_queue queue;
+	u64 now;
+
+	spin_lock_irqsave(&stats->lock, irqflags);
+	now = local_clock();
+	for (queue = 0; queue < V3D_MAX_QUEUES; queue++) {
+		enabled_ns[queue] = stats->enabled_ns[queue];
+		if (stats->start_ns[queue])
+			enabled_ns[queue] += now - stats->start_ns[queue];
+		jobs[queue] = stats->jobs_completed[queue];
+	}
+	spin_unlock_irqrestore(&stats->lock, irqflags);
+
+	for (queue = 0; queue < V3D_MAX_QUEUES; queue++) {
+		drm_printf(p, "drm-engine-%s: \t%llu ns\n",
+			   v3d_queue_to_string(queue), enabled_ns[queue]);
+		drm_printf(p, "v3d-jobs-%s: \t%llu jobs\n",
+			   v3d_queue_to_string(queue), jobs[queue]);
+	}
+
+	for (queue = 0; queue < V3D_MAX_QUEUES; queue++) {
+		char prefix[32];
+
+		snprintf(prefix, sizeof(prefix), "v3d-sched-%s",
+			 v3d_queue_to_string(queue));
+		drm_sched_entity_print_stats(&v3d_priv->sched_entity[queue],
+					     p, prefix);
+	}
+}
+
 /*
  * Updates the scheduling stats of the gpu queues runtime for completed jobs.
  *
@@ -203,6 +373,7 @@ static struct dma_fence *v3d_bin_job_run(struct drm_sched_job *sched_job)
 	V3D_CORE_WRITE(0, V3D_PTB_BPOS, 0);
 	spin_unlock_irqrestore(&v3d->job_lock, irqflags);
 
+	v3d_mmu_flush_deferred(v3d);
 	v3d_invalidate_caches(v3d);
 
 	fence = v3d_fence_create(v3d, V3D_BIN);
@@ -216,7 +387,10 @@ static struct dma_fence *v3d_bin_job_run(struct drm_sched_job *sched_job)
 	trace_v3d_submit_cl(dev, false, to_v3d_fence(fence)->seqno,
 			    job->start, job->end);
 
+	v3d_sched_set_urgent(&job->base, fence);
+
 	v3d_sched_stats_add_job(&v3d->gpu_queue_stats[V3D_BIN], sched_job);
+	v3d_job_start_stats(&job->base, V3D_BIN);
 	v3d_switch_perfmon(v3d, &job->base);
 
 	/* Set the current and end address of the control list.
@@ -255,6 +429,7 @@ static struct dma_fence *v3d_render_job_run(struct drm_sched_job *sched_job)
 	 * render0, render1, so that render1's flush at bin time
 	 * wasn't enough.
 	 */
+	v3d_mmu_flush_deferred(v3d);
 	v3d_invalidate_caches(v3d);
 
 	fence = v3d_fence_create(v3d, V3D_RENDER);
@@ -268,7 +443,10 @@ static struct dma_fence *v3d_render_job_run(struct drm_sched_job *sched_job)
 	trace_v3d_submit_cl(dev, true, to_v3d_fence(fence)->seqno,
 			    job->start, job->end);
 
+	v3d_sched_set_urgent(&job->base, fence);
+
 	v3d_sched_stats_add_job(&v3d->gpu_queue_stats[V3D_RENDER], sched_job);
+	v3d_job_start_stats(&job->base, V3D_RENDER);
 	v3d_switch_perfmon(v3d, &job->base);
 
 	/* XXX: Set the QCFG */
@@ -304,6 +482,8 @@ v3d_tfu_job_run(struct drm_sched_job *sched_job)
 	trace_v3d_submit_tfu(dev, to_v3d_fence(fence)->seqno);
 
 	v3d_sched_stats_add_job(&v3d->gpu_queue_stats[V3D_TFU], sched_job);
+	v3d_job_start_stats(&job->base, V3D_TFU);
+	v3d_mmu_flush_deferred(v3d);
 	V3D_WRITE(V3D_TFU_REG(IIA), job->args.iia);
 	V3D_WRITE(V3D_TFU_REG(IIS), job->args.iis);
 	V3D_WRITE(V3D_TFU_REG(ICA), job->args.ica);
@@ -335,6 +515,7 @@ v3d_csd_job_run(struct drm_sched_job *sched_job)
 
 	v3d->csd_job = job;
 
+	v3d_mmu_flush_deferred(v3d);
 	v3d_invalidate_caches(v3d);
 
 	fence = v3d_fence_create(v3d, V3D_CSD);
@@ -348,6 +529,7 @@ v3d_csd_job_run(struct drm_sched_job *sched_job)
 	trace_v3d_submit_csd(dev, to_v3d_fence(fence)->seqno);
 
 	v3d_sched_stats_add_job(&v3d->gpu_queue_stats[V3D_CSD], sched_job);
+	v3d_job_start_stats(&job->base, V3D_CSD);
 	v3d_switch_perfmon(v3d, &job->base);
 
 	csd_cfg0_reg = v3d->ver < 71 ? V3D_CSD_QUEUED_CFG0 : V3D_V7_CSD_QUEUED_CFG0;
@@ -368,8 +550,10 @@ v3d_cache_clean_job_run(struct drm_sched_job *sched_job)
 
 	v3d_sched_stats_add_job(&v3d->gpu_queue_stats[V3D_CACHE_CLEAN],
 				sched_job);
+	v3d_job_start_stats(job, V3D_CACHE_CLEAN);
 	v3d_clean_caches(v3d);
 	v3d->gpu_queue_stats[V3D_CACHE_CLEAN].last_exec_end = local_clock();
+	v3d_job_update_stats(job, V3D_CACHE_CLEAN);
 
 	return NULL;
 }
@@ -385,9 +569,15 @@ v3d_gpu_reset_for_timeout(struct v3d_dev *v3d, struct drm_sched_job *sched_job)
 	for (q = 0; q < V3D_MAX_QUEUES; q++)
 		drm_sched_stop(&v3d->queue[q].sched, sched_job);
 
-	if (sched_job)
+	if (sched_job) {
 		drm_sched_increase_karma(sched_job);
 
+		for (q = 0; q < V3D_MAX_QUEUES; q++) {
+			if (sched_job->sched == &v3d->queue[q].sched)
+				v3d_job_clear_stats(to_v3d_job(sched_job), q);
+		}
+	}
+
 	/* get the GPU back into the init state */
 	v3d_reset(v3d);
 
@@ -473,6 +663,7 @@ v3d_csd_job_timedout(struct drm_sched_job *sched_job)
 }
 
 static const struct drm_sched_backend_ops v3d_bin_sched_ops = {
+	.prepare_job = v3d_sched_job_prepare,
 	.run_job = v3d_bin_job_run,
 	.timedout_job = v3d_bin_job_timedout,
 	.free_job = v3d_sched_job_free,
@@ -491,6 +682,7 @@ static const struct drm_sched_backend_ops v3d_tfu_sched_ops = {
 };
 
 static const struct drm_sched_backend_ops v3d_csd_sched_ops = {
+	.prepare_job = v3d_sched_job_prepare,
 	.run_job = v3d_csd_job_run,
 	.timedout_job = v3d_csd_job_timedout,
 	.free_job = v3d_sched_job_free
@@ -589,4 +781,7 @@ v3d_sched_fini(struct v3d_dev *v3d)
 			drm_sched_fini(&v3d->queue[q].sched);
 		}
 	}
+
+	dma_fence_put(v3d->urgent_fence);
+	v3d->urgent_fence = NULL;
 }
@@ -257,6 +257,68 @@ TRACE_EVENT(v3d_cache_clean_end,
 		      __entry->dev)
 );
 
+TRACE_DEFINE_ENUM(V3D_BIN);
+TRACE_DEFINE_ENUM(V3D_RENDER);
+TRACE_DEFINE_ENUM(V3D_TFU);
+TRACE_DEFINE_ENUM(V3D_CSD);
+TRACE_DEFINE_ENUM(V3D_CACHE_CLEAN);
+
+#define show_v3d_queue(queue)					\
+	__print_symbolic(queue,					\
+			 { V3D_BIN, "bin" },			\
+			 { V3D_RENDER, "render" },		\
+			 { V3D_TFU, "tfu" },			\
+			 { V3D_CSD, "csd" },			\
+			 { V3D_CACHE_CLEAN, "cache_clean" })
+
+TRACE_EVENT(v3d_job_start,
+	    TP_PROTO(struct drm_device *dev, enum v3d_queue queue, pid_t pid),
+	    TP_ARGS(dev, queue, pid),
+
+	    TP_STRUCT__entry(
+			     __field(u32, dev)
+			     __field(u32, queue)
+			     __field(pid_t, pid)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->dev = dev->primary->index;
+			   __entry->queue = queue;
+			   __entry->pid = pid;
+			   ),
+
+	    TP_printk("dev=%u, queue=%s, pid=%d",
+		      __entry->dev,
+		      show_v3d_queue(__entry->queue),
+		      __entry->pid)
+);
+
+TRACE_EVENT(v3d_job_end,
+	    TP_PROTO(struct drm_device *dev, enum v3d_queue queue, pid_t pid,
+		     u64 runtime_ns),
+	    TP_ARGS(dev, queue, pid, runtime_ns),
+
+	    TP_STRUCT__entry(
+			     __field(u32, dev)
+			     __field(u32, queue)
+			     __field(pid_t, pid)
+			     __field(u64, runtime_ns)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->dev = dev->primary->index;
+			   __entry->queue = queue;
+			   __entry->pid = pid;
+			   __entry->runtime_ns = runtime_ns;
+			   ),
+
+	    TP_printk("dev=%u, queue=%s, pid=%d, runtime=%lluns",
+		      __entry->dev,
+		      show_v3d_queue(__entry->queue),
+		      __entry->pid,
+		      __entry->runtime_ns)
+);
+
 TRACE_EVENT(v3d_reset_begin,
 	    TP_PROTO(struct drm_device *dev),
 	    TP_ARGS(dev),
@@ -345,6 +345,11 @@ struct vc4_hvs {
 	 * list.  Units are dwords.
 	 */
 	struct drm_mm dlist_mm;
+	/* Each channel allocates from its own range of dlist_mm
+	 * first, so that channels don't fragment each other's space.
+	 */
+	unsigned int dlist_start;
+	unsigned int dlist_chan_size;
 	/* Memory manager for the LBM memory used by HVS scaling. */
 	struct drm_mm lbm_mm;
 
@@ -1106,6 +1111,7 @@ int vc4_hvs_debugfs_init(struct drm_minor *minor);
 
 /* vc4_kms.c */
 int vc4_kms_load(struct drm_device *dev);
+void vc4_kms_debugfs_init(struct drm_minor *minor);
 
 /* vc4_plane.c */
 struct drm_plane *vc4_plane_init(struct drm_device *dev,
@@ -279,6 +279,13 @@ struct vc4_fkms_crtc {
 	bool vblank_enabled;
 	u32 display_number;
 	u32 display_type;
+
+	/*
+	 * Plane updates of the current commit, sent to the firmware as a
+	 * single property list from the CRTC flush.
+	 */
+	struct mailbox_set_plane plane_mbs[PLANES_PER_CRTC];
+	unsigned int num_plane_mbs;
 };
 
 static inline struct vc4_fkms_crtc *to_vc4_fkms_crtc(struct drm_crtc *crtc)
@@ -381,40 +388,84 @@ static inline struct vc4_fkms_plane *to_vc4_fkms_plane(struct drm_plane *plane)
 	return (struct vc4_fkms_plane *)plane;
 }
 
-static int vc4_plane_set_blank(struct drm_plane *plane, bool blank)
+static void vc4_plane_get_blank_mb(struct drm_plane *plane, bool blank,
+				   struct mailbox_set_plane *mb)
 {
-	struct vc4_dev *vc4 = to_vc4_dev(plane->dev);
 	struct vc4_fkms_plane *vc4_plane = to_vc4_fkms_plane(plane);
-	struct mailbox_set_plane blank_mb = {
-		.tag = { RPI_FIRMWARE_SET_PLANE, sizeof(struct set_plane), 0 },
-		.plane = {
-			.display = vc4_plane->mb.plane.display,
-			.plane_id = vc4_plane->mb.plane.plane_id,
-		}
-	};
 	static const char * const plane_types[] = {
 							"overlay",
 							"primary",
 							"cursor"
 						  };
-	int ret;
 
 	DRM_DEBUG_ATOMIC("[PLANE:%d:%s] %s plane %s",
 			 plane->base.id, plane->name, plane_types[plane->type],
 			 blank ? "blank" : "unblank");
 
-	if (blank)
-		ret = rpi_firmware_property_list(vc4->firmware, &blank_mb,
-						 sizeof(blank_mb));
-	else
-		ret = rpi_firmware_property_list(vc4->firmware, &vc4_plane->mb,
-						 sizeof(vc4_plane->mb));
+	if (blank) {
+		*mb = (struct mailbox_set_plane) {
+			.tag = { RPI_FIRMWARE_SET_PLANE, sizeof(struct set_plane), 0 },
+			.plane = {
+				.display = vc4_plane->mb.plane.display,
+				.plane_id = vc4_plane->mb.plane.plane_id,
+			}
+		};
+	} else {
+		*mb = vc4_plane->mb;
+	}
+}
+
+static int vc4_plane_set_blank(struct drm_plane *plane, bool blank)
+{
+	struct vc4_dev *vc4 = to_vc4_dev(plane->dev);
+	struct mailbox_set_plane mb;
+	int ret;
+
+	vc4_plane_get_blank_mb(plane, blank, &mb);
+
+	ret = rpi_firmware_property_list(vc4->firmware, &mb, sizeof(mb));
 
 	WARN_ONCE(ret, "%s: firmware call failed. Please update your firmware",
 		  __func__);
 	return ret;
 }
 
+/*
+ * Sends all the plane updates queued on the CRTC to the firmware in one
+ * mailbox transaction, instead of waiting for the VPU to answer each
+ * plane in turn.
+ */
+static int vc4_fkms_crtc_flush_planes(struct drm_crtc *crtc)
+{
+	struct vc4_fkms_crtc *vc4_fkms_crtc = to_vc4_fkms_crtc(crtc);
+	struct vc4_dev *vc4 = to_vc4_dev(crtc->dev);
+	int ret;
+
+	if (!vc4_fkms_crtc->num_plane_mbs)
+		return 0;
+
+	ret = rpi_firmware_property_list(vc4->firmware, vc4_fkms_crtc->plane_mbs,
+					 vc4_fkms_crtc->num_plane_mbs *
+					 sizeof(vc4_fkms_crtc->plane_mbs[0]));
+	vc4_fkms_crtc->num_plane_mbs = 0;
+
+	WARN_ONCE(ret, "%s: firmware call failed. Please update your firmware",
+		  __func__);
+	return ret;
+}
+
+static void vc4_plane_queue_blank(struct drm_plane *plane,
+				  struct drm_crtc *crtc, bool blank)
+{
+	struct vc4_fkms_crtc *vc4_fkms_crtc = to_vc4_fkms_crtc(crtc);
+
+	if (vc4_fkms_crtc->num_plane_mbs == ARRAY_SIZE(vc4_fkms_crtc->plane_mbs))
+		vc4_fkms_crtc_flush_planes(crtc);
+
+	vc4_plane_get_blank_mb(plane, blank,
+			       &vc4_fkms_crtc->plane_mbs[vc4_fkms_crtc->num_plane_mbs++]);
+}
+
 static void vc4_fkms_crtc_get_margins(struct drm_crtc_state *state,
 				      unsigned int *left, unsigned int *right,
 				      unsigned int *top, unsigned int *bottom)
@@ -496,18 +547,17 @@ static void vc4_plane_atomic_update(struct drm_plane *plane,
 	struct drm_plane_state *state = plane->state;
 
 	/*
-	 * Do NOT set now, as we haven't checked if the crtc is active or not.
-	 * Set from vc4_plane_set_blank instead.
-	 *
 	 * If the CRTC is on (or going to be on) and we're enabled,
 	 * then unblank.  Otherwise, stay blank until CRTC enable.
+	 *
+	 * Nothing is sent to the firmware here, the update goes out along
+	 * with the other planes of the CRTC in vc4_crtc_atomic_flush().
 	 */
 	if (state->crtc->state->active)
-		vc4_plane_set_blank(plane, false);
+		vc4_plane_queue_blank(plane, state->crtc, false);
 }
 
-static void vc4_plane_atomic_disable(struct drm_plane *plane,
-				     struct drm_atomic_state *old_state)
+static void vc4_plane_disable(struct drm_plane *plane, struct drm_crtc *crtc)
 {
 	struct drm_plane_state *state = plane->state;
 	struct vc4_fkms_plane *vc4_plane = to_vc4_fkms_plane(plane);
@@ -519,7 +569,16 @@ static void vc4_plane_atomic_disable(struct drm_plane *plane,
 			 vc4_plane->mb.plane.vc_image_type,
 			 state->crtc_x,
 			 state->crtc_y);
-	vc4_plane_set_blank(plane, true);
+	vc4_plane_queue_blank(plane, crtc, true);
+}
+
+static void vc4_plane_atomic_disable(struct drm_plane *plane,
+				     struct drm_atomic_state *state)
+{
+	struct drm_plane_state *old_plane_state =
+		drm_atomic_get_old_plane_state(state, plane);
+
+	vc4_plane_disable(plane, old_plane_state->crtc);
 }
 
 static bool plane_enabled(struct drm_plane_state *state)
@@ -1062,7 +1121,8 @@ static void vc4_crtc_disable(struct drm_crtc *crtc,
 	 */
 
 	drm_atomic_crtc_for_each_plane(plane, crtc)
-		vc4_plane_atomic_disable(plane, state);
+		vc4_plane_disable(plane, crtc);
+	vc4_fkms_crtc_flush_planes(crtc);
 
 	/*
 	 * Make sure we issue a vblank event after disabling the CRTC if
@@ -1110,7 +1170,9 @@ static void vc4_crtc_enable(struct drm_crtc *crtc,
 	/* Unblank the planes (if they're supposed to be displayed). */
 	drm_atomic_crtc_for_each_plane(plane, crtc)
 		if (plane->state->fb)
-			vc4_plane_set_blank(plane, plane->state->visible);
+			vc4_plane_queue_blank(plane, crtc,
+					      plane->state->visible);
+	vc4_fkms_crtc_flush_planes(crtc);
 }
 
 static enum drm_mode_status
@@ -1202,6 +1264,8 @@ static void vc4_crtc_atomic_flush(struct drm_crtc *crtc,
 
 	DRM_DEBUG_KMS("[CRTC:%d] crtc_atomic_flush.\n",
 		      crtc->base.id);
+	vc4_fkms_crtc_flush_planes(crtc);
+
 	if (crtc->state->active && old_state->active && crtc->state->event)
 		vc4_crtc_consume_event(crtc);
 }
@@ -695,6 +695,47 @@ static void vc4_hvs_irq_clear_eof(struct vc4_hvs *hvs,
 
 static void vc4_hvs_free_dlist_entry_locked(struct vc4_hvs *hvs,
 					    struct vc4_hvs_dlist_allocation *alloc);
+static void vc4_hvs_dlist_sweep_locked(struct vc4_hvs *hvs);
+
+static int vc4_hvs_insert_dlist_node_locked(struct vc4_hvs *hvs,
+					    struct drm_mm_node *node,
+					    unsigned int channel,
+					    size_t dlist_count)
+{
+	u64 start = hvs->dlist_start + channel * hvs->dlist_chan_size;
+	u64 end = start + hvs->dlist_chan_size;
+	int ret;
+
+	lockdep_assert_held(&hvs->mm_lock);
+
+	if (channel >= HVS_NUM_CHANNELS)
+		return drm_mm_insert_node(&hvs->dlist_mm, node, dlist_count);
+
+	/*
+	 * Allocate from the channel's own range first. In a steady
+	 * state it only ever holds the list being scanned out, the one
+	 * pending for the next frame and the new one, so flipping on
+	 * one channel can't fragment the space used by the others.
+	 */
+	ret = drm_mm_insert_node_in_range(&hvs->dlist_mm, node, dlist_count,
+					  0, 0, start, end, DRM_MM_INSERT_BEST);
+	if (!ret)
+		return 0;
+
+	/*
+	 * Reclaim whatever the hardware is done with now rather than
+	 * depending on when the sweep work last ran, and retry before
+	 * falling back to the whole dlist memory.
+	 */
+	vc4_hvs_dlist_sweep_locked(hvs);
+
+	ret = drm_mm_insert_node_in_range(&hvs->dlist_mm, node, dlist_count,
+					  0, 0, start, end, DRM_MM_INSERT_BEST);
+	if (ret)
+		ret = drm_mm_insert_node(&hvs->dlist_mm, node, dlist_count);
+
+	return ret;
+}
 
 static struct vc4_hvs_dlist_allocation *
 vc4_hvs_alloc_dlist_entry(struct vc4_hvs *hvs,
@@ -718,8 +759,8 @@ vc4_hvs_alloc_dlist_entry(struct vc4_hvs *hvs,
 	INIT_LIST_HEAD(&alloc->node);
 
 	spin_lock_irqsave(&hvs->mm_lock, flags);
-	ret = drm_mm_insert_node(&hvs->dlist_mm, &alloc->mm_node,
-				 dlist_count);
+	ret = vc4_hvs_insert_dlist_node_locked(hvs, &alloc->mm_node, channel,
+					       dlist_count);
 	spin_unlock_irqrestore(&hvs->mm_lock, flags);
 	if (ret) {
 		drm_err(dev, "Failed to allocate DLIST entry. Requested size=%zu. ret=%d. DISPCTRL is %08x\n",
@@ -871,17 +912,18 @@ bool vc4_hvs_check_channel_active(struct vc4_hvs *hvs, unsigned int fifo)
  * entry will no longer be used, and thus will only free those entries
  * when we will have reached that frame count.
  */
-static void vc4_hvs_dlist_free_work(struct work_struct *work)
+static void vc4_hvs_dlist_sweep_locked(struct vc4_hvs *hvs)
 {
-	struct vc4_hvs *hvs = container_of(work, struct vc4_hvs, free_dlist_work);
 	struct vc4_hvs_dlist_allocation *cur, *next;
-	unsigned long flags;
 	bool active[3];
 	u8 frcnt[3];
 	int i;
 
+	lockdep_assert_held(&hvs->mm_lock);
+
+	if (list_empty(&hvs->stale_dlist_entries))
+		return;
 
-	spin_lock_irqsave(&hvs->mm_lock, flags);
 	for (i = 0; i < 3; i++) {
 		frcnt[i] = vc4_hvs_get_fifo_frame_count(hvs, i);
 		active[i] = vc4_hvs_check_channel_active(hvs, i);
@@ -893,6 +935,15 @@ static void vc4_hvs_dlist_free_work(struct work_struct *work)
 
 		vc4_hvs_free_dlist_entry_locked(hvs, cur);
 	}
+}
+
+static void vc4_hvs_dlist_free_work(struct work_struct *work)
+{
+	struct vc4_hvs *hvs = container_of(work, struct vc4_hvs, free_dlist_work);
+	unsigned long flags;
+
+	spin_lock_irqsave(&hvs->mm_lock, flags);
+	vc4_hvs_dlist_sweep_locked(hvs);
 	spin_unlock_irqrestore(&hvs->mm_lock, flags);
 }
 
@@ -1800,6 +1851,8 @@ struct vc4_hvs *__vc4_hvs_alloc(struct vc4_dev *vc4,
 	drm_mm_init(&hvs->dlist_mm, dlist_start, dlist_size);
 
 	hvs->dlist_mem_size = dlist_size;
+	hvs->dlist_start = dlist_start;
+	hvs->dlist_chan_size = dlist_size / HVS_NUM_CHANNELS;
 
 	/* Set up the HVS LBM memory manager.  We could have some more
 	 * complicated data structure that allowed reuse of LBM areas
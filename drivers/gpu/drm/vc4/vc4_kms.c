@@ -12,11 +12,13 @@
  */
 
 #include <linux/clk.h>
+#include <linux/seq_file.h>
 #include <linux/sort.h>
 
 #include <drm/drm_atomic.h>
 #include <drm/drm_atomic_helper.h>
 #include <drm/drm_crtc.h>
+#include <drm/drm_drv.h>
 #include <drm/drm_fourcc.h>
 #include <drm/drm_gem_framebuffer_helper.h>
 #include <drm/drm_probe_helper.h>
@@ -43,6 +45,16 @@ struct vc4_load_tracker_state {
 #define to_vc4_load_tracker_state(_state)				\
 	container_of_const(_state, struct vc4_load_tracker_state, base)
 
+/* The absolute limit is 2Gbyte/sec, but let's take a margin to let
+ * the system work when other blocks are accessing the memory.
+ */
+#define VC4_MEMBUS_LOAD_LIMIT		(SZ_1G + SZ_512M)
+
+/* HVS clock is supposed to run @ 250Mhz, let's take a margin and
+ * consider the maximum number of cycles is 240M.
+ */
+#define VC4_HVS_LOAD_LIMIT		240000000ULL
+
 static struct vc4_ctm_state *vc4_get_ctm_state(struct drm_atomic_state *state,
 					       struct drm_private_obj *manager)
 {
@@ -692,16 +704,10 @@ static int vc4_load_tracker_atomic_check(struct drm_atomic_state *state)
 	if (!vc4->load_tracker_enabled)
 		return 0;
 
-	/* The absolute limit is 2Gbyte/sec, but let's take a margin to let
-	 * the system work when other blocks are accessing the memory.
-	 */
-	if (load_state->membus_load > SZ_1G + SZ_512M)
+	if (load_state->membus_load > VC4_MEMBUS_LOAD_LIMIT)
 		return -ENOSPC;
 
-	/* HVS clock is supposed to run @ 250Mhz, let's take a margin and
-	 * consider the maximum number of cycles is 240M.
-	 */
-	if (load_state->hvs_load > 240000000ULL)
+	if (load_state->hvs_load > VC4_HVS_LOAD_LIMIT)
 		return -ENOSPC;
 
 	return 0;
@@ -730,11 +736,98 @@ static void vc4_load_tracker_destroy_state(struct drm_private_obj *obj,
 	kfree(load_state);
 }
 
+static void vc4_load_tracker_print_state(struct drm_printer *p,
+					 const struct drm_private_state *state)
+{
+	const struct vc4_load_tracker_state *load_state =
+		to_vc4_load_tracker_state(state);
+
+	drm_printf(p, "Load Tracker State\n");
+	drm_printf(p, "\tHVS load=%llu\n", load_state->hvs_load);
+	drm_printf(p, "\tMembus load=%llu\n", load_state->membus_load);
+}
+
 static const struct drm_private_state_funcs vc4_load_tracker_state_funcs = {
 	.atomic_duplicate_state = vc4_load_tracker_duplicate_state,
 	.atomic_destroy_state = vc4_load_tracker_destroy_state,
+	.atomic_print_state = vc4_load_tracker_print_state,
 };
 
+static void vc4_load_print_headroom(struct drm_printer *p, const char *name,
+				    u64 load, u64 limit)
+{
+	drm_printf(p, "\t%s: load=%llu limit=%llu headroom=%llu\n",
+		   name, load, limit, load < limit ? limit - load : 0);
+}
+
+/*
+ * Reports the load of the currently committed state, both in total and
+ * for each CRTC, along with the limits the load tracker checks new
+ * commits against. This lets a compositor estimate up front whether
+ * another plane will fit rather than probing with TEST_ONLY commits.
+ */
+static int vc4_load_tracker_debugfs(struct seq_file *m, void *data)
+{
+	struct drm_debugfs_entry *entry = m->private;
+	struct drm_device *drm = entry->dev;
+	struct vc4_dev *vc4 = to_vc4_dev(drm);
+	struct drm_printer p = drm_seq_file_printer(m);
+	const struct vc4_load_tracker_state *load_state;
+	const struct vc4_hvs_state *hvs_state;
+	struct drm_crtc *crtc;
+
+	drm_modeset_lock_all(drm);
+
+	load_state = to_vc4_load_tracker_state(vc4->load_tracker.state);
+	hvs_state = to_vc4_hvs_state(vc4->hvs_channels.state);
+
+	drm_printf(&p, "Load tracker %s\n",
+		   vc4->load_tracker_enabled ? "enabled" : "disabled");
+	vc4_load_print_headroom(&p, "HVS", load_state->hvs_load,
+				VC4_HVS_LOAD_LIMIT);
+	vc4_load_print_headroom(&p, "Membus", load_state->membus_load,
+				VC4_MEMBUS_LOAD_LIMIT);
+	drm_printf(&p, "\tcore clock rate=%lu\n", hvs_state->core_clock_rate);
+
+	drm_for_each_crtc(crtc, drm) {
+		const struct vc4_crtc_state *vc4_crtc_state =
+			to_vc4_crtc_state(crtc->state);
+		u64 hvs_load = 0, membus_load = 0;
+		struct drm_plane *plane;
+
+		drm_for_each_plane_mask(plane, drm, crtc->state->plane_mask) {
+			const struct vc4_plane_state *vc4_plane_state =
+				to_vc4_plane_state(plane->state);
+
+			if (!plane->state->fb)
+				continue;
+
+			hvs_load += vc4_plane_state->hvs_load;
+			membus_load += vc4_plane_state->membus_load;
+		}
+
+		drm_printf(&p, "[CRTC:%d:%s]\n", crtc->base.id, crtc->name);
+		drm_printf(&p, "\tactive=%d\n", crtc->state->active);
+		if (crtc->state->active)
+			drm_printf(&p, "\tchannel=%u fifo load=%lu\n",
+				   vc4_crtc_state->assigned_channel,
+				   vc4_crtc_state->hvs_load);
+		drm_printf(&p, "\tplanes HVS load=%llu\n", hvs_load);
+		drm_printf(&p, "\tplanes membus load=%llu\n", membus_load);
+	}
+
+	drm_modeset_unlock_all(drm);
+
+	return 0;
+}
+
+void vc4_kms_debugfs_init(struct drm_minor *minor)
+{
+	struct drm_device *drm = minor->dev;
+
+	drm_debugfs_add_file(drm, "hvs_load", vc4_load_tracker_debugfs, NULL);
+}
+
 static void vc4_load_tracker_obj_fini(struct drm_device *dev, void *unused)
 {
 	struct vc4_dev *vc4 = to_vc4_dev(dev);
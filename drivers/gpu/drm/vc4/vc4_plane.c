@@ -2007,6 +2007,138 @@ static int vc6_plane_mode_set(struct drm_plane *plane,
 	return 0;
 }
 
+/*
+ * Checks whether anything that goes into the plane's dlist, other than
+ * the framebuffer memory itself, differs between the two states.
+ */
+static bool vc4_plane_only_fb_changed(struct drm_plane_state *old_state,
+				      struct drm_plane_state *new_state)
+{
+	struct drm_framebuffer *old_fb = old_state->fb;
+	struct drm_framebuffer *new_fb = new_state->fb;
+	struct drm_crtc_state *old_crtc_state, *new_crtc_state;
+	struct vc4_crtc_state *old_vc4_crtc_state;
+	unsigned int left, right, top, bottom;
+	unsigned int i;
+
+	if (!old_fb || !new_fb || old_state->crtc != new_state->crtc)
+		return false;
+
+	if (old_fb->format != new_fb->format ||
+	    old_fb->modifier != new_fb->modifier ||
+	    old_fb->width != new_fb->width ||
+	    old_fb->height != new_fb->height)
+		return false;
+
+	for (i = 0; i < new_fb->format->num_planes; i++) {
+		if (old_fb->pitches[i] != new_fb->pitches[i] ||
+		    old_fb->offsets[i] != new_fb->offsets[i])
+			return false;
+	}
+
+	if (old_state->src_x != new_state->src_x ||
+	    old_state->src_y != new_state->src_y ||
+	    old_state->src_w != new_state->src_w ||
+	    old_state->src_h != new_state->src_h ||
+	    old_state->crtc_x != new_state->crtc_x ||
+	    old_state->crtc_y != new_state->crtc_y ||
+	    old_state->crtc_w != new_state->crtc_w ||
+	    old_state->crtc_h != new_state->crtc_h ||
+	    old_state->rotation != new_state->rotation ||
+	    old_state->alpha != new_state->alpha ||
+	    old_state->pixel_blend_mode != new_state->pixel_blend_mode ||
+	    old_state->color_encoding != new_state->color_encoding ||
+	    old_state->color_range != new_state->color_range ||
+	    old_state->chroma_siting_h != new_state->chroma_siting_h ||
+	    old_state->chroma_siting_v != new_state->chroma_siting_v)
+		return false;
+
+	/* The CRTC mode and margins go into the plane's position. */
+	old_crtc_state = drm_atomic_get_old_crtc_state(new_state->state,
+						       new_state->crtc);
+	new_crtc_state = drm_atomic_get_new_crtc_state(new_state->state,
+						       new_state->crtc);
+	if (!old_crtc_state || !new_crtc_state ||
+	    drm_atomic_crtc_needs_modeset(new_crtc_state))
+		return false;
+
+	old_vc4_crtc_state = to_vc4_crtc_state(old_crtc_state);
+	vc4_crtc_get_margins(new_crtc_state, &left, &right, &top, &bottom);
+
+	return left == old_vc4_crtc_state->margins.left &&
+	       right == old_vc4_crtc_state->margins.right &&
+	       top == old_vc4_crtc_state->margins.top &&
+	       bottom == old_vc4_crtc_state->margins.bottom;
+}
+
+/*
+ * A plane that only flips to a new framebuffer of the same layout can
+ * keep the dlist duplicated from the previous state, with just the
+ * scan-out addresses moved to the new buffers, rather than redoing the
+ * scaling, coefficient and load computations in the mode_set functions.
+ */
+static bool vc4_plane_update_fb_only(struct drm_plane *plane,
+				     struct drm_plane_state *new_state)
+{
+	struct vc4_dev *vc4 = to_vc4_dev(plane->dev);
+	struct vc4_plane_state *vc4_state = to_vc4_plane_state(new_state);
+	struct drm_plane_state *old_state;
+	struct drm_framebuffer *old_fb, *new_fb;
+	unsigned int i;
+
+	old_state = drm_atomic_get_old_plane_state(new_state->state, plane);
+	if (!old_state || !plane_enabled(old_state))
+		return false;
+
+	/*
+	 * The dlist must have been fully built for the old state, which
+	 * vc4_plane_duplicate_state() copied for us.
+	 */
+	if (!vc4_state->dlist || !vc4_state->dlist_size ||
+	    vc4_state->dlist_size != to_vc4_plane_state(old_state)->dlist_count)
+		return false;
+
+	if (!vc4_plane_only_fb_changed(old_state, new_state))
+		return false;
+
+	old_fb = old_state->fb;
+	new_fb = new_state->fb;
+
+	for (i = 0; i < new_fb->format->num_planes; i++) {
+		dma_addr_t old_base = drm_fb_dma_get_gem_obj(old_fb, i)->dma_addr;
+		dma_addr_t new_base = drm_fb_dma_get_gem_obj(new_fb, i)->dma_addr;
+
+		if (vc4->gen >= VC4_GEN_6) {
+			u32 *ptr = &vc4_state->dlist[vc4_state->ptr0_offset[i]];
+			u64 addr;
+
+			addr = ((u64)VC4_GET_FIELD(ptr[0], SCALER6_PTR0_UPPER_ADDR) << 32) |
+			       ptr[1];
+			addr = addr - old_base + new_base;
+
+			/* The UPM fields are filled in again by
+			 * vc6_plane_allocate_upm().
+			 */
+			ptr[0] &= ~(SCALER6_PTR0_UPPER_ADDR_MASK |
+				    SCALER6_PTR0_UPM_BASE_MASK |
+				    SCALER6_PTR0_UPM_HANDLE_MASK |
+				    SCALER6_PTR0_UPM_BUFF_SIZE_MASK);
+			ptr[0] |= VC4_SET_FIELD(upper_32_bits(addr) & 0xff,
+						SCALER6_PTR0_UPPER_ADDR);
+			ptr[1] = lower_32_bits(addr);
+		} else {
+			u32 *ptr = &vc4_state->dlist[vc4_state->ptr0_offset[0] + i];
+
+			*ptr = *ptr - old_base + new_base;
+		}
+	}
+
+	vc4_state->dlist_count = vc4_state->dlist_size;
+	vc4_state->dlist_initialized = 1;
+
+	return true;
+}
+
 /* If a modeset involves changing the setup of a plane, the atomic
  * infrastructure will call this to validate a proposed plane setup.
  * However, if a plane isn't getting updated, this (and the
@@ -2028,6 +2160,9 @@ int vc4_plane_atomic_check(struct drm_plane *plane,
 	if (!plane_enabled(new_plane_state))
 		return 0;
 
+	if (!vc4_state->dlist_initialized)
+		vc4_plane_update_fb_only(plane, new_plane_state);
+
 	if (vc4->gen >= VC4_GEN_6)
 		ret = vc6_plane_mode_set(plane, new_plane_state);
 	else
@@ -283,6 +283,16 @@ static int vc4_txp_connector_atomic_check(struct drm_connector *conn,
 	return 0;
 }
 
+/*
+ * The TXP has a single set of destination registers and no way of
+ * queueing a second frame, so only one writeback job is ever in flight.
+ * The CRTC event is held back until the frame-done interrupt (see
+ * vc4_hvs_update_dlist()), which keeps the next commit, and with it the
+ * next job, waiting in drm_atomic_helper_wait_for_dependencies() until
+ * this one has been signalled. That ordering is also what keeps the
+ * source planes' buffers alive until the HVS has finished reading them,
+ * so it must not be relaxed to let userspace queue jobs ahead.
+ */
 static void vc4_txp_connector_atomic_commit(struct drm_connector *conn,
 					struct drm_atomic_state *state)
 {
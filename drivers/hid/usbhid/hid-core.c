@@ -68,6 +68,14 @@ MODULE_PARM_DESC(quirks, "Add/modify USB HID quirks by specifying "
 		" quirks=vendorID:productID:quirks"
 		" where vendorID, productID, and quirks are all in"
 		" 0x-prefixed hex");
+
+/* Per-device polling intervals specified at module load time */
+static char *poll_param[MAX_USBHID_BOOT_QUIRKS];
+module_param_array_named(poll, poll_param, charp, NULL, 0444);
+MODULE_PARM_DESC(poll, "Override the polling interval of a device by "
+		" specifying poll=vendorID:productID:interval"
+		" where vendorID and productID are 0x-prefixed hex and"
+		" interval is in bInterval units, as for mousepoll");
 /*
  * Input submission and I/O error handler.
  */
@@ -1057,6 +1065,31 @@ static int usbhid_parse(struct hid_device *hid)
 	return ret;
 }
 
+static int usbhid_poll_interval(struct hid_device *hid, int interval)
+{
+	unsigned short vendor, product;
+	unsigned int override;
+	int n;
+
+	for (n = 0; n < MAX_USBHID_BOOT_QUIRKS && poll_param[n]; n++) {
+		if (sscanf(poll_param[n], "0x%hx:0x%hx:%u",
+			   &vendor, &product, &override) != 3)
+			continue;
+
+		if (vendor != hid->vendor || product != hid->product)
+			continue;
+
+		if (!override || override > 255)
+			break;
+
+		hid_info(hid, "polling interval %d overridden to %u\n",
+			 interval, override);
+		return override;
+	}
+
+	return interval;
+}
+
 static int usbhid_start(struct hid_device *hid)
 {
 	struct usb_interface *intf = to_usb_interface(hid->dev.parent);
@@ -1126,6 +1159,9 @@ static int usbhid_start(struct hid_device *hid)
 				interval = hid_kbpoll_interval;
 			break;
 		}
+
+		/* A per-device override wins over the per-class ones */
+		interval = usbhid_poll_interval(hid, interval);
 		usb_fixup_endpoint(dev, endpoint->bEndpointAddress, interval);
 
 		ret = -ENOMEM;
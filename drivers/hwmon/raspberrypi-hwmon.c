@@ -6,28 +6,72 @@
  *
  * Copyright (C) 2018 Stefan Wahren <stefan.wahren@i2se.com>
  */
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/devm-helpers.h>
 #include <linux/err.h>
 #include <linux/hwmon.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
 #include <soc/bcm2835/raspberrypi-firmware.h>
 
 #define UNDERVOLTAGE_STICKY_BIT	BIT(16)
 
+/* Current state bits of RPI_FIRMWARE_GET_THROTTLED */
+#define RPI_THROTTLE_UNDERVOLTAGE	0
+#define RPI_THROTTLE_FREQ_CAPPED	1
+#define RPI_THROTTLE_THROTTLED		2
+#define RPI_THROTTLE_SOFT_TEMP_LIMIT	3
+#define RPI_THROTTLE_NUM_STATES		4
+#define RPI_THROTTLE_STATE_MASK		GENMASK(RPI_THROTTLE_NUM_STATES - 1, 0)
+
+/*
+ * We can't run faster than the sticky shift (100ms) since we get
+ * flipping in the sticky bits that are cleared. While a condition is
+ * active poll faster so that its end is seen promptly and the residency
+ * counters stay accurate.
+ */
+#define RPI_HWMON_POLL_IDLE	(2 * HZ)
+#define RPI_HWMON_POLL_ACTIVE	msecs_to_jiffies(250)
+
 struct rpi_hwmon_data {
 	struct device *hwmon_dev;
 	struct rpi_firmware *fw;
 	u32 last_throttled;
 	struct delayed_work get_values_poll_work;
+
+	/* Protects the residency accounting below */
+	struct mutex lock;
+	ktime_t last_poll;
+	u64 residency_ms[RPI_THROTTLE_NUM_STATES];
 };
 
+static void rpi_hwmon_account(struct rpi_hwmon_data *data, u32 value)
+{
+	ktime_t now = ktime_get();
+	u64 delta_ms;
+	int i;
+
+	mutex_lock(&data->lock);
+	if (data->last_poll) {
+		delta_ms = ktime_ms_delta(now, data->last_poll);
+		for (i = 0; i < RPI_THROTTLE_NUM_STATES; i++)
+			if (data->last_throttled & BIT(i))
+				data->residency_ms[i] += delta_ms;
+	}
+	data->last_poll = now;
+	data->last_throttled = value;
+	mutex_unlock(&data->lock);
+}
+
 static void rpi_firmware_get_throttled(struct rpi_hwmon_data *data)
 {
-	u32 new_uv, old_uv, value;
+	u32 new_uv, old_uv, old, value;
 	int ret;
 
 	/* Request firmware to clear sticky bits */
@@ -41,9 +85,15 @@ static void rpi_firmware_get_throttled(struct rpi_hwmon_data *data)
 		return;
 	}
 
+	old = data->last_throttled;
+	rpi_hwmon_account(data, value);
+
 	new_uv = value & UNDERVOLTAGE_STICKY_BIT;
-	old_uv = data->last_throttled & UNDERVOLTAGE_STICKY_BIT;
-	data->last_throttled = value;
+	old_uv = old & UNDERVOLTAGE_STICKY_BIT;
+
+	if ((value ^ old) & BIT(RPI_THROTTLE_SOFT_TEMP_LIMIT))
+		hwmon_notify_event(data->hwmon_dev, hwmon_temp,
+				   hwmon_temp_max_alarm, 0);
 
 	if (new_uv == old_uv)
 		return;
@@ -65,19 +115,70 @@ static void get_values_poll(struct work_struct *work)
 
 	rpi_firmware_get_throttled(data);
 
-	/*
-	 * We can't run faster than the sticky shift (100ms) since we get
-	 * flipping in the sticky bits that are cleared.
-	 */
-	schedule_delayed_work(&data->get_values_poll_work, 2 * HZ);
+	schedule_delayed_work(&data->get_values_poll_work,
+			      data->last_throttled & RPI_THROTTLE_STATE_MASK ?
+			      RPI_HWMON_POLL_ACTIVE : RPI_HWMON_POLL_IDLE);
+}
+
+/*
+ * The firmware's view of throttling has no place in the hwmon ABI beyond
+ * the alarms, so the raw state and the time spent in each state are only
+ * made available through debugfs.
+ */
+static int rpi_hwmon_throttle_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[RPI_THROTTLE_NUM_STATES] = {
+		[RPI_THROTTLE_UNDERVOLTAGE] = "undervoltage",
+		[RPI_THROTTLE_FREQ_CAPPED] = "freq_capped",
+		[RPI_THROTTLE_THROTTLED] = "throttled",
+		[RPI_THROTTLE_SOFT_TEMP_LIMIT] = "soft_temp_limit",
+	};
+	struct rpi_hwmon_data *data = s->private;
+	u64 delta_ms = 0;
+	int i;
+
+	mutex_lock(&data->lock);
+	seq_printf(s, "state: 0x%x\n", data->last_throttled);
+	/* Include the time since the last poll for states still active */
+	if (data->last_poll)
+		delta_ms = ktime_ms_delta(ktime_get(), data->last_poll);
+	for (i = 0; i < RPI_THROTTLE_NUM_STATES; i++)
+		seq_printf(s, "%s_ms: %llu\n", names[i],
+			   data->residency_ms[i] +
+			   (data->last_throttled & BIT(i) ? delta_ms : 0));
+	mutex_unlock(&data->lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(rpi_hwmon_throttle);
+
+static void rpi_hwmon_debugfs_remove(void *data)
+{
+	debugfs_remove_recursive(data);
+}
+
+static int rpi_hwmon_init_debugfs(struct device *dev,
+				  struct rpi_hwmon_data *data)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir(dev_name(data->hwmon_dev), NULL);
+	debugfs_create_file("throttle", 0444, dir, data,
+			    &rpi_hwmon_throttle_fops);
+
+	return devm_add_action_or_reset(dev, rpi_hwmon_debugfs_remove, dir);
 }
 
 static int rpi_read(struct device *dev, enum hwmon_sensor_types type,
 		    u32 attr, int channel, long *val)
 {
 	struct rpi_hwmon_data *data = dev_get_drvdata(dev);
+	u32 throttled = READ_ONCE(data->last_throttled);
 
-	*val = !!(data->last_throttled & UNDERVOLTAGE_STICKY_BIT);
+	if (type == hwmon_temp)
+		*val = !!(throttled & BIT(RPI_THROTTLE_SOFT_TEMP_LIMIT));
+	else
+		*val = !!(throttled & UNDERVOLTAGE_STICKY_BIT);
 	return 0;
 }
 
@@ -90,6 +191,8 @@ static umode_t rpi_is_visible(const void *_data, enum hwmon_sensor_types type,
 static const struct hwmon_channel_info * const rpi_info[] = {
 	HWMON_CHANNEL_INFO(in,
 			   HWMON_I_LCRIT_ALARM),
+	HWMON_CHANNEL_INFO(temp,
+			   HWMON_T_MAX_ALARM),
 	NULL
 };
 
@@ -115,6 +218,7 @@ static int rpi_hwmon_probe(struct platform_device *pdev)
 
 	/* Parent driver assure that firmware is correct */
 	data->fw = dev_get_drvdata(dev->parent);
+	mutex_init(&data->lock);
 
 	data->hwmon_dev = devm_hwmon_device_register_with_info(dev, "rpi_volt",
 							       data,
@@ -123,13 +227,17 @@ static int rpi_hwmon_probe(struct platform_device *pdev)
 	if (IS_ERR(data->hwmon_dev))
 		return PTR_ERR(data->hwmon_dev);
 
+	ret = rpi_hwmon_init_debugfs(dev, data);
+	if (ret)
+		return ret;
+
 	ret = devm_delayed_work_autocancel(dev, &data->get_values_poll_work,
 					   get_values_poll);
 	if (ret)
 		return ret;
 	platform_set_drvdata(pdev, data);
 
-	schedule_delayed_work(&data->get_values_poll_work, 2 * HZ);
+	schedule_delayed_work(&data->get_values_poll_work, RPI_HWMON_POLL_IDLE);
 
 	return 0;
 }
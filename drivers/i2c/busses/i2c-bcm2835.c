@@ -11,6 +11,7 @@
 #include <linux/i2c.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
@@ -56,6 +57,10 @@
 #define BCM2835_I2C_CDIV_MIN	0x0002
 #define BCM2835_I2C_CDIV_MAX	0xFFFE
 
+#define BCM2835_I2C_FIFO_SIZE	16
+/* time for a transfer to become active, i.e. to send the start condition */
+#define BCM2835_I2C_TA_TIMEOUT_US	1000
+
 static unsigned int debug;
 module_param(debug, uint, 0644);
 MODULE_PARM_DESC(debug, "1=err, 2=isr, 3=xfer");
@@ -328,7 +333,10 @@ static void bcm2835_drain_rxfifo(struct bcm2835_i2c_dev *i2c_dev)
  * firmware actually does it using polling and says that it's a workaround for
  * a problem in the state machine.
  * It turns out that it is possible to use the TXW interrupt to know when the
- * transfer is active, provided the FIFO has not been prefilled.
+ * transfer is active, provided the FIFO has not been prefilled. That is what
+ * the general path below does. A write short enough to prefill, followed by
+ * a read, instead polls TA like the firmware, see
+ * bcm2835_i2c_start_write_read().
  */
 
 static void bcm2835_i2c_start_transfer(struct bcm2835_i2c_dev *i2c_dev)
@@ -358,6 +366,66 @@ static void bcm2835_i2c_start_transfer(struct bcm2835_i2c_dev *i2c_dev)
 	bcm2835_debug_add(i2c_dev, ~0);
 }
 
+/*
+ * A register address write followed by a read is by far the most common
+ * combined transfer. When the write fits in the FIFO, prefill it and poll
+ * for the transfer to become active instead of taking a TXW interrupt, then
+ * queue the read straight away, so the whole transaction completes with no
+ * interrupt before the read data arrives.
+ */
+static bool bcm2835_i2c_can_write_read(struct i2c_msg msgs[], int num)
+{
+	return num == 2 &&
+	       !msgs[0].flags && msgs[0].len &&
+	       msgs[0].len <= BCM2835_I2C_FIFO_SIZE &&
+	       msgs[1].flags == I2C_M_RD && msgs[1].len;
+}
+
+static int bcm2835_i2c_start_write_read(struct bcm2835_i2c_dev *i2c_dev)
+{
+	struct i2c_msg *wr = i2c_dev->curr_msg, *rd = wr + 1;
+	u32 c = BCM2835_I2C_C_ST | BCM2835_I2C_C_I2CEN;
+	u32 val;
+	int i, ret;
+
+	bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_A, wr->addr);
+	bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_DLEN, wr->len);
+	for (i = 0; i < wr->len; i++)
+		bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_FIFO, wr->buf[i]);
+	bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_C, c);
+	bcm2835_debug_add(i2c_dev, ~0);
+
+	ret = readl_poll_timeout_atomic(i2c_dev->regs + BCM2835_I2C_S, val,
+					val & (BCM2835_I2C_S_TA |
+					       BCM2835_I2C_S_DONE |
+					       BCM2835_I2C_S_ERR |
+					       BCM2835_I2C_S_CLKT),
+					0, BCM2835_I2C_TA_TIMEOUT_US);
+	if (ret)
+		return ret;
+
+	/* the ISR completes on DONE, so let it also report these errors */
+	if (val & (BCM2835_I2C_S_ERR | BCM2835_I2C_S_CLKT)) {
+		i2c_dev->num_msgs = 0;
+		bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_C,
+				   BCM2835_I2C_C_I2CEN | BCM2835_I2C_C_INTD);
+		return 0;
+	}
+
+	i2c_dev->curr_msg = rd;
+	i2c_dev->num_msgs = 0;
+	i2c_dev->msg_buf = rd->buf;
+	i2c_dev->msg_buf_remaining = rd->len;
+
+	bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_A, rd->addr);
+	bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_DLEN, rd->len);
+	bcm2835_i2c_writel(i2c_dev, BCM2835_I2C_C, c | BCM2835_I2C_C_READ |
+			   BCM2835_I2C_C_INTR | BCM2835_I2C_C_INTD);
+	bcm2835_debug_add(i2c_dev, ~0);
+
+	return 0;
+}
+
 static void bcm2835_i2c_finish_transfer(struct bcm2835_i2c_dev *i2c_dev)
 {
 	i2c_dev->curr_msg = NULL;
@@ -442,9 +510,9 @@ static int bcm2835_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 			    int num)
 {
 	struct bcm2835_i2c_dev *i2c_dev = i2c_get_adapdata(adap);
-	unsigned long time_left;
+	unsigned long time_left = 0;
 	bool ignore_nak = false;
-	int i;
+	int i, ret = 0;
 
 	if (debug)
 		i2c_dev->debug_num_msgs = num;
@@ -468,10 +536,15 @@ static int bcm2835_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 	i2c_dev->msg_err = 0;
 	reinit_completion(&i2c_dev->completion);
 
-	bcm2835_i2c_start_transfer(i2c_dev);
+	if (bcm2835_i2c_can_write_read(msgs, num))
+		ret = bcm2835_i2c_start_write_read(i2c_dev);
+	else
+		bcm2835_i2c_start_transfer(i2c_dev);
 
-	time_left = wait_for_completion_timeout(&i2c_dev->completion,
-						adap->timeout);
+	/* A write that never became active is handled as a timeout */
+	if (!ret)
+		time_left = wait_for_completion_timeout(&i2c_dev->completion,
+							adap->timeout);
 
 	bcm2835_i2c_finish_transfer(i2c_dev);
 
@@ -40,6 +40,9 @@
 #define DW_IC_CON_BUS_CLEAR_CTRL		BIT(11)
 
 #define DW_IC_DATA_CMD_DAT			GENMASK(7, 0)
+#define DW_IC_DATA_CMD_READ			BIT(8)
+#define DW_IC_DATA_CMD_STOP			BIT(9)
+#define DW_IC_DATA_CMD_RESTART			BIT(10)
 #define DW_IC_DATA_CMD_FIRST_DATA_BYTE		BIT(11)
 
 /*
@@ -77,6 +80,9 @@
 #define DW_IC_RXFLR				0x78
 #define DW_IC_SDA_HOLD				0x7c
 #define DW_IC_TX_ABRT_SOURCE			0x80
+#define DW_IC_DMA_CR				0x88
+#define DW_IC_DMA_TDLR				0x8c
+#define DW_IC_DMA_RDLR				0x90
 #define DW_IC_ENABLE_STATUS			0x9c
 #define DW_IC_CLR_RESTART_DET			0xa8
 #define DW_IC_COMP_PARAM_1			0xf4
@@ -108,9 +114,15 @@
 #define DW_IC_INTR_SLAVE_MASK			(DW_IC_INTR_DEFAULT_MASK | \
 						 DW_IC_INTR_RX_UNDER | \
 						 DW_IC_INTR_RD_REQ)
+/* Transfers queued up front only need to hear about the end */
+#define DW_IC_INTR_QUEUED_MASK			(DW_IC_INTR_TX_ABRT | \
+						 DW_IC_INTR_STOP_DET)
 
 #define DW_IC_ENABLE_ABORT			BIT(1)
 
+#define DW_IC_DMA_CR_RDMAE			BIT(0)
+#define DW_IC_DMA_CR_TDMAE			BIT(1)
+
 #define DW_IC_STATUS_ACTIVITY			BIT(0)
 #define DW_IC_STATUS_TFE			BIT(2)
 #define DW_IC_STATUS_RFNE			BIT(3)
@@ -143,6 +155,13 @@
 #define DW_IC_MASTER				0
 #define DW_IC_SLAVE				1
 
+/*
+ * master transfer modes
+ */
+#define DW_IC_XFER_IRQ				0 /* FIFOs serviced from the ISR */
+#define DW_IC_XFER_FIFO				1 /* queued whole into the FIFO */
+#define DW_IC_XFER_DMA				2 /* fed and drained by DMA */
+
 /*
  * Hardware abort codes from the DW_IC_TX_ABRT_SOURCE register
  *
@@ -187,8 +206,37 @@
 
 struct clk;
 struct device;
+struct dma_chan;
 struct reset_control;
 
+/**
+ * struct dw_i2c_dma - master DMA channels and the transfer they carry
+ * @tx: channel writing the command stream to IC_DATA_CMD
+ * @rx: channel reading the received bytes from IC_DATA_CMD
+ * @fifo: physical address of IC_DATA_CMD
+ * @done: signalled when @rx has completed
+ * @tx_buf: one IC_DATA_CMD word per byte of the transfer
+ * @rx_buf: one IC_DATA_CMD word per byte read
+ * @tx_addr: DMA address of @tx_buf
+ * @rx_addr: DMA address of @rx_buf
+ * @tx_len: number of words in @tx_buf
+ * @rx_len: number of words in @rx_buf
+ * @tx_cookie: cookie of the @tx descriptor
+ */
+struct dw_i2c_dma {
+	struct dma_chan		*tx;
+	struct dma_chan		*rx;
+	phys_addr_t		fifo;
+	struct completion	done;
+	u32			*tx_buf;
+	u32			*rx_buf;
+	dma_addr_t		tx_addr;
+	dma_addr_t		rx_addr;
+	unsigned int		tx_len;
+	unsigned int		rx_len;
+	dma_cookie_t		tx_cookie;
+};
+
 /**
  * struct dw_i2c_dev - private i2c-designware data
  * @dev: driver model device node
@@ -223,6 +271,8 @@ struct reset_control;
  * @tx_fifo_depth: depth of the hardware tx fifo
  * @rx_fifo_depth: depth of the hardware rx fifo
  * @rx_outstanding: current master-rx elements in tx fifo
+ * @xfer_mode: how the current master transfer is run, one of DW_IC_XFER_*
+ * @dma: optional DMA channels for master transfers
  * @timings: bus clock frequency, SDA hold and other timings
  * @sda_hold_time: SDA hold value
  * @ss_hcnt: standard speed HCNT value
@@ -281,6 +331,8 @@ struct dw_i2c_dev {
 	unsigned int		tx_fifo_depth;
 	unsigned int		rx_fifo_depth;
 	int			rx_outstanding;
+	unsigned int		xfer_mode;
+	struct dw_i2c_dma	dma;
 	struct i2c_timings	timings;
 	u32			sda_hold_time;
 	u16			ss_hcnt;
@@ -306,6 +358,7 @@ struct dw_i2c_dev {
 #define ACCESS_INTR_MASK			BIT(0)
 #define ACCESS_NO_IRQ_SUSPEND			BIT(1)
 #define ARBITRATION_SEMAPHORE			BIT(2)
+#define ACCESS_QUEUED_XFER			BIT(3)
 
 #define MODEL_MSCC_OCELOT			BIT(8)
 #define MODEL_BAIKAL_BT1			BIT(9)
@@ -9,6 +9,8 @@
  * Copyright (C) 2009 Provigent Ltd.
  */
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
 #include <linux/err.h>
 #include <linux/errno.h>
 #include <linux/export.h>
@@ -21,6 +23,7 @@
 #include <linux/pm_runtime.h>
 #include <linux/regmap.h>
 #include <linux/reset.h>
+#include <linux/slab.h>
 
 #include "i2c-designware-core.h"
 
@@ -291,7 +294,10 @@ static void i2c_dw_xfer_init(struct dw_i2c_dev *dev)
 
 	/* Clear and enable interrupts */
 	regmap_read(dev->map, DW_IC_CLR_INTR, &dummy);
-	regmap_write(dev->map, DW_IC_INTR_MASK, DW_IC_INTR_MASTER_MASK);
+	if (dev->xfer_mode == DW_IC_XFER_IRQ)
+		regmap_write(dev->map, DW_IC_INTR_MASK, DW_IC_INTR_MASTER_MASK);
+	else if (dev->xfer_mode == DW_IC_XFER_DMA)
+		regmap_write(dev->map, DW_IC_INTR_MASK, DW_IC_INTR_QUEUED_MASK);
 }
 
 static int i2c_dw_check_stopbit(struct dw_i2c_dev *dev)
@@ -682,6 +688,283 @@ i2c_dw_read(struct dw_i2c_dev *dev)
 	}
 }
 
+/*
+ * Pick how to run a transfer. Anything needing the ISR to make decisions
+ * along the way (SMBus block reads, quick commands, messages the driver
+ * rejects) stays on the interrupt driven path. Otherwise the whole
+ * command stream is known up front: if it fits in the FIFOs it is queued
+ * in one go on controllers flagged ACCESS_QUEUED_XFER, where the register
+ * reads the interrupt driven path makes are expensive, and if it does not
+ * it is handed to the DMA channels. Both only take the interrupt at the
+ * end, instead of TX_EMPTY and RX_FULL interrupts with FIFO level reads
+ * all the way through.
+ */
+static unsigned int i2c_dw_xfer_mode(struct dw_i2c_dev *dev)
+{
+	struct i2c_msg *msgs = dev->msgs;
+	u32 len = 0, rx_len = 0;
+	int i;
+
+	for (i = 0; i < dev->msgs_num; i++) {
+		if (!msgs[i].len || (msgs[i].flags & I2C_M_RECV_LEN) ||
+		    msgs[i].addr != msgs[0].addr)
+			return DW_IC_XFER_IRQ;
+
+		len += msgs[i].len;
+		if (msgs[i].flags & I2C_M_RD)
+			rx_len += msgs[i].len;
+	}
+
+	if ((dev->flags & ACCESS_QUEUED_XFER) &&
+	    len <= dev->tx_fifo_depth && rx_len <= dev->rx_fifo_depth)
+		return DW_IC_XFER_FIFO;
+
+	if (dev->dma.tx)
+		return DW_IC_XFER_DMA;
+
+	return DW_IC_XFER_IRQ;
+}
+
+/* IC_DATA_CMD word for byte @pos of message @idx of a queued transfer */
+static u32 i2c_dw_queued_cmd(struct dw_i2c_dev *dev, int idx, u32 pos)
+{
+	struct i2c_msg *msg = &dev->msgs[idx];
+	u32 cmd;
+
+	cmd = (msg->flags & I2C_M_RD) ? DW_IC_DATA_CMD_READ : msg->buf[pos];
+
+	if (!pos && idx && (dev->master_cfg & DW_IC_CON_RESTART_EN))
+		cmd |= DW_IC_DATA_CMD_RESTART;
+
+	if (idx == dev->msgs_num - 1 && pos == msg->len - 1)
+		cmd |= DW_IC_DATA_CMD_STOP;
+
+	return cmd;
+}
+
+static void i2c_dw_fifo_start(struct dw_i2c_dev *dev)
+{
+	int i;
+	u32 j;
+
+	/* The FIFO is empty after i2c_dw_xfer_init(), no need to check */
+	for (i = 0; i < dev->msgs_num; i++)
+		for (j = 0; j < dev->msgs[i].len; j++)
+			regmap_write(dev->map, DW_IC_DATA_CMD,
+				     i2c_dw_queued_cmd(dev, i, j));
+
+	/* Only now, so that the ISR never runs with commands left to write */
+	regmap_write(dev->map, DW_IC_INTR_MASK, DW_IC_INTR_QUEUED_MASK);
+}
+
+static void i2c_dw_fifo_finish(struct dw_i2c_dev *dev)
+{
+	int i;
+
+	/* Everything read is still in the RX FIFO, drain it in one pass */
+	for (i = 0; i < dev->msgs_num; i++)
+		if (dev->msgs[i].flags & I2C_M_RD)
+			dev->rx_outstanding += dev->msgs[i].len;
+
+	i2c_dw_read(dev);
+}
+
+static void i2c_dw_dma_callback(void *data)
+{
+	struct dw_i2c_dev *dev = data;
+
+	complete(&dev->dma.done);
+}
+
+static struct dma_async_tx_descriptor *
+i2c_dw_dma_prep(struct dw_i2c_dev *dev, struct dma_chan *chan,
+		enum dma_transfer_direction dir, dma_addr_t addr,
+		unsigned int len)
+{
+	struct dma_slave_config cfg = {
+		.direction = dir,
+		.src_addr = dev->dma.fifo,
+		.dst_addr = dev->dma.fifo,
+		.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES,
+		.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES,
+		.src_maxburst = 1,
+		.dst_maxburst = 1,
+	};
+
+	if (dmaengine_slave_config(chan, &cfg))
+		return NULL;
+
+	return dmaengine_prep_slave_single(chan, addr, len * sizeof(u32), dir,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+}
+
+static void i2c_dw_dma_unmap(struct dw_i2c_dev *dev)
+{
+	struct dw_i2c_dma *dma = &dev->dma;
+
+	if (dma->rx_len)
+		dma_unmap_single(dmaengine_get_dma_device(dma->rx),
+				 dma->rx_addr, dma->rx_len * sizeof(u32),
+				 DMA_FROM_DEVICE);
+	dma_unmap_single(dmaengine_get_dma_device(dma->tx), dma->tx_addr,
+			 dma->tx_len * sizeof(u32), DMA_TO_DEVICE);
+}
+
+static void i2c_dw_dma_free(struct dw_i2c_dev *dev)
+{
+	struct dw_i2c_dma *dma = &dev->dma;
+
+	kfree(dma->rx_buf);
+	kfree(dma->tx_buf);
+	dma->rx_buf = NULL;
+	dma->tx_buf = NULL;
+}
+
+/*
+ * Build the command stream and submit the descriptors. Called before the
+ * controller is enabled so that any failure can fall back to the
+ * interrupt driven path.
+ */
+static int i2c_dw_dma_prepare(struct dw_i2c_dev *dev)
+{
+	struct dw_i2c_dma *dma = &dev->dma;
+	struct device *tx_dev = dmaengine_get_dma_device(dma->tx);
+	struct device *rx_dev = dmaengine_get_dma_device(dma->rx);
+	struct dma_async_tx_descriptor *txd, *rxd;
+	unsigned int n = 0;
+	int ret, i;
+	u32 j;
+
+	dma->tx_len = 0;
+	dma->rx_len = 0;
+	for (i = 0; i < dev->msgs_num; i++) {
+		dma->tx_len += dev->msgs[i].len;
+		if (dev->msgs[i].flags & I2C_M_RD)
+			dma->rx_len += dev->msgs[i].len;
+	}
+
+	ret = -ENOMEM;
+	dma->tx_buf = kmalloc_array(dma->tx_len, sizeof(u32), GFP_KERNEL);
+	if (dma->rx_len)
+		dma->rx_buf = kmalloc_array(dma->rx_len, sizeof(u32),
+					    GFP_KERNEL);
+	if (!dma->tx_buf || (dma->rx_len && !dma->rx_buf))
+		goto err_free;
+
+	for (i = 0; i < dev->msgs_num; i++)
+		for (j = 0; j < dev->msgs[i].len; j++)
+			dma->tx_buf[n++] = i2c_dw_queued_cmd(dev, i, j);
+
+	dma->tx_addr = dma_map_single(tx_dev, dma->tx_buf,
+				      dma->tx_len * sizeof(u32), DMA_TO_DEVICE);
+	if (dma_mapping_error(tx_dev, dma->tx_addr))
+		goto err_free;
+
+	if (dma->rx_len) {
+		dma->rx_addr = dma_map_single(rx_dev, dma->rx_buf,
+					      dma->rx_len * sizeof(u32),
+					      DMA_FROM_DEVICE);
+		if (dma_mapping_error(rx_dev, dma->rx_addr)) {
+			dma_unmap_single(tx_dev, dma->tx_addr,
+					 dma->tx_len * sizeof(u32),
+					 DMA_TO_DEVICE);
+			goto err_free;
+		}
+	}
+
+	ret = -EIO;
+	if (dma->rx_len) {
+		rxd = i2c_dw_dma_prep(dev, dma->rx, DMA_DEV_TO_MEM,
+				      dma->rx_addr, dma->rx_len);
+		if (!rxd)
+			goto err_unmap;
+
+		reinit_completion(&dma->done);
+		rxd->callback = i2c_dw_dma_callback;
+		rxd->callback_param = dev;
+		dmaengine_submit(rxd);
+	}
+
+	txd = i2c_dw_dma_prep(dev, dma->tx, DMA_MEM_TO_DEV, dma->tx_addr,
+			      dma->tx_len);
+	if (!txd)
+		goto err_terminate;
+
+	dma->tx_cookie = dmaengine_submit(txd);
+
+	return 0;
+
+err_terminate:
+	if (dma->rx_len)
+		dmaengine_terminate_sync(dma->rx);
+err_unmap:
+	i2c_dw_dma_unmap(dev);
+err_free:
+	i2c_dw_dma_free(dev);
+	return ret;
+}
+
+static void i2c_dw_dma_start(struct dw_i2c_dev *dev)
+{
+	struct dw_i2c_dma *dma = &dev->dma;
+	u32 cr = DW_IC_DMA_CR_TDMAE;
+
+	if (dma->rx_len) {
+		dma_async_issue_pending(dma->rx);
+		cr |= DW_IC_DMA_CR_RDMAE;
+	}
+	dma_async_issue_pending(dma->tx);
+
+	/* Keep the TX FIFO topped up, and drain every received byte */
+	regmap_write(dev->map, DW_IC_DMA_TDLR, dev->tx_fifo_depth - 1);
+	regmap_write(dev->map, DW_IC_DMA_RDLR, 0);
+	regmap_write(dev->map, DW_IC_DMA_CR, cr);
+}
+
+/*
+ * Tear down a DMA transfer once the controller has signalled the end of
+ * it. The last received bytes may still be on their way to memory after
+ * STOP_DET, so wait for the RX channel before copying them out.
+ */
+static int i2c_dw_dma_finish(struct dw_i2c_dev *dev, bool ok)
+{
+	struct dw_i2c_dma *dma = &dev->dma;
+	unsigned int n = 0;
+	int ret = 0, i;
+	u32 j;
+
+	if (ok && dma->rx_len &&
+	    !wait_for_completion_timeout(&dma->done, dev->adapter.timeout)) {
+		dev_err(dev->dev, "DMA timed out\n");
+		ok = false;
+		ret = -ETIMEDOUT;
+	}
+
+	regmap_write(dev->map, DW_IC_DMA_CR, 0);
+
+	if (!ok) {
+		dmaengine_terminate_sync(dma->tx);
+		if (dma->rx_len)
+			dmaengine_terminate_sync(dma->rx);
+	}
+
+	i2c_dw_dma_unmap(dev);
+
+	if (ok) {
+		for (i = 0; i < dev->msgs_num; i++) {
+			if (!(dev->msgs[i].flags & I2C_M_RD))
+				continue;
+			for (j = 0; j < dev->msgs[i].len; j++)
+				dev->msgs[i].buf[j] = dma->rx_buf[n++] &
+						      DW_IC_DATA_CMD_DAT;
+		}
+	}
+
+	i2c_dw_dma_free(dev);
+
+	return ret;
+}
+
 /*
  * Prepare controller for a transaction and call i2c_dw_xfer_msg.
  */
@@ -721,6 +1004,7 @@ i2c_dw_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	dev->status = 0;
 	dev->abort_source = 0;
 	dev->rx_outstanding = 0;
+	dev->xfer_mode = i2c_dw_xfer_mode(dev);
 
 	ret = i2c_dw_acquire_lock(dev);
 	if (ret)
@@ -730,12 +1014,21 @@ i2c_dw_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	if (ret < 0)
 		goto done;
 
+	if (dev->xfer_mode == DW_IC_XFER_DMA && i2c_dw_dma_prepare(dev))
+		dev->xfer_mode = DW_IC_XFER_IRQ;
+
 	/* Start the transfers */
 	i2c_dw_xfer_init(dev);
+	if (dev->xfer_mode == DW_IC_XFER_FIFO)
+		i2c_dw_fifo_start(dev);
+	else if (dev->xfer_mode == DW_IC_XFER_DMA)
+		i2c_dw_dma_start(dev);
 
 	/* Wait for tx to complete */
 	if (!wait_for_completion_timeout(&dev->cmd_complete, adap->timeout)) {
 		dev_err(dev->dev, "controller timed out\n");
+		if (dev->xfer_mode == DW_IC_XFER_DMA)
+			i2c_dw_dma_finish(dev, false);
 		/* i2c_dw_init implicitly disables the adapter */
 		i2c_recover_bus(&dev->adapter);
 		i2c_dw_init_master(dev);
@@ -751,8 +1044,16 @@ i2c_dw_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	 * additional interrupts are a hardware bug or this driver doesn't
 	 * handle them correctly yet.
 	 */
+	if (dev->xfer_mode == DW_IC_XFER_DMA)
+		ret = i2c_dw_dma_finish(dev, !dev->cmd_err);
+	else if (dev->xfer_mode == DW_IC_XFER_FIFO && !dev->cmd_err)
+		i2c_dw_fifo_finish(dev);
+
 	__i2c_dw_disable_nowait(dev);
 
+	if (ret)
+		goto done;
+
 	if (dev->msg_err) {
 		ret = dev->msg_err;
 		goto done;
@@ -851,6 +1152,27 @@ static u32 i2c_dw_read_clear_intrbits(struct dw_i2c_dev *dev)
 	return stat;
 }
 
+/*
+ * With the TX FIFO empty the controller ends the transfer with a STOP of its
+ * own. If a queued command stream was not fed fast enough, STOP_DET is then
+ * raised with commands still to go, and those start a new transfer on the
+ * bus. Only the STOP after the last command ends the queued transfer.
+ */
+static bool i2c_dw_queued_pending(struct dw_i2c_dev *dev)
+{
+	struct dw_i2c_dma *dma = &dev->dma;
+	u32 txflr, status;
+
+	if (dev->xfer_mode == DW_IC_XFER_DMA &&
+	    dmaengine_tx_status(dma->tx, dma->tx_cookie, NULL) != DMA_COMPLETE)
+		return true;
+
+	regmap_read(dev->map, DW_IC_TXFLR, &txflr);
+	regmap_read(dev->map, DW_IC_STATUS, &status);
+
+	return txflr || (status & DW_IC_STATUS_MASTER_ACTIVITY);
+}
+
 /*
  * Interrupt service routine. This gets called whenever an I2C master interrupt
  * occurs.
@@ -868,6 +1190,14 @@ static irqreturn_t i2c_dw_isr(int this_irq, void *dev_id)
 		return IRQ_NONE;
 	dev_dbg(dev->dev, "enabled=%#x stat=%#x\n", enabled, stat);
 
+	/*
+	 * Clearing an abort releases the flushed TX FIFO. Stop the DMA
+	 * handshake first so the rest of the command stream cannot start
+	 * a new transfer on the bus.
+	 */
+	if (dev->xfer_mode == DW_IC_XFER_DMA && (stat & DW_IC_INTR_TX_ABRT))
+		regmap_write(dev->map, DW_IC_DMA_CR, 0);
+
 	stat = i2c_dw_read_clear_intrbits(dev);
 
 	if (!(dev->status & STATUS_ACTIVE)) {
@@ -907,6 +1237,10 @@ static irqreturn_t i2c_dw_isr(int this_irq, void *dev_id)
 	 * the current transmit status.
 	 */
 
+	if ((stat & DW_IC_INTR_STOP_DET) && dev->xfer_mode != DW_IC_XFER_IRQ &&
+	    i2c_dw_queued_pending(dev))
+		stat &= ~DW_IC_INTR_STOP_DET;
+
 tx_aborted:
 	if (((stat & (DW_IC_INTR_TX_ABRT | DW_IC_INTR_STOP_DET)) || dev->msg_err) &&
 	     (dev->rx_outstanding == 0))
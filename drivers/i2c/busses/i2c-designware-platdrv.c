@@ -12,6 +12,7 @@
 #include <linux/clk-provider.h>
 #include <linux/clk.h>
 #include <linux/delay.h>
+#include <linux/dmaengine.h>
 #include <linux/dmi.h>
 #include <linux/err.h>
 #include <linux/errno.h>
@@ -151,6 +152,7 @@ static int dw_i2c_of_configure(struct platform_device *pdev)
 
 static const struct of_device_id dw_i2c_of_match[] = {
 	{ .compatible = "snps,designware-i2c", },
+	{ .compatible = "raspberrypi,rp1-i2c", .data = (void *)ACCESS_QUEUED_XFER },
 	{ .compatible = "mscc,ocelot-i2c", .data = (void *)MODEL_MSCC_OCELOT },
 	{ .compatible = "baikal,bt1-sys-i2c", .data = (void *)MODEL_BAIKAL_BT1 },
 	{},
@@ -188,6 +190,7 @@ static void dw_i2c_plat_pm_cleanup(struct dw_i2c_dev *dev)
 static int dw_i2c_plat_request_regs(struct dw_i2c_dev *dev)
 {
 	struct platform_device *pdev = to_platform_device(dev->dev);
+	struct resource *res;
 	int ret;
 
 	switch (dev->flags & MODEL_MASK) {
@@ -198,14 +201,50 @@ static int dw_i2c_plat_request_regs(struct dw_i2c_dev *dev)
 		ret = txgbe_i2c_request_regs(dev);
 		break;
 	default:
-		dev->base = devm_platform_ioremap_resource(pdev, 0);
+		dev->base = devm_platform_get_and_ioremap_resource(pdev, 0,
+								   &res);
 		ret = PTR_ERR_OR_ZERO(dev->base);
+		if (!ret)
+			dev->dma.fifo = res->start + DW_IC_DATA_CMD;
 		break;
 	}
 
 	return ret;
 }
 
+static void dw_i2c_plat_release_dma(void *data)
+{
+	struct dw_i2c_dev *dev = data;
+
+	dma_release_channel(dev->dma.rx);
+	dma_release_channel(dev->dma.tx);
+}
+
+/* DMA is optional, transfers fall back to the FIFO without it */
+static int dw_i2c_plat_request_dma(struct dw_i2c_dev *dev)
+{
+	struct dma_chan *tx, *rx;
+
+	if (!dev->dma.fifo)
+		return 0;
+
+	tx = dma_request_chan(dev->dev, "tx");
+	if (IS_ERR(tx))
+		return PTR_ERR(tx) == -EPROBE_DEFER ? -EPROBE_DEFER : 0;
+
+	rx = dma_request_chan(dev->dev, "rx");
+	if (IS_ERR(rx)) {
+		dma_release_channel(tx);
+		return PTR_ERR(rx) == -EPROBE_DEFER ? -EPROBE_DEFER : 0;
+	}
+
+	dev->dma.tx = tx;
+	dev->dma.rx = rx;
+	init_completion(&dev->dma.done);
+
+	return devm_add_action_or_reset(dev->dev, dw_i2c_plat_release_dma, dev);
+}
+
 static const struct dmi_system_id dw_i2c_hwmon_class_dmi[] = {
 	{
 		.ident = "Qtechnology QT5222",
@@ -300,6 +339,10 @@ static int dw_i2c_plat_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	ret = dw_i2c_plat_request_dma(dev);
+	if (ret)
+		return ret;
+
 	dev->rst = devm_reset_control_get_optional_exclusive(&pdev->dev, NULL);
 	if (IS_ERR(dev->rst))
 		return PTR_ERR(dev->rst);
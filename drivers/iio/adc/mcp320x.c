@@ -43,6 +43,9 @@
 #include <linux/module.h>
 #include <linux/mod_devicetable.h>
 #include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
 #include <linux/regulator/consumer.h>
 
 enum {
@@ -61,6 +64,9 @@ enum {
 	mcp3553,
 };
 
+/* mcp3208: 8 single-ended plus 8 pseudo-differential channels */
+#define MCP320X_MAX_SCAN 16
+
 struct mcp320x_chip_info {
 	const struct iio_chan_spec *channels;
 	unsigned int num_channels;
@@ -75,11 +81,18 @@ struct mcp320x_chip_info {
  * @transfer: SPI transfers used by @msg
  * @start_conv_msg: SPI message to start a conversion by briefly asserting CS
  * @start_conv_transfer: SPI transfer used by @start_conv_msg
+ * @scan_msg: SPI message reading all channels of the active scan
+ * @scan_xfer: SPI transfers used by @scan_msg
+ * @scan_count: number of channels read by @scan_msg
+ * @rx_only: the converter has no MOSI pin and a single channel
  * @reg: regulator generating Vref
  * @lock: protects read sequences
  * @chip_info: ADC properties
+ * @scan: channel values and timestamp pushed to the buffer
  * @tx_buf: buffer for @transfer[0] (not used on single-channel converters)
  * @rx_buf: buffer for @transfer[1]
+ * @scan_tx: channel selection sent by @scan_msg
+ * @scan_rx: values received by @scan_msg
  */
 struct mcp320x {
 	struct spi_device *spi;
@@ -87,13 +100,24 @@ struct mcp320x {
 	struct spi_transfer transfer[2];
 	struct spi_message start_conv_msg;
 	struct spi_transfer start_conv_transfer;
+	struct spi_message scan_msg;
+	struct spi_transfer scan_xfer[2 * MCP320X_MAX_SCAN];
+	unsigned int scan_count;
+	bool rx_only;
 
 	struct regulator *reg;
 	struct mutex lock;
 	const struct mcp320x_chip_info *chip_info;
 
+	struct {
+		u16 channels[MCP320X_MAX_SCAN];
+		s64 ts __aligned(8);
+	} scan;
+
 	u8 tx_buf __aligned(IIO_DMA_MINALIGN);
 	u8 rx_buf[4];
+	u8 scan_tx[MCP320X_MAX_SCAN];
+	u8 scan_rx[MCP320X_MAX_SCAN][2];
 };
 
 static int mcp320x_channel_to_tx_data(int device_index,
@@ -117,55 +141,35 @@ static int mcp320x_channel_to_tx_data(int device_index,
 	}
 }
 
-static int mcp320x_adc_conversion(struct mcp320x *adc, u8 channel,
-				  bool differential, int device_index, int *val)
+static int mcp320x_adc_decode(struct mcp320x *adc, int device_index,
+			      const u8 *rx_buf, int *val)
 {
-	int ret;
-
-	if (adc->chip_info->conv_time) {
-		ret = spi_sync(adc->spi, &adc->start_conv_msg);
-		if (ret < 0)
-			return ret;
-
-		usleep_range(adc->chip_info->conv_time,
-			     adc->chip_info->conv_time + 100);
-	}
-
-	memset(&adc->rx_buf, 0, sizeof(adc->rx_buf));
-	if (adc->chip_info->num_channels > 1)
-		adc->tx_buf = mcp320x_channel_to_tx_data(device_index, channel,
-							 differential);
-
-	ret = spi_sync(adc->spi, &adc->msg);
-	if (ret < 0)
-		return ret;
-
 	switch (device_index) {
 	case mcp3001:
-		*val = (adc->rx_buf[0] << 5 | adc->rx_buf[1] >> 3);
+		*val = (rx_buf[0] << 5 | rx_buf[1] >> 3);
 		return 0;
 	case mcp3002:
 	case mcp3004:
 	case mcp3008:
-		*val = (adc->rx_buf[0] << 2 | adc->rx_buf[1] >> 6);
+		*val = (rx_buf[0] << 2 | rx_buf[1] >> 6);
 		return 0;
 	case mcp3201:
-		*val = (adc->rx_buf[0] << 7 | adc->rx_buf[1] >> 1);
+		*val = (rx_buf[0] << 7 | rx_buf[1] >> 1);
 		return 0;
 	case mcp3202:
 	case mcp3204:
 	case mcp3208:
-		*val = (adc->rx_buf[0] << 4 | adc->rx_buf[1] >> 4);
+		*val = (rx_buf[0] << 4 | rx_buf[1] >> 4);
 		return 0;
 	case mcp3301:
-		*val = sign_extend32((adc->rx_buf[0] & 0x1f) << 8
-				    | adc->rx_buf[1], 12);
+		*val = sign_extend32((rx_buf[0] & 0x1f) << 8
+				    | rx_buf[1], 12);
 		return 0;
 	case mcp3550_50:
 	case mcp3550_60:
 	case mcp3551:
 	case mcp3553: {
-		u32 raw = be32_to_cpup((__be32 *)adc->rx_buf);
+		u32 raw = be32_to_cpup((__be32 *)rx_buf);
 
 		if (!(adc->spi->mode & SPI_CPOL))
 			raw <<= 1; /* strip Data Ready bit in SPI mode 0,0 */
@@ -191,6 +195,32 @@ static int mcp320x_adc_conversion(struct mcp320x *adc, u8 channel,
 	}
 }
 
+static int mcp320x_adc_conversion(struct mcp320x *adc, u8 channel,
+				  bool differential, int device_index, int *val)
+{
+	int ret;
+
+	if (adc->chip_info->conv_time) {
+		ret = spi_sync(adc->spi, &adc->start_conv_msg);
+		if (ret < 0)
+			return ret;
+
+		usleep_range(adc->chip_info->conv_time,
+			     adc->chip_info->conv_time + 100);
+	}
+
+	memset(&adc->rx_buf, 0, sizeof(adc->rx_buf));
+	if (!adc->rx_only)
+		adc->tx_buf = mcp320x_channel_to_tx_data(device_index, channel,
+							 differential);
+
+	ret = spi_sync(adc->spi, &adc->msg);
+	if (ret < 0)
+		return ret;
+
+	return mcp320x_adc_decode(adc, device_index, adc->rx_buf, val);
+}
+
 static int mcp320x_read_raw(struct iio_dev *indio_dev,
 			    struct iio_chan_spec const *channel, int *val,
 			    int *val2, long mask)
@@ -231,17 +261,24 @@ static int mcp320x_read_raw(struct iio_dev *indio_dev,
 	return ret;
 }
 
-#define MCP320X_VOLTAGE_CHANNEL(num)				\
+#define MCP320X_VOLTAGE_CHANNEL(num, index, bits)		\
 	{							\
 		.type = IIO_VOLTAGE,				\
 		.indexed = 1,					\
 		.channel = (num),				\
 		.address = (num),				\
 		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),	\
-		.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE) \
+		.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE), \
+		.scan_index = (index),				\
+		.scan_type = {					\
+			.sign = 'u',				\
+			.realbits = (bits),			\
+			.storagebits = 16,			\
+			.endianness = IIO_CPU,			\
+		},						\
 	}
 
-#define MCP320X_VOLTAGE_CHANNEL_DIFF(chan1, chan2)		\
+#define MCP320X_VOLTAGE_CHANNEL_DIFF(chan1, chan2, index, bits, _sign) \
 	{							\
 		.type = IIO_VOLTAGE,				\
 		.indexed = 1,					\
@@ -250,73 +287,205 @@ static int mcp320x_read_raw(struct iio_dev *indio_dev,
 		.address = (chan1),				\
 		.differential = 1,				\
 		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),	\
-		.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE) \
+		.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE), \
+		.scan_index = (index),				\
+		.scan_type = {					\
+			.sign = (_sign),			\
+			.realbits = (bits),			\
+			.storagebits = (bits) > 16 ? 32 : 16,	\
+			.endianness = IIO_CPU,			\
+		},						\
 	}
 
+#define MCP3X02_CHANNELS(bits)					\
+	MCP320X_VOLTAGE_CHANNEL(0, 0, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(1, 1, bits),			\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 2, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(1, 0, 3, bits, 'u'),	\
+	IIO_CHAN_SOFT_TIMESTAMP(4)
+
+#define MCP3X04_CHANNELS(bits)					\
+	MCP320X_VOLTAGE_CHANNEL(0, 0, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(1, 1, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(2, 2, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(3, 3, bits),			\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 4, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(1, 0, 5, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(2, 3, 6, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(3, 2, 7, bits, 'u'),	\
+	IIO_CHAN_SOFT_TIMESTAMP(8)
+
+#define MCP3X08_CHANNELS(bits)					\
+	MCP320X_VOLTAGE_CHANNEL(0, 0, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(1, 1, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(2, 2, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(3, 3, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(4, 4, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(5, 5, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(6, 6, bits),			\
+	MCP320X_VOLTAGE_CHANNEL(7, 7, bits),			\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 8, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(1, 0, 9, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(2, 3, 10, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(3, 2, 11, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(4, 5, 12, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(5, 4, 13, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(6, 7, 14, bits, 'u'),	\
+	MCP320X_VOLTAGE_CHANNEL_DIFF(7, 6, 15, bits, 'u'),	\
+	IIO_CHAN_SOFT_TIMESTAMP(16)
+
+static const struct iio_chan_spec mcp3001_channels[] = {
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 0, 10, 'u'),
+	IIO_CHAN_SOFT_TIMESTAMP(1),
+};
+
 static const struct iio_chan_spec mcp3201_channels[] = {
-	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1),
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 0, 12, 'u'),
+	IIO_CHAN_SOFT_TIMESTAMP(1),
+};
+
+static const struct iio_chan_spec mcp3301_channels[] = {
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 0, 13, 's'),
+	IIO_CHAN_SOFT_TIMESTAMP(1),
+};
+
+/* no buffer support, a conversion takes up to 80 msec */
+static const struct iio_chan_spec mcp3550_channels[] = {
+	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1, 0, 22, 's'),
+};
+
+static const struct iio_chan_spec mcp3002_channels[] = {
+	MCP3X02_CHANNELS(10),
 };
 
 static const struct iio_chan_spec mcp3202_channels[] = {
-	MCP320X_VOLTAGE_CHANNEL(0),
-	MCP320X_VOLTAGE_CHANNEL(1),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(1, 0),
+	MCP3X02_CHANNELS(12),
+};
+
+static const struct iio_chan_spec mcp3004_channels[] = {
+	MCP3X04_CHANNELS(10),
 };
 
 static const struct iio_chan_spec mcp3204_channels[] = {
-	MCP320X_VOLTAGE_CHANNEL(0),
-	MCP320X_VOLTAGE_CHANNEL(1),
-	MCP320X_VOLTAGE_CHANNEL(2),
-	MCP320X_VOLTAGE_CHANNEL(3),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(1, 0),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(2, 3),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(3, 2),
+	MCP3X04_CHANNELS(12),
+};
+
+static const struct iio_chan_spec mcp3008_channels[] = {
+	MCP3X08_CHANNELS(10),
 };
 
 static const struct iio_chan_spec mcp3208_channels[] = {
-	MCP320X_VOLTAGE_CHANNEL(0),
-	MCP320X_VOLTAGE_CHANNEL(1),
-	MCP320X_VOLTAGE_CHANNEL(2),
-	MCP320X_VOLTAGE_CHANNEL(3),
-	MCP320X_VOLTAGE_CHANNEL(4),
-	MCP320X_VOLTAGE_CHANNEL(5),
-	MCP320X_VOLTAGE_CHANNEL(6),
-	MCP320X_VOLTAGE_CHANNEL(7),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(0, 1),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(1, 0),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(2, 3),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(3, 2),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(4, 5),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(5, 4),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(6, 7),
-	MCP320X_VOLTAGE_CHANNEL_DIFF(7, 6),
+	MCP3X08_CHANNELS(12),
 };
 
+/*
+ * Build a single SPI message reading all channels of the scan, so a trigger
+ * costs one spi_sync() regardless of the number of enabled channels. CS is
+ * toggled between the channels as each of them is a separate conversion.
+ */
+static int mcp320x_update_scan_mode(struct iio_dev *indio_dev,
+				    const unsigned long *scan_mask)
+{
+	struct mcp320x *adc = iio_priv(indio_dev);
+	int device_index = spi_get_device_id(adc->spi)->driver_data;
+	struct spi_transfer *xfer = adc->scan_xfer;
+	unsigned int i, n = 0;
+
+	spi_message_init(&adc->scan_msg);
+
+	for_each_set_bit(i, scan_mask, indio_dev->masklength) {
+		const struct iio_chan_spec *chan = &indio_dev->channels[i];
+
+		if (chan->type != IIO_VOLTAGE)
+			continue;
+
+		if (!adc->rx_only) {
+			adc->scan_tx[n] = mcp320x_channel_to_tx_data(device_index,
+								     chan->address,
+								     chan->differential);
+			xfer->tx_buf = &adc->scan_tx[n];
+			xfer->len = 1;
+			spi_message_add_tail(xfer++, &adc->scan_msg);
+		}
+
+		xfer->rx_buf = adc->scan_rx[n];
+		xfer->len = adc->transfer[1].len;
+		xfer->cs_change = 1;
+		/* tCSH is 500 nsec on the mcp3204/08 at 2.7V */
+		xfer->cs_change_delay.value = 500;
+		xfer->cs_change_delay.unit = SPI_DELAY_UNIT_NSECS;
+		spi_message_add_tail(xfer++, &adc->scan_msg);
+		n++;
+	}
+
+	if (!n)
+		return -EINVAL;
+
+	/* release CS after the last channel */
+	(xfer - 1)->cs_change = 0;
+	adc->scan_count = n;
+
+	return 0;
+}
+
+static irqreturn_t mcp320x_trigger_handler(int irq, void *p)
+{
+	struct iio_poll_func *pf = p;
+	struct iio_dev *indio_dev = pf->indio_dev;
+	struct mcp320x *adc = iio_priv(indio_dev);
+	int device_index = spi_get_device_id(adc->spi)->driver_data;
+	unsigned int i;
+	int ret, val;
+
+	mutex_lock(&adc->lock);
+
+	ret = spi_sync(adc->spi, &adc->scan_msg);
+	if (ret < 0)
+		goto out;
+
+	for (i = 0; i < adc->scan_count; i++) {
+		ret = mcp320x_adc_decode(adc, device_index, adc->scan_rx[i],
+					 &val);
+		if (ret < 0)
+			goto out;
+
+		adc->scan.channels[i] = val;
+	}
+
+	iio_push_to_buffers_with_timestamp(indio_dev, &adc->scan,
+					   iio_get_time_ns(indio_dev));
+
+out:
+	mutex_unlock(&adc->lock);
+	iio_trigger_notify_done(indio_dev->trig);
+
+	return IRQ_HANDLED;
+}
+
 static const struct iio_info mcp320x_info = {
 	.read_raw = mcp320x_read_raw,
+	.update_scan_mode = mcp320x_update_scan_mode,
 };
 
 static const struct mcp320x_chip_info mcp320x_chip_infos[] = {
 	[mcp3001] = {
-		.channels = mcp3201_channels,
-		.num_channels = ARRAY_SIZE(mcp3201_channels),
+		.channels = mcp3001_channels,
+		.num_channels = ARRAY_SIZE(mcp3001_channels),
 		.resolution = 10
 	},
 	[mcp3002] = {
-		.channels = mcp3202_channels,
-		.num_channels = ARRAY_SIZE(mcp3202_channels),
+		.channels = mcp3002_channels,
+		.num_channels = ARRAY_SIZE(mcp3002_channels),
 		.resolution = 10
 	},
 	[mcp3004] = {
-		.channels = mcp3204_channels,
-		.num_channels = ARRAY_SIZE(mcp3204_channels),
+		.channels = mcp3004_channels,
+		.num_channels = ARRAY_SIZE(mcp3004_channels),
 		.resolution = 10
 	},
 	[mcp3008] = {
-		.channels = mcp3208_channels,
-		.num_channels = ARRAY_SIZE(mcp3208_channels),
+		.channels = mcp3008_channels,
+		.num_channels = ARRAY_SIZE(mcp3008_channels),
 		.resolution = 10
 	},
 	[mcp3201] = {
@@ -340,32 +509,32 @@ static const struct mcp320x_chip_info mcp320x_chip_infos[] = {
 		.resolution = 12
 	},
 	[mcp3301] = {
-		.channels = mcp3201_channels,
-		.num_channels = ARRAY_SIZE(mcp3201_channels),
+		.channels = mcp3301_channels,
+		.num_channels = ARRAY_SIZE(mcp3301_channels),
 		.resolution = 13
 	},
 	[mcp3550_50] = {
-		.channels = mcp3201_channels,
-		.num_channels = ARRAY_SIZE(mcp3201_channels),
+		.channels = mcp3550_channels,
+		.num_channels = ARRAY_SIZE(mcp3550_channels),
 		.resolution = 21,
 		/* 2% max deviation + 144 clock periods to exit shutdown */
 		.conv_time = 80000 * 1.02 + 144000 / 102.4,
 	},
 	[mcp3550_60] = {
-		.channels = mcp3201_channels,
-		.num_channels = ARRAY_SIZE(mcp3201_channels),
+		.channels = mcp3550_channels,
+		.num_channels = ARRAY_SIZE(mcp3550_channels),
 		.resolution = 21,
 		.conv_time = 66670 * 1.02 + 144000 / 122.88,
 	},
 	[mcp3551] = {
-		.channels = mcp3201_channels,
-		.num_channels = ARRAY_SIZE(mcp3201_channels),
+		.channels = mcp3550_channels,
+		.num_channels = ARRAY_SIZE(mcp3550_channels),
 		.resolution = 21,
 		.conv_time = 73100 * 1.02 + 144000 / 112.64,
 	},
 	[mcp3553] = {
-		.channels = mcp3201_channels,
-		.num_channels = ARRAY_SIZE(mcp3201_channels),
+		.channels = mcp3550_channels,
+		.num_channels = ARRAY_SIZE(mcp3550_channels),
 		.resolution = 21,
 		.conv_time = 16670 * 1.02 + 144000 / 122.88,
 	},
@@ -396,13 +565,14 @@ static int mcp320x_probe(struct spi_device *spi)
 	indio_dev->num_channels = chip_info->num_channels;
 
 	adc->chip_info = chip_info;
+	adc->rx_only = mcp320x_channel_to_tx_data(device_index, 0, false) < 0;
 
 	adc->transfer[0].tx_buf = &adc->tx_buf;
 	adc->transfer[0].len = sizeof(adc->tx_buf);
 	adc->transfer[1].rx_buf = adc->rx_buf;
 	adc->transfer[1].len = DIV_ROUND_UP(chip_info->resolution, 8);
 
-	if (chip_info->num_channels == 1)
+	if (adc->rx_only)
 		/* single-channel converters are rx only (no MOSI pin) */
 		spi_message_init_with_transfers(&adc->msg,
 						&adc->transfer[1], 1);
@@ -447,6 +617,15 @@ static int mcp320x_probe(struct spi_device *spi)
 
 	mutex_init(&adc->lock);
 
+	if (!chip_info->conv_time) {
+		ret = devm_iio_triggered_buffer_setup(&spi->dev, indio_dev,
+						      NULL,
+						      mcp320x_trigger_handler,
+						      NULL);
+		if (ret)
+			goto reg_disable;
+	}
+
 	ret = iio_device_register(indio_dev);
 	if (ret < 0)
 		goto reg_disable;
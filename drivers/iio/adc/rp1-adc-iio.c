@@ -0,0 +1,446 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * IIO driver for the RP1 ADC and temperature sensor
+ * Copyright (C) 2024 Raspberry Pi Ltd.
+ *
+ * Besides one-shot reads, the ADC can convert continuously, cycling
+ * round-robin through the enabled inputs and pushing the results into an
+ * 8 entry FIFO. In buffered mode the FIFO threshold interrupt drains the
+ * FIFO and hands complete scans to the IIO buffer, so user space reads
+ * blocks of samples instead of making a syscall per conversion.
+ */
+
+#include <linux/bitfield.h>
+#include <linux/clk.h>
+#include <linux/err.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/iopoll.h>
+#include <linux/module.h>
+#include <linux/mod_devicetable.h>
+#include <linux/mutex.h>
+#include <linux/platform_device.h>
+#include <linux/regulator/consumer.h>
+
+#include <linux/iio/buffer.h>
+#include <linux/iio/iio.h>
+#include <linux/iio/kfifo_buf.h>
+
+#define MODULE_NAME	"rp1-adc-iio"
+
+#define RP1_ADC_CS		0x00
+#define RP1_ADC_RESULT		0x04
+#define RP1_ADC_FCS		0x08
+#define RP1_ADC_FIFO		0x0c
+#define RP1_ADC_DIV		0x10
+
+#define RP1_ADC_INTR		0x14
+#define RP1_ADC_INTE		0x18
+#define RP1_ADC_INTF		0x1c
+#define RP1_ADC_INTS		0x20
+
+#define RP1_ADC_RWTYPE_SET	0x2000
+#define RP1_ADC_RWTYPE_CLR	0x3000
+
+#define RP1_ADC_CS_RROBIN	GENMASK(20, 16)
+#define RP1_ADC_CS_AINSEL	GENMASK(14, 12)
+#define RP1_ADC_CS_ERR_STICKY	BIT(10)
+#define RP1_ADC_CS_ERR		BIT(9)
+#define RP1_ADC_CS_READY	BIT(8)
+#define RP1_ADC_CS_START_MANY	BIT(3)
+#define RP1_ADC_CS_START_ONCE	BIT(2)
+#define RP1_ADC_CS_TS_EN	BIT(1)
+#define RP1_ADC_CS_EN		BIT(0)
+
+#define RP1_ADC_FCS_THRESH	GENMASK(27, 24)
+#define RP1_ADC_FCS_LEVEL	GENMASK(19, 16)
+#define RP1_ADC_FCS_OVER	BIT(11)
+#define RP1_ADC_FCS_UNDER	BIT(10)
+#define RP1_ADC_FCS_FULL	BIT(9)
+#define RP1_ADC_FCS_EMPTY	BIT(8)
+#define RP1_ADC_FCS_DREQ_EN	BIT(3)
+#define RP1_ADC_FCS_ERR		BIT(2)
+#define RP1_ADC_FCS_SHIFR	BIT(1)
+#define RP1_ADC_FCS_EN		BIT(0)
+
+#define RP1_ADC_FIFO_VAL_MASK	0xfff
+
+#define RP1_ADC_INT_FIFO	BIT(0)
+
+/* Fixed point, in 1/256ths of an ADC clock cycle */
+#define RP1_ADC_DIV_MASK	GENMASK(23, 0)
+
+#define RP1_ADC_CLK_RATE	50000000
+#define RP1_ADC_CYCLES		96
+#define RP1_ADC_FIFO_THRESH	4
+#define RP1_ADC_TEMP_CHANNEL	4
+#define RP1_ADC_NUM_CHANNELS	5
+
+struct rp1_adc_iio {
+	void __iomem *base;
+	unsigned long clk_rate;
+	int vref_mv;
+	/* serialise conversions, rate changes and FIFO restarts */
+	struct mutex lock;
+
+	unsigned int scan_len;
+	unsigned int scan_pos;
+	struct {
+		u16 data[RP1_ADC_NUM_CHANNELS];
+		s64 ts __aligned(8);
+	} scan;
+};
+
+#define RP1_ADC_VOLTAGE(_idx) {						\
+	.type = IIO_VOLTAGE,						\
+	.indexed = 1,							\
+	.channel = (_idx),						\
+	.info_mask_separate = BIT(IIO_CHAN_INFO_RAW),			\
+	.info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),		\
+	.info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ),	\
+	.scan_index = (_idx),						\
+	.scan_type = {							\
+		.sign = 'u',						\
+		.realbits = 12,						\
+		.storagebits = 16,					\
+		.endianness = IIO_CPU,					\
+	},								\
+}
+
+static const struct iio_chan_spec rp1_adc_channels[] = {
+	RP1_ADC_VOLTAGE(0),
+	RP1_ADC_VOLTAGE(1),
+	RP1_ADC_VOLTAGE(2),
+	RP1_ADC_VOLTAGE(3),
+	{
+		.type = IIO_TEMP,
+		.info_mask_separate = BIT(IIO_CHAN_INFO_RAW) |
+				      BIT(IIO_CHAN_INFO_PROCESSED),
+		.info_mask_shared_by_all = BIT(IIO_CHAN_INFO_SAMP_FREQ),
+		.scan_index = RP1_ADC_TEMP_CHANNEL,
+		.scan_type = {
+			.sign = 'u',
+			.realbits = 12,
+			.storagebits = 16,
+			.endianness = IIO_CPU,
+		},
+	},
+	IIO_CHAN_SOFT_TIMESTAMP(RP1_ADC_NUM_CHANNELS),
+};
+
+static inline void rp1_adc_set(struct rp1_adc_iio *adc, u32 reg, u32 bits)
+{
+	writel(bits, adc->base + RP1_ADC_RWTYPE_SET + reg);
+}
+
+static inline void rp1_adc_clr(struct rp1_adc_iio *adc, u32 reg, u32 bits)
+{
+	writel(bits, adc->base + RP1_ADC_RWTYPE_CLR + reg);
+}
+
+static int rp1_adc_read_once(struct rp1_adc_iio *adc, unsigned int channel,
+			     int *val)
+{
+	u32 cs;
+	int ret;
+
+	mutex_lock(&adc->lock);
+
+	if (channel == RP1_ADC_TEMP_CHANNEL)
+		rp1_adc_set(adc, RP1_ADC_CS, RP1_ADC_CS_TS_EN);
+	rp1_adc_clr(adc, RP1_ADC_CS, RP1_ADC_CS_AINSEL);
+	rp1_adc_set(adc, RP1_ADC_CS,
+		    FIELD_PREP(RP1_ADC_CS_AINSEL, channel) |
+		    RP1_ADC_CS_START_ONCE);
+
+	ret = readl_poll_timeout(adc->base + RP1_ADC_CS, cs,
+				 cs & RP1_ADC_CS_READY, 1, 100);
+	/* Asserted if the completed conversion had a convergence error */
+	if (!ret && (cs & RP1_ADC_CS_ERR))
+		ret = -EIO;
+	if (!ret)
+		*val = readl(adc->base + RP1_ADC_RESULT) & RP1_ADC_FIFO_VAL_MASK;
+
+	mutex_unlock(&adc->lock);
+
+	return ret;
+}
+
+static int rp1_adc_raw_to_mdegc(struct rp1_adc_iio *adc, int raw)
+{
+	int mv = DIV_ROUND_CLOSEST(adc->vref_mv * raw, RP1_ADC_FIFO_VAL_MASK);
+
+	/* T = 27 - (ADC_voltage - 0.706)/0.001721 */
+	return 27000 - DIV_ROUND_CLOSEST((mv - 706) * (s64)1000000, 1721);
+}
+
+static int rp1_adc_read_raw(struct iio_dev *indio_dev,
+			    struct iio_chan_spec const *chan,
+			    int *val, int *val2, long mask)
+{
+	struct rp1_adc_iio *adc = iio_priv(indio_dev);
+	u32 div;
+	int ret;
+
+	switch (mask) {
+	case IIO_CHAN_INFO_RAW:
+	case IIO_CHAN_INFO_PROCESSED:
+		ret = iio_device_claim_direct_mode(indio_dev);
+		if (ret)
+			return ret;
+		ret = rp1_adc_read_once(adc, chan->scan_index, val);
+		iio_device_release_direct_mode(indio_dev);
+		if (ret)
+			return ret;
+		if (mask == IIO_CHAN_INFO_PROCESSED)
+			*val = rp1_adc_raw_to_mdegc(adc, *val);
+		return IIO_VAL_INT;
+
+	case IIO_CHAN_INFO_SCALE:
+		*val = adc->vref_mv;
+		*val2 = 12;
+		return IIO_VAL_FRACTIONAL_LOG2;
+
+	case IIO_CHAN_INFO_SAMP_FREQ:
+		div = readl(adc->base + RP1_ADC_DIV) & RP1_ADC_DIV_MASK;
+		/* Conversions run back to back below the conversion time */
+		div = max_t(u32, div, (RP1_ADC_CYCLES - 1) * 256);
+		*val = DIV_ROUND_CLOSEST_ULL((u64)adc->clk_rate * 256,
+					     div + 256);
+		return IIO_VAL_INT;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+static int rp1_adc_write_raw(struct iio_dev *indio_dev,
+			     struct iio_chan_spec const *chan,
+			     int val, int val2, long mask)
+{
+	struct rp1_adc_iio *adc = iio_priv(indio_dev);
+	u64 div;
+
+	if (mask != IIO_CHAN_INFO_SAMP_FREQ)
+		return -EINVAL;
+
+	if (val <= 0 || val > adc->clk_rate / RP1_ADC_CYCLES)
+		return -EINVAL;
+
+	div = DIV_ROUND_CLOSEST_ULL((u64)adc->clk_rate * 256, val) - 256;
+	if (div > RP1_ADC_DIV_MASK)
+		return -EINVAL;
+
+	mutex_lock(&adc->lock);
+	writel(div, adc->base + RP1_ADC_DIV);
+	mutex_unlock(&adc->lock);
+
+	return 0;
+}
+
+static void rp1_adc_stop_many(struct rp1_adc_iio *adc)
+{
+	u32 cs;
+
+	rp1_adc_clr(adc, RP1_ADC_CS, RP1_ADC_CS_START_MANY);
+	readl_poll_timeout_atomic(adc->base + RP1_ADC_CS, cs,
+				  cs & RP1_ADC_CS_READY, 1, 100);
+}
+
+/*
+ * Start free-running conversions from the lowest enabled input, so the
+ * round-robin order matches the order of the samples in a scan.
+ */
+static void rp1_adc_start_many(struct rp1_adc_iio *adc, unsigned long mask)
+{
+	adc->scan_pos = 0;
+	/* Toggling the FIFO enable flushes any stale results */
+	writel(0, adc->base + RP1_ADC_FCS);
+	writel(RP1_ADC_FCS_OVER | RP1_ADC_FCS_UNDER |
+	       FIELD_PREP(RP1_ADC_FCS_THRESH, RP1_ADC_FIFO_THRESH) |
+	       RP1_ADC_FCS_EN, adc->base + RP1_ADC_FCS);
+
+	rp1_adc_clr(adc, RP1_ADC_CS, RP1_ADC_CS_RROBIN | RP1_ADC_CS_AINSEL);
+	rp1_adc_set(adc, RP1_ADC_CS,
+		    FIELD_PREP(RP1_ADC_CS_RROBIN, adc->scan_len > 1 ? mask : 0) |
+		    FIELD_PREP(RP1_ADC_CS_AINSEL, __ffs(mask)) |
+		    RP1_ADC_CS_START_MANY);
+}
+
+static irqreturn_t rp1_adc_fifo_irq(int irq, void *dev_id)
+{
+	struct iio_dev *indio_dev = dev_id;
+	struct rp1_adc_iio *adc = iio_priv(indio_dev);
+	u32 fcs;
+
+	fcs = readl(adc->base + RP1_ADC_FCS);
+	if (fcs & RP1_ADC_FCS_OVER) {
+		/*
+		 * The results carry no channel number, so after losing some
+		 * the only way back into step is to restart the sequence.
+		 */
+		dev_warn_ratelimited(indio_dev->dev.parent, "FIFO overflow\n");
+		mutex_lock(&adc->lock);
+		/* Unless the buffer was disabled meanwhile */
+		if (readl(adc->base + RP1_ADC_INTE)) {
+			rp1_adc_stop_many(adc);
+			rp1_adc_start_many(adc, *indio_dev->active_scan_mask);
+		}
+		mutex_unlock(&adc->lock);
+		return IRQ_HANDLED;
+	}
+
+	while (!(fcs & RP1_ADC_FCS_EMPTY)) {
+		adc->scan.data[adc->scan_pos++] =
+			readl(adc->base + RP1_ADC_FIFO) & RP1_ADC_FIFO_VAL_MASK;
+		if (adc->scan_pos == adc->scan_len) {
+			iio_push_to_buffers_with_timestamp(indio_dev, &adc->scan,
+							   iio_get_time_ns(indio_dev));
+			adc->scan_pos = 0;
+		}
+		fcs = readl(adc->base + RP1_ADC_FCS);
+	}
+
+	return IRQ_HANDLED;
+}
+
+static int rp1_adc_buffer_postenable(struct iio_dev *indio_dev)
+{
+	struct rp1_adc_iio *adc = iio_priv(indio_dev);
+	unsigned long mask = *indio_dev->active_scan_mask &
+			     GENMASK(RP1_ADC_NUM_CHANNELS - 1, 0);
+
+	if (!mask)
+		return -EINVAL;
+
+	mutex_lock(&adc->lock);
+
+	adc->scan_len = hweight_long(mask);
+	if (mask & BIT(RP1_ADC_TEMP_CHANNEL))
+		rp1_adc_set(adc, RP1_ADC_CS, RP1_ADC_CS_TS_EN);
+
+	rp1_adc_start_many(adc, mask);
+	writel(RP1_ADC_INT_FIFO, adc->base + RP1_ADC_INTE);
+
+	mutex_unlock(&adc->lock);
+
+	return 0;
+}
+
+static int rp1_adc_buffer_predisable(struct iio_dev *indio_dev)
+{
+	struct rp1_adc_iio *adc = iio_priv(indio_dev);
+
+	mutex_lock(&adc->lock);
+
+	writel(0, adc->base + RP1_ADC_INTE);
+	rp1_adc_stop_many(adc);
+	writel(0, adc->base + RP1_ADC_FCS);
+	rp1_adc_clr(adc, RP1_ADC_CS, RP1_ADC_CS_RROBIN);
+
+	mutex_unlock(&adc->lock);
+
+	return 0;
+}
+
+static const struct iio_buffer_setup_ops rp1_adc_buffer_ops = {
+	.postenable = rp1_adc_buffer_postenable,
+	.predisable = rp1_adc_buffer_predisable,
+};
+
+static const struct iio_info rp1_adc_info = {
+	.read_raw = rp1_adc_read_raw,
+	.write_raw = rp1_adc_write_raw,
+};
+
+static int rp1_adc_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct iio_dev *indio_dev;
+	struct rp1_adc_iio *adc;
+	struct regulator *reg;
+	struct clk *clk;
+	int irq, ret;
+
+	indio_dev = devm_iio_device_alloc(dev, sizeof(*adc));
+	if (!indio_dev)
+		return -ENOMEM;
+
+	adc = iio_priv(indio_dev);
+	mutex_init(&adc->lock);
+
+	adc->base = devm_platform_ioremap_resource(pdev, 0);
+	if (IS_ERR(adc->base))
+		return PTR_ERR(adc->base);
+
+	clk = devm_clk_get_enabled(dev, NULL);
+	if (IS_ERR(clk))
+		return dev_err_probe(dev, PTR_ERR(clk), "failed to get clock\n");
+
+	ret = clk_set_rate(clk, RP1_ADC_CLK_RATE);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to set clock rate\n");
+
+	adc->clk_rate = clk_get_rate(clk);
+	if (!adc->clk_rate)
+		return -EINVAL;
+
+	reg = devm_regulator_get(dev, "vref");
+	if (IS_ERR(reg))
+		return PTR_ERR(reg);
+
+	ret = regulator_get_voltage(reg);
+	if (ret < 0)
+		return ret;
+	adc->vref_mv = DIV_ROUND_CLOSEST(ret, 1000);
+
+	/* Disable interrupts and the FIFO */
+	writel(0, adc->base + RP1_ADC_INTE);
+	writel(0, adc->base + RP1_ADC_FCS);
+
+	/* Enable the block, clearing any sticky error */
+	writel(RP1_ADC_CS_EN | RP1_ADC_CS_ERR_STICKY, adc->base + RP1_ADC_CS);
+
+	indio_dev->name = "rp1-adc";
+	indio_dev->info = &rp1_adc_info;
+	indio_dev->modes = INDIO_DIRECT_MODE;
+	indio_dev->channels = rp1_adc_channels;
+	indio_dev->num_channels = ARRAY_SIZE(rp1_adc_channels);
+
+	irq = platform_get_irq_optional(pdev, 0);
+	if (irq > 0) {
+		/* Threaded, so that restarting can take the lock */
+		ret = devm_request_threaded_irq(dev, irq, NULL,
+						rp1_adc_fifo_irq, IRQF_ONESHOT,
+						MODULE_NAME, indio_dev);
+		if (ret)
+			return ret;
+
+		ret = devm_iio_kfifo_buffer_setup(dev, indio_dev,
+						  &rp1_adc_buffer_ops);
+		if (ret)
+			return ret;
+	} else if (irq != -ENXIO) {
+		return irq;
+	}
+
+	return devm_iio_device_register(dev, indio_dev);
+}
+
+static const struct of_device_id rp1_adc_dt_ids[] = {
+	{ .compatible = "raspberrypi,rp1-adc", },
+	{ }
+};
+MODULE_DEVICE_TABLE(of, rp1_adc_dt_ids);
+
+static struct platform_driver rp1_adc_driver = {
+	.probe		= rp1_adc_probe,
+	.driver		= {
+		.name	= MODULE_NAME,
+		.of_match_table = rp1_adc_dt_ids,
+	},
+};
+module_platform_driver(rp1_adc_driver);
+
+MODULE_DESCRIPTION("RP1 ADC IIO driver");
+MODULE_LICENSE("GPL");
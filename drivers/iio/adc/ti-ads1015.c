@@ -291,11 +291,23 @@ static const struct regmap_access_table ads1015_writeable_table = {
 	.n_yes_ranges = ARRAY_SIZE(ads1015_writeable_ranges),
 };
 
+/*
+ * Only the conversion register changes behind our back. Caching the others
+ * saves reading back the config register for every conversion, so a triggered
+ * read is a single combined I2C transfer.
+ */
+static bool ads1015_volatile_reg(struct device *dev, unsigned int reg)
+{
+	return reg == ADS1015_CONV_REG;
+}
+
 static const struct regmap_config ads1015_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 16,
 	.max_register = ADS1015_HI_THRESH_REG,
 	.wr_table = &ads1015_writeable_table,
+	.volatile_reg = ads1015_volatile_reg,
+	.cache_type = REGCACHE_RBTREE,
 };
 
 static const struct regmap_range tla2024_writeable_ranges[] = {
@@ -312,6 +324,8 @@ static const struct regmap_config tla2024_regmap_config = {
 	.val_bits = 16,
 	.max_register = ADS1015_CFG_REG,
 	.wr_table = &tla2024_writeable_table,
+	.volatile_reg = ads1015_volatile_reg,
+	.cache_type = REGCACHE_RBTREE,
 };
 
 static const struct iio_chan_spec ads1015_channels[] = {
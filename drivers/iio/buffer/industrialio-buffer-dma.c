@@ -15,8 +15,12 @@
 #include <linux/iio/buffer_impl.h>
 #include <linux/iio/buffer-dma.h>
 #include <linux/dma-mapping.h>
+#include <linux/mm.h>
 #include <linux/sizes.h>
 
+/* Upper limit for the number of blocks of the mmap block interface */
+#define IIO_DMA_BUFFER_MAX_BLOCKS 64
+
 /*
  * For DMA buffers the storage is sub-divided into so called blocks. Each block
  * has its own memory buffer. The size of the block is the granularity at which
@@ -82,6 +86,14 @@
  * It will be called when the buffer is disabled and can be used to cancel
  * pending and stop active transfers.
  *
+ * Instead of read() an application can also use the mmap block interface. It
+ * allocates a number of blocks with IIO_BUFFER_BLOCK_ALLOC_IOCTL, maps them
+ * into its address space and exchanges them with the queue using the enqueue
+ * and dequeue ioctls. Blocks handed back to the queue go straight to the
+ * incoming queue or the DMA controller, so the samples are never copied. While
+ * blocks are allocated this way the fileio blocks are released and read()
+ * fails with -EBUSY.
+ *
  * The specific driver implementation should use the default callback
  * implementations provided by this module for the iio_buffer_access_funcs
  * struct. It may overload some callbacks with custom variants if the hardware
@@ -296,6 +308,10 @@ int iio_dma_buffer_request_update(struct iio_buffer *buffer)
 
 	mutex_lock(&queue->lock);
 
+	/* The application manages the blocks itself */
+	if (queue->num_blocks)
+		goto out_unlock;
+
 	/* Allocations are page aligned */
 	if (PAGE_ALIGN(queue->fileio.block_size) == PAGE_ALIGN(size))
 		try_reuse = true;
@@ -490,6 +506,11 @@ int iio_dma_buffer_read(struct iio_buffer *buffer, size_t n,
 
 	mutex_lock(&queue->lock);
 
+	if (queue->num_blocks) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
 	if (!queue->fileio.active_block) {
 		block = iio_dma_buffer_dequeue(queue);
 		if (block == NULL) {
@@ -527,6 +548,324 @@ int iio_dma_buffer_read(struct iio_buffer *buffer, size_t n,
 }
 EXPORT_SYMBOL_GPL(iio_dma_buffer_read);
 
+static void iio_dma_buffer_fileio_free(struct iio_dma_buffer_queue *queue)
+{
+	unsigned int i;
+
+	spin_lock_irq(&queue->list_lock);
+	for (i = 0; i < ARRAY_SIZE(queue->fileio.blocks); i++) {
+		if (!queue->fileio.blocks[i])
+			continue;
+		queue->fileio.blocks[i]->state = IIO_BLOCK_STATE_DEAD;
+	}
+	INIT_LIST_HEAD(&queue->outgoing);
+	spin_unlock_irq(&queue->list_lock);
+
+	INIT_LIST_HEAD(&queue->incoming);
+
+	for (i = 0; i < ARRAY_SIZE(queue->fileio.blocks); i++) {
+		if (!queue->fileio.blocks[i])
+			continue;
+		iio_buffer_block_put(queue->fileio.blocks[i]);
+		queue->fileio.blocks[i] = NULL;
+	}
+	queue->fileio.active_block = NULL;
+	queue->fileio.block_size = 0;
+}
+
+static void iio_dma_buffer_blocks_free(struct iio_dma_buffer_queue *queue)
+{
+	unsigned int i;
+
+	spin_lock_irq(&queue->list_lock);
+	for (i = 0; i < queue->num_blocks; i++)
+		queue->blocks[i]->state = IIO_BLOCK_STATE_DEAD;
+	INIT_LIST_HEAD(&queue->outgoing);
+	spin_unlock_irq(&queue->list_lock);
+
+	INIT_LIST_HEAD(&queue->incoming);
+
+	/* Blocks that are still mapped are freed once they get unmapped */
+	for (i = 0; i < queue->num_blocks; i++)
+		iio_buffer_block_put(queue->blocks[i]);
+
+	kfree(queue->blocks);
+	queue->blocks = NULL;
+	queue->num_blocks = 0;
+}
+
+/**
+ * iio_dma_buffer_alloc_blocks() - DMA buffer alloc_blocks callback
+ * @buffer: Buffer to allocate the blocks for
+ * @req: Allocation request, the count is updated with the number of blocks
+ *   that were allocated
+ *
+ * Should be used as the alloc_blocks callback for iio_buffer_access_ops
+ * struct for DMA buffers. The buffer must not be enabled. The new blocks are
+ * owned by the application and have to be enqueued before they are filled.
+ */
+int iio_dma_buffer_alloc_blocks(struct iio_buffer *buffer,
+	struct iio_buffer_block_alloc_req *req)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block **blocks;
+	unsigned int count, i;
+	int ret = 0;
+
+	if (!req->size || !req->count)
+		return -EINVAL;
+
+	count = min_t(unsigned int, req->count, IIO_DMA_BUFFER_MAX_BLOCKS);
+
+	/* Keep the mmap offsets of all blocks within the 32 bit descriptor */
+	if ((u64)PAGE_ALIGN(req->size) * count > U32_MAX)
+		return -EINVAL;
+
+	mutex_lock(&queue->lock);
+
+	if (queue->num_blocks) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	blocks = kcalloc(count, sizeof(*blocks), GFP_KERNEL);
+	if (!blocks) {
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+
+	for (i = 0; i < count; i++) {
+		blocks[i] = iio_dma_buffer_alloc_block(queue, req->size);
+		if (!blocks[i])
+			break;
+		blocks[i]->id = i;
+	}
+
+	if (!i) {
+		kfree(blocks);
+		ret = -ENOMEM;
+		goto out_unlock;
+	}
+
+	/* From here on the application owns the memory */
+	iio_dma_buffer_fileio_free(queue);
+
+	queue->blocks = blocks;
+	queue->num_blocks = i;
+	req->count = i;
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_alloc_blocks);
+
+/**
+ * iio_dma_buffer_free_blocks() - DMA buffer free_blocks callback
+ * @buffer: Buffer to free the blocks of
+ *
+ * Should be used as the free_blocks callback for iio_buffer_access_ops
+ * struct for DMA buffers. Afterwards the buffer can be read with read() again.
+ */
+int iio_dma_buffer_free_blocks(struct iio_buffer *buffer)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+
+	mutex_lock(&queue->lock);
+	iio_dma_buffer_blocks_free(queue);
+	mutex_unlock(&queue->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_free_blocks);
+
+static void iio_dma_buffer_block_to_desc(struct iio_dma_buffer_block *block,
+	struct iio_buffer_block *desc)
+{
+	desc->id = block->id;
+	desc->size = block->size;
+	desc->bytes_used = block->bytes_used;
+	desc->type = 0;
+	desc->flags = 0;
+	desc->offset = block->id * PAGE_ALIGN(block->size);
+	desc->reserved = 0;
+}
+
+/**
+ * iio_dma_buffer_query_block() - DMA buffer query_block callback
+ * @buffer: Buffer the block belongs to
+ * @desc: Block descriptor, filled in based on its id
+ *
+ * Should be used as the query_block callback for iio_buffer_access_ops
+ * struct for DMA buffers.
+ */
+int iio_dma_buffer_query_block(struct iio_buffer *buffer,
+	struct iio_buffer_block *desc)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+	if (desc->id >= queue->num_blocks)
+		ret = -EINVAL;
+	else
+		iio_dma_buffer_block_to_desc(queue->blocks[desc->id], desc);
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_query_block);
+
+/**
+ * iio_dma_buffer_enqueue_block() - DMA buffer enqueue_block callback
+ * @buffer: Buffer the block belongs to
+ * @desc: Descriptor of the block to hand back to the buffer
+ *
+ * Should be used as the enqueue_block callback for iio_buffer_access_ops
+ * struct for DMA buffers. If the buffer is enabled the block is submitted to
+ * the DMA controller right away.
+ */
+int iio_dma_buffer_enqueue_block(struct iio_buffer *buffer,
+	struct iio_buffer_block *desc)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+
+	if (desc->id >= queue->num_blocks) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	block = queue->blocks[desc->id];
+
+	/* Only blocks owned by the application can be enqueued */
+	if (block->state != IIO_BLOCK_STATE_DEQUEUED) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	block->bytes_used = block->size;
+	iio_dma_buffer_block_to_desc(block, desc);
+	iio_dma_buffer_enqueue(queue, block);
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_enqueue_block);
+
+/**
+ * iio_dma_buffer_dequeue_block() - DMA buffer dequeue_block callback
+ * @buffer: Buffer to dequeue the block from
+ * @desc: Filled in with the descriptor of the dequeued block
+ *
+ * Should be used as the dequeue_block callback for iio_buffer_access_ops
+ * struct for DMA buffers. Returns -EAGAIN if no block has been completed yet.
+ */
+int iio_dma_buffer_dequeue_block(struct iio_buffer *buffer,
+	struct iio_buffer_block *desc)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	struct iio_dma_buffer_block *block;
+	int ret = 0;
+
+	mutex_lock(&queue->lock);
+
+	if (!queue->num_blocks) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	block = iio_dma_buffer_dequeue(queue);
+	if (!block) {
+		ret = -EAGAIN;
+		goto out_unlock;
+	}
+
+	iio_dma_buffer_block_to_desc(block, desc);
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_dequeue_block);
+
+static void iio_dma_buffer_vm_open(struct vm_area_struct *vma)
+{
+	iio_buffer_block_get(vma->vm_private_data);
+}
+
+static void iio_dma_buffer_vm_close(struct vm_area_struct *vma)
+{
+	iio_buffer_block_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct iio_dma_buffer_vm_ops = {
+	.open = iio_dma_buffer_vm_open,
+	.close = iio_dma_buffer_vm_close,
+};
+
+/**
+ * iio_dma_buffer_mmap() - DMA buffer mmap callback
+ * @buffer: Buffer the block belongs to
+ * @vma: VMA to map the block to, the offset selects the block
+ *
+ * Should be used as the mmap callback for iio_buffer_access_ops struct for DMA
+ * buffers. The mapping keeps a reference to the block, so the memory stays
+ * valid until it is unmapped even if the blocks are freed in the meantime.
+ */
+int iio_dma_buffer_mmap(struct iio_buffer *buffer,
+	struct vm_area_struct *vma)
+{
+	struct iio_dma_buffer_queue *queue = iio_buffer_to_queue(buffer);
+	unsigned long size = vma->vm_end - vma->vm_start;
+	struct iio_dma_buffer_block *block;
+	size_t block_size;
+	unsigned long id;
+	int ret;
+
+	mutex_lock(&queue->lock);
+
+	if (!queue->num_blocks) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	block_size = PAGE_ALIGN(queue->blocks[0]->size);
+	id = (vma->vm_pgoff << PAGE_SHIFT) / block_size;
+	if ((vma->vm_pgoff << PAGE_SHIFT) % block_size ||
+	    id >= queue->num_blocks || size > block_size) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	block = queue->blocks[id];
+
+	/* dma_mmap_coherent() takes the offset relative to the block */
+	vma->vm_pgoff = 0;
+	vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+	ret = dma_mmap_coherent(queue->dev, vma, block->vaddr,
+				block->phys_addr, size);
+	if (ret)
+		goto out_unlock;
+
+	vma->vm_ops = &iio_dma_buffer_vm_ops;
+	vma->vm_private_data = block;
+	iio_buffer_block_get(block);
+
+out_unlock:
+	mutex_unlock(&queue->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(iio_dma_buffer_mmap);
+
 /**
  * iio_dma_buffer_data_available() - DMA buffer data_available callback
  * @buf: Buffer to check for data availability
@@ -635,28 +974,10 @@ EXPORT_SYMBOL_GPL(iio_dma_buffer_init);
  */
 void iio_dma_buffer_exit(struct iio_dma_buffer_queue *queue)
 {
-	unsigned int i;
-
 	mutex_lock(&queue->lock);
 
-	spin_lock_irq(&queue->list_lock);
-	for (i = 0; i < ARRAY_SIZE(queue->fileio.blocks); i++) {
-		if (!queue->fileio.blocks[i])
-			continue;
-		queue->fileio.blocks[i]->state = IIO_BLOCK_STATE_DEAD;
-	}
-	INIT_LIST_HEAD(&queue->outgoing);
-	spin_unlock_irq(&queue->list_lock);
-
-	INIT_LIST_HEAD(&queue->incoming);
-
-	for (i = 0; i < ARRAY_SIZE(queue->fileio.blocks); i++) {
-		if (!queue->fileio.blocks[i])
-			continue;
-		iio_buffer_block_put(queue->fileio.blocks[i]);
-		queue->fileio.blocks[i] = NULL;
-	}
-	queue->fileio.active_block = NULL;
+	iio_dma_buffer_fileio_free(queue);
+	iio_dma_buffer_blocks_free(queue);
 	queue->ops = NULL;
 
 	mutex_unlock(&queue->lock);
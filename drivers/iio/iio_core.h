@@ -60,6 +60,8 @@ ssize_t iio_format_value(char *buf, unsigned int type, int size, int *vals);
 
 /* Event interface flags */
 #define IIO_BUSY_BIT_POS 1
+/* Buffer has blocks allocated through the mmap block interface */
+#define IIO_BLOCKS_BIT_POS 2
 
 #ifdef CONFIG_IIO_BUFFER
 struct poll_table_struct;
@@ -17,6 +17,7 @@
 #include <linux/fs.h>
 #include <linux/cdev.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <linux/poll.h>
 #include <linux/sched/signal.h>
 
@@ -1511,6 +1512,23 @@ static int iio_buffer_chrdev_release(struct inode *inode, struct file *filep)
 
 	wake_up(&buffer->pollq);
 
+	/*
+	 * Give the memory of the mmap block interface back to read(). The
+	 * blocks may still be queued to the DMA controller, so stop the buffer
+	 * first.
+	 */
+	if (test_and_clear_bit(IIO_BLOCKS_BIT_POS, &buffer->flags)) {
+		struct iio_dev_opaque *iio_dev_opaque = to_iio_dev_opaque(indio_dev);
+
+		mutex_lock(&iio_dev_opaque->info_exist_lock);
+		mutex_lock(&iio_dev_opaque->mlock);
+		if (indio_dev->info && iio_buffer_is_active(buffer))
+			__iio_update_buffers(indio_dev, NULL, buffer);
+		buffer->access->free_blocks(buffer);
+		mutex_unlock(&iio_dev_opaque->mlock);
+		mutex_unlock(&iio_dev_opaque->info_exist_lock);
+	}
+
 	kfree(ib);
 	clear_bit(IIO_BUSY_BIT_POS, &buffer->flags);
 	iio_device_put(indio_dev);
@@ -1518,12 +1536,170 @@ static int iio_buffer_chrdev_release(struct inode *inode, struct file *filep)
 	return 0;
 }
 
+static int iio_buffer_alloc_blocks(struct iio_dev *indio_dev,
+				   struct iio_buffer *rb, void __user *arg)
+{
+	struct iio_dev_opaque *iio_dev_opaque = to_iio_dev_opaque(indio_dev);
+	struct iio_buffer_block_alloc_req req;
+	int ret;
+
+	if (copy_from_user(&req, arg, sizeof(req)))
+		return -EFAULT;
+
+	if (req.type || req.id)
+		return -EINVAL;
+
+	mutex_lock(&iio_dev_opaque->mlock);
+	if (iio_buffer_is_active(rb))
+		ret = -EBUSY;
+	else
+		ret = rb->access->alloc_blocks(rb, &req);
+	if (!ret)
+		set_bit(IIO_BLOCKS_BIT_POS, &rb->flags);
+	mutex_unlock(&iio_dev_opaque->mlock);
+	if (ret)
+		return ret;
+
+	if (copy_to_user(arg, &req, sizeof(req)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int iio_buffer_free_blocks(struct iio_dev *indio_dev,
+				  struct iio_buffer *rb)
+{
+	struct iio_dev_opaque *iio_dev_opaque = to_iio_dev_opaque(indio_dev);
+	int ret;
+
+	mutex_lock(&iio_dev_opaque->mlock);
+	if (iio_buffer_is_active(rb))
+		ret = -EBUSY;
+	else
+		ret = rb->access->free_blocks(rb);
+	if (!ret)
+		clear_bit(IIO_BLOCKS_BIT_POS, &rb->flags);
+	mutex_unlock(&iio_dev_opaque->mlock);
+
+	return ret;
+}
+
+static int iio_buffer_dequeue_block(struct iio_dev *indio_dev,
+				    struct file *filp, struct iio_buffer *rb,
+				    struct iio_buffer_block *block)
+{
+	DEFINE_WAIT_FUNC(wait, woken_wake_function);
+	int ret;
+
+	add_wait_queue(&rb->pollq, &wait);
+	do {
+		if (!indio_dev->info) {
+			ret = -ENODEV;
+			break;
+		}
+
+		ret = rb->access->dequeue_block(rb, block);
+		if (ret != -EAGAIN || (filp->f_flags & O_NONBLOCK))
+			break;
+
+		if (signal_pending(current)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+
+		wait_woken(&wait, TASK_INTERRUPTIBLE, MAX_SCHEDULE_TIMEOUT);
+	} while (1);
+	remove_wait_queue(&rb->pollq, &wait);
+
+	return ret;
+}
+
+/**
+ * iio_buffer_chrdev_ioctl() - ioctl handler for the block based buffer access
+ * @filp:	File structure pointer for the buffer fd
+ * @cmd:	ioctl command
+ * @arg:	ioctl argument
+ *
+ * Blocks are allocated with IIO_BUFFER_BLOCK_ALLOC_IOCTL, mapped into user
+ * space with mmap() at the offset reported by IIO_BUFFER_BLOCK_QUERY_IOCTL and
+ * then exchanged with the buffer using IIO_BUFFER_BLOCK_ENQUEUE_IOCTL and
+ * IIO_BUFFER_BLOCK_DEQUEUE_IOCTL. The samples never get copied.
+ *
+ * Return: 0 on success, negative error code otherwise
+ */
+static long iio_buffer_chrdev_ioctl(struct file *filp, unsigned int cmd,
+				    unsigned long arg)
+{
+	struct iio_dev_buffer_pair *ib = filp->private_data;
+	struct iio_buffer *rb = ib->buffer;
+	struct iio_dev *indio_dev = ib->indio_dev;
+	void __user *uarg = (void __user *)arg;
+	struct iio_buffer_block block;
+	int ret;
+
+	if (!indio_dev->info)
+		return -ENODEV;
+
+	if (!rb->access->alloc_blocks)
+		return -ENOTTY;
+
+	switch (cmd) {
+	case IIO_BUFFER_BLOCK_ALLOC_IOCTL:
+		return iio_buffer_alloc_blocks(indio_dev, rb, uarg);
+	case IIO_BUFFER_BLOCK_FREE_IOCTL:
+		return iio_buffer_free_blocks(indio_dev, rb);
+	case IIO_BUFFER_BLOCK_QUERY_IOCTL:
+	case IIO_BUFFER_BLOCK_ENQUEUE_IOCTL:
+		if (copy_from_user(&block, uarg, sizeof(block)))
+			return -EFAULT;
+
+		if (cmd == IIO_BUFFER_BLOCK_QUERY_IOCTL)
+			ret = rb->access->query_block(rb, &block);
+		else
+			ret = rb->access->enqueue_block(rb, &block);
+		break;
+	case IIO_BUFFER_BLOCK_DEQUEUE_IOCTL:
+		ret = iio_buffer_dequeue_block(indio_dev, filp, rb, &block);
+		break;
+	default:
+		return -ENOTTY;
+	}
+
+	if (ret)
+		return ret;
+
+	if (copy_to_user(uarg, &block, sizeof(block)))
+		return -EFAULT;
+
+	return 0;
+}
+
+static int iio_buffer_chrdev_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct iio_dev_buffer_pair *ib = filp->private_data;
+	struct iio_buffer *rb = ib->buffer;
+
+	if (!ib->indio_dev->info)
+		return -ENODEV;
+
+	if (!rb->access->mmap)
+		return -ENODEV;
+
+	if (!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	return rb->access->mmap(rb, vma);
+}
+
 static const struct file_operations iio_buffer_chrdev_fileops = {
 	.owner = THIS_MODULE,
 	.llseek = noop_llseek,
 	.read = iio_buffer_read,
 	.write = iio_buffer_write,
 	.poll = iio_buffer_poll,
+	.unlocked_ioctl = iio_buffer_chrdev_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap = iio_buffer_chrdev_mmap,
 	.release = iio_buffer_chrdev_release,
 };
 
@@ -144,6 +144,7 @@ struct edt_ft5x06_ts_data {
 	u8 tdata_cmd;
 	int tdata_len;
 	int tdata_offset;
+	int last_num_points;
 	unsigned int known_ids;
 
 	char name[EDT_NAME_PREFIX_LEN + EDT_NAME_LEN];
@@ -319,11 +320,23 @@ static irqreturn_t edt_ft5x06_ts_isr(int irq, void *dev_id)
 	int b = 0;
 
 	memset(rdbuf, 0, sizeof(rdbuf));
-	error = regmap_bulk_read(tsdata->regmap, tsdata->tdata_cmd, rdbuf,
-				 tsdata->tdata_len);
 	if (tsdata->version == EDT_M06) {
+		error = regmap_bulk_read(tsdata->regmap, tsdata->tdata_cmd,
+					 rdbuf, tsdata->tdata_len);
 		num_points = tsdata->max_support_points;
 	} else {
+		/*
+		 * The number of touch points rarely changes from one report
+		 * to the next, so read as many points as last time together
+		 * with the header. A second transfer is only needed for the
+		 * points that were added since.
+		 */
+		int prefetched = max(1, tsdata->last_num_points);
+
+		error = regmap_bulk_read(tsdata->regmap, tsdata->tdata_cmd,
+					 rdbuf, tsdata->tdata_len +
+					 tsdata->point_len * prefetched);
+
 		/* Register 2 is TD_STATUS, containing the number of touch
 		 * points.
 		 */
@@ -343,11 +356,18 @@ static irqreturn_t edt_ft5x06_ts_isr(int irq, void *dev_id)
 			tsdata->init_td_status = 0;
 		}
 
-		if (!error && num_points)
-			error = regmap_bulk_read(tsdata->regmap,
-						 tsdata->tdata_offset,
-						 &rdbuf[tsdata->tdata_offset],
-						 tsdata->point_len * num_points);
+		if (!error && num_points > prefetched) {
+			int offset = tsdata->tdata_offset +
+				     tsdata->point_len * prefetched;
+
+			error = regmap_bulk_read(tsdata->regmap, offset,
+						 &rdbuf[offset],
+						 tsdata->point_len *
+						 (num_points - prefetched));
+		}
+
+		if (!error)
+			tsdata->last_num_points = num_points;
 	}
 	if (error) {
 		dev_err_ratelimited(dev, "Unable to fetch data, error: %d\n",
@@ -255,13 +255,17 @@ static int goodix_ts_read_input_report(struct goodix_ts_data *ts, u8 *data)
 	unsigned long max_timeout;
 	int touch_num;
 	int error;
-	u16 addr = GOODIX_READ_COOR_ADDR;
 	/*
 	 * We are going to read 1-byte header,
 	 * ts->contact_size * max(1, touch_num) bytes of coordinates
 	 * and 1-byte footer which contains the touch-key code.
+	 *
+	 * The number of contacts rarely changes between two reports, so
+	 * read as many as were reported last time along with the header.
+	 * Only a report with more contacts needs a second transfer.
 	 */
-	const int header_contact_keycode_size = 1 + ts->contact_size + 1;
+	const int prefetch_size = 1 + ts->contact_size *
+				  max(1U, ts->last_touch_num) + 1;
 
 	/*
 	 * The 'buffer status' bit, which indicates that the data is valid, is
@@ -270,27 +274,30 @@ static int goodix_ts_read_input_report(struct goodix_ts_data *ts, u8 *data)
 	 */
 	max_timeout = jiffies + msecs_to_jiffies(GOODIX_BUFFER_STATUS_TIMEOUT);
 	do {
-		error = goodix_i2c_read(ts->client, addr, data,
-					header_contact_keycode_size);
+		error = goodix_i2c_read(ts->client, GOODIX_READ_COOR_ADDR,
+					data, prefetch_size);
 		if (error)
 			return error;
 
 		if (data[0] & GOODIX_BUFFER_STATUS_READY) {
+			int report_size;
+
 			touch_num = data[0] & 0x0f;
 			if (touch_num > ts->max_touch_num)
 				return -EPROTO;
 
-			if (touch_num > 1) {
-				addr += header_contact_keycode_size;
-				data += header_contact_keycode_size;
+			report_size = 1 + ts->contact_size * touch_num + 1;
+			if (report_size > prefetch_size) {
 				error = goodix_i2c_read(ts->client,
-						addr, data,
-						ts->contact_size *
-							(touch_num - 1));
+						GOODIX_READ_COOR_ADDR +
+							prefetch_size,
+						data + prefetch_size,
+						report_size - prefetch_size);
 				if (error)
 					return error;
 			}
 
+			ts->last_touch_num = touch_num;
 			return touch_num;
 		}
 
@@ -3,12 +3,16 @@
  * Copyright (C) 2021 Raspberry Pi Ltd., All Rights Reserved.
  */
 
+#include <linux/debugfs.h>
+#include <linux/init.h>
+#include <linux/kernel_stat.h>
 #include <linux/pci.h>
 #include <linux/msi.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/of_pci.h>
+#include <linux/seq_file.h>
 
 #include <linux/irqchip.h>
 
@@ -26,6 +30,9 @@
 #define MIP_INT_STATUSH_VPU	0xb0
 
 struct mip_priv {
+	struct list_head list;
+	struct device_node *node;
+	struct irq_domain *domain;	/* The middle domain */
 	spinlock_t msi_map_lock;
 	spinlock_t hw_lock;
 	void * __iomem base;
@@ -36,6 +43,9 @@ struct mip_priv {
 	unsigned long *msi_map;
 };
 
+/* All MIPs, for debugfs, which isn't up yet when they are initialised */
+static LIST_HEAD(mip_list);
+
 static void mip_mask_msi_irq(struct irq_data *d)
 {
 	pci_msi_mask_irq(d);
@@ -99,7 +109,8 @@ static int mip_irq_domain_alloc(struct irq_domain *domain,
 
 	spin_lock(&priv->msi_map_lock);
 
-	hwirq = bitmap_find_free_region(priv->msi_map, priv->num_msis, ilog2(nr_irqs));
+	hwirq = bitmap_find_free_region(priv->msi_map, priv->num_msis,
+					order_base_2(nr_irqs));
 
 	spin_unlock(&priv->msi_map_lock);
 
@@ -136,13 +147,13 @@ static void mip_irq_domain_free(struct irq_domain *domain,
 {
 	struct irq_data *d = irq_domain_get_irq_data(domain, virq);
 	struct mip_priv *priv = irq_data_get_irq_chip_data(d);
+	unsigned int hwirq = d->hwirq - priv->msi_offset;
 
 	irq_domain_free_irqs_parent(domain, virq, nr_irqs);
-	d->hwirq -= priv->msi_offset;
 
 	spin_lock(&priv->msi_map_lock);
 
-	bitmap_release_region(priv->msi_map, d->hwirq, ilog2(nr_irqs));
+	bitmap_release_region(priv->msi_map, hwirq, order_base_2(nr_irqs));
 
 	spin_unlock(&priv->msi_map_lock);
 }
@@ -226,8 +237,60 @@ static int mip_init_domains(struct mip_priv *priv,
 		return -ENOMEM;
 	}
 
+	priv->domain = middle_domain;
+
+	return 0;
+}
+
+/*
+ * Each MSI is its own GIC SPI, so can be steered to any CPU independently of
+ * the others through its affinity, and this shows where each one currently
+ * goes and how often it has fired.
+ */
+static int mip_vectors_show(struct seq_file *s, void *data)
+{
+	struct mip_priv *priv = s->private;
+	unsigned int i;
+
+	seq_puts(s, "hwirq  spi  irq  cpus    count\n");
+
+	for (i = 0; i < priv->num_msis; i++) {
+		unsigned int hwirq = i + priv->msi_offset;
+		struct irq_data *d;
+		unsigned int irq;
+
+		irq = irq_find_mapping(priv->domain, hwirq);
+		if (!irq)
+			continue;
+
+		d = irq_get_irq_data(irq);
+		seq_printf(s, "%5u %4u %4u  %-6.*pbl %u\n", hwirq,
+			   hwirq + priv->msi_base, irq,
+			   cpumask_pr_args(irq_data_get_effective_affinity_mask(d)),
+			   kstat_irqs_usr(irq));
+	}
+
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(mip_vectors);
+
+static int __init mip_debugfs_init(void)
+{
+	struct dentry *dir;
+	struct mip_priv *priv;
+
+	if (list_empty(&mip_list))
+		return 0;
+
+	dir = debugfs_create_dir("bcm2712-mip", NULL);
+	list_for_each_entry(priv, &mip_list, list)
+		debugfs_create_file(of_node_full_name(priv->node), 0444, dir,
+				    priv, &mip_vectors_fops);
+
 	return 0;
 }
+late_initcall(mip_debugfs_init);
 
 static int __init mip_of_msi_init(struct device_node *node,
 				  struct device_node *parent)
@@ -305,6 +368,9 @@ static int __init mip_of_msi_init(struct device_node *node,
 		goto err_map;
 	}
 
+	priv->node = of_node_get(node);
+	list_add_tail(&priv->list, &mip_list);
+
 	return 0;
 
 err_map:
@@ -35,7 +35,13 @@
  * otherwise both handlers will fire at the same time!
  */
 
+#include <linux/debugfs.h>
 #include <linux/io.h>
+#include <linux/jump_label.h>
+#include <linux/log2_hist.h>
+#include <linux/percpu.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
@@ -298,56 +304,214 @@ static int __init bcm2836_armctrl_of_init(struct device_node *node,
  * handle_IRQ may briefly re-enable interrupts for soft IRQ handling.
  */
 
-static u32 armctrl_translate_bank(int bank)
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Optional dispatch statistics: for each source, a log2 histogram of the
+ * time from entering the demux to calling its handler, which covers the
+ * pending register reads and every handler run before it in the same pass.
+ * Bucket 0 is below 256ns, each further bucket doubles, the last is open.
+ */
+#define ARMCTRL_LAT_BUCKETS	12
+#define ARMCTRL_LAT_SHIFT	8
+
+struct armctrl_stats {
+	u32 passes;
+	u32 dispatched;
+	u32 latency[NUMBER_IRQS][ARMCTRL_LAT_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct armctrl_stats, armctrl_stats);
+static DEFINE_STATIC_KEY_FALSE(armctrl_stats_enabled);
+
+static inline u64 armctrl_stats_start(void)
 {
-	u32 stat = readl_relaxed(intc.pending[bank]);
+	if (!static_branch_unlikely(&armctrl_stats_enabled))
+		return 0;
+
+	this_cpu_inc(armctrl_stats.passes);
 
-	return MAKE_HWIRQ(bank, ffs(stat) - 1);
+	return local_clock();
+}
+
+static inline void armctrl_stats_dispatch(u32 hwirq, u64 start)
+{
+	unsigned int bucket;
+
+	if (!static_branch_unlikely(&armctrl_stats_enabled))
+		return;
+
+	bucket = log2_hist_bucket(local_clock() - start, ARMCTRL_LAT_SHIFT,
+				  ARMCTRL_LAT_BUCKETS);
+
+	this_cpu_inc(armctrl_stats.dispatched);
+	this_cpu_inc(armctrl_stats.latency[hwirq][bucket]);
+}
+#else
+static inline u64 armctrl_stats_start(void) { return 0; }
+static inline void armctrl_stats_dispatch(u32 hwirq, u64 start) { }
+#endif
+
+static void armctrl_dispatch_bank(int bank, u32 stat, u64 start)
+{
+	while (stat) {
+		u32 hwirq = MAKE_HWIRQ(bank, __ffs(stat));
+
+		stat &= stat - 1;
+		armctrl_stats_dispatch(hwirq, start);
+		generic_handle_domain_irq(intc.domain, hwirq);
+	}
 }
 
-static u32 armctrl_translate_shortcut(int bank, u32 stat)
+/*
+ * The bank 1/2 sources pending according to the bank 0 register @stat:
+ * its shortcut bits, plus the whole bank register if the bank's summary
+ * bit is set (which it is not for shortcut-only interrupts, see quirk 1).
+ */
+static u32 armctrl_bank_pending(int bank, u32 stat, u32 bank_hwirq,
+				u32 shortcut_mask)
 {
-	return MAKE_HWIRQ(bank, shortcuts[ffs(stat >> SHORTCUT_SHIFT) - 1]);
+	u32 sc = (stat & shortcut_mask) >> SHORTCUT_SHIFT;
+	u32 pending = 0;
+
+	while (sc) {
+		pending |= BIT(shortcuts[__ffs(sc)]);
+		sc &= sc - 1;
+	}
+
+	if (stat & bank_hwirq)
+		pending |= readl_relaxed(intc.pending[bank]);
+
+	return pending;
 }
 
-static u32 get_next_armctrl_hwirq(void)
+/*
+ * Service every source pending at the time of a single read of each
+ * pending register, rather than re-reading bank 0 (and the bank register)
+ * for each interrupt. Returns false if nothing was pending.
+ */
+static bool armctrl_handle_pending(void)
 {
+	u64 start = armctrl_stats_start();
 	u32 stat = readl_relaxed(intc.pending[0]) & BANK0_VALID_MASK;
 
-	if (stat == 0)
-		return ~0;
-	else if (stat & BANK0_HWIRQ_MASK)
-		return MAKE_HWIRQ(0, ffs(stat & BANK0_HWIRQ_MASK) - 1);
-	else if (stat & SHORTCUT1_MASK)
-		return armctrl_translate_shortcut(1, stat & SHORTCUT1_MASK);
-	else if (stat & SHORTCUT2_MASK)
-		return armctrl_translate_shortcut(2, stat & SHORTCUT2_MASK);
-	else if (stat & BANK1_HWIRQ)
-		return armctrl_translate_bank(1);
-	else if (stat & BANK2_HWIRQ)
-		return armctrl_translate_bank(2);
-	else
-		BUG();
+	if (!stat)
+		return false;
+
+	armctrl_dispatch_bank(0, stat & BANK0_HWIRQ_MASK, start);
+	armctrl_dispatch_bank(1, armctrl_bank_pending(1, stat, BANK1_HWIRQ,
+						      SHORTCUT1_MASK), start);
+	armctrl_dispatch_bank(2, armctrl_bank_pending(2, stat, BANK2_HWIRQ,
+						      SHORTCUT2_MASK), start);
+
+	return true;
 }
 
 static void __exception_irq_entry bcm2835_handle_irq(
 	struct pt_regs *regs)
 {
-	u32 hwirq;
-
-	while ((hwirq = get_next_armctrl_hwirq()) != ~0)
-		generic_handle_domain_irq(intc.domain, hwirq);
+	while (armctrl_handle_pending())
+		;
 }
 
 static void bcm2836_chained_handle_irq(struct irq_desc *desc)
 {
-	u32 hwirq;
+	armctrl_handle_pending();
+}
 
-	hwirq = get_next_armctrl_hwirq();
-	if (hwirq != ~0)
-		generic_handle_domain_irq(intc.domain, hwirq);
+#ifdef CONFIG_DEBUG_FS
+static int armctrl_stats_show(struct seq_file *s, void *data)
+{
+	unsigned int hwirq, cpu;
+	int b;
+
+	seq_puts(s, "cpu    passes  dispatched\n");
+	for_each_possible_cpu(cpu) {
+		struct armctrl_stats *st = per_cpu_ptr(&armctrl_stats, cpu);
+
+		seq_printf(s, "%3u %9u %11u\n", cpu, READ_ONCE(st->passes),
+			   READ_ONCE(st->dispatched));
+	}
+
+	seq_puts(s, "\nbank:bit  irq  latency counts (<256ns, <512ns, ... , >=256us)\n");
+	for (hwirq = 0; hwirq < NUMBER_IRQS; hwirq++) {
+		u32 hist[ARMCTRL_LAT_BUCKETS] = { };
+		u32 total = 0;
+
+		for_each_possible_cpu(cpu) {
+			struct armctrl_stats *st = per_cpu_ptr(&armctrl_stats,
+							       cpu);
+
+			for (b = 0; b < ARMCTRL_LAT_BUCKETS; b++) {
+				u32 n = READ_ONCE(st->latency[hwirq][b]);
+
+				hist[b] += n;
+				total += n;
+			}
+		}
+
+		if (!total)
+			continue;
+
+		seq_printf(s, "%4u:%-3u %4u ", HWIRQ_BANK(hwirq), hwirq & 0x1f,
+			   irq_find_mapping(intc.domain, hwirq));
+		for (b = 0; b < ARMCTRL_LAT_BUCKETS; b++)
+			seq_printf(s, " %u", hist[b]);
+		seq_putc(s, '\n');
+	}
+
+	return 0;
 }
 
+DEFINE_SHOW_ATTRIBUTE(armctrl_stats);
+
+static int armctrl_stats_enable_get(void *data, u64 *val)
+{
+	*val = static_key_enabled(&armctrl_stats_enabled);
+
+	return 0;
+}
+
+/* Enabling clears the counters so each run starts from zero */
+static int armctrl_stats_enable_set(void *data, u64 val)
+{
+	unsigned int cpu;
+
+	if (!val) {
+		static_branch_disable(&armctrl_stats_enabled);
+		return 0;
+	}
+
+	if (static_key_enabled(&armctrl_stats_enabled))
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&armctrl_stats, cpu), 0,
+		       sizeof(struct armctrl_stats));
+	static_branch_enable(&armctrl_stats_enabled);
+
+	return 0;
+}
+
+DEFINE_DEBUGFS_ATTRIBUTE(armctrl_stats_enable_fops, armctrl_stats_enable_get,
+			 armctrl_stats_enable_set, "%llu\n");
+
+static int __init armctrl_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	if (!intc.domain)
+		return 0;
+
+	dir = debugfs_create_dir("bcm2835-armctrl", NULL);
+	debugfs_create_file_unsafe("stats_enable", 0644, dir, NULL,
+				   &armctrl_stats_enable_fops);
+	debugfs_create_file("stats", 0444, dir, NULL, &armctrl_stats_fops);
+
+	return 0;
+}
+late_initcall(armctrl_debugfs_init);
+#endif
+
 IRQCHIP_DECLARE(bcm2835_armctrl_ic, "brcm,bcm2835-armctrl-ic",
 		bcm2835_armctrl_of_init);
 IRQCHIP_DECLARE(bcm2836_armctrl_ic, "brcm,bcm2836-armctrl-ic",
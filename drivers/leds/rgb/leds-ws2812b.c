@@ -0,0 +1,308 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * WS2812B-family addressable LED strip driven over SPI
+ *
+ * Every bit sent to the strip is encoded as three SPI bits, 100 for a 0
+ * and 110 for a 1, so with the SPI clock at about 2.5 MHz each SPI bit is
+ * one 400 ns third of the 1.2 us WS2812B bit period. A run of zero bytes
+ * after the pixel data holds the line low long enough for every LED to
+ * latch the frame it has just shifted in.
+ *
+ * Each LED of the strip is its own multicolor LED class device. Brightness
+ * changes only update a back buffer; a worker copies it to the front
+ * buffer and sends the whole strip in a single SPI transfer, so every
+ * change made while a frame is in flight is latched together with the
+ * next one and the strip never shows a half-updated frame.
+ */
+
+#include <linux/bits.h>
+#include <linux/led-class-multicolor.h>
+#include <linux/leds.h>
+#include <linux/mod_devicetable.h>
+#include <linux/module.h>
+#include <linux/property.h>
+#include <linux/spi/spi.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
+
+#define WS2812B_SPI_HZ_MIN		2105000
+#define WS2812B_SPI_HZ_MAX		2850000
+
+/* SPI bytes for one 8-bit colour channel */
+#define WS2812B_BYTES_PER_COLOR		3
+#define WS2812B_MAX_COLORS		4
+
+/* Line held low for at least 280 us latches the frame */
+#define WS2812B_LATCH_US		300
+
+struct ws2812b_priv;
+
+struct ws2812b_led {
+	struct led_classdev_mc mc_cdev;
+	struct mc_subled subled[WS2812B_MAX_COLORS];
+	struct ws2812b_priv *priv;
+	unsigned int reg;
+	unsigned int offset;		/* of the first channel, in colors */
+};
+
+struct ws2812b_priv {
+	struct spi_device *spi;
+	struct work_struct work;
+
+	/* protects back and dirty */
+	spinlock_t lock;
+	bool dirty;
+	u8 *back;
+	u8 *front;
+	size_t data_len;
+	size_t xfer_len;
+
+	unsigned int num_leds;
+	struct ws2812b_led leds[];
+};
+
+static void ws2812b_encode(u8 *buf, u8 val)
+{
+	u32 bits = 0;
+	int i;
+
+	for (i = 7; i >= 0; i--)
+		bits = (bits << 3) | ((val & BIT(i)) ? 0b110 : 0b100);
+
+	buf[0] = bits >> 16;
+	buf[1] = bits >> 8;
+	buf[2] = bits;
+}
+
+static void ws2812b_work(struct work_struct *work)
+{
+	struct ws2812b_priv *priv = container_of(work, struct ws2812b_priv,
+						 work);
+	int ret;
+
+	spin_lock_irq(&priv->lock);
+	if (!priv->dirty) {
+		spin_unlock_irq(&priv->lock);
+		return;
+	}
+	memcpy(priv->front, priv->back, priv->data_len);
+	priv->dirty = false;
+	spin_unlock_irq(&priv->lock);
+
+	ret = spi_write(priv->spi, priv->front, priv->xfer_len);
+	if (ret)
+		dev_err_ratelimited(&priv->spi->dev,
+				    "failed to send frame: %d\n", ret);
+}
+
+static void ws2812b_set(struct led_classdev *cdev,
+			enum led_brightness brightness)
+{
+	struct led_classdev_mc *mc_cdev = lcdev_to_mccdev(cdev);
+	struct ws2812b_led *led = container_of(mc_cdev, struct ws2812b_led,
+					       mc_cdev);
+	struct ws2812b_priv *priv = led->priv;
+	unsigned long flags;
+	u8 *buf;
+	int i;
+
+	led_mc_calc_color_components(mc_cdev, brightness);
+
+	spin_lock_irqsave(&priv->lock, flags);
+	buf = priv->back + led->offset * WS2812B_BYTES_PER_COLOR;
+	for (i = 0; i < mc_cdev->num_colors; i++)
+		ws2812b_encode(buf + i * WS2812B_BYTES_PER_COLOR,
+			       mc_cdev->subled_info[i].brightness);
+	priv->dirty = true;
+	spin_unlock_irqrestore(&priv->lock, flags);
+
+	schedule_work(&priv->work);
+}
+
+static void ws2812b_cancel_work(void *data)
+{
+	struct ws2812b_priv *priv = data;
+
+	cancel_work_sync(&priv->work);
+}
+
+static int ws2812b_parse_led(struct device *dev, struct fwnode_handle *child,
+			     struct ws2812b_led *led)
+{
+	u32 colors[WS2812B_MAX_COLORS];
+	int num_colors, ret, i;
+
+	ret = fwnode_property_read_u32(child, "reg", &led->reg);
+	if (ret)
+		return dev_err_probe(dev, ret, "%pfw: missing reg\n", child);
+
+	num_colors = fwnode_property_count_u32(child, "color-index");
+	if (num_colors < 1 || num_colors > WS2812B_MAX_COLORS)
+		return dev_err_probe(dev, -EINVAL,
+				     "%pfw: bad color-index\n", child);
+
+	ret = fwnode_property_read_u32_array(child, "color-index", colors,
+					     num_colors);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < num_colors; i++) {
+		led->subled[i].color_index = colors[i];
+		led->subled[i].channel = i;
+		led->subled[i].intensity = LED_FULL;
+	}
+
+	led->mc_cdev.subled_info = led->subled;
+	led->mc_cdev.num_colors = num_colors;
+
+	return 0;
+}
+
+static int ws2812b_probe(struct spi_device *spi)
+{
+	struct device *dev = &spi->dev;
+	struct fwnode_handle *child;
+	struct ws2812b_priv *priv;
+	unsigned int *offsets;
+	unsigned int num_leds, colors, latch_len, i;
+	int ret;
+
+	if (spi->max_speed_hz < WS2812B_SPI_HZ_MIN ||
+	    spi->max_speed_hz > WS2812B_SPI_HZ_MAX)
+		return dev_err_probe(dev, -EINVAL,
+				     "spi-max-frequency must be %u-%u Hz\n",
+				     WS2812B_SPI_HZ_MIN, WS2812B_SPI_HZ_MAX);
+
+	num_leds = device_get_child_node_count(dev);
+	if (!num_leds)
+		return dev_err_probe(dev, -ENODEV, "no LEDs defined\n");
+
+	priv = devm_kzalloc(dev, struct_size(priv, leds, num_leds), GFP_KERNEL);
+	if (!priv)
+		return -ENOMEM;
+
+	priv->spi = spi;
+	priv->num_leds = num_leds;
+	spin_lock_init(&priv->lock);
+	INIT_WORK(&priv->work, ws2812b_work);
+
+	i = 0;
+	device_for_each_child_node(dev, child) {
+		ret = ws2812b_parse_led(dev, child, &priv->leds[i]);
+		if (ret) {
+			fwnode_handle_put(child);
+			return ret;
+		}
+		if (priv->leds[i].reg >= num_leds) {
+			ret = dev_err_probe(dev, -EINVAL,
+					    "%pfw: reg out of range\n", child);
+			fwnode_handle_put(child);
+			return ret;
+		}
+		i++;
+	}
+
+	/*
+	 * The strip is a shift register, so each LED's position in the
+	 * stream is the sum of the channels of every LED before it.
+	 */
+	offsets = devm_kcalloc(dev, num_leds, sizeof(*offsets), GFP_KERNEL);
+	if (!offsets)
+		return -ENOMEM;
+
+	for (i = 0; i < num_leds; i++) {
+		unsigned int reg = priv->leds[i].reg;
+
+		if (offsets[reg])
+			return dev_err_probe(dev, -EINVAL,
+					     "duplicate reg %u\n", reg);
+		offsets[reg] = priv->leds[i].mc_cdev.num_colors;
+	}
+
+	colors = 0;
+	for (i = 0; i < num_leds; i++) {
+		unsigned int n = offsets[i];
+
+		offsets[i] = colors;
+		colors += n;
+	}
+
+	for (i = 0; i < num_leds; i++)
+		priv->leds[i].offset = offsets[priv->leds[i].reg];
+
+	devm_kfree(dev, offsets);
+
+	latch_len = DIV_ROUND_UP(spi->max_speed_hz / 8 * WS2812B_LATCH_US,
+				 USEC_PER_SEC);
+	priv->data_len = colors * WS2812B_BYTES_PER_COLOR;
+	priv->xfer_len = priv->data_len + latch_len;
+
+	priv->back = devm_kzalloc(dev, priv->data_len, GFP_KERNEL);
+	/* kmalloc memory is DMA safe; the latch tail is never written */
+	priv->front = devm_kzalloc(dev, priv->xfer_len, GFP_KERNEL);
+	if (!priv->back || !priv->front)
+		return -ENOMEM;
+
+	/* Start with every LED off */
+	for (i = 0; i < colors; i++)
+		ws2812b_encode(priv->back + i * WS2812B_BYTES_PER_COLOR, 0);
+	priv->dirty = true;
+
+	/* Registered first so it runs after the LEDs are unregistered */
+	ret = devm_add_action_or_reset(dev, ws2812b_cancel_work, priv);
+	if (ret)
+		return ret;
+
+	i = 0;
+	device_for_each_child_node(dev, child) {
+		struct ws2812b_led *led = &priv->leds[i++];
+		struct led_init_data init_data = {
+			.fwnode = child,
+		};
+		struct led_classdev *cdev = &led->mc_cdev.led_cdev;
+
+		led->priv = priv;
+		cdev->max_brightness = LED_FULL;
+		cdev->brightness_set = ws2812b_set;
+
+		ret = devm_led_classdev_multicolor_register_ext(dev,
+								&led->mc_cdev,
+								&init_data);
+		if (ret) {
+			fwnode_handle_put(child);
+			return dev_err_probe(dev, ret,
+					     "failed to register LED %u\n",
+					     led->reg);
+		}
+	}
+
+	schedule_work(&priv->work);
+
+	return 0;
+}
+
+static const struct of_device_id ws2812b_of_match[] = {
+	{ .compatible = "worldsemi,ws2812b" },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, ws2812b_of_match);
+
+static const struct spi_device_id ws2812b_spi_ids[] = {
+	{ "ws2812b" },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(spi, ws2812b_spi_ids);
+
+static struct spi_driver ws2812b_driver = {
+	.probe		= ws2812b_probe,
+	.id_table	= ws2812b_spi_ids,
+	.driver = {
+		.name		= "leds-ws2812b",
+		.of_match_table	= ws2812b_of_match,
+	},
+};
+module_spi_driver(ws2812b_driver);
+
+MODULE_DESCRIPTION("WS2812B SPI LED strip driver");
+MODULE_LICENSE("GPL");
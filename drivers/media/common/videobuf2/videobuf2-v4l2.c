@@ -903,6 +903,7 @@ int vb2_queue_init_name(struct vb2_queue *q, const char *name)
 		q->buf_struct_size = sizeof(struct vb2_v4l2_buffer);
 
 	q->buf_ops = &v4l2_buf_ops;
+	q->stock_dqbuf = vb2_ioctl_dqbuf;
 	q->is_multiplanar = V4L2_TYPE_IS_MULTIPLANAR(q->type);
 	q->is_output = V4L2_TYPE_IS_OUTPUT(q->type);
 	q->copy_timestamp = (q->timestamp_flags & V4L2_BUF_FLAG_TIMESTAMP_MASK)
@@ -498,6 +498,8 @@ struct imx219 {
 	struct v4l2_ctrl *pixel_rate;
 	struct v4l2_ctrl *link_freq;
 	struct v4l2_ctrl *exposure;
+	struct v4l2_ctrl *analogue_gain;
+	struct v4l2_ctrl *digital_gain;
 	struct v4l2_ctrl *vflip;
 	struct v4l2_ctrl *hflip;
 	struct v4l2_ctrl *vblank;
@@ -585,6 +587,31 @@ static int imx219_get_rate_factor(struct imx219 *imx219,
 	return -EINVAL;
 }
 
+/*
+ * Exposure and the gains are clustered, with exposure as the master. Their
+ * registers are adjacent, so the values that changed are queued together and
+ * reach the sensor in a single transfer, within the same frame.
+ */
+static int imx219_set_exposure_gains(struct imx219 *imx219, int rate_factor)
+{
+	struct cci_reg_batch batch;
+	int ret = 0;
+
+	cci_batch_init(&batch);
+
+	if (imx219->analogue_gain->is_new)
+		cci_batch_write(imx219->regmap, &batch, IMX219_REG_ANALOG_GAIN,
+				imx219->analogue_gain->val, &ret);
+	if (imx219->digital_gain->is_new)
+		cci_batch_write(imx219->regmap, &batch, IMX219_REG_DIGITAL_GAIN,
+				imx219->digital_gain->val, &ret);
+	if (imx219->exposure->is_new)
+		cci_batch_write(imx219->regmap, &batch, IMX219_REG_EXPOSURE,
+				imx219->exposure->val / rate_factor, &ret);
+
+	return cci_batch_flush(imx219->regmap, &batch, &ret);
+}
+
 static int imx219_set_ctrl(struct v4l2_ctrl *ctrl)
 {
 	struct imx219 *imx219 =
@@ -620,17 +647,8 @@ static int imx219_set_ctrl(struct v4l2_ctrl *ctrl)
 	rate_factor = imx219_get_rate_factor(imx219, format);
 
 	switch (ctrl->id) {
-	case V4L2_CID_ANALOGUE_GAIN:
-		cci_write(imx219->regmap, IMX219_REG_ANALOG_GAIN,
-			  ctrl->val, &ret);
-		break;
 	case V4L2_CID_EXPOSURE:
-		cci_write(imx219->regmap, IMX219_REG_EXPOSURE,
-			  ctrl->val / rate_factor, &ret);
-		break;
-	case V4L2_CID_DIGITAL_GAIN:
-		cci_write(imx219->regmap, IMX219_REG_DIGITAL_GAIN,
-			  ctrl->val, &ret);
+		ret = imx219_set_exposure_gains(imx219, rate_factor);
 		break;
 	case V4L2_CID_TEST_PATTERN:
 		cci_write(imx219->regmap, IMX219_REG_TEST_PATTERN,
@@ -1258,13 +1276,19 @@ static int imx219_init_controls(struct imx219 *imx219)
 					     IMX219_EXPOSURE_STEP,
 					     exposure_def);
 
-	v4l2_ctrl_new_std(ctrl_hdlr, &imx219_ctrl_ops, V4L2_CID_ANALOGUE_GAIN,
-			  IMX219_ANA_GAIN_MIN, IMX219_ANA_GAIN_MAX,
-			  IMX219_ANA_GAIN_STEP, IMX219_ANA_GAIN_DEFAULT);
+	imx219->analogue_gain = v4l2_ctrl_new_std(ctrl_hdlr, &imx219_ctrl_ops,
+						  V4L2_CID_ANALOGUE_GAIN,
+						  IMX219_ANA_GAIN_MIN,
+						  IMX219_ANA_GAIN_MAX,
+						  IMX219_ANA_GAIN_STEP,
+						  IMX219_ANA_GAIN_DEFAULT);
 
-	v4l2_ctrl_new_std(ctrl_hdlr, &imx219_ctrl_ops, V4L2_CID_DIGITAL_GAIN,
-			  IMX219_DGTL_GAIN_MIN, IMX219_DGTL_GAIN_MAX,
-			  IMX219_DGTL_GAIN_STEP, IMX219_DGTL_GAIN_DEFAULT);
+	imx219->digital_gain = v4l2_ctrl_new_std(ctrl_hdlr, &imx219_ctrl_ops,
+						 V4L2_CID_DIGITAL_GAIN,
+						 IMX219_DGTL_GAIN_MIN,
+						 IMX219_DGTL_GAIN_MAX,
+						 IMX219_DGTL_GAIN_STEP,
+						 IMX219_DGTL_GAIN_DEFAULT);
 
 	imx219->hflip = v4l2_ctrl_new_std(ctrl_hdlr, &imx219_ctrl_ops,
 					  V4L2_CID_HFLIP, 0, 1, 1, 0);
@@ -1303,6 +1327,8 @@ static int imx219_init_controls(struct imx219 *imx219)
 		goto error;
 	}
 
+	v4l2_ctrl_cluster(3, &imx219->exposure);
+
 	ret = v4l2_fwnode_device_parse(&client->dev, &props);
 	if (ret)
 		goto error;
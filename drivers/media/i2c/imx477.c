@@ -6,7 +6,6 @@
  * Based on Sony imx219 camera driver
  * Copyright (C) 2019-2020 Raspberry Pi (Trading) Ltd
  */
-#include <asm/unaligned.h>
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/gpio/consumer.h>
@@ -15,6 +14,8 @@
 #include <linux/of_device.h>
 #include <linux/pm_runtime.h>
 #include <linux/regulator/consumer.h>
+#include <linux/regmap.h>
+#include <media/v4l2-cci.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-event.h>
@@ -1103,6 +1104,8 @@ struct imx477 {
 	struct v4l2_subdev sd;
 	struct media_pad pad[NUM_PADS];
 
+	struct regmap *regmap;
+
 	unsigned int fmt_code;
 
 	struct clk *xclk;
@@ -1139,6 +1142,9 @@ struct imx477 {
 	/* Rewrite common registers on stream on? */
 	bool common_regs_written;
 
+	/* Mode registers last written since power up, or NULL */
+	const struct imx477_reg_list *written_mode_regs;
+
 	/* Current long exposure factor in use. Set through V4L2_CID_VBLANK */
 	unsigned int long_exp_shift;
 
@@ -1178,76 +1184,81 @@ static inline void get_mode_table(unsigned int code,
 	}
 }
 
-/* Read registers up to 2 at a time */
+/* Read registers up to 4 at a time */
 static int imx477_read_reg(struct imx477 *imx477, u16 reg, u32 len, u32 *val)
 {
-	struct i2c_client *client = v4l2_get_subdevdata(&imx477->sd);
-	struct i2c_msg msgs[2];
-	u8 addr_buf[2] = { reg >> 8, reg & 0xff };
-	u8 data_buf[4] = { 0, };
+	u64 v;
 	int ret;
 
 	if (len > 4)
 		return -EINVAL;
 
-	/* Write register address */
-	msgs[0].addr = client->addr;
-	msgs[0].flags = 0;
-	msgs[0].len = ARRAY_SIZE(addr_buf);
-	msgs[0].buf = addr_buf;
-
-	/* Read data from register */
-	msgs[1].addr = client->addr;
-	msgs[1].flags = I2C_M_RD;
-	msgs[1].len = len;
-	msgs[1].buf = &data_buf[4 - len];
-
-	ret = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
-	if (ret != ARRAY_SIZE(msgs))
-		return -EIO;
+	ret = cci_read(imx477->regmap, reg | (len << CCI_REG_WIDTH_SHIFT), &v,
+		       NULL);
+	if (ret)
+		return ret;
 
-	*val = get_unaligned_be32(data_buf);
+	*val = v;
 
 	return 0;
 }
 
-/* Write registers up to 2 at a time */
+/* Write registers up to 4 at a time */
 static int imx477_write_reg(struct imx477 *imx477, u16 reg, u32 len, u32 val)
 {
-	struct i2c_client *client = v4l2_get_subdevdata(&imx477->sd);
-	u8 buf[6];
-
 	if (len > 4)
 		return -EINVAL;
 
-	put_unaligned_be16(reg, buf);
-	put_unaligned_be32(val << (8 * (4 - len)), buf + 2);
-	if (i2c_master_send(client, buf, len + 2) != len + 2)
-		return -EIO;
+	return cci_write(imx477->regmap, reg | (len << CCI_REG_WIDTH_SHIFT), val,
+			 NULL);
+}
 
-	return 0;
+/* Does the register list leave this register set to this value? */
+static bool imx477_reg_list_has(const struct imx477_reg_list *list,
+				const struct imx477_reg *reg)
+{
+	unsigned int i = list->num_of_regs;
+
+	while (i--) {
+		if (list->regs[i].address == reg->address)
+			return list->regs[i].val == reg->val;
+	}
+
+	return false;
 }
 
-/* Write a list of registers */
-static int imx477_write_regs(struct imx477 *imx477,
-			     const struct imx477_reg *regs, u32 len)
+/*
+ * Write a list of registers, skipping any that are set to the same value in
+ * the list "skip", if given. The writes are batched so that runs of
+ * consecutive addresses go out in a single transfer, using the sensor's
+ * address auto-increment.
+ */
+static int imx477_write_regs_skip(struct imx477 *imx477,
+				  const struct imx477_reg *regs, u32 len,
+				  const struct imx477_reg_list *skip)
 {
-	struct i2c_client *client = v4l2_get_subdevdata(&imx477->sd);
+	struct cci_reg_batch batch;
 	unsigned int i;
-	int ret;
+	int ret = 0;
+
+	cci_batch_init(&batch);
 
 	for (i = 0; i < len; i++) {
-		ret = imx477_write_reg(imx477, regs[i].address, 1, regs[i].val);
-		if (ret) {
-			dev_err_ratelimited(&client->dev,
-					    "Failed to write reg 0x%4.4x. error = %d\n",
-					    regs[i].address, ret);
+		if (skip && imx477_reg_list_has(skip, &regs[i]))
+			continue;
 
-			return ret;
-		}
+		cci_batch_write(imx477->regmap, &batch,
+				CCI_REG8(regs[i].address), regs[i].val, &ret);
 	}
 
-	return 0;
+	return cci_batch_flush(imx477->regmap, &batch, &ret);
+}
+
+/* Write a list of registers */
+static int imx477_write_regs(struct imx477 *imx477,
+			     const struct imx477_reg *regs, u32 len)
+{
+	return imx477_write_regs_skip(imx477, regs, len, NULL);
 }
 
 /* Get bayer order based on flip setting. */
@@ -1733,13 +1744,21 @@ static int imx477_start_streaming(struct imx477 *imx477)
 		imx477->common_regs_written = true;
 	}
 
-	/* Apply default values of current mode */
+	/*
+	 * Apply default values of current mode. Registers that the last mode
+	 * written already set to the same values don't need writing again, and
+	 * anything that controls may have changed is rewritten below.
+	 */
 	reg_list = &imx477->mode->reg_list;
-	ret = imx477_write_regs(imx477, reg_list->regs, reg_list->num_of_regs);
+	ret = imx477_write_regs_skip(imx477, reg_list->regs,
+				     reg_list->num_of_regs,
+				     imx477->written_mode_regs);
 	if (ret) {
+		imx477->written_mode_regs = NULL;
 		dev_err(&client->dev, "%s failed to set mode\n", __func__);
 		return ret;
 	}
+	imx477->written_mode_regs = reg_list;
 
 	/* Set on-sensor DPC. */
 	imx477_write_reg(imx477, 0x0b05, IMX477_REG_VALUE_08BIT, !!dpc_enable);
@@ -1878,6 +1897,7 @@ static int imx477_power_off(struct device *dev)
 
 	/* Force reprogramming of the common registers when powered up again. */
 	imx477->common_regs_written = false;
+	imx477->written_mode_regs = NULL;
 
 	return 0;
 }
@@ -2199,6 +2219,11 @@ static int imx477_probe(struct i2c_client *client)
 
 	v4l2_i2c_subdev_init(&imx477->sd, client, &imx477_subdev_ops);
 
+	imx477->regmap = devm_cci_regmap_init_i2c(client, 16);
+	if (IS_ERR(imx477->regmap))
+		return dev_err_probe(dev, PTR_ERR(imx477->regmap),
+				     "failed to initialize CCI\n");
+
 	match = of_match_device(imx477_dt_ids, dev);
 	if (!match)
 		return -ENODEV;
@@ -6,7 +6,6 @@
  * Based on Sony imx477 camera driver
  * Copyright (C) 2020 Raspberry Pi Ltd
  */
-#include <asm/unaligned.h>
 #include <linux/clk.h>
 #include <linux/delay.h>
 #include <linux/gpio/consumer.h>
@@ -14,6 +13,8 @@
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
 #include <linux/regulator/consumer.h>
+#include <linux/regmap.h>
+#include <media/v4l2-cci.h>
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-event.h>
@@ -826,6 +827,8 @@ struct imx708 {
 	struct v4l2_subdev sd;
 	struct media_pad pad[NUM_PADS];
 
+	struct regmap *regmap;
+
 	struct v4l2_mbus_framefmt fmt;
 
 	struct clk *inclk;
@@ -862,6 +865,9 @@ struct imx708 {
 	/* Rewrite common registers on stream on? */
 	bool common_regs_written;
 
+	/* Mode registers last written since power up, or NULL */
+	const struct imx708_reg_list *written_mode_regs;
+
 	/* Current long exposure factor in use. Set through V4L2_CID_VBLANK */
 	unsigned int long_exp_shift;
 
@@ -898,77 +904,81 @@ static inline void get_mode_table(unsigned int code,
 	}
 }
 
-/* Read registers up to 2 at a time */
+/* Read registers up to 4 at a time */
 static int imx708_read_reg(struct imx708 *imx708, u16 reg, u32 len, u32 *val)
 {
-	struct i2c_client *client = v4l2_get_subdevdata(&imx708->sd);
-	struct i2c_msg msgs[2];
-	u8 addr_buf[2] = { reg >> 8, reg & 0xff };
-	u8 data_buf[4] = { 0, };
+	u64 v;
 	int ret;
 
 	if (len > 4)
 		return -EINVAL;
 
-	/* Write register address */
-	msgs[0].addr = client->addr;
-	msgs[0].flags = 0;
-	msgs[0].len = ARRAY_SIZE(addr_buf);
-	msgs[0].buf = addr_buf;
-
-	/* Read data from register */
-	msgs[1].addr = client->addr;
-	msgs[1].flags = I2C_M_RD;
-	msgs[1].len = len;
-	msgs[1].buf = &data_buf[4 - len];
-
-	ret = i2c_transfer(client->adapter, msgs, ARRAY_SIZE(msgs));
-	if (ret != ARRAY_SIZE(msgs))
-		return -EIO;
+	ret = cci_read(imx708->regmap, reg | (len << CCI_REG_WIDTH_SHIFT), &v,
+		       NULL);
+	if (ret)
+		return ret;
 
-	*val = get_unaligned_be32(data_buf);
+	*val = v;
 
 	return 0;
 }
 
-/* Write registers up to 2 at a time */
+/* Write registers up to 4 at a time */
 static int imx708_write_reg(struct imx708 *imx708, u16 reg, u32 len, u32 val)
 {
-	struct i2c_client *client = v4l2_get_subdevdata(&imx708->sd);
-	u8 buf[6];
-
 	if (len > 4)
 		return -EINVAL;
 
-	put_unaligned_be16(reg, buf);
-	put_unaligned_be32(val << (8 * (4 - len)), buf + 2);
-	if (i2c_master_send(client, buf, len + 2) != len + 2)
-		return -EIO;
+	return cci_write(imx708->regmap, reg | (len << CCI_REG_WIDTH_SHIFT), val,
+			 NULL);
+}
 
-	return 0;
+/* Does the register list leave this register set to this value? */
+static bool imx708_reg_list_has(const struct imx708_reg_list *list,
+				const struct imx708_reg *reg)
+{
+	unsigned int i = list->num_of_regs;
+
+	while (i--) {
+		if (list->regs[i].address == reg->address)
+			return list->regs[i].val == reg->val;
+	}
+
+	return false;
 }
 
-/* Write a list of registers */
-static int imx708_write_regs(struct imx708 *imx708,
-			     const struct imx708_reg *regs, u32 len)
+/*
+ * Write a list of registers, skipping any that are set to the same value in
+ * the list "skip", if given. The writes are batched so that runs of
+ * consecutive addresses go out in a single transfer, using the sensor's
+ * address auto-increment.
+ */
+static int imx708_write_regs_skip(struct imx708 *imx708,
+				  const struct imx708_reg *regs, u32 len,
+				  const struct imx708_reg_list *skip)
 {
-	struct i2c_client *client = v4l2_get_subdevdata(&imx708->sd);
+	struct cci_reg_batch batch;
 	unsigned int i;
+	int ret = 0;
 
-	for (i = 0; i < len; i++) {
-		int ret;
+	cci_batch_init(&batch);
 
-		ret = imx708_write_reg(imx708, regs[i].address, 1, regs[i].val);
-		if (ret) {
-			dev_err_ratelimited(&client->dev,
-					    "Failed to write reg 0x%4.4x. error = %d\n",
-					    regs[i].address, ret);
+	for (i = 0; i < len; i++) {
+		if (skip && imx708_reg_list_has(skip, &regs[i]))
+			continue;
 
-			return ret;
-		}
+		cci_batch_write(imx708->regmap, &batch,
+				CCI_REG8(regs[i].address), regs[i].val, &ret);
 	}
 
-	return 0;
+	return cci_batch_flush(imx708->regmap, &batch, &ret);
+}
+
+/* Write a list of registers */
+static int imx708_write_regs(struct imx708 *imx708,
+			     const struct imx708_reg *regs, u32 len)
+{
+	return imx708_write_regs_skip(imx708, regs, len, NULL);
 }
 
 /* Get bayer order based on flip setting. */
@@ -1516,13 +1526,22 @@ static int imx708_start_streaming(struct imx708 *imx708)
 		imx708->common_regs_written = true;
 	}
 
-	/* Apply default values of current mode */
+	/*
+	 * Apply default values of current mode. Registers that the last mode
+	 * written already set to the same values don't need writing again, and
+	 * anything that controls or the link frequency may have changed is
+	 * rewritten below.
+	 */
 	reg_list = &imx708->mode->reg_list;
-	ret = imx708_write_regs(imx708, reg_list->regs, reg_list->num_of_regs);
+	ret = imx708_write_regs_skip(imx708, reg_list->regs,
+				     reg_list->num_of_regs,
+				     imx708->written_mode_regs);
 	if (ret) {
+		imx708->written_mode_regs = NULL;
 		dev_err(&client->dev, "%s failed to set mode\n", __func__);
 		return ret;
 	}
+	imx708->written_mode_regs = reg_list;
 
 	/* Update the link frequency registers */
 	freq_regs = &link_freq_regs[imx708->link_freq_idx];
@@ -1670,6 +1689,7 @@ static int imx708_power_off(struct device *dev)
 
 	/* Force reprogramming of the common registers when powered up again. */
 	imx708->common_regs_written = false;
+	imx708->written_mode_regs = NULL;
 
 	return 0;
 }
@@ -1984,6 +2004,11 @@ static int imx708_probe(struct i2c_client *client)
 
 	v4l2_i2c_subdev_init(&imx708->sd, client, &imx708_subdev_ops);
 
+	imx708->regmap = devm_cci_regmap_init_i2c(client, 16);
+	if (IS_ERR(imx708->regmap))
+		return dev_err_probe(dev, PTR_ERR(imx708->regmap),
+				     "failed to initialize CCI\n");
+
 	/* Check the hardware configuration in device tree */
 	if (imx708_check_hwcfg(dev, imx708))
 		return -EINVAL;
@@ -88,6 +88,10 @@ static int media_controller;
 module_param(media_controller, int, 0644);
 MODULE_PARM_DESC(media_controller, "Use media controller API");
 
+static bool double_buffer;
+module_param(double_buffer, bool, 0644);
+MODULE_PARM_DESC(double_buffer, "Use both DMA address sets in ping-pong mode");
+
 #define unicam_dbg(level, dev, fmt, arg...)	\
 		v4l2_dbg(level, debug, &(dev)->v4l2_dev, fmt, ##arg)
 #define unicam_info(dev, fmt, arg...)	\
@@ -494,6 +498,8 @@ struct unicam_node {
 	struct unicam_buffer *cur_frm;
 	/* Pointer pointing to next v4l2_buffer */
 	struct unicam_buffer *next_frm;
+	/* Buffers programmed into each DMA address set in double buffer mode */
+	struct unicam_buffer *db_frm[2];
 	/* video capture */
 	const struct unicam_fmt *fmt;
 	/* Used to store current pixel format */
@@ -549,6 +555,12 @@ struct unicam_device {
 	struct v4l2_async_notifier notifier;
 	unsigned int sequence;
 	bool frame_started;
+	/*
+	 * In double buffer mode the hardware alternates between the two DMA
+	 * address sets, and db_active is the one the current frame goes to.
+	 */
+	bool double_buffer;
+	unsigned int db_active;
 
 	/* ptr to  sub device */
 	struct v4l2_subdev *sensor;
@@ -819,20 +831,27 @@ static int unicam_reset_format(struct unicam_node *node)
 	return 0;
 }
 
-static void unicam_wr_dma_addr(struct unicam_device *dev, dma_addr_t dmaaddr,
-			       unsigned int buffer_size, int pad_id)
+static void unicam_wr_dma_addr_set(struct unicam_device *dev, unsigned int set,
+				   dma_addr_t dmaaddr,
+				   unsigned int buffer_size, int pad_id)
 {
 	dma_addr_t endaddr = dmaaddr + buffer_size;
 
 	if (pad_id == IMAGE_PAD) {
-		reg_write(dev, UNICAM_IBSA0, dmaaddr);
-		reg_write(dev, UNICAM_IBEA0, endaddr);
+		reg_write(dev, set ? UNICAM_IBSA1 : UNICAM_IBSA0, dmaaddr);
+		reg_write(dev, set ? UNICAM_IBEA1 : UNICAM_IBEA0, endaddr);
 	} else {
-		reg_write(dev, UNICAM_DBSA0, dmaaddr);
-		reg_write(dev, UNICAM_DBEA0, endaddr);
+		reg_write(dev, set ? UNICAM_DBSA1 : UNICAM_DBSA0, dmaaddr);
+		reg_write(dev, set ? UNICAM_DBEA1 : UNICAM_DBEA0, endaddr);
 	}
 }
 
+static void unicam_wr_dma_addr(struct unicam_device *dev, dma_addr_t dmaaddr,
+			       unsigned int buffer_size, int pad_id)
+{
+	unicam_wr_dma_addr_set(dev, 0, dmaaddr, buffer_size, pad_id);
+}
+
 static unsigned int unicam_get_lines_done(struct unicam_device *dev)
 {
 	dma_addr_t start_addr, cur_addr;
@@ -886,6 +905,76 @@ static void unicam_process_buffer_complete(struct unicam_node *node,
 	vb2_buffer_done(&node->cur_frm->vb.vb2_buf, VB2_BUF_STATE_DONE);
 }
 
+/*
+ * Program one DMA address set with the next queued buffer, or the dummy
+ * buffer if there is none. In double buffer mode the set won't be used until
+ * the frame after next, which gives a whole frame of slack for IRQ latency.
+ */
+static void unicam_db_schedule(struct unicam_node *node, unsigned int set)
+{
+	struct unicam_device *dev = node->dev;
+	struct unicam_buffer *buf = NULL;
+	unsigned long flags;
+	unsigned int size;
+	dma_addr_t addr;
+
+	spin_lock_irqsave(&node->dma_queue_lock, flags);
+	if (!list_empty(&node->dma_queue)) {
+		buf = list_first_entry(&node->dma_queue, struct unicam_buffer,
+				       list);
+		list_del(&buf->list);
+	}
+	node->db_frm[set] = buf;
+	spin_unlock_irqrestore(&node->dma_queue_lock, flags);
+
+	if (buf) {
+		/*
+		 * Overwritten by the frame start timestamp, but never leave a
+		 * stale one from the buffer's last use if FS is not seen.
+		 */
+		buf->vb.vb2_buf.timestamp = ktime_get_ns();
+		addr = vb2_dma_contig_plane_dma_addr(&buf->vb.vb2_buf, 0);
+		size = (node->pad_id == IMAGE_PAD) ?
+				node->v_fmt.fmt.pix.sizeimage :
+				node->v_fmt.fmt.meta.buffersize;
+	} else {
+		unicam_dbg(3, dev, "Scheduling dummy buffer for node %d set %u\n",
+			   node->pad_id, set);
+		addr = node->dummy_buf_dma_addr;
+		size = 0;
+	}
+
+	unicam_wr_dma_addr_set(dev, set, addr, size, node->pad_id);
+}
+
+static void unicam_db_buffer_done(struct unicam_device *unicam,
+				  unsigned int set)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(unicam->node); i++) {
+		struct unicam_node *node = &unicam->node[i];
+		struct unicam_buffer *buf = node->db_frm[set];
+
+		if (!node->streaming)
+			continue;
+
+		if (buf) {
+			buf->vb.field = node->m_fmt.field;
+			buf->vb.sequence = unicam->sequence;
+			vb2_buffer_done(&buf->vb.vb2_buf, VB2_BUF_STATE_DONE);
+		} else {
+			unicam_dbg(2, unicam, "ISR: [%d] Dropping frame, no buffer in set %u\n",
+				   i, set);
+		}
+
+		unicam_db_schedule(node, set);
+	}
+
+	unicam->sequence++;
+	unicam->db_active = set ^ 1;
+}
+
 static void unicam_queue_event_sof(struct unicam_device *unicam)
 {
 	struct v4l2_event event = {
@@ -896,6 +985,42 @@ static void unicam_queue_event_sof(struct unicam_device *unicam)
 	v4l2_event_queue(&unicam->node[IMAGE_PAD].video_dev, &event);
 }
 
+/*
+ * Double buffer mode. Frame completion comes from the BUFn_RDY status, and
+ * the completed set is reprogrammed straight away.
+ */
+static void unicam_isr_double_buffer(struct unicam_device *unicam, u32 sta,
+				     u32 ista)
+{
+	static const u32 rdy[2] = { UNICAM_BUF0_RDY, UNICAM_BUF1_RDY };
+	unsigned int set = unicam->db_active;
+	unsigned int i;
+
+	/* If both are ready, the active one must have completed first. */
+	if (sta & rdy[set])
+		unicam_db_buffer_done(unicam, set);
+	if (sta & rdy[set ^ 1])
+		unicam_db_buffer_done(unicam, set ^ 1);
+
+	if (sta & (UNICAM_BUF0_NO | UNICAM_BUF1_NO))
+		unicam_dbg(2, unicam, "ISR: No buffer available, STA: 0x%X\n",
+			   sta);
+
+	if (ista & UNICAM_FSI) {
+		u64 ts = ktime_get_ns();
+
+		for (i = 0; i < ARRAY_SIZE(unicam->node); i++) {
+			struct unicam_buffer *buf =
+				unicam->node[i].db_frm[unicam->db_active];
+
+			if (unicam->node[i].streaming && buf)
+				buf->vb.vb2_buf.timestamp = ts;
+		}
+
+		unicam_queue_event_sof(unicam);
+	}
+}
+
 /*
  * unicam_isr : ISR handler for unicam capture
  * @irq: irq number
@@ -925,6 +1050,11 @@ static irqreturn_t unicam_isr(int irq, void *dev)
 	unicam_dbg(3, unicam, "ISR: ISTA: 0x%X, STA: 0x%X, sequence %d, lines done %d",
 		   ista, sta, sequence, lines_done);
 
+	if (unicam->double_buffer) {
+		unicam_isr_double_buffer(unicam, sta, ista);
+		return IRQ_HANDLED;
+	}
+
 	if (!(sta & (UNICAM_IS | UNICAM_PI0)))
 		return IRQ_HANDLED;
 
@@ -2471,6 +2601,16 @@ static void unicam_start_rx(struct unicam_device *dev, dma_addr_t *addr)
 		unicam_wr_dma_addr(dev, addr[METADATA_PAD], size, METADATA_PAD);
 	}
 
+	if (dev->double_buffer) {
+		for (i = 0; i < ARRAY_SIZE(dev->node); i++) {
+			if (dev->node[i].streaming)
+				unicam_db_schedule(&dev->node[i], 1);
+		}
+		dev->db_active = 0;
+		reg_write(dev, UNICAM_DBCTL,
+			  UNICAM_DBEN | UNICAM_BUF0_IE | UNICAM_BUF1_IE);
+	}
+
 	/* Enable peripheral */
 	reg_write_field(dev, UNICAM_CTRL, 1, UNICAM_CPE);
 
@@ -2510,6 +2650,9 @@ static void unicam_disable(struct unicam_device *dev)
 	/* Clear ED setup */
 	reg_write(dev, UNICAM_DCS, 0);
 
+	/* Disable double buffering */
+	reg_write(dev, UNICAM_DBCTL, 0);
+
 	/* Disable all lane clocks */
 	clk_write(dev, 0);
 }
@@ -2519,6 +2662,7 @@ static void unicam_return_buffers(struct unicam_node *node,
 {
 	struct unicam_buffer *buf, *tmp;
 	unsigned long flags;
+	unsigned int i;
 
 	spin_lock_irqsave(&node->dma_queue_lock, flags);
 	list_for_each_entry_safe(buf, tmp, &node->dma_queue, list) {
@@ -2532,6 +2676,11 @@ static void unicam_return_buffers(struct unicam_node *node,
 	if (node->next_frm && node->cur_frm != node->next_frm)
 		vb2_buffer_done(&node->next_frm->vb.vb2_buf,
 				state);
+	for (i = 0; i < ARRAY_SIZE(node->db_frm); i++) {
+		if (node->db_frm[i])
+			vb2_buffer_done(&node->db_frm[i]->vb.vb2_buf, state);
+		node->db_frm[i] = NULL;
+	}
 
 	node->cur_frm = NULL;
 	node->next_frm = NULL;
@@ -2560,6 +2709,7 @@ static int unicam_start_streaming(struct vb2_queue *vq, unsigned int count)
 	}
 
 	dev->sequence = 0;
+	dev->double_buffer = double_buffer;
 	ret = unicam_runtime_get(dev);
 	if (ret < 0) {
 		unicam_dbg(3, dev, "unicam_runtime_get failed\n");
@@ -2633,8 +2783,12 @@ static int unicam_start_streaming(struct vb2_queue *vq, unsigned int count)
 		spin_lock_irqsave(&dev->node[i].dma_queue_lock, flags);
 		buf = list_first_entry(&dev->node[i].dma_queue,
 				       struct unicam_buffer, list);
-		dev->node[i].cur_frm = buf;
-		dev->node[i].next_frm = buf;
+		if (dev->double_buffer) {
+			dev->node[i].db_frm[0] = buf;
+		} else {
+			dev->node[i].cur_frm = buf;
+			dev->node[i].next_frm = buf;
+		}
 		list_del(&buf->list);
 		spin_unlock_irqrestore(&dev->node[i].dma_queue_lock, flags);
 
@@ -2711,6 +2865,9 @@ static void unicam_stop_streaming(struct vb2_queue *vq)
 		 */
 		unicam_wr_dma_addr(dev, node->dummy_buf_dma_addr, 0,
 				   METADATA_PAD);
+		if (dev->double_buffer)
+			unicam_wr_dma_addr_set(dev, 1, node->dummy_buf_dma_addr,
+					       0, METADATA_PAD);
 	}
 
 	/* Clear all queued buffers for the node */
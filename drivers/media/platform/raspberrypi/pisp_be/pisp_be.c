@@ -5,11 +5,16 @@
  *
  */
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/kfifo.h>
+#include <linux/log2_hist.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 #include <media/v4l2-device.h>
 #include <media/v4l2-ioctl.h>
 #include <media/videobuf2-dma-contig.h>
@@ -18,6 +23,9 @@
 #include "pisp_be_config.h"
 #include "pisp_be_formats.h"
 
+#define CREATE_TRACE_POINTS
+#include "pisp_be_trace.h"
+
 MODULE_DESCRIPTION("PiSP Back End driver");
 MODULE_AUTHOR("David Plowman <david.plowman@raspberrypi.com>");
 MODULE_AUTHOR("Nick Hollinghurst <nick.hollinghurst@raspberrypi.com>");
@@ -30,15 +38,41 @@ MODULE_LICENSE("GPL v2");
 #define PISP_BE_NUM_CONFIG_BUFFERS VB2_MAX_FRAME
 
 /*
- * We want to support 2 independent instances allowing 2 simultaneous users
+ * We want to support several independent instances allowing simultaneous users
  * of the ISP-BE (of course they share hardware, platform resources and mutex).
  * Each such instance comprises a group of device nodes representing input
  * and output queues, and a media controller device node to describe them.
+ * There are 2 by default, and up to PISPBE_MAX_NODE_GROUPS.
  */
 #define PISPBE_NUM_NODE_GROUPS 2
+#define PISPBE_MAX_NODE_GROUPS 8
+
+static unsigned int pispbe_num_groups = PISPBE_NUM_NODE_GROUPS;
+module_param_named(num_groups, pispbe_num_groups, uint, 0444);
+MODULE_PARM_DESC(num_groups, "Number of node groups (simultaneous users), 1 to 8");
+
+/*
+ * Node groups share the hardware in proportion to their weights, measured in
+ * tiles processed. A weight of 0 is treated as 1.
+ */
+static unsigned int pispbe_group_weights[PISPBE_MAX_NODE_GROUPS] = {
+	1, 1, 1, 1, 1, 1, 1, 1
+};
+module_param_array_named(group_weights, pispbe_group_weights, uint, NULL,
+			 0444);
+MODULE_PARM_DESC(group_weights, "Relative share of the hardware for each node group");
+
+/* Fixed point scale for the weighted virtual time of each node group */
+#define PISPBE_VTIME_SCALE 1024
 
 #define PISPBE_NAME "pispbe"
 
+/*
+ * Number of jobs that may be prepared ahead of the hardware, so that the next
+ * job can be written straight from the interrupt handler. Must be a power of 2.
+ */
+#define PISPBE_JOB_QUEUE_DEPTH 8
+
 /* Some ISP-BE registers */
 #define PISP_BE_VERSION_OFFSET (0x0)
 #define PISP_BE_CONTROL_OFFSET (0x4)
@@ -188,6 +222,29 @@ struct pispbe_node {
 		(node_desc[(node)->id].ent_name + sizeof(PISPBE_NAME))
 #define NODE_GET_V4L2(node) ((node)->node_group->v4l2_dev)
 
+/* Job duration histogram in power of two microsecond buckets from 1us up */
+#define PISPBE_JOB_HIST_BUCKETS 20
+
+struct pispbe_job_hist {
+	u32 buckets[PISPBE_JOB_HIST_BUCKETS];
+	u32 count;
+	u64 busy_ns;
+	u64 max_ns;
+};
+
+/*
+ * The parts of a config that pisp_be_validate_config() looks at. These are
+ * usually the same from one frame to the next.
+ */
+struct pispbe_validated_config {
+	u32 bayer_enables;
+	u32 rgb_enables;
+	struct pisp_image_format_config tdn_output_format;
+	struct pisp_image_format_config stitch_output_format;
+	struct pisp_be_output_format_config
+				output_format[PISP_BACK_END_NUM_OUTPUTS];
+};
+
 /*
  * Node group structure, which comprises all the input and output nodes that a
  * single PiSP client will need, along with its own v4l2 and media devices.
@@ -204,9 +261,21 @@ struct pispbe_node_group {
 	struct pisp_be_tiles_config *config;
 	dma_addr_t config_dma_addr;
 	unsigned int sequence;
+	/* Last config to pass validation, and the format_gen it was done at */
+	struct pispbe_validated_config validated;
+	unsigned int validated_gen;
+	bool validated_ok;
+	atomic_t format_gen; /* incremented on any change of node format */
+	/* Scheduling state and statistics, protected by the hw_lock */
+	unsigned int weight;
+	u64 vtime; /* weighted tiles processed, see pispbe_account_job */
+	unsigned int jobs_queued; /* jobs in the pispbe job_queue */
+	u64 jobs;
+	u64 tiles;
+	struct pispbe_job_hist hist; /* of jobs completed */
 };
 
-/* Records details of the jobs currently running or queued on the h/w. */
+/* Records details of the jobs prepared, or currently running or queued on the h/w. */
 struct pispbe_job {
 	struct pispbe_node_group *node_group;
 	/*
@@ -214,6 +283,13 @@ struct pispbe_job {
 	 * then captures, then metadata last.
 	 */
 	struct pispbe_buffer *buf[PISPBE_NUM_NODES];
+	/* Sanitised register values, filled in when the job is prepared. */
+	dma_addr_t hw_dma_addrs[N_HW_ADDRESSES];
+	u32 hw_enables[N_HW_ENABLES];
+	struct pisp_be_config *config;
+	dma_addr_t tiles;
+	unsigned int num_tiles;
+	u64 queue_ns; /* when it was written to the h/w queue */
 };
 
 /*
@@ -222,15 +298,24 @@ struct pispbe_job {
  */
 struct pispbe_dev {
 	struct device *dev;
-	struct pispbe_node_group node_group[PISPBE_NUM_NODE_GROUPS];
+	struct pispbe_node_group *node_group;
+	unsigned int num_groups;
+	u64 vtime; /* start vtime of the last job prepared */
+	struct dentry *debugfs;
 	int hw_busy; /* non-zero if a job is queued or is being started */
 	struct pispbe_job queued_job, running_job;
+	/* jobs with all their buffers, waiting for space in the h/w queue */
+	DECLARE_KFIFO(job_queue, struct pispbe_job, PISPBE_JOB_QUEUE_DEPTH);
 	void __iomem *be_reg_base;
 	struct clk *clk;
 	int irq;
 	u32 hw_version;
 	u8 done, started;
-	spinlock_t hw_lock; /* protects "hw_busy" flag and streaming_map */
+	/* Utilisation statistics, protected by the hw_lock */
+	u64 last_done_ns;
+	u64 stats_since_ns;
+	u64 busy_ns;
+	spinlock_t hw_lock; /* protects "hw_busy" flag, job_queue and streaming_map */
 };
 
 static inline u32 read_reg(struct pispbe_dev *pispbe, unsigned int offset)
@@ -286,11 +371,13 @@ static int hw_init(struct pispbe_dev *pispbe)
  * queued, unstarted job.
  */
 static void hw_queue_job(struct pispbe_dev *pispbe,
-			 dma_addr_t hw_dma_addrs[N_HW_ADDRESSES],
-			 u32 hw_enables[N_HW_ENABLES],
-			 struct pisp_be_config *config, dma_addr_t tiles,
-			 unsigned int num_tiles)
+			 const struct pispbe_job *job)
 {
+	const dma_addr_t *hw_dma_addrs = job->hw_dma_addrs;
+	const u32 *hw_enables = job->hw_enables;
+	struct pisp_be_config *config = job->config;
+	dma_addr_t tiles = job->tiles;
+	unsigned int num_tiles = job->num_tiles;
 	unsigned int begin, end;
 	unsigned int u;
 
@@ -424,7 +511,7 @@ fixup_addrs_enables(dma_addr_t addrs[N_HW_ADDRESSES],
 			 &node_group->node[MAIN_INPUT_NODE]);
 	if (ret <= 0) {
 		/*
-		 * This shouldn't happen; pispbe_schedule_internal should insist
+		 * This shouldn't happen; pispbe_prepare_job should insist
 		 * on an input.
 		 */
 		dev_warn(node_group->pispbe->dev,
@@ -491,26 +578,69 @@ fixup_addrs_enables(dma_addr_t addrs[N_HW_ADDRESSES],
 }
 
 /*
- * Internal function. Called from pispbe_schedule_one/all. Returns non-zero if
- * we started a job.
+ * Start-time fair queueing: a node group's vtime advances by its tiles divided
+ * by its weight, and the group with the lowest vtime is served first. A group
+ * that was idle starts again from the current vtime, rather than catching up
+ * on the time it didn't use.
+ *
+ * Warning: needs to be called with hw_lock taken.
+ */
+static void pispbe_account_job(struct pispbe_node_group *node_group,
+			       unsigned int num_tiles)
+{
+	struct pispbe_dev *pispbe = node_group->pispbe;
+
+	if (node_group->vtime < pispbe->vtime)
+		node_group->vtime = pispbe->vtime;
+	pispbe->vtime = node_group->vtime;
+	node_group->vtime += div_u64((u64)max(num_tiles, 1U) * PISPBE_VTIME_SCALE,
+				     node_group->weight);
+
+	node_group->jobs_queued++;
+	node_group->jobs++;
+	node_group->tiles += num_tiles;
+}
+
+/* Fill order[] with the node group indices, lowest vtime first. */
+static void pispbe_group_order(struct pispbe_dev *pispbe,
+			       unsigned int order[PISPBE_MAX_NODE_GROUPS])
+{
+	unsigned int i, j;
+
+	for (i = 0; i < pispbe->num_groups; i++) {
+		u64 vtime = pispbe->node_group[i].vtime;
+
+		for (j = i; j > 0 &&
+		     pispbe->node_group[order[j - 1]].vtime > vtime; j--)
+			order[j] = order[j - 1];
+		order[j] = i;
+	}
+}
+
+/*
+ * Internal function. Gathers a buffer from each node of a node group to form
+ * a job, works out the register values for it and adds it to the job queue.
+ * Returns non-zero if a job was prepared.
  *
- * Warning: needs to be called with hw_lock taken, and releases it if it
- * schedules a job.
+ * Warning: needs to be called with hw_lock taken.
  */
-static int pispbe_schedule_internal(struct pispbe_node_group *node_group,
-				    unsigned long flags)
+static int pispbe_prepare_job(struct pispbe_node_group *node_group)
 {
 	struct pisp_be_tiles_config *config_tiles_buffer;
 	struct pispbe_dev *pispbe = node_group->pispbe;
 	struct pispbe_buffer *buf[PISPBE_NUM_NODES];
-	dma_addr_t hw_dma_addrs[N_HW_ADDRESSES];
-	dma_addr_t tiles;
-	u32 hw_enables[N_HW_ENABLES];
+	struct pispbe_job job;
 	struct pispbe_node *node;
 	unsigned long flags1;
 	unsigned int config_index;
 	int i;
 
+	/* Don't let one node group take the whole job queue. */
+	if (kfifo_is_full(&pispbe->job_queue) ||
+	    node_group->jobs_queued >=
+	    max(1U, PISPBE_JOB_QUEUE_DEPTH / pispbe->num_groups))
+		return 0;
+
 	/*
 	 * To schedule a job, we need all streaming nodes (apart from Output0,
 	 * Output1, Tdn and Stitch) to have a buffer ready, which must
@@ -541,9 +671,6 @@ static int pispbe_schedule_internal(struct pispbe_node_group *node_group,
 
 	config_index = buf[CONFIG_NODE]->vb.vb2_buf.index;
 	config_tiles_buffer = &node_group->config[config_index];
-	tiles = (dma_addr_t)node_group->config_dma_addr +
-			config_index * sizeof(struct pisp_be_tiles_config) +
-			offsetof(struct pisp_be_tiles_config, tiles);
 
 	/* remember: srcimages, captures then metadata */
 	for (i = 0; i < PISPBE_NUM_NODES; i++) {
@@ -596,7 +723,7 @@ static int pispbe_schedule_internal(struct pispbe_node_group *node_group,
 		}
 	}
 
-	/* Pull a buffer from each V4L2 queue to form the queued job */
+	/* Pull a buffer from each V4L2 queue to form the job */
 	for (i = 0; i < PISPBE_NUM_NODES; i++) {
 		if (buf[i]) {
 			node = &node_group->node[i];
@@ -606,22 +733,19 @@ static int pispbe_schedule_internal(struct pispbe_node_group *node_group,
 			spin_unlock_irqrestore(&node->ready_lock,
 					       flags1);
 		}
-		pispbe->queued_job.buf[i] = buf[i];
+		job.buf[i] = buf[i];
 	}
 
-	pispbe->queued_job.node_group = node_group;
-	pispbe->hw_busy = 1;
-	spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+	job.node_group = node_group;
+	job.config = &config_tiles_buffer->config;
+	job.tiles = (dma_addr_t)node_group->config_dma_addr +
+			config_index * sizeof(struct pisp_be_tiles_config) +
+			offsetof(struct pisp_be_tiles_config, tiles);
 
-	/*
-	 * We can kick the job off without the hw_lock, as this can
-	 * never run again until hw_busy is cleared, which will happen
-	 * only when the following job has been queued.
-	 */
-	dev_dbg(pispbe->dev, "Have buffers - starting hardware\n");
+	dev_dbg(pispbe->dev, "Have buffers - preparing job\n");
 
 	/* Convert buffers to DMA addresses for the hardware */
-	fixup_addrs_enables(hw_dma_addrs, hw_enables,
+	fixup_addrs_enables(job.hw_dma_addrs, job.hw_enables,
 			    config_tiles_buffer, buf, node_group);
 	/*
 	 * This could be a spot to fill in the
@@ -629,7 +753,7 @@ static int pispbe_schedule_internal(struct pispbe_node_group *node_group,
 	 */
 	i = config_tiles_buffer->num_tiles;
 	if (i <= 0 || i > PISP_BACK_END_NUM_TILES ||
-	    !((hw_enables[0] | hw_enables[1]) &
+	    !((job.hw_enables[0] | job.hw_enables[1]) &
 	      PISP_BE_BAYER_ENABLE_INPUT)) {
 		/*
 		 * Bad job. We can't let it proceed as it could lock up
@@ -644,56 +768,147 @@ static int pispbe_schedule_internal(struct pispbe_node_group *node_group,
 		dev_err(pispbe->dev, "PROBLEM: Bad job");
 		i = 0;
 	}
-	hw_queue_job(pispbe, hw_dma_addrs, hw_enables,
-		     &config_tiles_buffer->config, tiles, i);
+	job.num_tiles = i;
+
+	kfifo_put(&pispbe->job_queue, job);
+	pispbe_account_job(node_group, job.num_tiles);
 
 	return 1;
 }
 
-/* Try and schedule a job for just a single node group. */
-static void pispbe_schedule_one(struct pispbe_node_group *node_group)
+/*
+ * Prepare a single job, from node_group or, if NULL, from the first node group
+ * that has one ready. Returns non-zero if a job was prepared.
+ *
+ * Warning: needs to be called with hw_lock taken.
+ */
+static int pispbe_prepare_one(struct pispbe_dev *pispbe,
+			      struct pispbe_node_group *node_group)
 {
-	struct pispbe_dev *pispbe = node_group->pispbe;
-	unsigned long flags;
-	int ret;
+	unsigned int order[PISPBE_MAX_NODE_GROUPS];
+	unsigned int i;
 
-	spin_lock_irqsave(&pispbe->hw_lock, flags);
-	if (pispbe->hw_busy) {
-		spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+	if (node_group)
+		return pispbe_prepare_job(node_group);
+
+	pispbe_group_order(pispbe, order);
+	for (i = 0; i < pispbe->num_groups; i++) {
+		if (pispbe_prepare_job(&pispbe->node_group[order[i]]))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Prepare as many jobs as the job queue has room for, from just one node group
+ * or, if node_group is NULL, from any of them in their fair order.
+ *
+ * Warning: needs to be called with hw_lock taken.
+ */
+static void pispbe_fill_job_queue(struct pispbe_dev *pispbe,
+				  struct pispbe_node_group *node_group)
+{
+	if (node_group) {
+		while (pispbe_prepare_job(node_group))
+			;
 		return;
 	}
 
-	/* A non-zero return means the lock was released. */
-	ret = pispbe_schedule_internal(node_group, flags);
-	if (!ret)
-		spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+	while (pispbe_prepare_one(pispbe, NULL))
+		;
 }
 
-/* Try and schedule a job for any of the node groups. */
-static void pispbe_schedule_any(struct pispbe_dev *pispbe, int clear_hw_busy)
+/*
+ * Prepare jobs for node_group (or any group if NULL) and, if the h/w has room,
+ * queue the oldest prepared job to it. The h/w is written first, so that it is
+ * not kept waiting while the job queue is refilled.
+ */
+static void pispbe_schedule(struct pispbe_dev *pispbe,
+			    struct pispbe_node_group *node_group,
+			    int clear_hw_busy)
 {
+	struct pispbe_job job;
 	unsigned long flags;
+	int have_job = 0;
 
 	spin_lock_irqsave(&pispbe->hw_lock, flags);
 
 	if (clear_hw_busy)
 		pispbe->hw_busy = 0;
 	if (pispbe->hw_busy == 0) {
-		unsigned int i;
-
-		for (i = 0; i < PISPBE_NUM_NODE_GROUPS; i++) {
-			/*
-			 * A non-zero return from pispbe_schedule_internal means
-			 * the lock was released.
-			 */
-			if (pispbe_schedule_internal(&pispbe->node_group[i],
-						     flags))
-				return;
+		/* Nothing prepared yet, so prepare just the one needed now. */
+		if (kfifo_is_empty(&pispbe->job_queue))
+			pispbe_prepare_one(pispbe, node_group);
+		if (kfifo_get(&pispbe->job_queue, &job)) {
+			job.node_group->jobs_queued--;
+			job.queue_ns = ktime_get_ns();
+			pispbe->queued_job = job;
+			pispbe->hw_busy = 1;
+			have_job = 1;
 		}
 	}
+
+	spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+
+	/*
+	 * We can kick the job off without the hw_lock, as this can
+	 * never run again until hw_busy is cleared, which will happen
+	 * only when the following job has been queued.
+	 */
+	if (have_job) {
+		dev_dbg(pispbe->dev, "Starting hardware\n");
+		hw_queue_job(pispbe, &job);
+		trace_pispbe_job_queue(job.node_group->id, job.num_tiles);
+	}
+
+	spin_lock_irqsave(&pispbe->hw_lock, flags);
+	pispbe_fill_job_queue(pispbe, node_group);
 	spin_unlock_irqrestore(&pispbe->hw_lock, flags);
 }
 
+/* Try and schedule a job for just a single node group. */
+static void pispbe_schedule_one(struct pispbe_node_group *node_group)
+{
+	pispbe_schedule(node_group->pispbe, node_group, 0);
+}
+
+/* Try and schedule a job for any of the node groups. */
+static void pispbe_schedule_any(struct pispbe_dev *pispbe, int clear_hw_busy)
+{
+	pispbe_schedule(pispbe, NULL, clear_hw_busy);
+}
+
+/*
+ * The hardware runs jobs one after another, so a job started either when it
+ * was queued or when the previous one finished, whichever was later. Both ends
+ * are measured when the driver sees them, so include some interrupt latency.
+ */
+static void pispbe_account_done(struct pispbe_dev *pispbe,
+				struct pispbe_job *job, u64 end_ns)
+{
+	struct pispbe_job_hist *hist = &job->node_group->hist;
+	u64 start_ns = max(job->queue_ns, pispbe->last_done_ns);
+	u64 duration_ns = end_ns - start_ns;
+	unsigned int bucket;
+
+	trace_pispbe_job_done(job->node_group->id, job->node_group->sequence,
+			      job->num_tiles, start_ns, end_ns);
+
+	bucket = log2_hist_bucket(div_u64(duration_ns, NSEC_PER_USEC), 0,
+				  PISPBE_JOB_HIST_BUCKETS);
+
+	spin_lock(&pispbe->hw_lock);
+	pispbe->last_done_ns = end_ns;
+	pispbe->busy_ns += duration_ns;
+	hist->buckets[bucket]++;
+	hist->count++;
+	hist->busy_ns += duration_ns;
+	if (duration_ns > hist->max_ns)
+		hist->max_ns = duration_ns;
+	spin_unlock(&pispbe->hw_lock);
+}
+
 static void pispbe_isr_jobdone(struct pispbe_dev *pispbe,
 			       struct pispbe_job *job)
 {
@@ -701,6 +916,8 @@ static void pispbe_isr_jobdone(struct pispbe_dev *pispbe,
 	u64 ts = ktime_get_ns();
 	int i;
 
+	pispbe_account_done(pispbe, job, ts);
+
 	for (i = 0; i < PISPBE_NUM_NODES; i++) {
 		if (buf[i]) {
 			buf[i]->vb.vb2_buf.timestamp = ts;
@@ -854,6 +1071,39 @@ static int pisp_be_validate_config(struct pispbe_node_group *node_group,
 	return 0;
 }
 
+/*
+ * Validate a config, unless the parts of it that matter, and the node formats,
+ * are the same as for the last config that passed.
+ */
+static int pispbe_validate_config_cached(struct pispbe_node_group *node_group,
+					 struct pisp_be_tiles_config *config)
+{
+	unsigned int gen = atomic_read(&node_group->format_gen);
+	struct pispbe_validated_config key;
+	int ret;
+
+	memset(&key, 0, sizeof(key));
+	key.bayer_enables = config->config.global.bayer_enables;
+	key.rgb_enables = config->config.global.rgb_enables;
+	key.tdn_output_format = config->config.tdn_output_format;
+	key.stitch_output_format = config->config.stitch_output_format;
+	memcpy(key.output_format, config->config.output_format,
+	       sizeof(key.output_format));
+
+	if (node_group->validated_ok && node_group->validated_gen == gen &&
+	    !memcmp(&key, &node_group->validated, sizeof(key)))
+		return 0;
+
+	ret = pisp_be_validate_config(node_group, config);
+	node_group->validated_ok = !ret;
+	if (!ret) {
+		node_group->validated = key;
+		node_group->validated_gen = gen;
+	}
+
+	return ret;
+}
+
 static int pispbe_node_queue_setup(struct vb2_queue *q, unsigned int *nbuffers,
 				   unsigned int *nplanes, unsigned int sizes[],
 				   struct device *alloc_devs[])
@@ -923,7 +1173,7 @@ static int pispbe_node_buffer_prepare(struct vb2_buffer *vb)
 		void *src = vb2_plane_vaddr(vb, 0);
 
 		memcpy(dst, src, sizeof(struct pisp_be_tiles_config));
-		return pisp_be_validate_config(node->node_group, dst);
+		return pispbe_validate_config_cached(node->node_group, dst);
 	}
 
 	return 0;
@@ -1375,6 +1625,7 @@ static int pispbe_node_s_fmt_vid_cap(struct file *file, void *priv,
 		return ret;
 
 	node->format = *f;
+	atomic_inc(&node->node_group->format_gen);
 	node->pisp_format = find_format(f->fmt.pix_mp.pixelformat);
 
 	dev_dbg(pispbe->dev,
@@ -1395,6 +1646,7 @@ static int pispbe_node_s_fmt_vid_out(struct file *file, void *priv,
 		return ret;
 
 	node->format = *f;
+	atomic_inc(&node->node_group->format_gen);
 	node->pisp_format = find_format(f->fmt.pix_mp.pixelformat);
 
 	dev_dbg(pispbe->dev,
@@ -1415,6 +1667,7 @@ static int pispbe_node_s_fmt_meta_out(struct file *file, void *priv,
 		return ret;
 
 	node->format = *f;
+	atomic_inc(&node->node_group->format_gen);
 	node->pisp_format = &meta_out_supported_formats[0];
 
 	dev_dbg(pispbe->dev,
@@ -1435,6 +1688,7 @@ static int pispbe_node_s_fmt_meta_cap(struct file *file, void *priv,
 		return ret;
 
 	node->format = *f;
+	atomic_inc(&node->node_group->format_gen);
 	node->pisp_format = find_format(f->fmt.meta.dataformat);
 
 	dev_dbg(pispbe->dev,
@@ -1743,6 +1997,7 @@ static int pispbe_init_group(struct pispbe_dev *pispbe, unsigned int id)
 	node_group->id = id;
 	node_group->pispbe = pispbe;
 	node_group->streaming_map = 0;
+	node_group->weight = max(1U, pispbe_group_weights[id]);
 
 	dev_info(pispbe->dev, "Register nodes for group %u\n", id);
 
@@ -1862,6 +2117,137 @@ static int pispbe_runtime_resume(struct device *dev)
 	return 0;
 }
 
+static int pispbe_groups_show(struct seq_file *s, void *data)
+{
+	struct pispbe_dev *pispbe = s->private;
+	unsigned long flags;
+	unsigned int i;
+
+	seq_puts(s, "group weight jobs tiles queued\n");
+
+	spin_lock_irqsave(&pispbe->hw_lock, flags);
+	for (i = 0; i < pispbe->num_groups; i++) {
+		struct pispbe_node_group *node_group = &pispbe->node_group[i];
+
+		seq_printf(s, "%5u %6u %llu %llu %u\n", node_group->id,
+			   node_group->weight, node_group->jobs,
+			   node_group->tiles, node_group->jobs_queued);
+	}
+	spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(pispbe_groups);
+
+static void pispbe_job_hist_show(struct seq_file *s,
+				 const struct pispbe_job_hist *hist)
+{
+	int i;
+
+	if (!hist->count)
+		return;
+
+	seq_printf(s, "  jobs=%u avg=%lluus max=%lluus\n", hist->count,
+		   div_u64(div_u64(hist->busy_ns, hist->count), NSEC_PER_USEC),
+		   div_u64(hist->max_ns, NSEC_PER_USEC));
+
+	for (i = 0; i < PISPBE_JOB_HIST_BUCKETS; i++) {
+		if (!hist->buckets[i])
+			continue;
+		if (!i)
+			seq_puts(s, "    <1us");
+		else if (i == PISPBE_JOB_HIST_BUCKETS - 1)
+			seq_printf(s, "    >=%luus", 1UL << (i - 1));
+		else
+			seq_printf(s, "    <%luus", 1UL << i);
+		seq_printf(s, ": %u\n", hist->buckets[i]);
+	}
+}
+
+/* Busy time as a percentage of elapsed, to one decimal place */
+static void pispbe_busy_show(struct seq_file *s, const char *name,
+			     u64 busy_ns, u64 elapsed_ns)
+{
+	u64 permille = elapsed_ns ?
+		div64_u64(busy_ns * 1000, elapsed_ns) : 0;
+
+	seq_printf(s, "%s busy=%lluus (%llu.%llu%%)\n", name,
+		   div_u64(busy_ns, NSEC_PER_USEC),
+		   div_u64(permille, 10), permille % 10);
+}
+
+static int pispbe_utilisation_show(struct seq_file *s, void *data)
+{
+	struct pispbe_dev *pispbe = s->private;
+	struct pispbe_job_hist *hists;
+	u64 busy_ns, elapsed_ns;
+	unsigned long flags;
+	unsigned int i;
+	char name[16];
+
+	/* Take a copy so as not to print with the hw_lock held */
+	hists = kcalloc(pispbe->num_groups, sizeof(*hists), GFP_KERNEL);
+	if (!hists)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&pispbe->hw_lock, flags);
+	for (i = 0; i < pispbe->num_groups; i++)
+		hists[i] = pispbe->node_group[i].hist;
+	busy_ns = pispbe->busy_ns;
+	elapsed_ns = ktime_get_ns() - pispbe->stats_since_ns;
+	spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+
+	seq_printf(s, "elapsed=%lluus\n", div_u64(elapsed_ns, NSEC_PER_USEC));
+	pispbe_busy_show(s, "total", busy_ns, elapsed_ns);
+
+	for (i = 0; i < pispbe->num_groups; i++) {
+		snprintf(name, sizeof(name), "group%u", i);
+		pispbe_busy_show(s, name, hists[i].busy_ns, elapsed_ns);
+		pispbe_job_hist_show(s, &hists[i]);
+	}
+
+	kfree(hists);
+
+	return 0;
+}
+
+static int pispbe_utilisation_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pispbe_utilisation_show, inode->i_private);
+}
+
+/* Any write resets the utilisation statistics */
+static ssize_t pispbe_utilisation_write(struct file *file,
+					const char __user *buffer,
+					size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct pispbe_dev *pispbe = s->private;
+	unsigned long flags;
+	unsigned int i;
+
+	spin_lock_irqsave(&pispbe->hw_lock, flags);
+	for (i = 0; i < pispbe->num_groups; i++)
+		memset(&pispbe->node_group[i].hist, 0,
+		       sizeof(pispbe->node_group[i].hist));
+	pispbe->busy_ns = 0;
+	pispbe->stats_since_ns = ktime_get_ns();
+	spin_unlock_irqrestore(&pispbe->hw_lock, flags);
+
+	*ppos += count;
+
+	return count;
+}
+
+static const struct file_operations pispbe_utilisation_fops = {
+	.owner		= THIS_MODULE,
+	.open		= pispbe_utilisation_open,
+	.write		= pispbe_utilisation_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  * Probe the ISP-BE hardware block, as a single platform device.
  * This will instantiate multiple "node groups" each with many device nodes.
@@ -1870,12 +2256,21 @@ static int pispbe_probe(struct platform_device *pdev)
 {
 	unsigned int num_groups = 0;
 	struct pispbe_dev *pispbe;
+	char debugfs_name[32];
 	int ret;
 
 	pispbe = devm_kzalloc(&pdev->dev, sizeof(*pispbe), GFP_KERNEL);
 	if (!pispbe)
 		return -ENOMEM;
 
+	pispbe->num_groups = clamp(pispbe_num_groups, 1U,
+				   (unsigned int)PISPBE_MAX_NODE_GROUPS);
+	pispbe->node_group = devm_kcalloc(&pdev->dev, pispbe->num_groups,
+					  sizeof(*pispbe->node_group),
+					  GFP_KERNEL);
+	if (!pispbe->node_group)
+		return -ENOMEM;
+
 	dev_set_drvdata(&pdev->dev, pispbe);
 	pispbe->dev = &pdev->dev;
 	platform_set_drvdata(pdev, pispbe);
@@ -1918,7 +2313,9 @@ static int pispbe_probe(struct platform_device *pdev)
 		goto pm_runtime_disable_err;
 
 	pispbe->hw_busy = 0;
+	INIT_KFIFO(pispbe->job_queue);
 	spin_lock_init(&pispbe->hw_lock);
+	pispbe->stats_since_ns = ktime_get_ns();
 	ret = hw_init(pispbe);
 	if (ret)
 		goto pm_runtime_put_err;
@@ -1928,13 +2325,21 @@ static int pispbe_probe(struct platform_device *pdev)
 	 * device
 	 */
 	for (num_groups = 0;
-	     num_groups < PISPBE_NUM_NODE_GROUPS;
+	     num_groups < pispbe->num_groups;
 	     num_groups++) {
 		ret = pispbe_init_group(pispbe, num_groups);
 		if (ret)
 			goto disable_nodes_err;
 	}
 
+	snprintf(debugfs_name, sizeof(debugfs_name), PISPBE_NAME ":%s",
+		 dev_name(&pdev->dev));
+	pispbe->debugfs = debugfs_create_dir(debugfs_name, NULL);
+	debugfs_create_file("groups", 0444, pispbe->debugfs, pispbe,
+			    &pispbe_groups_fops);
+	debugfs_create_file("utilisation", 0644, pispbe->debugfs, pispbe,
+			    &pispbe_utilisation_fops);
+
 	pm_runtime_mark_last_busy(pispbe->dev);
 	pm_runtime_put_autosuspend(pispbe->dev);
 
@@ -1959,7 +2364,9 @@ static int pispbe_remove(struct platform_device *pdev)
 	struct pispbe_dev *pispbe = platform_get_drvdata(pdev);
 	int i;
 
-	for (i = PISPBE_NUM_NODE_GROUPS - 1; i >= 0; i--)
+	debugfs_remove_recursive(pispbe->debugfs);
+
+	for (i = pispbe->num_groups - 1; i >= 0; i--)
 		pispbe_destroy_node_group(&pispbe->node_group[i]);
 
 	pm_runtime_dont_use_autosuspend(pispbe->dev);
@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * PiSP Back End driver tracepoints.
+ * Copyright (c) 2021-2022 Raspberry Pi Limited.
+ *
+ */
+
+#if !defined(_PISP_BE_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _PISP_BE_TRACE_H_
+
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pispbe
+#define TRACE_INCLUDE_FILE pisp_be_trace
+
+TRACE_EVENT(pispbe_job_queue,
+	    TP_PROTO(unsigned int group, unsigned int num_tiles),
+	    TP_ARGS(group, num_tiles),
+
+	    TP_STRUCT__entry(
+			     __field(unsigned int, group)
+			     __field(unsigned int, num_tiles)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->group = group;
+			   __entry->num_tiles = num_tiles;
+			   ),
+
+	    TP_printk("group=%u tiles=%u", __entry->group, __entry->num_tiles)
+);
+
+TRACE_EVENT(pispbe_job_done,
+	    TP_PROTO(unsigned int group, unsigned int sequence,
+		     unsigned int num_tiles, u64 start_ns, u64 end_ns),
+	    TP_ARGS(group, sequence, num_tiles, start_ns, end_ns),
+
+	    TP_STRUCT__entry(
+			     __field(unsigned int, group)
+			     __field(unsigned int, sequence)
+			     __field(unsigned int, num_tiles)
+			     __field(u64, start_ns)
+			     __field(u64, end_ns)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->group = group;
+			   __entry->sequence = sequence;
+			   __entry->num_tiles = num_tiles;
+			   __entry->start_ns = start_ns;
+			   __entry->end_ns = end_ns;
+			   ),
+
+	    TP_printk("group=%u sequence=%u tiles=%u start=%llu end=%llu duration=%lluns",
+		      __entry->group, __entry->sequence, __entry->num_tiles,
+		      __entry->start_ns, __entry->end_ns,
+		      __entry->end_ns - __entry->start_ns)
+);
+
+#endif /* _PISP_BE_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../drivers/media/platform/raspberrypi/pisp_be
+#include <trace/define_trace.h>
@@ -28,6 +28,8 @@
 #include <linux/uaccess.h>
 #include <linux/videodev2.h>
 
+#include <uapi/linux/media/raspberrypi/rp1_cfe.h>
+
 #include <media/v4l2-async.h>
 #include <media/v4l2-common.h>
 #include <media/v4l2-ctrls.h>
@@ -53,6 +55,11 @@ bool cfe_debug_verbose;
 module_param_named(verbose_debug, cfe_debug_verbose, bool, 0644);
 MODULE_PARM_DESC(verbose_debug, "verbose debugging messages");
 
+static bool cfe_independent_channels;
+module_param_named(independent_channels, cfe_independent_channels, bool, 0444);
+MODULE_PARM_DESC(independent_channels,
+		 "schedule each CSI2 channel independently when the FE is not used");
+
 #define cfe_dbg_verbose(fmt, arg...)                          \
 	do {                                                  \
 		if (cfe_debug_verbose)                        \
@@ -95,6 +102,18 @@ MODULE_PARM_DESC(verbose_debug, "verbose debugging messages");
 /* Default size of the embedded buffer */
 #define DEFAULT_EMBEDDED_SIZE 16384
 
+/*
+ * Frames for a CSI2 node with no buffer queued are written here instead. The
+ * length limit stops anything past the end being written, so it can be small.
+ */
+#define SCRATCH_SIZE 4096
+
+/*
+ * Stay powered for a while after streaming stops, so that a quick restart
+ * (e.g. a sensor mode switch) doesn't have to set the D-PHY up again.
+ */
+#define CFE_AUTOSUSPEND_DELAY_MS 1000
+
 const struct v4l2_mbus_framefmt cfe_default_format = {
 	.width = 640,
 	.height = 480,
@@ -274,6 +293,13 @@ struct cfe_node {
 	struct media_pad pad;
 	unsigned int fs_count;
 	u64 ts;
+	/* next_frm has been given to the hardware (independent channels only) */
+	bool job_queued;
+	/* Line count for V4L2_EVENT_RP1_CFE_LINE, and its subscribers */
+	unsigned int line_event;
+	unsigned int line_event_users;
+	/* Frames that started with no buffer to write them to */
+	unsigned int dropped;
 };
 
 struct cfe_device {
@@ -313,6 +339,13 @@ struct cfe_device {
 	struct pisp_fe_device fe;
 
 	int fe_csi2_channel;
+
+	/* Schedule CSI2 channels independently of each other */
+	bool independent_channels;
+
+	/* Where to send CSI2 frames when there is no buffer for them */
+	void *scratch;
+	dma_addr_t scratch_addr;
 };
 
 static inline bool is_fe_enabled(struct cfe_device *cfe)
@@ -320,6 +353,17 @@ static inline bool is_fe_enabled(struct cfe_device *cfe)
 	return cfe->fe_csi2_channel != -1;
 }
 
+/*
+ * With independent channels, each CSI2 node is armed with its next buffer as
+ * soon as it has one, so a node that is short of buffers only drops its own
+ * frames rather than holding up all the others. This can't work with the FE,
+ * as its outputs and the CSI2 channel feeding it make up a single job.
+ */
+static inline bool is_csi2_independent(struct cfe_device *cfe)
+{
+	return cfe->independent_channels && !is_fe_enabled(cfe);
+}
+
 static inline struct cfe_device *to_cfe_device(struct v4l2_device *v4l2_dev)
 {
 	return container_of(v4l2_dev, struct cfe_device, v4l2_dev);
@@ -446,6 +490,9 @@ static int format_show(struct seq_file *s, void *data)
 				   V4L2_FOURCC_CONV_ARGS(node->meta_fmt.fmt.meta.dataformat),
 				   node->meta_fmt.fmt.meta.dataformat,
 				   node->meta_fmt.fmt.meta.buffersize);
+
+		if (is_csi2_node(node))
+			seq_printf(s, "dropped: %u\n", node->dropped);
 	}
 
 	return 0;
@@ -548,38 +595,70 @@ static int cfe_calc_format_size_bpl(struct cfe_device *cfe,
 	return 0;
 }
 
-static void cfe_schedule_next_csi2_job(struct cfe_device *cfe)
+static void cfe_schedule_next_csi2_buffer(struct cfe_node *node)
 {
+	struct cfe_device *cfe = node->cfe;
 	struct cfe_buffer *buf;
-	unsigned int i;
+	unsigned int stride, size;
 	dma_addr_t addr;
 
-	for (i = 0; i < CSI2_NUM_CHANNELS; i++) {
-		struct cfe_node *node = &cfe->node[i];
-		unsigned int stride, size;
+	/*
+	 * Keep the channel running into the scratch buffer rather than leaving
+	 * it unarmed, so that there is no glitch when buffers are queued again.
+	 */
+	if (list_empty(&node->dma_queue)) {
+		cfe_dbg_verbose("%s: [%s] no buffer, using scratch\n", __func__,
+				node_desc[node->id].name);
+		node->next_frm = NULL;
+		csi2_set_buffer(&cfe->csi2, node->id, cfe->scratch_addr, 0,
+				SCRATCH_SIZE);
+		return;
+	}
+
+	buf = list_first_entry(&node->dma_queue, struct cfe_buffer, list);
+	node->next_frm = buf;
+	list_del(&buf->list);
 
+	cfe_dbg_verbose("%s: [%s] buffer:%p\n", __func__,
+			node_desc[node->id].name, &buf->vb.vb2_buf);
+
+	if (is_meta_node(node)) {
+		size = node->meta_fmt.fmt.meta.buffersize;
+		stride = 0;
+	} else {
+		size = node->vid_fmt.fmt.pix.sizeimage;
+		stride = node->vid_fmt.fmt.pix.bytesperline;
+	}
+
+	addr = vb2_dma_contig_plane_dma_addr(&buf->vb.vb2_buf, 0);
+	csi2_set_buffer(&cfe->csi2, node->id, addr, stride, size);
+}
+
+static void cfe_schedule_next_csi2_job(struct cfe_device *cfe)
+{
+	unsigned int i;
+
+	for (i = 0; i < CSI2_NUM_CHANNELS; i++) {
 		if (!check_state(cfe, NODE_STREAMING, i))
 			continue;
 
-		buf = list_first_entry(&node->dma_queue, struct cfe_buffer,
-				       list);
-		node->next_frm = buf;
-		list_del(&buf->list);
+		cfe_schedule_next_csi2_buffer(&cfe->node[i]);
+	}
+}
 
-		cfe_dbg_verbose("%s: [%s] buffer:%p\n", __func__,
-				node_desc[node->id].name, &buf->vb.vb2_buf);
+/*
+ * Arm a single channel with its next buffer, if it has one and isn't already
+ * armed. Only used with independent channels.
+ */
+static void cfe_prepare_next_csi2_node(struct cfe_node *node)
+{
+	struct cfe_device *cfe = node->cfe;
 
-		if (is_meta_node(node)) {
-			size = node->meta_fmt.fmt.meta.buffersize;
-			stride = 0;
-		} else {
-			size = node->vid_fmt.fmt.pix.sizeimage;
-			stride = node->vid_fmt.fmt.pix.bytesperline;
-		}
+	if (node->job_queued || !check_state(cfe, NODE_STREAMING, node->id))
+		return;
 
-		addr = vb2_dma_contig_plane_dma_addr(&buf->vb.vb2_buf, 0);
-		csi2_set_buffer(&cfe->csi2, node->id, addr, stride, size);
-	}
+	node->job_queued = true;
+	cfe_schedule_next_csi2_buffer(node);
 }
 
 static void cfe_schedule_next_pisp_job(struct cfe_device *cfe)
@@ -595,6 +674,12 @@ static void cfe_schedule_next_pisp_job(struct cfe_device *cfe)
 		if (!check_state(cfe, NODE_STREAMING, i))
 			continue;
 
+		/* With no new config, the FE repeats the last one. */
+		if (i == FE_CONFIG && list_empty(&node->dma_queue)) {
+			node->next_frm = NULL;
+			continue;
+		}
+
 		buf = list_first_entry(&node->dma_queue, struct cfe_buffer,
 				       list);
 
@@ -606,8 +691,10 @@ static void cfe_schedule_next_pisp_job(struct cfe_device *cfe)
 		list_del(&buf->list);
 	}
 
-	config_buf = to_cfe_config_buffer(cfe->node[FE_CONFIG].next_frm);
-	pisp_fe_submit_job(&cfe->fe, vb2_bufs, &config_buf->config);
+	buf = cfe->node[FE_CONFIG].next_frm;
+	config_buf = buf ? to_cfe_config_buffer(buf) : NULL;
+	pisp_fe_submit_job(&cfe->fe, vb2_bufs,
+			   config_buf ? &config_buf->config : NULL);
 }
 
 static bool cfe_check_job_ready(struct cfe_device *cfe)
@@ -620,6 +707,14 @@ static bool cfe_check_job_ready(struct cfe_device *cfe)
 		if (!check_state(cfe, NODE_ENABLED, i))
 			continue;
 
+		/* CSI2 nodes can always fall back to the scratch buffer. */
+		if (is_csi2_node(node))
+			continue;
+
+		/* And the FE config node to the previous config. */
+		if (i == FE_CONFIG && pisp_fe_can_repeat_config(&cfe->fe))
+			continue;
+
 		if (list_empty(&node->dma_queue)) {
 			cfe_dbg_verbose("%s: [%s] has no buffer, unable to schedule job\n",
 				__func__, node_desc[i].name);
@@ -665,6 +760,21 @@ static void cfe_queue_event_sof(struct cfe_node *node)
 	v4l2_event_queue(&node->video_dev, &event);
 }
 
+static void cfe_queue_event_line(struct cfe_node *node)
+{
+	struct v4l2_event event = {
+		.type = V4L2_EVENT_RP1_CFE_LINE,
+		.id = node->line_event,
+	};
+	struct rp1_cfe_line_event *line =
+		(struct rp1_cfe_line_event *)event.u.data;
+
+	line->line = node->line_event;
+	line->sequence = node->fs_count - 1;
+
+	v4l2_event_queue(&node->video_dev, &event);
+}
+
 static void cfe_sof_isr_handler(struct cfe_node *node)
 {
 	struct cfe_device *cfe = node->cfe;
@@ -689,6 +799,9 @@ static void cfe_sof_isr_handler(struct cfe_node *node)
 	node->next_frm = NULL;
 	node->fs_count++;
 
+	if (!node->cur_frm && node->id != FE_CONFIG)
+		node->dropped++;
+
 	node->ts = ktime_get_ns();
 	for (i = 0; i < NUM_NODES; i++) {
 		if (!check_state(cfe, NODE_STREAMING, i) || i == node->id)
@@ -707,7 +820,9 @@ static void cfe_sof_isr_handler(struct cfe_node *node)
 			matching_fs = false;
 	}
 
-	if (matching_fs)
+	if (is_csi2_independent(cfe))
+		node->job_queued = false;
+	else if (matching_fs)
 		cfe->job_queued = false;
 
 	if (node->cur_frm)
@@ -739,13 +854,13 @@ static irqreturn_t cfe_isr(int irq, void *dev)
 {
 	struct cfe_device *cfe = dev;
 	unsigned int i;
-	bool sof[NUM_NODES] = {0}, eof[NUM_NODES] = {0};
+	bool sof[NUM_NODES] = {0}, eof[NUM_NODES] = {0}, lof[NUM_NODES] = {0};
 	u32 sts;
 
 	sts = cfg_reg_read(cfe, MIPICFG_INTS);
 
 	if (sts & MIPICFG_INT_CSI_DMA)
-		csi2_isr(&cfe->csi2, sof, eof);
+		csi2_isr(&cfe->csi2, sof, eof, lof);
 
 	if (sts & MIPICFG_INT_PISP_FE)
 		pisp_fe_isr(&cfe->fe, sof + CSI2_NUM_CHANNELS,
@@ -762,7 +877,7 @@ static irqreturn_t cfe_isr(int irq, void *dev)
 		 * generate interrupts even though the node is not streaming.
 		 */
 		if (!check_state(cfe, NODE_STREAMING, i) ||
-		    !(sof[i] || eof[i]))
+		    !(sof[i] || eof[i] || lof[i]))
 			continue;
 
 		/*
@@ -809,7 +924,13 @@ static irqreturn_t cfe_isr(int irq, void *dev)
 			cfe_sof_isr_handler(node);
 		}
 
-		if (!cfe->job_queued && cfe->job_ready)
+		/* This belongs to the frame started most recently. */
+		if (lof[i] && node->line_event)
+			cfe_queue_event_line(node);
+
+		if (is_csi2_independent(cfe))
+			cfe_prepare_next_csi2_node(node);
+		else if (!cfe->job_queued && cfe->job_ready)
 			cfe_prepare_next_job(cfe);
 	}
 
@@ -861,6 +982,7 @@ static void cfe_start_channel(struct cfe_node *node)
 		 * even if we are connected to the front end. Once running,
 		 * this is handled by the CSI2 AUTO_ARM mode.
 		 */
+		cfe->csi2.line_irq[cfe->fe_csi2_channel] = 0;
 		csi2_start_channel(&cfe->csi2, cfe->fe_csi2_channel,
 				   CSI2_MODE_FE_STREAMING,
 				   true, false, width, height);
@@ -895,6 +1017,8 @@ static void cfe_start_channel(struct cfe_node *node)
 						     0);
 			}
 		}
+		cfe->csi2.line_irq[node->id] = node->line_event;
+
 		/* Unconditionally start this CSI2 channel. */
 		csi2_start_channel(&cfe->csi2, node->id,
 				   mode,
@@ -908,7 +1032,10 @@ static void cfe_start_channel(struct cfe_node *node)
 	v4l2_subdev_unlock_state(state);
 
 	spin_lock_irqsave(&cfe->state_lock, flags);
-	if (cfe->job_ready && test_all_nodes(cfe, NODE_ENABLED, NODE_STREAMING))
+	if (is_csi2_independent(cfe))
+		cfe_prepare_next_csi2_node(node);
+	else if (cfe->job_ready &&
+		 test_all_nodes(cfe, NODE_ENABLED, NODE_STREAMING))
 		cfe_prepare_next_job(cfe);
 	spin_unlock_irqrestore(&cfe->state_lock, flags);
 }
@@ -951,6 +1078,7 @@ static void cfe_return_buffers(struct cfe_node *node,
 
 	node->cur_frm = NULL;
 	node->next_frm = NULL;
+	node->job_queued = false;
 	spin_unlock_irqrestore(&cfe->state_lock, flags);
 }
 
@@ -1034,6 +1162,12 @@ static void cfe_buffer_queue(struct vb2_buffer *vb)
 
 	list_add_tail(&buf->list, &node->dma_queue);
 
+	if (is_csi2_independent(cfe)) {
+		cfe_prepare_next_csi2_node(node);
+		spin_unlock_irqrestore(&cfe->state_lock, flags);
+		return;
+	}
+
 	if (!cfe->job_ready)
 		cfe->job_ready = cfe_check_job_ready(cfe);
 
@@ -1139,6 +1273,8 @@ static int cfe_start_streaming(struct vb2_queue *vq, unsigned int count)
 	clear_state(cfe, FS_INT | FE_INT, node->id);
 	set_state(cfe, NODE_STREAMING, node->id);
 	node->fs_count = 0;
+	node->dropped = 0;
+	node->job_queued = false;
 	cfe_start_channel(node);
 
 	if (!test_all_nodes(cfe, NODE_ENABLED, NODE_STREAMING)) {
@@ -1228,7 +1364,8 @@ static void cfe_stop_streaming(struct vb2_queue *vq)
 	/* Clear all queued buffers for the node */
 	cfe_return_buffers(node, VB2_BUF_STATE_ERROR);
 
-	pm_runtime_put(&cfe->pdev->dev);
+	pm_runtime_mark_last_busy(&cfe->pdev->dev);
+	pm_runtime_put_autosuspend(&cfe->pdev->dev);
 
 	cfe_dbg("%s: [%s] end.\n", __func__, node_desc[node->id].name);
 }
@@ -1571,6 +1708,46 @@ static int cfe_vb2_ioctl_create_bufs(struct file *file, void *priv,
 	return vb2_ioctl_create_bufs(file, priv, p);
 }
 
+static int cfe_line_event_add(struct v4l2_subscribed_event *sev,
+			      unsigned int elems)
+{
+	struct cfe_node *node = video_get_drvdata(sev->fh->vdev);
+	struct cfe_device *cfe = node->cfe;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!sev->id || sev->id > CSI2_MAX_LINE_IRQ)
+		return -EINVAL;
+
+	spin_lock_irqsave(&cfe->state_lock, flags);
+	if (node->line_event_users && node->line_event != sev->id) {
+		ret = -EBUSY;
+	} else {
+		node->line_event = sev->id;
+		node->line_event_users++;
+	}
+	spin_unlock_irqrestore(&cfe->state_lock, flags);
+
+	return ret;
+}
+
+static void cfe_line_event_del(struct v4l2_subscribed_event *sev)
+{
+	struct cfe_node *node = video_get_drvdata(sev->fh->vdev);
+	struct cfe_device *cfe = node->cfe;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cfe->state_lock, flags);
+	if (!--node->line_event_users)
+		node->line_event = 0;
+	spin_unlock_irqrestore(&cfe->state_lock, flags);
+}
+
+static const struct v4l2_subscribed_event_ops cfe_line_event_ops = {
+	.add = cfe_line_event_add,
+	.del = cfe_line_event_del,
+};
+
 static int cfe_subscribe_event(struct v4l2_fh *fh,
 			       const struct v4l2_event_subscription *sub)
 {
@@ -1588,6 +1765,11 @@ static int cfe_subscribe_event(struct v4l2_fh *fh,
 			break;
 
 		return v4l2_event_subscribe(fh, sub, 4, NULL);
+	case V4L2_EVENT_RP1_CFE_LINE:
+		if (!is_csi2_node(node) || !node_supports_image_output(node))
+			break;
+
+		return v4l2_event_subscribe(fh, sub, 2, &cfe_line_event_ops);
 	}
 
 	return v4l2_ctrl_subscribe_event(fh, sub);
@@ -2211,6 +2393,7 @@ static int cfe_probe(struct platform_device *pdev)
 	kref_init(&cfe->kref);
 	cfe->pdev = pdev;
 	cfe->fe_csi2_channel = -1;
+	cfe->independent_channels = cfe_independent_channels;
 	spin_lock_init(&cfe->state_lock);
 
 	cfe->csi2.base = devm_platform_ioremap_resource(pdev, 0);
@@ -2261,6 +2444,13 @@ static int cfe_probe(struct platform_device *pdev)
 		goto err_cfe_put;
 	}
 
+	cfe->scratch = dmam_alloc_coherent(&pdev->dev, SCRATCH_SIZE,
+					   &cfe->scratch_addr, GFP_KERNEL);
+	if (!cfe->scratch) {
+		ret = -ENOMEM;
+		goto err_cfe_put;
+	}
+
 	/* TODO: Enable clock only when running. */
 	cfe->clk = devm_clk_get(&pdev->dev, NULL);
 	if (IS_ERR(cfe->clk))
@@ -2292,6 +2482,8 @@ static int cfe_probe(struct platform_device *pdev)
 			    &mipi_cfg_regs_fops);
 
 	/* Enable the block power domain */
+	pm_runtime_set_autosuspend_delay(&pdev->dev, CFE_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(&pdev->dev);
 	pm_runtime_enable(&pdev->dev);
 
 	ret = pm_runtime_resume_and_get(&cfe->pdev->dev);
@@ -2339,6 +2531,7 @@ static int cfe_probe(struct platform_device *pdev)
 	pm_runtime_put(&cfe->pdev->dev);
 err_runtime_disable:
 	pm_runtime_disable(&pdev->dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 	debugfs_remove(cfe->debugfs);
 	v4l2_device_unregister(&cfe->v4l2_dev);
 err_cfe_put:
@@ -2361,6 +2554,7 @@ static int cfe_remove(struct platform_device *pdev)
 	csi2_uninit(&cfe->csi2);
 
 	pm_runtime_disable(&pdev->dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
 
 	v4l2_device_unregister(&cfe->v4l2_dev);
 
@@ -2375,6 +2569,7 @@ static int cfe_runtime_suspend(struct device *dev)
 	struct cfe_device *cfe = platform_get_drvdata(pdev);
 
 	clk_disable_unprepare(cfe->clk);
+	dphy_invalidate(&cfe->csi2.dphy);
 
 	return 0;
 }
@@ -258,7 +258,7 @@ static void csi2_isr_handle_errors(struct csi2_device *csi2, u32 status)
 	spin_unlock(&csi2->errors_lock);
 }
 
-void csi2_isr(struct csi2_device *csi2, bool *sof, bool *eof)
+void csi2_isr(struct csi2_device *csi2, bool *sof, bool *eof, bool *lof)
 {
 	unsigned int i;
 	u32 status;
@@ -290,6 +290,7 @@ void csi2_isr(struct csi2_device *csi2, bool *sof, bool *eof)
 
 		sof[i] = !!(status & IRQ_FS(i));
 		eof[i] = !!(status & IRQ_FE_ACK(i));
+		lof[i] = !!(status & IRQ_LE_ACK(i));
 	}
 
 	if (csi2_track_errors)
@@ -417,6 +418,15 @@ void csi2_start_channel(struct csi2_device *csi2, unsigned int channel,
 	if (auto_arm)
 		ctrl |= AUTO_ARM;
 
+	/*
+	 * The line count compare raises LE_ACK once the given number of lines
+	 * of the frame have been written out.
+	 */
+	if (csi2->line_irq[channel]) {
+		ctrl |= IRQ_EN_LE_ACK;
+		set_field(&ctrl, csi2->line_irq[channel], LC_MASK);
+	}
+
 	if (width && height) {
 		set_field(&ctrl, mode, CH_MODE_MASK);
 		csi2_reg_write(csi2, CSI2_CH_FRAME_SIZE(channel),
@@ -19,6 +19,9 @@
 
 #define DISCARDS_TABLE_NUM_VCS 4
 
+/* Largest line count usable for the line interrupt */
+#define CSI2_MAX_LINE_IRQ 1023
+
 enum csi2_mode {
 	CSI2_MODE_NORMAL = 0,
 	CSI2_MODE_REMAP = 1,
@@ -59,6 +62,8 @@ struct csi2_device {
 	unsigned int bus_flags;
 	bool multipacket_line;
 	unsigned int num_lines[CSI2_NUM_CHANNELS];
+	/* Raise a line interrupt after this many lines, 0 to disable */
+	unsigned int line_irq[CSI2_NUM_CHANNELS];
 
 	struct media_pad pad[CSI2_NUM_CHANNELS * 2];
 	struct v4l2_subdev sd;
@@ -70,7 +75,7 @@ struct csi2_device {
 	u32 discards_dt_table[DISCARDS_TABLE_NUM_ENTRIES];
 };
 
-void csi2_isr(struct csi2_device *csi2, bool *sof, bool *eof);
+void csi2_isr(struct csi2_device *csi2, bool *sof, bool *eof, bool *lof);
 void csi2_set_buffer(struct csi2_device *csi2, unsigned int channel,
 		     dma_addr_t dmaaddr, unsigned int stride,
 		     unsigned int size);
@@ -150,7 +150,22 @@ static void dphy_init(struct dphy_data *dphy)
 void dphy_start(struct dphy_data *dphy)
 {
 	dw_csi2_host_write(dphy, N_LANES, (dphy->active_lanes - 1));
-	dphy_init(dphy);
+
+	/*
+	 * dphy_stop() only resets the host controller and leaves the PHY
+	 * powered up, so a restart at the same rate and lane count (as when
+	 * switching sensor modes) can keep the PHY as it is.
+	 */
+	if (dphy->init_rate != dphy->dphy_rate ||
+	    dphy->init_lanes != dphy->active_lanes) {
+		dphy_init(dphy);
+		dphy->init_rate = dphy->dphy_rate;
+		dphy->init_lanes = dphy->active_lanes;
+	} else {
+		dphy_dbg("DPHY: already set up for %u Mbps, %u lanes\n",
+			 dphy->dphy_rate, dphy->active_lanes);
+	}
+
 	dw_csi2_host_write(dphy, RESETN, 0xffffffff);
 	usleep_range(10, 50);
 }
@@ -162,6 +177,13 @@ void dphy_stop(struct dphy_data *dphy)
 	dw_csi2_host_write(dphy, RESETN, 0);
 }
 
+/* Forget the PHY setup, so it is redone next time, e.g. after power down. */
+void dphy_invalidate(struct dphy_data *dphy)
+{
+	dphy->init_rate = 0;
+	dphy->init_lanes = 0;
+}
+
 void dphy_probe(struct dphy_data *dphy)
 {
 	u32 host_ver;
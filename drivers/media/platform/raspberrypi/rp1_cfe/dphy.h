@@ -18,10 +18,15 @@ struct dphy_data {
 	u32 dphy_rate;
 	u32 max_lanes;
 	u32 active_lanes;
+
+	/* What the PHY was last initialised for, zero if not known */
+	u32 init_rate;
+	u32 init_lanes;
 };
 
 void dphy_probe(struct dphy_data *dphy);
 void dphy_start(struct dphy_data *dphy);
 void dphy_stop(struct dphy_data *dphy);
+void dphy_invalidate(struct dphy_data *dphy);
 
 #endif
@@ -16,6 +16,16 @@
 #include "pisp_fe.h"
 #include "cfe.h"
 
+static bool pisp_fe_early_stats;
+module_param_named(early_stats, pisp_fe_early_stats, bool, 0644);
+MODULE_PARM_DESC(early_stats,
+		 "return statistics as soon as they are written, takes effect on the next stream start");
+
+static bool pisp_fe_repeat_config = true;
+module_param_named(repeat_config, pisp_fe_repeat_config, bool, 0644);
+MODULE_PARM_DESC(repeat_config,
+		 "run frames with no config buffer queued using the previous config, takes effect on the next stream start");
+
 #define FE_VERSION		0x000
 #define FE_CONTROL		0x004
 #define FE_STATUS		0x008
@@ -213,6 +223,21 @@ void pisp_fe_isr(struct pisp_fe_device *fe, bool *sof, bool *eof)
 		sof[i] = !!(int_status & FE_INT_SOF);
 		eof[i] = !!(int_status & FE_INT_EOF);
 	}
+
+	/*
+	 * In early stats mode, the stats buffer is finished when the stats
+	 * have been written, which is usually well before the end of frame.
+	 * Only report it once per frame though, and still at the end of frame
+	 * if the stats never arrived (e.g. were not enabled).
+	 */
+	if (fe->early_stats) {
+		unsigned int s = FE_STATS_PAD - FE_OUTPUT0_PAD;
+		bool stats = !!(int_status & FE_INT_STATS);
+		bool frame_end = eof[s];
+
+		eof[s] = (stats || frame_end) && !fe->stats_done;
+		fe->stats_done = (fe->stats_done || stats) && !frame_end;
+	}
 }
 
 static bool pisp_fe_validate_output(struct pisp_fe_config const *cfg,
@@ -301,6 +326,21 @@ int pisp_fe_validate_config(struct pisp_fe_device *fe,
 	return 0;
 }
 
+/*
+ * Whether a job can be submitted without a new config, in which case the last
+ * one is used again. Configs can then be queued any number of frames ahead, and
+ * each is returned with the sequence number of the frame it was applied to,
+ * without a late one stalling the pipeline.
+ */
+bool pisp_fe_can_repeat_config(struct pisp_fe_device *fe)
+{
+	return fe->repeat_config && fe->last_config_valid;
+}
+
+/*
+ * Submit a job with the given config or, if cfg is NULL, with the last config
+ * again (see pisp_fe_can_repeat_config).
+ */
 void pisp_fe_submit_job(struct pisp_fe_device *fe, struct vb2_buffer **vb2_bufs,
 			struct pisp_fe_config *cfg)
 {
@@ -308,6 +348,12 @@ void pisp_fe_submit_job(struct pisp_fe_device *fe, struct vb2_buffer **vb2_bufs,
 	u64 addr;
 	u32 status;
 
+	if (!cfg) {
+		if (WARN_ON(!pisp_fe_can_repeat_config(fe)))
+			return;
+		cfg = &fe->last_config;
+	}
+
 	/*
 	 * Check output buffers exist and outputs are correctly configured.
 	 * If valid, set the buffer's DMA address; otherwise disable.
@@ -369,13 +415,29 @@ void pisp_fe_submit_job(struct pisp_fe_device *fe, struct vb2_buffer **vb2_bufs,
 
 	/* This final non-relaxed write serves as a memory barrier */
 	pisp_fe_reg_write(fe, FE_CONTROL, FE_CONTROL_QUEUE);
+
+	/*
+	 * The hardware now holds all the parameters, so a repeat of this
+	 * config only needs the unconditional ones written again.
+	 */
+	if (fe->repeat_config && cfg != &fe->last_config) {
+		fe->last_config = *cfg;
+		fe->last_config.dirty_flags = 0;
+		fe->last_config.dirty_flags_extra = 0;
+		fe->last_config_valid = true;
+	}
 }
 
 void pisp_fe_start(struct pisp_fe_device *fe)
 {
 	pisp_fe_reg_write(fe, FE_CONTROL, FE_CONTROL_RESET);
 	pisp_fe_reg_write(fe, FE_INT_STATUS, ~0);
-	pisp_fe_reg_write(fe, FE_INT_EN, FE_INT_EOF | FE_INT_SOF | FE_INT_LINES0 | FE_INT_LINES1);
+	fe->early_stats = pisp_fe_early_stats;
+	fe->stats_done = false;
+	fe->repeat_config = pisp_fe_repeat_config;
+	fe->last_config_valid = false;
+	pisp_fe_reg_write(fe, FE_INT_EN, FE_INT_EOF | FE_INT_SOF | FE_INT_LINES0 | FE_INT_LINES1 |
+			  (fe->early_stats ? FE_INT_STATS : 0));
 	fe->inframe_count = 0;
 }
 
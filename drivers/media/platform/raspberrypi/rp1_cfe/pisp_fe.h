@@ -34,6 +34,16 @@ struct pisp_fe_device {
 	u32 hw_revision;
 
 	u16 inframe_count;
+	/* Complete the stats buffer on FE_INT_STATS rather than end of frame */
+	bool early_stats;
+	bool stats_done;
+	/*
+	 * The config most recently given to the hardware, reused for frames
+	 * that have no config buffer of their own when repeat_config is set.
+	 */
+	bool repeat_config;
+	bool last_config_valid;
+	struct pisp_fe_config last_config;
 	struct media_pad pad[FE_NUM_PADS];
 	struct v4l2_subdev sd;
 };
@@ -45,6 +55,7 @@ int pisp_fe_validate_config(struct pisp_fe_device *fe,
 			    struct v4l2_format const *f1);
 void pisp_fe_submit_job(struct pisp_fe_device *fe, struct vb2_buffer **vb2_bufs,
 			struct pisp_fe_config *cfg);
+bool pisp_fe_can_repeat_config(struct pisp_fe_device *fe);
 void pisp_fe_start(struct pisp_fe_device *fe);
 void pisp_fe_stop(struct pisp_fe_device *fe);
 int pisp_fe_init(struct pisp_fe_device *fe, struct dentry *debugfs);
@@ -7,6 +7,7 @@
 #include <linux/module.h>
 #include <linux/interrupt.h>
 #include <linux/gpio/consumer.h>
+#include <linux/hte.h>
 #include <linux/slab.h>
 #include <linux/of.h>
 #include <linux/of_gpio.h>
@@ -24,6 +25,9 @@ struct gpio_rc_dev {
 	int irq;
 	struct device *pmdev;
 	struct pm_qos_request qos;
+	struct hte_ts_desc hdesc;
+	bool use_hte;
+	u64 last_edge_ns;
 };
 
 static irqreturn_t gpio_ir_recv_irq(int irq, void *dev_id)
@@ -57,6 +61,69 @@ static irqreturn_t gpio_ir_recv_irq(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+/*
+ * Edges timestamped by a hardware timestamp engine: the duration of the
+ * period that just ended is taken from the latched edge times rather
+ * than from when this callback happened to run.
+ */
+static enum hte_return gpio_ir_recv_hte(struct hte_ts_data *ts, void *data)
+{
+	struct gpio_rc_dev *gpio_dev = data;
+	struct ir_raw_event ev = {};
+	int val;
+
+	if (ts->raw_level >= 0)
+		val = gpiod_is_active_low(gpio_dev->gpiod) ?
+			!ts->raw_level : ts->raw_level;
+	else
+		val = gpiod_get_value(gpio_dev->gpiod);
+	if (val < 0)
+		return HTE_CB_HANDLED;
+
+	if (gpio_dev->last_edge_ns && ts->tsc > gpio_dev->last_edge_ns)
+		ev.duration = min_t(u64, div_u64(ts->tsc - gpio_dev->last_edge_ns,
+						 NSEC_PER_USEC),
+				    IR_MAX_DURATION);
+	else
+		ev.duration = IR_MAX_DURATION;
+	gpio_dev->last_edge_ns = ts->tsc;
+
+	/* The level now is the opposite of the period that just ended */
+	ev.pulse = val != 1;
+	ir_raw_event_store_with_timeout(gpio_dev->rcdev, &ev);
+
+	return HTE_CB_HANDLED;
+}
+
+static int gpio_ir_recv_hte_setup(struct device *dev,
+				  struct gpio_rc_dev *gpio_dev)
+{
+	struct hte_clk_info ci;
+	int rc;
+
+	hte_init_line_attr(&gpio_dev->hdesc, desc_to_gpio(gpio_dev->gpiod),
+			   HTE_RISING_EDGE_TS | HTE_FALLING_EDGE_TS,
+			   NULL, gpio_dev->gpiod);
+
+	rc = hte_ts_get(dev, &gpio_dev->hdesc, 0);
+	if (rc)
+		return dev_err_probe(dev, rc,
+				     "failed to get hardware timestamp\n");
+
+	rc = hte_get_clk_src_info(&gpio_dev->hdesc, &ci);
+	if (!rc && ci.type != CLOCK_MONOTONIC) {
+		dev_err(dev, "unsupported timestamp clock %d\n", ci.type);
+		rc = -EINVAL;
+	}
+	if (!rc)
+		rc = hte_request_ts_ns(&gpio_dev->hdesc, gpio_ir_recv_hte,
+				       NULL, gpio_dev);
+	if (rc)
+		hte_ts_put(&gpio_dev->hdesc);
+
+	return rc;
+}
+
 static int gpio_ir_recv_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
@@ -77,9 +144,12 @@ static int gpio_ir_recv_probe(struct platform_device *pdev)
 	if (IS_ERR(gpio_dev->gpiod))
 		return dev_err_probe(dev, PTR_ERR(gpio_dev->gpiod),
 				     "error getting gpio\n");
-	gpio_dev->irq = gpiod_to_irq(gpio_dev->gpiod);
-	if (gpio_dev->irq < 0)
-		return gpio_dev->irq;
+	gpio_dev->use_hte = of_hte_req_count(dev) > 0;
+	if (!gpio_dev->use_hte) {
+		gpio_dev->irq = gpiod_to_irq(gpio_dev->gpiod);
+		if (gpio_dev->irq < 0)
+			return gpio_dev->irq;
+	}
 
 	rcdev = devm_rc_allocate_device(dev, RC_DRIVER_IR_RAW);
 	if (!rcdev)
@@ -112,6 +182,12 @@ static int gpio_ir_recv_probe(struct platform_device *pdev)
 		return rc;
 	}
 
+	platform_set_drvdata(pdev, gpio_dev);
+
+	/* Latency no longer matters once edges are timestamped in hardware */
+	if (gpio_dev->use_hte)
+		return gpio_ir_recv_hte_setup(dev, gpio_dev);
+
 	of_property_read_u32(np, "linux,autosuspend-period", &period);
 	if (period) {
 		gpio_dev->pmdev = dev;
@@ -121,8 +197,6 @@ static int gpio_ir_recv_probe(struct platform_device *pdev)
 		pm_runtime_enable(dev);
 	}
 
-	platform_set_drvdata(pdev, gpio_dev);
-
 	return devm_request_irq(dev, gpio_dev->irq, gpio_ir_recv_irq,
 				IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING,
 				"gpio-ir-recv-irq", gpio_dev);
@@ -133,6 +207,9 @@ static void gpio_ir_recv_remove(struct platform_device *pdev)
 	struct gpio_rc_dev *gpio_dev = platform_get_drvdata(pdev);
 	struct device *pmdev = gpio_dev->pmdev;
 
+	if (gpio_dev->use_hte)
+		hte_ts_put(&gpio_dev->hdesc);
+
 	if (pmdev) {
 		pm_runtime_get_sync(pmdev);
 		cpu_latency_qos_remove_request(&gpio_dev->qos);
@@ -148,6 +225,9 @@ static int gpio_ir_recv_suspend(struct device *dev)
 {
 	struct gpio_rc_dev *gpio_dev = dev_get_drvdata(dev);
 
+	if (gpio_dev->use_hte)
+		return hte_disable_ts(&gpio_dev->hdesc);
+
 	if (device_may_wakeup(dev))
 		enable_irq_wake(gpio_dev->irq);
 	else
@@ -160,6 +240,11 @@ static int gpio_ir_recv_resume(struct device *dev)
 {
 	struct gpio_rc_dev *gpio_dev = dev_get_drvdata(dev);
 
+	if (gpio_dev->use_hte) {
+		gpio_dev->last_edge_ns = 0;
+		return hte_enable_ts(&gpio_dev->hdesc);
+	}
+
 	if (device_may_wakeup(dev))
 		disable_irq_wake(gpio_dev->irq);
 	else
@@ -42,6 +42,10 @@ static unsigned int default_transtime = 40; /* Max 25 fps */
 module_param(default_transtime, uint, 0644);
 MODULE_PARM_DESC(default_transtime, "default transaction time in ms");
 
+static unsigned int max_jobs = 1;
+module_param(max_jobs, uint, 0444);
+MODULE_PARM_DESC(max_jobs, "number of jobs the device runs at once");
+
 #define MIN_W 32
 #define MIN_H 32
 #define MAX_W 640
@@ -212,6 +216,11 @@ struct vim2m_ctx {
 	struct mutex		vb_mutex;
 	struct delayed_work	work_run;
 
+	/* Buffers of the jobs in flight, with max_jobs > 1 */
+	spinlock_t		jobs_lock;
+	struct list_head	jobs_src;
+	struct list_head	jobs_dst;
+
 	/* Abort requested by m2m */
 	int			aborting;
 
@@ -565,9 +574,11 @@ static int device_process(struct vim2m_ctx *ctx,
 static int job_ready(void *priv)
 {
 	struct vim2m_ctx *ctx = priv;
+	/* With several jobs in flight, each job is a single buffer pair */
+	u32 needed = max_jobs > 1 ? 1 : ctx->translen;
 
-	if (v4l2_m2m_num_src_bufs_ready(ctx->fh.m2m_ctx) < ctx->translen
-	    || v4l2_m2m_num_dst_bufs_ready(ctx->fh.m2m_ctx) < ctx->translen) {
+	if (v4l2_m2m_num_src_bufs_ready(ctx->fh.m2m_ctx) < needed
+	    || v4l2_m2m_num_dst_bufs_ready(ctx->fh.m2m_ctx) < needed) {
 		dprintk(ctx->dev, 1, "Not enough buffers available\n");
 		return 0;
 	}
@@ -581,6 +592,42 @@ static void job_abort(void *priv)
 
 	/* Will cancel the transaction in the next interrupt handler */
 	ctx->aborting = 1;
+
+	/* Complete all the jobs in flight now rather than one per transtime */
+	if (max_jobs > 1)
+		mod_delayed_work(system_wq, &ctx->work_run, 0);
+}
+
+/*
+ * device_run_multi() - device_run() for max_jobs > 1
+ *
+ * The framework may call this again for the same instance before the
+ * previous job has completed, so the buffers of the job are taken off the
+ * ready queues here and kept on the jobs lists until device_work_multi()
+ * completes them.
+ */
+static void device_run_multi(struct vim2m_ctx *ctx)
+{
+	struct vb2_v4l2_buffer *src_buf, *dst_buf;
+	struct v4l2_m2m_buffer *src_m2m, *dst_m2m;
+	unsigned long flags;
+
+	src_buf = v4l2_m2m_src_buf_remove(ctx->fh.m2m_ctx);
+	dst_buf = v4l2_m2m_dst_buf_remove(ctx->fh.m2m_ctx);
+
+	v4l2_ctrl_request_setup(src_buf->vb2_buf.req_obj.req, &ctx->hdl);
+	device_process(ctx, src_buf, dst_buf);
+	v4l2_ctrl_request_complete(src_buf->vb2_buf.req_obj.req, &ctx->hdl);
+
+	src_m2m = container_of(src_buf, struct v4l2_m2m_buffer, vb);
+	dst_m2m = container_of(dst_buf, struct v4l2_m2m_buffer, vb);
+
+	spin_lock_irqsave(&ctx->jobs_lock, flags);
+	list_add_tail(&src_m2m->list, &ctx->jobs_src);
+	list_add_tail(&dst_m2m->list, &ctx->jobs_dst);
+	spin_unlock_irqrestore(&ctx->jobs_lock, flags);
+
+	schedule_delayed_work(&ctx->work_run, msecs_to_jiffies(ctx->transtime));
 }
 
 /* device_run() - prepares and starts the device
@@ -594,6 +641,11 @@ static void device_run(void *priv)
 	struct vim2m_ctx *ctx = priv;
 	struct vb2_v4l2_buffer *src_buf, *dst_buf;
 
+	if (max_jobs > 1) {
+		device_run_multi(ctx);
+		return;
+	}
+
 	src_buf = v4l2_m2m_next_src_buf(ctx->fh.m2m_ctx);
 	dst_buf = v4l2_m2m_next_dst_buf(ctx->fh.m2m_ctx);
 
@@ -611,6 +663,41 @@ static void device_run(void *priv)
 	schedule_delayed_work(&ctx->work_run, msecs_to_jiffies(ctx->transtime));
 }
 
+/*
+ * device_work_multi() - complete the oldest job in flight, or all of them
+ * when aborting
+ */
+static void device_work_multi(struct vim2m_ctx *ctx)
+{
+	struct v4l2_m2m_buffer *src_m2m, *dst_m2m;
+	unsigned long flags;
+	bool more;
+
+	do {
+		spin_lock_irqsave(&ctx->jobs_lock, flags);
+		src_m2m = list_first_entry_or_null(&ctx->jobs_src,
+						   struct v4l2_m2m_buffer, list);
+		dst_m2m = list_first_entry_or_null(&ctx->jobs_dst,
+						   struct v4l2_m2m_buffer, list);
+		if (!src_m2m || !dst_m2m) {
+			spin_unlock_irqrestore(&ctx->jobs_lock, flags);
+			return;
+		}
+		list_del(&src_m2m->list);
+		list_del(&dst_m2m->list);
+		more = !list_empty(&ctx->jobs_src);
+		spin_unlock_irqrestore(&ctx->jobs_lock, flags);
+
+		v4l2_m2m_buf_done(&src_m2m->vb, VB2_BUF_STATE_DONE);
+		v4l2_m2m_buf_done(&dst_m2m->vb, VB2_BUF_STATE_DONE);
+		v4l2_m2m_job_finish(ctx->dev->m2m_dev, ctx->fh.m2m_ctx);
+	} while (more && ctx->aborting);
+
+	if (more)
+		schedule_delayed_work(&ctx->work_run,
+				      msecs_to_jiffies(ctx->transtime));
+}
+
 static void device_work(struct work_struct *w)
 {
 	struct vim2m_ctx *curr_ctx;
@@ -619,6 +706,11 @@ static void device_work(struct work_struct *w)
 
 	curr_ctx = container_of(w, struct vim2m_ctx, work_run.work);
 
+	if (max_jobs > 1) {
+		device_work_multi(curr_ctx);
+		return;
+	}
+
 	vim2m_dev = curr_ctx->dev;
 
 	src_vb = v4l2_m2m_src_buf_remove(curr_ctx->fh.m2m_ctx);
@@ -1210,6 +1302,9 @@ static int vim2m_open(struct file *file)
 
 	mutex_init(&ctx->vb_mutex);
 	INIT_DELAYED_WORK(&ctx->work_run, device_work);
+	spin_lock_init(&ctx->jobs_lock);
+	INIT_LIST_HEAD(&ctx->jobs_src);
+	INIT_LIST_HEAD(&ctx->jobs_dst);
 
 	if (IS_ERR(ctx->fh.m2m_ctx)) {
 		rc = PTR_ERR(ctx->fh.m2m_ctx);
@@ -1329,6 +1424,8 @@ static int vim2m_probe(struct platform_device *pdev)
 		goto error_dev;
 	}
 
+	v4l2_m2m_set_max_jobs(dev->m2m_dev, max_jobs);
+
 #ifdef CONFIG_MEDIA_CONTROLLER
 	dev->mdev.dev = &pdev->dev;
 	strscpy(dev->mdev.model, "vim2m", sizeof(dev->mdev.model));
@@ -80,19 +80,11 @@ int cci_read(struct regmap *map, u32 reg, u64 *val, int *err)
 }
 EXPORT_SYMBOL_GPL(cci_read);
 
-int cci_write(struct regmap *map, u32 reg, u64 val, int *err)
+/* Store @val in @buf in the register's byte order, return its width */
+static int cci_encode(struct regmap *map, u32 reg, u64 val, u8 *buf)
 {
-	bool little_endian;
-	unsigned int len;
-	u8 buf[8];
-	int ret;
-
-	if (err && *err)
-		return *err;
-
-	little_endian = reg & CCI_REG_LE;
-	len = CCI_REG_WIDTH_BYTES(reg);
-	reg = CCI_REG_ADDR(reg);
+	bool little_endian = reg & CCI_REG_LE;
+	unsigned int len = CCI_REG_WIDTH_BYTES(reg);
 
 	switch (len) {
 	case 1:
@@ -124,15 +116,29 @@ int cci_write(struct regmap *map, u32 reg, u64 val, int *err)
 		break;
 	default:
 		dev_err(regmap_get_device(map), "Error invalid reg-width %u for reg 0x%04x\n",
-			len, reg);
-		ret = -EINVAL;
-		goto out;
+			len, CCI_REG_ADDR(reg));
+		return -EINVAL;
 	}
 
-	ret = regmap_bulk_write(map, reg, buf, len);
+	return len;
+}
+
+int cci_write(struct regmap *map, u32 reg, u64 val, int *err)
+{
+	u8 buf[8];
+	int ret;
+
+	if (err && *err)
+		return *err;
+
+	ret = cci_encode(map, reg, val, buf);
+	if (ret < 0)
+		goto out;
+
+	ret = regmap_bulk_write(map, CCI_REG_ADDR(reg), buf, ret);
 	if (ret)
 		dev_err(regmap_get_device(map), "Error writing reg 0x%4x: %d\n",
-			reg, ret);
+			CCI_REG_ADDR(reg), ret);
 
 out:
 	if (ret && err)
@@ -173,6 +179,104 @@ int cci_multi_reg_write(struct regmap *map, const struct cci_reg_sequence *regs,
 }
 EXPORT_SYMBOL_GPL(cci_multi_reg_write);
 
+/* Largest run of consecutive registers sent as a single transfer */
+#define CCI_MULTI_WRITE_MAX	32
+
+int cci_multi_reg_write_merged(struct regmap *map,
+			       const struct cci_reg_sequence *regs,
+			       unsigned int num_regs, int *err)
+{
+	u8 buf[CCI_MULTI_WRITE_MAX];
+	unsigned int i, start = 0;
+	u32 addr = 0;
+	int len = 0;
+	int ret = 0;
+
+	if (err && *err)
+		return *err;
+
+	/*
+	 * Registers that follow each other in the list and in the address
+	 * space, like the bytes of an exposure or gain setting, are merged
+	 * into one bulk write so they go out in a single bus transfer.
+	 */
+	for (i = 0; i < num_regs; i++) {
+		u32 reg_addr = CCI_REG_ADDR(regs[i].reg);
+		unsigned int width = CCI_REG_WIDTH_BYTES(regs[i].reg);
+
+		if (len && (reg_addr != addr + len ||
+			    len + width > sizeof(buf))) {
+			ret = regmap_bulk_write(map, addr, buf, len);
+			if (ret)
+				goto err;
+			len = 0;
+		}
+
+		if (!len) {
+			addr = reg_addr;
+			start = i;
+		}
+
+		ret = cci_encode(map, regs[i].reg, regs[i].val, buf + len);
+		if (ret < 0)
+			goto out;
+		len += ret;
+	}
+
+	ret = 0;
+	if (len) {
+		ret = regmap_bulk_write(map, addr, buf, len);
+		if (ret)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	dev_err(regmap_get_device(map), "Error writing reg 0x%4x: %d\n",
+		CCI_REG_ADDR(regs[start].reg), ret);
+out:
+	if (err)
+		*err = ret;
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(cci_multi_reg_write_merged);
+
+int cci_batch_write(struct regmap *map, struct cci_reg_batch *batch, u32 reg,
+		    u64 val, int *err)
+{
+	int ret;
+
+	if (err && *err)
+		return *err;
+
+	if (batch->num_regs == ARRAY_SIZE(batch->regs)) {
+		ret = cci_batch_flush(map, batch, err);
+		if (ret)
+			return ret;
+	}
+
+	batch->regs[batch->num_regs].reg = reg;
+	batch->regs[batch->num_regs].val = val;
+	batch->num_regs++;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cci_batch_write);
+
+int cci_batch_flush(struct regmap *map, struct cci_reg_batch *batch, int *err)
+{
+	unsigned int num_regs = batch->num_regs;
+
+	batch->num_regs = 0;
+	if (!num_regs)
+		return err ? *err : 0;
+
+	return cci_multi_reg_write_merged(map, batch->regs, num_regs, err);
+}
+EXPORT_SYMBOL_GPL(cci_batch_flush);
+
 #if IS_ENABLED(CONFIG_V4L2_CCI_I2C)
 struct regmap *devm_cci_regmap_init_i2c(struct i2c_client *client,
 					int reg_addr_bits)
@@ -209,12 +209,13 @@ static int user_to_new(struct v4l2_ext_control *c, struct v4l2_ctrl *ctrl)
 /*
  * Prepare for the extended g/s/try functions.
  * Find the controls in the control array and do some basic checks.
+ * Called with the handler lock held.
  */
-static int prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
-			     struct v4l2_ext_controls *cs,
-			     struct v4l2_ctrl_helper *helpers,
-			     struct video_device *vdev,
-			     bool get)
+static int __prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
+			       struct v4l2_ext_controls *cs,
+			       struct v4l2_ctrl_helper *helpers,
+			       struct video_device *vdev,
+			       bool get)
 {
 	struct v4l2_ctrl_helper *h;
 	bool have_clusters = false;
@@ -247,7 +248,7 @@ static int prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
 				"old-style private controls not allowed\n");
 			return -EINVAL;
 		}
-		ref = find_ref_lock(hdl, id);
+		ref = find_ref(hdl, id);
 		if (!ref) {
 			dprintk(vdev, "cannot find control id 0x%x\n", id);
 			return -EINVAL;
@@ -262,7 +263,7 @@ static int prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
 		if (ctrl->cluster[0]->ncontrols > 1)
 			have_clusters = true;
 		if (ctrl->cluster[0] != ctrl)
-			ref = find_ref_lock(hdl, ctrl->cluster[0]->id);
+			ref = find_ref(hdl, ctrl->cluster[0]->id);
 		if (ctrl->is_dyn_array) {
 			unsigned int max_size = ctrl->dims[0] * ctrl->elem_size;
 			unsigned int tot_size = ctrl->elem_size;
@@ -328,9 +329,6 @@ static int prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
 	 * belong to the same cluster.
 	 */
 
-	/* This has to be done with the handler lock taken. */
-	mutex_lock(hdl->lock);
-
 	/* First zero the helper field in the master control references */
 	for (i = 0; i < cs->count; i++)
 		helpers[i].mref->helper = NULL;
@@ -357,10 +355,25 @@ static int prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
 		/* Point the mref helper to the current helper struct. */
 		mref->helper = h;
 	}
-	mutex_unlock(hdl->lock);
 	return 0;
 }
 
+/* Look up all the controls with a single acquisition of the handler lock. */
+static int prepare_ext_ctrls(struct v4l2_ctrl_handler *hdl,
+			     struct v4l2_ext_controls *cs,
+			     struct v4l2_ctrl_helper *helpers,
+			     struct video_device *vdev,
+			     bool get)
+{
+	int ret;
+
+	mutex_lock(hdl->lock);
+	ret = __prepare_ext_ctrls(hdl, cs, helpers, vdev, get);
+	mutex_unlock(hdl->lock);
+
+	return ret;
+}
+
 /*
  * Handles the corner case where cs->count == 0. It checks whether the
  * specified control class exists. If that class ID is 0, then it checks
@@ -559,6 +572,7 @@ int try_set_ext_ctrls_common(struct v4l2_fh *fh,
 {
 	struct v4l2_ctrl_helper helper[4];
 	struct v4l2_ctrl_helper *helpers = helper;
+	bool single_lock;
 	unsigned int i, j;
 	int ret;
 
@@ -593,6 +607,21 @@ int try_set_ext_ctrls_common(struct v4l2_fh *fh,
 		ret = validate_ctrls(cs, helpers, vdev, set);
 	if (ret && set)
 		cs->error_idx = cs->count;
+
+	/*
+	 * Per-frame updates usually set a handful of controls that all live
+	 * in the same handler. Take its lock once for the whole batch rather
+	 * than once per cluster, unless some controls are inherited from
+	 * handlers with another lock.
+	 */
+	single_lock = !ret;
+	for (i = 0; single_lock && i < cs->count; i++)
+		if (helpers[i].mref &&
+		    helpers[i].mref->ctrl->handler->lock != hdl->lock)
+			single_lock = false;
+	if (single_lock)
+		mutex_lock(hdl->lock);
+
 	for (i = 0; !ret && i < cs->count; i++) {
 		struct v4l2_ctrl *master;
 		u32 idx = i;
@@ -602,7 +631,8 @@ int try_set_ext_ctrls_common(struct v4l2_fh *fh,
 
 		cs->error_idx = i;
 		master = helpers[i].mref->ctrl;
-		v4l2_ctrl_lock(master);
+		if (!single_lock)
+			v4l2_ctrl_lock(master);
 
 		/* Reset the 'is_new' flags of the cluster */
 		for (j = 0; j < master->ncontrols; j++)
@@ -679,9 +709,13 @@ int try_set_ext_ctrls_common(struct v4l2_fh *fh,
 				idx = helpers[idx].next;
 			} while (!ret && idx);
 		}
-		v4l2_ctrl_unlock(master);
+		if (!single_lock)
+			v4l2_ctrl_unlock(master);
 	}
 
+	if (single_lock)
+		mutex_unlock(hdl->lock);
+
 	if (cs->count > ARRAY_SIZE(helper))
 		kvfree(helpers);
 	return ret;
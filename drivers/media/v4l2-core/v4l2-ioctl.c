@@ -3033,6 +3033,25 @@ static long __video_do_ioctl(struct file *file,
 			return -ERESTARTSYS;
 	}
 
+	/*
+	 * Applications streaming several nodes typically poll() and then try a
+	 * non-blocking DQBUF on each of them, most of which have nothing yet.
+	 * Answer those without taking the queue lock. This is only done for a
+	 * vb2 queue owned by this file handle and of the type asked for, as
+	 * anything else needs the full checks below, and only when the driver
+	 * uses vb2_ioctl_dqbuf() so that a driver wrapping DQBUF still sees
+	 * every call.
+	 */
+	if (cmd == VIDIOC_DQBUF && (file->f_flags & O_NONBLOCK) &&
+	    !(vfh && vfh->m2m_ctx) && vfd->queue &&
+	    vfd->queue->owner == file->private_data &&
+	    ((struct v4l2_buffer *)arg)->type == vfd->queue->type &&
+	    test_bit(_IOC_NR(cmd), vfd->valid_ioctls) &&
+	    (const void *)vfd->ioctl_ops->vidioc_dqbuf ==
+		vfd->queue->stock_dqbuf &&
+	    video_is_registered(vfd) && vb2_dqbuf_would_block(vfd->queue))
+		return -EAGAIN;
+
 	lock = v4l2_ioctl_get_lock(vfd, vfh, cmd, arg);
 
 	if (lock && mutex_lock_interruptible(lock)) {
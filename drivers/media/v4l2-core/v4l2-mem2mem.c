@@ -41,6 +41,8 @@ module_param(debug, bool, 0644);
 #define TRANS_RUNNING		(1 << 1)
 /* Instance is currently aborting */
 #define TRANS_ABORT		(1 << 2)
+/* Instance is in device_run(), with several jobs in flight */
+#define TRANS_DISPATCH		(1 << 3)
 
 
 /* The job queue is not running new jobs */
@@ -89,6 +91,9 @@ static const char * const m2m_entity_name[] = {
  * @job_spinlock:	protects job_queue
  * @job_work:		worker to run queued jobs.
  * @job_queue_flags:	flags of the queue status, %QUEUE_PAUSED.
+ * @max_jobs:		number of jobs that may run at once
+ * @num_running:	number of jobs running when @max_jobs is more than 1
+ * @idle:		woken up when @num_running drops to 0
  * @m2m_ops:		driver callbacks
  */
 struct v4l2_m2m_dev {
@@ -107,6 +112,9 @@ struct v4l2_m2m_dev {
 	spinlock_t		job_spinlock;
 	struct work_struct	job_work;
 	unsigned long		job_queue_flags;
+	unsigned int		max_jobs;
+	unsigned int		num_running;
+	wait_queue_head_t	idle;
 
 	const struct v4l2_m2m_ops *m2m_ops;
 };
@@ -243,6 +251,52 @@ void *v4l2_m2m_get_curr_priv(struct v4l2_m2m_dev *m2m_dev)
 }
 EXPORT_SYMBOL(v4l2_m2m_get_curr_priv);
 
+static void __v4l2_m2m_try_queue(struct v4l2_m2m_dev *m2m_dev,
+				 struct v4l2_m2m_ctx *m2m_ctx);
+
+/*
+ * v4l2_m2m_try_run_multi() - dispatch queued jobs while the device has room
+ * @m2m_dev: per-device context
+ *
+ * Used instead of v4l2_m2m_try_run() when more than one job may run at once.
+ * A context leaves the job_queue as soon as its job is dispatched, and is
+ * queued again right away if it has buffers for another job. Until its
+ * device_run() returns, the buffers of the job are still on the ready
+ * queues, so TRANS_DISPATCH keeps the context from being queued again in
+ * the meantime and dispatched a second time for the same buffers.
+ */
+static void v4l2_m2m_try_run_multi(struct v4l2_m2m_dev *m2m_dev)
+{
+	struct v4l2_m2m_ctx *m2m_ctx;
+	unsigned long flags;
+
+	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
+	while (m2m_dev->num_running < m2m_dev->max_jobs &&
+	       !list_empty(&m2m_dev->job_queue) &&
+	       !(m2m_dev->job_queue_flags & QUEUE_PAUSED)) {
+		m2m_ctx = list_first_entry(&m2m_dev->job_queue,
+					   struct v4l2_m2m_ctx, queue);
+		list_del(&m2m_ctx->queue);
+		m2m_ctx->job_flags &= ~TRANS_QUEUED;
+		m2m_ctx->job_flags |= TRANS_RUNNING | TRANS_DISPATCH;
+		m2m_ctx->jobs_running++;
+		m2m_dev->num_running++;
+		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
+
+		dprintk("Running job on m2m_ctx: %p (%u in flight)\n",
+			m2m_ctx, m2m_dev->num_running);
+		m2m_dev->m2m_ops->device_run(m2m_ctx->priv);
+
+		spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
+		m2m_ctx->job_flags &= ~TRANS_DISPATCH;
+		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
+		__v4l2_m2m_try_queue(m2m_dev, m2m_ctx);
+
+		spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
+	}
+	spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
+}
+
 /**
  * v4l2_m2m_try_run() - select next job to perform and run it if possible
  * @m2m_dev: per-device context
@@ -256,6 +310,11 @@ static void v4l2_m2m_try_run(struct v4l2_m2m_dev *m2m_dev)
 {
 	unsigned long flags;
 
+	if (m2m_dev->max_jobs > 1) {
+		v4l2_m2m_try_run_multi(m2m_dev);
+		return;
+	}
+
 	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
 	if (NULL != m2m_dev->curr_ctx) {
 		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
@@ -321,6 +380,11 @@ static void __v4l2_m2m_try_queue(struct v4l2_m2m_dev *m2m_dev,
 		goto job_unlock;
 	}
 
+	if (m2m_ctx->job_flags & TRANS_DISPATCH) {
+		dprintk("Job being dispatched\n");
+		goto job_unlock;
+	}
+
 	src = v4l2_m2m_next_src_buf(m2m_ctx);
 	dst = v4l2_m2m_next_dst_buf(m2m_ctx);
 	if (!src && !m2m_ctx->out_q_ctx.buffered) {
@@ -423,6 +487,13 @@ static void v4l2_m2m_cancel_job(struct v4l2_m2m_ctx *m2m_ctx)
 	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
 
 	m2m_ctx->job_flags |= TRANS_ABORT;
+	/* With several jobs in flight, the context may be queued again too */
+	if (m2m_dev->max_jobs > 1 &&
+	    (m2m_ctx->job_flags & (TRANS_QUEUED | TRANS_RUNNING)) ==
+	    (TRANS_QUEUED | TRANS_RUNNING)) {
+		list_del(&m2m_ctx->queue);
+		m2m_ctx->job_flags &= ~TRANS_QUEUED;
+	}
 	if (m2m_ctx->job_flags & TRANS_RUNNING) {
 		spin_unlock_irqrestore(&m2m_dev->job_spinlock, flags);
 		if (m2m_dev->m2m_ops->job_abort)
@@ -470,6 +541,20 @@ static void v4l2_m2m_schedule_next_job(struct v4l2_m2m_dev *m2m_dev,
 static bool _v4l2_m2m_job_finish(struct v4l2_m2m_dev *m2m_dev,
 				 struct v4l2_m2m_ctx *m2m_ctx)
 {
+	if (m2m_dev->max_jobs > 1) {
+		if (WARN_ON(!m2m_ctx->jobs_running))
+			return false;
+
+		m2m_ctx->jobs_running--;
+		if (!m2m_ctx->jobs_running) {
+			m2m_ctx->job_flags &= ~TRANS_RUNNING;
+			wake_up(&m2m_ctx->finished);
+		}
+		if (!--m2m_dev->num_running)
+			wake_up(&m2m_dev->idle);
+		return true;
+	}
+
 	if (!m2m_dev->curr_ctx || m2m_dev->curr_ctx != m2m_ctx) {
 		dprintk("Called by an instance not currently running\n");
 		return false;
@@ -510,6 +595,10 @@ void v4l2_m2m_buf_done_and_job_finish(struct v4l2_m2m_dev *m2m_dev,
 	bool schedule_next = false;
 	unsigned long flags;
 
+	/* The buffers were already taken off the queues in device_run */
+	if (WARN_ON_ONCE(m2m_dev->max_jobs > 1))
+		return;
+
 	spin_lock_irqsave(&m2m_dev->job_spinlock, flags);
 	src_buf = v4l2_m2m_src_buf_remove(m2m_ctx);
 	dst_buf = v4l2_m2m_next_dst_buf(m2m_ctx);
@@ -553,6 +642,9 @@ void v4l2_m2m_suspend(struct v4l2_m2m_dev *m2m_dev)
 	if (curr_ctx)
 		wait_event(curr_ctx->finished,
 			   !(curr_ctx->job_flags & TRANS_RUNNING));
+
+	if (m2m_dev->max_jobs > 1)
+		wait_event(m2m_dev->idle, !READ_ONCE(m2m_dev->num_running));
 }
 EXPORT_SYMBOL(v4l2_m2m_suspend);
 
@@ -1197,14 +1289,23 @@ struct v4l2_m2m_dev *v4l2_m2m_init(const struct v4l2_m2m_ops *m2m_ops)
 
 	m2m_dev->curr_ctx = NULL;
 	m2m_dev->m2m_ops = m2m_ops;
+	m2m_dev->max_jobs = 1;
 	INIT_LIST_HEAD(&m2m_dev->job_queue);
 	spin_lock_init(&m2m_dev->job_spinlock);
+	init_waitqueue_head(&m2m_dev->idle);
 	INIT_WORK(&m2m_dev->job_work, v4l2_m2m_device_run_work);
 
 	return m2m_dev;
 }
 EXPORT_SYMBOL_GPL(v4l2_m2m_init);
 
+void v4l2_m2m_set_max_jobs(struct v4l2_m2m_dev *m2m_dev,
+			   unsigned int max_jobs)
+{
+	m2m_dev->max_jobs = max(max_jobs, 1U);
+}
+EXPORT_SYMBOL_GPL(v4l2_m2m_set_max_jobs);
+
 void v4l2_m2m_release(struct v4l2_m2m_dev *m2m_dev)
 {
 	kfree(m2m_dev);
@@ -10,6 +10,7 @@
 #include <linux/completion.h>
 #include <linux/etherdevice.h>
 #include <linux/err.h>
+#include <linux/genalloc.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/irq.h>
@@ -64,6 +65,19 @@
 #define INTSTATL		0x108
 #define INTSTATH		0x10c
 
+/* RP1's own bus masters see the peripheral window here */
+#define RP1_PERIPH_DMA_BASE	0x40000000
+
+#define RP1_SRAM_MIN_ORDER	5	/* allocations are cache line aligned */
+
+/*
+ * The RP1 firmware has a use for some of the SRAM, so nothing is handed
+ * out unless a size is given here; the pool then covers the top of it.
+ */
+static unsigned int sram_pool_size;
+module_param(sram_pool_size, uint, 0444);
+MODULE_PARM_DESC(sram_pool_size, "Bytes of RP1 SRAM to make available to drivers");
+
 struct rp1_dev {
 	struct pci_dev *pdev;
 	struct device *dev;
@@ -73,6 +87,7 @@ struct rp1_dev {
 	struct irq_domain *domain;
 	struct irq_data *pcie_irqds[64];
 	void __iomem *msix_cfg_regs;
+	struct gen_pool *sram_pool;
 };
 
 static bool rp1_level_triggered_irq[RP1_ACTUAL_IRQS] = { 0 };
@@ -141,13 +156,47 @@ static int rp1_irq_set_type(struct irq_data *irqd, unsigned int type)
 	return ret;
 }
 
+/*
+ * Each RP1 interrupt has an MSI-X vector of its own, so steering the
+ * vector steers the peripheral interrupt without affecting the others.
+ */
+static int rp1_irq_set_affinity(struct irq_data *irqd,
+				const struct cpumask *dest, bool force)
+{
+	struct rp1_dev *rp1 = irqd->domain->host_data;
+	struct irq_data *pcie_irqd;
+	int pcie_irq, ret;
+
+	pcie_irq = pci_irq_vector(rp1->pdev, irqd->hwirq);
+	if (pcie_irq < 0)
+		return pcie_irq;
+
+	ret = irq_set_affinity(pcie_irq, dest);
+	if (ret)
+		return ret;
+
+	pcie_irqd = irq_get_irq_data(pcie_irq);
+	irq_data_update_effective_affinity(irqd,
+			irq_data_get_effective_affinity_mask(pcie_irqd));
+
+	return IRQ_SET_MASK_OK;
+}
+
 static struct irq_chip rp1_irq_chip = {
 	.name            = "rp1_irq_chip",
 	.irq_mask        = rp1_mask_irq,
 	.irq_unmask      = rp1_unmask_irq,
 	.irq_set_type    = rp1_irq_set_type,
+	.irq_set_affinity = rp1_irq_set_affinity,
 };
 
+/*
+ * Setting the affinity takes the descriptor lock of the MSI-X vector while
+ * holding that of the RP1 interrupt, so keep them in separate classes.
+ */
+static struct lock_class_key rp1_irq_lock_class;
+static struct lock_class_key rp1_irq_request_class;
+
 static void rp1_chained_handle_irq(struct irq_desc *desc)
 {
 	struct irq_chip *chip = irq_desc_get_chip(desc);
@@ -239,6 +288,94 @@ void rp1_get_platform(u32 *chip_id, u32 *platform)
 }
 EXPORT_SYMBOL_GPL(rp1_get_platform);
 
+/**
+ * rp1_sram_alloc() - allocate a buffer in the RP1 on-chip SRAM
+ * @size: number of bytes
+ * @dma_addr: returns the address of the buffer as seen by RP1 bus masters
+ *
+ * Memory local to RP1 saves a PCIe round trip per access for RP1's DMA
+ * controller and peripherals, which suits descriptor rings and small,
+ * latency sensitive buffers. The pool is small and may be disabled, so
+ * callers must be prepared to fall back to host memory.
+ *
+ * The CPU mapping is write-combined I/O memory, so fill the buffer with
+ * the I/O accessors and order the writes with wmb() before starting DMA.
+ *
+ * Return: the CPU mapping of the buffer, or NULL.
+ */
+void __iomem *rp1_sram_alloc(size_t size, dma_addr_t *dma_addr)
+{
+	if (!g_rp1 || !g_rp1->sram_pool)
+		return NULL;
+
+	return (__force void __iomem *)gen_pool_dma_alloc(g_rp1->sram_pool,
+							  size, dma_addr);
+}
+EXPORT_SYMBOL_GPL(rp1_sram_alloc);
+
+void rp1_sram_free(void __iomem *vaddr, size_t size)
+{
+	/* The pool is left behind, not freed into, once RP1 has gone */
+	if (!vaddr || !g_rp1 || !g_rp1->sram_pool)
+		return;
+
+	gen_pool_free(g_rp1->sram_pool, (__force unsigned long)vaddr, size);
+}
+EXPORT_SYMBOL_GPL(rp1_sram_free);
+
+static void rp1_sram_release(void *data)
+{
+	struct rp1_dev *rp1 = data;
+	struct gen_pool *pool = rp1->sram_pool;
+
+	rp1->sram_pool = NULL;
+
+	/* gen_pool_destroy() BUG()s on outstanding allocations */
+	if (gen_pool_avail(pool) != gen_pool_size(pool)) {
+		dev_warn(rp1->dev, "SRAM still in use, leaking the pool\n");
+		return;
+	}
+
+	gen_pool_destroy(pool);
+}
+
+static int rp1_sram_init(struct rp1_dev *rp1)
+{
+	unsigned int size, offset;
+	void __iomem *virt;
+	int ret;
+
+	size = min_t(unsigned int, sram_pool_size, RP1_RAM_SIZE);
+	size = round_down(size, PAGE_SIZE);
+	if (!size)
+		return 0;
+
+	offset = RP1_RAM_BASE + RP1_RAM_SIZE - size;
+
+	virt = devm_ioremap_wc(rp1->dev, rp1_io_to_phys(rp1, offset), size);
+	if (!virt)
+		return -ENOMEM;
+
+	rp1->sram_pool = gen_pool_create(RP1_SRAM_MIN_ORDER, NUMA_NO_NODE);
+	if (!rp1->sram_pool)
+		return -ENOMEM;
+
+	ret = devm_add_action_or_reset(rp1->dev, rp1_sram_release, rp1);
+	if (ret)
+		return ret;
+
+	/* Record the RP1 bus address so allocations come back ready to use */
+	ret = gen_pool_add_virt(rp1->sram_pool, (unsigned long)virt,
+				RP1_PERIPH_DMA_BASE + offset, size,
+				NUMA_NO_NODE);
+	if (ret)
+		return ret;
+
+	dev_info(rp1->dev, "%u bytes of SRAM available\n", size);
+
+	return 0;
+}
+
 static int rp1_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 {
 	struct reset_control *reset;
@@ -311,6 +448,12 @@ static int rp1_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 	rp1->domain = irq_domain_add_linear(rp1_node, RP1_IRQS,
 					    &rp1_domain_ops, rp1);
 
+	err = rp1_sram_init(rp1);
+	if (err) {
+		dev_err(&pdev->dev, "failed to set up SRAM pool - %d\n", err);
+		return err;
+	}
+
 	g_rp1 = rp1;
 
 	/* TODO can this go in the rp1 device tree entry? */
@@ -325,6 +468,8 @@ static int rp1_probe(struct pci_dev *pdev, const struct pci_device_id *id)
 		}
 
 		irq_set_chip_data(irq, rp1);
+		irq_set_lockdep_class(irq, &rp1_irq_lock_class,
+				      &rp1_irq_request_class);
 		irq_set_chip_and_handler(irq, &rp1_irq_chip, handle_level_irq);
 		irq_set_probe(irq);
 		irq_set_chained_handler(pci_irq_vector(pdev, i),
@@ -345,6 +490,8 @@ static void rp1_remove(struct pci_dev *pdev)
 
 	mfd_remove_devices(&pdev->dev);
 
+	g_rp1 = NULL;
+
 	clk_unregister(rp1->sys_clk);
 }
 
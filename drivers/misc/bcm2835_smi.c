@@ -44,11 +44,13 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/pagemap.h>
+#include <linux/scatterlist.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
 #include <linux/semaphore.h>
 #include <linux/spinlock.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 
 #define BCM2835_SMI_IMPLEMENTATION
 #include <linux/broadcom/bcm2835_smi.h>
@@ -75,8 +77,13 @@ struct bcm2835_smi_instance {
 
 	struct clk *clk;
 
+	/* Continuous capture into a cyclic ring, NULL when not streaming */
+	struct bcm2835_smi_stream *stream;
+
 	/* Sometimes we are called into in an atomic context (e.g. by
-	   JFFS2 + MTD) so we can't use a mutex */
+	   JFFS2 + MTD) so we can't use a mutex. Also taken by the stream's
+	   DMA callback, which the DMA driver runs from its tasklet, never
+	   from hardirq, so _bh locking is enough everywhere else. */
 	spinlock_t transaction_lock;
 };
 
@@ -156,7 +163,7 @@ void bcm2835_smi_set_regs_from_settings(struct bcm2835_smi_instance *inst)
 	int smidsr_temp = 0, smidsw_temp = 0, smics_temp,
 	    smidcs_temp, smidc_temp = 0;
 
-	spin_lock(&inst->transaction_lock);
+	spin_lock_bh(&inst->transaction_lock);
 
 	/* temporarily disable the peripheral: */
 	smics_temp = read_smi_reg(inst, SMICS);
@@ -213,7 +220,7 @@ void bcm2835_smi_set_regs_from_settings(struct bcm2835_smi_instance *inst)
 	write_smi_reg(inst, smics_temp, SMICS);
 	write_smi_reg(inst, smidcs_temp, SMIDCS);
 
-	spin_unlock(&inst->transaction_lock);
+	spin_unlock_bh(&inst->transaction_lock);
 }
 EXPORT_SYMBOL(bcm2835_smi_set_regs_from_settings);
 
@@ -223,7 +230,7 @@ struct smi_settings *bcm2835_smi_get_settings_from_regs
 	struct smi_settings *settings = &inst->settings;
 	int smidsr, smidsw, smidc;
 
-	spin_lock(&inst->transaction_lock);
+	spin_lock_bh(&inst->transaction_lock);
 
 	smidsr = read_smi_reg(inst, SMIDSR0);
 	smidsw = read_smi_reg(inst, SMIDSW0);
@@ -250,7 +257,7 @@ struct smi_settings *bcm2835_smi_get_settings_from_regs
 	settings->dma_passthrough_enable = (smidc & SMIDC_DMAP) ? true : false;
 	settings->dma_enable = (smidc & SMIDC_DMAEN) ? true : false;
 
-	spin_unlock(&inst->transaction_lock);
+	spin_unlock_bh(&inst->transaction_lock);
 
 	return settings;
 }
@@ -525,12 +532,13 @@ static void smi_dma_callback_user_copy(void *param)
    sg_len is the number of control blocks, NOT the number of bytes.
    dir can be DMA_MEM_TO_DEV or DMA_DEV_TO_MEM.
    callback can be NULL - in this case it is not called. */
-static inline struct dma_async_tx_descriptor *smi_dma_submit_sgl(
+static inline struct dma_async_tx_descriptor *smi_dma_submit_sgl_param(
 	struct bcm2835_smi_instance *inst,
 	struct scatterlist *sgl,
 	size_t sg_len,
 	enum dma_transfer_direction dir,
-	dma_async_tx_callback callback)
+	dma_async_tx_callback callback,
+	void *callback_param)
 {
 	struct dma_async_tx_descriptor *desc;
 
@@ -551,12 +559,23 @@ static inline struct dma_async_tx_descriptor *smi_dma_submit_sgl(
 		return NULL;
 	}
 	desc->callback = callback;
-	desc->callback_param = inst;
+	desc->callback_param = callback_param;
 	if (dmaengine_submit(desc) < 0)
 		return NULL;
 	return desc;
 }
 
+static inline struct dma_async_tx_descriptor *smi_dma_submit_sgl(
+	struct bcm2835_smi_instance *inst,
+	struct scatterlist *sgl,
+	size_t sg_len,
+	enum dma_transfer_direction dir,
+	dma_async_tx_callback callback)
+{
+	return smi_dma_submit_sgl_param(inst, sgl, sg_len, dir, callback,
+					inst);
+}
+
 /* NB this function blocks until the transfer is complete */
 static void
 smi_dma_read_sgl(struct bcm2835_smi_instance *inst,
@@ -617,7 +636,7 @@ ssize_t bcm2835_smi_user_dma(
 	struct scatterlist *sgl;
 	void (*init_trans_func)(struct bcm2835_smi_instance *, int);
 
-	spin_lock(&inst->transaction_lock);
+	spin_lock_bh(&inst->transaction_lock);
 
 	if (dma_dir == DMA_DEV_TO_MEM)
 		init_trans_func = smi_init_programmed_read;
@@ -661,11 +680,297 @@ ssize_t bcm2835_smi_user_dma(
 	else if (inst->settings.data_width == SMI_WIDTH_16BIT)
 		init_trans_func(inst, count / 2);
 out:
-	spin_unlock(&inst->transaction_lock);
+	spin_unlock_bh(&inst->transaction_lock);
 	return count;
 }
 EXPORT_SYMBOL(bcm2835_smi_user_dma);
 
+/* Pin a user buffer and map it for DMA, so that SMI transfers can go
+   straight to/from user memory without touching the bounce buffers.
+   The buffer must be 32 bit aligned and a multiple of 4 bytes long, as
+   the DMA moves whole FIFO words. */
+int bcm2835_smi_pin_user_buf(
+	struct bcm2835_smi_instance *inst,
+	enum dma_transfer_direction dma_dir,
+	char __user *user_ptr, size_t count,
+	struct bcm2835_smi_pinned_buf *buf)
+{
+	unsigned long start = (unsigned long)user_ptr;
+	unsigned int offset = offset_in_page(start);
+	int pinned, ret;
+
+	if (!count || ((start | count) & 0x3))
+		return -EINVAL;
+
+	buf->n_pages = N_PAGES_FROM_BYTES(offset + count);
+	buf->pages = kvmalloc_array(buf->n_pages, sizeof(*buf->pages),
+				    GFP_KERNEL);
+	if (!buf->pages)
+		return -ENOMEM;
+
+	pinned = pin_user_pages_fast(start & PAGE_MASK, buf->n_pages,
+				     dma_dir == DMA_DEV_TO_MEM ? FOLL_WRITE : 0,
+				     buf->pages);
+	if (pinned < 0) {
+		ret = pinned;
+		goto err_free_pages;
+	}
+	if (pinned != buf->n_pages) {
+		unpin_user_pages(buf->pages, pinned);
+		ret = -EFAULT;
+		goto err_free_pages;
+	}
+
+	ret = sg_alloc_table_from_pages(&buf->sgt, buf->pages, buf->n_pages,
+					offset, count, GFP_KERNEL);
+	if (ret)
+		goto err_unpin;
+
+	ret = dma_map_sgtable(inst->dev, &buf->sgt,
+			      dma_dir == DMA_DEV_TO_MEM ?
+			      DMA_FROM_DEVICE : DMA_TO_DEVICE, 0);
+	if (ret)
+		goto err_free_table;
+
+	buf->dir = dma_dir;
+	buf->len = count;
+	return 0;
+
+err_free_table:
+	sg_free_table(&buf->sgt);
+err_unpin:
+	unpin_user_pages(buf->pages, buf->n_pages);
+err_free_pages:
+	kvfree(buf->pages);
+	buf->pages = NULL;
+	return ret;
+}
+EXPORT_SYMBOL(bcm2835_smi_pin_user_buf);
+
+void bcm2835_smi_unpin_user_buf(
+	struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_pinned_buf *buf)
+{
+	if (!buf->pages)
+		return;
+
+	dma_unmap_sgtable(inst->dev, &buf->sgt,
+			  buf->dir == DMA_DEV_TO_MEM ?
+			  DMA_FROM_DEVICE : DMA_TO_DEVICE, 0);
+	sg_free_table(&buf->sgt);
+	unpin_user_pages_dirty_lock(buf->pages, buf->n_pages,
+				    buf->dir == DMA_DEV_TO_MEM);
+	kvfree(buf->pages);
+	buf->pages = NULL;
+}
+EXPORT_SYMBOL(bcm2835_smi_unpin_user_buf);
+
+/* Queue one descriptor per pinned buffer and start a single programmed
+   transfer covering all of them. Does not block: callback is called with
+   the buffer as its parameter as each one completes, so the caller can
+   hand the first buffer back to user space while the next is still
+   being filled. */
+int bcm2835_smi_user_dma_pinned(
+	struct bcm2835_smi_instance *inst,
+	enum dma_transfer_direction dma_dir,
+	struct bcm2835_smi_pinned_buf **bufs, unsigned int n_bufs,
+	dma_async_tx_callback callback)
+{
+	size_t count = 0;
+	unsigned int i;
+	int ret = 0;
+	void (*init_trans_func)(struct bcm2835_smi_instance *, int);
+
+	spin_lock_bh(&inst->transaction_lock);
+
+	if (dma_dir == DMA_DEV_TO_MEM)
+		init_trans_func = smi_init_programmed_read;
+	else
+		init_trans_func = smi_init_programmed_write;
+
+	smi_disable(inst, dma_dir);
+
+	for (i = 0; i < n_bufs; i++) {
+		if (!smi_dma_submit_sgl_param(inst, bufs[i]->sgt.sgl,
+					      bufs[i]->sgt.nents, dma_dir,
+					      callback, bufs[i])) {
+			dev_err(inst->dev, "sgl submit failed");
+			dmaengine_terminate_async(inst->dma_chan);
+			ret = -EIO;
+			goto out;
+		}
+		count += bufs[i]->len;
+	}
+	dma_async_issue_pending(inst->dma_chan);
+
+	if (inst->settings.data_width == SMI_WIDTH_8BIT)
+		init_trans_func(inst, count);
+	else if (inst->settings.data_width == SMI_WIDTH_16BIT)
+		init_trans_func(inst, count / 2);
+out:
+	spin_unlock_bh(&inst->transaction_lock);
+	return ret;
+}
+EXPORT_SYMBOL(bcm2835_smi_user_dma_pinned);
+
+/* Wait for the programmed transfer behind a pinned DMA to finish on the
+   bus. The DMA completes when the last word has left memory (write) or
+   the FIFO (read), which can be before SMI itself is done. */
+int bcm2835_smi_user_dma_wait_done(struct bcm2835_smi_instance *inst)
+{
+	u32 smics;
+
+	return readl_poll_timeout(inst->smi_regs_ptr + SMICS, smics,
+				  smics & SMICS_DONE, 10, 100000);
+}
+EXPORT_SYMBOL(bcm2835_smi_user_dma_wait_done);
+
+/* Stop any outstanding pinned transfer, e.g. on timeout or when the
+   owner goes away. No callbacks are called after this returns. */
+void bcm2835_smi_user_dma_abort(struct bcm2835_smi_instance *inst)
+{
+	dmaengine_terminate_sync(inst->dma_chan);
+}
+EXPORT_SYMBOL(bcm2835_smi_user_dma_abort);
+
+/****************************************************************************
+*
+*   Continuous streaming into a cyclic DMA ring
+*
+***************************************************************************/
+
+/* A programmed read is limited to SMIL transfers, so a stream is really a
+   back-to-back run of maximum length reads, re-armed as each one ends. */
+#define SMI_STREAM_TRANSFERS INT_MAX
+
+int bcm2835_smi_stream_alloc(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream)
+{
+	if (!stream->ring_size || !stream->chunk_size ||
+	    !PAGE_ALIGNED(stream->ring_size) ||
+	    stream->ring_size % stream->chunk_size ||
+	    stream->chunk_size & 0x3)
+		return -EINVAL;
+
+	stream->ring = dma_alloc_coherent(inst->dev, stream->ring_size,
+					  &stream->ring_phys, GFP_KERNEL);
+	if (!stream->ring)
+		return -ENOMEM;
+	return 0;
+}
+EXPORT_SYMBOL(bcm2835_smi_stream_alloc);
+
+void bcm2835_smi_stream_free(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream)
+{
+	if (!stream->ring)
+		return;
+
+	dma_free_coherent(inst->dev, stream->ring_size, stream->ring,
+			  stream->ring_phys);
+	stream->ring = NULL;
+}
+EXPORT_SYMBOL(bcm2835_smi_stream_free);
+
+/* vma->vm_pgoff is ignored: the whole ring is always mapped */
+int bcm2835_smi_stream_mmap(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream, struct vm_area_struct *vma)
+{
+	if (!stream->ring)
+		return -EINVAL;
+	if (vma->vm_end - vma->vm_start != stream->ring_size)
+		return -EINVAL;
+
+	vma->vm_pgoff = 0;
+	return dma_mmap_coherent(inst->dev, vma, stream->ring,
+				 stream->ring_phys, stream->ring_size);
+}
+EXPORT_SYMBOL(bcm2835_smi_stream_mmap);
+
+static void smi_stream_chunk_done(void *param)
+{
+	struct bcm2835_smi_instance *inst = param;
+	struct bcm2835_smi_stream *stream;
+
+	/* Stop clears inst->stream under the lock before disabling SMI */
+	spin_lock(&inst->transaction_lock);
+	stream = inst->stream;
+	/* Keep the external bus busy if the last programmed read ran out */
+	if (stream && !(read_smi_reg(inst, SMICS) & SMICS_ACTIVE))
+		smi_init_programmed_read(inst, SMI_STREAM_TRANSFERS);
+	spin_unlock(&inst->transaction_lock);
+
+	if (stream)
+		stream->chunk_done(stream);
+}
+
+int bcm2835_smi_stream_start(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream)
+{
+	struct dma_async_tx_descriptor *desc;
+	int ret = 0;
+
+	spin_lock_bh(&inst->transaction_lock);
+
+	if (inst->stream) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	smi_disable(inst, DMA_DEV_TO_MEM);
+
+	desc = dmaengine_prep_dma_cyclic(inst->dma_chan, stream->ring_phys,
+					 stream->ring_size, stream->chunk_size,
+					 DMA_DEV_TO_MEM, DMA_PREP_INTERRUPT);
+	if (!desc) {
+		dev_err(inst->dev, "stream: cyclic dma preparation failed!");
+		ret = -ENOMEM;
+		goto out;
+	}
+	desc->callback = smi_stream_chunk_done;
+	desc->callback_param = inst;
+	if (dma_submit_error(dmaengine_submit(desc))) {
+		ret = -EIO;
+		goto out;
+	}
+
+	WRITE_ONCE(inst->stream, stream);
+	dma_async_issue_pending(inst->dma_chan);
+	smi_init_programmed_read(inst, SMI_STREAM_TRANSFERS);
+out:
+	spin_unlock_bh(&inst->transaction_lock);
+	return ret;
+}
+EXPORT_SYMBOL(bcm2835_smi_stream_start);
+
+/* Stop @stream if it is the one running; anyone else's is left alone */
+void bcm2835_smi_stream_stop(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream)
+{
+	spin_lock_bh(&inst->transaction_lock);
+	if (inst->stream != stream) {
+		spin_unlock_bh(&inst->transaction_lock);
+		return;
+	}
+	/* Stop the bus first so no more data lands in the FIFO */
+	write_smi_reg(inst, read_smi_reg(inst, SMICS) & ~SMICS_ENABLE, SMICS);
+	WRITE_ONCE(inst->stream, NULL);
+	spin_unlock_bh(&inst->transaction_lock);
+
+	dmaengine_terminate_sync(inst->dma_chan);
+
+	spin_lock_bh(&inst->transaction_lock);
+	write_smi_reg(inst, read_smi_reg(inst, SMICS) | SMICS_CLEAR, SMICS);
+	spin_unlock_bh(&inst->transaction_lock);
+}
+EXPORT_SYMBOL(bcm2835_smi_stream_stop);
+
+bool bcm2835_smi_stream_active(struct bcm2835_smi_instance *inst)
+{
+	return READ_ONCE(inst->stream);
+}
+EXPORT_SYMBOL(bcm2835_smi_stream_active);
+
 
 /****************************************************************************
 *
@@ -682,7 +987,7 @@ void bcm2835_smi_write_buf(
 
 	n_bytes -= odd_bytes;
 
-	spin_lock(&inst->transaction_lock);
+	spin_lock_bh(&inst->transaction_lock);
 
 	if (n_bytes > DMA_THRESHOLD_BYTES) {
 		dma_addr_t phy_addr = dma_map_single(
@@ -730,7 +1035,7 @@ void bcm2835_smi_write_buf(
 		}
 	}
 out:
-	spin_unlock(&inst->transaction_lock);
+	spin_unlock_bh(&inst->transaction_lock);
 }
 EXPORT_SYMBOL(bcm2835_smi_write_buf);
 
@@ -743,7 +1048,7 @@ void bcm2835_smi_read_buf(struct bcm2835_smi_instance *inst,
 	   by handling remainder separately. */
 	int odd_bytes = n_bytes & 0x3;
 
-	spin_lock(&inst->transaction_lock);
+	spin_lock_bh(&inst->transaction_lock);
 	n_bytes -= odd_bytes;
 	if (n_bytes > DMA_THRESHOLD_BYTES) {
 		dma_addr_t phy_addr = dma_map_single(inst->dev,
@@ -782,16 +1087,16 @@ void bcm2835_smi_read_buf(struct bcm2835_smi_instance *inst,
 		}
 	}
 out:
-	spin_unlock(&inst->transaction_lock);
+	spin_unlock_bh(&inst->transaction_lock);
 }
 EXPORT_SYMBOL(bcm2835_smi_read_buf);
 
 void bcm2835_smi_set_address(struct bcm2835_smi_instance *inst,
 	unsigned int address)
 {
-	spin_lock(&inst->transaction_lock);
+	spin_lock_bh(&inst->transaction_lock);
 	smi_set_address(inst, address);
-	spin_unlock(&inst->transaction_lock);
+	spin_unlock_bh(&inst->transaction_lock);
 }
 EXPORT_SYMBOL(bcm2835_smi_set_address);
 
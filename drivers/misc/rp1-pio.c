@@ -0,0 +1,864 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Raspberry Pi RP1 PIO driver
+ *
+ * Copyright (c) 2024 Raspberry Pi Ltd.
+ *
+ * The PIO block holds four programmable I/O state machines sharing a
+ * 32 word instruction memory. Clients, either in the kernel or through the
+ * misc device, load programs, claim state machines and move data through
+ * the state machine FIFOs using the RP1 DMA controller, so the CPU does not
+ * have to poll the FIFOs. The GPIOs used by a program must be switched to
+ * the PIO function through the usual pinctrl mechanisms.
+ */
+
+#include <linux/clk.h>
+#include <linux/completion.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/io.h>
+#include <linux/kref.h>
+#include <linux/miscdevice.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/of_address.h>
+#include <linux/pio_rp1.h>
+#include <linux/platform_device.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define DRIVER_NAME		"rp1-pio"
+
+#define PIO_CTRL		0x000
+#define PIO_CTRL_SM_ENABLE(sm)		BIT(sm)
+#define PIO_CTRL_SM_RESTART(sm)		BIT(4 + (sm))
+#define PIO_CTRL_CLKDIV_RESTART(sm)	BIT(8 + (sm))
+#define PIO_FSTAT		0x004
+#define PIO_FDEBUG		0x008
+#define PIO_FLEVEL		0x00c
+#define PIO_TXF(sm)		(0x010 + 4 * (sm))
+#define PIO_RXF(sm)		(0x020 + 4 * (sm))
+#define PIO_INSTR_MEM(i)	(0x048 + 4 * (i))
+#define PIO_SM_CLKDIV(sm)	(0x0c8 + 0x18 * (sm))
+#define PIO_SM_EXECCTRL(sm)	(0x0cc + 0x18 * (sm))
+#define PIO_SM_SHIFTCTRL(sm)	(0x0d0 + 0x18 * (sm))
+#define PIO_SM_ADDR(sm)		(0x0d4 + 0x18 * (sm))
+#define PIO_SM_INSTR(sm)	(0x0d8 + 0x18 * (sm))
+#define PIO_SM_PINCTRL(sm)	(0x0dc + 0x18 * (sm))
+
+#define PIO_SHIFTCTRL_FJOIN_RX	BIT(31)
+
+/* JMP is the only instruction encoding an absolute address */
+#define PIO_INSTR_OP_MASK	0xe000
+#define PIO_INSTR_OP_JMP	0x0000
+#define PIO_INSTR_JMP_ADDR_MASK	0x001f
+
+#define RP1_PIO_DMA_BUF_SIZE	SZ_64K
+#define RP1_PIO_DMA_TIMEOUT_MS	10000
+
+struct rp1_pio_sm_dma {
+	struct dma_chan *chan;
+	void *buf;
+	dma_addr_t buf_dma;
+	struct completion done;
+	/* 0, or why the transfer was aborted before the DMA completed */
+	int result;
+	/* serialise transfers in one direction */
+	struct mutex lock;
+};
+
+struct rp1_pio_sm {
+	struct rp1_pio_client *owner;
+	struct rp1_pio_sm_dma dma[2];
+};
+
+struct rp1_pio_device {
+	/* held by the platform device and by every client */
+	struct kref ref;
+	struct device *dev;
+	void __iomem *base;
+	dma_addr_t dma_base;
+	struct clk *clk;
+	struct miscdevice misc;
+
+	/* protect the allocation state and the shared registers */
+	struct mutex lock;
+	/* set at remove; the registers and DMA channels are gone */
+	bool dead;
+	u32 used_instrs;
+	struct rp1_pio_sm sms[RP1_PIO_SM_COUNT];
+};
+
+struct rp1_pio_client {
+	struct rp1_pio_device *pio;
+	u32 used_instrs;
+	u32 claimed_sms;
+};
+
+static struct rp1_pio_device *g_pio;
+static DEFINE_MUTEX(g_pio_lock);
+
+static inline u32 pio_read(struct rp1_pio_device *pio, unsigned int reg)
+{
+	return readl(pio->base + reg);
+}
+
+static inline void pio_write(struct rp1_pio_device *pio, unsigned int reg,
+			     u32 value)
+{
+	writel(value, pio->base + reg);
+}
+
+static void rp1_pio_release(struct kref *ref)
+{
+	kfree(container_of(ref, struct rp1_pio_device, ref));
+}
+
+static void rp1_pio_put(void *data)
+{
+	struct rp1_pio_device *pio = data;
+
+	kref_put(&pio->ref, rp1_pio_release);
+}
+
+/* Called with pio->lock held */
+static int rp1_pio_sm_check(struct rp1_pio_client *client, unsigned int sm)
+{
+	if (client->pio->dead)
+		return -ENODEV;
+	if (sm >= RP1_PIO_SM_COUNT || !(client->claimed_sms & BIT(sm)))
+		return -EPERM;
+	return 0;
+}
+
+static void rp1_pio_sm_stop(struct rp1_pio_device *pio, unsigned int sm)
+{
+	pio_write(pio, PIO_CTRL, pio_read(pio, PIO_CTRL) & ~PIO_CTRL_SM_ENABLE(sm));
+}
+
+static struct rp1_pio_client *rp1_pio_client_alloc(struct rp1_pio_device *pio)
+{
+	struct rp1_pio_client *client;
+
+	client = kzalloc(sizeof(*client), GFP_KERNEL);
+	if (!client)
+		return ERR_PTR(-ENOMEM);
+
+	kref_get(&pio->ref);
+	client->pio = pio;
+	return client;
+}
+
+struct rp1_pio_client *rp1_pio_open(void)
+{
+	struct rp1_pio_client *client;
+
+	mutex_lock(&g_pio_lock);
+	if (g_pio)
+		client = rp1_pio_client_alloc(g_pio);
+	else
+		client = ERR_PTR(-EPROBE_DEFER);
+	mutex_unlock(&g_pio_lock);
+
+	return client;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_open);
+
+void rp1_pio_close(struct rp1_pio_client *client)
+{
+	struct rp1_pio_device *pio = client->pio;
+	unsigned int sm;
+
+	for (sm = 0; sm < RP1_PIO_SM_COUNT; sm++) {
+		if (client->claimed_sms & BIT(sm))
+			rp1_pio_sm_unclaim(client, sm);
+	}
+
+	mutex_lock(&pio->lock);
+	pio->used_instrs &= ~client->used_instrs;
+	mutex_unlock(&pio->lock);
+
+	kfree(client);
+	rp1_pio_put(pio);
+}
+EXPORT_SYMBOL_GPL(rp1_pio_close);
+
+static int rp1_pio_find_origin(u32 used, unsigned int num, unsigned int origin)
+{
+	u32 mask = GENMASK(num - 1, 0);
+	int i;
+
+	if (origin != RP1_PIO_ORIGIN_ANY) {
+		if (origin > RP1_PIO_INSTRUCTION_COUNT - num ||
+		    (used & (mask << origin)))
+			return -EBUSY;
+		return origin;
+	}
+
+	/* Allocate from the top, leaving the low addresses for fixed origins */
+	for (i = RP1_PIO_INSTRUCTION_COUNT - num; i >= 0; i--) {
+		if (!(used & (mask << i)))
+			return i;
+	}
+
+	return -ENOSPC;
+}
+
+int rp1_pio_add_program(struct rp1_pio_client *client,
+			const struct rp1_pio_add_program_args *args)
+{
+	struct rp1_pio_device *pio = client->pio;
+	unsigned int num = args->num_instrs;
+	unsigned int i;
+	int offset;
+
+	if (!num || num > RP1_PIO_INSTRUCTION_COUNT)
+		return -EINVAL;
+
+	mutex_lock(&pio->lock);
+
+	if (pio->dead) {
+		offset = -ENODEV;
+		goto out;
+	}
+
+	offset = rp1_pio_find_origin(pio->used_instrs, num, args->origin);
+	if (offset < 0)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		u16 instr = args->instrs[i];
+
+		if ((instr & PIO_INSTR_OP_MASK) == PIO_INSTR_OP_JMP)
+			instr = (instr & ~PIO_INSTR_JMP_ADDR_MASK) |
+				((instr + offset) & PIO_INSTR_JMP_ADDR_MASK);
+		pio_write(pio, PIO_INSTR_MEM(offset + i), instr);
+	}
+
+	pio->used_instrs |= GENMASK(num - 1, 0) << offset;
+	client->used_instrs |= GENMASK(num - 1, 0) << offset;
+
+out:
+	mutex_unlock(&pio->lock);
+
+	return offset;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_add_program);
+
+int rp1_pio_remove_program(struct rp1_pio_client *client,
+			   const struct rp1_pio_remove_program_args *args)
+{
+	struct rp1_pio_device *pio = client->pio;
+	unsigned int num = args->num_instrs;
+	int ret = -ENOENT;
+	u32 mask;
+
+	if (!num || num > RP1_PIO_INSTRUCTION_COUNT ||
+	    args->origin > RP1_PIO_INSTRUCTION_COUNT - num)
+		return -EINVAL;
+
+	mask = GENMASK(num - 1, 0) << args->origin;
+
+	mutex_lock(&pio->lock);
+	if ((client->used_instrs & mask) == mask) {
+		pio->used_instrs &= ~mask;
+		client->used_instrs &= ~mask;
+		ret = 0;
+	}
+	mutex_unlock(&pio->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_remove_program);
+
+int rp1_pio_sm_claim(struct rp1_pio_client *client, unsigned int sm)
+{
+	struct rp1_pio_device *pio = client->pio;
+	int ret = -EBUSY;
+
+	if (sm != RP1_PIO_SM_ANY && sm >= RP1_PIO_SM_COUNT)
+		return -EINVAL;
+
+	mutex_lock(&pio->lock);
+
+	if (pio->dead) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	if (sm == RP1_PIO_SM_ANY) {
+		for (sm = 0; sm < RP1_PIO_SM_COUNT; sm++) {
+			if (!pio->sms[sm].owner)
+				break;
+		}
+	}
+
+	if (sm < RP1_PIO_SM_COUNT && !pio->sms[sm].owner) {
+		pio->sms[sm].owner = client;
+		client->claimed_sms |= BIT(sm);
+		ret = sm;
+	}
+
+out:
+	mutex_unlock(&pio->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_sm_claim);
+
+/*
+ * Fail a transfer in progress on @dma. The waiter terminates the channel
+ * itself, as it is the only one allowed to touch it. Called with pio->lock
+ * held, so that a transfer is either started before this and woken by it,
+ * or sees the state that made us abort and is never started.
+ */
+static void rp1_pio_sm_dma_abort(struct rp1_pio_sm_dma *dma, int result)
+{
+	WRITE_ONCE(dma->result, result);
+	complete(&dma->done);
+}
+
+int rp1_pio_sm_unclaim(struct rp1_pio_client *client, unsigned int sm)
+{
+	struct rp1_pio_device *pio = client->pio;
+	unsigned int dir;
+
+	mutex_lock(&pio->lock);
+	if (sm >= RP1_PIO_SM_COUNT || !(client->claimed_sms & BIT(sm))) {
+		mutex_unlock(&pio->lock);
+		return -EPERM;
+	}
+
+	/*
+	 * Stop the client starting new transfers, but keep the state machine
+	 * owned until those in progress have gone, so that no other client
+	 * can claim it and have its transfers aborted.
+	 */
+	client->claimed_sms &= ~BIT(sm);
+	if (!pio->dead)
+		rp1_pio_sm_stop(pio, sm);
+	for (dir = 0; dir < ARRAY_SIZE(pio->sms[sm].dma); dir++)
+		rp1_pio_sm_dma_abort(&pio->sms[sm].dma[dir], -ECANCELED);
+	mutex_unlock(&pio->lock);
+
+	for (dir = 0; dir < ARRAY_SIZE(pio->sms[sm].dma); dir++) {
+		struct rp1_pio_sm_dma *dma = &pio->sms[sm].dma[dir];
+
+		mutex_lock(&dma->lock);
+		mutex_unlock(&dma->lock);
+	}
+
+	mutex_lock(&pio->lock);
+	pio->sms[sm].owner = NULL;
+	mutex_unlock(&pio->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_sm_unclaim);
+
+int rp1_pio_sm_config(struct rp1_pio_client *client,
+		      const struct rp1_pio_sm_config_args *args)
+{
+	struct rp1_pio_device *pio = client->pio;
+	unsigned int sm = args->sm;
+	int ret;
+
+	if (args->initial_pc >= RP1_PIO_INSTRUCTION_COUNT)
+		return -EINVAL;
+
+	mutex_lock(&pio->lock);
+
+	ret = rp1_pio_sm_check(client, sm);
+	if (ret)
+		goto out;
+
+	rp1_pio_sm_stop(pio, sm);
+
+	pio_write(pio, PIO_SM_CLKDIV(sm), args->clkdiv);
+	pio_write(pio, PIO_SM_EXECCTRL(sm), args->execctrl);
+	pio_write(pio, PIO_SM_PINCTRL(sm), args->pinctrl);
+
+	/* Changing the FIFO join clears both FIFOs */
+	pio_write(pio, PIO_SM_SHIFTCTRL(sm),
+		  args->shiftctrl ^ PIO_SHIFTCTRL_FJOIN_RX);
+	pio_write(pio, PIO_SM_SHIFTCTRL(sm), args->shiftctrl);
+
+	pio_write(pio, PIO_CTRL, pio_read(pio, PIO_CTRL) |
+		  PIO_CTRL_SM_RESTART(sm) | PIO_CTRL_CLKDIV_RESTART(sm));
+
+	/* An unconditional JMP takes the state machine to its entry point */
+	pio_write(pio, PIO_SM_INSTR(sm), PIO_INSTR_OP_JMP | args->initial_pc);
+
+out:
+	mutex_unlock(&pio->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_sm_config);
+
+int rp1_pio_sm_set_enabled(struct rp1_pio_client *client, unsigned int sm,
+			   bool enable)
+{
+	struct rp1_pio_device *pio = client->pio;
+	u32 ctrl;
+	int ret;
+
+	mutex_lock(&pio->lock);
+	ret = rp1_pio_sm_check(client, sm);
+	if (!ret) {
+		ctrl = pio_read(pio, PIO_CTRL);
+		if (enable)
+			ctrl |= PIO_CTRL_SM_ENABLE(sm);
+		else
+			ctrl &= ~PIO_CTRL_SM_ENABLE(sm);
+		pio_write(pio, PIO_CTRL, ctrl);
+	}
+	mutex_unlock(&pio->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_sm_set_enabled);
+
+int rp1_pio_sm_exec(struct rp1_pio_client *client, unsigned int sm, u16 instr)
+{
+	struct rp1_pio_device *pio = client->pio;
+	int ret;
+
+	mutex_lock(&pio->lock);
+	ret = rp1_pio_sm_check(client, sm);
+	if (!ret)
+		pio_write(pio, PIO_SM_INSTR(sm), instr);
+	mutex_unlock(&pio->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(rp1_pio_sm_exec);
+
+static void rp1_pio_dma_complete(void *param)
+{
+	struct rp1_pio_sm_dma *dma = param;
+
+	complete(&dma->done);
+}
+
+static int rp1_pio_sm_dma_setup(struct rp1_pio_device *pio, unsigned int sm,
+				unsigned int dir)
+{
+	struct rp1_pio_sm_dma *dma = &pio->sms[sm].dma[dir];
+	struct dma_slave_config config = {};
+	char name[4];
+	int ret;
+
+	if (dma->chan)
+		return 0;
+
+	snprintf(name, sizeof(name), "%s%u",
+		 dir == RP1_PIO_DIR_TO_SM ? "tx" : "rx", sm);
+	dma->chan = dma_request_chan(pio->dev, name);
+	if (IS_ERR(dma->chan)) {
+		ret = PTR_ERR(dma->chan);
+		dma->chan = NULL;
+		dev_err(pio->dev, "failed to get DMA channel %s: %d\n",
+			name, ret);
+		return ret;
+	}
+
+	/* The FIFO DREQs only guarantee room for, or presence of, one word */
+	if (dir == RP1_PIO_DIR_TO_SM) {
+		config.direction = DMA_MEM_TO_DEV;
+		config.dst_addr = pio->dma_base + PIO_TXF(sm);
+		config.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		config.dst_maxburst = 1;
+	} else {
+		config.direction = DMA_DEV_TO_MEM;
+		config.src_addr = pio->dma_base + PIO_RXF(sm);
+		config.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+		config.src_maxburst = 1;
+	}
+
+	ret = dmaengine_slave_config(dma->chan, &config);
+	if (ret)
+		goto err_release;
+
+	dma->buf = dma_alloc_coherent(dma->chan->device->dev,
+				      RP1_PIO_DMA_BUF_SIZE, &dma->buf_dma,
+				      GFP_KERNEL);
+	if (!dma->buf) {
+		ret = -ENOMEM;
+		goto err_release;
+	}
+
+	return 0;
+
+err_release:
+	dma_release_channel(dma->chan);
+	dma->chan = NULL;
+	return ret;
+}
+
+/*
+ * Start one transfer of the bounce buffer, if @client still owns @sm.
+ * Checking and starting under pio->lock lets unclaim and remove abort
+ * every transfer they race with.
+ */
+static int rp1_pio_sm_dma_start(struct rp1_pio_client *client,
+				unsigned int sm, unsigned int dir, size_t len)
+{
+	struct rp1_pio_device *pio = client->pio;
+	struct rp1_pio_sm_dma *dma = &pio->sms[sm].dma[dir];
+	struct dma_async_tx_descriptor *desc;
+	int ret;
+
+	mutex_lock(&pio->lock);
+
+	ret = rp1_pio_sm_check(client, sm);
+	if (ret)
+		goto out;
+
+	desc = dmaengine_prep_slave_single(dma->chan, dma->buf_dma, len,
+					   dir == RP1_PIO_DIR_TO_SM ?
+					   DMA_MEM_TO_DEV : DMA_DEV_TO_MEM,
+					   DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (!desc) {
+		ret = -EIO;
+		goto out;
+	}
+
+	desc->callback = rp1_pio_dma_complete;
+	desc->callback_param = dma;
+	dma->result = 0;
+	reinit_completion(&dma->done);
+
+	if (dma_submit_error(dmaengine_submit(desc)))
+		ret = -EIO;
+	else
+		dma_async_issue_pending(dma->chan);
+
+out:
+	mutex_unlock(&pio->lock);
+
+	return ret;
+}
+
+static int rp1_pio_sm_dma_wait(struct rp1_pio_sm_dma *dma)
+{
+	long ret;
+
+	ret = wait_for_completion_interruptible_timeout(&dma->done,
+			msecs_to_jiffies(RP1_PIO_DMA_TIMEOUT_MS));
+	if (ret > 0)
+		ret = READ_ONCE(dma->result);
+	else if (!ret)
+		ret = -ETIMEDOUT;
+
+	if (ret)
+		dmaengine_terminate_sync(dma->chan);
+
+	return ret;
+}
+
+/*
+ * Move @len bytes between the FIFO of @sm and either a kernel or a user
+ * buffer, through the DMA bounce buffer of that FIFO.
+ */
+static int rp1_pio_sm_xfer(struct rp1_pio_client *client, unsigned int sm,
+			   unsigned int dir, void *kbuf, void __user *ubuf,
+			   size_t len)
+{
+	struct rp1_pio_device *pio = client->pio;
+	struct rp1_pio_sm_dma *dma;
+	size_t done = 0;
+	int ret;
+
+	if (sm >= RP1_PIO_SM_COUNT)
+		return -EPERM;
+	if (dir != RP1_PIO_DIR_TO_SM && dir != RP1_PIO_DIR_FROM_SM)
+		return -EINVAL;
+	if (!len || !IS_ALIGNED(len, 4))
+		return -EINVAL;
+
+	dma = &pio->sms[sm].dma[dir];
+	mutex_lock(&dma->lock);
+
+	/*
+	 * Unclaim and remove wait for dma->lock after failing the check, so
+	 * the channel cannot be set up behind their backs.
+	 */
+	mutex_lock(&pio->lock);
+	ret = rp1_pio_sm_check(client, sm);
+	mutex_unlock(&pio->lock);
+
+	if (!ret)
+		ret = rp1_pio_sm_dma_setup(pio, sm, dir);
+
+	while (!ret && done < len) {
+		size_t chunk = min_t(size_t, len - done, RP1_PIO_DMA_BUF_SIZE);
+
+		if (dir == RP1_PIO_DIR_TO_SM) {
+			if (!ubuf)
+				memcpy(dma->buf, kbuf + done, chunk);
+			else if (copy_from_user(dma->buf, ubuf + done, chunk))
+				ret = -EFAULT;
+		}
+
+		if (!ret)
+			ret = rp1_pio_sm_dma_start(client, sm, dir, chunk);
+		if (!ret)
+			ret = rp1_pio_sm_dma_wait(dma);
+
+		if (!ret && dir == RP1_PIO_DIR_FROM_SM) {
+			if (!ubuf)
+				memcpy(kbuf + done, dma->buf, chunk);
+			else if (copy_to_user(ubuf + done, dma->buf, chunk))
+				ret = -EFAULT;
+		}
+
+		done += chunk;
+	}
+
+	mutex_unlock(&dma->lock);
+
+	return ret;
+}
+
+int rp1_pio_sm_xfer_data(struct rp1_pio_client *client, unsigned int sm,
+			 unsigned int dir, void *data, size_t len)
+{
+	return rp1_pio_sm_xfer(client, sm, dir, data, NULL, len);
+}
+EXPORT_SYMBOL_GPL(rp1_pio_sm_xfer_data);
+
+static int rp1_pio_file_open(struct inode *inode, struct file *file)
+{
+	struct rp1_pio_device *pio = container_of(file->private_data,
+						  struct rp1_pio_device, misc);
+	struct rp1_pio_client *client;
+
+	client = rp1_pio_client_alloc(pio);
+	if (IS_ERR(client))
+		return PTR_ERR(client);
+
+	file->private_data = client;
+	return 0;
+}
+
+static int rp1_pio_file_release(struct inode *inode, struct file *file)
+{
+	rp1_pio_close(file->private_data);
+	return 0;
+}
+
+static long rp1_pio_ioctl(struct file *file, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct rp1_pio_client *client = file->private_data;
+	void __user *argp = (void __user *)arg;
+
+	switch (cmd) {
+	case PIO_IOC_ADD_PROGRAM: {
+		struct rp1_pio_add_program_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		return rp1_pio_add_program(client, &args);
+	}
+	case PIO_IOC_REMOVE_PROGRAM: {
+		struct rp1_pio_remove_program_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		return rp1_pio_remove_program(client, &args);
+	}
+	case PIO_IOC_SM_CLAIM:
+	case PIO_IOC_SM_UNCLAIM: {
+		struct rp1_pio_sm_claim_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		if (cmd == PIO_IOC_SM_CLAIM)
+			return rp1_pio_sm_claim(client, args.sm);
+		return rp1_pio_sm_unclaim(client, args.sm);
+	}
+	case PIO_IOC_SM_CONFIG: {
+		struct rp1_pio_sm_config_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		return rp1_pio_sm_config(client, &args);
+	}
+	case PIO_IOC_SM_SET_ENABLED: {
+		struct rp1_pio_sm_set_enabled_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		return rp1_pio_sm_set_enabled(client, args.sm, args.enable);
+	}
+	case PIO_IOC_SM_EXEC: {
+		struct rp1_pio_sm_exec_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		return rp1_pio_sm_exec(client, args.sm, args.instr);
+	}
+	case PIO_IOC_SM_XFER_DATA: {
+		struct rp1_pio_sm_xfer_data_args args;
+
+		if (copy_from_user(&args, argp, sizeof(args)))
+			return -EFAULT;
+		return rp1_pio_sm_xfer(client, args.sm, args.dir, NULL,
+				       u64_to_user_ptr(args.data),
+				       args.data_bytes);
+	}
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations rp1_pio_fops = {
+	.owner		= THIS_MODULE,
+	.open		= rp1_pio_file_open,
+	.release	= rp1_pio_file_release,
+	.unlocked_ioctl	= rp1_pio_ioctl,
+	.compat_ioctl	= compat_ptr_ioctl,
+};
+
+static int rp1_pio_probe(struct platform_device *pdev)
+{
+	struct device *dev = &pdev->dev;
+	struct rp1_pio_device *pio;
+	struct resource *res;
+	const __be32 *addr;
+	unsigned int sm, dir;
+	int ret;
+
+	if (g_pio)
+		return -EBUSY;
+
+	/* Clients may outlive the device, so the state is refcounted */
+	pio = kzalloc(sizeof(*pio), GFP_KERNEL);
+	if (!pio)
+		return -ENOMEM;
+
+	kref_init(&pio->ref);
+	ret = devm_add_action_or_reset(dev, rp1_pio_put, pio);
+	if (ret)
+		return ret;
+
+	pio->dev = dev;
+	mutex_init(&pio->lock);
+
+	pio->base = devm_platform_get_and_ioremap_resource(pdev, 0, &res);
+	if (IS_ERR(pio->base))
+		return PTR_ERR(pio->base);
+
+	/* The DMA controller sees the FIFOs at their RP1 bus address */
+	pio->dma_base = res->start;
+	addr = of_get_address(dev->of_node, 0, NULL, NULL);
+	if (addr) {
+		u64 dma_addr = of_translate_dma_address(dev->of_node, addr);
+
+		if (dma_addr != OF_BAD_ADDR)
+			pio->dma_base = dma_addr;
+	}
+
+	pio->clk = devm_clk_get_optional_enabled(dev, NULL);
+	if (IS_ERR(pio->clk))
+		return dev_err_probe(dev, PTR_ERR(pio->clk),
+				     "failed to get clock\n");
+
+	for (sm = 0; sm < RP1_PIO_SM_COUNT; sm++) {
+		for (dir = 0; dir < ARRAY_SIZE(pio->sms[sm].dma); dir++) {
+			init_completion(&pio->sms[sm].dma[dir].done);
+			mutex_init(&pio->sms[sm].dma[dir].lock);
+		}
+	}
+
+	/* Start from a clean slate, with every state machine stopped */
+	pio_write(pio, PIO_CTRL, 0);
+
+	pio->misc.minor = MISC_DYNAMIC_MINOR;
+	pio->misc.name = "pio0";
+	pio->misc.fops = &rp1_pio_fops;
+	pio->misc.parent = dev;
+
+	platform_set_drvdata(pdev, pio);
+
+	ret = misc_register(&pio->misc);
+	if (ret)
+		return ret;
+
+	mutex_lock(&g_pio_lock);
+	g_pio = pio;
+	mutex_unlock(&g_pio_lock);
+
+	dev_info(dev, "RP1 PIO, %d state machines, %d instructions\n",
+		 RP1_PIO_SM_COUNT, RP1_PIO_INSTRUCTION_COUNT);
+
+	return 0;
+}
+
+static int rp1_pio_remove(struct platform_device *pdev)
+{
+	struct rp1_pio_device *pio = platform_get_drvdata(pdev);
+	unsigned int sm, dir;
+
+	mutex_lock(&g_pio_lock);
+	g_pio = NULL;
+	mutex_unlock(&g_pio_lock);
+
+	misc_deregister(&pio->misc);
+
+	/*
+	 * Open clients keep their reference, but from here on every call
+	 * they make fails with -ENODEV instead of touching the hardware.
+	 */
+	mutex_lock(&pio->lock);
+	pio->dead = true;
+	pio_write(pio, PIO_CTRL, 0);
+	for (sm = 0; sm < RP1_PIO_SM_COUNT; sm++) {
+		for (dir = 0; dir < ARRAY_SIZE(pio->sms[sm].dma); dir++)
+			rp1_pio_sm_dma_abort(&pio->sms[sm].dma[dir], -ENODEV);
+	}
+	mutex_unlock(&pio->lock);
+
+	for (sm = 0; sm < RP1_PIO_SM_COUNT; sm++) {
+		for (dir = 0; dir < ARRAY_SIZE(pio->sms[sm].dma); dir++) {
+			struct rp1_pio_sm_dma *dma = &pio->sms[sm].dma[dir];
+
+			mutex_lock(&dma->lock);
+			if (dma->chan) {
+				dma_free_coherent(dma->chan->device->dev,
+						  RP1_PIO_DMA_BUF_SIZE, dma->buf,
+						  dma->buf_dma);
+				dma_release_channel(dma->chan);
+				dma->chan = NULL;
+			}
+			mutex_unlock(&dma->lock);
+		}
+	}
+
+	return 0;
+}
+
+static const struct of_device_id rp1_pio_of_match[] = {
+	{ .compatible = "raspberrypi,rp1-pio" },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, rp1_pio_of_match);
+
+static struct platform_driver rp1_pio_driver = {
+	.driver = {
+		.name = DRIVER_NAME,
+		.of_match_table = rp1_pio_of_match,
+	},
+	.probe = rp1_pio_probe,
+	.remove = rp1_pio_remove,
+};
+module_platform_driver(rp1_pio_driver);
+
+MODULE_DESCRIPTION("Raspberry Pi RP1 PIO driver");
+MODULE_LICENSE("GPL");
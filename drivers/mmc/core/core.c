@@ -172,6 +172,7 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 	 */
 	if (!err || !cmd->retries || mmc_card_removed(host->card)) {
 		mmc_should_fail_request(host, mrq);
+		mmc_debugfs_io_done(host, mrq, false);
 
 		if (!host->ongoing_mrq)
 			led_trigger_event(host->led, LED_OFF);
@@ -254,6 +255,7 @@ static void __mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 	}
 
 	trace_mmc_request_start(host, mrq);
+	mmc_debugfs_io_start(host, mrq, false);
 
 	if (host->cqe_on)
 		host->cqe_ops->cqe_off(host);
@@ -450,9 +452,12 @@ int mmc_cqe_start_req(struct mmc_host *host, struct mmc_request *mrq)
 	if (err)
 		goto out_err;
 
+	mmc_debugfs_io_start(host, mrq, true);
 	err = host->cqe_ops->cqe_request(host, mrq);
-	if (err)
+	if (err) {
+		mmc_debugfs_io_done(host, mrq, true);
 		goto out_err;
+	}
 
 	trace_mmc_request_start(host, mrq);
 	led_trigger_event(host->led, LED_FULL);
@@ -489,6 +494,7 @@ void mmc_cqe_request_done(struct mmc_host *host, struct mmc_request *mrq)
 		mmc_retune_needed(host);
 
 	trace_mmc_request_done(host, mrq);
+	mmc_debugfs_io_done(host, mrq, true);
 
 	if (mrq->cmd) {
 		pr_debug("%s: CQE req done (direct CMD%u): %d\n",
@@ -92,6 +92,13 @@ void mmc_remove_host_debugfs(struct mmc_host *host);
 
 void mmc_add_card_debugfs(struct mmc_card *card);
 void mmc_remove_card_debugfs(struct mmc_card *card);
+
+void mmc_debugfs_io_start(struct mmc_host *host, struct mmc_request *mrq,
+			  bool cqe);
+void mmc_debugfs_io_done(struct mmc_host *host, struct mmc_request *mrq,
+			 bool cqe);
+void mmc_debugfs_busy_done(struct mmc_host *host, u64 start_ns);
+void mmc_debugfs_retune_done(struct mmc_host *host);
 #else
 static inline void mmc_add_host_debugfs(struct mmc_host *host)
 {
@@ -105,6 +112,20 @@ static inline void mmc_add_card_debugfs(struct mmc_card *card)
 static inline void mmc_remove_card_debugfs(struct mmc_card *card)
 {
 }
+static inline void mmc_debugfs_io_start(struct mmc_host *host,
+					struct mmc_request *mrq, bool cqe)
+{
+}
+static inline void mmc_debugfs_io_done(struct mmc_host *host,
+				       struct mmc_request *mrq, bool cqe)
+{
+}
+static inline void mmc_debugfs_busy_done(struct mmc_host *host, u64 start_ns)
+{
+}
+static inline void mmc_debugfs_retune_done(struct mmc_host *host)
+{
+}
 #endif
 
 int mmc_execute_tuning(struct mmc_card *card);
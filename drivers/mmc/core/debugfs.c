@@ -12,6 +12,9 @@
 #include <linux/slab.h>
 #include <linux/stat.h>
 #include <linux/fault-inject.h>
+#include <linux/ktime.h>
+#include <linux/log2_hist.h>
+#include <linux/sizes.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -298,6 +301,162 @@ static const struct file_operations mmc_err_stats_fops = {
 	.release = single_release,
 };
 
+static unsigned int mmc_io_stats_lat_bucket(u64 start_ns)
+{
+	u64 us = div_u64(ktime_get_ns() - start_ns, NSEC_PER_USEC);
+
+	/* Bucket 0 is below 16us, each following one doubles */
+	return log2_hist_bucket(us, 4, MMC_IO_STATS_LAT);
+}
+
+static unsigned int mmc_io_stats_size_bucket(struct mmc_data *data)
+{
+	unsigned int bytes = data->blksz * data->blocks;
+
+	if (bytes <= SZ_4K)
+		return 0;
+	if (bytes <= SZ_64K)
+		return 1;
+	if (bytes <= SZ_512K)
+		return 2;
+	return 3;
+}
+
+void mmc_debugfs_io_start(struct mmc_host *host, struct mmc_request *mrq,
+			  bool cqe)
+{
+	int depth;
+
+	mrq->io_start_ns = ktime_get_ns();
+
+	if (!cqe)
+		return;
+
+	depth = min(atomic_inc_return(&host->cqe_in_flight), MMC_IO_STATS_DEPTH);
+	host->io_stats.cqe_depth[depth] += 1;
+	if (host->card)
+		host->card->io_stats.cqe_depth[depth] += 1;
+}
+
+static void mmc_io_stats_account(struct mmc_io_stats *stats,
+				 struct mmc_data *data, unsigned int lat)
+{
+	unsigned int size = mmc_io_stats_size_bucket(data);
+
+	if (data->flags & MMC_DATA_READ)
+		stats->read_lat[size][lat] += 1;
+	else
+		stats->write_lat[size][lat] += 1;
+}
+
+void mmc_debugfs_io_done(struct mmc_host *host, struct mmc_request *mrq,
+			 bool cqe)
+{
+	struct mmc_data *data = mrq->data;
+	unsigned int lat;
+
+	if (cqe)
+		atomic_dec(&host->cqe_in_flight);
+
+	/* Only successful transfers say anything about the card's speed */
+	if (!data || data->error || !data->bytes_xfered)
+		return;
+
+	lat = mmc_io_stats_lat_bucket(mrq->io_start_ns);
+	mmc_io_stats_account(&host->io_stats, data, lat);
+	if (host->card)
+		mmc_io_stats_account(&host->card->io_stats, data, lat);
+}
+
+void mmc_debugfs_busy_done(struct mmc_host *host, u64 start_ns)
+{
+	unsigned int lat = mmc_io_stats_lat_bucket(start_ns);
+
+	host->io_stats.busy_lat[lat] += 1;
+	if (host->card)
+		host->card->io_stats.busy_lat[lat] += 1;
+}
+
+void mmc_debugfs_retune_done(struct mmc_host *host)
+{
+	host->io_stats.retune += 1;
+	if (host->card)
+		host->card->io_stats.retune += 1;
+}
+
+static void mmc_io_stats_show_lat(struct seq_file *s, const char *name,
+				  const u32 *lat)
+{
+	int i;
+
+	seq_printf(s, "%-12s", name);
+	for (i = 0; i < MMC_IO_STATS_LAT; i++)
+		seq_printf(s, " %8u", lat[i]);
+	seq_putc(s, '\n');
+}
+
+/*
+ * Latency histograms per direction and request size. Each column counts
+ * the requests that completed in less than the given number of
+ * microseconds, the last one everything slower.
+ */
+static int mmc_io_stats_show(struct seq_file *s, void *data)
+{
+	static const char * const sizes[MMC_IO_STATS_SIZES] = {
+		"<=4k", "<=64k", "<=512k", ">512k",
+	};
+	struct mmc_io_stats *stats = s->private;
+	char name[16];
+	int i;
+
+	seq_printf(s, "%-12s", "usecs");
+	for (i = 0; i < MMC_IO_STATS_LAT - 1; i++)
+		seq_printf(s, " %8u", 16U << i);
+	seq_printf(s, " %8s\n", "more");
+
+	for (i = 0; i < MMC_IO_STATS_SIZES; i++) {
+		snprintf(name, sizeof(name), "read %s", sizes[i]);
+		mmc_io_stats_show_lat(s, name, stats->read_lat[i]);
+	}
+	for (i = 0; i < MMC_IO_STATS_SIZES; i++) {
+		snprintf(name, sizeof(name), "write %s", sizes[i]);
+		mmc_io_stats_show_lat(s, name, stats->write_lat[i]);
+	}
+	mmc_io_stats_show_lat(s, "busy", stats->busy_lat);
+
+	seq_printf(s, "retune:\t%u\n", stats->retune);
+
+	seq_puts(s, "cqe depth:");
+	for (i = 1; i <= MMC_IO_STATS_DEPTH; i++)
+		if (stats->cqe_depth[i])
+			seq_printf(s, " %d:%u", i, stats->cqe_depth[i]);
+	seq_putc(s, '\n');
+
+	return 0;
+}
+
+static int mmc_io_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_io_stats_show, inode->i_private);
+}
+
+static ssize_t mmc_io_stats_write(struct file *filp, const char __user *ubuf,
+				  size_t cnt, loff_t *ppos)
+{
+	struct mmc_io_stats *stats = filp->f_mapping->host->i_private;
+
+	memset(stats, 0, sizeof(*stats));
+
+	return cnt;
+}
+
+static const struct file_operations mmc_io_stats_fops = {
+	.open	= mmc_io_stats_open,
+	.read	= seq_read,
+	.write	= mmc_io_stats_write,
+	.release = single_release,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -315,6 +474,8 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 			    &mmc_err_state);
 	debugfs_create_file("err_stats", 0600, root, host,
 			    &mmc_err_stats_fops);
+	debugfs_create_file("io_stats", 0600, root, &host->io_stats,
+			    &mmc_io_stats_fops);
 
 #ifdef CONFIG_FAIL_MMC_REQUEST
 	if (fail_request)
@@ -342,6 +503,8 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 	card->debugfs_root = root;
 
 	debugfs_create_x32("state", S_IRUSR, root, &card->state);
+	debugfs_create_file("io_stats", 0600, root, &card->io_stats,
+			    &mmc_io_stats_fops);
 }
 
 void mmc_remove_card_debugfs(struct mmc_card *card)
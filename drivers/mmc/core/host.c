@@ -209,6 +209,7 @@ int mmc_retune(struct mmc_host *host)
 		err = mmc_hs200_to_hs400(host->card);
 out:
 	host->doing_retune = 0;
+	mmc_debugfs_retune_done(host);
 
 	return err;
 }
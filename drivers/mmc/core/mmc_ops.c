@@ -9,6 +9,7 @@
 #include <linux/export.h>
 #include <linux/types.h>
 #include <linux/scatterlist.h>
+#include <linux/ktime.h>
 
 #include <linux/mmc/host.h>
 #include <linux/mmc/card.h>
@@ -507,6 +508,7 @@ int __mmc_poll_for_busy(struct mmc_host *host, unsigned int period_us,
 	int err;
 	unsigned long timeout;
 	unsigned int udelay = period_us ? period_us : 32, udelay_max = 32768;
+	u64 start_ns = ktime_get_ns();
 	bool expired = false;
 	bool busy = false;
 
@@ -537,6 +539,8 @@ int __mmc_poll_for_busy(struct mmc_host *host, unsigned int period_us,
 		}
 	} while (busy);
 
+	mmc_debugfs_busy_done(host, start_ns);
+
 	return 0;
 }
 EXPORT_SYMBOL_GPL(__mmc_poll_for_busy);
@@ -11,6 +11,8 @@
 
 #include <linux/scatterlist.h>
 #include <linux/list.h>
+#include <linux/sizes.h>
+#include <linux/sort.h>
 
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
@@ -22,6 +24,7 @@
 #include "host.h"
 #include "bus.h"
 #include "mmc_ops.h"
+#include "sd_ops.h"
 
 #define RESULT_OK		0
 #define RESULT_FAIL		1
@@ -39,6 +42,13 @@
  */
 #define TEST_AREA_MAX_SIZE (128 * 1024 * 1024)
 
+/* Benchmark suite defaults and limits */
+#define BENCH_MAX_SIZES		8
+#define BENCH_MAX_DEPTH		8
+#define BENCH_DEF_COUNT		256
+#define BENCH_MAX_COUNT		65536
+#define BENCH_CQE_TIMEOUT_MS	10000
+
 /**
  * struct mmc_test_pages - pages allocated by 'alloc_pages()'.
  * @page: first page in the allocation
@@ -119,6 +129,72 @@ struct mmc_test_general_result {
 	struct list_head tr_lst;
 };
 
+enum mmc_test_bench_mode {
+	MMC_TEST_BENCH_SYNC,
+	MMC_TEST_BENCH_ASYNC,
+	MMC_TEST_BENCH_CQE,
+};
+
+enum mmc_test_bench_lat {
+	MMC_TEST_BENCH_LAT_MIN,
+	MMC_TEST_BENCH_LAT_P50,
+	MMC_TEST_BENCH_LAT_P90,
+	MMC_TEST_BENCH_LAT_P99,
+	MMC_TEST_BENCH_LAT_P999,
+	MMC_TEST_BENCH_LAT_MAX,
+	MMC_TEST_BENCH_LAT_NUM,
+};
+
+/**
+ * struct mmc_test_bench_cfg - benchmark matrix.
+ * @sizes: transfer sizes (in bytes)
+ * @nr_sizes: number of entries in @sizes
+ * @count: number of transfers per point
+ * @modes: bitmask of enum mmc_test_bench_mode
+ * @patterns: bitmask of sequential (bit 0) and random (bit 1) access
+ * @dirs: bitmask of read (bit 0) and write (bit 1)
+ */
+struct mmc_test_bench_cfg {
+	unsigned int sizes[BENCH_MAX_SIZES];
+	unsigned int nr_sizes;
+	unsigned int count;
+	unsigned long modes;
+	unsigned long patterns;
+	unsigned long dirs;
+};
+
+/**
+ * struct mmc_test_bench_result - results for one point of the benchmark.
+ * @link: double-linked list
+ * @card: card under test
+ * @size: transfer size (in bytes)
+ * @mode: submission mode
+ * @random: random instead of sequential addresses
+ * @write: write instead of read
+ * @depth: maximum number of requests in flight
+ * @count: number of transfers completed
+ * @result: result of the run
+ * @ts: time values of the run
+ * @rate: calculated transfer rate
+ * @iops: I/O operations per second (times 100)
+ * @lat: request latency percentiles (in ns)
+ */
+struct mmc_test_bench_result {
+	struct list_head link;
+	struct mmc_card *card;
+	unsigned int size;
+	enum mmc_test_bench_mode mode;
+	bool random;
+	bool write;
+	unsigned int depth;
+	unsigned int count;
+	int result;
+	struct timespec64 ts;
+	unsigned int rate;
+	unsigned int iops;
+	u64 lat[MMC_TEST_BENCH_LAT_NUM];
+};
+
 /**
  * struct mmc_test_dbgfs_file - debugfs related file.
  * @link: double-linked list
@@ -2314,6 +2390,22 @@ static int mmc_test_profile_sglen_r_nonblock_perf(struct mmc_test_card *test)
 	return mmc_test_rw_multiple_sg_len(test, &test_data);
 }
 
+static int mmc_test_cmdq_enable(struct mmc_card *card)
+{
+	if (mmc_card_sd(card))
+		return mmc_sd_cmdq_enable(card);
+
+	return mmc_cmdq_enable(card);
+}
+
+static int mmc_test_cmdq_disable(struct mmc_card *card)
+{
+	if (mmc_card_sd(card))
+		return mmc_sd_cmdq_disable(card);
+
+	return mmc_cmdq_disable(card);
+}
+
 /*
  * eMMC hardware reset.
  */
@@ -2329,7 +2421,7 @@ static int mmc_test_reset(struct mmc_test_card *test)
 		 * expect it to be disabled.
 		 */
 		if (card->ext_csd.cmdq_en)
-			mmc_cmdq_disable(card);
+			mmc_test_cmdq_disable(card);
 		return RESULT_OK;
 	} else if (err == -EOPNOTSUPP) {
 		return RESULT_UNSUP_HOST;
@@ -3150,6 +3242,720 @@ static int mtf_testlist_show(struct seq_file *sf, void *data)
 
 DEFINE_SHOW_ATTRIBUTE(mtf_testlist);
 
+/*******************************************************************/
+/*  Benchmark suite                                                */
+/*******************************************************************/
+
+static LIST_HEAD(mmc_test_bench_lst);
+
+static const char * const mmc_test_bench_modes[] = {
+	[MMC_TEST_BENCH_SYNC]	= "sync",
+	[MMC_TEST_BENCH_ASYNC]	= "async",
+	[MMC_TEST_BENCH_CQE]	= "cqe",
+};
+
+static const char * const mmc_test_bench_patterns[] = { "seq", "rnd" };
+
+static const char * const mmc_test_bench_dirs[] = { "read", "write" };
+
+/* Latency percentiles, in per mille */
+static const unsigned int mmc_test_bench_pm[MMC_TEST_BENCH_LAT_NUM] = {
+	[MMC_TEST_BENCH_LAT_MIN]	= 0,
+	[MMC_TEST_BENCH_LAT_P50]	= 500,
+	[MMC_TEST_BENCH_LAT_P90]	= 900,
+	[MMC_TEST_BENCH_LAT_P99]	= 990,
+	[MMC_TEST_BENCH_LAT_P999]	= 999,
+	[MMC_TEST_BENCH_LAT_MAX]	= 1000,
+};
+
+static const char * const mmc_test_bench_lat_names[MMC_TEST_BENCH_LAT_NUM] = {
+	[MMC_TEST_BENCH_LAT_MIN]	= "min",
+	[MMC_TEST_BENCH_LAT_P50]	= "p50",
+	[MMC_TEST_BENCH_LAT_P90]	= "p90",
+	[MMC_TEST_BENCH_LAT_P99]	= "p99",
+	[MMC_TEST_BENCH_LAT_P999]	= "p999",
+	[MMC_TEST_BENCH_LAT_MAX]	= "max",
+};
+
+/**
+ * struct mmc_test_bench_req - one request slot of the benchmark.
+ * @rq: request, commands and data
+ * @sg: scatterlist
+ * @sg_len: length of currently mapped scatterlist @sg
+ * @start_ns: time the request was started
+ * @end_ns: time the request completed (CQE only)
+ * @busy: request is in flight
+ */
+struct mmc_test_bench_req {
+	struct mmc_test_req rq;
+	struct scatterlist *sg;
+	unsigned int sg_len;
+	u64 start_ns;
+	u64 end_ns;
+	bool busy;
+};
+
+/**
+ * struct mmc_test_bench - benchmark state.
+ * @reqs: request slots
+ * @nr_reqs: number of entries in @reqs
+ * @lat: latency samples of the current point (in ns)
+ * @nr_lat: number of entries in @lat
+ */
+struct mmc_test_bench {
+	struct mmc_test_bench_req *reqs;
+	unsigned int nr_reqs;
+	u64 *lat;
+	unsigned int nr_lat;
+};
+
+static void mmc_test_free_bench_result(struct mmc_card *card)
+{
+	struct mmc_test_bench_result *br, *brs;
+
+	mutex_lock(&mmc_test_lock);
+
+	list_for_each_entry_safe(br, brs, &mmc_test_bench_lst, link) {
+		if (card && br->card != card)
+			continue;
+
+		list_del(&br->link);
+		kfree(br);
+	}
+
+	mutex_unlock(&mmc_test_lock);
+}
+
+/*
+ * The depth used for CQE requests, or zero if the card under test cannot
+ * be driven through the command queue engine.
+ */
+static unsigned int mmc_test_bench_cqe_depth(struct mmc_test_card *test)
+{
+	struct mmc_card *card = test->card;
+	struct mmc_host *host = card->host;
+
+	if (!host->cqe_enabled || host->hsq_enabled || !card->reenable_cmdq)
+		return 0;
+
+	return clamp_t(unsigned int,
+		       min_t(unsigned int, host->cqe_qdepth,
+			     card->ext_csd.cmdq_depth), 1, BENCH_MAX_DEPTH);
+}
+
+static int mmc_test_bench_flags(char *tok, const char * const *names,
+				unsigned int n, unsigned long *mask)
+{
+	int i = __match_string(names, n, tok);
+
+	if (i < 0)
+		return i;
+
+	*mask |= BIT(i);
+	return 0;
+}
+
+static int mmc_test_bench_parse_sizes(char *str,
+				      struct mmc_test_bench_cfg *cfg)
+{
+	unsigned long long sz;
+	char *end;
+
+	while (*str) {
+		sz = memparse(str, &end);
+		if (end == str || !sz || sz % 512 || sz > UINT_MAX)
+			return -EINVAL;
+		if (cfg->nr_sizes == BENCH_MAX_SIZES)
+			return -E2BIG;
+
+		cfg->sizes[cfg->nr_sizes++] = sz;
+
+		str = end;
+		if (*str == ',')
+			str++;
+		else if (*str)
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Parse the benchmark matrix, a list of whitespace separated tokens:
+ *
+ *   sizes=<size>[,<size>...]	transfer sizes, with optional K/M suffix
+ *   count=<n>			transfers per point
+ *   sync | async | cqe		submission modes
+ *   seq | rnd			access patterns
+ *   read | write		transfer directions
+ *
+ * Any dimension that is not given runs all of its values.
+ */
+static int mmc_test_bench_parse(char *buf, struct mmc_test_bench_cfg *cfg)
+{
+	char *tok;
+	int ret;
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->count = BENCH_DEF_COUNT;
+
+	while ((tok = strsep(&buf, " \t\n"))) {
+		if (!*tok)
+			continue;
+
+		if (!strncmp(tok, "sizes=", 6)) {
+			ret = mmc_test_bench_parse_sizes(tok + 6, cfg);
+		} else if (!strncmp(tok, "count=", 6)) {
+			ret = kstrtouint(tok + 6, 0, &cfg->count);
+			if (!ret && (!cfg->count || cfg->count > BENCH_MAX_COUNT))
+				ret = -EINVAL;
+		} else {
+			ret = mmc_test_bench_flags(tok, mmc_test_bench_modes,
+					ARRAY_SIZE(mmc_test_bench_modes),
+					&cfg->modes);
+			if (ret)
+				ret = mmc_test_bench_flags(tok,
+					mmc_test_bench_patterns,
+					ARRAY_SIZE(mmc_test_bench_patterns),
+					&cfg->patterns);
+			if (ret)
+				ret = mmc_test_bench_flags(tok,
+					mmc_test_bench_dirs,
+					ARRAY_SIZE(mmc_test_bench_dirs),
+					&cfg->dirs);
+		}
+		if (ret)
+			return ret;
+	}
+
+	if (!cfg->nr_sizes) {
+		cfg->sizes[cfg->nr_sizes++] = SZ_4K;
+		cfg->sizes[cfg->nr_sizes++] = SZ_64K;
+		cfg->sizes[cfg->nr_sizes++] = SZ_512K;
+	}
+	if (!cfg->modes)
+		cfg->modes = GENMASK(ARRAY_SIZE(mmc_test_bench_modes) - 1, 0);
+	if (!cfg->patterns)
+		cfg->patterns = GENMASK(ARRAY_SIZE(mmc_test_bench_patterns) - 1, 0);
+	if (!cfg->dirs)
+		cfg->dirs = GENMASK(ARRAY_SIZE(mmc_test_bench_dirs) - 1, 0);
+
+	return 0;
+}
+
+/*
+ * Address of the next transfer.  All transfers stay within the test area and
+ * are aligned to their size.
+ */
+static unsigned int mmc_test_bench_addr(struct mmc_test_card *test,
+					struct mmc_test_bench_result *br,
+					unsigned int i)
+{
+	struct mmc_test_area *t = &test->area;
+	unsigned int cnt = t->max_sz / br->size;
+
+	if (br->random)
+		i = mmc_test_rnd_num(cnt);
+	else
+		i %= cnt;
+
+	return t->dev_addr + i * (br->size >> 9);
+}
+
+static void mmc_test_bench_sample(struct mmc_test_bench *b, u64 start_ns,
+				  u64 end_ns)
+{
+	b->lat[b->nr_lat++] = end_ns - start_ns;
+}
+
+static int mmc_test_bench_sync(struct mmc_test_card *test,
+			       struct mmc_test_bench *b,
+			       struct mmc_test_bench_result *br)
+{
+	struct mmc_test_bench_req *req = &b->reqs[0];
+	struct mmc_request *mrq = &req->rq.mrq;
+	unsigned int i;
+	u64 start_ns;
+	int ret;
+
+	for (i = 0; i < br->count; i++) {
+		mmc_test_req_reset(&req->rq);
+		mmc_test_prepare_mrq(test, mrq, req->sg, req->sg_len,
+				     mmc_test_bench_addr(test, br, i),
+				     br->size >> 9, 512, br->write);
+
+		start_ns = ktime_get_ns();
+		mmc_wait_for_req(test->card->host, mrq);
+		ret = mmc_test_wait_busy(test);
+		if (!ret)
+			ret = mmc_test_check_result(test, mrq);
+		if (ret)
+			return ret;
+		mmc_test_bench_sample(b, start_ns, ktime_get_ns());
+	}
+
+	return 0;
+}
+
+/*
+ * Keep the next request prepared while the current one is in flight, the same
+ * way mmc_test_nonblock_transfer() does.  Latency is measured up to the point
+ * the card is ready for the next request.
+ */
+static int mmc_test_bench_async(struct mmc_test_card *test,
+				struct mmc_test_bench *b,
+				struct mmc_test_bench_result *br)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_bench_req *req, *prev = NULL;
+	struct mmc_request *mrq;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i <= br->count; i++) {
+		req = i < br->count ? &b->reqs[i & 1] : NULL;
+		if (req) {
+			mrq = &req->rq.mrq;
+			mmc_test_req_reset(&req->rq);
+			mmc_test_prepare_mrq(test, mrq, req->sg, req->sg_len,
+					     mmc_test_bench_addr(test, br, i),
+					     br->size >> 9, 512, br->write);
+			init_completion(&mrq->completion);
+			mrq->done = mmc_test_wait_done;
+			mmc_pre_req(host, mrq);
+		}
+
+		if (prev) {
+			wait_for_completion(&prev->rq.mrq.completion);
+			ret = mmc_test_wait_busy(test);
+			if (!ret)
+				ret = mmc_test_check_result(test, &prev->rq.mrq);
+			if (!ret)
+				mmc_test_bench_sample(b, prev->start_ns,
+						      ktime_get_ns());
+		}
+
+		if (!ret && req) {
+			req->start_ns = ktime_get_ns();
+			ret = mmc_start_request(host, &req->rq.mrq);
+			if (ret)
+				mmc_retune_release(host);
+		}
+
+		if (prev)
+			mmc_post_req(host, &prev->rq.mrq, 0);
+
+		if (ret) {
+			if (req)
+				mmc_post_req(host, &req->rq.mrq, ret);
+			return ret;
+		}
+
+		prev = req;
+	}
+
+	return 0;
+}
+
+static void mmc_test_bench_cqe_done(struct mmc_request *mrq)
+{
+	struct mmc_test_bench_req *req =
+		container_of(mrq, struct mmc_test_bench_req, rq.mrq);
+
+	req->end_ns = ktime_get_ns();
+	complete(&mrq->completion);
+}
+
+static int mmc_test_bench_cqe_reap(struct mmc_test_card *test,
+				   struct mmc_test_bench *b,
+				   struct mmc_test_bench_req *req)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_request *mrq = &req->rq.mrq;
+	struct mmc_data *data = mrq->data;
+	int ret = 0;
+
+	if (!wait_for_completion_timeout(&mrq->completion,
+				msecs_to_jiffies(BENCH_CQE_TIMEOUT_MS))) {
+		pr_info("%s: CQE request timed out\n", mmc_hostname(host));
+		/* Recovery completes all outstanding requests */
+		mmc_cqe_recovery(host);
+		wait_for_completion(&mrq->completion);
+		ret = -ETIMEDOUT;
+	}
+
+	req->busy = false;
+	mmc_cqe_post_req(host, mrq);
+
+	if (!ret)
+		ret = data->error;
+	if (!ret && data->bytes_xfered != data->blocks * data->blksz)
+		ret = RESULT_FAIL;
+	if (!ret)
+		mmc_test_bench_sample(b, req->start_ns, req->end_ns);
+
+	return ret;
+}
+
+/*
+ * Keep up to @br->depth requests queued on the command queue engine.  Slots
+ * are reused in order, so a request that completes early is only reaped when
+ * its slot comes around again, but its latency is taken at completion.
+ */
+static int mmc_test_bench_cqe(struct mmc_test_card *test,
+			      struct mmc_test_bench *b,
+			      struct mmc_test_bench_result *br)
+{
+	struct mmc_host *host = test->card->host;
+	struct mmc_test_bench_req *req;
+	struct mmc_request *mrq;
+	struct mmc_data *data;
+	unsigned int i;
+	int err, ret = 0;
+
+	mmc_retune_hold(host);
+
+	for (i = 0; i < br->count + br->depth; i++) {
+		req = &b->reqs[i % br->depth];
+		if (req->busy) {
+			err = mmc_test_bench_cqe_reap(test, b, req);
+			if (err && !ret)
+				ret = err;
+		}
+
+		if (ret || i >= br->count)
+			continue;
+
+		mmc_test_req_reset(&req->rq);
+		mrq = &req->rq.mrq;
+		data = mrq->data;
+		mrq->cmd = NULL;
+		mrq->stop = NULL;
+		mrq->tag = i % br->depth;
+		data->blk_addr = mmc_test_bench_addr(test, br, i);
+		data->blksz = 512;
+		data->blocks = br->size >> 9;
+		data->flags = br->write ? MMC_DATA_WRITE : MMC_DATA_READ;
+		data->sg = req->sg;
+		data->sg_len = req->sg_len;
+		mmc_set_data_timeout(data, test->card);
+
+		init_completion(&mrq->completion);
+		mrq->done = mmc_test_bench_cqe_done;
+		mmc_pre_req(host, mrq);
+
+		req->start_ns = ktime_get_ns();
+		ret = mmc_cqe_start_req(host, mrq);
+		if (ret) {
+			mmc_post_req(host, mrq, ret);
+			continue;
+		}
+		req->busy = true;
+	}
+
+	if (ret)
+		mmc_cqe_recovery(host);
+
+	mmc_retune_release(host);
+
+	return ret;
+}
+
+static int mmc_test_bench_cmp(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void mmc_test_bench_point(struct mmc_test_card *test,
+				 struct mmc_test_bench *b,
+				 struct mmc_test_bench_result *br)
+{
+	struct mmc_test_area *t = &test->area;
+	struct timespec64 ts1, ts2;
+	unsigned int i;
+	int ret = 0;
+
+	if (br->size > t->max_tfr || !br->depth) {
+		br->result = RESULT_UNSUP_HOST;
+		return;
+	}
+
+	for (i = 0; i < br->depth; i++) {
+		ret = mmc_test_map_sg(t->mem, br->size, b->reqs[i].sg, 1,
+				      t->max_segs, t->max_seg_sz,
+				      &b->reqs[i].sg_len, 0);
+		if (ret) {
+			br->result = RESULT_UNSUP_HOST;
+			return;
+		}
+	}
+
+	b->nr_lat = 0;
+
+	ktime_get_ts64(&ts1);
+	switch (br->mode) {
+	case MMC_TEST_BENCH_SYNC:
+		ret = mmc_test_bench_sync(test, b, br);
+		break;
+	case MMC_TEST_BENCH_ASYNC:
+		ret = mmc_test_bench_async(test, b, br);
+		break;
+	case MMC_TEST_BENCH_CQE:
+		ret = mmc_test_bench_cqe(test, b, br);
+		break;
+	}
+	ktime_get_ts64(&ts2);
+
+	br->result = ret;
+	if (ret == -EINVAL)
+		br->result = RESULT_UNSUP_HOST;
+	if (ret)
+		return;
+
+	br->ts = timespec64_sub(ts2, ts1);
+	br->rate = mmc_test_rate((u64)br->size * br->count, &br->ts);
+	br->iops = mmc_test_rate(br->count * 100, &br->ts);
+
+	sort(b->lat, b->nr_lat, sizeof(*b->lat), mmc_test_bench_cmp, NULL);
+	for (i = 0; i < MMC_TEST_BENCH_LAT_NUM; i++)
+		br->lat[i] = b->lat[div_u64((u64)(b->nr_lat - 1) *
+					    mmc_test_bench_pm[i], 1000)];
+
+	pr_info("%s: Bench %s %s %s %u bytes: %u kB/s, %u.%02u IOPS, p50 %llu us, p99 %llu us\n",
+		mmc_hostname(test->card->host),
+		mmc_test_bench_modes[br->mode],
+		mmc_test_bench_patterns[br->random],
+		mmc_test_bench_dirs[br->write], br->size,
+		br->rate / 1000, br->iops / 100, br->iops % 100,
+		div_u64(br->lat[MMC_TEST_BENCH_LAT_P50], NSEC_PER_USEC),
+		div_u64(br->lat[MMC_TEST_BENCH_LAT_P99], NSEC_PER_USEC));
+}
+
+static int mmc_test_bench_alloc(struct mmc_test_card *test,
+				struct mmc_test_bench *b, unsigned int count,
+				unsigned int depth)
+{
+	unsigned int i;
+
+	b->nr_reqs = max(depth, 2U);
+	b->reqs = kcalloc(b->nr_reqs, sizeof(*b->reqs), GFP_KERNEL);
+	if (!b->reqs)
+		return -ENOMEM;
+
+	for (i = 0; i < b->nr_reqs; i++) {
+		b->reqs[i].sg = kmalloc_array(test->area.max_segs,
+					      sizeof(*b->reqs[i].sg),
+					      GFP_KERNEL);
+		if (!b->reqs[i].sg)
+			return -ENOMEM;
+	}
+
+	b->lat = kvmalloc_array(count, sizeof(*b->lat), GFP_KERNEL);
+	if (!b->lat)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void mmc_test_bench_free(struct mmc_test_bench *b)
+{
+	unsigned int i;
+
+	kvfree(b->lat);
+	for (i = 0; b->reqs && i < b->nr_reqs; i++)
+		kfree(b->reqs[i].sg);
+	kfree(b->reqs);
+}
+
+static int mmc_test_bench_points(struct mmc_test_card *test,
+				 struct mmc_test_bench *b,
+				 struct mmc_test_bench_cfg *cfg,
+				 enum mmc_test_bench_mode mode,
+				 unsigned int cqe_depth)
+{
+	struct mmc_test_bench_result *br;
+	unsigned int pattern, dir, i;
+
+	for_each_set_bit(pattern, &cfg->patterns,
+			 ARRAY_SIZE(mmc_test_bench_patterns)) {
+		for_each_set_bit(dir, &cfg->dirs,
+				 ARRAY_SIZE(mmc_test_bench_dirs)) {
+			for (i = 0; i < cfg->nr_sizes; i++) {
+				br = kzalloc(sizeof(*br), GFP_KERNEL);
+				if (!br)
+					return -ENOMEM;
+
+				br->card = test->card;
+				br->size = cfg->sizes[i];
+				br->mode = mode;
+				br->random = pattern;
+				br->write = dir;
+				br->count = cfg->count;
+				if (mode == MMC_TEST_BENCH_CQE)
+					br->depth = cqe_depth;
+				else
+					br->depth = mode + 1;
+
+				mmc_test_bench_point(test, b, br);
+				list_add_tail(&br->link,
+					      &mmc_test_bench_lst);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int mmc_test_bench_run(struct mmc_test_card *test,
+			      struct mmc_test_bench_cfg *cfg)
+{
+	struct mmc_card *card = test->card;
+	unsigned int cqe_depth = mmc_test_bench_cqe_depth(test);
+	struct mmc_test_bench b = {};
+	unsigned int mode;
+	int ret;
+
+	pr_info("%s: Starting benchmark of card %s...\n",
+		mmc_hostname(card->host), mmc_card_id(card));
+
+	mmc_claim_host(card->host);
+
+	ret = mmc_test_area_init(test, 1, 1);
+	if (ret)
+		goto out_release;
+
+	ret = mmc_test_bench_alloc(test, &b, cfg->count, cqe_depth);
+	if (ret)
+		goto out_free;
+
+	/* Make random offsets repeatable from one run to the next */
+	rnd_next = 1;
+
+	for (mode = 0; mode < ARRAY_SIZE(mmc_test_bench_modes); mode++) {
+		bool cqe = mode == MMC_TEST_BENCH_CQE && cqe_depth;
+
+		if (!(cfg->modes & BIT(mode)))
+			continue;
+
+		if (cqe) {
+			ret = mmc_test_cmdq_enable(card);
+			if (ret) {
+				pr_info("%s: Failed to enable command queue (%d)\n",
+					mmc_hostname(card->host), ret);
+				cqe = false;
+				cqe_depth = 0;
+			}
+		}
+
+		ret = mmc_test_bench_points(test, &b, cfg, mode,
+					    cqe ? cqe_depth : 0);
+
+		if (cqe)
+			mmc_test_cmdq_disable(card);
+		if (ret)
+			break;
+	}
+
+out_free:
+	mmc_test_bench_free(&b);
+	mmc_test_area_cleanup(test);
+out_release:
+	mmc_release_host(card->host);
+
+	pr_info("%s: Benchmark completed.\n", mmc_hostname(card->host));
+
+	return ret;
+}
+
+static int mtf_bench_show(struct seq_file *sf, void *data)
+{
+	struct mmc_card *card = sf->private;
+	struct mmc_test_bench_result *br;
+	int i;
+
+	mutex_lock(&mmc_test_lock);
+
+	list_for_each_entry(br, &mmc_test_bench_lst, link) {
+		if (br->card != card)
+			continue;
+
+		seq_printf(sf, "mode=%s pattern=%s dir=%s size=%u depth=%u count=%u result=%d",
+			   mmc_test_bench_modes[br->mode],
+			   mmc_test_bench_patterns[br->random],
+			   mmc_test_bench_dirs[br->write], br->size,
+			   br->depth, br->count, br->result);
+		if (br->result == RESULT_OK) {
+			seq_printf(sf, " time_ns=%llu rate=%u iops=%u.%02u",
+				   (u64)timespec64_to_ns(&br->ts), br->rate,
+				   br->iops / 100, br->iops % 100);
+			for (i = 0; i < MMC_TEST_BENCH_LAT_NUM; i++)
+				seq_printf(sf, " lat_%s_ns=%llu",
+					   mmc_test_bench_lat_names[i],
+					   br->lat[i]);
+		}
+		seq_putc(sf, '\n');
+	}
+
+	mutex_unlock(&mmc_test_lock);
+
+	return 0;
+}
+
+static int mtf_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtf_bench_show, inode->i_private);
+}
+
+static ssize_t mtf_bench_write(struct file *file, const char __user *buf,
+	size_t count, loff_t *pos)
+{
+	struct seq_file *sf = file->private_data;
+	struct mmc_card *card = sf->private;
+	struct mmc_test_bench_cfg cfg;
+	struct mmc_test_card *test;
+	char *kbuf;
+	int ret;
+
+	if (count >= PAGE_SIZE)
+		return -EINVAL;
+
+	kbuf = memdup_user_nul(buf, count);
+	if (IS_ERR(kbuf))
+		return PTR_ERR(kbuf);
+
+	ret = mmc_test_bench_parse(kbuf, &cfg);
+	kfree(kbuf);
+	if (ret)
+		return ret;
+
+	test = kzalloc(sizeof(*test), GFP_KERNEL);
+	if (!test)
+		return -ENOMEM;
+
+	/* Only keep the results of the last run */
+	mmc_test_free_bench_result(card);
+
+	test->card = card;
+
+	mutex_lock(&mmc_test_lock);
+	ret = mmc_test_bench_run(test, &cfg);
+	mutex_unlock(&mmc_test_lock);
+
+	kfree(test);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations mmc_test_fops_bench = {
+	.open		= mtf_bench_open,
+	.read		= seq_read,
+	.write		= mtf_bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void mmc_test_free_dbgfs_file(struct mmc_card *card)
 {
 	struct mmc_test_dbgfs_file *df, *dfs;
@@ -3206,6 +4012,11 @@ static int mmc_test_register_dbgfs_file(struct mmc_card *card)
 	if (ret)
 		goto err;
 
+	ret = __mmc_test_register_dbgfs_file(card, "bench", S_IWUSR | S_IRUGO,
+		&mmc_test_fops_bench);
+	if (ret)
+		goto err;
+
 err:
 	mutex_unlock(&mmc_test_lock);
 
@@ -3225,7 +4036,7 @@ static int mmc_test_probe(struct mmc_card *card)
 
 	if (card->ext_csd.cmdq_en) {
 		mmc_claim_host(card->host);
-		ret = mmc_cmdq_disable(card);
+		ret = mmc_test_cmdq_disable(card);
 		mmc_release_host(card->host);
 		if (ret)
 			return ret;
@@ -3240,10 +4051,11 @@ static void mmc_test_remove(struct mmc_card *card)
 {
 	if (card->reenable_cmdq) {
 		mmc_claim_host(card->host);
-		mmc_cmdq_enable(card);
+		mmc_test_cmdq_enable(card);
 		mmc_release_host(card->host);
 	}
 	mmc_test_free_result(card);
+	mmc_test_free_bench_result(card);
 	mmc_test_free_dbgfs_file(card);
 }
 
@@ -3264,6 +4076,7 @@ static void __exit mmc_test_exit(void)
 {
 	/* Clear stalled data if card is still plugged */
 	mmc_test_free_result(NULL);
+	mmc_test_free_bench_result(NULL);
 	mmc_test_free_dbgfs_file(NULL);
 
 	mmc_unregister_driver(&mmc_driver);
@@ -144,6 +144,13 @@
 
 #define MHZ 1000000
 
+/* Where the scatterlist of a request was DMA mapped, see data->host_cookie */
+enum bcm2835_sdhost_cookie {
+	COOKIE_UNMAPPED,
+	COOKIE_PRE_MAPPED,	/* mapped by bcm2835_sdhost_pre_req() */
+	COOKIE_MAPPED,		/* mapped by bcm2835_sdhost_request() */
+};
+
 
 struct bcm2835_host {
 	spinlock_t		lock;
@@ -531,6 +538,69 @@ static void bcm2835_sdhost_wait_transfer_complete(struct bcm2835_host *host)
 
 static void bcm2835_sdhost_finish_data(struct bcm2835_host *host);
 
+/* The block doesn't manage the FIFO DREQs properly for multi-block
+   transfers, so don't attempt to DMA the final few words.
+   Unfortunately this requires the final sg entry to be trimmed.
+   N.B. This code demands that the overspill is contained in
+   a single sg entry.
+*/
+static u32 bcm2835_sdhost_drain_len(struct mmc_data *data)
+{
+	if ((data->blocks > 1) && (data->flags & MMC_DATA_READ))
+		return min((u32)(FIFO_READ_THRESHOLD - 1) * 4,
+			   (u32)data->blocks * data->blksz);
+	return 0;
+}
+
+static int bcm2835_sdhost_map_dma(struct bcm2835_host *host,
+				  struct mmc_data *data, int cookie)
+{
+	struct dma_chan *dma_chan = host->dma_chan_rxtx;
+	struct scatterlist *sg;
+	u32 len;
+	int count;
+
+	if (data->host_cookie == COOKIE_PRE_MAPPED)
+		return data->sg_count;
+
+	len = bcm2835_sdhost_drain_len(data);
+	if (len) {
+		sg = sg_last(data->sg, data->sg_len);
+		BUG_ON(sg->length < len);
+		sg->length -= len;
+	}
+
+	count = dma_map_sg(dma_chan->device->dev, data->sg, data->sg_len,
+			   mmc_get_dma_dir(data));
+	if (!count) {
+		if (len)
+			sg->length += len;
+		return 0;
+	}
+
+	data->sg_count = count;
+	data->host_cookie = cookie;
+
+	return count;
+}
+
+static void bcm2835_sdhost_unmap_dma(struct bcm2835_host *host,
+				     struct mmc_data *data)
+{
+	struct dma_chan *dma_chan = host->dma_chan_rxtx;
+	u32 len;
+
+	dma_unmap_sg(dma_chan->device->dev, data->sg, data->sg_len,
+		     mmc_get_dma_dir(data));
+
+	/* Give the drained words back to the final sg entry */
+	len = bcm2835_sdhost_drain_len(data);
+	if (len)
+		sg_last(data->sg, data->sg_len)->length += len;
+
+	data->host_cookie = COOKIE_UNMAPPED;
+}
+
 static void bcm2835_sdhost_dma_complete(void *param)
 {
 	struct bcm2835_host *host = param;
@@ -543,9 +613,9 @@ static void bcm2835_sdhost_dma_complete(void *param)
 		  bcm2835_sdhost_read(host, SDEDM));
 
 	if (host->dma_chan) {
-		dma_unmap_sg(host->dma_chan->device->dev,
-			     data->sg, data->sg_len,
-			     host->dma_dir);
+		/* Unmap before the CPU drains the tail of the last sg */
+		if (data->host_cookie != COOKIE_UNMAPPED)
+			bcm2835_sdhost_unmap_dma(host, data);
 
 		host->dma_chan = NULL;
 	}
@@ -816,41 +886,22 @@ static void bcm2835_sdhost_prepare_dma(struct bcm2835_host *host,
 	BUG_ON(!dma_chan->device->dev);
 	BUG_ON(!data->sg);
 
-	/* The block doesn't manage the FIFO DREQs properly for multi-block
-	   transfers, so don't attempt to DMA the final few words.
-	   Unfortunately this requires the final sg entry to be trimmed.
-	   N.B. This code demands that the overspill is contained in
-	   a single sg entry.
-	*/
-
-	host->drain_words = 0;
-	if ((data->blocks > 1) && (dir_data == DMA_FROM_DEVICE)) {
-		struct scatterlist *sg;
-		u32 len;
-		int i;
-
-		len = min((u32)(FIFO_READ_THRESHOLD - 1) * 4,
-			  (u32)data->blocks * data->blksz);
-
-		for_each_sg(data->sg, sg, data->sg_len, i) {
-			if (sg_is_last(sg)) {
-				BUG_ON(sg->length < len);
-				sg->length -= len;
-				host->drain_page = sg_page(sg);
-				host->drain_offset = sg->offset + sg->length;
-			}
-		}
-		host->drain_words = len/4;
-	}
-
 	/* The parameters have already been validated, so this will not fail */
 	(void)dmaengine_slave_config(dma_chan,
 				     (dir_data == DMA_FROM_DEVICE) ?
 				     &host->dma_cfg_rx :
 				     &host->dma_cfg_tx);
 
-	len = dma_map_sg(dma_chan->device->dev, data->sg, data->sg_len,
-			 dir_data);
+	len = bcm2835_sdhost_map_dma(host, data, COOKIE_MAPPED);
+
+	host->drain_words = 0;
+	if (len > 0 && bcm2835_sdhost_drain_len(data)) {
+		struct scatterlist *sg = sg_last(data->sg, data->sg_len);
+
+		host->drain_page = sg_page(sg);
+		host->drain_offset = sg->offset + sg->length;
+		host->drain_words = bcm2835_sdhost_drain_len(data) / 4;
+	}
 
 	log_event("PRD2", len, 0);
 	if (len > 0)
@@ -859,6 +910,12 @@ static void bcm2835_sdhost_prepare_dma(struct bcm2835_host *host,
 					       DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
 	log_event("PRD3", desc, 0);
 
+	/* Fall back to PIO, which needs the CPU to own the whole buffer */
+	if (!desc && data->host_cookie != COOKIE_UNMAPPED) {
+		bcm2835_sdhost_unmap_dma(host, data);
+		host->drain_words = 0;
+	}
+
 	if (desc) {
 		desc->callback = bcm2835_sdhost_dma_complete;
 		desc->callback_param = host;
@@ -1783,8 +1840,39 @@ static void bcm2835_sdhost_set_ios(struct mmc_host *mmc, struct mmc_ios *ios)
 		bcm2835_sdhost_set_clock(host, ios->clock);
 }
 
+/*
+ * Map the next request's buffers while the current one is still on the
+ * bus, the mapping (and cache maintenance) then drops out of the gap
+ * between two requests.
+ */
+static void bcm2835_sdhost_pre_req(struct mmc_host *mmc,
+				   struct mmc_request *mrq)
+{
+	struct bcm2835_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (!data)
+		return;
+
+	data->host_cookie = COOKIE_UNMAPPED;
+	if (host->use_dma && (data->blocks > host->pio_limit))
+		bcm2835_sdhost_map_dma(host, data, COOKIE_PRE_MAPPED);
+}
+
+static void bcm2835_sdhost_post_req(struct mmc_host *mmc,
+				    struct mmc_request *mrq, int err)
+{
+	struct bcm2835_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+
+	if (data && data->host_cookie != COOKIE_UNMAPPED)
+		bcm2835_sdhost_unmap_dma(host, data);
+}
+
 static struct mmc_host_ops bcm2835_sdhost_ops = {
 	.request = bcm2835_sdhost_request,
+	.pre_req = bcm2835_sdhost_pre_req,
+	.post_req = bcm2835_sdhost_post_req,
 	.set_ios = bcm2835_sdhost_set_ios,
 // todo:fix	.hw_reset = bcm2835_sdhost_reset,
 };
@@ -1875,6 +1963,8 @@ static void bcm2835_sdhost_tasklet_finish(unsigned long param)
 		if (err)
 			pr_err("%s: failed to terminate DMA (%d)\n",
 			       mmc_hostname(host->mmc), err);
+		if (mrq->data && mrq->data->host_cookie != COOKIE_UNMAPPED)
+			bcm2835_sdhost_unmap_dma(host, mrq->data);
 	}
 
 	/* The SDHOST block doesn't report any errors for a disconnected
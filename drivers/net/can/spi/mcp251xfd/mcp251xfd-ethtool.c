@@ -71,6 +71,7 @@ static int mcp251xfd_ring_get_coalesce(struct net_device *ndev,
 
 	ec->rx_max_coalesced_frames_irq = rx_max_frames;
 	ec->rx_coalesce_usecs_irq = priv->rx_coalesce_usecs_irq;
+	ec->use_adaptive_rx_coalesce = priv->rx_coalesce_adaptive;
 
 	if (priv->tx_obj_num_coalesce_irq == 0)
 		tx_max_frames = 1;
@@ -96,10 +97,18 @@ static int mcp251xfd_ring_set_coalesce(struct net_device *ndev,
 	};
 	struct can_ram_layout layout;
 
+	/* The adaptive delay is bounded by, and needs, the usecs setting */
+	if (ec->use_adaptive_rx_coalesce && !ec->rx_coalesce_usecs_irq) {
+		NL_SET_ERR_MSG(ext_ack,
+			       "adaptive RX coalescing needs rx-usecs-irq as upper bound");
+		return -EINVAL;
+	}
+
 	can_ram_get_layout(&layout, &mcp251xfd_ram_config, &ring, ec, fd_mode);
 
 	if ((layout.rx_coalesce != priv->rx_obj_num_coalesce_irq ||
 	     ec->rx_coalesce_usecs_irq != priv->rx_coalesce_usecs_irq ||
+	     !!ec->use_adaptive_rx_coalesce != priv->rx_coalesce_adaptive ||
 	     layout.tx_coalesce != priv->tx_obj_num_coalesce_irq ||
 	     ec->tx_coalesce_usecs_irq != priv->tx_coalesce_usecs_irq) &&
 	    netif_running(ndev))
@@ -108,6 +117,8 @@ static int mcp251xfd_ring_set_coalesce(struct net_device *ndev,
 	priv->rx_obj_num = layout.cur_rx;
 	priv->rx_obj_num_coalesce_irq = layout.rx_coalesce;
 	priv->rx_coalesce_usecs_irq = ec->rx_coalesce_usecs_irq;
+	priv->rx_coalesce_adaptive = ec->use_adaptive_rx_coalesce;
+	priv->rx_coalesce_usecs_cur = ec->rx_coalesce_usecs_irq;
 
 	priv->tx->obj_num = layout.cur_tx;
 	priv->tx_obj_num_coalesce_irq = layout.tx_coalesce;
@@ -116,15 +127,66 @@ static int mcp251xfd_ring_set_coalesce(struct net_device *ndev,
 	return 0;
 }
 
+static const char mcp251xfd_stats_strings[][ETH_GSTRING_LEN] = {
+	"rx_irq_handled",
+	"rx_bulk_reads",
+	"rx_objs",
+	"rx_coalesce_usecs_cur",
+};
+
+static int mcp251xfd_get_sset_count(struct net_device *ndev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(mcp251xfd_stats_strings);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void mcp251xfd_get_strings(struct net_device *ndev, u32 sset, u8 *data)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		memcpy(data, mcp251xfd_stats_strings,
+		       sizeof(mcp251xfd_stats_strings));
+		break;
+	}
+}
+
+/* rx_objs / rx_bulk_reads gives the objects fetched per SPI read,
+ * rx_objs / rx_irq_handled the objects handled per interrupt.
+ */
+static void mcp251xfd_get_ethtool_stats(struct net_device *ndev,
+					struct ethtool_stats *stats, u64 *data)
+{
+	const struct mcp251xfd_priv *priv = netdev_priv(ndev);
+	const struct mcp251xfd_rx_stats *rx_stats = &priv->rx_stats;
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&rx_stats->syncp);
+		data[0] = u64_stats_read(&rx_stats->handled);
+		data[1] = u64_stats_read(&rx_stats->reads);
+		data[2] = u64_stats_read(&rx_stats->objs);
+	} while (u64_stats_fetch_retry(&rx_stats->syncp, start));
+
+	data[3] = READ_ONCE(priv->rx_coalesce_usecs_cur);
+}
+
 static const struct ethtool_ops mcp251xfd_ethtool_ops = {
 	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS_IRQ |
 		ETHTOOL_COALESCE_RX_MAX_FRAMES_IRQ |
+		ETHTOOL_COALESCE_USE_ADAPTIVE_RX |
 		ETHTOOL_COALESCE_TX_USECS_IRQ |
 		ETHTOOL_COALESCE_TX_MAX_FRAMES_IRQ,
 	.get_ringparam = mcp251xfd_ring_get_ringparam,
 	.set_ringparam = mcp251xfd_ring_set_ringparam,
 	.get_coalesce = mcp251xfd_ring_get_coalesce,
 	.set_coalesce = mcp251xfd_ring_set_coalesce,
+	.get_sset_count = mcp251xfd_get_sset_count,
+	.get_strings = mcp251xfd_get_strings,
+	.get_ethtool_stats = mcp251xfd_get_ethtool_stats,
 	.get_ts_info = can_ethtool_op_get_ts_info_hwts,
 };
 
@@ -142,4 +204,8 @@ void mcp251xfd_ethtool_init(struct mcp251xfd_priv *priv)
 	priv->tx_obj_num_coalesce_irq = 0;
 	priv->rx_coalesce_usecs_irq = 0;
 	priv->tx_coalesce_usecs_irq = 0;
+	priv->rx_coalesce_adaptive = false;
+	priv->rx_coalesce_usecs_cur = 0;
+
+	u64_stats_init(&priv->rx_stats.syncp);
 }
@@ -199,7 +199,8 @@ mcp251xfd_rx_obj_read(const struct mcp251xfd_priv *priv,
 
 static int
 mcp251xfd_handle_rxif_ring(struct mcp251xfd_priv *priv,
-			   struct mcp251xfd_rx_ring *ring)
+			   struct mcp251xfd_rx_ring *ring,
+			   unsigned int *objs)
 {
 	struct mcp251xfd_hw_rx_obj_canfd *hw_rx_obj = ring->obj;
 	u8 rx_tail, len;
@@ -219,6 +220,12 @@ mcp251xfd_handle_rxif_ring(struct mcp251xfd_priv *priv,
 		if (err)
 			return err;
 
+		u64_stats_update_begin(&priv->rx_stats.syncp);
+		u64_stats_inc(&priv->rx_stats.reads);
+		u64_stats_add(&priv->rx_stats.objs, len);
+		u64_stats_update_end(&priv->rx_stats.syncp);
+		*objs += len;
+
 		for (i = 0; i < len; i++) {
 			err = mcp251xfd_handle_rxif_one(priv, ring,
 							(void *)hw_rx_obj +
@@ -248,9 +255,46 @@ mcp251xfd_handle_rxif_ring(struct mcp251xfd_priv *priv,
 	return 0;
 }
 
+/* Pick the delay before the RX FIFO not empty interrupt is re-enabled.
+ *
+ * With adaptive coalescing the delay follows the observed frame rate:
+ * it is chosen so that about as many objects as the coalescing FIFO
+ * holds arrive during it, bounded by rx_coalesce_usecs_irq. If only a
+ * single object came in since the last run, the bus is quiet and
+ * coalescing would only add latency, so the interrupt is re-enabled
+ * right away.
+ */
+static u32
+mcp251xfd_rx_coalesce_usecs(struct mcp251xfd_priv *priv, unsigned int objs)
+{
+	ktime_t now;
+	u64 elapsed;
+	u32 target;
+
+	if (!priv->rx_coalesce_adaptive)
+		return priv->rx_coalesce_usecs_irq;
+
+	now = ktime_get();
+	elapsed = ktime_us_delta(now, priv->rx_coalesce_last);
+	priv->rx_coalesce_last = now;
+
+	if (objs <= 1) {
+		priv->rx_coalesce_usecs_cur = 0;
+	} else {
+		target = priv->rx_obj_num_coalesce_irq ? :
+			priv->rx[0]->obj_num / 2;
+		priv->rx_coalesce_usecs_cur =
+			min_t(u64, div_u64(elapsed * target, objs),
+			      priv->rx_coalesce_usecs_irq);
+	}
+
+	return priv->rx_coalesce_usecs_cur;
+}
+
 int mcp251xfd_handle_rxif(struct mcp251xfd_priv *priv)
 {
 	struct mcp251xfd_rx_ring *ring;
+	unsigned int objs = 0;
 	int err, n;
 
 	mcp251xfd_for_each_rx_ring(priv, ring, n) {
@@ -261,14 +305,18 @@ int mcp251xfd_handle_rxif(struct mcp251xfd_priv *priv)
 		    !(priv->regs_status.rxif & BIT(ring->fifo_nr)))
 			continue;
 
-		err = mcp251xfd_handle_rxif_ring(priv, ring);
+		err = mcp251xfd_handle_rxif_ring(priv, ring, &objs);
 		if (err)
 			return err;
 	}
 
+	u64_stats_update_begin(&priv->rx_stats.syncp);
+	u64_stats_inc(&priv->rx_stats.handled);
+	u64_stats_update_end(&priv->rx_stats.syncp);
+
 	if (priv->rx_coalesce_usecs_irq)
 		hrtimer_start(&priv->rx_irq_timer,
-			      ns_to_ktime(priv->rx_coalesce_usecs_irq *
+			      ns_to_ktime(mcp251xfd_rx_coalesce_usecs(priv, objs) *
 					  NSEC_PER_USEC),
 			      HRTIMER_MODE_REL);
 
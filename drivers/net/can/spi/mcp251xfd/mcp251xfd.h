@@ -21,6 +21,7 @@
 #include <linux/regulator/consumer.h>
 #include <linux/spi/spi.h>
 #include <linux/timecounter.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* MPC251x registers */
@@ -608,6 +609,13 @@ enum mcp251xfd_flags {
 	__MCP251XFD_FLAGS_SIZE__
 };
 
+struct mcp251xfd_rx_stats {
+	u64_stats_t handled;	/* RX interrupts serviced */
+	u64_stats_t reads;	/* bulk RX object reads */
+	u64_stats_t objs;	/* RX objects read */
+	struct u64_stats_sync syncp;
+};
+
 struct mcp251xfd_priv {
 	struct can_priv can;
 	struct can_rx_offload offload;
@@ -645,6 +653,13 @@ struct mcp251xfd_priv {
 	struct hrtimer rx_irq_timer;
 	struct hrtimer tx_irq_timer;
 
+	/* adaptive RX IRQ coalescing, rx_coalesce_usecs_irq is the limit */
+	bool rx_coalesce_adaptive;
+	u32 rx_coalesce_usecs_cur;
+	ktime_t rx_coalesce_last;
+
+	struct mcp251xfd_rx_stats rx_stats;
+
 	struct mcp251xfd_ecc ecc;
 	struct mcp251xfd_regs_status regs_status;
 
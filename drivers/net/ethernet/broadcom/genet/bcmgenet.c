@@ -36,6 +36,9 @@
 #include <linux/ipv6.h>
 #include <linux/phy.h>
 #include <linux/platform_data/bcmgenet.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <net/page_pool/helpers.h>
 
 #include <asm/unaligned.h>
 
@@ -53,7 +56,21 @@
 	(TOTAL_DESC - priv->hw_params->tx_queues * priv->hw_params->tx_bds_per_q)
 
 #define RX_BUF_LENGTH		2048
-#define SKB_ALIGNMENT		32
+
+/* Flow spreading filters live above the ethtool rxnfc locations, one per
+ * value of the low nibble of the L4 source port for each of TCP and UDP.
+ */
+#define GENET_HFB_SPREAD_BASE	MAX_NUM_OF_FS_RULES
+#define GENET_HFB_SPREAD_CNT	32
+
+/* Rx buffers are page pool pages with XDP headroom in front of the RSB */
+#define GENET_RX_HEADROOM	XDP_PACKET_HEADROOM
+
+/* 64B Receive Status Block plus 2 bytes the hardware adds for IP alignment */
+#define GENET_RSB_PAD		(sizeof(struct status_64) + 2)
+
+#define GENET_XDP_TX		BIT(0)
+#define GENET_XDP_REDIRECT	BIT(1)
 
 /* Tx/Rx DMA register offset, skip 256 descriptors */
 #define WORDS_PER_BD(p)		(p->hw_params->words_per_bd)
@@ -73,6 +90,9 @@ MODULE_PARM_DESC(skip_umac_reset, "Skip UMAC reset step");
 static bool eee = true;
 module_param(eee, bool, 0444);
 MODULE_PARM_DESC(eee, "Enable EEE (default Y)");
+static bool rx_spread;
+module_param(rx_spread, bool, 0444);
+MODULE_PARM_DESC(rx_spread, "Spread TCP/UDP flows across Rx priority rings (default N)");
 
 static inline void bcmgenet_writel(u32 value, void __iomem *offset)
 {
@@ -680,9 +700,9 @@ static void bcmgenet_hfb_create_rxnfc_filter(struct bcmgenet_priv *priv,
 		bcmgenet_hfb_set_filter_rx_queue_mapping(priv, f, 0);
 		rule->state = BCMGENET_RXNFC_STATE_DISABLED;
 	} else {
-		/* Other Rx rings are direct mapped here */
+		/* Other Rx queues map to the priority rings below them */
 		bcmgenet_hfb_set_filter_rx_queue_mapping(priv, f,
-							 fs->ring_cookie);
+							 fs->ring_cookie - 1);
 		bcmgenet_hfb_enable_filter(priv, f);
 		rule->state = BCMGENET_RXNFC_STATE_ENABLED;
 	}
@@ -723,6 +743,65 @@ static void bcmgenet_hfb_clear(struct bcmgenet_priv *priv)
 		bcmgenet_hfb_clear_filter(priv, i);
 }
 
+static bool bcmgenet_hfb_can_spread(struct bcmgenet_priv *priv)
+{
+	return rx_spread && priv->hw_params->rx_queues &&
+	       priv->hw_params->hfb_filter_size >= 128 &&
+	       priv->hw_params->hfb_filter_cnt >=
+	       GENET_HFB_SPREAD_BASE + GENET_HFB_SPREAD_CNT;
+}
+
+/* bcmgenet_hfb_spread_flows
+ *
+ * Hash-like distribution of IPv4 TCP and UDP traffic over the Rx priority
+ * rings, keyed on the low nibble of the source port so that every packet of
+ * a flow lands on the same ring. Everything else, including IPv4 headers
+ * with options and VLAN tagged frames, stays on the default ring.
+ */
+static void bcmgenet_hfb_spread_flows(struct bcmgenet_priv *priv)
+{
+	static const u8 protos[] = { IPPROTO_TCP, IPPROTO_UDP };
+	u32 rings = priv->hw_params->rx_queues;
+	u32 f, i, p;
+	__be16 val_16;
+	u16 mask_16;
+	u8 val_8, mask_8;
+
+	if (!bcmgenet_hfb_can_spread(priv))
+		return;
+
+	for (p = 0; p < ARRAY_SIZE(protos); p++) {
+		for (i = 0; i < 16; i++) {
+			f = GENET_HFB_SPREAD_BASE + p * 16 + i;
+			bcmgenet_hfb_clear_filter(priv, f);
+
+			val_16 = htons(ETH_P_IP);
+			mask_16 = 0xFFFF;
+			bcmgenet_hfb_insert_data(priv, f, 2 * ETH_ALEN,
+						 &val_16, &mask_16,
+						 sizeof(val_16));
+			/* Only a 20 byte IPv4 header puts the ports here */
+			val_8 = 0x45;
+			mask_8 = 0xFF;
+			bcmgenet_hfb_insert_data(priv, f, ETH_HLEN,
+						 &val_8, &mask_8, sizeof(val_8));
+			val_8 = protos[p];
+			bcmgenet_hfb_insert_data(priv, f, ETH_HLEN + 9,
+						 &val_8, &mask_8, sizeof(val_8));
+			val_8 = i;
+			mask_8 = 0x0F;
+			bcmgenet_hfb_insert_data(priv, f, ETH_HLEN + 21,
+						 &val_8, &mask_8, sizeof(val_8));
+
+			bcmgenet_hfb_set_filter_length(priv, f,
+						       ETH_HLEN + 20 + 2);
+			bcmgenet_hfb_set_filter_rx_queue_mapping(priv, f,
+								 i % rings);
+			bcmgenet_hfb_enable_filter(priv, f);
+		}
+	}
+}
+
 static void bcmgenet_hfb_init(struct bcmgenet_priv *priv)
 {
 	int i;
@@ -737,6 +816,7 @@ static void bcmgenet_hfb_init(struct bcmgenet_priv *priv)
 	}
 
 	bcmgenet_hfb_clear(priv);
+	bcmgenet_hfb_spread_flows(priv);
 }
 
 static int bcmgenet_begin(struct net_device *dev)
@@ -825,8 +905,7 @@ static int bcmgenet_get_coalesce(struct net_device *dev,
 	unsigned int i;
 
 	ec->tx_max_coalesced_frames =
-		bcmgenet_tdma_ring_readl(priv, DESC_INDEX,
-					 DMA_MBUF_DONE_THRESH);
+		priv->tx_rings[DESC_INDEX].tx_max_coalesced_frames;
 	ec->rx_max_coalesced_frames =
 		bcmgenet_rdma_ring_readl(priv, DESC_INDEX,
 					 DMA_MBUF_DONE_THRESH);
@@ -870,7 +949,8 @@ static void bcmgenet_set_ring_rx_coalesce(struct bcmgenet_rx_ring *ring,
 	pkts = ring->rx_max_coalesced_frames;
 
 	if (ec->use_adaptive_rx_coalesce && !ring->dim.use_dim) {
-		moder = net_dim_get_def_rx_moderation(ring->dim.dim.mode);
+		moder = net_dim_get_def_rx_moderation_set(ring->dim.dim.profile_set,
+							  ring->dim.dim.mode);
 		usecs = moder.usec;
 		pkts = moder.pkts;
 	}
@@ -879,6 +959,14 @@ static void bcmgenet_set_ring_rx_coalesce(struct bcmgenet_rx_ring *ring,
 	bcmgenet_set_rx_coalesce(ring, usecs, pkts);
 }
 
+/* The threshold is kept in the ring so that it survives a down/up cycle */
+static void bcmgenet_set_tx_coalesce(struct bcmgenet_priv *priv,
+				     unsigned int index, u32 pkts)
+{
+	priv->tx_rings[index].tx_max_coalesced_frames = pkts;
+	bcmgenet_tdma_ring_writel(priv, index, pkts, DMA_MBUF_DONE_THRESH);
+}
+
 static int bcmgenet_set_coalesce(struct net_device *dev,
 				 struct ethtool_coalesce *ec,
 				 struct kernel_ethtool_coalesce *kernel_coal,
@@ -909,12 +997,10 @@ static int bcmgenet_set_coalesce(struct net_device *dev,
 	 * ethtool knob to do coalescing on a per-queue basis
 	 */
 	for (i = 0; i < priv->hw_params->tx_queues; i++)
-		bcmgenet_tdma_ring_writel(priv, i,
-					  ec->tx_max_coalesced_frames,
-					  DMA_MBUF_DONE_THRESH);
-	bcmgenet_tdma_ring_writel(priv, DESC_INDEX,
-				  ec->tx_max_coalesced_frames,
-				  DMA_MBUF_DONE_THRESH);
+		bcmgenet_set_tx_coalesce(priv, i,
+					 ec->tx_max_coalesced_frames);
+	bcmgenet_set_tx_coalesce(priv, DESC_INDEX,
+				 ec->tx_max_coalesced_frames);
 
 	for (i = 0; i < priv->hw_params->rx_queues; i++)
 		bcmgenet_set_ring_rx_coalesce(&priv->rx_rings[i], ec);
@@ -1121,6 +1207,10 @@ static const struct bcmgenet_stats bcmgenet_gstrings_stats[] = {
 	STAT_GENET_SOFT_MIB("tx_realloc_tsb", mib.tx_realloc_tsb),
 	STAT_GENET_SOFT_MIB("tx_realloc_tsb_failed",
 			    mib.tx_realloc_tsb_failed),
+	STAT_GENET_SOFT_MIB("rx_xdp_drop", mib.rx_xdp_drop),
+	STAT_GENET_SOFT_MIB("rx_xdp_tx", mib.rx_xdp_tx),
+	STAT_GENET_SOFT_MIB("rx_xdp_redirect", mib.rx_xdp_redirect),
+	STAT_GENET_SOFT_MIB("xdp_tx_err", mib.xdp_tx_err),
 	/* Per TX queues */
 	STAT_GENET_Q(0),
 	STAT_GENET_Q(1),
@@ -1854,22 +1944,34 @@ static struct sk_buff *bcmgenet_free_tx_cb(struct device *dev,
 	return NULL;
 }
 
-/* Simple helper to free a receive control block's resources */
-static struct sk_buff *bcmgenet_free_rx_cb(struct device *dev,
-					   struct enet_cb *cb)
+/* Simple helper to free a transmit control block carrying an XDP frame.
+ * Frames sent back out of our own Rx page pool (XDP_TX) were not mapped
+ * here, so there is nothing to unmap for them.
+ */
+static void bcmgenet_free_tx_xdpf(struct device *dev, struct enet_cb *cb)
 {
-	struct sk_buff *skb;
-
-	skb = cb->skb;
-	cb->skb = NULL;
-
 	if (dma_unmap_addr(cb, dma_addr)) {
 		dma_unmap_single(dev, dma_unmap_addr(cb, dma_addr),
-				 dma_unmap_len(cb, dma_len), DMA_FROM_DEVICE);
+				 dma_unmap_len(cb, dma_len), DMA_TO_DEVICE);
 		dma_unmap_addr_set(cb, dma_addr, 0);
 	}
 
-	return skb;
+	xdp_return_frame(cb->xdpf);
+	cb->xdpf = NULL;
+}
+
+/* Simple helper to take the page off a receive control block. The page
+ * stays DMA mapped by its page pool.
+ */
+static struct page *bcmgenet_free_rx_cb(struct enet_cb *cb)
+{
+	struct page *page;
+
+	page = cb->rx_page;
+	cb->rx_page = NULL;
+	dma_unmap_addr_set(cb, dma_addr, 0);
+
+	return page;
 }
 
 /* Unlocked version of the reclaim routine */
@@ -1903,14 +2005,24 @@ static unsigned int __bcmgenet_tx_reclaim(struct net_device *dev,
 
 	/* Reclaim transmitted buffers */
 	while (txbds_processed < txbds_ready) {
-		skb = bcmgenet_free_tx_cb(&priv->pdev->dev,
-					  &priv->tx_cbs[ring->clean_ptr]);
+		struct enet_cb *tx_cb_ptr = &priv->tx_cbs[ring->clean_ptr];
+
+		if (tx_cb_ptr->xdpf) {
+			/* XDP frames bypass BQL, only count them in the ring */
+			ring->packets++;
+			ring->bytes += tx_cb_ptr->xdpf->len;
+			bcmgenet_free_tx_xdpf(&priv->pdev->dev, tx_cb_ptr);
+			goto next;
+		}
+
+		skb = bcmgenet_free_tx_cb(&priv->pdev->dev, tx_cb_ptr);
 		if (skb) {
 			pkts_compl++;
 			bytes_compl += GENET_CB(skb)->bytes_sent;
 			dev_consume_skb_any(skb);
 		}
 
+next:
 		txbds_processed++;
 		if (likely(ring->clean_ptr < ring->end_ptr))
 			ring->clean_ptr++;
@@ -2166,11 +2278,14 @@ static netdev_tx_t bcmgenet_xmit(struct sk_buff *skb, struct net_device *dev)
 	if (ring->free_bds <= (MAX_SKB_FRAGS + 1))
 		netif_tx_stop_queue(txq);
 
+out:
+	/* Packets are ready, update producer index once per batch. This is
+	 * also done when this skb was not queued, so that earlier packets of
+	 * the batch are not left sitting in the ring.
+	 */
 	if (!netdev_xmit_more() || netif_xmit_stopped(txq))
-		/* Packets are ready, update producer index */
 		bcmgenet_tdma_ring_writel(priv, ring->index,
 					  ring->prod_index, TDMA_PROD_INDEX);
-out:
 	spin_unlock(&ring->lock);
 
 	return ret;
@@ -2189,46 +2304,199 @@ static netdev_tx_t bcmgenet_xmit(struct sk_buff *skb, struct net_device *dev)
 	goto out;
 }
 
-static struct sk_buff *bcmgenet_rx_refill(struct bcmgenet_priv *priv,
-					  struct enet_cb *cb)
+/* Queue one XDP frame on the default Tx ring, called with ring->lock held.
+ * The frame must have room in front of it for the 64B Transmit Status
+ * Block. Frames from our own Rx page pool (XDP_TX) are already mapped,
+ * anything redirected to us from elsewhere is mapped here.
+ */
+static bool bcmgenet_xdp_xmit_frame(struct bcmgenet_priv *priv,
+				    struct bcmgenet_tx_ring *ring,
+				    struct xdp_frame *xdpf, bool dma_map)
 {
 	struct device *kdev = &priv->pdev->dev;
-	struct sk_buff *skb;
-	struct sk_buff *rx_skb;
+	struct enet_cb *tx_cb_ptr;
+	struct status_64 *status;
+	unsigned int size;
 	dma_addr_t mapping;
+	u32 len_stat;
 
-	/* Allocate a new Rx skb */
-	skb = __netdev_alloc_skb(priv->dev, priv->rx_buf_len + SKB_ALIGNMENT,
-				 GFP_ATOMIC | __GFP_NOWARN);
-	if (!skb) {
-		priv->mib.alloc_rx_buff_failed++;
-		netif_err(priv, rx_err, priv->dev,
-			  "%s: Rx skb allocation failed\n", __func__);
-		return NULL;
+	/* Leave room for the stack to queue a maximally fragmented skb */
+	if (ring->free_bds <= (MAX_SKB_FRAGS + 1))
+		return false;
+
+	if (xdpf->headroom < sizeof(*status))
+		return false;
+
+	status = xdpf->data - sizeof(*status);
+	memset(status, 0, sizeof(*status));
+	size = xdpf->len + sizeof(*status);
+
+	if (dma_map) {
+		mapping = dma_map_single(kdev, status, size, DMA_TO_DEVICE);
+		if (dma_mapping_error(kdev, mapping)) {
+			priv->mib.tx_dma_failed++;
+			return false;
+		}
+	} else {
+		struct page *page = virt_to_page(xdpf->data);
+
+		mapping = page_pool_get_dma_addr(page) +
+			  ((void *)status - page_address(page));
+		dma_sync_single_for_device(kdev, mapping, size,
+					   DMA_BIDIRECTIONAL);
 	}
 
-	/* DMA-map the new Rx skb */
-	mapping = dma_map_single(kdev, skb->data, priv->rx_buf_len,
-				 DMA_FROM_DEVICE);
-	if (dma_mapping_error(kdev, mapping)) {
-		priv->mib.rx_dma_failed++;
-		dev_kfree_skb_any(skb);
-		netif_err(priv, rx_err, priv->dev,
-			  "%s: Rx skb DMA mapping failed\n", __func__);
-		return NULL;
+	tx_cb_ptr = bcmgenet_get_txcb(priv, ring);
+	dma_unmap_addr_set(tx_cb_ptr, dma_addr, dma_map ? mapping : 0);
+	dma_unmap_len_set(tx_cb_ptr, dma_len, size);
+	tx_cb_ptr->xdpf = xdpf;
+
+	len_stat = (size << DMA_BUFLENGTH_SHIFT) |
+		   (priv->hw_params->qtag_mask << DMA_TX_QTAG_SHIFT) |
+		   DMA_TX_APPEND_CRC | DMA_SOP | DMA_EOP;
+	dmadesc_set(priv, tx_cb_ptr->bd_addr, mapping, len_stat);
+
+	ring->free_bds--;
+	ring->prod_index++;
+	ring->prod_index &= DMA_P_INDEX_MASK;
+
+	return true;
+}
+
+static void bcmgenet_xdp_xmit_flush(struct bcmgenet_priv *priv,
+				    struct bcmgenet_tx_ring *ring)
+{
+	bcmgenet_tdma_ring_writel(priv, ring->index, ring->prod_index,
+				  TDMA_PROD_INDEX);
+}
+
+static int bcmgenet_xdp_xmit(struct net_device *dev, int n,
+			     struct xdp_frame **frames, u32 flags)
+{
+	struct bcmgenet_priv *priv = netdev_priv(dev);
+	struct bcmgenet_tx_ring *ring = &priv->tx_rings[DESC_INDEX];
+	int nxmit;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	if (unlikely(!netif_running(dev) || !netif_carrier_ok(dev)))
+		return -ENETDOWN;
+
+	spin_lock(&ring->lock);
+
+	for (nxmit = 0; nxmit < n; nxmit++) {
+		if (!bcmgenet_xdp_xmit_frame(priv, ring, frames[nxmit], true))
+			break;
+	}
+
+	if (flags & XDP_XMIT_FLUSH)
+		bcmgenet_xdp_xmit_flush(priv, ring);
+
+	spin_unlock(&ring->lock);
+
+	if (nxmit < n)
+		priv->mib.xdp_tx_err += n - nxmit;
+
+	return nxmit;
+}
+
+static bool bcmgenet_xdp_xmit_back(struct bcmgenet_priv *priv,
+				   struct xdp_buff *xdp)
+{
+	struct bcmgenet_tx_ring *ring = &priv->tx_rings[DESC_INDEX];
+	struct xdp_frame *xdpf = xdp_convert_buff_to_frame(xdp);
+	bool xmit;
+
+	if (unlikely(!xdpf))
+		return false;
+
+	spin_lock(&ring->lock);
+	xmit = bcmgenet_xdp_xmit_frame(priv, ring, xdpf, false);
+	spin_unlock(&ring->lock);
+
+	return xmit;
+}
+
+/* Returns true if the XDP program consumed the buffer, in which case the
+ * page is no longer ours.
+ */
+static bool bcmgenet_run_xdp(struct bcmgenet_rx_ring *ring,
+			     struct bpf_prog *prog, struct xdp_buff *xdp,
+			     struct page *page, unsigned int *xdp_status)
+{
+	struct bcmgenet_priv *priv = ring->priv;
+	u32 act;
+
+	act = bpf_prog_run_xdp(prog, xdp);
+	switch (act) {
+	case XDP_PASS:
+		return false;
+	case XDP_TX:
+		if (unlikely(!bcmgenet_xdp_xmit_back(priv, xdp)))
+			goto out_failure;
+		priv->mib.rx_xdp_tx++;
+		*xdp_status |= GENET_XDP_TX;
+		return true;
+	case XDP_REDIRECT:
+		if (unlikely(xdp_do_redirect(priv->dev, xdp, prog) < 0))
+			goto out_failure;
+		priv->mib.rx_xdp_redirect++;
+		*xdp_status |= GENET_XDP_REDIRECT;
+		return true;
+	default:
+		bpf_warn_invalid_xdp_action(priv->dev, prog, act);
+		fallthrough;
+	case XDP_ABORTED:
+out_failure:
+		trace_xdp_exception(priv->dev, prog, act);
+		priv->mib.xdp_tx_err++;
+		fallthrough;
+	case XDP_DROP:
+		priv->mib.rx_xdp_drop++;
+		page_pool_recycle_direct(ring->page_pool, page);
+		return true;
 	}
+}
 
-	/* Grab the current Rx skb from the ring and DMA-unmap it */
-	rx_skb = bcmgenet_free_rx_cb(kdev, cb);
+/* Swap a fresh page pool page onto the ring and return the one that was
+ * there, ready for the CPU to look at.
+ */
+static struct page *bcmgenet_rx_refill(struct bcmgenet_rx_ring *ring,
+				       struct enet_cb *cb)
+{
+	struct bcmgenet_priv *priv = ring->priv;
+	struct device *kdev = &priv->pdev->dev;
+	struct page *page;
+	struct page *rx_page;
+	dma_addr_t mapping;
 
-	/* Put the new Rx skb on the ring */
-	cb->skb = skb;
+	/* Allocate a new Rx page, already DMA mapped by the pool */
+	page = page_pool_dev_alloc_pages(ring->page_pool);
+	if (!page) {
+		priv->mib.alloc_rx_buff_failed++;
+		netif_err(priv, rx_err, priv->dev,
+			  "%s: Rx page allocation failed\n", __func__);
+		return NULL;
+	}
+	mapping = page_pool_get_dma_addr(page) + GENET_RX_HEADROOM;
+
+	/* Grab the current Rx page from the ring and sync it for the CPU */
+	rx_page = bcmgenet_free_rx_cb(cb);
+	if (rx_page)
+		dma_sync_single_for_cpu(kdev,
+					page_pool_get_dma_addr(rx_page) +
+					GENET_RX_HEADROOM, priv->rx_buf_len,
+					page_pool_get_dma_dir(ring->page_pool));
+
+	/* Put the new Rx page on the ring */
+	cb->rx_page = page;
 	dma_unmap_addr_set(cb, dma_addr, mapping);
 	dma_unmap_len_set(cb, dma_len, priv->rx_buf_len);
 	dmadesc_set_addr(priv, cb->bd_addr, mapping);
 
-	/* Return the current Rx skb to caller */
-	return rx_skb;
+	/* Return the current Rx page to caller */
+	return rx_page;
 }
 
 /* bcmgenet_desc_rx - descriptor based rx process.
@@ -2239,8 +2507,11 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 {
 	struct bcmgenet_priv *priv = ring->priv;
 	struct net_device *dev = priv->dev;
+	unsigned int xdp_status = 0;
+	struct bpf_prog *xdp_prog;
 	struct enet_cb *cb;
 	struct sk_buff *skb;
+	struct page *page;
 	u32 dma_length_status;
 	unsigned long dma_flag;
 	int len;
@@ -2248,6 +2519,7 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 	unsigned int bytes_processed = 0;
 	unsigned int p_index, mask;
 	unsigned int discards;
+	struct xdp_buff xdp;
 
 	/* Clear status before servicing to reduce spurious interrupts */
 	if (ring->index == DESC_INDEX) {
@@ -2283,28 +2555,25 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 	netif_dbg(priv, rx_status, dev,
 		  "RDMA: rxpkttoprocess=%d\n", rxpkttoprocess);
 
+	xdp_prog = READ_ONCE(priv->xdp_prog);
+	xdp_init_buff(&xdp, PAGE_SIZE, &ring->xdp_rxq);
+
 	while ((rxpktprocessed < rxpkttoprocess) &&
 	       (rxpktprocessed < budget)) {
 		struct status_64 *status;
+		unsigned int offset;
 		__be16 rx_csum;
 
 		cb = &priv->rx_cbs[ring->read_ptr];
-		skb = bcmgenet_rx_refill(priv, cb);
+		page = bcmgenet_rx_refill(ring, cb);
 
-		if (unlikely(!skb)) {
+		if (unlikely(!page)) {
 			ring->dropped++;
 			goto next;
 		}
 
-		status = (struct status_64 *)skb->data;
+		status = page_address(page) + GENET_RX_HEADROOM;
 		dma_length_status = status->length_status;
-		if (dev->features & NETIF_F_RXCSUM) {
-			rx_csum = (__force __be16)(status->rx_csum & 0xffff);
-			if (rx_csum) {
-				skb->csum = (__force __wsum)ntohs(rx_csum);
-				skb->ip_summed = CHECKSUM_COMPLETE;
-			}
-		}
 
 		/* DMA flags and length are still valid no matter how
 		 * we got the Receive Status Vector (64B RSB or register)
@@ -2321,7 +2590,7 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 			netif_err(priv, rx_status, dev, "oversized packet\n");
 			dev->stats.rx_length_errors++;
 			dev->stats.rx_errors++;
-			dev_kfree_skb_any(skb);
+			page_pool_recycle_direct(ring->page_pool, page);
 			goto next;
 		}
 
@@ -2329,7 +2598,7 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 			netif_err(priv, rx_status, dev,
 				  "dropping fragmented packet!\n");
 			ring->errors++;
-			dev_kfree_skb_any(skb);
+			page_pool_recycle_direct(ring->page_pool, page);
 			goto next;
 		}
 
@@ -2350,25 +2619,60 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 			if (dma_flag & DMA_RX_LG)
 				dev->stats.rx_length_errors++;
 			dev->stats.rx_errors++;
-			dev_kfree_skb_any(skb);
+			page_pool_recycle_direct(ring->page_pool, page);
 			goto next;
 		} /* error packet */
 
-		skb_put(skb, len);
-
 		/* remove RSB and hardware 2bytes added for IP alignment */
-		skb_pull(skb, 66);
-		len -= 66;
+		offset = GENET_RX_HEADROOM + GENET_RSB_PAD;
+		len -= GENET_RSB_PAD;
 
-		if (priv->crc_fwd_en) {
-			skb_trim(skb, len - ETH_FCS_LEN);
+		if (priv->crc_fwd_en)
 			len -= ETH_FCS_LEN;
+
+		rx_csum = (__force __be16)(status->rx_csum & 0xffff);
+
+		if (xdp_prog) {
+			xdp_prepare_buff(&xdp, page_address(page), offset, len,
+					 false);
+			if (bcmgenet_run_xdp(ring, xdp_prog, &xdp, page,
+					     &xdp_status)) {
+				ring->packets++;
+				ring->bytes += len;
+				bytes_processed += len;
+				goto next;
+			}
+
+			/* The program may have moved or resized the packet,
+			 * and the hardware checksum no longer applies.
+			 */
+			offset = xdp.data - xdp.data_hard_start;
+			len = xdp.data_end - xdp.data;
+			rx_csum = 0;
+		}
+
+		skb = napi_build_skb(page_address(page), PAGE_SIZE);
+		if (unlikely(!skb)) {
+			priv->mib.alloc_rx_buff_failed++;
+			ring->dropped++;
+			page_pool_recycle_direct(ring->page_pool, page);
+			goto next;
+		}
+		skb_mark_for_recycle(skb);
+		skb_reserve(skb, offset);
+		__skb_put(skb, len);
+
+		if ((dev->features & NETIF_F_RXCSUM) && rx_csum) {
+			skb->csum = (__force __wsum)ntohs(rx_csum);
+			skb->ip_summed = CHECKSUM_COMPLETE;
 		}
 
 		bytes_processed += len;
 
 		/*Finish setting up the received SKB and send it to the kernel*/
 		skb->protocol = eth_type_trans(skb, priv->dev);
+		skb_record_rx_queue(skb, ring->index == DESC_INDEX ?
+					 0 : ring->index + 1);
 		ring->packets++;
 		ring->bytes += len;
 		if (dma_flag & DMA_RX_MULT)
@@ -2389,6 +2693,17 @@ static unsigned int bcmgenet_desc_rx(struct bcmgenet_rx_ring *ring,
 		bcmgenet_rdma_ring_writel(priv, ring->index, ring->c_index, RDMA_CONS_INDEX);
 	}
 
+	if (xdp_status & GENET_XDP_TX) {
+		struct bcmgenet_tx_ring *tx_ring = &priv->tx_rings[DESC_INDEX];
+
+		spin_lock(&tx_ring->lock);
+		bcmgenet_xdp_xmit_flush(priv, tx_ring);
+		spin_unlock(&tx_ring->lock);
+	}
+
+	if (xdp_status & GENET_XDP_REDIRECT)
+		xdp_do_flush();
+
 	ring->dim.bytes = bytes_processed;
 	ring->dim.packets = rxpktprocessed;
 
@@ -2427,18 +2742,64 @@ static void bcmgenet_dim_work(struct work_struct *work)
 	struct bcmgenet_rx_ring *ring =
 			container_of(ndim, struct bcmgenet_rx_ring, dim);
 	struct dim_cq_moder cur_profile =
-			net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+			net_dim_get_rx_moderation_set(dim->profile_set,
+						      dim->mode, dim->profile_ix);
 
 	bcmgenet_set_rx_coalesce(ring, cur_profile.usec, cur_profile.pkts);
 	dim->state = DIM_START_MEASURE;
 }
 
-/* Assign skb to RX DMA descriptor. */
+static int bcmgenet_create_page_pool(struct bcmgenet_priv *priv,
+				     struct bcmgenet_rx_ring *ring)
+{
+	struct page_pool_params pp_params = {
+		.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV,
+		.order = 0,
+		.pool_size = ring->size,
+		.nid = NUMA_NO_NODE,
+		.dev = &priv->pdev->dev,
+		.napi = &ring->napi,
+		/* Bidirectional so that XDP_TX can send straight from it */
+		.dma_dir = DMA_BIDIRECTIONAL,
+		.offset = GENET_RX_HEADROOM,
+		.max_len = RX_BUF_LENGTH,
+	};
+	int ret;
+
+	ring->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(ring->page_pool)) {
+		ret = PTR_ERR(ring->page_pool);
+		ring->page_pool = NULL;
+		return ret;
+	}
+
+	return 0;
+}
+
+static void bcmgenet_destroy_page_pools(struct bcmgenet_priv *priv)
+{
+	struct bcmgenet_rx_ring *ring;
+	unsigned int i;
+
+	for (i = 0; i <= DESC_INDEX; i++) {
+		ring = &priv->rx_rings[i];
+
+		if (xdp_rxq_info_is_reg(&ring->xdp_rxq))
+			xdp_rxq_info_unreg(&ring->xdp_rxq);
+
+		if (ring->page_pool) {
+			page_pool_destroy(ring->page_pool);
+			ring->page_pool = NULL;
+		}
+	}
+}
+
+/* Assign a page pool page to each RX DMA descriptor. */
 static int bcmgenet_alloc_rx_buffers(struct bcmgenet_priv *priv,
 				     struct bcmgenet_rx_ring *ring)
 {
 	struct enet_cb *cb;
-	struct sk_buff *skb;
+	struct page *page;
 	int i;
 
 	netif_dbg(priv, hw, priv->dev, "%s\n", __func__);
@@ -2446,10 +2807,10 @@ static int bcmgenet_alloc_rx_buffers(struct bcmgenet_priv *priv,
 	/* loop here for each buffer needing assign */
 	for (i = 0; i < ring->size; i++) {
 		cb = ring->cbs + i;
-		skb = bcmgenet_rx_refill(priv, cb);
-		if (skb)
-			dev_consume_skb_any(skb);
-		if (!cb->skb)
+		page = bcmgenet_rx_refill(ring, cb);
+		if (page)
+			page_pool_put_full_page(ring->page_pool, page, false);
+		if (!cb->rx_page)
 			return -ENOMEM;
 	}
 
@@ -2458,17 +2819,19 @@ static int bcmgenet_alloc_rx_buffers(struct bcmgenet_priv *priv,
 
 static void bcmgenet_free_rx_buffers(struct bcmgenet_priv *priv)
 {
-	struct sk_buff *skb;
 	struct enet_cb *cb;
+	struct page *page;
 	int i;
 
 	for (i = 0; i < priv->num_rx_bds; i++) {
 		cb = &priv->rx_cbs[i];
 
-		skb = bcmgenet_free_rx_cb(&priv->pdev->dev, cb);
-		if (skb)
-			dev_consume_skb_any(skb);
+		page = bcmgenet_free_rx_cb(cb);
+		if (page)
+			page_pool_put_full_page(page->pp, page, false);
 	}
+
+	bcmgenet_destroy_page_pools(priv);
 }
 
 static void umac_enable_set(struct bcmgenet_priv *priv, u32 mask, bool enable)
@@ -2610,6 +2973,7 @@ static void bcmgenet_init_dim(struct bcmgenet_rx_ring *ring,
 
 	INIT_WORK(&dim->dim.work, cb);
 	dim->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	dim->dim.profile_set = NET_DIM_PROFILE_SET_LOW_POWER;
 	dim->event_ctr = 0;
 	dim->packets = 0;
 	dim->bytes = 0;
@@ -2626,7 +2990,8 @@ static void bcmgenet_init_rx_coalesce(struct bcmgenet_rx_ring *ring)
 
 	/* If DIM was enabled, re-apply default parameters */
 	if (dim->use_dim) {
-		moder = net_dim_get_def_rx_moderation(dim->dim.mode);
+		moder = net_dim_get_def_rx_moderation_set(dim->dim.profile_set,
+							  dim->dim.mode);
 		usecs = moder.usec;
 		pkts = moder.pkts;
 	}
@@ -2671,7 +3036,8 @@ static void bcmgenet_init_tx_ring(struct bcmgenet_priv *priv,
 
 	bcmgenet_tdma_ring_writel(priv, index, 0, TDMA_PROD_INDEX);
 	bcmgenet_tdma_ring_writel(priv, index, 0, TDMA_CONS_INDEX);
-	bcmgenet_tdma_ring_writel(priv, index, 10, DMA_MBUF_DONE_THRESH);
+	bcmgenet_tdma_ring_writel(priv, index, ring->tx_max_coalesced_frames,
+				  DMA_MBUF_DONE_THRESH);
 	/* Disable rate control for now */
 	bcmgenet_tdma_ring_writel(priv, index, flow_period_val,
 				  TDMA_FLOW_PERIOD);
@@ -2718,6 +3084,10 @@ static int bcmgenet_init_rx_ring(struct bcmgenet_priv *priv,
 	ring->cb_ptr = start_ptr;
 	ring->end_ptr = end_ptr - 1;
 
+	ret = bcmgenet_create_page_pool(priv, ring);
+	if (ret)
+		return ret;
+
 	ret = bcmgenet_alloc_rx_buffers(priv, ring);
 	if (ret)
 		return ret;
@@ -2728,6 +3098,18 @@ static int bcmgenet_init_rx_ring(struct bcmgenet_priv *priv,
 	/* Initialize Rx NAPI */
 	netif_napi_add(priv->dev, &ring->napi, bcmgenet_rx_poll);
 
+	/* Same queue numbering as Tx: ring 16 is queue 0 */
+	ret = xdp_rxq_info_reg(&ring->xdp_rxq, priv->dev,
+			       index == DESC_INDEX ? 0 : index + 1,
+			       ring->napi.napi_id);
+	if (ret)
+		return ret;
+
+	ret = xdp_rxq_info_reg_mem_model(&ring->xdp_rxq, MEM_TYPE_PAGE_POOL,
+					 ring->page_pool);
+	if (ret)
+		return ret;
+
 	bcmgenet_rdma_ring_writel(priv, index, 0, RDMA_PROD_INDEX);
 	bcmgenet_rdma_ring_writel(priv, index, 0, RDMA_CONS_INDEX);
 	bcmgenet_rdma_ring_writel(priv, index,
@@ -3045,9 +3427,14 @@ static void bcmgenet_fini_dma(struct bcmgenet_priv *priv)
 	bcmgenet_fini_rx_napi(priv);
 	bcmgenet_fini_tx_napi(priv);
 
-	for (i = 0; i < priv->num_tx_bds; i++)
-		dev_kfree_skb(bcmgenet_free_tx_cb(&priv->pdev->dev,
-						  priv->tx_cbs + i));
+	for (i = 0; i < priv->num_tx_bds; i++) {
+		if (priv->tx_cbs[i].xdpf)
+			bcmgenet_free_tx_xdpf(&priv->pdev->dev,
+					      priv->tx_cbs + i);
+		else
+			dev_kfree_skb(bcmgenet_free_tx_cb(&priv->pdev->dev,
+							  priv->tx_cbs + i));
+	}
 
 	for (i = 0; i < priv->hw_params->tx_queues; i++) {
 		txq = netdev_get_tx_queue(priv->dev, priv->tx_rings[i].queue);
@@ -3743,6 +4130,36 @@ static int bcmgenet_change_carrier(struct net_device *dev, bool new_carrier)
 	return 0;
 }
 
+static int bcmgenet_xdp_setup(struct net_device *dev, struct bpf_prog *prog,
+			      struct netlink_ext_ack *extack)
+{
+	struct bcmgenet_priv *priv = netdev_priv(dev);
+	struct bpf_prog *old_prog;
+
+	/* Rx buffers are single pages, no room for jumbo frames */
+	if (prog && dev->mtu > ETH_DATA_LEN) {
+		NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+		return -EOPNOTSUPP;
+	}
+
+	/* The Rx page pools are always mapped for XDP, just swap programs */
+	old_prog = xchg(&priv->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	return 0;
+}
+
+static int bcmgenet_bpf(struct net_device *dev, struct netdev_bpf *bpf)
+{
+	switch (bpf->command) {
+	case XDP_SETUP_PROG:
+		return bcmgenet_xdp_setup(dev, bpf->prog, bpf->extack);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static const struct net_device_ops bcmgenet_netdev_ops = {
 	.ndo_open		= bcmgenet_open,
 	.ndo_stop		= bcmgenet_close,
@@ -3757,6 +4174,8 @@ static const struct net_device_ops bcmgenet_netdev_ops = {
 #endif
 	.ndo_get_stats		= bcmgenet_get_stats,
 	.ndo_change_carrier	= bcmgenet_change_carrier,
+	.ndo_bpf		= bcmgenet_bpf,
+	.ndo_xdp_xmit		= bcmgenet_xdp_xmit,
 };
 
 /* Array of GENET hardware parameters/characteristics */
@@ -3877,6 +4296,14 @@ static void bcmgenet_set_hw_params(struct bcmgenet_priv *priv)
 	priv->hw_params = &bcmgenet_hw_params[priv->version];
 	params = priv->hw_params;
 
+	/* Only carve the priority rings out of the default ring when flows
+	 * are spread over them, nothing else steers packets there.
+	 */
+	if (rx_spread && GENET_IS_V5(priv)) {
+		params->rx_queues = 4;
+		params->rx_bds_per_q = 32;
+	}
+
 	/* Read GENET HW version */
 	reg = bcmgenet_sys_readl(priv, SYS_REV_CTRL);
 	major = (reg >> 24 & 0x0f);
@@ -4067,6 +4494,8 @@ static int bcmgenet_probe(struct platform_device *pdev)
 			 NETIF_F_RXCSUM;
 	dev->hw_features |= dev->features;
 	dev->vlan_features |= dev->features;
+	dev->xdp_features = NETDEV_XDP_ACT_BASIC | NETDEV_XDP_ACT_REDIRECT |
+			    NETDEV_XDP_ACT_NDO_XMIT;
 
 	/* Request the WOL interrupt and advertise suspend if available */
 	priv->wol_irq_disabled = true;
@@ -4171,6 +4600,9 @@ static int bcmgenet_probe(struct platform_device *pdev)
 	netif_set_real_num_rx_queues(priv->dev, priv->hw_params->rx_queues + 1);
 
 	/* Set default coalescing parameters */
+	for (i = 0; i < priv->hw_params->tx_queues; i++)
+		priv->tx_rings[i].tx_max_coalesced_frames = 10;
+	priv->tx_rings[DESC_INDEX].tx_max_coalesced_frames = 10;
 	for (i = 0; i < priv->hw_params->rx_queues; i++) {
 		priv->rx_rings[i].rx_max_coalesced_frames = 1;
 		priv->rx_rings[i].rx_coalesce_usecs = 50;
@@ -4190,6 +4622,12 @@ static int bcmgenet_probe(struct platform_device *pdev)
 		goto err;
 	}
 
+	/* The priority rings all share irq1, so run their NAPI contexts as
+	 * threads that the scheduler can spread over the CPUs.
+	 */
+	if (rx_spread && priv->hw_params->rx_queues)
+		dev_set_threaded(dev, true);
+
 	return err;
 
 err_clk_disable:
@@ -4290,6 +4728,7 @@ static int bcmgenet_resume(struct device *d)
 	list_for_each_entry(rule, &priv->rxnfc_list, list)
 		if (rule->state != BCMGENET_RXNFC_STATE_UNUSED)
 			bcmgenet_hfb_create_rxnfc_filter(priv, rule);
+	bcmgenet_hfb_spread_flows(priv);
 
 	/* Disable RX/TX DMA and flush TX queues */
 	dma_ctrl = bcmgenet_dma_disable(priv, false);
@@ -4320,6 +4759,25 @@ static int bcmgenet_resume(struct device *d)
 	return ret;
 }
 
+/* bcmgenet_hfb_unspread_flows
+ *
+ * Remove the flow spreading filters, which would otherwise wake the system
+ * on any TCP or UDP packet once the HFB is armed for Wake-on-LAN.
+ */
+static void bcmgenet_hfb_unspread_flows(struct bcmgenet_priv *priv)
+{
+	u32 f;
+
+	if (!bcmgenet_hfb_can_spread(priv))
+		return;
+
+	for (f = GENET_HFB_SPREAD_BASE;
+	     f < GENET_HFB_SPREAD_BASE + GENET_HFB_SPREAD_CNT; f++) {
+		bcmgenet_hfb_disable_filter(priv, f);
+		bcmgenet_hfb_clear_filter(priv, f);
+	}
+}
+
 static int bcmgenet_suspend(struct device *d)
 {
 	struct net_device *dev = dev_get_drvdata(d);
@@ -4335,7 +4793,8 @@ static int bcmgenet_suspend(struct device *d)
 	if (!device_may_wakeup(d))
 		phy_suspend(dev->phydev);
 
-	/* Disable filtering */
+	/* Disable filtering, leaving only the rxnfc filters for WoL */
+	bcmgenet_hfb_unspread_flows(priv);
 	bcmgenet_hfb_reg_writel(priv, 0, HFB_CTRL);
 
 	return 0;
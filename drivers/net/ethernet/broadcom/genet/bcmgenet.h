@@ -15,6 +15,7 @@
 #include <linux/phy.h>
 #include <linux/dim.h>
 #include <linux/ethtool.h>
+#include <net/xdp.h>
 
 #include "../unimac.h"
 
@@ -150,6 +151,10 @@ struct bcmgenet_mib_counters {
 	u32	tx_dma_failed;
 	u32	tx_realloc_tsb;
 	u32	tx_realloc_tsb_failed;
+	u32	rx_xdp_drop;
+	u32	rx_xdp_tx;
+	u32	rx_xdp_redirect;
+	u32	xdp_tx_err;
 };
 
 #define UMAC_MIB_START			0x400
@@ -440,6 +445,8 @@ struct bcmgenet_mib_counters {
 
 struct enet_cb {
 	struct sk_buff      *skb;
+	struct page         *rx_page;	/* Rx page pool buffer */
+	struct xdp_frame    *xdpf;	/* Tx XDP frame */
 	void __iomem *bd_addr;
 	DEFINE_DMA_UNMAP_ADDR(dma_addr);
 	DEFINE_DMA_UNMAP_LEN(dma_len);
@@ -523,6 +530,7 @@ struct bcmgenet_tx_ring {
 	unsigned int	prod_index;	/* Tx ring producer index SW copy */
 	unsigned int	cb_ptr;		/* Tx ring initial CB ptr */
 	unsigned int	end_ptr;	/* Tx ring end CB ptr */
+	u32		tx_max_coalesced_frames;
 	void (*int_enable)(struct bcmgenet_tx_ring *);
 	void (*int_disable)(struct bcmgenet_tx_ring *);
 	struct bcmgenet_priv *priv;
@@ -555,6 +563,8 @@ struct bcmgenet_rx_ring {
 	u32		rx_coalesce_usecs;
 	void (*int_enable)(struct bcmgenet_rx_ring *);
 	void (*int_disable)(struct bcmgenet_rx_ring *);
+	struct page_pool *page_pool;	/* Rx buffers, recycled pre-mapped */
+	struct xdp_rxq_info xdp_rxq;
 	struct bcmgenet_priv *priv;
 };
 
@@ -592,6 +602,7 @@ struct bcmgenet_priv {
 	struct list_head rxnfc_list;
 
 	struct bcmgenet_rx_ring rx_rings[DESC_INDEX + 1];
+	struct bpf_prog *xdp_prog;
 
 	/* other misc variables */
 	struct bcmgenet_hw_params *hw_params;
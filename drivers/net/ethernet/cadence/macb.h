@@ -8,11 +8,13 @@
 #define _MACB_H
 
 #include <linux/clk.h>
+#include <linux/dim.h>
 #include <linux/phylink.h>
 #include <linux/ptp_clock_kernel.h>
 #include <linux/net_tstamp.h>
 #include <linux/interrupt.h>
 #include <linux/phy/phy.h>
+#include <net/xdp.h>
 
 #if defined(CONFIG_ARCH_DMA_ADDR_T_64BIT) || defined(CONFIG_MACB_USE_HWSTAMP)
 #define MACB_EXT_DESC
@@ -954,6 +956,7 @@ struct macb_dma_desc_ptp {
  */
 struct macb_tx_skb {
 	struct sk_buff		*skb;
+	struct xdp_frame	*xdpf;
 	dma_addr_t		mapping;
 	size_t			size;
 	bool			mapped_as_page;
@@ -1248,10 +1251,22 @@ struct macb_queue {
 	unsigned int		rx_tail;
 	unsigned int		rx_prepared_head;
 	struct macb_dma_desc	*rx_ring;
-	struct sk_buff		**rx_skbuff;
+	void			**rx_buff;
+	struct page_pool	*page_pool;
+	struct xdp_rxq_info	xdp_rxq;
 	void			*rx_buffers;
 	struct napi_struct	napi_rx;
 	struct queue_stats stats;
+
+	/* Dynamic interrupt moderation, see gem_update_intmod() */
+	struct dim		rx_dim;
+	struct dim		tx_dim;
+	u16			rx_dim_events;
+	u16			tx_dim_events;
+	u32			rx_dim_usecs;
+	u32			tx_dim_usecs;
+	unsigned long		rx_dim_last;
+	unsigned long		tx_dim_last;
 };
 
 struct ethtool_rx_fs_item {
@@ -1273,6 +1288,13 @@ struct macb {
 	void	(*macb_reg_writel)(struct macb *bp, int offset, u32 value);
 
 	size_t			rx_buffer_size;
+	unsigned int		rx_headroom;
+	u32			rx_coalesce_usecs;
+	u32			tx_coalesce_usecs;
+	bool			rx_dim_enabled;
+	bool			tx_dim_enabled;
+	unsigned int		rx_frag_size;
+	struct bpf_prog		*xdp_prog;
 
 	unsigned int		rx_ring_size;
 	unsigned int		tx_ring_size;
@@ -1371,22 +1393,30 @@ enum macb_bd_control {
 
 void gem_ptp_init(struct net_device *ndev);
 void gem_ptp_remove(struct net_device *ndev);
-void gem_ptp_txstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc);
-void gem_ptp_rxstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc);
-static inline void gem_ptp_do_txstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc)
+void gem_ptp_txstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc,
+		     time64_t *tsu_sec);
+void gem_ptp_rxstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc,
+		     time64_t *tsu_sec);
+
+/* @tsu_sec caches the 1588 timer seconds across a batch of descriptors and
+ * must be initialised to a negative value at the start of each batch.
+ */
+static inline void gem_ptp_do_txstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc,
+				      time64_t *tsu_sec)
 {
 	if (bp->tstamp_config.tx_type == TSTAMP_DISABLED)
 		return;
 
-	gem_ptp_txstamp(bp, skb, desc);
+	gem_ptp_txstamp(bp, skb, desc, tsu_sec);
 }
 
-static inline void gem_ptp_do_rxstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc)
+static inline void gem_ptp_do_rxstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc,
+				      time64_t *tsu_sec)
 {
 	if (bp->tstamp_config.rx_filter == TSTAMP_DISABLED)
 		return;
 
-	gem_ptp_rxstamp(bp, skb, desc);
+	gem_ptp_rxstamp(bp, skb, desc, tsu_sec);
 }
 int gem_get_hwtst(struct net_device *dev, struct ifreq *rq);
 int gem_set_hwtst(struct net_device *dev, struct ifreq *ifr, int cmd);
@@ -1394,8 +1424,10 @@ int gem_set_hwtst(struct net_device *dev, struct ifreq *ifr, int cmd);
 static inline void gem_ptp_init(struct net_device *ndev) { }
 static inline void gem_ptp_remove(struct net_device *ndev) { }
 
-static inline void gem_ptp_do_txstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc) { }
-static inline void gem_ptp_do_rxstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc) { }
+static inline void gem_ptp_do_txstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc,
+				      time64_t *tsu_sec) { }
+static inline void gem_ptp_do_rxstamp(struct macb *bp, struct sk_buff *skb, struct macb_dma_desc *desc,
+				      time64_t *tsu_sec) { }
 #endif
 
 static inline bool macb_is_gem(struct macb *bp)
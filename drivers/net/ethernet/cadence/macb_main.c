@@ -38,6 +38,9 @@
 #include <linux/ptp_classify.h>
 #include <linux/reset.h>
 #include <linux/firmware/xlnx-zynqmp.h>
+#include <linux/filter.h>
+#include <linux/bpf_trace.h>
+#include <net/page_pool/helpers.h>
 #include "macb.h"
 
 static unsigned int txdelay = 35;
@@ -56,6 +59,15 @@ struct sifive_fu540_macb_mgmt {
 #define DEFAULT_RX_RING_SIZE	512 /* must be power of 2 */
 #define MIN_RX_RING_SIZE	64
 #define MAX_RX_RING_SIZE	8192
+/* GEM Rx buffers are page pool fragments that become the skb head, with
+ * bp->rx_headroom in front of the hardware's NET_IP_ALIGN offset: room for
+ * the stack, or XDP_PACKET_HEADROOM while an XDP program is attached.
+ */
+#define MACB_XDP_PASS		0
+#define MACB_XDP_CONSUMED	BIT(0)
+#define MACB_XDP_TX		BIT(1)
+#define MACB_XDP_REDIR		BIT(2)
+
 #define RX_RING_BYTES(bp)	(macb_dma_desc_get_size(bp)	\
 				 * (bp)->rx_ring_size)
 
@@ -1059,6 +1071,11 @@ static void macb_tx_unmap(struct macb *bp, struct macb_tx_skb *tx_skb, int budge
 		napi_consume_skb(tx_skb->skb, budget);
 		tx_skb->skb = NULL;
 	}
+
+	if (tx_skb->xdpf) {
+		xdp_return_frame(tx_skb->xdpf);
+		tx_skb->xdpf = NULL;
+	}
 }
 
 static void macb_set_addr(struct macb *bp, struct macb_dma_desc *desc, dma_addr_t addr)
@@ -1109,6 +1126,7 @@ static void macb_tx_error_task(struct work_struct *work)
 	struct sk_buff		*skb;
 	unsigned int		tail;
 	unsigned long		flags;
+	unsigned int		len;
 
 	netdev_vdbg(bp->dev, "macb_tx_error_task: q = %u, t = %u, h = %u\n",
 		    (unsigned int)(queue - bp->queues),
@@ -1148,8 +1166,8 @@ static void macb_tx_error_task(struct work_struct *work)
 		skb = tx_skb->skb;
 
 		if (ctrl & MACB_BIT(TX_USED)) {
-			/* skb is set for the last buffer of the frame */
-			while (!skb) {
+			/* skb or xdpf is set for the last buffer of the frame */
+			while (!skb && !tx_skb->xdpf) {
 				macb_tx_unmap(bp, tx_skb, 0);
 				tail++;
 				tx_skb = macb_tx_skb(queue, tail);
@@ -1160,13 +1178,13 @@ static void macb_tx_error_task(struct work_struct *work)
 			 * since it's the only one written back by the hardware
 			 */
 			if (!(ctrl & MACB_BIT(TX_BUF_EXHAUSTED))) {
-				netdev_vdbg(bp->dev, "txerr skb %u (data %p) TX complete\n",
-					    macb_tx_ring_wrap(bp, tail),
-					    skb->data);
+				len = skb ? skb->len : tx_skb->xdpf->len;
+				netdev_vdbg(bp->dev, "txerr frame %u TX complete\n",
+					    macb_tx_ring_wrap(bp, tail));
 				bp->dev->stats.tx_packets++;
 				queue->stats.tx_packets++;
-				bp->dev->stats.tx_bytes += skb->len;
-				queue->stats.tx_bytes += skb->len;
+				bp->dev->stats.tx_bytes += len;
+				queue->stats.tx_bytes += len;
 			}
 		} else {
 			/* "Buffers exhausted mid-frame" errors may only happen
@@ -1250,6 +1268,7 @@ static int macb_tx_complete(struct macb_queue *queue, int budget)
 {
 	struct macb *bp = queue->bp;
 	u16 queue_index = queue - bp->queues;
+	time64_t tsu_sec = -1;
 	unsigned int tail;
 	unsigned int head;
 	int packets = 0;
@@ -1258,6 +1277,7 @@ static int macb_tx_complete(struct macb_queue *queue, int budget)
 	head = queue->tx_head;
 	for (tail = queue->tx_tail; tail != head && packets < budget; tail++) {
 		struct macb_tx_skb	*tx_skb;
+		struct xdp_frame	*xdpf;
 		struct sk_buff		*skb;
 		struct macb_dma_desc	*desc;
 		u32			ctrl;
@@ -1279,12 +1299,19 @@ static int macb_tx_complete(struct macb_queue *queue, int budget)
 		for (;; tail++) {
 			tx_skb = macb_tx_skb(queue, tail);
 			skb = tx_skb->skb;
+			xdpf = tx_skb->xdpf;
 
 			/* First, update TX stats if needed */
-			if (skb) {
+			if (xdpf) {
+				bp->dev->stats.tx_packets++;
+				queue->stats.tx_packets++;
+				bp->dev->stats.tx_bytes += xdpf->len;
+				queue->stats.tx_bytes += xdpf->len;
+				packets++;
+			} else if (skb) {
 				if (unlikely(skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP) &&
 				    !ptp_one_step_sync(skb))
-					gem_ptp_do_txstamp(bp, skb, desc);
+					gem_ptp_do_txstamp(bp, skb, desc, &tsu_sec);
 
 				netdev_vdbg(bp->dev, "skb %u (data %p) TX complete\n",
 					    macb_tx_ring_wrap(bp, tail),
@@ -1299,11 +1326,11 @@ static int macb_tx_complete(struct macb_queue *queue, int budget)
 			/* Now we can safely release resources */
 			macb_tx_unmap(bp, tx_skb, budget);
 
-			/* skb is set only for the last buffer of the frame.
-			 * WARNING: at this point skb has been freed by
-			 * macb_tx_unmap().
+			/* skb or xdpf is set only for the last buffer of the
+			 * frame. WARNING: at this point both have been freed
+			 * by macb_tx_unmap().
 			 */
-			if (skb)
+			if (skb || xdpf)
 				break;
 		}
 	}
@@ -1318,10 +1345,166 @@ static int macb_tx_complete(struct macb_queue *queue, int budget)
 	return packets;
 }
 
+/* Queue one XDP frame as a single buffer descriptor, called with
+ * queue->tx_ptr_lock held. Frames bounced back from our own Rx page pool
+ * (XDP_TX) are already mapped, anything redirected to us is mapped here.
+ */
+static int macb_xdp_submit_frame(struct macb *bp, struct macb_queue *queue,
+				 struct xdp_frame *xdpf, bool dma_map)
+{
+	struct macb_tx_skb *tx_skb;
+	struct macb_dma_desc *desc;
+	unsigned int entry;
+	dma_addr_t mapping;
+	struct page *page;
+	u32 ctrl;
+
+	if (CIRC_SPACE(queue->tx_head, queue->tx_tail, bp->tx_ring_size) < 1)
+		return -ENOSPC;
+
+	entry = macb_tx_ring_wrap(bp, queue->tx_head);
+	tx_skb = &queue->tx_skb[entry];
+
+	if (dma_map) {
+		mapping = dma_map_single(&bp->pdev->dev, xdpf->data,
+					 xdpf->len, DMA_TO_DEVICE);
+		if (dma_mapping_error(&bp->pdev->dev, mapping))
+			return -ENOMEM;
+		tx_skb->mapping = mapping;
+	} else {
+		page = virt_to_head_page(xdpf->data);
+		mapping = page_pool_get_dma_addr(page) +
+			  (xdpf->data - page_address(page));
+		dma_sync_single_for_device(&bp->pdev->dev, mapping, xdpf->len,
+					   DMA_BIDIRECTIONAL);
+		/* The mapping belongs to the page pool */
+		tx_skb->mapping = 0;
+	}
+
+	tx_skb->skb = NULL;
+	tx_skb->xdpf = xdpf;
+	tx_skb->size = xdpf->len;
+	tx_skb->mapped_as_page = false;
+
+	/* Set 'TX_USED' bit in the next descriptor to end the TX queue */
+	desc = macb_tx_desc(queue, queue->tx_head + 1);
+	desc->ctrl = MACB_BIT(TX_USED);
+
+	ctrl = xdpf->len | MACB_BIT(TX_LAST);
+	if (unlikely(entry == (bp->tx_ring_size - 1)))
+		ctrl |= MACB_BIT(TX_WRAP);
+
+	desc = macb_tx_desc(queue, entry);
+	macb_set_addr(bp, desc, mapping);
+	/* desc->addr must be visible to hardware before clearing
+	 * 'TX_USED' bit in desc->ctrl.
+	 */
+	wmb();
+	desc->ctrl = ctrl;
+
+	queue->tx_head++;
+
+	return 0;
+}
+
+static void macb_xdp_kick(struct macb *bp, struct macb_queue *queue)
+{
+	unsigned long flags;
+
+	/* Make newly initialized descriptors visible to hardware */
+	wmb();
+
+	spin_lock_irqsave(&bp->lock, flags);
+
+	/* TSTART write might get dropped, so make the IRQ retrigger a buffer read */
+	if (macb_readl(bp, TSR) & MACB_BIT(TGO))
+		queue->tx_pending = 1;
+
+	macb_writel(bp, NCR, macb_readl(bp, NCR) | MACB_BIT(TSTART));
+	spin_unlock_irqrestore(&bp->lock, flags);
+}
+
+static int macb_xdp_xmit(struct net_device *dev, int n,
+			 struct xdp_frame **frames, u32 flags)
+{
+	struct macb *bp = netdev_priv(dev);
+	struct macb_queue *queue;
+	int i, nxmit = 0;
+
+	if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+		return -EINVAL;
+
+	if (unlikely(!netif_running(dev) || !macb_is_gem(bp)))
+		return -ENETDOWN;
+
+	queue = &bp->queues[smp_processor_id() % bp->num_queues];
+
+	spin_lock(&queue->tx_ptr_lock);
+	for (i = 0; i < n; i++) {
+		if (macb_xdp_submit_frame(bp, queue, frames[i], true))
+			break;
+		nxmit++;
+	}
+	spin_unlock(&queue->tx_ptr_lock);
+
+	if (nxmit)
+		macb_xdp_kick(bp, queue);
+
+	return nxmit;
+}
+
+static u32 gem_run_xdp(struct macb_queue *queue, struct bpf_prog *prog,
+		       struct xdp_buff *xdp)
+{
+	struct macb *bp = queue->bp;
+	struct xdp_frame *xdpf;
+	u32 act;
+	int err;
+
+	act = bpf_prog_run_xdp(prog, xdp);
+
+	switch (act) {
+	case XDP_PASS:
+		return MACB_XDP_PASS;
+	case XDP_TX:
+		xdpf = xdp_convert_buff_to_frame(xdp);
+		if (unlikely(!xdpf))
+			goto out_failure;
+
+		/* Bounce it back out of the Tx queue paired with this one */
+		spin_lock(&queue->tx_ptr_lock);
+		err = macb_xdp_submit_frame(bp, queue, xdpf, false);
+		spin_unlock(&queue->tx_ptr_lock);
+		if (unlikely(err)) {
+			bp->dev->stats.tx_dropped++;
+			goto out_failure;
+		}
+		return MACB_XDP_TX;
+	case XDP_REDIRECT:
+		err = xdp_do_redirect(bp->dev, xdp, prog);
+		if (unlikely(err))
+			goto out_failure;
+		return MACB_XDP_REDIR;
+	default:
+		bpf_warn_invalid_xdp_action(bp->dev, prog, act);
+		fallthrough;
+	case XDP_ABORTED:
+out_failure:
+		trace_xdp_exception(bp->dev, prog, act);
+		fallthrough;
+	case XDP_DROP:
+		break;
+	}
+
+	page_pool_put_full_page(queue->page_pool,
+				virt_to_head_page(xdp->data), true);
+	return MACB_XDP_CONSUMED;
+}
+
 static void gem_rx_refill(struct macb_queue *queue)
 {
-	unsigned int		entry;
-	struct sk_buff		*skb;
+	unsigned int		entry, offset;
+	struct page		*page;
 	dma_addr_t		paddr;
 	struct macb *bp = queue->bp;
 	struct macb_dma_desc *desc;
@@ -1335,25 +1518,27 @@ static void gem_rx_refill(struct macb_queue *queue)
 
 		desc = macb_rx_desc(queue, entry);
 
-		if (!queue->rx_skbuff[entry]) {
-			/* allocate sk_buff for this free entry in ring */
-			skb = netdev_alloc_skb(bp->dev, bp->rx_buffer_size);
-			if (unlikely(!skb)) {
+		if (!queue->rx_buff[entry]) {
+			/* allocate a buffer for this free entry in ring */
+			page = page_pool_dev_alloc_frag(queue->page_pool,
+							&offset,
+							bp->rx_frag_size);
+			if (unlikely(!page)) {
 				netdev_err(bp->dev,
-					   "Unable to allocate sk_buff\n");
+					   "Unable to allocate Rx buffer\n");
 				break;
 			}
 
-			/* now fill corresponding descriptor entry */
-			paddr = dma_map_single(&bp->pdev->dev, skb->data,
-					       bp->rx_buffer_size,
-					       DMA_FROM_DEVICE);
-			if (dma_mapping_error(&bp->pdev->dev, paddr)) {
-				dev_kfree_skb(skb);
-				break;
-			}
+			/* The pool keeps its pages mapped, a recycled buffer
+			 * only needs handing back to the device.
+			 */
+			paddr = page_pool_get_dma_addr(page) + offset +
+				bp->rx_headroom;
+			dma_sync_single_for_device(&bp->pdev->dev, paddr,
+						   bp->rx_buffer_size,
+						   page_pool_get_dma_dir(queue->page_pool));
 
-			queue->rx_skbuff[entry] = skb;
+			queue->rx_buff[entry] = page_address(page) + offset;
 
 			if (entry == bp->rx_ring_size - 1)
 				paddr |= MACB_BIT(RX_WRAP);
@@ -1363,9 +1548,6 @@ static void gem_rx_refill(struct macb_queue *queue)
 			 */
 			dma_wmb();
 			macb_set_addr(bp, desc, paddr);
-
-			/* properly align Ethernet header */
-			skb_reserve(skb, NET_IP_ALIGN);
 		} else {
 			desc->ctrl = 0;
 			dma_wmb();
@@ -1406,10 +1588,15 @@ static int gem_rx(struct macb_queue *queue, struct napi_struct *napi,
 		  int budget)
 {
 	struct macb *bp = queue->bp;
-	unsigned int		len;
+	struct bpf_prog *xdp_prog = READ_ONCE(bp->xdp_prog);
+	unsigned int		len, headroom;
 	unsigned int		entry;
 	struct sk_buff		*skb;
 	struct macb_dma_desc	*desc;
+	struct xdp_buff		xdp;
+	u32			xdp_act = 0, act;
+	void			*data;
+	time64_t		tsu_sec = -1;
 	int			count = 0;
 
 	while (count < budget) {
@@ -1444,8 +1631,8 @@ static int gem_rx(struct macb_queue *queue, struct napi_struct *napi,
 			queue->stats.rx_dropped++;
 			break;
 		}
-		skb = queue->rx_skbuff[entry];
-		if (unlikely(!skb)) {
+		data = queue->rx_buff[entry];
+		if (unlikely(!data)) {
 			netdev_err(bp->dev,
 				   "inconsistent Rx descriptor chain\n");
 			bp->dev->stats.rx_dropped++;
@@ -1453,14 +1640,48 @@ static int gem_rx(struct macb_queue *queue, struct napi_struct *napi,
 			break;
 		}
 		/* now everything is ready for receiving packet */
-		queue->rx_skbuff[entry] = NULL;
+		queue->rx_buff[entry] = NULL;
 		len = ctrl & bp->rx_frm_len_mask;
 
 		netdev_vdbg(bp->dev, "gem_rx %u (len %u)\n", entry, len);
 
+		dma_sync_single_for_cpu(&bp->pdev->dev, addr,
+					len + NET_IP_ALIGN,
+					page_pool_get_dma_dir(queue->page_pool));
+
+		headroom = bp->rx_headroom + NET_IP_ALIGN;
+		if (xdp_prog) {
+			xdp_init_buff(&xdp, bp->rx_frag_size, &queue->xdp_rxq);
+			xdp_prepare_buff(&xdp, data, headroom, len, false);
+
+			act = gem_run_xdp(queue, xdp_prog, &xdp);
+			if (act != MACB_XDP_PASS) {
+				xdp_act |= act;
+				bp->dev->stats.rx_packets++;
+				queue->stats.rx_packets++;
+				bp->dev->stats.rx_bytes += len;
+				queue->stats.rx_bytes += len;
+				continue;
+			}
+
+			/* The program may have moved the packet boundaries */
+			headroom = xdp.data - xdp.data_hard_start;
+			len = xdp.data_end - xdp.data;
+		}
+
+		skb = napi_build_skb(data, bp->rx_frag_size);
+		if (unlikely(!skb)) {
+			page_pool_put_full_page(queue->page_pool,
+						virt_to_head_page(data), true);
+			bp->dev->stats.rx_dropped++;
+			queue->stats.rx_dropped++;
+			break;
+		}
+		skb_mark_for_recycle(skb);
+
+		/* properly align Ethernet header */
+		skb_reserve(skb, headroom);
 		skb_put(skb, len);
-		dma_unmap_single(&bp->pdev->dev, addr,
-				 bp->rx_buffer_size, DMA_FROM_DEVICE);
 
 		skb->protocol = eth_type_trans(skb, bp->dev);
 		skb_checksum_none_assert(skb);
@@ -1474,7 +1695,7 @@ static int gem_rx(struct macb_queue *queue, struct napi_struct *napi,
 		bp->dev->stats.rx_bytes += skb->len;
 		queue->stats.rx_bytes += skb->len;
 
-		gem_ptp_do_rxstamp(bp, skb, desc);
+		gem_ptp_do_rxstamp(bp, skb, desc, &tsu_sec);
 
 #if defined(DEBUG) && defined(VERBOSE_DEBUG)
 		netdev_vdbg(bp->dev, "received skb of length %u, csum: %08x\n",
@@ -1488,6 +1709,11 @@ static int gem_rx(struct macb_queue *queue, struct napi_struct *napi,
 		napi_gro_receive(napi, skb);
 	}
 
+	if (xdp_act & MACB_XDP_TX)
+		macb_xdp_kick(bp, queue);
+	if (xdp_act & MACB_XDP_REDIR)
+		xdp_do_flush();
+
 	gem_rx_refill(queue);
 
 	return count;
@@ -1704,6 +1930,16 @@ static int macb_rx_poll(struct napi_struct *napi, int budget)
 		    (unsigned int)(queue - bp->queues), work_done, budget);
 
 	if (work_done < budget && napi_complete_done(napi, work_done)) {
+		if (bp->rx_dim_enabled) {
+			struct dim_sample dim_sample = {};
+
+			WRITE_ONCE(queue->rx_dim_last, jiffies);
+			dim_update_sample(++queue->rx_dim_events,
+					  queue->stats.rx_packets,
+					  queue->stats.rx_bytes, &dim_sample);
+			net_dim(&queue->rx_dim, dim_sample);
+		}
+
 		queue_writel(queue, IER, bp->rx_intr_mask);
 
 		/* Packet completions only seem to propagate to raise
@@ -1790,6 +2026,16 @@ static int macb_tx_poll(struct napi_struct *napi, int budget)
 		    (unsigned int)(queue - bp->queues), work_done, budget);
 
 	if (work_done < budget && napi_complete_done(napi, work_done)) {
+		if (bp->tx_dim_enabled) {
+			struct dim_sample dim_sample = {};
+
+			WRITE_ONCE(queue->tx_dim_last, jiffies);
+			dim_update_sample(++queue->tx_dim_events,
+					  queue->stats.tx_packets,
+					  queue->stats.tx_bytes, &dim_sample);
+			net_dim(&queue->tx_dim, dim_sample);
+		}
+
 		queue_writel(queue, IER, MACB_BIT(TCOMP));
 
 		/* Packet completions only seem to propagate to raise
@@ -2092,6 +2338,7 @@ static unsigned int macb_tx_map(struct macb *bp,
 
 		/* Save info to properly release resources */
 		tx_skb->skb = NULL;
+		tx_skb->xdpf = NULL;
 		tx_skb->mapping = mapping;
 		tx_skb->size = size;
 		tx_skb->mapped_as_page = false;
@@ -2122,6 +2369,7 @@ static unsigned int macb_tx_map(struct macb *bp,
 
 			/* Save info to properly release resources */
 			tx_skb->skb = NULL;
+			tx_skb->xdpf = NULL;
 			tx_skb->mapping = mapping;
 			tx_skb->size = size;
 			tx_skb->mapped_as_page = true;
@@ -2448,6 +2696,12 @@ static void macb_init_rx_buffer_size(struct macb *bp, size_t size)
 			bp->rx_buffer_size =
 				roundup(bp->rx_buffer_size, RX_BUFFER_MULTIPLE);
 		}
+
+		bp->rx_headroom = bp->xdp_prog ? XDP_PACKET_HEADROOM :
+						 NET_SKB_PAD;
+		bp->rx_frag_size =
+			SKB_DATA_ALIGN(bp->rx_headroom + bp->rx_buffer_size) +
+			SKB_DATA_ALIGN(sizeof(struct skb_shared_info));
 	}
 
 	netdev_dbg(bp->dev, "mtu [%u] rx_buffer_size [%zu]\n",
@@ -2456,34 +2710,31 @@ static void macb_init_rx_buffer_size(struct macb *bp, size_t size)
 
 static void gem_free_rx_buffers(struct macb *bp)
 {
-	struct sk_buff		*skb;
-	struct macb_dma_desc	*desc;
 	struct macb_queue *queue;
-	dma_addr_t		addr;
 	unsigned int q;
+	void *data;
 	int i;
 
 	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
-		if (!queue->rx_skbuff)
-			continue;
-
-		for (i = 0; i < bp->rx_ring_size; i++) {
-			skb = queue->rx_skbuff[i];
-
-			if (!skb)
-				continue;
-
-			desc = macb_rx_desc(queue, i);
-			addr = macb_get_addr(bp, desc);
+		if (queue->rx_buff) {
+			for (i = 0; i < bp->rx_ring_size; i++) {
+				data = queue->rx_buff[i];
+				if (!data)
+					continue;
+
+				page_pool_put_full_page(queue->page_pool,
+							virt_to_head_page(data),
+							false);
+			}
 
-			dma_unmap_single(&bp->pdev->dev, addr, bp->rx_buffer_size,
-					DMA_FROM_DEVICE);
-			dev_kfree_skb_any(skb);
-			skb = NULL;
+			kfree(queue->rx_buff);
+			queue->rx_buff = NULL;
 		}
 
-		kfree(queue->rx_skbuff);
-		queue->rx_skbuff = NULL;
+		if (xdp_rxq_info_is_reg(&queue->xdp_rxq))
+			xdp_rxq_info_unreg(&queue->xdp_rxq);
+		page_pool_destroy(queue->page_pool);
+		queue->page_pool = NULL;
 	}
 }
 
@@ -2527,19 +2778,42 @@ static void macb_free_consistent(struct macb *bp)
 
 static int gem_alloc_rx_buffers(struct macb *bp)
 {
+	struct page_pool_params pp_params = {
+		.flags = PP_FLAG_DMA_MAP | PP_FLAG_PAGE_FRAG,
+		.order = get_order(bp->rx_frag_size),
+		.pool_size = bp->rx_ring_size,
+		.nid = NUMA_NO_NODE,
+		.dev = &bp->pdev->dev,
+		/* XDP_TX sends frames straight out of the Rx buffers */
+		.dma_dir = bp->xdp_prog ? DMA_BIDIRECTIONAL : DMA_FROM_DEVICE,
+	};
 	struct macb_queue *queue;
 	unsigned int q;
 	int size;
 
 	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
-		size = bp->rx_ring_size * sizeof(struct sk_buff *);
-		queue->rx_skbuff = kzalloc(size, GFP_KERNEL);
-		if (!queue->rx_skbuff)
+		pp_params.napi = &queue->napi_rx;
+		queue->page_pool = page_pool_create(&pp_params);
+		if (IS_ERR(queue->page_pool)) {
+			queue->page_pool = NULL;
+			return -ENOMEM;
+		}
+
+		if (xdp_rxq_info_reg(&queue->xdp_rxq, bp->dev, q,
+				     queue->napi_rx.napi_id) ||
+		    xdp_rxq_info_reg_mem_model(&queue->xdp_rxq,
+					       MEM_TYPE_PAGE_POOL,
+					       queue->page_pool))
+			return -ENOMEM;
+
+		size = bp->rx_ring_size * sizeof(void *);
+		queue->rx_buff = kzalloc(size, GFP_KERNEL);
+		if (!queue->rx_buff)
 			return -ENOMEM;
 		else
 			netdev_dbg(bp->dev,
-				   "Allocated %d RX struct sk_buff entries at %p\n",
-				   bp->rx_ring_size, queue->rx_skbuff);
+				   "Allocated %d RX buffer entries at %p\n",
+				   bp->rx_ring_size, queue->rx_buff);
 	}
 	return 0;
 }
@@ -2815,18 +3089,118 @@ static void gem_init_axi(struct macb *bp)
 	gem_writel(bp, AMP, amp);
 }
 
-static void gem_init_intmod(struct macb *bp)
+/* A queue whose DIM has not been fed a sample for this long is idle */
+#define MACB_DIM_IDLE		HZ
+
+/* Shortest moderation asked for by the queues with traffic, or by all
+ * queues if none has had any recently.
+ */
+static u32 gem_dim_usecs(struct macb *bp, bool tx)
+{
+	u32 usecs = U32_MAX, idle_usecs = U32_MAX, want;
+	struct macb_queue *queue;
+	unsigned long last;
+	unsigned int q;
+
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		want = tx ? queue->tx_dim_usecs : queue->rx_dim_usecs;
+		last = tx ? READ_ONCE(queue->tx_dim_last) :
+			    READ_ONCE(queue->rx_dim_last);
+
+		if (time_before(jiffies, last + MACB_DIM_IDLE))
+			usecs = min(usecs, want);
+		else
+			idle_usecs = min(idle_usecs, want);
+	}
+
+	return usecs != U32_MAX ? usecs : idle_usecs;
+}
+
+/* GEM has a single INTMOD register shared by all queues. With DIM enabled
+ * each queue runs its own DIM instance on its own traffic, and the shortest
+ * moderation asked for by a busy queue wins, so that no queue waits longer
+ * than it asked for. Idle queues do not hold the others back at the
+ * moderation they last wanted.
+ */
+static void gem_update_intmod(struct macb *bp)
 {
-	unsigned int throttle;
+	u32 rx_usecs = bp->rx_coalesce_usecs;
+	u32 tx_usecs = bp->tx_coalesce_usecs;
 	u32 intmod = 0;
 
-	/* Use sensible interrupt moderation thresholds (50us rx and tx) */
-	throttle = (1000 * 50) / 800;
-	intmod = GEM_BFINS(TX_MODERATION, throttle, intmod);
-	intmod = GEM_BFINS(RX_MODERATION, throttle, intmod);
+	if (bp->rx_dim_enabled)
+		rx_usecs = gem_dim_usecs(bp, false);
+	if (bp->tx_dim_enabled)
+		tx_usecs = gem_dim_usecs(bp, true);
+
+	/* Max is 255 * 0.8us = 204us */
+	rx_usecs = min_t(u32, rx_usecs, 204);
+	tx_usecs = min_t(u32, tx_usecs, 204);
+
+	intmod = GEM_BFINS(TX_MODERATION, (1000 * tx_usecs) / 800, intmod);
+	intmod = GEM_BFINS(RX_MODERATION, (1000 * rx_usecs) / 800, intmod);
 	gem_writel(bp, INTMOD, intmod);
 }
 
+static void gem_init_intmod(struct macb *bp)
+{
+	struct dim_cq_moder rx_moder, tx_moder;
+	struct macb_queue *queue;
+	unsigned int q;
+
+	rx_moder = net_dim_get_def_rx_moderation_set(NET_DIM_PROFILE_SET_LOW_POWER,
+						     DIM_CQ_PERIOD_MODE_START_FROM_EQE);
+	tx_moder = net_dim_get_def_tx_moderation_set(NET_DIM_PROFILE_SET_LOW_POWER,
+						     DIM_CQ_PERIOD_MODE_START_FROM_EQE);
+
+	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
+		queue->rx_dim_usecs = rx_moder.usec;
+		queue->tx_dim_usecs = tx_moder.usec;
+		queue->rx_dim_last = jiffies - MACB_DIM_IDLE;
+		queue->tx_dim_last = jiffies - MACB_DIM_IDLE;
+	}
+
+	gem_update_intmod(bp);
+}
+
+static void macb_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct macb_queue *queue = container_of(dim, struct macb_queue, rx_dim);
+	struct macb *bp = queue->bp;
+	struct dim_cq_moder moder;
+	unsigned long flags;
+
+	moder = net_dim_get_rx_moderation_set(dim->profile_set, dim->mode,
+					      dim->profile_ix);
+
+	spin_lock_irqsave(&bp->lock, flags);
+	queue->rx_dim_usecs = moder.usec;
+	gem_update_intmod(bp);
+	spin_unlock_irqrestore(&bp->lock, flags);
+
+	dim->state = DIM_START_MEASURE;
+}
+
+static void macb_tx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct macb_queue *queue = container_of(dim, struct macb_queue, tx_dim);
+	struct macb *bp = queue->bp;
+	struct dim_cq_moder moder;
+	unsigned long flags;
+
+	moder = net_dim_get_tx_moderation_set(dim->profile_set, dim->mode,
+					      dim->profile_ix);
+
+	spin_lock_irqsave(&bp->lock, flags);
+	queue->tx_dim_usecs = moder.usec;
+	gem_update_intmod(bp);
+	spin_unlock_irqrestore(&bp->lock, flags);
+
+	dim->state = DIM_START_MEASURE;
+}
+
 static void macb_init_hw(struct macb *bp)
 {
 	u32 config;
@@ -3059,6 +3433,8 @@ static int macb_close(struct net_device *dev)
 	for (q = 0, queue = bp->queues; q < bp->num_queues; ++q, ++queue) {
 		napi_disable(&queue->napi_rx);
 		napi_disable(&queue->napi_tx);
+		cancel_work_sync(&queue->rx_dim.work);
+		cancel_work_sync(&queue->tx_dim.work);
 	}
 
 	phylink_stop(bp->phylink);
@@ -3081,16 +3457,82 @@ static int macb_close(struct net_device *dev)
 	return 0;
 }
 
+/* XDP needs the whole frame plus its headroom in a single page */
+static bool macb_xdp_mtu_ok(int mtu)
+{
+	size_t size = roundup(mtu + ETH_HLEN + ETH_FCS_LEN + NET_IP_ALIGN,
+			      RX_BUFFER_MULTIPLE);
+
+	return SKB_DATA_ALIGN(XDP_PACKET_HEADROOM + size) +
+	       SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) <= PAGE_SIZE;
+}
+
 static int macb_change_mtu(struct net_device *dev, int new_mtu)
 {
+	struct macb *bp = netdev_priv(dev);
+
 	if (netif_running(dev))
 		return -EBUSY;
 
+	if (bp->xdp_prog && !macb_xdp_mtu_ok(new_mtu)) {
+		netdev_err(dev, "MTU %d too large for XDP\n", new_mtu);
+		return -EINVAL;
+	}
+
 	dev->mtu = new_mtu;
 
 	return 0;
 }
 
+static int macb_xdp_setup(struct net_device *dev, struct bpf_prog *prog,
+			  struct netlink_ext_ack *extack)
+{
+	struct macb *bp = netdev_priv(dev);
+	bool running = netif_running(dev);
+	struct bpf_prog *old_prog;
+	bool need_reset;
+	int err = 0;
+
+	if (prog && !macb_xdp_mtu_ok(dev->mtu)) {
+		NL_SET_ERR_MSG_MOD(extack, "MTU too large for XDP");
+		return -EOPNOTSUPP;
+	}
+
+	/* Attaching or removing the first program changes the Rx headroom
+	 * and buffer mapping, so the rings have to be rebuilt.
+	 */
+	need_reset = !!bp->xdp_prog != !!prog;
+	if (running && need_reset)
+		macb_close(dev);
+
+	old_prog = xchg(&bp->xdp_prog, prog);
+	if (old_prog)
+		bpf_prog_put(old_prog);
+
+	if (running && need_reset) {
+		err = macb_open(dev);
+		if (err)
+			netdev_err(dev, "failed to restart after XDP change\n");
+	}
+
+	return err;
+}
+
+static int macb_bpf(struct net_device *dev, struct netdev_bpf *xdp)
+{
+	struct macb *bp = netdev_priv(dev);
+
+	if (!macb_is_gem(bp))
+		return -EOPNOTSUPP;
+
+	switch (xdp->command) {
+	case XDP_SETUP_PROG:
+		return macb_xdp_setup(dev, xdp->prog, xdp->extack);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static int macb_set_mac_addr(struct net_device *dev, void *addr)
 {
 	int err;
@@ -3227,9 +3669,7 @@ static int gem_set_coalesce(struct net_device *dev,
 			    struct netlink_ext_ack *extack)
 {
 	struct macb *bp = netdev_priv(dev);
-	unsigned int tx_throttle;
-	unsigned int rx_throttle;
-	u32 intmod = 0;
+	unsigned long flags;
 
 	/* GEM has simple IRQ throttling support. RX and TX interrupts
 	 * are separately moderated on 800ns quantums, with no support
@@ -3240,13 +3680,13 @@ static int gem_set_coalesce(struct net_device *dev,
 	if (ec->rx_coalesce_usecs > 204 || ec->tx_coalesce_usecs > 204)
 		return -EINVAL;
 
-	tx_throttle = (1000 * ec->tx_coalesce_usecs) / 800;
-	rx_throttle = (1000 * ec->rx_coalesce_usecs) / 800;
-
-	intmod = GEM_BFINS(TX_MODERATION, tx_throttle, intmod);
-	intmod = GEM_BFINS(RX_MODERATION, rx_throttle, intmod);
-
-	gem_writel(bp, INTMOD, intmod);
+	spin_lock_irqsave(&bp->lock, flags);
+	bp->rx_coalesce_usecs = ec->rx_coalesce_usecs;
+	bp->tx_coalesce_usecs = ec->tx_coalesce_usecs;
+	bp->rx_dim_enabled = ec->use_adaptive_rx_coalesce;
+	bp->tx_dim_enabled = ec->use_adaptive_tx_coalesce;
+	gem_update_intmod(bp);
+	spin_unlock_irqrestore(&bp->lock, flags);
 
 	return 0;
 }
@@ -3257,12 +3697,11 @@ static int gem_get_coalesce(struct net_device *dev,
 			    struct netlink_ext_ack *extack)
 {
 	struct macb *bp = netdev_priv(dev);
-	u32 intmod;
-
-	intmod = gem_readl(bp, INTMOD);
 
-	ec->tx_coalesce_usecs = (GEM_BFEXT(TX_MODERATION, intmod) * 800) / 1000;
-	ec->rx_coalesce_usecs = (GEM_BFEXT(RX_MODERATION, intmod) * 800) / 1000;
+	ec->tx_coalesce_usecs = bp->tx_coalesce_usecs;
+	ec->rx_coalesce_usecs = bp->rx_coalesce_usecs;
+	ec->use_adaptive_rx_coalesce = bp->rx_dim_enabled;
+	ec->use_adaptive_tx_coalesce = bp->tx_dim_enabled;
 
 	return 0;
 }
@@ -3860,7 +4299,8 @@ static const struct ethtool_ops macb_ethtool_ops = {
 
 static const struct ethtool_ops gem_ethtool_ops = {
 	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS |
-				     ETHTOOL_COALESCE_TX_USECS,
+				     ETHTOOL_COALESCE_TX_USECS |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE,
 	.get_regs_len		= macb_get_regs_len,
 	.get_regs		= macb_get_regs,
 	.get_wol		= macb_get_wol,
@@ -3998,6 +4438,8 @@ static const struct net_device_ops macb_netdev_ops = {
 #endif
 	.ndo_set_features	= macb_set_features,
 	.ndo_features_check	= macb_features_check,
+	.ndo_bpf		= macb_bpf,
+	.ndo_xdp_xmit		= macb_xdp_xmit,
 };
 
 /* Configure peripheral capabilities according to device tree
@@ -4233,6 +4675,12 @@ static int macb_init(struct platform_device *pdev)
 		}
 
 		INIT_WORK(&queue->tx_error_task, macb_tx_error_task);
+		INIT_WORK(&queue->rx_dim.work, macb_rx_dim_work);
+		queue->rx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+		queue->rx_dim.profile_set = NET_DIM_PROFILE_SET_LOW_POWER;
+		INIT_WORK(&queue->tx_dim.work, macb_tx_dim_work);
+		queue->tx_dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+		queue->tx_dim.profile_set = NET_DIM_PROFILE_SET_LOW_POWER;
 		q++;
 	}
 
@@ -4245,6 +4693,15 @@ static int macb_init(struct platform_device *pdev)
 		bp->macbgem_ops.mog_init_rings = gem_init_rings;
 		bp->macbgem_ops.mog_rx = gem_rx;
 		dev->ethtool_ops = &gem_ethtool_ops;
+		dev->xdp_features = NETDEV_XDP_ACT_BASIC |
+				    NETDEV_XDP_ACT_REDIRECT |
+				    NETDEV_XDP_ACT_NDO_XMIT;
+
+		/* Static moderation of 50us rx and tx, adapted by DIM */
+		bp->rx_coalesce_usecs = 50;
+		bp->tx_coalesce_usecs = 50;
+		bp->rx_dim_enabled = true;
+		bp->tx_dim_enabled = true;
 	} else {
 		bp->macbgem_ops.mog_alloc_rx_buffers = macb_alloc_rx_buffers;
 		bp->macbgem_ops.mog_free_rx_buffers = macb_free_rx_buffers;
@@ -244,7 +244,8 @@ static void gem_ptp_clear_timer(struct macb *bp)
 }
 
 static int gem_hw_timestamp(struct macb *bp, u32 dma_desc_ts_1,
-			    u32 dma_desc_ts_2, struct timespec64 *ts)
+			    u32 dma_desc_ts_2, struct timespec64 *ts,
+			    time64_t *tsu_sec)
 {
 	struct timespec64 tsu;
 
@@ -254,25 +255,30 @@ static int gem_hw_timestamp(struct macb *bp, u32 dma_desc_ts_1,
 
 	/* TSU overlapping workaround
 	 * The timestamp only contains lower few bits of seconds,
-	 * so add value from 1588 timer
+	 * so add value from 1588 timer. The timer is only read once per
+	 * batch of descriptors; any sample within half the descriptor
+	 * seconds range of the timestamp is good enough.
 	 */
-	gem_tsu_get_time(&bp->ptp_clock_info, &tsu, NULL);
+	if (*tsu_sec < 0) {
+		gem_tsu_get_time(&bp->ptp_clock_info, &tsu, NULL);
+		*tsu_sec = tsu.tv_sec;
+	}
 
-	ts->tv_sec |= ((~GEM_DMA_SEC_MASK) & tsu.tv_sec);
+	ts->tv_sec |= ((~GEM_DMA_SEC_MASK) & *tsu_sec);
 
-	/* If the top bit is set in the timestamp,
-	 * but not in 1588 timer, it has rolled over,
-	 * so subtract max size
+	/* Pick whichever wrap of the timestamp is closest to the
+	 * 1588 timer sample, which may be from either side of it.
 	 */
-	if ((ts->tv_sec & (GEM_DMA_SEC_TOP >> 1)) &&
-	    !(tsu.tv_sec & (GEM_DMA_SEC_TOP >> 1)))
+	if (ts->tv_sec > *tsu_sec + (GEM_DMA_SEC_TOP >> 1))
 		ts->tv_sec -= GEM_DMA_SEC_TOP;
+	else if (ts->tv_sec + (GEM_DMA_SEC_TOP >> 1) < *tsu_sec)
+		ts->tv_sec += GEM_DMA_SEC_TOP;
 
 	return 0;
 }
 
 void gem_ptp_rxstamp(struct macb *bp, struct sk_buff *skb,
-		     struct macb_dma_desc *desc)
+		     struct macb_dma_desc *desc, time64_t *tsu_sec)
 {
 	struct skb_shared_hwtstamps *shhwtstamps = skb_hwtstamps(skb);
 	struct macb_dma_desc_ptp *desc_ptp;
@@ -286,14 +292,15 @@ void gem_ptp_rxstamp(struct macb *bp, struct sk_buff *skb,
 					     "Timestamp not supported in BD\n");
 			return;
 		}
-		gem_hw_timestamp(bp, desc_ptp->ts_1, desc_ptp->ts_2, &ts);
+		gem_hw_timestamp(bp, desc_ptp->ts_1, desc_ptp->ts_2, &ts,
+				 tsu_sec);
 		memset(shhwtstamps, 0, sizeof(struct skb_shared_hwtstamps));
 		shhwtstamps->hwtstamp = ktime_set(ts.tv_sec, ts.tv_nsec);
 	}
 }
 
 void gem_ptp_txstamp(struct macb *bp, struct sk_buff *skb,
-		     struct macb_dma_desc *desc)
+		     struct macb_dma_desc *desc, time64_t *tsu_sec)
 {
 	struct skb_shared_hwtstamps shhwtstamps;
 	struct macb_dma_desc_ptp *desc_ptp;
@@ -315,7 +322,7 @@ void gem_ptp_txstamp(struct macb *bp, struct sk_buff *skb,
 
 	/* ensure ts_1/ts_2 is loaded after ctrl (TX_USED check) */
 	dma_rmb();
-	gem_hw_timestamp(bp, desc_ptp->ts_1, desc_ptp->ts_2, &ts);
+	gem_hw_timestamp(bp, desc_ptp->ts_1, desc_ptp->ts_2, &ts, tsu_sec);
 
 	memset(&shhwtstamps, 0, sizeof(shhwtstamps));
 	shhwtstamps.hwtstamp = ktime_set(ts.tv_sec, ts.tv_nsec);
@@ -15,6 +15,7 @@
 #include <linux/rtnetlink.h>
 #include <linux/iopoll.h>
 #include <linux/crc16.h>
+#include <linux/interrupt.h>
 #include "lan743x_main.h"
 #include "lan743x_ethtool.h"
 
@@ -451,8 +452,19 @@ static int lan743x_intr_register_isr(struct lan743x_adapter *adapter,
 		vector->context = NULL;
 		vector->int_mask = 0;
 		vector->flags = 0;
+		return ret;
 	}
-	return ret;
+
+	/* Spread the per channel vectors over the CPUs, vector 0 serves
+	 * everything else and keeps the default affinity.
+	 */
+	if (adapter->intr.using_vectors && vector_index) {
+		int cpu = cpumask_local_spread(vector_index - 1,
+					       dev_to_node(&adapter->pdev->dev));
+
+		irq_set_affinity_and_hint(vector->irq, cpumask_of(cpu));
+	}
+	return 0;
 }
 
 static void lan743x_intr_unregister_isr(struct lan743x_adapter *adapter,
@@ -461,6 +473,8 @@ static void lan743x_intr_unregister_isr(struct lan743x_adapter *adapter,
 	struct lan743x_vector *vector = &adapter->intr.vector_list
 					[vector_index];
 
+	if (adapter->intr.using_vectors && vector_index)
+		irq_update_affinity_hint(vector->irq, NULL);
 	free_irq(vector->irq, vector);
 	vector->handler = NULL;
 	vector->context = NULL;
@@ -3349,6 +3363,22 @@ static int lan743x_mdiobus_init(struct lan743x_adapter *adapter)
 	return ret;
 }
 
+/* Some PCIe host bridges demultiplex all MSIs from a single parent
+ * interrupt, so every vector is serviced on the same CPU whatever its
+ * affinity. Find out by trying to move a spare MSI-X vector.
+ */
+static bool lan743x_msix_affinity_supported(struct pci_dev *pdev)
+{
+	bool supported;
+
+	if (pci_alloc_irq_vectors(pdev, 1, 1, PCI_IRQ_MSIX) < 1)
+		return true;
+	supported = !irq_set_affinity(pci_irq_vector(pdev, 0),
+				      cpumask_of(cpumask_last(cpu_online_mask)));
+	pci_free_irq_vectors(pdev);
+	return supported;
+}
+
 /* lan743x_pcidev_probe - Device Initialization Routine
  * @pdev: PCI device information struct
  * @id: entry in lan743x_pci_tbl
@@ -3415,6 +3445,16 @@ static int lan743x_pcidev_probe(struct pci_dev *pdev,
 				    NETIF_F_HW_CSUM | NETIF_F_RXCSUM;
 	adapter->netdev->hw_features = adapter->netdev->features;
 
+	/* Without vector affinity, run NAPI in threads so the scheduler can
+	 * spread the channels. This is only the default, the sysfs "threaded"
+	 * attribute can still turn it off.
+	 */
+	if (!lan743x_msix_affinity_supported(pdev)) {
+		netif_info(adapter, probe, netdev,
+			   "vector affinity not supported, using threaded NAPI\n");
+		dev_set_threaded(netdev, true);
+	}
+
 	/* carrier off reporting is important to ethtool even BEFORE open */
 	netif_carrier_off(netdev);
 
@@ -5,6 +5,7 @@
 #include <linux/bitops.h>
 #include <linux/clk.h>
 #include <linux/compiler.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
@@ -28,8 +29,10 @@
 #include <linux/printk.h>
 #include <linux/regulator/consumer.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
 #include <linux/sizes.h>
 #include <linux/slab.h>
+#include <linux/smp.h>
 #include <linux/string.h>
 #include <linux/types.h>
 
@@ -181,6 +184,10 @@
 #define PCIE_MISC_UBUS_BAR10_CONFIG_REMAP_LO		0x413c
 #define PCIE_MISC_UBUS_BAR10_CONFIG_REMAP_HI		0x4140
 
+#define BRCM_NUM_PCIE_EXTRA_IN_WINS			7
+/* Largest inbound window brcm_pcie_encode_ibar_size() can describe */
+#define BRCM_PCIE_MAX_IN_WIN_SIZE			(1ULL << 36)
+
 /* AXI priority forwarding - automatic level-based */
 #define PCIE_MISC_TC_QUEUE_TO_QOS_MAP(x)		(0x4160 - (x) * 4)
 /* Defined in quarter-fullness */
@@ -314,6 +321,16 @@ struct subdev_regulators {
 	struct regulator_bulk_data supplies[];
 };
 
+struct brcm_msi;
+
+/* Per CPU queue of MSIs demultiplexed elsewhere but targeted at this CPU */
+struct brcm_msi_cpu {
+	call_single_data_t	csd;
+	struct brcm_msi		*msi;
+	unsigned long		queued;
+	DECLARE_BITMAP(pending, 64);
+};
+
 struct brcm_msi {
 	struct device		*dev;
 	void __iomem		*base;
@@ -330,6 +347,10 @@ struct brcm_msi {
 	int			nr; /* No. of MSI available, depends on chip */
 	/* This is the base pointer for interrupt status/set/clr regs */
 	void __iomem		*intr_base;
+	struct brcm_msi_cpu __percpu *cpu;
+	unsigned int		target_cpu[64];
+	/* Forwarded vectors, already acked by the demultiplexing handler */
+	DECLARE_BITMAP(acked, 64);
 };
 
 /* Internal PCIe Host Controller Information.*/
@@ -359,6 +380,7 @@ struct brcm_pcie {
 	struct subdev_regulators *sr;
 	bool			ep_wakeup_capable;
 	u32			tperst_clk_ms;
+	struct dentry		*debugfs;
 };
 
 static inline bool is_bmips(const struct brcm_pcie *pcie)
@@ -659,6 +681,56 @@ static struct msi_domain_info brcm_msi_domain_info = {
 	.chip	= &brcm_msi_irq_chip,
 };
 
+static void brcm_msi_ipi_handler(void *info)
+{
+	struct brcm_msi_cpu *mc = info;
+	unsigned long hwirq;
+
+	clear_bit(0, &mc->queued);
+	smp_mb__after_atomic();
+
+	for_each_set_bit(hwirq, mc->pending, 64)
+		if (test_and_clear_bit(hwirq, mc->pending))
+			generic_handle_domain_irq(mc->msi->inner_domain, hwirq);
+}
+
+/*
+ * All MSIs arrive on a single parent interrupt, so the status register is
+ * always read on the CPU that parent is routed to. Vectors whose affinity
+ * points elsewhere are handed over to their target CPU with an IPI, which
+ * lets endpoint queues with per-CPU vectors run their handlers (and the
+ * softirq work they raise) on different cores.
+ */
+static void brcm_msi_dispatch(struct brcm_msi *msi, unsigned long hwirq,
+			      unsigned long virq)
+{
+	unsigned int cpu = READ_ONCE(msi->target_cpu[hwirq]);
+	struct brcm_msi_cpu *mc;
+
+	if (cpu == smp_processor_id()) {
+		generic_handle_irq(virq);
+		return;
+	}
+
+	/*
+	 * Ack here, or the parent keeps firing until the target CPU gets
+	 * round to it. The flow handler there then skips its own ack, which
+	 * could otherwise clear an MSI that arrived in the meantime.
+	 */
+	set_bit(hwirq, msi->acked);
+	writel(1 << ((hwirq & 0x1f) + msi->legacy_shift),
+	       msi->intr_base + MSI_INT_CLR);
+
+	mc = per_cpu_ptr(msi->cpu, cpu);
+	set_bit(hwirq, mc->pending);
+	if (test_and_set_bit(0, &mc->queued))
+		return;
+
+	/* The target may have just gone offline, drain its queue here */
+	if (smp_call_function_single_async(cpu, &mc->csd))
+		brcm_msi_ipi_handler(mc);
+}
+
 static void brcm_pcie_msi_isr(struct irq_desc *desc)
 {
 	struct irq_chip *chip = irq_desc_get_chip(desc);
@@ -681,13 +753,13 @@ static void brcm_pcie_msi_isr(struct irq_desc *desc)
 		if (virq) {
 			found = true;
 			dev_dbg(dev, "MSI -> %ld\n", virq);
-			generic_handle_irq(virq);
+			brcm_msi_dispatch(msi, bit, virq);
 		}
 		virq = irq_find_mapping(msi->inner_domain, bit + 32);
 		if (virq) {
 			found = true;
 			dev_dbg(dev, "MSI -> %ld\n", virq);
-			generic_handle_irq(virq);
+			brcm_msi_dispatch(msi, bit + 32, virq);
 		}
 		if (!found)
 			dev_dbg(dev, "unexpected MSI\n");
@@ -708,7 +780,33 @@ static void brcm_msi_compose_msi_msg(struct irq_data *data, struct msi_msg *msg)
 static int brcm_msi_set_affinity(struct irq_data *irq_data,
 				 const struct cpumask *mask, bool force)
 {
-	return -EINVAL;
+	struct brcm_msi *msi = irq_data_get_irq_chip_data(irq_data);
+	unsigned long partner = irq_data->hwirq ^ 32;
+	unsigned int cpu;
+
+	/*
+	 * Vectors N and N + 32 share a status bit, and whichever CPU acks it
+	 * clears both. They must therefore be handled on the same CPU: once
+	 * one of them is in use, the other can only follow it.
+	 */
+	if (msi->nr > 32 && test_bit(partner, msi->used)) {
+		cpu = READ_ONCE(msi->target_cpu[partner]);
+		if (!cpumask_test_cpu(cpu, mask))
+			return -EINVAL;
+	} else if (force) {
+		cpu = cpumask_first(mask);
+	} else {
+		cpu = cpumask_any_and(mask, cpu_online_mask);
+	}
+
+	if (cpu >= nr_cpu_ids)
+		return -EINVAL;
+
+	/* The MSI message does not change, only where it is handled */
+	WRITE_ONCE(msi->target_cpu[irq_data->hwirq], cpu);
+	irq_data_update_effective_affinity(irq_data, cpumask_of(cpu));
+
+	return IRQ_SET_MASK_OK_DONE;
 }
 
 static void brcm_msi_ack_irq(struct irq_data *data)
@@ -716,6 +814,9 @@ static void brcm_msi_ack_irq(struct irq_data *data)
 	struct brcm_msi *msi = irq_data_get_irq_chip_data(data);
 	const int shift_amt = (data->hwirq & 0x1f) + msi->legacy_shift;
 
+	if (test_and_clear_bit(data->hwirq, msi->acked))
+		return;
+
 	writel(1 << shift_amt, msi->intr_base + MSI_INT_CLR);
 }
 
@@ -842,7 +943,7 @@ static void brcm_msi_set_regs(struct brcm_msi *msi)
 static int brcm_pcie_enable_msi(struct brcm_pcie *pcie)
 {
 	struct brcm_msi *msi;
-	int irq, ret;
+	int irq, ret, cpu;
 	struct device *dev = pcie->dev;
 
 	irq = irq_of_parse_and_map(dev->of_node, 1);
@@ -863,6 +964,17 @@ static int brcm_pcie_enable_msi(struct brcm_pcie *pcie)
 	msi->irq = irq;
 	msi->legacy = pcie->hw_rev < BRCM_PCIE_HW_REV_33;
 
+	msi->cpu = devm_alloc_percpu(dev, struct brcm_msi_cpu);
+	if (!msi->cpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct brcm_msi_cpu *mc = per_cpu_ptr(msi->cpu, cpu);
+
+		mc->msi = msi;
+		INIT_CSD(&mc->csd, brcm_msi_ipi_handler, mc);
+	}
+
 	/*
 	 * Sanity check to make sure that the 'used' bitmap in struct brcm_msi
 	 * is large enough.
@@ -1144,6 +1256,70 @@ static int brcm_pcie_get_rc_bar_n(struct brcm_pcie *pcie,
 	return -EINVAL;
 }
 
+static void brcm_pcie_set_extra_in_win(struct brcm_pcie *pcie, int win,
+				       u64 cpu_addr, u64 pci_addr, u64 size)
+{
+	void __iomem *base = pcie->base;
+	u32 tmp;
+
+	tmp = lower_32_bits(pci_addr);
+	u32p_replace_bits(&tmp, brcm_pcie_encode_ibar_size(size),
+			  PCIE_MISC_RC_BAR_CONFIG_LO_SIZE_MASK);
+	writel(tmp, base + PCIE_MISC_RC_BAR4_CONFIG_LO + win * 8);
+	writel(upper_32_bits(pci_addr),
+	       base + PCIE_MISC_RC_BAR4_CONFIG_HI + win * 8);
+
+	tmp = upper_32_bits(cpu_addr) &
+		PCIE_MISC_UBUS_BAR_CONFIG_REMAP_HI_MASK;
+	writel(tmp,
+	       base + PCIE_MISC_UBUS_BAR4_CONFIG_REMAP_HI + win * 8);
+	tmp = lower_32_bits(cpu_addr) &
+		PCIE_MISC_UBUS_BAR_CONFIG_REMAP_LO_MASK;
+	writel(tmp | PCIE_MISC_UBUS_BAR_CONFIG_REMAP_ENABLE,
+	       base + PCIE_MISC_UBUS_BAR4_CONFIG_REMAP_LO + win * 8);
+}
+
+static int brcm_pcie_check_ram_range(struct resource *res, void *arg)
+{
+	struct brcm_pcie *pcie = arg;
+	struct pci_host_bridge *bridge = pci_host_bridge_from_priv(pcie);
+	struct resource_entry *entry;
+	u64 start = res->start, end = (u64)res->end + 1;
+
+	while (start < end) {
+		u64 next = end;
+		bool covered = false;
+
+		resource_list_for_each_entry(entry, &bridge->dma_ranges) {
+			if (entry->res->start <= start && entry->res->end >= start) {
+				next = (u64)entry->res->end + 1;
+				covered = true;
+				break;
+			}
+			if (entry->res->start > start && entry->res->start < next)
+				next = entry->res->start;
+		}
+
+		if (!covered)
+			dev_dbg(pcie->dev,
+				"System RAM [mem %#010llx-%#010llx] outside dma-ranges, DMA to it will bounce\n",
+				start, next - 1);
+		start = next;
+	}
+
+	return 0;
+}
+
+/*
+ * Endpoint DMA to memory that no dma-ranges entry covers goes through
+ * swiotlb, which costs a copy per transfer. Say so once at probe time so
+ * a too small inbound view does not go unnoticed.
+ */
+static void brcm_pcie_check_dma_coverage(struct brcm_pcie *pcie)
+{
+	walk_system_ram_res(0, -1, pcie, brcm_pcie_check_ram_range);
+}
+
 static int brcm_pcie_setup(struct brcm_pcie *pcie)
 {
 	u64 rc_bar2_offset, rc_bar2_size;
@@ -1152,7 +1328,7 @@ static int brcm_pcie_setup(struct brcm_pcie *pcie)
 	struct resource_entry *entry;
 	u32 tmp, burst, aspm_support;
 	int num_out_wins = 0;
-	int ret, memc, count, i;
+	int ret, memc, count, i, win;
 
 	/* Reset the bridge */
 	pcie->bridge_sw_init_set(pcie, 1);
@@ -1305,9 +1481,14 @@ static int brcm_pcie_setup(struct brcm_pcie *pcie)
 		PCIE_RC_CFG_PRIV1_LINK_CAPABILITY_ASPM_SUPPORT_MASK);
 	writel(tmp, base + PCIE_RC_CFG_PRIV1_LINK_CAPABILITY);
 
-	/* program additional inbound windows (RC_BAR4..RC_BAR10) */
-	count = (pcie->type == BCM2712) ? 7 : 0;
-	for (i = 0; i < count; i++) {
+	/*
+	 * Program additional inbound windows (RC_BAR4..RC_BAR10). Each
+	 * window has to be a naturally aligned power of two, so dma-ranges
+	 * entries that are not get split over as many windows as needed
+	 * rather than silently truncated.
+	 */
+	count = (pcie->type == BCM2712) ? BRCM_NUM_PCIE_EXTRA_IN_WINS : 0;
+	for (i = 0, win = 0; win < count; i++) {
 		u64 bar_cpu, bar_size, bar_pci;
 
 		ret = brcm_pcie_get_rc_bar_n(pcie, 1 + i, &bar_cpu, &bar_size,
@@ -1315,21 +1496,24 @@ static int brcm_pcie_setup(struct brcm_pcie *pcie)
 		if (ret)
 			break;
 
-		tmp = lower_32_bits(bar_pci);
-		u32p_replace_bits(&tmp, brcm_pcie_encode_ibar_size(bar_size),
-				  PCIE_MISC_RC_BAR_CONFIG_LO_SIZE_MASK);
-		writel(tmp, base + PCIE_MISC_RC_BAR4_CONFIG_LO + i * 8);
-		writel(upper_32_bits(bar_pci),
-		       base + PCIE_MISC_RC_BAR4_CONFIG_HI + i * 8);
-
-		tmp = upper_32_bits(bar_cpu) &
-			PCIE_MISC_UBUS_BAR_CONFIG_REMAP_HI_MASK;
-		writel(tmp,
-		       base + PCIE_MISC_UBUS_BAR4_CONFIG_REMAP_HI + i * 8);
-		tmp = lower_32_bits(bar_cpu) &
-			PCIE_MISC_UBUS_BAR_CONFIG_REMAP_LO_MASK;
-		writel(tmp | PCIE_MISC_UBUS_BAR_CONFIG_REMAP_ENABLE,
-		       base + PCIE_MISC_UBUS_BAR4_CONFIG_REMAP_LO + i * 8);
+		while (bar_size && win < count) {
+			u64 chunk = 1ULL << (fls64(bar_size) - 1);
+
+			if (bar_cpu | bar_pci)
+				chunk = min(chunk, 1ULL << __ffs64(bar_cpu | bar_pci));
+			chunk = min(chunk, BRCM_PCIE_MAX_IN_WIN_SIZE);
+
+			brcm_pcie_set_extra_in_win(pcie, win++, bar_cpu,
+						   bar_pci, chunk);
+			bar_cpu += chunk;
+			bar_pci += chunk;
+			bar_size -= chunk;
+		}
+
+		if (bar_size)
+			dev_warn(pcie->dev,
+				 "out of inbound windows, [mem %#010llx-%#010llx] not mapped\n",
+				 bar_cpu, bar_cpu + bar_size - 1);
 	}
 
 	if (pcie->gen) {
@@ -1778,6 +1962,71 @@ static int brcm_pcie_resume_noirq(struct device *dev)
 	return ret;
 }
 
+/*
+ * This is a snapshot taken when the file is read. The controller has no
+ * residency or retrain counters, so rates and history are left to
+ * userspace sampling the file.
+ */
+static int brcm_pcie_link_state_show(struct seq_file *s, void *data)
+{
+	struct brcm_pcie *pcie = dev_get_drvdata(s->private);
+	void __iomem *base = pcie->base;
+	unsigned int cls, nlw;
+	u16 lnksta, lnkctl;
+	u32 tmp;
+
+	if (brcm_pcie_link_up(pcie)) {
+		lnksta = readw(base + BRCM_PCIE_CAP_REGS + PCI_EXP_LNKSTA);
+		cls = FIELD_GET(PCI_EXP_LNKSTA_CLS, lnksta);
+		nlw = FIELD_GET(PCI_EXP_LNKSTA_NLW, lnksta);
+		seq_printf(s, "link: up, %s x%u\n",
+			   pci_speed_string(pcie_link_speed[cls]), nlw);
+	} else {
+		seq_puts(s, "link: down\n");
+	}
+
+	lnkctl = readw(base + BRCM_PCIE_CAP_REGS + PCI_EXP_LNKCTL);
+	seq_printf(s, "aspm:%s%s\n",
+		   lnkctl & PCI_EXP_LNKCTL_ASPM_L0S ? " L0s" : "",
+		   lnkctl & PCI_EXP_LNKCTL_ASPM_L1 ? " L1" : "");
+
+	tmp = readl(base + PCIE_MISC_HARD_PCIE_HARD_DEBUG);
+	if (tmp & PCIE_MISC_HARD_PCIE_HARD_DEBUG_CLKREQ_L1SS_ENABLE_MASK)
+		seq_puts(s, "clkreq: l1ss\n");
+	else if (tmp & PCIE_MISC_HARD_PCIE_HARD_DEBUG_CLKREQ_DEBUG_ENABLE_MASK)
+		seq_puts(s, "clkreq: clkpm\n");
+	else
+		seq_puts(s, "clkreq: off\n");
+
+	return 0;
+}
+
+static void brcm_pcie_init_debugfs(struct brcm_pcie *pcie)
+{
+	struct device *dev = pcie->dev;
+	char *name;
+
+	name = devm_kasprintf(dev, GFP_KERNEL, "%pOFP", dev->of_node);
+	if (!name)
+		return;
+
+	pcie->debugfs = debugfs_create_dir(name, NULL);
+	if (IS_ERR(pcie->debugfs))
+		return;
+
+	debugfs_create_devm_seqfile(dev, "link_state", pcie->debugfs,
+				    brcm_pcie_link_state_show);
+}
+
+static void brcm_pcie_remove_debugfs(struct brcm_pcie *pcie)
+{
+	if (IS_ERR_OR_NULL(pcie->debugfs))
+		return;
+
+	debugfs_remove_recursive(pcie->debugfs);
+	pcie->debugfs = NULL;
+}
+
 static void __brcm_pcie_remove(struct brcm_pcie *pcie)
 {
 	brcm_msi_remove(pcie);
@@ -1794,6 +2043,7 @@ static void brcm_pcie_remove(struct platform_device *pdev)
 	struct brcm_pcie *pcie = platform_get_drvdata(pdev);
 	struct pci_host_bridge *bridge = pci_host_bridge_from_priv(pcie);
 
+	brcm_pcie_remove_debugfs(pcie);
 	pci_stop_root_bus(bridge->bus);
 	pci_remove_root_bus(bridge->bus);
 	__brcm_pcie_remove(pcie);
@@ -1994,6 +2244,8 @@ static int brcm_pcie_probe(struct platform_device *pdev)
 	if (ret)
 		goto fail;
 
+	brcm_pcie_check_dma_coverage(pcie);
+
 	pcie->hw_rev = readl(pcie->base + PCIE_MISC_REVISION);
 	if (pcie->type == BCM4908 && pcie->hw_rev >= BRCM_PCIE_HW_REV_3_20) {
 		dev_err(pcie->dev, "hardware revision with unsupported PERST# setup\n");
@@ -2052,6 +2304,7 @@ static int brcm_pcie_probe(struct platform_device *pdev)
 	}
 
 	brcm_pcie_config_clkreq(pcie);
+	brcm_pcie_init_debugfs(pcie);
 
 	return 0;
 
@@ -695,6 +695,70 @@ static void rp1_gpio_set(struct gpio_chip *chip, unsigned offset, int value)
 		rp1_set_value(pin, value);
 }
 
+/*
+ * Extract the part of a chip-wide bitmap belonging to one bank, so that it
+ * can be applied with a single access to the bank's RIO registers.
+ */
+static u32 rp1_bank_bits(const struct rp1_iobank_desc *bank,
+			 const unsigned long *bitmap)
+{
+	u32 bits = 0;
+	int i;
+
+	for (i = 0; i < bank->num_gpios; i++) {
+		if (test_bit(bank->min_gpio + i, bitmap))
+			bits |= 1 << i;
+	}
+
+	return bits;
+}
+
+static int rp1_gpio_get_multiple(struct gpio_chip *chip, unsigned long *mask,
+				 unsigned long *bits)
+{
+	struct rp1_pinctrl *pc = gpiochip_get_data(chip);
+	int b, i;
+
+	for (b = 0; b < RP1_NUM_BANKS; b++) {
+		const struct rp1_iobank_desc *bank = &rp1_iobanks[b];
+		u32 bank_mask = rp1_bank_bits(bank, mask);
+		u32 in;
+
+		if (!bank_mask)
+			continue;
+
+		in = readl(pc->pins[bank->min_gpio].rio + RP1_RIO_IN);
+		for (i = 0; i < bank->num_gpios; i++) {
+			if (bank_mask & (1 << i))
+				__assign_bit(bank->min_gpio + i, bits,
+					     in & (1 << i));
+		}
+	}
+
+	return 0;
+}
+
+static void rp1_gpio_set_multiple(struct gpio_chip *chip, unsigned long *mask,
+				  unsigned long *bits)
+{
+	struct rp1_pinctrl *pc = gpiochip_get_data(chip);
+	int b;
+
+	for (b = 0; b < RP1_NUM_BANKS; b++) {
+		const struct rp1_iobank_desc *bank = &rp1_iobanks[b];
+		u32 bank_mask = rp1_bank_bits(bank, mask);
+		u32 bank_bits = rp1_bank_bits(bank, bits) & bank_mask;
+		void __iomem *rio = pc->pins[bank->min_gpio].rio;
+
+		/* Assume the pins are already outputs */
+		if (bank_bits)
+			writel(bank_bits, rio + RP1_RIO_OUT + RP1_SET_OFFSET);
+		if (bank_mask & ~bank_bits)
+			writel(bank_mask & ~bank_bits,
+			       rio + RP1_RIO_OUT + RP1_CLR_OFFSET);
+	}
+}
+
 static int rp1_gpio_get_direction(struct gpio_chip *chip, unsigned int offset)
 {
 	struct rp1_pin_info *pin = rp1_get_pin(chip, offset);
@@ -754,6 +818,8 @@ static const struct gpio_chip rp1_gpio_chip = {
 	.get_direction = rp1_gpio_get_direction,
 	.get = rp1_gpio_get,
 	.set = rp1_gpio_set,
+	.get_multiple = rp1_gpio_get_multiple,
+	.set_multiple = rp1_gpio_set_multiple,
 	.base = -1,
 	.set_config = rp1_gpio_set_config,
 	.ngpio = RP1_NUM_GPIOS,
@@ -779,15 +845,15 @@ static void rp1_gpio_irq_handler(struct irq_desc *desc)
 
 	chained_irq_enter(host_chip, desc);
 
+	/*
+	 * One read gives the pending status of the whole bank. The latched
+	 * events are cleared by the flow handler through irq_ack, so there
+	 * is no need to reset them here as well.
+	 */
 	ints = readl(pc->gpio_base + bank->ints_offset);
-	for_each_set_bit(b, &ints, 32) {
-		struct rp1_pin_info *pin = rp1_get_pin(chip, b);
-
-		writel(RP1_GPIO_CTRL_IRQRESET,
-		       pin->gpio + RP1_SET_OFFSET + RP1_GPIO_CTRL);
-		generic_handle_irq(irq_linear_revmap(pc->gpio_chip.irq.domain,
-						     bank->gpio_offset + b));
-	}
+	for_each_set_bit(b, &ints, bank->num_gpios)
+		generic_handle_domain_irq(pc->gpio_chip.irq.domain,
+					  bank->min_gpio + b);
 
 	chained_irq_exit(host_chip, desc);
 }
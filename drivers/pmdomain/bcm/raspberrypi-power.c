@@ -6,10 +6,14 @@
  * Eric Anholt <eric@anholt.net>
  */
 
+#include <linux/ktime.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/platform_device.h>
 #include <linux/pm_domain.h>
+#include <linux/suspend.h>
+#include <linux/workqueue.h>
 #include <dt-bindings/power/raspberrypi-power.h>
 #include <soc/bcm2835/raspberrypi-firmware.h>
 
@@ -20,18 +24,40 @@
 #define RPI_OLD_POWER_DOMAIN_USB		3
 #define RPI_OLD_POWER_DOMAIN_V3D		10
 
+static unsigned int keep_warm_ms = 100;
+module_param(keep_warm_ms, uint, 0644);
+MODULE_PARM_DESC(keep_warm_ms, "Longest time a domain that is reused quickly is kept powered after release, 0 to disable. Default is 100.");
+
+struct rpi_power_domains;
+
 struct rpi_power_domain {
 	u32 domain;
 	bool enabled;
 	bool old_interface;
 	struct generic_pm_domain base;
 	struct rpi_firmware *fw;
+	struct rpi_power_domains *domains;
+
+	/*
+	 * Keep-warm state: a power off requested by genpd may be deferred
+	 * so that a quick power on finds the domain still up and skips the
+	 * firmware round trips in both directions.
+	 */
+	struct mutex lock;
+	struct delayed_work off_work;
+	bool off_pending;
+	ktime_t last_off;
+	/* Moving average of the off to on interval, in ns */
+	u64 avg_gap_ns;
 };
 
 struct rpi_power_domains {
 	bool has_new_interface;
 	struct genpd_onecell_data xlate;
 	struct rpi_firmware *fw;
+	struct notifier_block pm_nb;
+	/* No deferred power off across system suspend */
+	bool suspending;
 	struct rpi_power_domain domains[RPI_POWER_DOMAIN_COUNT];
 };
 
@@ -61,20 +87,105 @@ static int rpi_firmware_set_power(struct rpi_power_domain *rpi_domain, bool on)
 				     &packet, sizeof(packet));
 }
 
+static void rpi_domain_off_work(struct work_struct *work)
+{
+	struct rpi_power_domain *rpi_domain =
+		container_of(work, struct rpi_power_domain, off_work.work);
+
+	mutex_lock(&rpi_domain->lock);
+	if (rpi_domain->off_pending) {
+		rpi_domain->off_pending = false;
+		rpi_firmware_set_power(rpi_domain, false);
+	}
+	mutex_unlock(&rpi_domain->lock);
+}
+
+/*
+ * How long to keep the domain up after genpd released it: twice the
+ * typical reuse interval if the domain has been coming back quickly,
+ * nothing otherwise.
+ */
+static unsigned long rpi_domain_keep_warm(struct rpi_power_domain *rpi_domain)
+{
+	u64 max_ns = (u64)READ_ONCE(keep_warm_ms) * NSEC_PER_MSEC;
+
+	if (!rpi_domain->avg_gap_ns || rpi_domain->avg_gap_ns > max_ns / 2)
+		return 0;
+
+	return nsecs_to_jiffies(2 * rpi_domain->avg_gap_ns);
+}
+
 static int rpi_domain_off(struct generic_pm_domain *domain)
 {
 	struct rpi_power_domain *rpi_domain =
 		container_of(domain, struct rpi_power_domain, base);
+	struct rpi_power_domains *rpi_domains = rpi_domain->domains;
+	unsigned long delay;
+	int ret = 0;
+
+	mutex_lock(&rpi_domain->lock);
+	rpi_domain->last_off = ktime_get();
+	delay = READ_ONCE(rpi_domains->suspending) ?
+		0 : rpi_domain_keep_warm(rpi_domain);
+	if (delay) {
+		rpi_domain->off_pending = true;
+		schedule_delayed_work(&rpi_domain->off_work, delay);
+	} else {
+		ret = rpi_firmware_set_power(rpi_domain, false);
+	}
+	mutex_unlock(&rpi_domain->lock);
 
-	return rpi_firmware_set_power(rpi_domain, false);
+	return ret;
 }
 
 static int rpi_domain_on(struct generic_pm_domain *domain)
 {
 	struct rpi_power_domain *rpi_domain =
 		container_of(domain, struct rpi_power_domain, base);
+	u64 gap;
+	int ret = 0;
+
+	mutex_lock(&rpi_domain->lock);
+	if (rpi_domain->last_off) {
+		gap = ktime_to_ns(ktime_sub(ktime_get(), rpi_domain->last_off));
+		rpi_domain->avg_gap_ns = rpi_domain->avg_gap_ns ?
+			(3 * rpi_domain->avg_gap_ns + gap) / 4 : gap;
+	}
+
+	if (rpi_domain->off_pending) {
+		/* Still up, the deferred off simply doesn't happen */
+		rpi_domain->off_pending = false;
+		cancel_delayed_work(&rpi_domain->off_work);
+	} else {
+		ret = rpi_firmware_set_power(rpi_domain, true);
+	}
+	mutex_unlock(&rpi_domain->lock);
 
-	return rpi_firmware_set_power(rpi_domain, true);
+	return ret;
+}
+
+static int rpi_power_pm_notifier(struct notifier_block *nb,
+				 unsigned long action, void *data)
+{
+	struct rpi_power_domains *rpi_domains =
+		container_of(nb, struct rpi_power_domains, pm_nb);
+	int i;
+
+	switch (action) {
+	case PM_SUSPEND_PREPARE:
+	case PM_HIBERNATION_PREPARE:
+		WRITE_ONCE(rpi_domains->suspending, true);
+		for (i = 0; i < RPI_POWER_DOMAIN_COUNT; i++)
+			if (rpi_domains->domains[i].base.name)
+				flush_delayed_work(&rpi_domains->domains[i].off_work);
+		break;
+	case PM_POST_SUSPEND:
+	case PM_POST_HIBERNATION:
+		WRITE_ONCE(rpi_domains->suspending, false);
+		break;
+	}
+
+	return NOTIFY_DONE;
 }
 
 static void rpi_common_init_power_domain(struct rpi_power_domains *rpi_domains,
@@ -83,6 +194,9 @@ static void rpi_common_init_power_domain(struct rpi_power_domains *rpi_domains,
 	struct rpi_power_domain *dom = &rpi_domains->domains[xlate_index];
 
 	dom->fw = rpi_domains->fw;
+	dom->domains = rpi_domains;
+	mutex_init(&dom->lock);
+	INIT_DELAYED_WORK(&dom->off_work, rpi_domain_off_work);
 
 	dom->base.name = name;
 	dom->base.power_on = rpi_domain_on;
@@ -220,6 +334,9 @@ static int rpi_power_probe(struct platform_device *pdev)
 
 	of_genpd_add_provider_onecell(dev->of_node, &rpi_domains->xlate);
 
+	rpi_domains->pm_nb.notifier_call = rpi_power_pm_notifier;
+	register_pm_notifier(&rpi_domains->pm_nb);
+
 	platform_set_drvdata(pdev, rpi_domains);
 
 	return 0;
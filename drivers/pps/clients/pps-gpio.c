@@ -18,6 +18,7 @@
 #include <linux/slab.h>
 #include <linux/pps_kernel.h>
 #include <linux/gpio/consumer.h>
+#include <linux/hte.h>
 #include <linux/list.h>
 #include <linux/property.h>
 #include <linux/timer.h>
@@ -31,6 +32,8 @@ struct pps_gpio_device_data {
 	struct gpio_desc *gpio_pin;	/* GPIO port descriptors */
 	struct gpio_desc *echo_pin;
 	struct timer_list echo_timer;	/* timer to reset echo active state */
+	struct hte_ts_desc hdesc;	/* hardware timestamp descriptor */
+	bool use_hte;			/* timestamp edges with HTE, not IRQ */
 	bool assert_falling_edge;
 	bool capture_clear;
 	unsigned int echo_active_ms;	/* PPS echo active duration */
@@ -64,6 +67,41 @@ static irqreturn_t pps_gpio_irq_handler(int irq, void *data)
 	return IRQ_HANDLED;
 }
 
+/*
+ * Report the PPS event timestamped by a hardware timestamp engine
+ *
+ * The engine latches the edge in CLOCK_MONOTONIC nanoseconds, so the
+ * interrupt latency is only the distance between that and "now", which
+ * is subtracted from a fresh system time sample.
+ */
+static enum hte_return pps_gpio_hte_handler(struct hte_ts_data *hts,
+					    void *data)
+{
+	const struct pps_gpio_device_data *info = data;
+	struct pps_event_time ts;
+	ktime_t now, delta;
+	int rising_edge;
+
+	now = ktime_get();
+	pps_get_ts(&ts);
+
+	delta = ktime_sub(now, ns_to_ktime(hts->tsc));
+	if (delta > 0)
+		pps_sub_ts(&ts, ktime_to_timespec64(delta));
+
+	if (hts->raw_level >= 0)
+		rising_edge = hts->raw_level;
+	else
+		rising_edge = gpiod_get_raw_value(info->gpio_pin);
+
+	if (rising_edge != info->assert_falling_edge)
+		pps_event(info->pps, &ts, PPS_CAPTUREASSERT, data);
+	else if (info->capture_clear)
+		pps_event(info->pps, &ts, PPS_CAPTURECLEAR, data);
+
+	return HTE_CB_HANDLED;
+}
+
 /* This function will only be called when an ECHO GPIO is defined */
 static void pps_gpio_echo(struct pps_device *pps, int event, void *data)
 {
@@ -121,6 +159,8 @@ static int pps_gpio_setup(struct device *dev)
 		return dev_err_probe(dev, PTR_ERR(data->echo_pin),
 				     "failed to request ECHO GPIO\n");
 
+	data->use_hte = of_hte_req_count(dev) > 0;
+
 	if (!data->echo_pin)
 		return 0;
 
@@ -155,6 +195,41 @@ get_irqf_trigger_flags(const struct pps_gpio_device_data *data)
 	return flags;
 }
 
+static int pps_gpio_hte_setup(struct device *dev)
+{
+	struct pps_gpio_device_data *data = dev_get_drvdata(dev);
+	struct hte_clk_info ci;
+	unsigned long flags = data->assert_falling_edge ?
+		HTE_FALLING_EDGE_TS : HTE_RISING_EDGE_TS;
+	int ret;
+
+	if (data->capture_clear)
+		flags |= HTE_RISING_EDGE_TS | HTE_FALLING_EDGE_TS;
+
+	hte_init_line_attr(&data->hdesc, desc_to_gpio(data->gpio_pin), flags,
+			   data->info.name, data->gpio_pin);
+
+	ret = hte_ts_get(dev, &data->hdesc, 0);
+	if (ret)
+		return dev_err_probe(dev, ret,
+				     "failed to get hardware timestamp\n");
+
+	ret = hte_get_clk_src_info(&data->hdesc, &ci);
+	if (!ret && ci.type != CLOCK_MONOTONIC) {
+		dev_err(dev, "unsupported timestamp clock %d\n", ci.type);
+		ret = -EINVAL;
+	}
+	if (!ret)
+		ret = hte_request_ts_ns(&data->hdesc, pps_gpio_hte_handler,
+					NULL, data);
+	if (ret) {
+		hte_ts_put(&data->hdesc);
+		return ret;
+	}
+
+	return 0;
+}
+
 static int pps_gpio_probe(struct platform_device *pdev)
 {
 	struct pps_gpio_device_data *data;
@@ -175,12 +250,14 @@ static int pps_gpio_probe(struct platform_device *pdev)
 		return ret;
 
 	/* IRQ setup */
-	ret = gpiod_to_irq(data->gpio_pin);
-	if (ret < 0) {
-		dev_err(dev, "failed to map GPIO to IRQ: %d\n", ret);
-		return -EINVAL;
+	if (!data->use_hte) {
+		ret = gpiod_to_irq(data->gpio_pin);
+		if (ret < 0) {
+			dev_err(dev, "failed to map GPIO to IRQ: %d\n", ret);
+			return -EINVAL;
+		}
+		data->irq = ret;
 	}
-	data->irq = ret;
 
 	/* initialize PPS specific parts of the bookkeeping data structure. */
 	data->info.mode = PPS_CAPTUREASSERT | PPS_OFFSETASSERT |
@@ -208,6 +285,19 @@ static int pps_gpio_probe(struct platform_device *pdev)
 		return PTR_ERR(data->pps);
 	}
 
+	if (data->use_hte) {
+		ret = pps_gpio_hte_setup(dev);
+		if (ret) {
+			pps_unregister_source(data->pps);
+			return ret;
+		}
+
+		dev_info(data->pps->dev,
+			 "Registered hardware timestamped GPIO as PPS source\n");
+
+		return 0;
+	}
+
 	/* register IRQ interrupt handler */
 	ret = devm_request_irq(dev, data->irq, pps_gpio_irq_handler,
 			get_irqf_trigger_flags(data), data->info.name, data);
@@ -227,6 +317,8 @@ static int pps_gpio_remove(struct platform_device *pdev)
 {
 	struct pps_gpio_device_data *data = platform_get_drvdata(pdev);
 
+	if (data->use_hte)
+		hte_ts_put(&data->hdesc);
 	pps_unregister_source(data->pps);
 	del_timer_sync(&data->echo_timer);
 	/* reset echo pin in any case */
@@ -14,14 +14,25 @@
 
 #include <linux/bitops.h>
 #include <linux/clk.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/iopoll.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
+#include <linux/of_address.h>
 #include <linux/platform_device.h>
 #include <linux/pwm.h>
+#include <linux/rp1_platform.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/sysfs.h>
 
 #define PWM_GLOBAL_CTRL		0x000
+#define PWM_FIFO_CTRL		0x004
+#define PWM_DUTY_FIFO		0x010
 #define PWM_CHANNEL_CTRL(x)	(0x014 + ((x) * 16))
 #define PWM_RANGE(x)		(0x018 + ((x) * 16))
 #define PWM_DUTY(x)		(0x020 + ((x) * 16))
@@ -30,14 +41,31 @@
 #define PWM_CHANNEL_DEFAULT	(BIT(8) + BIT(0))
 #define PWM_CHANNEL_ENABLE(x)	BIT(x)
 #define PWM_POLARITY		BIT(3)
+#define PWM_USEFIFO		BIT(5)
 #define SET_UPDATE		BIT(31)
 #define PWM_MODE_MASK		GENMASK(1, 0)
 
+#define PWM_FIFO_FLUSH		BIT(5)
+#define PWM_FIFO_FLUSH_DONE	BIT(6)
+#define PWM_FIFO_DREQ_EN	BIT(31)
+
+#define PWM_WAVE_MAX_BYTES	SZ_256K
+
 struct rp1_pwm {
 	struct pwm_chip chip;
 	struct device *dev;
 	void __iomem *base;
 	struct clk *clk;
+
+	/* waveform playback, the duty FIFO is shared by all channels */
+	struct mutex wave_lock;
+	struct dma_chan *dma;
+	dma_addr_t fifo_dma_addr;
+	struct pwm_device *wave_pwm;
+	u32 *wave_buf;
+	u32 __iomem *wave_sram;
+	dma_addr_t wave_dma;
+	size_t wave_size;
 };
 
 static inline struct rp1_pwm *to_rp1_pwm(struct pwm_chip *chip)
@@ -45,6 +73,8 @@ static inline struct rp1_pwm *to_rp1_pwm(struct pwm_chip *chip)
 	return container_of(chip, struct rp1_pwm, chip);
 }
 
+static void rp1_pwm_stop_waveform(struct pwm_device *pwm);
+
 static void rp1_pwm_apply_config(struct pwm_chip *chip, struct pwm_device *pwm)
 {
 	struct rp1_pwm *pc = to_rp1_pwm(chip);
@@ -68,6 +98,8 @@ static void rp1_pwm_free(struct pwm_chip *chip, struct pwm_device *pwm)
 	struct rp1_pwm *pc = to_rp1_pwm(chip);
 	u32 value;
 
+	rp1_pwm_stop_waveform(pwm);
+
 	value = readl(pc->base + PWM_CHANNEL_CTRL(pwm->hwpwm));
 	value &= ~PWM_MODE_MASK;
 	writel(value, pc->base + PWM_CHANNEL_CTRL(pwm->hwpwm));
@@ -125,6 +157,271 @@ static const struct pwm_ops rp1_pwm_ops = {
 	.owner = THIS_MODULE,
 };
 
+static int rp1_pwm_flush_fifo(struct rp1_pwm *pc)
+{
+	u32 value;
+
+	writel(PWM_FIFO_FLUSH, pc->base + PWM_FIFO_CTRL);
+	return readl_poll_timeout(pc->base + PWM_FIFO_CTRL, value,
+				  value & PWM_FIFO_FLUSH_DONE, 1, 1000);
+}
+
+static void rp1_pwm_release_wave(struct rp1_pwm *pc)
+{
+	if (pc->wave_sram)
+		rp1_sram_free(pc->wave_sram, pc->wave_size);
+	else
+		dma_free_coherent(pc->dma->device->dev, pc->wave_size,
+				  pc->wave_buf, pc->wave_dma);
+	pc->wave_sram = NULL;
+	pc->wave_buf = NULL;
+	pc->wave_pwm = NULL;
+}
+
+/* Called with wave_lock held and a waveform playing */
+static void rp1_pwm_stop_wave(struct rp1_pwm *pc)
+{
+	struct pwm_device *pwm = pc->wave_pwm;
+	u32 value;
+
+	value = readl(pc->base + PWM_CHANNEL_CTRL(pwm->hwpwm));
+	writel(value & ~PWM_USEFIFO, pc->base + PWM_CHANNEL_CTRL(pwm->hwpwm));
+	rp1_pwm_apply_config(pwm->chip, pwm);
+
+	dmaengine_terminate_sync(pc->dma);
+	writel(0, pc->base + PWM_FIFO_CTRL);
+	rp1_pwm_flush_fifo(pc);
+	rp1_pwm_release_wave(pc);
+}
+
+/**
+ * rp1_pwm_start_waveform() - play a sequence of duty cycles on a channel
+ * @pwm: a requested and enabled RP1 PWM channel
+ * @duty_ns: duty cycles in nanoseconds, one per period
+ * @count: number of entries in @duty_ns
+ * @repeat: loop the sequence until stopped rather than playing it once
+ *
+ * The sequence is copied and streamed into the duty FIFO by DMA, the
+ * channel takes the next entry at the end of each period. The period set
+ * with pwm_apply_state() therefore is the sample rate. Once a single-shot
+ * sequence has run out the channel keeps its last duty cycle until
+ * rp1_pwm_stop_waveform() is called. Only one channel can play a
+ * waveform at a time.
+ *
+ * Return: 0 on success or a negative error code.
+ */
+static int rp1_pwm_start_waveform(struct pwm_device *pwm, const u32 *duty_ns,
+				  unsigned int count, bool repeat)
+{
+	struct rp1_pwm *pc = to_rp1_pwm(pwm->chip);
+	struct dma_async_tx_descriptor *desc;
+	unsigned long clk_rate, clk_period;
+	unsigned int i;
+	u32 value;
+	int ret;
+
+	if (!pc->dma)
+		return -EOPNOTSUPP;
+
+	if (!count || count > PWM_WAVE_MAX_BYTES / sizeof(u32))
+		return -EINVAL;
+
+	clk_rate = clk_get_rate(pc->clk);
+	if (!clk_rate)
+		return -EINVAL;
+	clk_period = DIV_ROUND_CLOSEST(NSEC_PER_SEC, clk_rate);
+
+	mutex_lock(&pc->wave_lock);
+
+	/* Checked under the lock, rp1_pwm_free() stops the waveform */
+	if (!test_bit(PWMF_REQUESTED, &pwm->flags)) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+
+	if (pc->wave_pwm) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	pc->wave_size = count * sizeof(u32);
+
+	/* RP1 SRAM saves the DMA a PCIe round trip for every sample */
+	pc->wave_sram = rp1_sram_alloc(pc->wave_size, &pc->wave_dma);
+	if (!pc->wave_sram) {
+		pc->wave_buf = dma_alloc_coherent(pc->dma->device->dev,
+						  pc->wave_size, &pc->wave_dma,
+						  GFP_KERNEL);
+		if (!pc->wave_buf) {
+			ret = -ENOMEM;
+			goto unlock;
+		}
+	}
+	pc->wave_pwm = pwm;
+
+	for (i = 0; i < count; i++) {
+		u32 duty = DIV_ROUND_CLOSEST(duty_ns[i], clk_period);
+
+		if (pc->wave_sram)
+			writel_relaxed(duty, pc->wave_sram + i);
+		else
+			pc->wave_buf[i] = duty;
+	}
+	/* The SRAM mapping is write-combined */
+	wmb();
+
+	ret = rp1_pwm_flush_fifo(pc);
+	if (ret)
+		goto release;
+
+	if (repeat)
+		desc = dmaengine_prep_dma_cyclic(pc->dma, pc->wave_dma,
+						 pc->wave_size, pc->wave_size,
+						 DMA_MEM_TO_DEV,
+						 DMA_PREP_INTERRUPT);
+	else
+		desc = dmaengine_prep_slave_single(pc->dma, pc->wave_dma,
+						   pc->wave_size,
+						   DMA_MEM_TO_DEV,
+						   DMA_PREP_INTERRUPT);
+	if (!desc) {
+		ret = -EIO;
+		goto release;
+	}
+
+	ret = dma_submit_error(dmaengine_submit(desc));
+	if (ret)
+		goto release;
+
+	writel(PWM_FIFO_DREQ_EN, pc->base + PWM_FIFO_CTRL);
+	dma_async_issue_pending(pc->dma);
+
+	value = readl(pc->base + PWM_CHANNEL_CTRL(pwm->hwpwm));
+	writel(value | PWM_USEFIFO, pc->base + PWM_CHANNEL_CTRL(pwm->hwpwm));
+	rp1_pwm_apply_config(pwm->chip, pwm);
+
+	mutex_unlock(&pc->wave_lock);
+
+	return 0;
+
+release:
+	rp1_pwm_release_wave(pc);
+unlock:
+	mutex_unlock(&pc->wave_lock);
+	return ret;
+}
+
+/**
+ * rp1_pwm_stop_waveform() - return a channel to its fixed duty cycle
+ * @pwm: the RP1 PWM channel passed to rp1_pwm_start_waveform()
+ *
+ * Does nothing if @pwm is not playing a waveform.
+ */
+static void rp1_pwm_stop_waveform(struct pwm_device *pwm)
+{
+	struct rp1_pwm *pc = to_rp1_pwm(pwm->chip);
+
+	mutex_lock(&pc->wave_lock);
+	if (pc->wave_pwm == pwm)
+		rp1_pwm_stop_wave(pc);
+	mutex_unlock(&pc->wave_lock);
+}
+
+/*
+ * Writing "<channel> <repeat> <duty_ns> [<duty_ns> ...]" plays the sequence
+ * of duty cycles on a requested channel, looping it if <repeat> is non-zero.
+ * Writing just "<channel>" stops the waveform playing on that channel.
+ */
+static ssize_t waveform_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct rp1_pwm *pc = dev_get_drvdata(dev);
+	unsigned int channel, repeat, n = 0;
+	struct pwm_device *pwm;
+	int pos, len, ret;
+	u32 *duty;
+
+	if (sscanf(buf, "%u %n", &channel, &pos) != 1 ||
+	    channel >= pc->chip.npwm)
+		return -EINVAL;
+
+	pwm = &pc->chip.pwms[channel];
+
+	if (!buf[pos]) {
+		rp1_pwm_stop_waveform(pwm);
+		return count;
+	}
+
+	if (sscanf(buf + pos, "%u %n", &repeat, &len) != 1)
+		return -EINVAL;
+	pos += len;
+
+	/* Every entry takes at least two characters */
+	duty = kcalloc(count / 2 + 1, sizeof(*duty), GFP_KERNEL);
+	if (!duty)
+		return -ENOMEM;
+
+	while (buf[pos] && sscanf(buf + pos, "%u %n", &duty[n], &len) == 1) {
+		pos += len;
+		n++;
+	}
+
+	if (buf[pos])
+		ret = -EINVAL;
+	else
+		ret = rp1_pwm_start_waveform(pwm, duty, n, repeat);
+
+	kfree(duty);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_WO(waveform);
+
+static struct attribute *rp1_pwm_attrs[] = {
+	&dev_attr_waveform.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(rp1_pwm);
+
+static int rp1_pwm_init_dma(struct rp1_pwm *pc, struct resource *res)
+{
+	struct dma_slave_config config = {};
+	const __be32 *addr;
+	int ret;
+
+	pc->dma = dma_request_chan(pc->dev, "tx");
+	if (IS_ERR(pc->dma)) {
+		ret = PTR_ERR(pc->dma);
+		pc->dma = NULL;
+		/* Waveform playback is optional */
+		return ret == -ENODEV ? 0 : ret;
+	}
+
+	/* The DMA controller sees the FIFO at its RP1 bus address */
+	pc->fifo_dma_addr = res->start + PWM_DUTY_FIFO;
+	addr = of_get_address(pc->dev->of_node, 0, NULL, NULL);
+	if (addr) {
+		u64 dma_addr = of_translate_dma_address(pc->dev->of_node, addr);
+
+		if (dma_addr != OF_BAD_ADDR)
+			pc->fifo_dma_addr = dma_addr + PWM_DUTY_FIFO;
+	}
+
+	config.direction = DMA_MEM_TO_DEV;
+	config.dst_addr = pc->fifo_dma_addr;
+	config.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
+	config.dst_maxburst = 1;
+
+	ret = dmaengine_slave_config(pc->dma, &config);
+	if (ret) {
+		dma_release_channel(pc->dma);
+		pc->dma = NULL;
+	}
+
+	return ret;
+}
+
 static int rp1_pwm_probe(struct platform_device *pdev)
 {
 	struct rp1_pwm *pc;
@@ -136,6 +433,7 @@ static int rp1_pwm_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	pc->dev = &pdev->dev;
+	mutex_init(&pc->wave_lock);
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	pc->base = devm_ioremap_resource(&pdev->dev, res);
@@ -151,6 +449,12 @@ static int rp1_pwm_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	ret = rp1_pwm_init_dma(pc, res);
+	if (ret) {
+		dev_err_probe(&pdev->dev, ret, "failed to set up DMA\n");
+		goto add_fail;
+	}
+
 	pc->chip.dev = &pdev->dev;
 	pc->chip.ops = &rp1_pwm_ops;
 	pc->chip.base = -1;
@@ -167,6 +471,8 @@ static int rp1_pwm_probe(struct platform_device *pdev)
 	return 0;
 
 add_fail:
+	if (pc->dma)
+		dma_release_channel(pc->dma);
 	clk_disable_unprepare(pc->clk);
 	return ret;
 }
@@ -175,10 +481,19 @@ static int rp1_pwm_remove(struct platform_device *pdev)
 {
 	struct rp1_pwm *pc = platform_get_drvdata(pdev);
 
-	clk_disable_unprepare(pc->clk);
-
 	pwmchip_remove(&pc->chip);
 
+	/* The DMA may still be feeding the FIFO from wave_buf */
+	mutex_lock(&pc->wave_lock);
+	if (pc->wave_pwm)
+		rp1_pwm_stop_wave(pc);
+	mutex_unlock(&pc->wave_lock);
+
+	if (pc->dma)
+		dma_release_channel(pc->dma);
+
+	clk_disable_unprepare(pc->clk);
+
 	return 0;
 }
 
@@ -192,6 +507,7 @@ static struct platform_driver rp1_pwm_driver = {
 	.driver = {
 		.name = "rpi-pwm",
 		.of_match_table = rp1_pwm_of_match,
+		.dev_groups = rp1_pwm_groups,
 	},
 	.probe = rp1_pwm_probe,
 	.remove = rp1_pwm_remove,
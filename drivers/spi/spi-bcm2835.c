@@ -11,6 +11,7 @@
  * spi-atmel.c, Copyright (C) 2006 Atmel Corporation
  */
 
+#include <linux/average.h>
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/debugfs.h>
@@ -21,10 +22,13 @@
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/platform_device.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
 #include <linux/gpio/consumer.h>
 #include <linux/gpio/machine.h> /* FIXME: using chip internals */
 #include <linux/gpio/driver.h> /* FIXME: using chip internals */
@@ -68,6 +72,7 @@
 #define BCM2835_SPI_FIFO_SIZE		64
 #define BCM2835_SPI_FIFO_SIZE_3_4	48
 #define BCM2835_SPI_DMA_MIN_LENGTH	96
+#define BCM2835_SPI_DMA_MAX_LENGTH	65532
 #define BCM2835_SPI_MODE_BITS	(SPI_CPOL | SPI_CPHA | SPI_CS_HIGH \
 				| SPI_NO_CS | SPI_3WIRE)
 
@@ -79,6 +84,23 @@ module_param(polling_limit_us, uint, 0664);
 MODULE_PARM_DESC(polling_limit_us,
 		 "time in us to run a transfer in polling mode\n");
 
+/* define DMA vs. interrupt mode selection */
+static bool adaptive_dma;
+module_param(adaptive_dma, bool, 0664);
+MODULE_PARM_DESC(adaptive_dma,
+		 "choose between DMA and interrupt mode from measured latency (default off)\n");
+
+/* every that many messages, try the mode which is not currently preferred */
+#define BCM2835_SPI_ADAPT_PROBE_INTERVAL	32
+
+DECLARE_EWMA(bcm2835_spi_lat, 4, 8)
+
+enum bcm2835_spi_mode {
+	BCM2835_SPI_MODE_NONE,
+	BCM2835_SPI_MODE_IRQ,
+	BCM2835_SPI_MODE_DMA,
+};
+
 /**
  * struct bcm2835_spi - BCM2835 SPI controller
  * @regs: base address of register map
@@ -105,6 +127,8 @@ MODULE_PARM_DESC(polling_limit_us,
  *      These are counted as well in @count_transfer_polling and
  *      @count_transfer_irq
  * @count_transfer_dma: count how often dma mode is used
+ * @count_transfer_dma_chained: count of transfers which were appended to
+ *      the DMA transaction of a preceding transfer of the same message
  * @target: SPI target currently selected
  *	(used by bcm2835_spi_dma_tx_done() to write @clear_rx_cs)
  * @tx_dma_active: whether a TX DMA descriptor is in progress
@@ -113,6 +137,18 @@ MODULE_PARM_DESC(polling_limit_us,
  * @fill_tx_desc: preallocated TX DMA descriptor used for RX-only transfers
  *	(cyclically copies from zero page to TX FIFO)
  * @fill_tx_addr: bus address of zero page
+ * @chain_tx_sg: TX sglist concatenating the mapped buffers of transfers
+ *	performed as a single DMA transaction
+ * @chain_rx_sg: RX sglist for the same transfers
+ * @chain_tx_nents: number of entries in @chain_tx_sg
+ * @chain_rx_nents: number of entries in @chain_rx_sg
+ * @chain_left: number of transfers following the current one which are
+ *	part of its DMA transaction, and so are already done
+ * @chain_speed_hz: effective speed of the chained transfers
+ * @adapt_mode: mode of the transfer in progress, if its latency is to be
+ *	accounted to the per-target mode selection statistics
+ * @adapt_len: number of bytes of the transfer in progress
+ * @adapt_start: time at which the transfer in progress was started
  */
 struct bcm2835_spi {
 	void __iomem *regs;
@@ -135,12 +171,24 @@ struct bcm2835_spi {
 	u64 count_transfer_irq;
 	u64 count_transfer_irq_after_polling;
 	u64 count_transfer_dma;
+	u64 count_transfer_dma_chained;
 
 	struct bcm2835_spidev *target;
 	unsigned int tx_dma_active;
 	unsigned int rx_dma_active;
 	struct dma_async_tx_descriptor *fill_tx_desc;
 	dma_addr_t fill_tx_addr;
+
+	struct scatterlist *chain_tx_sg;
+	struct scatterlist *chain_rx_sg;
+	unsigned int chain_tx_nents;
+	unsigned int chain_rx_nents;
+	unsigned int chain_left;
+	u32 chain_speed_hz;
+
+	enum bcm2835_spi_mode adapt_mode;
+	unsigned int adapt_len;
+	ktime_t adapt_start;
 };
 
 /**
@@ -150,6 +198,19 @@ struct bcm2835_spi {
  * @clear_rx_desc: preallocated RX DMA descriptor used for TX-only transfers
  *	(cyclically clears RX FIFO by writing @clear_rx_cs to CS register)
  * @clear_rx_addr: bus address of @clear_rx_cs
+ * @use_dma: whether DMA mode may be used for the current message,
+ *	as chosen by bcm2835_spi_adapt_mode() in ->prepare_message()
+ * @irq_lat: average latency of interrupt mode transfers, in ns per byte
+ * @dma_lat: average latency of DMA mode transfers, in ns per byte
+ * @irq_ns_per_byte: last value of @irq_lat, for debugfs
+ * @dma_ns_per_byte: last value of @dma_lat, for debugfs
+ * @count_irq_sampled: number of interrupt mode transfers measured
+ * @count_dma_sampled: number of DMA mode transfers measured
+ * @count_msg_irq: number of messages for which interrupt mode was chosen
+ * @count_msg_dma: number of messages for which DMA mode was chosen
+ * @count_msg_probe: number of messages which used the mode not currently
+ *	preferred, to track changing conditions
+ * @debugfs_dir: the per chip select debugfs directory
  * @clear_rx_cs: precalculated CS register value to clear RX FIFO
  *	(uses target-specific clock polarity and phase settings)
  */
@@ -157,6 +218,19 @@ struct bcm2835_spidev {
 	u32 prepare_cs;
 	struct dma_async_tx_descriptor *clear_rx_desc;
 	dma_addr_t clear_rx_addr;
+
+	bool use_dma;
+	struct ewma_bcm2835_spi_lat irq_lat;
+	struct ewma_bcm2835_spi_lat dma_lat;
+	u32 irq_ns_per_byte;
+	u32 dma_ns_per_byte;
+	u64 count_irq_sampled;
+	u64 count_dma_sampled;
+	u64 count_msg_irq;
+	u64 count_msg_dma;
+	u64 count_msg_probe;
+	struct dentry *debugfs_dir;
+
 	u32 clear_rx_cs ____cacheline_aligned;
 };
 
@@ -183,6 +257,8 @@ static void bcm2835_debugfs_create(struct bcm2835_spi *bs,
 			   &bs->count_transfer_irq_after_polling);
 	debugfs_create_u64("count_transfer_dma", 0444, dir,
 			   &bs->count_transfer_dma);
+	debugfs_create_u64("count_transfer_dma_chained", 0444, dir,
+			   &bs->count_transfer_dma_chained);
 }
 
 static void bcm2835_debugfs_remove(struct bcm2835_spi *bs)
@@ -190,6 +266,41 @@ static void bcm2835_debugfs_remove(struct bcm2835_spi *bs)
 	debugfs_remove_recursive(bs->debugfs_dir);
 	bs->debugfs_dir = NULL;
 }
+
+static void bcm2835_debugfs_create_target(struct bcm2835_spi *bs,
+					  struct spi_device *spi,
+					  struct bcm2835_spidev *target)
+{
+	char name[16];
+	struct dentry *dir;
+
+	snprintf(name, sizeof(name), "cs%u", spi_get_chipselect(spi, 0));
+
+	dir = debugfs_create_dir(name, bs->debugfs_dir);
+	target->debugfs_dir = dir;
+
+	/* the mode selection statistics */
+	debugfs_create_u64("count_msg_irq", 0444, dir,
+			   &target->count_msg_irq);
+	debugfs_create_u64("count_msg_dma", 0444, dir,
+			   &target->count_msg_dma);
+	debugfs_create_u64("count_msg_probe", 0444, dir,
+			   &target->count_msg_probe);
+	debugfs_create_u64("count_irq_sampled", 0444, dir,
+			   &target->count_irq_sampled);
+	debugfs_create_u64("count_dma_sampled", 0444, dir,
+			   &target->count_dma_sampled);
+	debugfs_create_u32("irq_ns_per_byte", 0444, dir,
+			   &target->irq_ns_per_byte);
+	debugfs_create_u32("dma_ns_per_byte", 0444, dir,
+			   &target->dma_ns_per_byte);
+}
+
+static void bcm2835_debugfs_remove_target(struct bcm2835_spidev *target)
+{
+	debugfs_remove_recursive(target->debugfs_dir);
+	target->debugfs_dir = NULL;
+}
 #else
 static void bcm2835_debugfs_create(struct bcm2835_spi *bs,
 				   const char *dname)
@@ -199,6 +310,16 @@ static void bcm2835_debugfs_create(struct bcm2835_spi *bs,
 static void bcm2835_debugfs_remove(struct bcm2835_spi *bs)
 {
 }
+
+static void bcm2835_debugfs_create_target(struct bcm2835_spi *bs,
+					  struct spi_device *spi,
+					  struct bcm2835_spidev *target)
+{
+}
+
+static void bcm2835_debugfs_remove_target(struct bcm2835_spidev *target)
+{
+}
 #endif /* CONFIG_DEBUG_FS */
 
 static inline u32 bcm2835_rd(struct bcm2835_spi *bs, unsigned int reg)
@@ -368,6 +489,38 @@ static void bcm2835_spi_reset_hw(struct bcm2835_spi *bs)
 	bcm2835_wr(bs, BCM2835_SPI_DLEN, 0);
 }
 
+/**
+ * bcm2835_spi_adapt_sample() - account latency of the finished transfer
+ * @bs: BCM2835 SPI controller
+ *
+ * Called on completion of interrupt and DMA mode transfers to feed the
+ * per-target averages used by bcm2835_spi_adapt_mode().
+ */
+static void bcm2835_spi_adapt_sample(struct bcm2835_spi *bs)
+{
+	struct bcm2835_spidev *target = bs->target;
+	unsigned long ns_per_byte;
+	u64 ns;
+
+	if (bs->adapt_mode == BCM2835_SPI_MODE_NONE || !bs->adapt_len)
+		return;
+
+	ns = ktime_to_ns(ktime_sub(ktime_get(), bs->adapt_start));
+	ns_per_byte = div_u64(ns, bs->adapt_len) ? : 1;
+
+	if (bs->adapt_mode == BCM2835_SPI_MODE_DMA) {
+		ewma_bcm2835_spi_lat_add(&target->dma_lat, ns_per_byte);
+		target->dma_ns_per_byte = ewma_bcm2835_spi_lat_read(&target->dma_lat);
+		target->count_dma_sampled++;
+	} else {
+		ewma_bcm2835_spi_lat_add(&target->irq_lat, ns_per_byte);
+		target->irq_ns_per_byte = ewma_bcm2835_spi_lat_read(&target->irq_lat);
+		target->count_irq_sampled++;
+	}
+
+	bs->adapt_mode = BCM2835_SPI_MODE_NONE;
+}
+
 static irqreturn_t bcm2835_spi_interrupt(int irq, void *dev_id)
 {
 	struct bcm2835_spi *bs = dev_id;
@@ -397,6 +550,7 @@ static irqreturn_t bcm2835_spi_interrupt(int irq, void *dev_id)
 	if (!bs->rx_len) {
 		/* Transfer complete - reset SPI HW */
 		bcm2835_spi_reset_hw(bs);
+		bcm2835_spi_adapt_sample(bs);
 		/* wake up the framework */
 		spi_finalize_current_transfer(bs->ctlr);
 	}
@@ -618,6 +772,7 @@ static void bcm2835_spi_dma_rx_done(void *data)
 
 	/* reset fifo and HW */
 	bcm2835_spi_reset_hw(bs);
+	bcm2835_spi_adapt_sample(bs);
 
 	/* and mark as completed */;
 	spi_finalize_current_transfer(ctlr);
@@ -651,6 +806,7 @@ static void bcm2835_spi_dma_tx_done(void *data)
 
 	bcm2835_spi_undo_prologue(bs);
 	bcm2835_spi_reset_hw(bs);
+	bcm2835_spi_adapt_sample(bs);
 	spi_finalize_current_transfer(ctlr);
 }
 
@@ -693,6 +849,12 @@ static int bcm2835_spi_prepare_sg(struct spi_controller *ctlr,
 		sgl   = tfr->rx_sg.sgl;
 		flags = DMA_PREP_INTERRUPT;
 	}
+
+	/* the following transfers of a chain go in the same descriptor */
+	if (bs->chain_left) {
+		nents = is_tx ? bs->chain_tx_nents : bs->chain_rx_nents;
+		sgl   = is_tx ? bs->chain_tx_sg : bs->chain_rx_sg;
+	}
 	/* prepare the channel */
 	desc = dmaengine_prep_slave_sg(chan, sgl, nents, dir, flags);
 	if (!desc)
@@ -850,14 +1012,200 @@ static bool bcm2835_spi_can_dma(struct spi_controller *ctlr,
 				struct spi_device *spi,
 				struct spi_transfer *tfr)
 {
+	struct bcm2835_spidev *target = spi_get_ctldata(spi);
+
 	/* we start DMA efforts only on bigger transfers */
 	if (tfr->len < BCM2835_SPI_DMA_MIN_LENGTH)
 		return false;
 
+	/* interrupt mode was found to be faster for this target */
+	if (!target->use_dma)
+		return false;
+
 	/* return OK */
 	return true;
 }
 
+static bool bcm2835_spi_sg_is_aligned(struct sg_table *sgt)
+{
+	struct scatterlist *sg;
+	int i;
+
+	for_each_sg(sgt->sgl, sg, sgt->nents, i)
+		if (sg_dma_len(sg) & 3)
+			return false;
+
+	return true;
+}
+
+/*
+ * Whether @next can be appended to the DMA transaction ending with @cur:
+ * nothing may happen on the bus in between, and as only the last sglist
+ * entry of a transaction may be shorter than a 32-bit FIFO word, all the
+ * entries of both transfers must be multiples of 4 bytes long.  @next may
+ * end up in the middle of the transaction once more transfers follow.
+ */
+static bool bcm2835_spi_can_chain(struct spi_controller *ctlr,
+				  struct spi_device *spi,
+				  struct spi_transfer *cur,
+				  struct spi_transfer *next)
+{
+	if (cur->cs_change || cur->delay.value || cur->word_delay.value)
+		return false;
+
+	if (next->speed_hz != cur->speed_hz ||
+	    next->bits_per_word != cur->bits_per_word ||
+	    !next->tx_buf != !cur->tx_buf ||
+	    !next->rx_buf != !cur->rx_buf)
+		return false;
+
+	if (!bcm2835_spi_can_dma(ctlr, spi, next))
+		return false;
+
+	if (cur->tx_buf && !bcm2835_spi_sg_is_aligned(&cur->tx_sg))
+		return false;
+
+	if (cur->rx_buf && !bcm2835_spi_sg_is_aligned(&cur->rx_sg))
+		return false;
+
+	if (next->tx_buf && !bcm2835_spi_sg_is_aligned(&next->tx_sg))
+		return false;
+
+	if (next->rx_buf && !bcm2835_spi_sg_is_aligned(&next->rx_sg))
+		return false;
+
+	return true;
+}
+
+/*
+ * spi_transfer_wait() waits for the completion of @tfr for twice the time
+ * its own length takes at speed_hz, plus 200 ms.  Keep the whole chain
+ * within half of that at the effective speed, so that it cannot time out
+ * at low clock rates.
+ */
+static unsigned int bcm2835_spi_chain_max_len(struct spi_transfer *tfr)
+{
+	u32 speed_hz = tfr->speed_hz ?: 100000;
+	u64 budget_us, len;
+
+	budget_us = div_u64(8ULL * USEC_PER_SEC * tfr->len, speed_hz) +
+		    100 * USEC_PER_MSEC;
+	len = div_u64(budget_us * tfr->effective_speed_hz, 8 * USEC_PER_SEC);
+
+	return min_t(u64, len, BCM2835_SPI_DMA_MAX_LENGTH);
+}
+
+static struct scatterlist *bcm2835_spi_chain_sg(struct spi_transfer *first,
+						struct spi_transfer *last,
+						bool is_tx,
+						unsigned int *nents)
+{
+	struct spi_transfer *xfer = first;
+	struct scatterlist *sgl, *dst, *src;
+	unsigned int n = 0;
+	int i;
+
+	for (;; xfer = list_next_entry(xfer, transfer_list)) {
+		n += is_tx ? xfer->tx_sg.nents : xfer->rx_sg.nents;
+		if (xfer == last)
+			break;
+	}
+
+	sgl = kmalloc_array(n, sizeof(*sgl), GFP_KERNEL);
+	if (!sgl)
+		return NULL;
+	sg_init_table(sgl, n);
+
+	dst = sgl;
+	for (xfer = first;; xfer = list_next_entry(xfer, transfer_list)) {
+		struct sg_table *sgt = is_tx ? &xfer->tx_sg : &xfer->rx_sg;
+
+		for_each_sg(sgt->sgl, src, sgt->nents, i) {
+			sg_dma_address(dst) = sg_dma_address(src);
+			sg_dma_len(dst) = sg_dma_len(src);
+			dst = sg_next(dst);
+		}
+		if (xfer == last)
+			break;
+	}
+
+	*nents = n;
+	return sgl;
+}
+
+static void bcm2835_spi_free_chain(struct bcm2835_spi *bs)
+{
+	kfree(bs->chain_tx_sg);
+	kfree(bs->chain_rx_sg);
+	bs->chain_tx_sg = NULL;
+	bs->chain_rx_sg = NULL;
+	bs->chain_left = 0;
+}
+
+/**
+ * bcm2835_spi_chain_transfers() - merge transfers into one DMA transaction
+ * @ctlr: SPI host controller
+ * @spi: SPI target
+ * @tfr: SPI transfer about to be performed using DMA
+ *
+ * Back-to-back DMA transfers within a message otherwise each pay for an
+ * interrupt and for reprogramming the controller and both DMA channels.
+ * Append the transfers following @tfr to its DMA transaction for as long as
+ * bcm2835_spi_can_chain() allows, up to the DLEN limit and to the length the
+ * core's timeout for @tfr covers.  ->transfer_one() then has nothing left to
+ * do for them.
+ *
+ * Return the number of bytes to transfer.
+ */
+static unsigned int bcm2835_spi_chain_transfers(struct spi_controller *ctlr,
+						struct spi_device *spi,
+						struct spi_transfer *tfr)
+{
+	struct bcm2835_spi *bs = spi_controller_get_devdata(ctlr);
+	struct spi_message *msg = ctlr->cur_msg;
+	struct spi_transfer *cur = tfr, *next;
+	unsigned int max_len = bcm2835_spi_chain_max_len(tfr);
+	unsigned int len = tfr->len, count = 0;
+
+	bcm2835_spi_free_chain(bs);
+
+	while (!list_is_last(&cur->transfer_list, &msg->transfers)) {
+		next = list_next_entry(cur, transfer_list);
+		if (len + next->len > max_len ||
+		    !bcm2835_spi_can_chain(ctlr, spi, cur, next))
+			break;
+
+		len += next->len;
+		count++;
+		cur = next;
+	}
+
+	if (!count)
+		return tfr->len;
+
+	if (tfr->tx_buf) {
+		bs->chain_tx_sg = bcm2835_spi_chain_sg(tfr, cur, true,
+						       &bs->chain_tx_nents);
+		if (!bs->chain_tx_sg)
+			return tfr->len;
+	}
+
+	if (tfr->rx_buf) {
+		bs->chain_rx_sg = bcm2835_spi_chain_sg(tfr, cur, false,
+						       &bs->chain_rx_nents);
+		if (!bs->chain_rx_sg) {
+			bcm2835_spi_free_chain(bs);
+			return tfr->len;
+		}
+	}
+
+	bs->chain_left = count;
+	bs->chain_speed_hz = tfr->effective_speed_hz;
+	bs->count_transfer_dma_chained += count;
+
+	return len;
+}
+
 static void bcm2835_dma_release(struct spi_controller *ctlr,
 				struct bcm2835_spi *bs)
 {
@@ -1035,6 +1383,64 @@ static int bcm2835_spi_transfer_one_poll(struct spi_controller *ctlr,
 	return 0;
 }
 
+static void bcm2835_spi_adapt_start(struct bcm2835_spi *bs,
+				    struct bcm2835_spidev *target,
+				    enum bcm2835_spi_mode mode)
+{
+	bs->target = target;
+	bs->adapt_mode = mode;
+	bs->adapt_len = bs->tx_len;
+	bs->adapt_start = ktime_get();
+}
+
+/**
+ * bcm2835_spi_adapt_mode() - choose between DMA and interrupt mode
+ * @target: BCM2835 SPI target the next message is for
+ *
+ * Which of the two is faster for transfers large enough to use DMA depends
+ * on the clock rate, the target and the system load, so rather than rely
+ * on a static threshold pick the mode with the lower average latency per
+ * byte measured for this target.  Each mode is tried until it has been
+ * measured once, and the other mode is retried once every
+ * %BCM2835_SPI_ADAPT_PROBE_INTERVAL messages to follow changing conditions.
+ *
+ * The choice is made per message, as the SPI core maps the transfers for
+ * DMA according to ->can_dma() before ->transfer_one() is called.
+ */
+static void bcm2835_spi_adapt_mode(struct bcm2835_spidev *target)
+{
+	unsigned long irq_lat, dma_lat;
+	bool use_dma;
+
+	if (!adaptive_dma) {
+		target->use_dma = true;
+		return;
+	}
+
+	irq_lat = ewma_bcm2835_spi_lat_read(&target->irq_lat);
+	dma_lat = ewma_bcm2835_spi_lat_read(&target->dma_lat);
+
+	if (!dma_lat)
+		use_dma = true;
+	else if (!irq_lat)
+		use_dma = false;
+	else
+		use_dma = dma_lat <= irq_lat;
+
+	if (!((target->count_msg_irq + target->count_msg_dma + 1) %
+	      BCM2835_SPI_ADAPT_PROBE_INTERVAL)) {
+		use_dma = !use_dma;
+		target->count_msg_probe++;
+	}
+
+	if (use_dma)
+		target->count_msg_dma++;
+	else
+		target->count_msg_irq++;
+
+	target->use_dma = use_dma;
+}
+
 static int bcm2835_spi_transfer_one(struct spi_controller *ctlr,
 				    struct spi_device *spi,
 				    struct spi_transfer *tfr)
@@ -1045,6 +1451,15 @@ static int bcm2835_spi_transfer_one(struct spi_controller *ctlr,
 	unsigned long hz_per_byte, byte_limit;
 	u32 cs = target->prepare_cs;
 
+	/* already transferred as part of a preceding DMA transaction */
+	if (bs->chain_left) {
+		bs->chain_left--;
+		tfr->effective_speed_hz = bs->chain_speed_hz;
+		return 0;
+	}
+
+	bs->adapt_mode = BCM2835_SPI_MODE_NONE;
+
 	if (unlikely(!tfr->len)) {
 		static int warned;
 
@@ -1100,8 +1515,16 @@ static int bcm2835_spi_transfer_one(struct spi_controller *ctlr,
 	 * Note that unlike poll or interrupt mode DMA mode does not have
 	 * this 1 idle clock cycle pattern but runs the spi clock without gaps
 	 */
-	if (ctlr->can_dma && bcm2835_spi_can_dma(ctlr, spi, tfr))
+	if (ctlr->can_dma && bcm2835_spi_can_dma(ctlr, spi, tfr)) {
+		bs->tx_len = bcm2835_spi_chain_transfers(ctlr, spi, tfr);
+		bs->rx_len = bs->tx_len;
+		bcm2835_spi_adapt_start(bs, target, BCM2835_SPI_MODE_DMA);
 		return bcm2835_spi_transfer_one_dma(ctlr, tfr, target, cs);
+	}
+
+	/* only sizes which could go either way matter for mode selection */
+	if (ctlr->can_dma && tfr->len >= BCM2835_SPI_DMA_MIN_LENGTH)
+		bcm2835_spi_adapt_start(bs, target, BCM2835_SPI_MODE_IRQ);
 
 	/* run in interrupt-mode */
 	return bcm2835_spi_transfer_one_irq(ctlr, spi, tfr, cs, true);
@@ -1125,6 +1548,8 @@ static int bcm2835_spi_prepare_message(struct spi_controller *ctlr,
 						  GFP_KERNEL | GFP_DMA);
 		if (ret)
 			return ret;
+
+		bcm2835_spi_adapt_mode(target);
 	}
 
 	/*
@@ -1136,6 +1561,16 @@ static int bcm2835_spi_prepare_message(struct spi_controller *ctlr,
 	return 0;
 }
 
+static int bcm2835_spi_unprepare_message(struct spi_controller *ctlr,
+					 struct spi_message *msg)
+{
+	struct bcm2835_spi *bs = spi_controller_get_devdata(ctlr);
+
+	bcm2835_spi_free_chain(bs);
+
+	return 0;
+}
+
 static void bcm2835_spi_handle_err(struct spi_controller *ctlr,
 				   struct spi_message *msg)
 {
@@ -1152,6 +1587,9 @@ static void bcm2835_spi_handle_err(struct spi_controller *ctlr,
 	}
 	bcm2835_spi_undo_prologue(bs);
 
+	/* a failed transfer says nothing about the latency of its mode */
+	bs->adapt_mode = BCM2835_SPI_MODE_NONE;
+
 	/* and reset */
 	bcm2835_spi_reset_hw(bs);
 }
@@ -1166,6 +1604,8 @@ static void bcm2835_spi_cleanup(struct spi_device *spi)
 	struct bcm2835_spidev *target = spi_get_ctldata(spi);
 	struct spi_controller *ctlr = spi->controller;
 
+	bcm2835_debugfs_remove_target(target);
+
 	if (target->clear_rx_desc)
 		dmaengine_desc_free(target->clear_rx_desc);
 
@@ -1237,6 +1677,11 @@ static int bcm2835_spi_setup(struct spi_device *spi)
 		ret = bcm2835_spi_setup_dma(ctlr, spi, bs, target);
 		if (ret)
 			goto err_cleanup;
+
+		target->use_dma = true;
+		ewma_bcm2835_spi_lat_init(&target->irq_lat);
+		ewma_bcm2835_spi_lat_init(&target->dma_lat);
+		bcm2835_debugfs_create_target(bs, spi, target);
 	}
 
 	/*
@@ -1349,6 +1794,7 @@ static int bcm2835_spi_probe(struct platform_device *pdev)
 	ctlr->transfer_one = bcm2835_spi_transfer_one;
 	ctlr->handle_err = bcm2835_spi_handle_err;
 	ctlr->prepare_message = bcm2835_spi_prepare_message;
+	ctlr->unprepare_message = bcm2835_spi_unprepare_message;
 	ctlr->dev.of_node = pdev->dev.of_node;
 
 	bs = spi_controller_get_devdata(ctlr);
@@ -83,6 +83,9 @@ MODULE_PARM_DESC(polling_limit_us,
 #define BCM2835_AUX_SPI_STAT_BUSY	0x00000040
 #define BCM2835_AUX_SPI_STAT_BITCOUNT	0x0000003F
 
+/* Entries in each of the TX and RX FIFOs, up to 24 bits each */
+#define BCM2835_AUX_SPI_FIFO_DEPTH	4
+
 struct bcm2835aux_spi {
 	void __iomem *regs;
 	struct clk *clk;
@@ -92,7 +95,8 @@ struct bcm2835aux_spi {
 	u8 *rx_buf;
 	int tx_len;
 	int rx_len;
-	int pending;
+	int bits;
+	int pending;	/* FIFO entries written but not yet read back */
 
 	u64 count_transfer_polling;
 	u64 count_transfer_irq;
@@ -151,13 +155,38 @@ static inline void bcm2835aux_wr(struct bcm2835aux_spi *bs, unsigned int reg,
 	writel(val, bs->regs + reg);
 }
 
+/*
+ * Each FIFO entry carries up to 24 bits, sent MSB first from bit 23 and
+ * received right-aligned. 8-bit words are packed three to an entry, 16
+ * and 24-bit words (stored as u16 and u32 in the buffers) take an entry
+ * each, so wider words need neither byte swapping nor splitting.
+ */
 static inline void bcm2835aux_rd_fifo(struct bcm2835aux_spi *bs)
 {
 	u32 data;
-	int count = min(bs->rx_len, 3);
+	int count;
 
 	data = bcm2835aux_rd(bs, BCM2835_AUX_SPI_IO);
-	if (bs->rx_buf) {
+
+	switch (bs->bits) {
+	case 16:
+		count = 2;
+		if (bs->rx_buf) {
+			*(u16 *)bs->rx_buf = data & 0xffff;
+			bs->rx_buf += count;
+		}
+		break;
+	case 24:
+		count = 4;
+		if (bs->rx_buf) {
+			*(u32 *)bs->rx_buf = data & 0xffffff;
+			bs->rx_buf += count;
+		}
+		break;
+	default:
+		count = min(bs->rx_len, 3);
+		if (!bs->rx_buf)
+			break;
 		switch (count) {
 		case 3:
 			*bs->rx_buf++ = (data >> 16) & 0xff;
@@ -170,31 +199,54 @@ static inline void bcm2835aux_rd_fifo(struct bcm2835aux_spi *bs)
 			/* fallthrough - no default */
 		}
 	}
+
 	bs->rx_len -= count;
-	bs->pending -= count;
+	bs->pending--;
 }
 
 static inline void bcm2835aux_wr_fifo(struct bcm2835aux_spi *bs)
 {
 	u32 data;
 	u8 byte;
-	int count;
+	int count, bits;
 	int i;
 
-	/* gather up to 3 bytes to write to the FIFO */
-	count = min(bs->tx_len, 3);
-	data = 0;
-	for (i = 0; i < count; i++) {
-		byte = bs->tx_buf ? *bs->tx_buf++ : 0;
-		data |= byte << (8 * (2 - i));
+	switch (bs->bits) {
+	case 16:
+		count = 2;
+		bits = 16;
+		data = 0;
+		if (bs->tx_buf) {
+			data = *(const u16 *)bs->tx_buf << 8;
+			bs->tx_buf += count;
+		}
+		break;
+	case 24:
+		count = 4;
+		bits = 24;
+		data = 0;
+		if (bs->tx_buf) {
+			data = *(const u32 *)bs->tx_buf & 0xffffff;
+			bs->tx_buf += count;
+		}
+		break;
+	default:
+		/* gather up to 3 bytes to write to the FIFO */
+		count = min(bs->tx_len, 3);
+		bits = count * 8;
+		data = 0;
+		for (i = 0; i < count; i++) {
+			byte = bs->tx_buf ? *bs->tx_buf++ : 0;
+			data |= byte << (8 * (2 - i));
+		}
 	}
 
 	/* and set the variable bit-length */
-	data |= (count * 8) << 24;
+	data |= bits << 24;
 
 	/* and decrement length */
 	bs->tx_len -= count;
-	bs->pending += count;
+	bs->pending++;
 
 	/* write to the correct TX-register */
 	if (bs->tx_len)
@@ -220,13 +272,13 @@ static void bcm2835aux_spi_transfer_helper(struct bcm2835aux_spi *bs)
 	     stat = bcm2835aux_rd(bs, BCM2835_AUX_SPI_STAT))
 		bcm2835aux_rd_fifo(bs);
 
-	/* check if we have data to write */
-	while (bs->tx_len &&
-	       (bs->pending < 12) &&
-	       (!(bcm2835aux_rd(bs, BCM2835_AUX_SPI_STAT) &
-		  BCM2835_AUX_SPI_STAT_TX_FULL))) {
+	/*
+	 * Check if we have data to write. With no more entries in flight
+	 * than the TX FIFO holds it cannot be full, so there is no need to
+	 * read STAT again for every entry.
+	 */
+	while (bs->tx_len && bs->pending < BCM2835_AUX_SPI_FIFO_DEPTH)
 		bcm2835aux_wr_fifo(bs);
-	}
 }
 
 static irqreturn_t bcm2835aux_spi_interrupt(int irq, void *dev_id)
@@ -286,12 +338,8 @@ static int bcm2835aux_spi_transfer_one_irq(struct spi_controller *host,
 	bcm2835aux_wr(bs, BCM2835_AUX_SPI_CNTL0, bs->cntl[0]);
 
 	/* fill in tx fifo with data before enabling interrupts */
-	while ((bs->tx_len) &&
-	       (bs->pending < 12) &&
-	       (!(bcm2835aux_rd(bs, BCM2835_AUX_SPI_STAT) &
-		  BCM2835_AUX_SPI_STAT_TX_FULL))) {
+	while (bs->tx_len && bs->pending < BCM2835_AUX_SPI_FIFO_DEPTH)
 		bcm2835aux_wr_fifo(bs);
-	}
 
 	/* now run the interrupt mode */
 	return __bcm2835aux_spi_transfer_one_irq(host, spi, tfr);
@@ -378,6 +426,7 @@ static int bcm2835aux_spi_transfer_one(struct spi_controller *host,
 	bs->rx_buf = tfr->rx_buf;
 	bs->tx_len = tfr->len;
 	bs->rx_len = tfr->len;
+	bs->bits = tfr->bits_per_word;
 	bs->pending = 0;
 
 	/* Calculate the estimated time in us the transfer runs.  Note that
@@ -484,7 +533,8 @@ static int bcm2835aux_spi_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, host);
 	host->mode_bits = (SPI_CPOL | SPI_CS_HIGH | SPI_NO_CS);
-	host->bits_per_word_mask = SPI_BPW_MASK(8);
+	host->bits_per_word_mask = SPI_BPW_MASK(8) | SPI_BPW_MASK(16) |
+				   SPI_BPW_MASK(24);
 	/* even though the driver never officially supported native CS
 	 * allow a single native CS for legacy DT support purposes when
 	 * no cs-gpio is configured.
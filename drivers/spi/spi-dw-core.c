@@ -439,16 +439,20 @@ static int dw_spi_transfer_one(struct spi_controller *host,
 	/* Ensure the data above is visible for all CPUs */
 	smp_mb();
 
+	/* Check if current transfer is a DMA transaction */
+	if (host->can_dma && host->can_dma(host, spi, transfer))
+		dws->dma_mapped = host->cur_msg_mapped;
+
+	/* Don't let the Rx FIFO overflow while DMA only feeds the Tx FIFO */
+	if (dws->dma_mapped && !transfer->rx_buf)
+		cfg.tmode = DW_SPI_CTRLR0_TMOD_TO;
+
 	dw_spi_enable_chip(dws, 0);
 
 	dw_spi_update_config(dws, spi, &cfg);
 
 	transfer->effective_speed_hz = dws->current_freq;
 
-	/* Check if current transfer is a DMA transaction */
-	if (host->can_dma && host->can_dma(host, spi, transfer))
-		dws->dma_mapped = host->cur_msg_mapped;
-
 	/* For poll mode just disable all interrupts */
 	dw_spi_mask_intr(dws, 0xff);
 
@@ -953,7 +957,6 @@ int dw_spi_add_host(struct device *dev, struct dw_spi *dws)
 			dev_warn(dev, "DMA init failed\n");
 		} else {
 			host->can_dma = dws->dma_ops->can_dma;
-			host->flags |= SPI_CONTROLLER_MUST_TX;
 		}
 	}
 
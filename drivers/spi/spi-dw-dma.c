@@ -8,11 +8,13 @@
 #include <linux/completion.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
+#include <linux/gfp.h>
 #include <linux/irqreturn.h>
 #include <linux/jiffies.h>
 #include <linux/module.h>
 #include <linux/pci.h>
 #include <linux/platform_data/dma-dw.h>
+#include <linux/scatterlist.h>
 #include <linux/spi/spi.h>
 #include <linux/types.h>
 
@@ -108,6 +110,42 @@ static int dw_spi_dma_caps_init(struct dw_spi *dws)
 	return 0;
 }
 
+/*
+ * Rx-only transfers still need the Tx FIFO to be fed for the clock to run.
+ * Rather than having the SPI core allocate, clear and map a dummy buffer as
+ * long as each transfer, point all the Tx SG list entries at one zeroed
+ * page mapped once here.
+ */
+static int dw_spi_dma_dummy_init(struct dw_spi *dws)
+{
+	struct device *dma_dev = dws->txchan->device->dev;
+
+	dws->dma_dummy = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!dws->dma_dummy)
+		return -ENOMEM;
+
+	dws->dma_dummy_addr = dma_map_single(dma_dev, dws->dma_dummy,
+					     PAGE_SIZE, DMA_TO_DEVICE);
+	if (dma_mapping_error(dma_dev, dws->dma_dummy_addr)) {
+		free_page((unsigned long)dws->dma_dummy);
+		dws->dma_dummy = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void dw_spi_dma_dummy_exit(struct dw_spi *dws)
+{
+	if (!dws->dma_dummy)
+		return;
+
+	dma_unmap_single(dws->txchan->device->dev, dws->dma_dummy_addr,
+			 PAGE_SIZE, DMA_TO_DEVICE);
+	free_page((unsigned long)dws->dma_dummy);
+	dws->dma_dummy = NULL;
+}
+
 static int dw_spi_dma_init_mfld(struct device *dev, struct dw_spi *dws)
 {
 	struct dw_dma_slave dma_tx = { .dst_id = 1 }, *tx = &dma_tx;
@@ -150,6 +188,10 @@ static int dw_spi_dma_init_mfld(struct device *dev, struct dw_spi *dws)
 
 	dw_spi_dma_maxburst_init(dws);
 
+	ret = dw_spi_dma_dummy_init(dws);
+	if (ret)
+		goto free_txchan;
+
 	pci_dev_put(dma_dev);
 
 	return 0;
@@ -194,6 +236,10 @@ static int dw_spi_dma_init_generic(struct device *dev, struct dw_spi *dws)
 
 	dw_spi_dma_maxburst_init(dws);
 
+	ret = dw_spi_dma_dummy_init(dws);
+	if (ret)
+		goto free_txchan;
+
 	return 0;
 
 free_txchan:
@@ -210,6 +256,7 @@ static void dw_spi_dma_exit(struct dw_spi *dws)
 {
 	if (dws->txchan) {
 		dmaengine_terminate_sync(dws->txchan);
+		dw_spi_dma_dummy_exit(dws);
 		dma_release_channel(dws->txchan);
 	}
 
@@ -467,23 +514,60 @@ static int dw_spi_dma_submit_rx(struct dw_spi *dws, struct scatterlist *sgl,
 	return 0;
 }
 
+static int dw_spi_dma_dummy_sg(struct dw_spi *dws, struct spi_transfer *xfer)
+{
+	struct sg_table *sgt = &dws->dma_dummy_sgt;
+	unsigned int len = xfer->len, nents;
+	struct scatterlist *sg;
+	int i, ret;
+
+	nents = DIV_ROUND_UP(len, PAGE_SIZE);
+	ret = sg_alloc_table(sgt, nents, GFP_KERNEL);
+	if (ret)
+		return ret;
+
+	for_each_sg(sgt->sgl, sg, nents, i) {
+		sg_dma_address(sg) = dws->dma_dummy_addr;
+		sg_dma_len(sg) = min_t(unsigned int, len, PAGE_SIZE);
+		len -= sg_dma_len(sg);
+	}
+
+	return 0;
+}
+
+static void dw_spi_dma_dummy_sg_free(struct dw_spi *dws)
+{
+	if (dws->dma_dummy_sgt.sgl)
+		sg_free_table(&dws->dma_dummy_sgt);
+	dws->dma_dummy_sgt.sgl = NULL;
+}
+
+static struct sg_table *dw_spi_dma_tx_sgt(struct dw_spi *dws,
+					  struct spi_transfer *xfer)
+{
+	return xfer->tx_buf ? &xfer->tx_sg : &dws->dma_dummy_sgt;
+}
+
 static int dw_spi_dma_setup(struct dw_spi *dws, struct spi_transfer *xfer)
 {
 	u16 imr, dma_ctrl;
 	int ret;
 
-	if (!xfer->tx_buf)
-		return -EINVAL;
+	if (!xfer->tx_buf) {
+		ret = dw_spi_dma_dummy_sg(dws, xfer);
+		if (ret)
+			return ret;
+	}
 
 	/* Setup DMA channels */
 	ret = dw_spi_dma_config_tx(dws);
 	if (ret)
-		return ret;
+		goto err_free_dummy;
 
 	if (xfer->rx_buf) {
 		ret = dw_spi_dma_config_rx(dws);
 		if (ret)
-			return ret;
+			goto err_free_dummy;
 	}
 
 	/* Set the DMA handshaking interface */
@@ -503,15 +587,21 @@ static int dw_spi_dma_setup(struct dw_spi *dws, struct spi_transfer *xfer)
 	dws->transfer_handler = dw_spi_dma_transfer_handler;
 
 	return 0;
+
+err_free_dummy:
+	dw_spi_dma_dummy_sg_free(dws);
+
+	return ret;
 }
 
 static int dw_spi_dma_transfer_all(struct dw_spi *dws,
 				   struct spi_transfer *xfer)
 {
+	struct sg_table *tx_sgt = dw_spi_dma_tx_sgt(dws, xfer);
 	int ret;
 
 	/* Submit the DMA Tx transfer */
-	ret = dw_spi_dma_submit_tx(dws, xfer->tx_sg.sgl, xfer->tx_sg.nents);
+	ret = dw_spi_dma_submit_tx(dws, tx_sgt->sgl, tx_sgt->nents);
 	if (ret)
 		goto err_clear_dmac;
 
@@ -571,6 +661,7 @@ static int dw_spi_dma_transfer_all(struct dw_spi *dws,
 static int dw_spi_dma_transfer_one(struct dw_spi *dws,
 				   struct spi_transfer *xfer)
 {
+	struct sg_table *tx_sgt = dw_spi_dma_tx_sgt(dws, xfer);
 	struct scatterlist *tx_sg = NULL, *rx_sg = NULL, tx_tmp, rx_tmp;
 	unsigned int tx_len = 0, rx_len = 0;
 	unsigned int base, len;
@@ -582,7 +673,7 @@ static int dw_spi_dma_transfer_one(struct dw_spi *dws,
 	for (base = 0, len = 0; base < xfer->len; base += len) {
 		/* Fetch next Tx DMA data chunk */
 		if (!tx_len) {
-			tx_sg = !tx_sg ? &xfer->tx_sg.sgl[0] : sg_next(tx_sg);
+			tx_sg = !tx_sg ? &tx_sgt->sgl[0] : sg_next(tx_sg);
 			sg_dma_address(&tx_tmp) = sg_dma_address(tx_sg);
 			tx_len = sg_dma_len(tx_sg);
 		}
@@ -642,9 +733,10 @@ static int dw_spi_dma_transfer(struct dw_spi *dws, struct spi_transfer *xfer)
 	unsigned int nents;
 	int ret;
 
-	nents = max(xfer->tx_sg.nents, xfer->rx_sg.nents);
+	nents = max(dw_spi_dma_tx_sgt(dws, xfer)->nents, xfer->rx_sg.nents);
 
-	dw_writel(dws, DW_SPI_DMARDLR, xfer->tx_buf ? (dws->rxburst - 1) : 0);
+	/* The Tx channel runs for Rx-only transfers too, off the dummy page */
+	dw_writel(dws, DW_SPI_DMARDLR, dws->rxburst - 1);
 
 	/*
 	 * Execute normal DMA-based transfer (which submits the Rx and Tx SG
@@ -657,6 +749,7 @@ static int dw_spi_dma_transfer(struct dw_spi *dws, struct spi_transfer *xfer)
 		ret = dw_spi_dma_transfer_all(dws, xfer);
 	else
 		ret = dw_spi_dma_transfer_one(dws, xfer);
+	dw_spi_dma_dummy_sg_free(dws);
 	if (ret)
 		return ret;
 
@@ -682,6 +775,7 @@ static void dw_spi_dma_stop(struct dw_spi *dws)
 		dmaengine_terminate_sync(dws->rxchan);
 		clear_bit(DW_SPI_RX_BUSY, &dws->dma_chan_busy);
 	}
+	dw_spi_dma_dummy_sg_free(dws);
 }
 
 static const struct dw_spi_dma_ops dw_spi_dma_mfld_ops = {
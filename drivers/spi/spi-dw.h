@@ -195,6 +195,9 @@ struct dw_spi {
 	dma_addr_t		dma_addr; /* phy address of the Data register */
 	const struct dw_spi_dma_ops *dma_ops;
 	struct completion	dma_completion;
+	void			*dma_dummy;	/* zeroes sent by Rx-only xfers */
+	dma_addr_t		dma_dummy_addr;
+	struct sg_table		dma_dummy_sgt;
 
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *debugfs;
@@ -137,6 +137,7 @@ static struct fbtft_display display = {
 	.gamma_num = 2,
 	.gamma_len = 15,
 	.gamma = DEFAULT_GAMMA,
+	.damage_cols = true,
 	.fbtftops = {
 		.init_display = init_display,
 		.set_addr_win = set_addr_win,
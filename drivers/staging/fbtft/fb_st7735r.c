@@ -179,6 +179,7 @@ static struct fbtft_display display = {
 	.gamma_num = 2,
 	.gamma_len = 16,
 	.gamma = DEFAULT_GAMMA,
+	.damage_cols = true,
 	.fbtftops = {
 		.set_addr_win = set_addr_win,
 		.set_var = set_var,
@@ -171,6 +171,78 @@ int fbtft_write_vmem16_bus8(struct fbtft_par *par, size_t offset, size_t len)
 }
 EXPORT_SYMBOL(fbtft_write_vmem16_bus8);
 
+/*
+ * 16 bit pixel over 8-bit databus, limited to a rectangle. The rows are
+ * packed back to back into txbuf so a narrow rectangle still goes out in
+ * a few large (DMA friendly) transfers rather than one per line.
+ * set_addr_win() must already have programmed the same window.
+ */
+int fbtft_write_vmem16_bus8_rect(struct fbtft_par *par, unsigned int xs,
+				 unsigned int ys, unsigned int xe,
+				 unsigned int ye)
+{
+	size_t line_length = par->info->fix.line_length / 2;
+	size_t width = xe - xs + 1;
+	__be16 *txbuf16 = par->txbuf.buf;
+	size_t tx_array_size;
+	size_t startbyte_size = 0;
+	size_t n = 0;
+	unsigned int y;
+	u16 *vmem16;
+	int i;
+	int ret = 0;
+
+	fbtft_par_dbg(DEBUG_WRITE_VMEM, par, "%s(xs=%u, ys=%u, xe=%u, ye=%u)\n",
+		      __func__, xs, ys, xe, ye);
+
+	if (!par->txbuf.buf) {
+		dev_err(par->info->device, "%s: txbuf.buf is NULL\n", __func__);
+		return -EINVAL;
+	}
+
+	gpiod_set_value(par->gpio.dc, 1);
+
+	tx_array_size = par->txbuf.len / 2;
+
+	if (par->startbyte) {
+		txbuf16 = par->txbuf.buf + 1;
+		tx_array_size -= 2;
+		*(u8 *)(par->txbuf.buf) = par->startbyte | 0x2;
+		startbyte_size = 1;
+	}
+
+	for (y = ys; y <= ye; y++) {
+		size_t remain = width;
+
+		vmem16 = (u16 *)par->info->screen_buffer + y * line_length + xs;
+
+		while (remain) {
+			size_t to_copy = min(tx_array_size - n, remain);
+
+			for (i = 0; i < to_copy; i++)
+				txbuf16[n + i] = cpu_to_be16(vmem16[i]);
+			vmem16 += to_copy;
+			remain -= to_copy;
+			n += to_copy;
+
+			if (n == tx_array_size) {
+				ret = par->fbtftops.write(par, par->txbuf.buf,
+							  startbyte_size + n * 2);
+				if (ret < 0)
+					return ret;
+				n = 0;
+			}
+		}
+	}
+
+	if (n)
+		ret = par->fbtftops.write(par, par->txbuf.buf,
+					  startbyte_size + n * 2);
+
+	return ret;
+}
+EXPORT_SYMBOL(fbtft_write_vmem16_bus8_rect);
+
 /* 16 bit pixel over 9-bit SPI bus: dc + high byte, dc + low byte */
 int fbtft_write_vmem16_bus9(struct fbtft_par *par, size_t offset, size_t len)
 {
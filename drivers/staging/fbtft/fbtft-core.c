@@ -300,6 +300,26 @@ static void fbtft_update_display(struct fbtft_par *par, unsigned int start_line,
 	}
 }
 
+/* Update only the damaged rectangle, see fbtft_display.damage_cols */
+static void fbtft_update_display_rect(struct fbtft_par *par, unsigned int xs,
+				      unsigned int ys, unsigned int xe,
+				      unsigned int ye)
+{
+	int ret;
+
+	fbtft_par_dbg(DEBUG_UPDATE_DISPLAY, par,
+		      "%s(xs=%u, ys=%u, xe=%u, ye=%u)\n",
+		      __func__, xs, ys, xe, ye);
+
+	par->fbtftops.set_addr_win(par, xs, ys, xe, ye);
+
+	ret = fbtft_write_vmem16_bus8_rect(par, xs, ys, xe, ye);
+	if (ret < 0)
+		dev_err(par->info->device,
+			"%s: write_vmem failed to update display buffer\n",
+			__func__);
+}
+
 static void fbtft_mkdirty(struct fb_info *info, int y, int height)
 {
 	struct fbtft_par *par = info->par;
@@ -309,6 +329,10 @@ static void fbtft_mkdirty(struct fb_info *info, int y, int height)
 	if (y == -1) {
 		y = 0;
 		height = info->var.yres;
+		spin_lock(&par->dirty_lock);
+		par->dirty_cols_start = 0;
+		par->dirty_cols_end = info->var.xres - 1;
+		spin_unlock(&par->dirty_lock);
 	}
 
 	/* Mark display lines/area as dirty */
@@ -323,10 +347,27 @@ static void fbtft_mkdirty(struct fb_info *info, int y, int height)
 	schedule_delayed_work(&info->deferred_work, fbdefio->delay);
 }
 
+static void fbtft_mkdirty_rect(struct fb_info *info, int x, int y, int width,
+			       int height)
+{
+	struct fbtft_par *par = info->par;
+
+	/* Mark display columns as dirty, mkdirty() takes care of the lines */
+	spin_lock(&par->dirty_lock);
+	if (x < par->dirty_cols_start)
+		par->dirty_cols_start = x;
+	if (x + width - 1 > par->dirty_cols_end)
+		par->dirty_cols_end = x + width - 1;
+	spin_unlock(&par->dirty_lock);
+
+	par->fbtftops.mkdirty(info, y, height);
+}
+
 static void fbtft_deferred_io(struct fb_info *info, struct list_head *pagereflist)
 {
 	struct fbtft_par *par = info->par;
 	unsigned int dirty_lines_start, dirty_lines_end;
+	unsigned int dirty_cols_start, dirty_cols_end;
 	struct fb_deferred_io_pageref *pageref;
 	unsigned int y_low = 0, y_high = 0;
 	int count = 0;
@@ -334,9 +375,13 @@ static void fbtft_deferred_io(struct fb_info *info, struct list_head *pagereflis
 	spin_lock(&par->dirty_lock);
 	dirty_lines_start = par->dirty_lines_start;
 	dirty_lines_end = par->dirty_lines_end;
+	dirty_cols_start = par->dirty_cols_start;
+	dirty_cols_end = par->dirty_cols_end;
 	/* set display line markers as clean */
 	par->dirty_lines_start = par->info->var.yres - 1;
 	par->dirty_lines_end = 0;
+	par->dirty_cols_start = par->info->var.xres - 1;
+	par->dirty_cols_end = 0;
 	spin_unlock(&par->dirty_lock);
 
 	/* Mark display lines as dirty */
@@ -355,7 +400,24 @@ static void fbtft_deferred_io(struct fb_info *info, struct list_head *pagereflis
 			dirty_lines_end = y_high;
 	}
 
-	par->fbtftops.update_display(info->par,
+	/*
+	 * Pages written through mmap only tell us about whole lines, and a
+	 * missing column range means the same.
+	 */
+	if (count || dirty_cols_start > dirty_cols_end ||
+	    dirty_cols_end > info->var.xres - 1) {
+		dirty_cols_start = 0;
+		dirty_cols_end = info->var.xres - 1;
+	}
+
+	if (par->damage_cols && dirty_lines_start <= dirty_lines_end &&
+	    dirty_lines_end < info->var.yres &&
+	    (dirty_cols_start || dirty_cols_end < info->var.xres - 1))
+		fbtft_update_display_rect(par, dirty_cols_start,
+					  dirty_lines_start, dirty_cols_end,
+					  dirty_lines_end);
+	else
+		par->fbtftops.update_display(info->par,
 					dirty_lines_start, dirty_lines_end);
 }
 
@@ -369,7 +431,8 @@ static void fbtft_fb_fillrect(struct fb_info *info,
 		__func__, rect->dx, rect->dy, rect->width, rect->height);
 	sys_fillrect(info, rect);
 
-	par->fbtftops.mkdirty(info, rect->dy, rect->height);
+	fbtft_mkdirty_rect(info, rect->dx, rect->dy, rect->width,
+			   rect->height);
 }
 
 static void fbtft_fb_copyarea(struct fb_info *info,
@@ -382,7 +445,8 @@ static void fbtft_fb_copyarea(struct fb_info *info,
 		__func__,  area->dx, area->dy, area->width, area->height);
 	sys_copyarea(info, area);
 
-	par->fbtftops.mkdirty(info, area->dy, area->height);
+	fbtft_mkdirty_rect(info, area->dx, area->dy, area->width,
+			   area->height);
 }
 
 static void fbtft_fb_imageblit(struct fb_info *info,
@@ -395,7 +459,8 @@ static void fbtft_fb_imageblit(struct fb_info *info,
 		__func__,  image->dx, image->dy, image->width, image->height);
 	sys_imageblit(info, image);
 
-	par->fbtftops.mkdirty(info, image->dy, image->height);
+	fbtft_mkdirty_rect(info, image->dx, image->dy, image->width,
+			   image->height);
 }
 
 static ssize_t fbtft_fb_write(struct fb_info *info, const char __user *buf,
@@ -694,6 +759,8 @@ struct fb_info *fbtft_framebuffer_alloc(struct fbtft_display *display,
 	par->debug = display->debug;
 	par->buf = buf;
 	spin_lock_init(&par->dirty_lock);
+	par->dirty_cols_start = width - 1;
+	par->damage_cols = display->damage_cols;
 	par->bgr = pdata->bgr;
 	par->startbyte = pdata->startbyte;
 	par->init_sequence = init_sequence;
@@ -1298,6 +1365,12 @@ int fbtft_probe_common(struct fbtft_display *display,
 	/* make sure we still use the driver provided functions */
 	fbtft_merge_fbtftops(&par->fbtftops, &display->fbtftops);
 
+	/* Partial width updates are packed by fbtft_write_vmem16_bus8_rect() */
+	if (par->fbtftops.write_vmem != fbtft_write_vmem16_bus8 ||
+	    !par->fbtftops.set_addr_win || !par->txbuf.buf ||
+	    par->info->var.bits_per_pixel != 16)
+		par->damage_cols = false;
+
 	/* use init_sequence if provided */
 	if (par->init_sequence)
 		par->fbtftops.init_display = fbtft_init_display;
@@ -205,9 +205,43 @@ static ssize_t show_debug(struct device *device,
 static struct device_attribute debug_device_attr =
 	__ATTR(debug, 0660, show_debug, store_debug);
 
+/*
+ * Maximum display update rate. Damage is collected for 1/fps seconds
+ * before being flushed, so this also caps the bus bandwidth used.
+ */
+static ssize_t store_fps(struct device *device,
+			 struct device_attribute *attr,
+			 const char *buf, size_t count)
+{
+	struct fb_info *fb_info = dev_get_drvdata(device);
+	unsigned long fps;
+	int ret;
+
+	ret = kstrtoul(buf, 10, &fps);
+	if (ret)
+		return ret;
+	if (!fps || fps > HZ)
+		return -EINVAL;
+	fb_info->fbdefio->delay = HZ / fps;
+
+	return count;
+}
+
+static ssize_t show_fps(struct device *device,
+			struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fb_info = dev_get_drvdata(device);
+
+	return sysfs_emit(buf, "%lu\n", HZ / fb_info->fbdefio->delay);
+}
+
+static struct device_attribute fps_device_attr =
+	__ATTR(fps, 0660, show_fps, store_fps);
+
 void fbtft_sysfs_init(struct fbtft_par *par)
 {
 	device_create_file(par->info->dev, &debug_device_attr);
+	device_create_file(par->info->dev, &fps_device_attr);
 	if (par->gamma.curves && par->fbtftops.set_gamma)
 		device_create_file(par->info->dev, &gamma_device_attrs[0]);
 }
@@ -215,6 +249,7 @@ void fbtft_sysfs_init(struct fbtft_par *par)
 void fbtft_sysfs_exit(struct fbtft_par *par)
 {
 	device_remove_file(par->info->dev, &debug_device_attr);
+	device_remove_file(par->info->dev, &fps_device_attr);
 	if (par->gamma.curves && par->fbtftops.set_gamma)
 		device_remove_file(par->info->dev, &gamma_device_attrs[0]);
 }
@@ -100,6 +100,8 @@ struct fbtft_ops {
  * @gamma_num: Number of Gamma curves
  * @gamma_len: Number of values per Gamma curve
  * @debug: Initial debug value
+ * @damage_cols: set_addr_win() honours the column range, so updates can be
+ *               limited to the damaged columns instead of whole lines
  *
  * This structure is not stored by FBTFT except for init_sequence.
  */
@@ -118,6 +120,7 @@ struct fbtft_display {
 	int gamma_num;
 	int gamma_len;
 	unsigned long debug;
+	bool damage_cols;
 };
 
 /**
@@ -164,9 +167,12 @@ struct fbtft_platform_data {
  * @startbyte: Used by some controllers when in SPI mode.
  *             Format: 6 bit Device id + RS bit + RW bit
  * @fbtftops: FBTFT operations provided by driver or device (platform_data)
- * @dirty_lock: Protects dirty_lines_start and dirty_lines_end
+ * @dirty_lock: Protects the dirty_lines_* and dirty_cols_* markers
  * @dirty_lines_start: Where to begin updating display
  * @dirty_lines_end: Where to end updating display
+ * @dirty_cols_start: First damaged column
+ * @dirty_cols_end: Last damaged column
+ * @damage_cols: Only write the damaged columns of the dirty lines
  * @gpio.reset: GPIO used to reset display
  * @gpio.dc: Data/Command signal, also known as RS
  * @gpio.rd: Read latching signal
@@ -205,6 +211,9 @@ struct fbtft_par {
 	spinlock_t dirty_lock;
 	unsigned int dirty_lines_start;
 	unsigned int dirty_lines_end;
+	unsigned int dirty_cols_start;
+	unsigned int dirty_cols_end;
+	bool damage_cols;
 	struct {
 		struct gpio_desc *reset;
 		struct gpio_desc *dc;
@@ -267,6 +276,9 @@ int fbtft_write_gpio16_wr_latched(struct fbtft_par *par, void *buf, size_t len);
 int fbtft_write_vmem8_bus8(struct fbtft_par *par, size_t offset, size_t len);
 int fbtft_write_vmem16_bus16(struct fbtft_par *par, size_t offset, size_t len);
 int fbtft_write_vmem16_bus8(struct fbtft_par *par, size_t offset, size_t len);
+int fbtft_write_vmem16_bus8_rect(struct fbtft_par *par, unsigned int xs,
+				 unsigned int ys, unsigned int xe,
+				 unsigned int ye);
 int fbtft_write_vmem16_bus9(struct fbtft_par *par, size_t offset, size_t len);
 void fbtft_write_reg8_bus8(struct fbtft_par *par, int len, ...);
 void fbtft_write_reg8_bus9(struct fbtft_par *par, int len, ...);
@@ -232,6 +232,8 @@ static int rpivid_open(struct file *file)
 	}
 
 	mutex_init(&ctx->ctx_mutex);
+	rpivid_hw_irq_q_init(&ctx->hwq1, RPIVID_P2BUF_COUNT);
+	rpivid_hw_irq_q_init(&ctx->hwq2, RPIVID_ICTL_ENABLE_UNLIMITED);
 
 	v4l2_fh_init(&ctx->fh, video_devdata(file));
 	file->private_data = &ctx->fh;
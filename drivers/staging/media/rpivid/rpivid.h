@@ -27,6 +27,8 @@
 #define RPIVID_DEC_ENV_COUNT 6
 #define RPIVID_P1BUF_COUNT 3
 #define RPIVID_P2BUF_COUNT 3
+/* Spare P1-P2 buffers kept for reuse across contexts */
+#define RPIVID_POOL_COUNT (2 * RPIVID_P2BUF_COUNT)
 
 #define RPIVID_NAME			"rpivid"
 
@@ -82,6 +84,18 @@ typedef void (*rpivid_irq_callback)(struct rpivid_dev *dev, void *ctx);
 struct rpivid_q_aux;
 #define RPIVID_AUX_ENT_COUNT VB2_MAX_FRAME
 
+struct rpivid_hw_irq_ent;
+
+/* Per context claim Q for one phase of the h/w */
+struct rpivid_hw_irq_q {
+	/* Link in rpivid_hw_irq_ctrl.ready whilst claims are pending */
+	struct list_head ready;
+	struct rpivid_hw_irq_ent *claim;
+	struct rpivid_hw_irq_ent *tail;
+	/* Enable count. -1 always OK, 0 do not sched, +ve sched & count down */
+	int enable;
+};
+
 struct rpivid_ctx {
 	struct v4l2_fh			fh;
 	struct rpivid_dev		*dev;
@@ -120,10 +134,16 @@ struct rpivid_ctx {
 	atomic_t p1out;
 	struct rpivid_gptr bitbufs[RPIVID_P1BUF_COUNT];
 
-	/* *** Should be in dev *** */
 	unsigned int p2idx;
 	struct rpivid_gptr pu_bufs[RPIVID_P2BUF_COUNT];
 	struct rpivid_gptr coeff_bufs[RPIVID_P2BUF_COUNT];
+	/* Largest PU & Coeff buffers phase 1 has needed so far */
+	size_t pu_peak;
+	size_t coeff_peak;
+
+	/* Claim Qs for phase 1 & 2, limited by our own P1-P2 buffers */
+	struct rpivid_hw_irq_q hwq1;
+	struct rpivid_hw_irq_q hwq2;
 
 	/* Spinlock protecting aux_free */
 	spinlock_t aux_lock;
@@ -148,15 +168,13 @@ struct rpivid_variant {
 	unsigned int	mod_rate;
 };
 
-struct rpivid_hw_irq_ent;
-
 #define RPIVID_ICTL_ENABLE_UNLIMITED (-1)
 
 struct rpivid_hw_irq_ctrl {
-	/* Spinlock protecting claim and tail */
+	/* Spinlock protecting ready and the claim Qs on it */
 	spinlock_t lock;
-	struct rpivid_hw_irq_ent *claim;
-	struct rpivid_hw_irq_ent *tail;
+	/* Claim Qs with pending claims in round robin order */
+	struct list_head ready;
 
 	/* Ent for pending irq - also prevents sched */
 	struct rpivid_hw_irq_ent *irq;
@@ -191,6 +209,21 @@ struct rpivid_dev {
 
 	struct rpivid_hw_irq_ctrl ic_active1;
 	struct rpivid_hw_irq_ctrl ic_active2;
+
+	/* Mutex protecting pool and pool_bytes */
+	struct mutex		pool_lock;
+	struct rpivid_gptr	pool[RPIVID_POOL_COUNT];
+	size_t			pool_bytes;
+
+	struct {
+		/* Phase 1 reruns due to PU or Coeff exhaustion */
+		atomic_t	realloc;
+		/* Buffers grown to the context peak ahead of use */
+		atomic_t	pregrow;
+		atomic_t	pool_hit;
+		atomic_t	pool_miss;
+	} stats;
+	struct dentry		*debugfs;
 };
 
 extern const struct rpivid_dec_ops rpivid_dec_ops_h265;
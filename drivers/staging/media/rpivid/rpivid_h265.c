@@ -78,7 +78,8 @@ static void gptr_free(struct rpivid_dev *const dev,
 
 /* Realloc but do not copy
  *
- * Frees then allocs.
+ * Returns the old buffer to the pool then gets the new one, from the pool
+ * if something big enough is there. The result may be bigger than asked.
  * If the alloc fails then it attempts to re-allocote the old size
  * On error then check gptr->ptr to determine if anything is currently
  * allocated.
@@ -87,33 +88,17 @@ static int gptr_realloc_new(struct rpivid_dev * const dev,
 			    struct rpivid_gptr * const gptr, size_t size)
 {
 	const size_t old_size = gptr->size;
+	const unsigned long attrs = gptr->attrs;
 
-	if (size == gptr->size)
+	if (size <= gptr->size)
 		return 0;
 
-	if (gptr->ptr)
-		dma_free_attrs(dev->dev, gptr->size, gptr->ptr,
-			       gptr->addr, gptr->attrs);
-
-	gptr->addr = 0;
-	gptr->size = size;
-	gptr->ptr = dma_alloc_attrs(dev->dev, gptr->size,
-				    &gptr->addr, GFP_KERNEL, gptr->attrs);
-
-	if (!gptr->ptr) {
-		gptr->addr = 0;
-		gptr->size = old_size;
-		gptr->ptr = dma_alloc_attrs(dev->dev, gptr->size,
-					    &gptr->addr, GFP_KERNEL, gptr->attrs);
-		if (!gptr->ptr) {
-			gptr->size = 0;
-			gptr->addr = 0;
-			gptr->attrs = 0;
-		}
-		return -ENOMEM;
-	}
+	rpivid_hw_gptr_put(dev, gptr);
+	if (!rpivid_hw_gptr_get(dev, gptr, size, attrs))
+		return 0;
 
-	return 0;
+	rpivid_hw_gptr_get(dev, gptr, old_size, attrs);
+	return -ENOMEM;
 }
 
 static size_t next_size(const size_t x)
@@ -121,6 +106,17 @@ static size_t next_size(const size_t x)
 	return rpivid_round_up_size(x + 1);
 }
 
+/* Size to grow an exhausted buffer to - at least the biggest any buffer in
+ * the context has needed so we don't walk each one up separately
+ */
+static size_t next_size_peak(const size_t x, size_t * const peak)
+{
+	const size_t n = max(next_size(x), READ_ONCE(*peak));
+
+	WRITE_ONCE(*peak, n);
+	return n;
+}
+
 #define NUM_SCALING_FACTORS 4064 /* Not a typo = 0xbe0 + 0x400 */
 
 #define AXI_BASE64 0
@@ -162,6 +158,7 @@ struct rpivid_dec_env {
 	enum rpivid_decode_state state;
 	unsigned int decode_order;
 	int p1_status;		/* P1 status - what to realloc */
+	unsigned int p2idx;	/* P1-P2 buffers in use */
 
 	struct rpi_cmd *cmd_fifo;
 	unsigned int cmd_len, cmd_max;
@@ -221,6 +218,29 @@ struct rpivid_dec_env {
 
 #define member_size(type, member) sizeof(((type *)0)->member)
 
+/* Number of SPS/PPS combinations whose derived tables are kept */
+#define RPIVID_PS_CACHE_COUNT 4
+
+struct rpivid_ps_cache_ent {
+	struct v4l2_ctrl_hevc_sps sps;
+	struct v4l2_ctrl_hevc_pps pps;
+	unsigned int last_used;		/* 0 if unused */
+
+	unsigned int log2_ctb_size;
+	unsigned int ctb_width;
+	unsigned int ctb_height;
+	unsigned int ctb_size;
+	unsigned int tile_width;
+	unsigned int tile_height;
+
+	int *col_bd;
+	int *row_bd;
+	int *ctb_addr_rs_to_ts;
+	int *ctb_addr_ts_to_rs;
+	int *ctb_col_tile;
+	int *ctb_row_tile;
+};
+
 struct rpivid_dec_state {
 	struct v4l2_ctrl_hevc_sps sps;
 	struct v4l2_ctrl_hevc_pps pps;
@@ -237,6 +257,12 @@ struct rpivid_dec_state {
 	int *row_bd;
 	int *ctb_addr_rs_to_ts;
 	int *ctb_addr_ts_to_rs;
+	int *ctb_col_tile;              /* CTB X -> tile X */
+	int *ctb_row_tile;              /* CTB Y -> tile Y */
+
+	// Owners of the tables above
+	struct rpivid_ps_cache_ent ps_cache[RPIVID_PS_CACHE_COUNT];
+	unsigned int ps_cache_seq;
 
 	// Aux starage for DPB
 	// Hold refs
@@ -343,25 +369,16 @@ static void p1_apb_write(struct rpivid_dec_env *const de, const u16 addr,
 	de->cmd_len++;
 }
 
-static int ctb_to_tile(unsigned int ctb, unsigned int *bd, int num)
-{
-	int i;
-
-	for (i = 1; ctb >= bd[i]; i++)
-		; // bd[] has num+1 elements; bd[0]=0;
-	return i - 1;
-}
-
 static unsigned int ctb_to_tile_x(const struct rpivid_dec_state *const s,
 				  const unsigned int ctb_x)
 {
-	return ctb_to_tile(ctb_x, s->col_bd, s->tile_width);
+	return s->ctb_col_tile[ctb_x];
 }
 
 static unsigned int ctb_to_tile_y(const struct rpivid_dec_state *const s,
 				  const unsigned int ctb_y)
 {
-	return ctb_to_tile(ctb_y, s->row_bd, s->tile_height);
+	return s->ctb_row_tile[ctb_y];
 }
 
 static void aux_q_free(struct rpivid_ctx *const ctx,
@@ -1375,44 +1392,82 @@ static void populate_scaling_factors(const struct rpivid_run *const run,
 				    sl->scaling_list_dc_coef_32x32[mid]);
 }
 
-static void free_ps_info(struct rpivid_dec_state *const s)
+static void ps_cache_ent_free(struct rpivid_ps_cache_ent *const ent)
+{
+	kfree(ent->ctb_addr_rs_to_ts);
+	kfree(ent->ctb_addr_ts_to_rs);
+	kfree(ent->col_bd);
+	kfree(ent->row_bd);
+	kfree(ent->ctb_col_tile);
+	kfree(ent->ctb_row_tile);
+	memset(ent, 0, sizeof(*ent));
+}
+
+static void clear_ps_info(struct rpivid_dec_state *const s)
 {
-	kfree(s->ctb_addr_rs_to_ts);
 	s->ctb_addr_rs_to_ts = NULL;
-	kfree(s->ctb_addr_ts_to_rs);
 	s->ctb_addr_ts_to_rs = NULL;
-
-	kfree(s->col_bd);
 	s->col_bd = NULL;
-	kfree(s->row_bd);
 	s->row_bd = NULL;
+	s->ctb_col_tile = NULL;
+	s->ctb_row_tile = NULL;
+}
+
+static void free_ps_info(struct rpivid_dec_state *const s)
+{
+	unsigned int i;
+
+	for (i = 0; i != RPIVID_PS_CACHE_COUNT; ++i)
+		ps_cache_ent_free(s->ps_cache + i);
+	clear_ps_info(s);
 }
 
-static unsigned int tile_width(const struct rpivid_dec_state *const s,
+/* Make a cache entry current - the tables remain owned by the entry */
+static void load_ps_info(struct rpivid_dec_state *const s,
+			 struct rpivid_ps_cache_ent *const ent)
+{
+	ent->last_used = ++s->ps_cache_seq;
+
+	s->log2_ctb_size = ent->log2_ctb_size;
+	s->ctb_width = ent->ctb_width;
+	s->ctb_height = ent->ctb_height;
+	s->ctb_size = ent->ctb_size;
+	s->tile_width = ent->tile_width;
+	s->tile_height = ent->tile_height;
+
+	s->col_bd = ent->col_bd;
+	s->row_bd = ent->row_bd;
+	s->ctb_addr_rs_to_ts = ent->ctb_addr_rs_to_ts;
+	s->ctb_addr_ts_to_rs = ent->ctb_addr_ts_to_rs;
+	s->ctb_col_tile = ent->ctb_col_tile;
+	s->ctb_row_tile = ent->ctb_row_tile;
+}
+
+static unsigned int tile_width(const struct rpivid_ps_cache_ent *const ent,
 			       const unsigned int t_x)
 {
-	return s->col_bd[t_x + 1] - s->col_bd[t_x];
+	return ent->col_bd[t_x + 1] - ent->col_bd[t_x];
 }
 
-static unsigned int tile_height(const struct rpivid_dec_state *const s,
+static unsigned int tile_height(const struct rpivid_ps_cache_ent *const ent,
 				const unsigned int t_y)
 {
-	return s->row_bd[t_y + 1] - s->row_bd[t_y];
+	return ent->row_bd[t_y + 1] - ent->row_bd[t_y];
 }
 
-static void fill_rs_to_ts(struct rpivid_dec_state *const s)
+static void fill_rs_to_ts(struct rpivid_ps_cache_ent *const ent)
 {
 	unsigned int ts = 0;
 	unsigned int t_y;
 	unsigned int tr_rs = 0;
 
-	for (t_y = 0; t_y != s->tile_height; ++t_y) {
-		const unsigned int t_h = tile_height(s, t_y);
+	for (t_y = 0; t_y != ent->tile_height; ++t_y) {
+		const unsigned int t_h = tile_height(ent, t_y);
 		unsigned int t_x;
 		unsigned int tc_rs = tr_rs;
 
-		for (t_x = 0; t_x != s->tile_width; ++t_x) {
-			const unsigned int t_w = tile_width(s, t_x);
+		for (t_x = 0; t_x != ent->tile_width; ++t_x) {
+			const unsigned int t_w = tile_width(ent, t_x);
 			unsigned int y;
 			unsigned int rs = tc_rs;
 
@@ -1420,83 +1475,143 @@ static void fill_rs_to_ts(struct rpivid_dec_state *const s)
 				unsigned int x;
 
 				for (x = 0; x != t_w; ++x) {
-					s->ctb_addr_rs_to_ts[rs + x] = ts;
-					s->ctb_addr_ts_to_rs[ts] = rs + x;
+					ent->ctb_addr_rs_to_ts[rs + x] = ts;
+					ent->ctb_addr_ts_to_rs[ts] = rs + x;
 					++ts;
 				}
-				rs += s->ctb_width;
+				rs += ent->ctb_width;
 			}
 			tc_rs += t_w;
 		}
-		tr_rs += t_h * s->ctb_width;
+		tr_rs += t_h * ent->ctb_width;
 	}
 }
 
-static int updated_ps(struct rpivid_dec_state *const s)
+static void fill_ctb_to_tile(int *const ctb_tile, const int *const bd,
+			     const unsigned int num)
 {
-	unsigned int i;
+	unsigned int t;
+	int ctb;
 
-	free_ps_info(s);
+	for (t = 0; t != num; ++t)
+		for (ctb = bd[t]; ctb != bd[t + 1]; ++ctb)
+			ctb_tile[ctb] = t;
+}
+
+static int build_ps_info(struct rpivid_ps_cache_ent *const ent)
+{
+	const struct v4l2_ctrl_hevc_sps *const sps = &ent->sps;
+	const struct v4l2_ctrl_hevc_pps *const pps = &ent->pps;
+	unsigned int i;
 
 	// Inferred parameters
-	s->log2_ctb_size = s->sps.log2_min_luma_coding_block_size_minus3 + 3 +
-			   s->sps.log2_diff_max_min_luma_coding_block_size;
+	ent->log2_ctb_size = sps->log2_min_luma_coding_block_size_minus3 + 3 +
+			     sps->log2_diff_max_min_luma_coding_block_size;
 
-	s->ctb_width = (s->sps.pic_width_in_luma_samples +
-			(1 << s->log2_ctb_size) - 1) >>
-		       s->log2_ctb_size;
-	s->ctb_height = (s->sps.pic_height_in_luma_samples +
-			 (1 << s->log2_ctb_size) - 1) >>
-			s->log2_ctb_size;
-	s->ctb_size = s->ctb_width * s->ctb_height;
+	ent->ctb_width = (sps->pic_width_in_luma_samples +
+			  (1 << ent->log2_ctb_size) - 1) >>
+			 ent->log2_ctb_size;
+	ent->ctb_height = (sps->pic_height_in_luma_samples +
+			   (1 << ent->log2_ctb_size) - 1) >>
+			  ent->log2_ctb_size;
+	ent->ctb_size = ent->ctb_width * ent->ctb_height;
 
 	// Inferred parameters
 
-	s->ctb_addr_rs_to_ts = kmalloc_array(s->ctb_size,
-					     sizeof(*s->ctb_addr_rs_to_ts),
-					     GFP_KERNEL);
-	if (!s->ctb_addr_rs_to_ts)
-		goto fail;
-	s->ctb_addr_ts_to_rs = kmalloc_array(s->ctb_size,
-					     sizeof(*s->ctb_addr_ts_to_rs),
-					     GFP_KERNEL);
-	if (!s->ctb_addr_ts_to_rs)
-		goto fail;
+	ent->ctb_addr_rs_to_ts = kmalloc_array(ent->ctb_size,
+					       sizeof(*ent->ctb_addr_rs_to_ts),
+					       GFP_KERNEL);
+	if (!ent->ctb_addr_rs_to_ts)
+		return -ENOMEM;
+	ent->ctb_addr_ts_to_rs = kmalloc_array(ent->ctb_size,
+					       sizeof(*ent->ctb_addr_ts_to_rs),
+					       GFP_KERNEL);
+	if (!ent->ctb_addr_ts_to_rs)
+		return -ENOMEM;
 
-	if (!(s->pps.flags & V4L2_HEVC_PPS_FLAG_TILES_ENABLED)) {
-		s->tile_width = 1;
-		s->tile_height = 1;
+	if (!(pps->flags & V4L2_HEVC_PPS_FLAG_TILES_ENABLED)) {
+		ent->tile_width = 1;
+		ent->tile_height = 1;
 	} else {
-		s->tile_width = s->pps.num_tile_columns_minus1 + 1;
-		s->tile_height = s->pps.num_tile_rows_minus1 + 1;
+		ent->tile_width = pps->num_tile_columns_minus1 + 1;
+		ent->tile_height = pps->num_tile_rows_minus1 + 1;
 	}
 
-	s->col_bd = kmalloc((s->tile_width + 1) * sizeof(*s->col_bd),
-			    GFP_KERNEL);
-	if (!s->col_bd)
-		goto fail;
-	s->row_bd = kmalloc((s->tile_height + 1) * sizeof(*s->row_bd),
-			    GFP_KERNEL);
-	if (!s->row_bd)
-		goto fail;
+	ent->col_bd = kmalloc((ent->tile_width + 1) * sizeof(*ent->col_bd),
+			      GFP_KERNEL);
+	if (!ent->col_bd)
+		return -ENOMEM;
+	ent->row_bd = kmalloc((ent->tile_height + 1) * sizeof(*ent->row_bd),
+			      GFP_KERNEL);
+	if (!ent->row_bd)
+		return -ENOMEM;
+	ent->ctb_col_tile = kmalloc_array(ent->ctb_width,
+					  sizeof(*ent->ctb_col_tile),
+					  GFP_KERNEL);
+	if (!ent->ctb_col_tile)
+		return -ENOMEM;
+	ent->ctb_row_tile = kmalloc_array(ent->ctb_height,
+					  sizeof(*ent->ctb_row_tile),
+					  GFP_KERNEL);
+	if (!ent->ctb_row_tile)
+		return -ENOMEM;
+
+	ent->col_bd[0] = 0;
+	for (i = 1; i < ent->tile_width; i++)
+		ent->col_bd[i] = ent->col_bd[i - 1] +
+			pps->column_width_minus1[i - 1] + 1;
+	ent->col_bd[ent->tile_width] = ent->ctb_width;
+
+	ent->row_bd[0] = 0;
+	for (i = 1; i < ent->tile_height; i++)
+		ent->row_bd[i] = ent->row_bd[i - 1] +
+			pps->row_height_minus1[i - 1] + 1;
+	ent->row_bd[ent->tile_height] = ent->ctb_height;
+
+	fill_rs_to_ts(ent);
+	fill_ctb_to_tile(ent->ctb_col_tile, ent->col_bd, ent->tile_width);
+	fill_ctb_to_tile(ent->ctb_row_tile, ent->row_bd, ent->tile_height);
+	return 0;
+}
 
-	s->col_bd[0] = 0;
-	for (i = 1; i < s->tile_width; i++)
-		s->col_bd[i] = s->col_bd[i - 1] +
-			s->pps.column_width_minus1[i - 1] + 1;
-	s->col_bd[s->tile_width] = s->ctb_width;
+/*
+ * Called when s->sps or s->pps has changed. Streams commonly switch between
+ * a few PPSs so the derived tables are kept for the most recently used
+ * combinations and only rebuilt when a new one turns up. Entries are
+ * matched on the whole of both PS so a redefined id is not mistaken for
+ * its old contents.
+ */
+static int updated_ps(struct rpivid_dec_state *const s)
+{
+	struct rpivid_ps_cache_ent *ent = NULL;
+	unsigned int i;
 
-	s->row_bd[0] = 0;
-	for (i = 1; i < s->tile_height; i++)
-		s->row_bd[i] = s->row_bd[i - 1] +
-			s->pps.row_height_minus1[i - 1] + 1;
-	s->row_bd[s->tile_height] = s->ctb_height;
+	for (i = 0; i != RPIVID_PS_CACHE_COUNT; ++i) {
+		struct rpivid_ps_cache_ent *const e = s->ps_cache + i;
 
-	fill_rs_to_ts(s);
+		if (e->last_used &&
+		    !memcmp(&e->sps, &s->sps, sizeof(s->sps)) &&
+		    !memcmp(&e->pps, &s->pps, sizeof(s->pps))) {
+			load_ps_info(s, e);
+			return 0;
+		}
+		/* Unused entries have last_used == 0 so are taken first */
+		if (!ent || e->last_used < ent->last_used)
+			ent = e;
+	}
+
+	ps_cache_ent_free(ent);
+	memcpy(&ent->sps, &s->sps, sizeof(s->sps));
+	memcpy(&ent->pps, &s->pps, sizeof(s->pps));
+	if (build_ps_info(ent))
+		goto fail;
+
+	load_ps_info(s, ent);
 	return 0;
 
 fail:
-	free_ps_info(s);
+	ps_cache_ent_free(ent);
+	clear_ps_info(s);
 	/* Set invalid to force reload */
 	s->sps.pic_width_in_luma_samples = 0;
 	return -ENOMEM;
@@ -2096,14 +2211,11 @@ static int check_status(const struct rpivid_dev *const dev)
 	return -1;
 }
 
-static void phase2_cb(struct rpivid_dev *const dev, void *v)
+static void phase2_done(struct rpivid_dev *const dev,
+			struct rpivid_dec_env *const de)
 {
-	struct rpivid_dec_env *const de = v;
-
-	xtrace_in(dev, de);
-
 	/* Done with buffers - allow new P1 */
-	rpivid_hw_irq_active1_enable_claim(dev, 1);
+	rpivid_hw_irq_active1_enable_claim(dev, &de->ctx->hwq1, 1);
 
 	v4l2_m2m_buf_done(de->frame_buf, VB2_BUF_STATE_DONE);
 	de->frame_buf = NULL;
@@ -2116,10 +2228,63 @@ static void phase2_cb(struct rpivid_dev *const dev, void *v)
 	de->req_obj = NULL;
 #endif
 
-	xtrace_ok(dev, de);
 	dec_env_delete(de);
 }
 
+/* The P1-P2 buffers just released are smaller than a previous frame
+ * needed so are likely to make phase 1 run twice when next used. Grow them
+ * now whilst they are idle - phase 1 cannot reuse them until phase2_done.
+ */
+static bool p2bufs_small(const struct rpivid_dec_env *const de)
+{
+	const struct rpivid_ctx *const ctx = de->ctx;
+
+	return ctx->pu_bufs[de->p2idx].size < READ_ONCE(ctx->pu_peak) ||
+	       ctx->coeff_bufs[de->p2idx].size < READ_ONCE(ctx->coeff_peak);
+}
+
+static void phase2_thread(struct rpivid_dev *const dev, void *v)
+{
+	struct rpivid_dec_env *const de = v;
+	struct rpivid_ctx *const ctx = de->ctx;
+	struct rpivid_gptr *const pu_gptr = ctx->pu_bufs + de->p2idx;
+	struct rpivid_gptr *const coeff_gptr = ctx->coeff_bufs + de->p2idx;
+
+	xtrace_in(dev, de);
+
+	/* Failure just means phase 1 will realloc later as it always did */
+	gptr_realloc_new(dev, pu_gptr, READ_ONCE(ctx->pu_peak));
+	gptr_realloc_new(dev, coeff_gptr, READ_ONCE(ctx->coeff_peak));
+	atomic_inc(&dev->stats.pregrow);
+
+	if (!pu_gptr->addr || !coeff_gptr->addr) {
+		v4l2_err(&dev->v4l2_dev,
+			 "%s: Fatal: failed to reclaim old alloc\n",
+			 __func__);
+		ctx->fatal_err = 1;
+	}
+
+	xtrace_ok(dev, de);
+	phase2_done(dev, de);
+}
+
+static void phase2_cb(struct rpivid_dev *const dev, void *v)
+{
+	struct rpivid_dec_env *const de = v;
+
+	xtrace_in(dev, de);
+
+	if (p2bufs_small(de)) {
+		/* Realloc needs to be pushed onto a thread */
+		rpivid_hw_irq_active2_thread(dev, &de->irq_ent,
+					     phase2_thread, de);
+		return;
+	}
+
+	xtrace_ok(dev, de);
+	phase2_done(dev, de);
+}
+
 static void phase2_claimed(struct rpivid_dev *const dev, void *v)
 {
 	struct rpivid_dec_env *const de = v;
@@ -2212,7 +2377,7 @@ static void phase1_err_fin(struct rpivid_dev *const dev,
 		v4l2_m2m_job_finish(dev->m2m_dev, ctx->fh.m2m_ctx);
 
 	/* Done with P1-P2 buffers - allow new P1 */
-	rpivid_hw_irq_active1_enable_claim(dev, 1);
+	rpivid_hw_irq_active1_enable_claim(dev, &ctx->hwq1, 1);
 }
 
 static void phase1_thread(struct rpivid_dev *const dev, void *v)
@@ -2225,8 +2390,12 @@ static void phase1_thread(struct rpivid_dev *const dev, void *v)
 
 	xtrace_in(dev, de);
 
+	atomic_inc(&dev->stats.realloc);
+
 	if (de->p1_status & STATUS_PU_EXHAUSTED) {
-		if (gptr_realloc_new(dev, pu_gptr, next_size(pu_gptr->size))) {
+		if (gptr_realloc_new(dev, pu_gptr,
+				     next_size_peak(pu_gptr->size,
+						    &ctx->pu_peak))) {
 			v4l2_err(&dev->v4l2_dev,
 				 "%s: PU realloc (%zx) failed\n",
 				 __func__, pu_gptr->size);
@@ -2238,7 +2407,8 @@ static void phase1_thread(struct rpivid_dev *const dev, void *v)
 
 	if (de->p1_status & STATUS_COEFF_EXHAUSTED) {
 		if (gptr_realloc_new(dev, coeff_gptr,
-				     next_size(coeff_gptr->size))) {
+				     next_size_peak(coeff_gptr->size,
+						    &ctx->coeff_peak))) {
 			v4l2_err(&dev->v4l2_dev,
 				 "%s: Coeff realloc (%zx) failed\n",
 				 __func__, coeff_gptr->size);
@@ -2299,7 +2469,8 @@ static void phase1_cb(struct rpivid_dev *const dev, void *v)
 		v4l2_m2m_job_finish(dev->m2m_dev, ctx->fh.m2m_ctx);
 	}
 
-	rpivid_hw_irq_active2_claim(dev, &de->irq_ent, phase2_claimed, de);
+	rpivid_hw_irq_active2_claim(dev, &ctx->hwq2, &de->irq_ent,
+				    phase2_claimed, de);
 
 	xtrace_ok(dev, de);
 	return;
@@ -2323,6 +2494,7 @@ static void phase1_claimed(struct rpivid_dev *const dev, void *v)
 	if (ctx->fatal_err)
 		goto fail;
 
+	de->p2idx = ctx->p2idx;
 	de->pu_base_vc = pu_gptr->addr;
 	de->pu_stride =
 		ALIGN_DOWN(pu_gptr->size / de->pic_height_in_ctbs_y, 64);
@@ -2376,6 +2548,7 @@ static void dec_state_delete(struct rpivid_ctx *const ctx)
 }
 
 struct irq_sync {
+	struct rpivid_ctx *ctx;
 	atomic_t done;
 	wait_queue_head_t wq;
 	struct rpivid_hw_irq_ent irq_ent;
@@ -2393,26 +2566,30 @@ static void phase1_sync_claimed(struct rpivid_dev *const dev, void *v)
 {
 	struct irq_sync *const sync = v;
 
-	rpivid_hw_irq_active1_enable_claim(dev, 1);
-	rpivid_hw_irq_active2_claim(dev, &sync->irq_ent, phase2_sync_claimed, sync);
+	rpivid_hw_irq_active1_enable_claim(dev, &sync->ctx->hwq1, 1);
+	rpivid_hw_irq_active2_claim(dev, &sync->ctx->hwq2, &sync->irq_ent,
+				    phase2_sync_claimed, sync);
 }
 
 /* Sync with IRQ operations
  *
  * Claims phase1 and phase2 in turn and waits for the phase2 claim so any
- * pending IRQ ops will have completed by the time this returns
+ * pending IRQ ops for this context will have completed by the time this
+ * returns. Other contexts are unaffected.
  *
  * phase1 has counted enables so must reenable once claimed
  * phase2 has unlimited enables
  */
-static void irq_sync(struct rpivid_dev *const dev)
+static void irq_sync(struct rpivid_dev *const dev, struct rpivid_ctx *const ctx)
 {
 	struct irq_sync sync;
 
+	sync.ctx = ctx;
 	atomic_set(&sync.done, 0);
 	init_waitqueue_head(&sync.wq);
 
-	rpivid_hw_irq_active1_claim(dev, &sync.irq_ent, phase1_sync_claimed, &sync);
+	rpivid_hw_irq_active1_claim(dev, &ctx->hwq1, &sync.irq_ent,
+				    phase1_sync_claimed, &sync);
 	wait_event(sync.wq, atomic_read(&sync.done));
 }
 
@@ -2430,9 +2607,9 @@ static void h265_ctx_uninit(struct rpivid_dev *const dev, struct rpivid_ctx *ctx
 	for (i = 0; i != ARRAY_SIZE(ctx->bitbufs); ++i)
 		gptr_free(dev, ctx->bitbufs + i);
 	for (i = 0; i != ARRAY_SIZE(ctx->pu_bufs); ++i)
-		gptr_free(dev, ctx->pu_bufs + i);
+		rpivid_hw_gptr_put(dev, ctx->pu_bufs + i);
 	for (i = 0; i != ARRAY_SIZE(ctx->coeff_bufs); ++i)
-		gptr_free(dev, ctx->coeff_bufs + i);
+		rpivid_hw_gptr_put(dev, ctx->coeff_bufs + i);
 }
 
 static void rpivid_h265_stop(struct rpivid_ctx *ctx)
@@ -2441,7 +2618,7 @@ static void rpivid_h265_stop(struct rpivid_ctx *ctx)
 
 	v4l2_info(&dev->v4l2_dev, "%s\n", __func__);
 
-	irq_sync(dev);
+	irq_sync(dev, ctx);
 	h265_ctx_uninit(dev, ctx);
 }
 
@@ -2490,19 +2667,22 @@ static int rpivid_h265_start(struct rpivid_ctx *ctx)
 
 	// Finger in the air PU & Coeff alloc
 	// Will be realloced if too small
+	// Buffers left in the pool by a previous stream are used if they fit
 	coeff_alloc = rpivid_round_up_size(wxh);
 	pu_alloc = rpivid_round_up_size(wxh / 4);
+	ctx->pu_peak = 0;
+	ctx->coeff_peak = 0;
 	for (i = 0; i != ARRAY_SIZE(ctx->pu_bufs); ++i) {
 		// Don't actually need a kernel mapping here
-		if (gptr_alloc(dev, ctx->pu_bufs + i, pu_alloc,
-			       DMA_ATTR_NO_KERNEL_MAPPING)) {
+		if (rpivid_hw_gptr_get(dev, ctx->pu_bufs + i, pu_alloc,
+				       DMA_ATTR_NO_KERNEL_MAPPING)) {
 			v4l2_err(&dev->v4l2_dev,
 				 "Failed to alloc %#zx PU%d buffer\n",
 				 pu_alloc, i);
 			goto fail;
 		}
-		if (gptr_alloc(dev, ctx->coeff_bufs + i, coeff_alloc,
-			       DMA_ATTR_NO_KERNEL_MAPPING)) {
+		if (rpivid_hw_gptr_get(dev, ctx->coeff_bufs + i, coeff_alloc,
+				       DMA_ATTR_NO_KERNEL_MAPPING)) {
 			v4l2_err(&dev->v4l2_dev,
 				 "Failed to alloc %#zx Coeff%d buffer\n",
 				 pu_alloc, i);
@@ -2596,8 +2776,8 @@ static void rpivid_h265_trigger(struct rpivid_ctx *ctx)
 			v4l2_m2m_job_finish(dev->m2m_dev, ctx->fh.m2m_ctx);
 		}
 
-		rpivid_hw_irq_active1_claim(dev, &de->irq_ent, phase1_claimed,
-					    de);
+		rpivid_hw_irq_active1_claim(dev, &ctx->hwq1, &de->irq_ent,
+					    phase1_claimed, de);
 		xtrace_ok(dev, de);
 		break;
 	}
@@ -12,9 +12,11 @@
  */
 #include <linux/clk.h>
 #include <linux/component.h>
+#include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/module.h>
 #include <linux/of_reserved_mem.h>
 #include <linux/of_device.h>
 #include <linux/of_platform.h>
@@ -30,6 +32,10 @@
 #include "rpivid.h"
 #include "rpivid_hw.h"
 
+static unsigned int pool_kb;
+module_param(pool_kb, uint, 0644);
+MODULE_PARM_DESC(pool_kb, "max size of spare decode buffers kept for reuse (KiB), 0 (default) disables the pool");
+
 static void pre_irq(struct rpivid_dev *dev, struct rpivid_hw_irq_ent *ient,
 		    rpivid_irq_callback cb, void *v,
 		    struct rpivid_hw_irq_ctrl *ictl)
@@ -65,20 +71,42 @@ static inline void set_claimed(struct rpivid_hw_irq_ctrl * const ictl)
 }
 
 /* Should be called from inside ictl->lock */
+static inline void q_set_claimed(struct rpivid_hw_irq_q * const q)
+{
+	if (q->enable > 0)
+		--q->enable;
+}
+
+/* Should be called from inside ictl->lock
+ * Takes the first claim from the first Q on the ready list that is enabled
+ * and moves that Q to the back of the list so contexts are served round
+ * robin. A Q that has used up its enables stays where it is so it gets
+ * first go once reenabled.
+ */
 static struct rpivid_hw_irq_ent *get_sched(struct rpivid_hw_irq_ctrl * const ictl)
 {
 	struct rpivid_hw_irq_ent *ient;
+	struct rpivid_hw_irq_q *q;
 
 	if (!sched_enabled(ictl))
 		return NULL;
 
-	ient = ictl->claim;
-	if (!ient)
-		return NULL;
-	ictl->claim = ient->next;
+	list_for_each_entry(q, &ictl->ready, ready) {
+		if (!q->enable)
+			continue;
 
-	set_claimed(ictl);
-	return ient;
+		ient = q->claim;
+		q->claim = ient->next;
+		if (q->claim)
+			list_move_tail(&q->ready, &ictl->ready);
+		else
+			list_del_init(&q->ready);
+
+		q_set_claimed(q);
+		set_claimed(ictl);
+		return ient;
+	}
+	return NULL;
 }
 
 /* Run a callback & check to see if there is anything else to run */
@@ -132,6 +160,7 @@ static void do_irq(struct rpivid_dev * const dev,
 }
 
 static void do_claim(struct rpivid_dev * const dev,
+		     struct rpivid_hw_irq_q * const q,
 		     struct rpivid_hw_irq_ent *ient,
 		     const rpivid_irq_callback cb, void * const v,
 		     struct rpivid_hw_irq_ctrl * const ictl)
@@ -144,19 +173,24 @@ static void do_claim(struct rpivid_dev * const dev,
 
 	spin_lock_irqsave(&ictl->lock, flags);
 
-	if (ictl->claim) {
+	if (q->claim) {
 		// If we have a Q then add to end
-		ictl->tail->next = ient;
-		ictl->tail = ient;
+		q->tail->next = ient;
+		q->tail = ient;
 		ient = NULL;
-	} else if (!sched_enabled(ictl)) {
-		// Empty Q but other activity in progress so Q
-		ictl->claim = ient;
-		ictl->tail = ient;
+	} else if (!sched_enabled(ictl) || !q->enable) {
+		// Empty Q but other activity in progress or we are at our
+		// limit so Q and join the round robin
+		q->claim = ient;
+		q->tail = ient;
+		list_add_tail(&q->ready, &ictl->ready);
 		ient = NULL;
 	} else {
 		// Nothing else going on - schedule immediately and
 		// prevent anything else scheduling claims
+		// Anything already on the ready list must be waiting for
+		// enables as it would have been scheduled otherwise
+		q_set_claimed(q);
 		set_claimed(ictl);
 	}
 
@@ -173,6 +207,7 @@ static void do_claim(struct rpivid_dev * const dev,
  * The enable count is automatically decremented every time a claim is run
  */
 static void do_enable_claim(struct rpivid_dev * const dev,
+			    struct rpivid_hw_irq_q * const q,
 			    int n,
 			    struct rpivid_hw_irq_ctrl * const ictl)
 {
@@ -180,7 +215,7 @@ static void do_enable_claim(struct rpivid_dev * const dev,
 	struct rpivid_hw_irq_ent *ient;
 
 	spin_lock_irqsave(&ictl->lock, flags);
-	ictl->enable = n < 0 ? -1 : ictl->enable <= 0 ? n : ictl->enable + n;
+	q->enable = n < 0 ? -1 : q->enable <= 0 ? n : q->enable + n;
 	ient = get_sched(ictl);
 	spin_unlock_irqrestore(&ictl->lock, flags);
 
@@ -190,8 +225,7 @@ static void do_enable_claim(struct rpivid_dev * const dev,
 static void ictl_init(struct rpivid_hw_irq_ctrl * const ictl, int enables)
 {
 	spin_lock_init(&ictl->lock);
-	ictl->claim = NULL;
-	ictl->tail = NULL;
+	INIT_LIST_HEAD(&ictl->ready);
 	ictl->irq = NULL;
 	ictl->no_sched = 0;
 	ictl->enable = enables;
@@ -203,6 +237,14 @@ static void ictl_uninit(struct rpivid_hw_irq_ctrl * const ictl)
 	// Nothing to do
 }
 
+void rpivid_hw_irq_q_init(struct rpivid_hw_irq_q *q, int enables)
+{
+	INIT_LIST_HEAD(&q->ready);
+	q->claim = NULL;
+	q->tail = NULL;
+	q->enable = enables;
+}
+
 #if !OPT_DEBUG_POLL_IRQ
 static irqreturn_t rpivid_irq_irq(int irq, void *data)
 {
@@ -270,16 +312,18 @@ void rpivid_hw_irq_active1_thread(struct rpivid_dev *dev,
 }
 
 void rpivid_hw_irq_active1_enable_claim(struct rpivid_dev *dev,
+					struct rpivid_hw_irq_q *q,
 					int n)
 {
-	do_enable_claim(dev, n, &dev->ic_active1);
+	do_enable_claim(dev, q, n, &dev->ic_active1);
 }
 
 void rpivid_hw_irq_active1_claim(struct rpivid_dev *dev,
+				 struct rpivid_hw_irq_q *q,
 				 struct rpivid_hw_irq_ent *ient,
 				 rpivid_irq_callback ready_cb, void *ctx)
 {
-	do_claim(dev, ient, ready_cb, ctx, &dev->ic_active1);
+	do_claim(dev, q, ient, ready_cb, ctx, &dev->ic_active1);
 }
 
 void rpivid_hw_irq_active1_irq(struct rpivid_dev *dev,
@@ -290,10 +334,11 @@ void rpivid_hw_irq_active1_irq(struct rpivid_dev *dev,
 }
 
 void rpivid_hw_irq_active2_claim(struct rpivid_dev *dev,
+				 struct rpivid_hw_irq_q *q,
 				 struct rpivid_hw_irq_ent *ient,
 				 rpivid_irq_callback ready_cb, void *ctx)
 {
-	do_claim(dev, ient, ready_cb, ctx, &dev->ic_active2);
+	do_claim(dev, q, ient, ready_cb, ctx, &dev->ic_active2);
 }
 
 void rpivid_hw_irq_active2_irq(struct rpivid_dev *dev,
@@ -303,6 +348,119 @@ void rpivid_hw_irq_active2_irq(struct rpivid_dev *dev,
 	pre_irq(dev, ient, irq_cb, ctx, &dev->ic_active2);
 }
 
+/* May only be called from Active2 CB
+ * Phase 2 is held until the thread cb completes
+ */
+void rpivid_hw_irq_active2_thread(struct rpivid_dev *dev,
+				  struct rpivid_hw_irq_ent *ient,
+				  rpivid_irq_callback thread_cb, void *ctx)
+{
+	pre_thread(dev, ient, thread_cb, ctx, &dev->ic_active2);
+}
+
+static void pool_free_ent(struct rpivid_dev * const dev,
+			  struct rpivid_gptr * const p)
+{
+	dma_free_attrs(dev->dev, p->size, p->ptr, p->addr, p->attrs);
+	dev->pool_bytes -= p->size;
+	memset(p, 0, sizeof(*p));
+}
+
+/* Takes the smallest pooled buffer that fits as long as it isn't more than
+ * twice the size asked for, otherwise allocs a new one.
+ * On error gptr is left empty.
+ */
+int rpivid_hw_gptr_get(struct rpivid_dev *dev, struct rpivid_gptr *gptr,
+		       size_t size, unsigned long attrs)
+{
+	struct rpivid_gptr *best = NULL;
+	unsigned int i;
+
+	mutex_lock(&dev->pool_lock);
+	for (i = 0; i != RPIVID_POOL_COUNT; ++i) {
+		struct rpivid_gptr *const p = dev->pool + i;
+
+		if (!p->ptr || p->attrs != attrs ||
+		    p->size < size || p->size / 2 > size)
+			continue;
+		if (!best || p->size < best->size)
+			best = p;
+	}
+	if (best) {
+		*gptr = *best;
+		dev->pool_bytes -= best->size;
+		memset(best, 0, sizeof(*best));
+	}
+	mutex_unlock(&dev->pool_lock);
+
+	if (best) {
+		atomic_inc(&dev->stats.pool_hit);
+		return 0;
+	}
+
+	atomic_inc(&dev->stats.pool_miss);
+	gptr->size = size;
+	gptr->attrs = attrs;
+	gptr->addr = 0;
+	gptr->ptr = dma_alloc_attrs(dev->dev, size, &gptr->addr, GFP_KERNEL,
+				    attrs);
+	if (!gptr->ptr) {
+		gptr->size = 0;
+		gptr->addr = 0;
+		gptr->attrs = 0;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+/* Evicts the smallest buffers first as the large ones are the expensive
+ * ones to get back
+ */
+void rpivid_hw_gptr_put(struct rpivid_dev *dev, struct rpivid_gptr *gptr)
+{
+	const size_t limit = (size_t)READ_ONCE(pool_kb) * 1024;
+	struct rpivid_gptr *slot;
+	unsigned int i;
+
+	if (!gptr->ptr)
+		goto done;
+
+	mutex_lock(&dev->pool_lock);
+	for (;;) {
+		slot = NULL;
+		for (i = 0; i != RPIVID_POOL_COUNT; ++i) {
+			struct rpivid_gptr *const p = dev->pool + i;
+
+			if (!p->ptr) {
+				if (dev->pool_bytes + gptr->size <= limit) {
+					slot = p;
+					break;
+				}
+				continue;
+			}
+			if (!slot || p->size < slot->size)
+				slot = p;
+		}
+
+		if (!slot || (slot->ptr && slot->size >= gptr->size)) {
+			/* Nothing worth evicting for this one */
+			dma_free_attrs(dev->dev, gptr->size, gptr->ptr,
+				       gptr->addr, gptr->attrs);
+			break;
+		}
+		if (!slot->ptr) {
+			*slot = *gptr;
+			dev->pool_bytes += gptr->size;
+			break;
+		}
+		pool_free_ent(dev, slot);
+	}
+	mutex_unlock(&dev->pool_lock);
+
+done:
+	memset(gptr, 0, sizeof(*gptr));
+}
+
 int rpivid_hw_probe(struct rpivid_dev *dev)
 {
 	struct rpi_firmware *firmware;
@@ -312,9 +470,13 @@ int rpivid_hw_probe(struct rpivid_dev *dev)
 	int irq_dec;
 	int ret = 0;
 
-	ictl_init(&dev->ic_active1, RPIVID_P2BUF_COUNT);
+	/* Phase 1 is limited per context by its P1-P2 buffers */
+	ictl_init(&dev->ic_active1, RPIVID_ICTL_ENABLE_UNLIMITED);
 	ictl_init(&dev->ic_active2, RPIVID_ICTL_ENABLE_UNLIMITED);
 
+	mutex_init(&dev->pool_lock);
+	dev->pool_bytes = 0;
+
 	res = platform_get_resource_byname(dev->pdev, IORESOURCE_MEM, "intc");
 	if (!res)
 		return -ENODEV;
@@ -370,14 +532,34 @@ int rpivid_hw_probe(struct rpivid_dev *dev)
 		return ret;
 	}
 #endif
+
+	dev->debugfs = debugfs_create_dir(dev_name(dev->dev), NULL);
+	debugfs_create_atomic_t("realloc", 0444, dev->debugfs,
+				&dev->stats.realloc);
+	debugfs_create_atomic_t("pregrow", 0444, dev->debugfs,
+				&dev->stats.pregrow);
+	debugfs_create_atomic_t("pool_hit", 0444, dev->debugfs,
+				&dev->stats.pool_hit);
+	debugfs_create_atomic_t("pool_miss", 0444, dev->debugfs,
+				&dev->stats.pool_miss);
 	return ret;
 }
 
 void rpivid_hw_remove(struct rpivid_dev *dev)
 {
+	unsigned int i;
+
 	// IRQ auto freed on unload so no need to do it here
 	// ioremap auto freed on unload
+
 	ictl_uninit(&dev->ic_active1);
 	ictl_uninit(&dev->ic_active2);
+
+	debugfs_remove_recursive(dev->debugfs);
+
+	for (i = 0; i != RPIVID_POOL_COUNT; ++i)
+		if (dev->pool[i].ptr)
+			pool_free_ent(dev, dev->pool + i);
+	mutex_destroy(&dev->pool_lock);
 }
 
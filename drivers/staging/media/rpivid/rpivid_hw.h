@@ -272,11 +272,16 @@ static inline void apb_write_vc_len(const struct rpivid_dev * const dev,
 		ARG_IC_ICTRL_ACTIVE1_INT_SET    |\
 		ARG_IC_ICTRL_ACTIVE2_INT_SET)
 
+/* Init a per context claim Q with the given enable count */
+void rpivid_hw_irq_q_init(struct rpivid_hw_irq_q *q, int enables);
+
 /* Regulate claim Q */
 void rpivid_hw_irq_active1_enable_claim(struct rpivid_dev *dev,
+					struct rpivid_hw_irq_q *q,
 					int n);
 /* Auto release once all CBs called */
 void rpivid_hw_irq_active1_claim(struct rpivid_dev *dev,
+				 struct rpivid_hw_irq_q *q,
 				 struct rpivid_hw_irq_ent *ient,
 				 rpivid_irq_callback ready_cb, void *ctx);
 /* May only be called in claim cb */
@@ -290,6 +295,7 @@ void rpivid_hw_irq_active1_thread(struct rpivid_dev *dev,
 
 /* Auto release once all CBs called */
 void rpivid_hw_irq_active2_claim(struct rpivid_dev *dev,
+				 struct rpivid_hw_irq_q *q,
 				 struct rpivid_hw_irq_ent *ient,
 				 rpivid_irq_callback ready_cb, void *ctx);
 /* May only be called in claim cb */
@@ -297,6 +303,17 @@ void rpivid_hw_irq_active2_irq(struct rpivid_dev *dev,
 			       struct rpivid_hw_irq_ent *ient,
 			       rpivid_irq_callback irq_cb, void *ctx);
 
+/* May only be called in irq cb */
+void rpivid_hw_irq_active2_thread(struct rpivid_dev *dev,
+				  struct rpivid_hw_irq_ent *ient,
+				  rpivid_irq_callback thread_cb, void *ctx);
+
+/* Alloc a P1-P2 buffer of at least size, reusing a pooled one if possible */
+int rpivid_hw_gptr_get(struct rpivid_dev *dev, struct rpivid_gptr *gptr,
+		       size_t size, unsigned long attrs);
+/* Return a buffer to the pool, freeing it or another if the pool is full */
+void rpivid_hw_gptr_put(struct rpivid_dev *dev, struct rpivid_gptr *gptr);
+
 int rpivid_hw_probe(struct rpivid_dev *dev);
 void rpivid_hw_remove(struct rpivid_dev *dev);
 
@@ -2,6 +2,8 @@
 /* Copyright 2011 Broadcom Corporation.  All rights reserved. */
 
 #include <linux/interrupt.h>
+#include <linux/math64.h>
+#include <linux/module.h>
 #include <linux/slab.h>
 
 #include <sound/asoundef.h>
@@ -12,7 +14,8 @@
 static const struct snd_pcm_hardware snd_bcm2835_playback_hw = {
 	.info = (SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER |
 		 SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID |
-		 SNDRV_PCM_INFO_SYNC_APPLPTR | SNDRV_PCM_INFO_BATCH),
+		 SNDRV_PCM_INFO_SYNC_APPLPTR | SNDRV_PCM_INFO_BATCH |
+		 SNDRV_PCM_INFO_HAS_LINK_ESTIMATED_ATIME),
 	.formats = SNDRV_PCM_FMTBIT_U8 | SNDRV_PCM_FMTBIT_S16_LE,
 	.rates = SNDRV_PCM_RATE_CONTINUOUS | SNDRV_PCM_RATE_8000_192000,
 	.rate_min = 8000,
@@ -29,7 +32,8 @@ static const struct snd_pcm_hardware snd_bcm2835_playback_hw = {
 static const struct snd_pcm_hardware snd_bcm2835_playback_spdif_hw = {
 	.info = (SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER |
 		 SNDRV_PCM_INFO_MMAP | SNDRV_PCM_INFO_MMAP_VALID |
-		 SNDRV_PCM_INFO_SYNC_APPLPTR | SNDRV_PCM_INFO_BATCH),
+		 SNDRV_PCM_INFO_SYNC_APPLPTR | SNDRV_PCM_INFO_BATCH |
+		 SNDRV_PCM_INFO_HAS_LINK_ESTIMATED_ATIME),
 	.formats = SNDRV_PCM_FMTBIT_S16_LE,
 	.rates = SNDRV_PCM_RATE_CONTINUOUS | SNDRV_PCM_RATE_44100 |
 	SNDRV_PCM_RATE_48000,
@@ -44,6 +48,10 @@ static const struct snd_pcm_hardware snd_bcm2835_playback_spdif_hw = {
 	.periods_max = 128,
 };
 
+static unsigned int min_period_us = 10000;
+module_param(min_period_us, uint, 0644);
+MODULE_PARM_DESC(min_period_us, "Minimum period time in us (default: 10000)");
+
 static void snd_bcm2835_playback_free(struct snd_pcm_runtime *runtime)
 {
 	kfree(runtime->private_data);
@@ -74,6 +82,9 @@ void bcm2835_playback_fifo(struct bcm2835_alsa_stream *alsa_stream,
 	atomic_set(&alsa_stream->pos, pos);
 
 	alsa_stream->period_offset += bytes;
+	alsa_stream->completed_bytes = bytes;
+	alsa_stream->frames_done +=
+		bytes_to_frames(substream->runtime, bytes);
 	alsa_stream->interpolate_start = ktime_get();
 	if (alsa_stream->period_offset >= alsa_stream->period_size) {
 		alsa_stream->period_offset %= alsa_stream->period_size;
@@ -139,10 +150,13 @@ static int snd_bcm2835_playback_open_generic(struct snd_pcm_substream *substream
 				   SNDRV_PCM_HW_PARAM_PERIOD_BYTES,
 				   16);
 
-	/* position update is in 10ms order */
+	/*
+	 * Position updates only come with VC completions, the pointer is
+	 * interpolated in between.
+	 */
 	snd_pcm_hw_constraint_minmax(runtime,
 				     SNDRV_PCM_HW_PARAM_PERIOD_TIME,
-				     10 * 1000, UINT_MAX);
+				     min_period_us, UINT_MAX);
 
 	chip->alsa_stream[idx] = alsa_stream;
 
@@ -226,7 +240,10 @@ static int snd_bcm2835_pcm_prepare(struct snd_pcm_substream *substream)
 	atomic_set(&alsa_stream->pos, 0);
 	alsa_stream->period_offset = 0;
 	alsa_stream->draining = false;
+	alsa_stream->completed_bytes = 0;
+	alsa_stream->frames_done = 0;
 	alsa_stream->interpolate_start = ktime_get();
+	alsa_stream->start_time = alsa_stream->interpolate_start;
 
 	return 0;
 }
@@ -259,6 +276,7 @@ static int snd_bcm2835_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
+		alsa_stream->start_time = ktime_get();
 		return bcm2835_audio_start(alsa_stream);
 	case SNDRV_PCM_TRIGGER_DRAIN:
 		alsa_stream->draining = true;
@@ -270,36 +288,98 @@ static int snd_bcm2835_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	}
 }
 
+/*
+ * Rate at which VC consumes frames, measured against ktime over the life of
+ * the stream.  The VC audio clock drifts from ktime, so use the measured rate
+ * once there is enough history, bounded to 1% of the nominal rate.
+ */
+static u64 bcm2835_pcm_consume_rate(struct bcm2835_alsa_stream *alsa_stream,
+				    struct snd_pcm_runtime *runtime)
+{
+	s64 elapsed = ktime_to_ns(ktime_sub(alsa_stream->interpolate_start,
+					    alsa_stream->start_time));
+	u64 rate;
+
+	if (elapsed < NSEC_PER_SEC)
+		return runtime->rate;
+
+	rate = mul_u64_u64_div_u64(alsa_stream->frames_done, NSEC_PER_SEC,
+				   elapsed);
+	return clamp_t(u64, rate, runtime->rate - runtime->rate / 100,
+		       runtime->rate + runtime->rate / 100);
+}
+
+/*
+ * Frames played since the last VC completion.  Never predict more than the
+ * last completion carried, so the reported position can't run ahead of the
+ * next real update and then jump back.
+ */
+static snd_pcm_uframes_t
+bcm2835_pcm_interpolate(struct bcm2835_alsa_stream *alsa_stream,
+			struct snd_pcm_runtime *runtime, ktime_t now)
+{
+	u64 interval, frames;
+
+	if (!ktime_to_ns(alsa_stream->interpolate_start) ||
+	    ktime_compare(alsa_stream->interpolate_start, now) >= 0)
+		return 0;
+
+	interval = ktime_to_ns(ktime_sub(now, alsa_stream->interpolate_start));
+	frames = div_u64(interval *
+			 bcm2835_pcm_consume_rate(alsa_stream, runtime),
+			 NSEC_PER_SEC);
+	if (alsa_stream->completed_bytes)
+		frames = min_t(u64, frames,
+			       bytes_to_frames(runtime,
+					       alsa_stream->completed_bytes));
+	return frames;
+}
+
 /* pointer callback */
 static snd_pcm_uframes_t
 snd_bcm2835_pcm_pointer(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct bcm2835_alsa_stream *alsa_stream = runtime->private_data;
-	ktime_t now = ktime_get();
 
 	/* Give userspace better delay reporting by interpolating between GPU
-	 * notifications, assuming audio speed is close enough to the clock
-	 * used for ktime
+	 * notifications
 	 */
-
-	if ((ktime_to_ns(alsa_stream->interpolate_start)) &&
-	    (ktime_compare(alsa_stream->interpolate_start, now) < 0)) {
-		u64 interval =
-			(ktime_to_ns(ktime_sub(now,
-				alsa_stream->interpolate_start)));
-		u64 frames_output_in_interval =
-			div_u64((interval * runtime->rate), 1000000000);
-		snd_pcm_sframes_t frames_output_in_interval_sized =
-			-frames_output_in_interval;
-		runtime->delay = frames_output_in_interval_sized;
-	}
+	runtime->delay = -(snd_pcm_sframes_t)
+		bcm2835_pcm_interpolate(alsa_stream, runtime, ktime_get());
 
 	return snd_pcm_indirect_playback_pointer(substream,
 		&alsa_stream->pcm_indirect,
 		atomic_read(&alsa_stream->pos));
 }
 
+static int snd_bcm2835_pcm_get_time_info(struct snd_pcm_substream *substream,
+			struct timespec64 *system_ts, struct timespec64 *audio_ts,
+			struct snd_pcm_audio_tstamp_config *audio_tstamp_config,
+			struct snd_pcm_audio_tstamp_report *audio_tstamp_report)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct bcm2835_alsa_stream *alsa_stream = runtime->private_data;
+	u64 frames;
+
+	if (audio_tstamp_config->type_requested !=
+	    SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ESTIMATED) {
+		audio_tstamp_report->actual_type =
+			SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+		return 0;
+	}
+
+	snd_pcm_gettime(runtime, system_ts);
+	frames = alsa_stream->frames_done +
+		 bcm2835_pcm_interpolate(alsa_stream, runtime, ktime_get());
+	*audio_ts = ns_to_timespec64(mul_u64_u64_div_u64(frames, NSEC_PER_SEC,
+							 runtime->rate));
+
+	audio_tstamp_report->actual_type =
+		SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ESTIMATED;
+	return 0;
+}
+
 /* operators */
 static const struct snd_pcm_ops snd_bcm2835_playback_ops = {
 	.open = snd_bcm2835_playback_open,
@@ -307,6 +387,7 @@ static const struct snd_pcm_ops snd_bcm2835_playback_ops = {
 	.prepare = snd_bcm2835_pcm_prepare,
 	.trigger = snd_bcm2835_pcm_trigger,
 	.pointer = snd_bcm2835_pcm_pointer,
+	.get_time_info = snd_bcm2835_pcm_get_time_info,
 	.ack = snd_bcm2835_pcm_ack,
 };
 
@@ -316,6 +397,7 @@ static const struct snd_pcm_ops snd_bcm2835_playback_spdif_ops = {
 	.prepare = snd_bcm2835_pcm_prepare,
 	.trigger = snd_bcm2835_pcm_trigger,
 	.pointer = snd_bcm2835_pcm_pointer,
+	.get_time_info = snd_bcm2835_pcm_get_time_info,
 	.ack = snd_bcm2835_pcm_ack,
 };
 
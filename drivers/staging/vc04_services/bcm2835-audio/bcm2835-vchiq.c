@@ -22,6 +22,11 @@ static bool force_bulk;
 module_param(force_bulk, bool, 0444);
 MODULE_PARM_DESC(force_bulk, "Force use of vchiq bulk for audio");
 
+static unsigned int bulk_min_bytes = 8192;
+module_param(bulk_min_bytes, uint, 0644);
+MODULE_PARM_DESC(bulk_min_bytes,
+		 "Use vchiq bulk for writes of at least this size (0: never)");
+
 static void bcm2835_audio_lock(struct bcm2835_audio_instance *instance)
 {
 	mutex_lock(&instance->vchi_mutex);
@@ -331,10 +336,10 @@ int bcm2835_audio_write(struct bcm2835_alsa_stream *alsa_stream,
 	struct bcm2835_audio_instance *instance = alsa_stream->instance;
 	struct bcm2835_vchi_ctx *vchi_ctx = alsa_stream->chip->vchi_ctx;
 	struct vchiq_instance *vchiq_instance = vchi_ctx->instance;
+	unsigned int max_packet = instance->max_packet;
 	struct vc_audio_msg m = {
 		.type = VC_AUDIO_MSG_TYPE_WRITE,
 		.write.count = size,
-		.write.max_packet = instance->max_packet,
 		.write.cookie1 = VC_AUDIO_WRITE_COOKIE1,
 		.write.cookie2 = VC_AUDIO_WRITE_COOKIE2,
 	};
@@ -344,19 +349,28 @@ int bcm2835_audio_write(struct bcm2835_alsa_stream *alsa_stream,
 	if (!size)
 		return 0;
 
+	/*
+	 * The mode is chosen per write.  Large writes are DMAed by VC straight
+	 * from the PCM buffer instead of being copied into message slots in
+	 * max_packet sized pieces, each of which wakes up VC.
+	 */
+	if (bulk_min_bytes && size >= bulk_min_bytes)
+		max_packet = 0;
+	m.write.max_packet = max_packet;
+
 	bcm2835_audio_lock(instance);
 	err = bcm2835_audio_send_msg_locked(instance, &m, false);
 	if (err < 0)
 		goto unlock;
 
 	count = size;
-	if (!instance->max_packet) {
+	if (!max_packet) {
 		/* Send the message to the videocore */
 		status = vchiq_bulk_transmit(vchiq_instance, instance->service_handle, src, count,
 					     NULL, VCHIQ_BULK_MODE_BLOCKING);
 	} else {
 		while (count > 0) {
-			int bytes = min(instance->max_packet, count);
+			int bytes = min(max_packet, count);
 
 			status = vchiq_queue_kernel_message(vchiq_instance,
 							    instance->service_handle, src, bytes);
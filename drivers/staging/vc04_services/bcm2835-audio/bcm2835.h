@@ -81,6 +81,11 @@ struct bcm2835_alsa_stream {
 	unsigned int buffer_size;
 	unsigned int period_size;
 	ktime_t interpolate_start;
+	/* bytes reported by the last completion, bounds the interpolation */
+	unsigned int completed_bytes;
+	/* frames consumed by VC since the stream was started */
+	u64 frames_done;
+	ktime_t start_time;
 
 	struct bcm2835_audio_instance *instance;
 	int idx;
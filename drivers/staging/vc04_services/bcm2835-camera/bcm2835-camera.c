@@ -11,6 +11,7 @@
  *          Luke Diamand @ Broadcom
  */
 
+#include <linux/dma-buf.h>
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
@@ -58,6 +59,18 @@ MODULE_PARM_DESC(max_video_width, "Threshold for video mode");
 module_param(max_video_height, int, 0644);
 MODULE_PARM_DESC(max_video_height, "Threshold for video mode");
 
+/*
+ * Allocate buffers from CMA and have the VPU write into them directly via
+ * vc-sm-cma instead of bulk transferring each frame into vmalloc memory.
+ * Exported dmabufs can then be handed to the codec or display without a
+ * copy. USERPTR and read() are not available in this mode.
+ */
+static bool zero_copy;
+module_param(zero_copy, bool, 0444);
+MODULE_PARM_DESC(zero_copy, "Capture into CMA buffers shared with the VPU");
+
+MODULE_IMPORT_NS(DMA_BUF);
+
 /* camera instance counter */
 static atomic_t camera_instance = ATOMIC_INIT(0);
 
@@ -276,6 +289,51 @@ static int buffer_init(struct vb2_buffer *vb)
 	return mmal_vchi_buffer_init(dev->instance, &buf->mmal);
 }
 
+/* Give the MMAL buffer a dmabuf for the VPU to import in zero copy mode */
+static int buffer_prepare_dmabuf(struct bcm2835_mmal_dev *dev,
+				 struct vb2_buffer *vb)
+{
+	struct vb2_v4l2_buffer *vb2 = to_vb2_v4l2_buffer(vb);
+	struct vb2_mmal_buffer *buf =
+				container_of(vb2, struct vb2_mmal_buffer, vb);
+	struct dma_buf *dma_buf;
+	int ret;
+
+	switch (vb->memory) {
+	case VB2_MEMORY_DMABUF:
+		dma_buf = dma_buf_get(vb->planes[0].m.fd);
+		if (IS_ERR(dma_buf))
+			return PTR_ERR(dma_buf);
+
+		if (dma_buf != buf->mmal.dma_buf) {
+			if (buf->mmal.dma_buf)
+				dma_buf_put(buf->mmal.dma_buf);
+			buf->mmal.dma_buf = dma_buf;
+		} else {
+			dma_buf_put(dma_buf);
+		}
+		return 0;
+	case VB2_MEMORY_MMAP:
+		/*
+		 * Can't be done at init as vb2_core_expbuf checks the index
+		 * against q->num_buffers, which isn't updated until all the
+		 * buffers have been allocated.
+		 */
+		if (buf->mmal.dma_buf)
+			return 0;
+		ret = vb2_core_expbuf_dmabuf(vb->vb2_queue, vb->vb2_queue->type,
+					     vb->index, 0, O_CLOEXEC,
+					     &buf->mmal.dma_buf);
+		if (ret)
+			v4l2_err(&dev->v4l2_dev,
+				 "%s: Failed to expbuf idx %d, ret %d\n",
+				 __func__, vb->index, ret);
+		return ret;
+	default:
+		return -EINVAL;
+	}
+}
+
 static int buffer_prepare(struct vb2_buffer *vb)
 {
 	struct bcm2835_mmal_dev *dev = vb2_get_drv_priv(vb->vb2_queue);
@@ -295,6 +353,9 @@ static int buffer_prepare(struct vb2_buffer *vb)
 		return -EINVAL;
 	}
 
+	if (zero_copy)
+		return buffer_prepare_dmabuf(dev, vb);
+
 	return 0;
 }
 
@@ -309,6 +370,11 @@ static void buffer_cleanup(struct vb2_buffer *vb)
 		 __func__, dev, vb);
 
 	mmal_vchi_buffer_cleanup(&buf->mmal);
+
+	if (buf->mmal.dma_buf) {
+		dma_buf_put(buf->mmal.dma_buf);
+		buf->mmal.dma_buf = NULL;
+	}
 }
 
 static inline bool is_capturing(struct bcm2835_mmal_dev *dev)
@@ -563,6 +629,22 @@ static int start_streaming(struct vb2_queue *vq, unsigned int count)
 	dev->capture.kernel_start_ts = ktime_get();
 
 	/* enable the camera port */
+	if (zero_copy) {
+		unsigned int enable = 1;
+
+		/*
+		 * The CMA buffers still have a kernel mapping, so if the VPU
+		 * won't import them carry on with bulk transfers into them.
+		 */
+		ret = vchiq_mmal_port_parameter_set(dev->instance,
+						    dev->capture.port,
+						    MMAL_PARAMETER_ZERO_COPY,
+						    &enable, sizeof(enable));
+		if (ret)
+			v4l2_warn(&dev->v4l2_dev,
+				  "Failed to enable zero copy - error %d, using bulk transfers\n",
+				  ret);
+	}
 	dev->capture.port->cb_ctx = dev;
 	ret = vchiq_mmal_port_enable(dev->instance, dev->capture.port,
 				     buffer_cb);
@@ -1929,11 +2011,18 @@ static int bcm2835_mmal_probe(struct platform_device *pdev)
 		q = &dev->capture.vb_vidq;
 		memset(q, 0, sizeof(*q));
 		q->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-		q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_READ | VB2_DMABUF;
 		q->drv_priv = dev;
 		q->buf_struct_size = sizeof(struct vb2_mmal_buffer);
 		q->ops = &bcm2835_mmal_video_qops;
-		q->mem_ops = &vb2_vmalloc_memops;
+		if (zero_copy) {
+			q->io_modes = VB2_MMAP | VB2_DMABUF;
+			q->mem_ops = &vb2_dma_contig_memops;
+			q->dev = &pdev->dev;
+		} else {
+			q->io_modes = VB2_MMAP | VB2_USERPTR | VB2_READ |
+				      VB2_DMABUF;
+			q->mem_ops = &vb2_vmalloc_memops;
+		}
 		q->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 		q->lock = &dev->mutex;
 		ret = vb2_queue_init(q);
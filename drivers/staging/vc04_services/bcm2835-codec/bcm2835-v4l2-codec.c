@@ -117,6 +117,23 @@ static const char * const components[] = {
 /* Timeout for stop_streaming to allow all buffers to return */
 #define COMPLETE_TIMEOUT (2 * HZ)
 
+/*
+ * Driver private control to set the scheduling priority of a context.
+ * Higher values are serviced first.
+ */
+#define V4L2_CID_USER_BCM2835_CODEC_PRIORITY	(V4L2_CID_USER_BASE + 0x1f00)
+/*
+ * Driver private control to have the encoder return each slice as soon as it
+ * is encoded, rather than only returning complete frames.
+ */
+#define V4L2_CID_USER_BCM2835_CODEC_PARTIAL_FRAMES (V4L2_CID_USER_BASE + 0x1f01)
+#define MAX_PRIORITY			3
+/*
+ * Number of input buffers a context may keep with the VPU while a higher
+ * priority context on the same device has work outstanding.
+ */
+#define THROTTLED_IP_BUFFERS		2
+
 #define MIN_W		32
 #define MIN_H		32
 #define MAX_W_CODEC	1920
@@ -698,6 +715,16 @@ struct bcm2835_codec_dev {
 	struct vchiq_mmal_instance	*instance;
 
 	struct v4l2_m2m_dev	*m2m_dev;
+
+	/*
+	 * Open contexts, for priority scheduling. Modifications take both
+	 * locks; job_ready() walks the list under sched_lock, and
+	 * codec_sched_kick() walks it under sched_mutex, as
+	 * v4l2_m2m_try_schedule() may call back into job_ready().
+	 */
+	struct list_head	ctx_list;
+	spinlock_t		sched_lock;
+	struct mutex		sched_mutex;
 };
 
 struct bcm2835_codec_ctx {
@@ -728,6 +755,15 @@ struct bcm2835_codec_ctx {
 	int num_ip_buffers;
 	int num_op_buffers;
 	struct completion frame_cmplt;
+
+	/* Scheduling priority, and entry in dev->ctx_list */
+	int priority;
+
+	/* Encoder slice configuration */
+	struct v4l2_ctrl *slice_mode;
+	struct v4l2_ctrl *slice_max_mb;
+	bool partial_frames;
+	struct list_head list;
 };
 
 struct bcm2835_codec_driver {
@@ -845,17 +881,83 @@ static struct vchiq_mmal_port *get_port_data(struct bcm2835_codec_ctx *ctx,
  * mem2mem callbacks
  */
 
+static unsigned int ip_buffers_with_vpu(struct bcm2835_codec_ctx *ctx)
+{
+	if (!ctx->component)
+		return 0;
+
+	return atomic_read(&ctx->component->input[0].buffers_with_vpu);
+}
+
+/*
+ * Whether a context of higher priority than ctx on the same device has input
+ * buffers either queued or with the VPU. Called with dev->sched_lock held.
+ */
+static bool higher_priority_busy(struct bcm2835_codec_ctx *ctx)
+{
+	struct bcm2835_codec_ctx *other;
+
+	list_for_each_entry(other, &ctx->dev->ctx_list, list) {
+		if (other->priority <= ctx->priority)
+			continue;
+		if (ip_buffers_with_vpu(other) ||
+		    v4l2_m2m_num_src_bufs_ready(other->fh.m2m_ctx))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Re-evaluate every context of lower priority than prio. Contexts that
+ * job_ready() held back are not on the m2m job queue, so nothing else will
+ * reschedule them.
+ */
+static void codec_sched_kick(struct bcm2835_codec_dev *dev, int prio)
+{
+	struct bcm2835_codec_ctx *ctx;
+
+	mutex_lock(&dev->sched_mutex);
+	list_for_each_entry(ctx, &dev->ctx_list, list) {
+		if (ctx->priority < prio)
+			v4l2_m2m_try_schedule(ctx->fh.m2m_ctx);
+	}
+	mutex_unlock(&dev->sched_mutex);
+}
+
 /*
  * job_ready() - check whether an instance is ready to be scheduled to run
+ *
+ * device_run() completes the m2m job as soon as the buffers are handed to the
+ * VPU, so the VPU works on every context at once in submission order. To stop
+ * throughput oriented contexts delaying latency sensitive ones, a context is
+ * limited to THROTTLED_IP_BUFFERS input buffers with the VPU whilst a higher
+ * priority context has input work outstanding.
  */
 static int job_ready(void *priv)
 {
 	struct bcm2835_codec_ctx *ctx = priv;
+	struct bcm2835_codec_dev *dev = ctx->dev;
+	unsigned long flags;
+	bool throttle = false;
 
 	if (!v4l2_m2m_num_src_bufs_ready(ctx->fh.m2m_ctx) &&
 	    !v4l2_m2m_num_dst_bufs_ready(ctx->fh.m2m_ctx))
 		return 0;
 
+	if (ctx->priority < MAX_PRIORITY &&
+	    ip_buffers_with_vpu(ctx) >= THROTTLED_IP_BUFFERS) {
+		spin_lock_irqsave(&dev->sched_lock, flags);
+		throttle = higher_priority_busy(ctx);
+		spin_unlock_irqrestore(&dev->sched_lock, flags);
+	}
+
+	if (throttle) {
+		v4l2_dbg(3, debug, &dev->v4l2_dev, "%s: ctx %p throttled\n",
+			 __func__, ctx);
+		return 0;
+	}
+
 	return 1;
 }
 
@@ -1009,6 +1111,9 @@ static void ip_buffer_cb(struct vchiq_mmal_instance *instance,
 
 	if (!port->enabled && atomic_read(&port->buffers_with_vpu))
 		complete(&ctx->frame_cmplt);
+
+	if (ctx->priority)
+		codec_sched_kick(ctx->dev, ctx->priority);
 }
 
 static void queue_res_chg_event(struct bcm2835_codec_ctx *ctx)
@@ -1252,6 +1357,16 @@ static void op_buffer_cb(struct vchiq_mmal_instance *instance,
 	if (mmal_buf->mmal_flags & MMAL_BUFFER_HEADER_FLAG_KEYFRAME)
 		vb2->flags |= V4L2_BUF_FLAG_KEYFRAME;
 
+	/*
+	 * With partial frames enabled, every buffer holding part of a frame
+	 * carries the same sequence number and timestamp. The sequence number
+	 * only advances once the VPU flags the end of the frame.
+	 */
+	vb2->sequence = ctx->q_data[V4L2_M2M_DST].sequence;
+	if (!ctx->partial_frames ||
+	    (mmal_buf->mmal_flags & MMAL_BUFFER_HEADER_FLAG_FRAME_END))
+		ctx->q_data[V4L2_M2M_DST].sequence++;
+
 	vb2_buffer_done(&vb2->vb2_buf, buf_state);
 	ctx->num_op_buffers++;
 
@@ -2383,6 +2498,55 @@ static int bcm2835_codec_s_ctrl(struct v4l2_ctrl *ctrl)
 		ret = 0;
 		break;
 
+	case V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MODE:
+	case V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MAX_MB: {
+		unsigned int mb_width, mb_rows = 0;
+
+		if (!ctx->component)
+			break;
+
+		/* The VPU splits slices on whole macroblock rows. */
+		if (ctx->slice_mode->val ==
+		    V4L2_MPEG_VIDEO_MULTI_SLICE_MODE_MAX_MB) {
+			mb_width = DIV_ROUND_UP(ctx->q_data[V4L2_M2M_SRC].crop_width,
+						16);
+			mb_rows = max(1U, ctx->slice_max_mb->val / mb_width);
+		}
+
+		ret = vchiq_mmal_port_parameter_set(ctx->dev->instance,
+						    &ctx->component->output[0],
+						    MMAL_PARAMETER_MB_ROWS_PER_SLICE,
+						    &mb_rows,
+						    sizeof(mb_rows));
+		break;
+	}
+
+	case V4L2_CID_USER_BCM2835_CODEC_PARTIAL_FRAMES:
+		ctx->partial_frames = ctrl->val;
+		if (!ctx->component)
+			break;
+
+		ret = vchiq_mmal_port_parameter_set(ctx->dev->instance,
+						    &ctx->component->output[0],
+						    MMAL_PARAMETER_VIDEO_ENCODE_H264_LOW_LATENCY,
+						    &ctrl->val,
+						    sizeof(ctrl->val));
+		break;
+
+	case V4L2_CID_USER_BCM2835_CODEC_PRIORITY: {
+		int old_priority = ctx->priority;
+
+		if (ctrl->val == old_priority)
+			break;
+
+		ctx->priority = ctrl->val;
+		if (ctrl->val < old_priority)
+			codec_sched_kick(ctx->dev, old_priority + 1);
+		else
+			v4l2_m2m_try_schedule(ctx->fh.m2m_ctx);
+		break;
+	}
+
 	case V4L2_CID_JPEG_COMPRESSION_QUALITY:
 		if (!ctx->component)
 			break;
@@ -2409,6 +2573,28 @@ static const struct v4l2_ctrl_ops bcm2835_codec_ctrl_ops = {
 	.s_ctrl = bcm2835_codec_s_ctrl,
 };
 
+static const struct v4l2_ctrl_config bcm2835_codec_partial_frames_ctrl = {
+	.ops	= &bcm2835_codec_ctrl_ops,
+	.id	= V4L2_CID_USER_BCM2835_CODEC_PARTIAL_FRAMES,
+	.name	= "Partial Frame Output",
+	.type	= V4L2_CTRL_TYPE_BOOLEAN,
+	.min	= 0,
+	.max	= 1,
+	.step	= 1,
+	.def	= 0,
+};
+
+static const struct v4l2_ctrl_config bcm2835_codec_priority_ctrl = {
+	.ops	= &bcm2835_codec_ctrl_ops,
+	.id	= V4L2_CID_USER_BCM2835_CODEC_PRIORITY,
+	.name	= "Scheduling Priority",
+	.type	= V4L2_CTRL_TYPE_INTEGER,
+	.min	= 0,
+	.max	= MAX_PRIORITY,
+	.step	= 1,
+	.def	= 0,
+};
+
 static int vidioc_try_decoder_cmd(struct file *file, void *priv,
 				  struct v4l2_decoder_cmd *cmd)
 {
@@ -2987,6 +3173,35 @@ static void bcm2835_codec_flush_buffers(struct bcm2835_codec_ctx *ctx,
 		}
 	}
 }
+
+/*
+ * vchiq-mmal keeps the dmabuf imports of a port cached for the life of the
+ * component, so buffers reused across STREAMOFF/STREAMON, or moved between
+ * buffer indices, are not imported again. Drop those imports that no longer
+ * back a buffer of the queue, e.g. after REQBUFS for a resolution change.
+ */
+static void bcm2835_codec_prune_dmabufs(struct bcm2835_codec_ctx *ctx,
+					struct vb2_queue *q,
+					struct vchiq_mmal_port *port)
+{
+	struct dma_buf *keep[VB2_MAX_FRAME];
+	unsigned int i, num_keep = 0;
+
+	for (i = 0; i < q->num_buffers; i++) {
+		struct vb2_v4l2_buffer *vb2 =
+			to_vb2_v4l2_buffer(vb2_get_buffer(q, i));
+		struct v4l2_m2m_buffer *m2m =
+			container_of(vb2, struct v4l2_m2m_buffer, vb);
+		struct m2m_mmal_buffer *buf =
+			container_of(m2m, struct m2m_mmal_buffer, m2m);
+
+		if (buf->mmal.dma_buf)
+			keep[num_keep++] = buf->mmal.dma_buf;
+	}
+
+	vchiq_mmal_port_dmabuf_cache_prune(port, keep, num_keep);
+}
+
 static int bcm2835_codec_start_streaming(struct vb2_queue *q,
 					 unsigned int count)
 {
@@ -3037,6 +3252,8 @@ static int bcm2835_codec_start_streaming(struct vb2_queue *q,
 		port->current_buffer.num = num_buffers;
 	}
 
+	bcm2835_codec_prune_dmabufs(ctx, q, port);
+
 	if (count < port->minimum_buffer.num)
 		count = port->minimum_buffer.num;
 
@@ -3372,7 +3589,7 @@ static int bcm2835_codec_open(struct file *file)
 	case ENCODE:
 	{
 		/* Encode controls */
-		v4l2_ctrl_handler_init(hdl, 13);
+		v4l2_ctrl_handler_init(hdl, 16);
 
 		v4l2_ctrl_new_std_menu(hdl, &bcm2835_codec_ctrl_ops,
 				       V4L2_CID_MPEG_VIDEO_BITRATE_MODE,
@@ -3440,10 +3657,23 @@ static int bcm2835_codec_open(struct file *file)
 		ctx->gop_size = v4l2_ctrl_new_std(hdl, &bcm2835_codec_ctrl_ops,
 						  V4L2_CID_MPEG_VIDEO_GOP_SIZE,
 						  0, 0x7FFFFFFF, 1, 60);
+		ctx->slice_mode =
+			v4l2_ctrl_new_std_menu(hdl, &bcm2835_codec_ctrl_ops,
+					       V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MODE,
+					       V4L2_MPEG_VIDEO_MULTI_SLICE_MODE_MAX_MB,
+					       BIT(V4L2_MPEG_VIDEO_MULTI_SLICE_MODE_MAX_BYTES),
+					       V4L2_MPEG_VIDEO_MULTI_SLICE_MODE_SINGLE);
+		/* 1920x1088 is 8160 macroblocks */
+		ctx->slice_max_mb = v4l2_ctrl_new_std(hdl, &bcm2835_codec_ctrl_ops,
+						      V4L2_CID_MPEG_VIDEO_MULTI_SLICE_MAX_MB,
+						      1, 8160, 1, 1);
+		v4l2_ctrl_new_custom(hdl, &bcm2835_codec_partial_frames_ctrl,
+				     NULL);
 		if (hdl->error) {
 			rc = hdl->error;
 			goto free_ctrl_handler;
 		}
+		v4l2_ctrl_cluster(2, &ctx->slice_mode);
 		ctx->fh.ctrl_handler = hdl;
 		v4l2_ctrl_handler_setup(hdl);
 	}
@@ -3508,6 +3738,13 @@ static int bcm2835_codec_open(struct file *file)
 	break;
 	}
 
+	v4l2_ctrl_new_custom(hdl, &bcm2835_codec_priority_ctrl, NULL);
+	if (hdl->error) {
+		rc = hdl->error;
+		goto free_ctrl_handler;
+	}
+	ctx->fh.ctrl_handler = hdl;
+
 	ctx->fh.m2m_ctx = v4l2_m2m_ctx_init(dev->m2m_dev, ctx, &queue_init);
 
 	if (IS_ERR(ctx->fh.m2m_ctx)) {
@@ -3523,6 +3760,12 @@ static int bcm2835_codec_open(struct file *file)
 	v4l2_m2m_set_src_buffered(ctx->fh.m2m_ctx, true);
 	v4l2_m2m_set_dst_buffered(ctx->fh.m2m_ctx, true);
 
+	mutex_lock(&dev->sched_mutex);
+	spin_lock_irq(&dev->sched_lock);
+	list_add_tail(&ctx->list, &dev->ctx_list);
+	spin_unlock_irq(&dev->sched_lock);
+	mutex_unlock(&dev->sched_mutex);
+
 	v4l2_fh_add(&ctx->fh);
 	atomic_inc(&dev->num_inst);
 
@@ -3545,6 +3788,12 @@ static int bcm2835_codec_release(struct file *file)
 	v4l2_dbg(1, debug, &dev->v4l2_dev, "%s: Releasing instance %p\n",
 		 __func__, ctx);
 
+	mutex_lock(&dev->sched_mutex);
+	spin_lock_irq(&dev->sched_lock);
+	list_del(&ctx->list);
+	spin_unlock_irq(&dev->sched_lock);
+	mutex_unlock(&dev->sched_mutex);
+
 	v4l2_fh_del(&ctx->fh);
 	v4l2_fh_exit(&ctx->fh);
 	v4l2_ctrl_handler_free(&ctx->hdl);
@@ -3734,6 +3983,9 @@ static int bcm2835_codec_create(struct bcm2835_codec_driver *drv,
 
 	atomic_set(&dev->num_inst, 0);
 	mutex_init(&dev->dev_mutex);
+	INIT_LIST_HEAD(&dev->ctx_list);
+	spin_lock_init(&dev->sched_lock);
+	mutex_init(&dev->sched_mutex);
 
 	/* Initialise the video device */
 	dev->vfd = bcm2835_codec_videodev;
@@ -136,6 +136,16 @@ struct bcm2835_isp_dev {
 	struct media_pad pad[BCM2835_ISP_NUM_NODES];
 	atomic_t num_streaming;
 
+	/*
+	 * Buffers of the media request being queued, held back so that they
+	 * are sent to the VPU together. Only touched under the media device
+	 * req_queue_mutex.
+	 */
+	struct media_request *batch_req;
+	struct bcm2835_isp_buffer *batch[BCM2835_ISP_NUM_NODES];
+	struct bcm2835_isp_node *batch_node[BCM2835_ISP_NUM_NODES];
+	unsigned int batch_count;
+
 	/* Image pipeline controls. */
 	int r_gain;
 	int b_gain;
@@ -301,6 +311,15 @@ static void mmal_buffer_cb(struct vchiq_mmal_instance *instance,
 			 "%s: Unexpected event on output callback - %08x\n",
 			 __func__, mmal_buf->cmd);
 
+	/*
+	 * The request's controls must be completed before any of its buffers,
+	 * or the request can complete with the control object still bound.
+	 * Later calls for the same request find nothing left to do.
+	 */
+	if (vb2->vb2_buf.req_obj.req)
+		v4l2_ctrl_request_complete(vb2->vb2_buf.req_obj.req,
+					   &dev->ctrl_handler);
+
 	if (status) {
 		/* error in transfer */
 		if (vb2) {
@@ -575,12 +594,29 @@ static void bcm2835_isp_node_buffer_queue(struct vb2_buffer *buf)
 		 __func__, node->name, node->id, buffer);
 
 	vb2_to_mmal_buffer(&buffer->mmal, &buffer->vb);
+
+	if (buf->req_obj.req && buf->req_obj.req == dev->batch_req &&
+	    dev->batch_count < BCM2835_ISP_NUM_NODES) {
+		dev->batch[dev->batch_count] = buffer;
+		dev->batch_node[dev->batch_count] = node;
+		dev->batch_count++;
+		return;
+	}
+
 	v4l2_dbg(3, debug, &dev->v4l2_dev,
 		 "%s: node %s[%d] - submitting  mmal dmabuf %p\n", __func__,
 		 node->name, node->id, buffer->mmal.dma_buf);
 	vchiq_mmal_submit_buffer(dev->mmal_instance, node->port, &buffer->mmal);
 }
 
+static void bcm2835_isp_buf_request_complete(struct vb2_buffer *vb)
+{
+	struct bcm2835_isp_node *node = vb2_get_drv_priv(vb->vb2_queue);
+	struct bcm2835_isp_dev *dev = node_get_dev(node);
+
+	v4l2_ctrl_request_complete(vb->req_obj.req, &dev->ctrl_handler);
+}
+
 static void bcm2835_isp_buffer_cleanup(struct vb2_buffer *vb)
 {
 	struct vb2_v4l2_buffer *vb2 = to_vb2_v4l2_buffer(vb);
@@ -692,6 +728,7 @@ static const struct vb2_ops bcm2835_isp_node_queue_ops = {
 	.buf_init		= bcm2835_isp_buf_init,
 	.buf_prepare		= bcm2835_isp_buf_prepare,
 	.buf_queue		= bcm2835_isp_node_buffer_queue,
+	.buf_request_complete	= bcm2835_isp_buf_request_complete,
 	.buf_cleanup		= bcm2835_isp_buffer_cleanup,
 	.start_streaming	= bcm2835_isp_node_start_streaming,
 	.stop_streaming		= bcm2835_isp_node_stop_streaming,
@@ -1386,6 +1423,7 @@ static int register_node(struct bcm2835_isp_dev *dev,
 	queue->timestamp_flags = V4L2_BUF_FLAG_TIMESTAMP_COPY;
 	queue->dev = dev->dev;
 	queue->lock = &node->queue_lock;
+	queue->supports_requests = true;
 
 	ret = vb2_queue_init(queue);
 	if (ret < 0) {
@@ -1619,6 +1657,90 @@ static int media_controller_register_node(struct bcm2835_isp_dev *dev, int num)
 	return ret;
 }
 
+/*
+ * A request must carry an input buffer; the output and stats buffers are
+ * optional. This lets one request describe a whole ISP pass: the parameter
+ * controls, the input frame and every result wanted from it.
+ */
+static int bcm2835_isp_req_validate(struct media_request *req)
+{
+	struct bcm2835_isp_dev *dev =
+		container_of(req->mdev, struct bcm2835_isp_dev, mdev);
+	struct media_request_object *obj;
+	bool has_input = false;
+
+	list_for_each_entry(obj, &req->objects, list) {
+		struct vb2_buffer *vb;
+
+		if (!vb2_request_object_is_buffer(obj))
+			continue;
+		vb = container_of(obj, struct vb2_buffer, req_obj);
+		if (node_is_output(vb2_get_drv_priv(vb->vb2_queue)))
+			has_input = true;
+	}
+
+	if (!has_input) {
+		v4l2_dbg(1, debug, &dev->v4l2_dev,
+			 "%s: request has no input buffer\n", __func__);
+		return -ENOENT;
+	}
+
+	return vb2_request_validate(req);
+}
+
+/*
+ * Apply the request's parameters, then send all its buffers to the VPU in
+ * one go. The results are queued before the input so that the firmware has
+ * everywhere to write to as soon as it starts the frame and processes it in
+ * a single pass.
+ */
+static void bcm2835_isp_req_queue(struct media_request *req)
+{
+	struct bcm2835_isp_dev *dev =
+		container_of(req->mdev, struct bcm2835_isp_dev, mdev);
+	struct vchiq_mmal_port *ports[BCM2835_ISP_NUM_NODES];
+	struct mmal_buffer *bufs[BCM2835_ISP_NUM_NODES];
+	unsigned int i, n = 0, sent;
+
+	v4l2_ctrl_request_setup(req, &dev->ctrl_handler);
+
+	dev->batch_req = req;
+	dev->batch_count = 0;
+	vb2_request_queue(req);
+	dev->batch_req = NULL;
+
+	for (i = 0; i < dev->batch_count; i++) {
+		if (node_is_output(dev->batch_node[i]))
+			continue;
+		ports[n] = dev->batch_node[i]->port;
+		bufs[n++] = &dev->batch[i]->mmal;
+	}
+	for (i = 0; i < dev->batch_count; i++) {
+		if (!node_is_output(dev->batch_node[i]))
+			continue;
+		ports[n] = dev->batch_node[i]->port;
+		bufs[n++] = &dev->batch[i]->mmal;
+	}
+
+	v4l2_dbg(3, debug, &dev->v4l2_dev, "%s: submitting %u buffers\n",
+		 __func__, n);
+	sent = vchiq_mmal_submit_buffers(dev->mmal_instance, ports, bufs, n);
+
+	/* The VPU will never return what it did not get, so fail those */
+	for (i = sent; i < n; i++) {
+		struct bcm2835_isp_buffer *buffer =
+			container_of(bufs[i], struct bcm2835_isp_buffer, mmal);
+
+		v4l2_ctrl_request_complete(req, &dev->ctrl_handler);
+		vb2_buffer_done(&buffer->vb.vb2_buf, VB2_BUF_STATE_ERROR);
+	}
+}
+
+static const struct media_device_ops bcm2835_isp_media_ops = {
+	.req_validate	= bcm2835_isp_req_validate,
+	.req_queue	= bcm2835_isp_req_queue,
+};
+
 static int media_controller_register(struct bcm2835_isp_dev *dev)
 {
 	char *name;
@@ -1631,6 +1753,7 @@ static int media_controller_register(struct bcm2835_isp_dev *dev)
 		sizeof(dev->mdev.model));
 	strscpy(dev->mdev.bus_info, "platform:bcm2835-isp",
 		sizeof(dev->mdev.bus_info));
+	dev->mdev.ops = &bcm2835_isp_media_ops;
 	media_device_init(&dev->mdev);
 	dev->v4l2_dev.mdev = &dev->mdev;
 
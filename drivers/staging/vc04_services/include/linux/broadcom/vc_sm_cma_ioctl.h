@@ -35,6 +35,8 @@ enum vc_sm_cma_cmd_e {
 
 	VC_SM_CMA_CMD_CLEAN_INVALID2,
 
+	VC_SM_CMA_CMD_CLEAN_INVALID_VEC,
+
 	VC_SM_CMA_CMD_LAST	/* Do not delete */
 };
 
@@ -98,6 +100,25 @@ struct vc_sm_cma_ioctl_clean_invalid2 {
 	} s[0];
 };
 
+/*
+ * Vectored form of clean_invalid2. The layout is the same for 32 and 64 bit
+ * user space. Operations are applied in order, but contiguous and
+ * overlapping ranges with compatible operations may be merged.
+ */
+struct vc_sm_cma_ioctl_clean_invalid_op {
+	__u64 start_address;
+	__u32 invalidate_mode;
+	__u32 block_count;
+	__u32 block_size;
+	__u32 inter_block_stride;
+};
+
+struct vc_sm_cma_ioctl_clean_invalid_vec {
+	__u64 ops;		/* struct vc_sm_cma_ioctl_clean_invalid_op [] */
+	__u32 op_count;
+	__u32 pad;
+};
+
 /* IOCTL numbers */
 #define VC_SM_CMA_IOCTL_MEM_ALLOC\
 	_IOR(VC_SM_CMA_MAGIC_TYPE, VC_SM_CMA_CMD_ALLOC,\
@@ -111,4 +132,8 @@ struct vc_sm_cma_ioctl_clean_invalid2 {
 	_IOR(VC_SM_CMA_MAGIC_TYPE, VC_SM_CMA_CMD_CLEAN_INVALID2,\
 	 struct vc_sm_cma_ioctl_clean_invalid2)
 
+#define VC_SM_CMA_IOCTL_MEM_CLEAN_INVALID_VEC\
+	_IOR(VC_SM_CMA_MAGIC_TYPE, VC_SM_CMA_CMD_CLEAN_INVALID_VEC,\
+	 struct vc_sm_cma_ioctl_clean_invalid_vec)
+
 #endif /* __VC_SM_CMA_IOCTL_H */
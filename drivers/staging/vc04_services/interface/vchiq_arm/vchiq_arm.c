@@ -40,7 +40,14 @@
 
 #define DEVICE_NAME "vchiq"
 
-#define TOTAL_SLOTS (VCHIQ_SLOT_ZERO_SLOTS + 2 * 32)
+/*
+ * Slots given to each side, its sync slot included. The firmware learns
+ * the layout from slot zero, so any size up to what slot zero can
+ * describe works.
+ */
+#define DEFAULT_SLOTS_PER_SIDE 32
+#define MIN_SLOTS_PER_SIDE 4
+#define MAX_SLOTS_PER_SIDE ((VCHIQ_MAX_SLOTS - VCHIQ_SLOT_ZERO_SLOTS) / 2)
 
 #define MAX_FRAGMENTS (VCHIQ_NUM_CURRENT_BULKS * 2)
 
@@ -54,6 +61,8 @@
 
 #define VCHIQ_DMA_POOL_SIZE PAGE_SIZE
 
+#define VCHIQ_MAX_CACHED_PAGELISTS 32
+
 /* Override the default prefix, which would be vchiq_arm (from the filename) */
 #undef MODULE_PARAM_PREFIX
 #define MODULE_PARAM_PREFIX DEVICE_NAME "."
@@ -69,6 +78,11 @@ module_param_named(susp_log_level, vchiq_susp_log_level, int, 0644);
 module_param_named(core_log_level, vchiq_core_log_level, int, 0644);
 module_param_named(core_msg_log_level, vchiq_core_msg_log_level, int, 0644);
 module_param_named(sync_log_level, vchiq_sync_log_level, int, 0644);
+module_param_named(rx_workers, vchiq_rx_workers, bool, 0644);
+module_param_named(rx_worker_cpu, vchiq_rx_worker_cpu, int, 0644);
+
+static int vchiq_slots_per_side = DEFAULT_SLOTS_PER_SIDE;
+module_param_named(slots_per_side, vchiq_slots_per_side, int, 0444);
 
 DEFINE_SPINLOCK(msg_queue_spinlock);
 struct vchiq_state g_state;
@@ -148,6 +162,14 @@ struct vchiq_pagelist_info {
 	struct page **pages;
 	struct scatterlist *scatterlist;
 	unsigned int scatterlist_mapped;
+
+	/* Registered (cached) pagelists only */
+	struct list_head cache_list;
+	void __user *ubuf;
+	size_t count;
+	unsigned short type;
+	bool is_cached;
+	bool in_use;
 };
 
 static void __iomem *g_regs;
@@ -442,32 +464,140 @@ create_pagelist(struct vchiq_instance *instance, char *buf, char __user *ubuf,
 		}
 	}
 
-	/* Partial cache lines (fragments) require special measures */
-	if ((type == PAGELIST_READ) &&
-	    ((pagelist->offset & (g_cache_line_size - 1)) ||
-	    ((pagelist->offset + pagelist->length) &
-	    (g_cache_line_size - 1)))) {
-		char *fragments;
+	return pagelistinfo;
+}
 
-		if (down_interruptible(&g_free_fragments_sema)) {
-			cleanup_pagelistinfo(instance, pagelistinfo);
-			return NULL;
-		}
+/*
+ * Partial cache lines (fragments) require special measures. This is done
+ * per transfer, so that a registered pagelist can be reused by reads.
+ */
+static int
+get_pagelist_fragments(struct vchiq_pagelist_info *pagelistinfo)
+{
+	struct pagelist *pagelist = pagelistinfo->pagelist;
+	char *fragments;
+
+	if ((pagelist->type != PAGELIST_READ) ||
+	    (!(pagelist->offset & (g_cache_line_size - 1)) &&
+	     !((pagelist->offset + pagelist->length) &
+	       (g_cache_line_size - 1))))
+		return 0;
+
+	if (down_interruptible(&g_free_fragments_sema))
+		return -EINTR;
+
+	WARN_ON(!g_free_fragments);
+
+	down(&g_free_fragments_mutex);
+	fragments = g_free_fragments;
+	WARN_ON(!fragments);
+	g_free_fragments = *(char **)g_free_fragments;
+	up(&g_free_fragments_mutex);
+	pagelist->type = PAGELIST_READ_WITH_FRAGMENTS +
+		(fragments - g_fragments_base) / g_fragments_size;
+
+	return 0;
+}
+
+static void
+put_pagelist_fragments(struct vchiq_pagelist_info *pagelistinfo, int actual)
+{
+	struct pagelist *pagelist = pagelistinfo->pagelist;
+	struct page **pages = pagelistinfo->pages;
+	unsigned int num_pages = pagelistinfo->num_pages;
+	char *fragments;
+	int head_bytes, tail_bytes;
+
+	if (pagelist->type < PAGELIST_READ_WITH_FRAGMENTS || !g_fragments_base)
+		return;
+
+	fragments = g_fragments_base +
+		(pagelist->type - PAGELIST_READ_WITH_FRAGMENTS) *
+		g_fragments_size;
 
-		WARN_ON(!g_free_fragments);
+	head_bytes = (g_cache_line_size - pagelist->offset) &
+		(g_cache_line_size - 1);
+	tail_bytes = (pagelist->offset + actual) &
+		(g_cache_line_size - 1);
 
-		down(&g_free_fragments_mutex);
-		fragments = g_free_fragments;
-		WARN_ON(!fragments);
-		g_free_fragments = *(char **)g_free_fragments;
-		up(&g_free_fragments_mutex);
-		pagelist->type = PAGELIST_READ_WITH_FRAGMENTS +
-			(fragments - g_fragments_base) / g_fragments_size;
+	if ((actual >= 0) && (head_bytes != 0)) {
+		if (head_bytes > actual)
+			head_bytes = actual;
+
+		memcpy_to_page(pages[0],
+			pagelist->offset,
+			fragments,
+			head_bytes);
+	}
+	if ((actual >= 0) && (head_bytes < actual) &&
+	    (tail_bytes != 0))
+		memcpy_to_page(pages[num_pages - 1],
+			(pagelist->offset + actual) &
+			(PAGE_SIZE - 1) & ~(g_cache_line_size - 1),
+			fragments + g_cache_line_size,
+			tail_bytes);
+
+	down(&g_free_fragments_mutex);
+	*(char **)fragments = g_free_fragments;
+	g_free_fragments = fragments;
+	up(&g_free_fragments_mutex);
+	up(&g_free_fragments_sema);
+
+	pagelist->type = PAGELIST_READ;
+}
+
+/*
+ * Registered pagelists stay pinned and DMA mapped until they are
+ * unregistered or the instance is released. A transfer that exactly
+ * matches a registered buffer only needs cache maintenance.
+ */
+static struct vchiq_pagelist_info *
+find_cached_pagelist(struct vchiq_instance *instance, void __user *ubuf,
+		     size_t count, unsigned short type)
+{
+	struct vchiq_pagelist_info *pagelistinfo;
+
+	list_for_each_entry(pagelistinfo, &instance->pagelist_cache, cache_list) {
+		if (pagelistinfo->ubuf == ubuf &&
+		    pagelistinfo->count == count &&
+		    pagelistinfo->type == type)
+			return pagelistinfo;
 	}
 
+	return NULL;
+}
+
+static struct vchiq_pagelist_info *
+get_cached_pagelist(struct vchiq_instance *instance, void __user *ubuf,
+		    size_t count, unsigned short type)
+{
+	struct vchiq_pagelist_info *pagelistinfo;
+
+	mutex_lock(&instance->pagelist_cache_mutex);
+	pagelistinfo = find_cached_pagelist(instance, ubuf, count, type);
+	if (pagelistinfo && pagelistinfo->in_use)
+		pagelistinfo = NULL;
+	if (pagelistinfo)
+		pagelistinfo->in_use = true;
+	mutex_unlock(&instance->pagelist_cache_mutex);
+
+	if (pagelistinfo)
+		dma_sync_sg_for_device(g_dma_dev, pagelistinfo->scatterlist,
+				       pagelistinfo->num_pages,
+				       pagelistinfo->dma_dir);
+
 	return pagelistinfo;
 }
 
+static void
+put_cached_pagelist(struct vchiq_instance *instance,
+		    struct vchiq_pagelist_info *pagelistinfo)
+{
+	mutex_lock(&instance->pagelist_cache_mutex);
+	pagelistinfo->in_use = false;
+	mutex_unlock(&instance->pagelist_cache_mutex);
+}
+
 static void
 free_pagelist(struct vchiq_instance *instance, struct vchiq_pagelist_info *pagelistinfo,
 	      int actual)
@@ -483,45 +613,18 @@ free_pagelist(struct vchiq_instance *instance, struct vchiq_pagelist_info *pagel
 	 * NOTE: dma_unmap_sg must be called before the
 	 * cpu can touch any of the data/pages.
 	 */
-	dma_unmap_sg(g_dma_dev, pagelistinfo->scatterlist,
-		     pagelistinfo->num_pages, pagelistinfo->dma_dir);
-	pagelistinfo->scatterlist_mapped = 0;
+	if (pagelistinfo->is_cached) {
+		dma_sync_sg_for_cpu(g_dma_dev, pagelistinfo->scatterlist,
+				    pagelistinfo->num_pages,
+				    pagelistinfo->dma_dir);
+	} else {
+		dma_unmap_sg(g_dma_dev, pagelistinfo->scatterlist,
+			     pagelistinfo->num_pages, pagelistinfo->dma_dir);
+		pagelistinfo->scatterlist_mapped = 0;
+	}
 
 	/* Deal with any partial cache lines (fragments) */
-	if (pagelist->type >= PAGELIST_READ_WITH_FRAGMENTS && g_fragments_base) {
-		char *fragments = g_fragments_base +
-			(pagelist->type - PAGELIST_READ_WITH_FRAGMENTS) *
-			g_fragments_size;
-		int head_bytes, tail_bytes;
-
-		head_bytes = (g_cache_line_size - pagelist->offset) &
-			(g_cache_line_size - 1);
-		tail_bytes = (pagelist->offset + actual) &
-			(g_cache_line_size - 1);
-
-		if ((actual >= 0) && (head_bytes != 0)) {
-			if (head_bytes > actual)
-				head_bytes = actual;
-
-			memcpy_to_page(pages[0],
-				pagelist->offset,
-				fragments,
-				head_bytes);
-		}
-		if ((actual >= 0) && (head_bytes < actual) &&
-		    (tail_bytes != 0))
-			memcpy_to_page(pages[num_pages - 1],
-				(pagelist->offset + actual) &
-				(PAGE_SIZE - 1) & ~(g_cache_line_size - 1),
-				fragments + g_cache_line_size,
-				tail_bytes);
-
-		down(&g_free_fragments_mutex);
-		*(char **)fragments = g_free_fragments;
-		g_free_fragments = fragments;
-		up(&g_free_fragments_mutex);
-		up(&g_free_fragments_sema);
-	}
+	put_pagelist_fragments(pagelistinfo, actual);
 
 	/* Need to mark all the pages dirty. */
 	if (pagelist->type != PAGELIST_WRITE &&
@@ -532,7 +635,10 @@ free_pagelist(struct vchiq_instance *instance, struct vchiq_pagelist_info *pagel
 			set_page_dirty(pages[i]);
 	}
 
-	cleanup_pagelistinfo(instance, pagelistinfo);
+	if (pagelistinfo->is_cached)
+		put_cached_pagelist(instance, pagelistinfo);
+	else
+		cleanup_pagelistinfo(instance, pagelistinfo);
 }
 
 static int vchiq_platform_init(struct platform_device *pdev, struct vchiq_state *state)
@@ -546,6 +652,7 @@ static int vchiq_platform_init(struct platform_device *pdev, struct vchiq_state
 	dma_addr_t slot_phys;
 	u32 channelbase;
 	int slot_mem_size, frag_mem_size;
+	int slots_per_side;
 	int err, irq, i;
 
 	/*
@@ -578,8 +685,14 @@ static int vchiq_platform_init(struct platform_device *pdev, struct vchiq_state
 		}
 	}
 
+	slots_per_side = clamp(vchiq_slots_per_side, MIN_SLOTS_PER_SIDE,
+			       MAX_SLOTS_PER_SIDE);
+	if (slots_per_side != vchiq_slots_per_side)
+		dev_warn(dev, "slots_per_side clamped to %d\n", slots_per_side);
+
 	/* Allocate space for the channels in coherent memory */
-	slot_mem_size = PAGE_ALIGN(TOTAL_SLOTS * VCHIQ_SLOT_SIZE);
+	slot_mem_size = PAGE_ALIGN((VCHIQ_SLOT_ZERO_SLOTS + 2 * slots_per_side) *
+				   VCHIQ_SLOT_SIZE);
 	frag_mem_size = PAGE_ALIGN(g_fragments_size * MAX_FRAGMENTS);
 
 	slot_mem = dmam_alloc_coherent(dev, slot_mem_size + frag_mem_size,
@@ -727,15 +840,24 @@ int
 vchiq_prepare_bulk_data(struct vchiq_instance *instance, struct vchiq_bulk *bulk, void *offset,
 			void __user *uoffset, int size, int dir)
 {
-	struct vchiq_pagelist_info *pagelistinfo;
+	struct vchiq_pagelist_info *pagelistinfo = NULL;
+	unsigned short type = (dir == VCHIQ_BULK_RECEIVE) ?
+			      PAGELIST_READ : PAGELIST_WRITE;
 
-	pagelistinfo = create_pagelist(instance, offset, uoffset, size,
-				       (dir == VCHIQ_BULK_RECEIVE)
-				       ? PAGELIST_READ
-				       : PAGELIST_WRITE);
+	if (uoffset && !list_empty(&instance->pagelist_cache))
+		pagelistinfo = get_cached_pagelist(instance, uoffset, size, type);
 
 	if (!pagelistinfo)
+		pagelistinfo = create_pagelist(instance, offset, uoffset, size,
+					       type);
+
+	if (!pagelistinfo)
+		return -ENOMEM;
+
+	if (get_pagelist_fragments(pagelistinfo)) {
+		free_pagelist(instance, pagelistinfo, VCHIQ_BULK_ACTUAL_ABORTED);
 		return -ENOMEM;
+	}
 
 	bulk->data = pagelistinfo->dma_addr;
 
@@ -756,6 +878,105 @@ vchiq_complete_bulk(struct vchiq_instance *instance, struct vchiq_bulk *bulk)
 			      bulk->actual);
 }
 
+int
+vchiq_register_bulk_buffer(struct vchiq_instance *instance, void __user *ubuf,
+			   unsigned int size, enum vchiq_bulk_dir dir)
+{
+	struct vchiq_pagelist_info *pagelistinfo;
+	unsigned short type = (dir == VCHIQ_BULK_RECEIVE) ?
+			      PAGELIST_READ : PAGELIST_WRITE;
+	int ret = 0;
+
+	if (!ubuf || !size)
+		return -EINVAL;
+
+	mutex_lock(&instance->pagelist_cache_mutex);
+
+	if (find_cached_pagelist(instance, ubuf, size, type)) {
+		ret = -EEXIST;
+		goto out;
+	}
+
+	if (instance->pagelist_cache_count >= VCHIQ_MAX_CACHED_PAGELISTS) {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	pagelistinfo = create_pagelist(instance, NULL, ubuf, size, type);
+	if (!pagelistinfo) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	/* The buffer is handed to the CPU between transfers. */
+	dma_sync_sg_for_cpu(g_dma_dev, pagelistinfo->scatterlist,
+			    pagelistinfo->num_pages, pagelistinfo->dma_dir);
+
+	pagelistinfo->ubuf = ubuf;
+	pagelistinfo->count = size;
+	pagelistinfo->type = type;
+	pagelistinfo->is_cached = true;
+	pagelistinfo->in_use = false;
+	list_add(&pagelistinfo->cache_list, &instance->pagelist_cache);
+	instance->pagelist_cache_count++;
+
+out:
+	mutex_unlock(&instance->pagelist_cache_mutex);
+
+	vchiq_log_trace(vchiq_arm_log_level, "%s(%pK, %u) returning %d",
+			__func__, ubuf, size, ret);
+
+	return ret;
+}
+
+int
+vchiq_unregister_bulk_buffer(struct vchiq_instance *instance, void __user *ubuf,
+			     unsigned int size, enum vchiq_bulk_dir dir)
+{
+	struct vchiq_pagelist_info *pagelistinfo;
+	unsigned short type = (dir == VCHIQ_BULK_RECEIVE) ?
+			      PAGELIST_READ : PAGELIST_WRITE;
+	int ret = 0;
+
+	mutex_lock(&instance->pagelist_cache_mutex);
+
+	pagelistinfo = find_cached_pagelist(instance, ubuf, size, type);
+	if (!pagelistinfo) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	if (pagelistinfo->in_use) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	list_del(&pagelistinfo->cache_list);
+	instance->pagelist_cache_count--;
+	cleanup_pagelistinfo(instance, pagelistinfo);
+
+out:
+	mutex_unlock(&instance->pagelist_cache_mutex);
+
+	return ret;
+}
+
+void
+vchiq_free_bulk_buffers(struct vchiq_instance *instance)
+{
+	struct vchiq_pagelist_info *pagelistinfo, *next;
+
+	mutex_lock(&instance->pagelist_cache_mutex);
+	list_for_each_entry_safe(pagelistinfo, next, &instance->pagelist_cache,
+				 cache_list) {
+		WARN_ON(pagelistinfo->in_use);
+		list_del(&pagelistinfo->cache_list);
+		cleanup_pagelistinfo(instance, pagelistinfo);
+	}
+	instance->pagelist_cache_count = 0;
+	mutex_unlock(&instance->pagelist_cache_mutex);
+}
+
 int vchiq_dump_platform_state(void *dump_context)
 {
 	char buf[80];
@@ -804,6 +1025,8 @@ int vchiq_initialise(struct vchiq_instance **instance_out)
 	instance->state = state;
 	mutex_init(&instance->bulk_waiter_list_mutex);
 	INIT_LIST_HEAD(&instance->bulk_waiter_list);
+	mutex_init(&instance->pagelist_cache_mutex);
+	INIT_LIST_HEAD(&instance->pagelist_cache);
 
 	*instance_out = instance;
 
@@ -845,6 +1068,7 @@ int vchiq_shutdown(struct vchiq_instance *instance)
 	vchiq_log_trace(vchiq_core_log_level, "%s(%p): returning %d", __func__, instance, status);
 
 	free_bulk_waiter(instance);
+	vchiq_free_bulk_buffers(instance);
 	kfree(instance);
 
 	return status;
@@ -1984,6 +2208,7 @@ static void vchiq_remove(struct platform_device *pdev)
 	platform_device_unregister(vcsm_cma);
 	vchiq_debugfs_deinit();
 	vchiq_deregister_chrdev();
+	vchiq_deinit_state(&g_state);
 }
 
 static struct platform_driver vchiq_driver = {
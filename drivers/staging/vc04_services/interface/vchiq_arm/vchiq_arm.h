@@ -66,6 +66,11 @@ struct vchiq_instance {
 	struct list_head bulk_waiter_list;
 	struct mutex bulk_waiter_list_mutex;
 
+	/* Registered bulk buffers, kept pinned and mapped between transfers */
+	struct list_head pagelist_cache;
+	struct mutex pagelist_cache_mutex;
+	int pagelist_cache_count;
+
 	struct vchiq_debugfs_node debugfs_node;
 };
 
@@ -144,4 +149,15 @@ service_callback(struct vchiq_instance *vchiq_instance, enum vchiq_reason reason
 extern void
 free_bulk_waiter(struct vchiq_instance *instance);
 
+extern int
+vchiq_register_bulk_buffer(struct vchiq_instance *instance, void __user *ubuf,
+			   unsigned int size, enum vchiq_bulk_dir dir);
+
+extern int
+vchiq_unregister_bulk_buffer(struct vchiq_instance *instance, void __user *ubuf,
+			     unsigned int size, enum vchiq_bulk_dir dir);
+
+extern void
+vchiq_free_bulk_buffers(struct vchiq_instance *instance);
+
 #endif /* VCHIQ_ARM_H */
@@ -10,12 +10,18 @@
 #include <linux/delay.h>
 #include <linux/slab.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
+#include <linux/log2_hist.h>
+#include <linux/math64.h>
 #include <linux/rcupdate.h>
 #include <linux/sched/signal.h>
 
 #include "vchiq_arm.h"
 #include "vchiq_core.h"
 
+#define CREATE_TRACE_POINTS
+#include "vchiq_trace.h"
+
 #define VCHIQ_SLOT_HANDLER_STACK 8192
 
 #define VCHIQ_MSG_PADDING            0  /* -                                 */
@@ -158,6 +164,9 @@ static inline void check_sizes(void)
 int vchiq_core_log_level = VCHIQ_LOG_DEFAULT;
 int vchiq_core_msg_log_level = VCHIQ_LOG_DEFAULT;
 int vchiq_sync_log_level = VCHIQ_LOG_DEFAULT;
+bool vchiq_rx_workers;
+int vchiq_rx_worker_cpu = VCHIQ_RX_CPU_ANY;
+bool vchiq_latency_stats;
 
 DEFINE_SPINLOCK(bulk_waiter_spinlock);
 static DEFINE_SPINLOCK(quota_spinlock);
@@ -463,17 +472,59 @@ mark_service_closing(struct vchiq_service *service)
 	mark_service_closing_internal(service, 0);
 }
 
+static void
+latency_hist_add(struct vchiq_latency_hist *hist, u64 delta_ns)
+{
+	unsigned int bucket = log2_hist_bucket(div_u64(delta_ns, NSEC_PER_USEC),
+					       0, VCHIQ_LATENCY_BUCKETS);
+
+	hist->buckets[bucket]++;
+	hist->count++;
+	hist->total_ns += delta_ns;
+	if (delta_ns > hist->max_ns)
+		hist->max_ns = delta_ns;
+}
+
+/*
+ * Timestamp for a latency sample, or 0 if neither the histograms nor the
+ * tracepoint @trace want it, so that the hot paths only read the clock when
+ * the result is used.
+ */
+static inline u64
+latency_start(bool trace)
+{
+	if (!READ_ONCE(vchiq_latency_stats) && !trace)
+		return 0;
+
+	return ktime_get_ns();
+}
+
+void
+vchiq_reset_service_latency(struct vchiq_service *service)
+{
+	memset(&service->latency, 0, sizeof(service->latency));
+}
+
 static inline int
 make_service_callback(struct vchiq_service *service, enum vchiq_reason reason,
 		      struct vchiq_header *header, void *bulk_userdata)
 {
 	int status;
+	u64 start_ns, delta_ns;
 
 	vchiq_log_trace(vchiq_core_log_level, "%d: callback:%d (%s, %pK, %pK)",
 			service->state->id, service->localport, reason_names[reason],
 			header, bulk_userdata);
+	start_ns = latency_start(trace_vchiq_callback_enabled());
 	status = service->base.callback(service->instance, reason, header, service->handle,
 					bulk_userdata);
+	if (start_ns) {
+		delta_ns = ktime_get_ns() - start_ns;
+		if (READ_ONCE(vchiq_latency_stats))
+			latency_hist_add(&service->latency.callback, delta_ns);
+		trace_vchiq_callback(service->base.fourcc, service->localport,
+				     reason, delta_ns);
+	}
 	if (status && (status != -EAGAIN)) {
 		vchiq_log_warning(vchiq_core_log_level,
 				  "%d: ignoring ERROR from callback to service %x",
@@ -721,6 +772,10 @@ reserve_space(struct vchiq_state *state, size_t space, int is_blocking)
 		slot_index = local->slot_queue[SLOT_QUEUE_INDEX_FROM_POS_MASKED(tx_pos)];
 		state->tx_data =
 			(char *)SLOT_DATA_FROM_INDEX(state, slot_index);
+
+		state->stats.min_slots_available =
+			min(state->stats.min_slots_available,
+			    vchiq_slots_available(state, tx_pos));
 	}
 
 	state->local_tx_pos = tx_pos + space;
@@ -921,6 +976,7 @@ queue_message(struct vchiq_state *state, struct vchiq_service *service,
 	struct vchiq_service_quota *quota = NULL;
 	struct vchiq_header *header;
 	int type = VCHIQ_MSG_TYPE(msgid);
+	u64 start_ns = latency_start(trace_vchiq_msg_signal_enabled());
 
 	size_t stride;
 
@@ -1145,6 +1201,15 @@ queue_message(struct vchiq_state *state, struct vchiq_service *service,
 
 	remote_event_signal(&state->remote->trigger);
 
+	if (start_ns && service && (type == VCHIQ_MSG_DATA)) {
+		u64 delta_ns = ktime_get_ns() - start_ns;
+
+		if (READ_ONCE(vchiq_latency_stats))
+			latency_hist_add(&service->latency.msg_signal, delta_ns);
+		trace_vchiq_msg_signal(service->base.fourcc, service->localport,
+				       size, delta_ns);
+	}
+
 	return 0;
 }
 
@@ -1242,6 +1307,137 @@ claim_slot(struct vchiq_slot_info *slot)
 	slot->use_count++;
 }
 
+/*
+ * Deferred delivery of DATA messages. The slot stays claimed until the
+ * client releases the message, so the header remains valid while it sits
+ * in the service's rx_queue. A single work item per service keeps the
+ * callbacks in order.
+ */
+static inline bool
+service_rx_deferred(struct vchiq_service *service)
+{
+	/* Keep deferring until the queue drains, to preserve ordering. */
+	return (READ_ONCE(service->rx_cpu) != VCHIQ_RX_CPU_NONE) ||
+	       (READ_ONCE(service->rx_insert) != READ_ONCE(service->rx_remove));
+}
+
+/*
+ * Where the DATA callbacks of a new service run: on the slot handler thread
+ * unless the rx_workers parameter is set, otherwise on the vchiq-rx
+ * workqueue, pinned to the CPU given by rx_worker_cpu if that is valid.
+ */
+static int
+service_rx_cpu(void)
+{
+	int cpu = READ_ONCE(vchiq_rx_worker_cpu);
+
+	if (!READ_ONCE(vchiq_rx_workers))
+		return VCHIQ_RX_CPU_NONE;
+
+	if (cpu < 0 || cpu >= nr_cpu_ids)
+		return VCHIQ_RX_CPU_ANY;
+
+	return cpu;
+}
+
+static bool
+queue_rx_callback(struct vchiq_service *service, struct vchiq_header *header,
+		  struct vchiq_slot_info *slot_info)
+{
+	int cpu;
+
+	spin_lock(&service->rx_lock);
+	if (service->rx_insert - service->rx_remove == VCHIQ_RX_QUEUE_SIZE) {
+		service->rx_stalled = 1;
+		spin_unlock(&service->rx_lock);
+		return false;
+	}
+	/* Claim before publishing - the worker may release it at once. */
+	header->msgid |= VCHIQ_MSGID_CLAIMED;
+	claim_slot(slot_info);
+	service->rx_queue[service->rx_insert & VCHIQ_RX_QUEUE_MASK] = header;
+	service->rx_insert++;
+	spin_unlock(&service->rx_lock);
+
+	cpu = READ_ONCE(service->rx_cpu);
+	if (cpu < 0 || !cpu_online(cpu))
+		cpu = WORK_CPU_UNBOUND;
+
+	/* The pending work item holds a reference to the service. */
+	vchiq_service_get(service);
+	if (!queue_work_on(cpu, service->state->rx_wq, &service->rx_work))
+		vchiq_service_put(service);
+
+	return true;
+}
+
+static void
+rx_callback_work(struct work_struct *work)
+{
+	struct vchiq_service *service =
+		container_of(work, struct vchiq_service, rx_work);
+	struct vchiq_state *state = service->state;
+	char stalled;
+
+	spin_lock(&service->rx_lock);
+	while (service->rx_remove != service->rx_insert) {
+		struct vchiq_header *header =
+			service->rx_queue[service->rx_remove & VCHIQ_RX_QUEUE_MASK];
+
+		spin_unlock(&service->rx_lock);
+
+		while (make_service_callback(service, VCHIQ_MESSAGE_AVAILABLE,
+					     header, NULL) == -EAGAIN) {
+			if (service->closing ||
+			    service->srvstate != VCHIQ_SRVSTATE_OPEN) {
+				vchiq_release_message(service->instance,
+						      service->handle, header);
+				break;
+			}
+			msleep(1);
+		}
+
+		spin_lock(&service->rx_lock);
+		service->rx_remove++;
+	}
+	stalled = service->rx_stalled;
+	service->rx_stalled = 0;
+	spin_unlock(&service->rx_lock);
+
+	/* Restart the slot handler if it was waiting for queue space. */
+	if (stalled)
+		remote_event_signal_local(&state->trigger_event,
+					  &state->local->trigger);
+
+	vchiq_service_put(service);
+}
+
+/*
+ * Drop the DATA callbacks still deferred for a service that is closing or
+ * being freed, so that none runs after the service is reported closed. The
+ * messages they carried stay claimed, release_service_messages() frees them.
+ */
+static void
+cancel_rx_callbacks(struct vchiq_service *service)
+{
+	struct vchiq_state *state = service->state;
+	char stalled;
+
+	/* The pending work item holds a reference to the service. */
+	if (cancel_work_sync(&service->rx_work))
+		vchiq_service_put(service);
+
+	spin_lock(&service->rx_lock);
+	service->rx_remove = service->rx_insert;
+	stalled = service->rx_stalled;
+	service->rx_stalled = 0;
+	spin_unlock(&service->rx_lock);
+
+	if (stalled)
+		remote_event_signal_local(&state->trigger_event,
+					  &state->local->trigger);
+}
+
 static void
 release_slot(struct vchiq_state *state, struct vchiq_slot_info *slot_info,
 	     struct vchiq_header *header, struct vchiq_service *service)
@@ -1710,13 +1906,21 @@ parse_message(struct vchiq_state *state, struct vchiq_header *header)
 
 		if ((service->remoteport == remoteport) &&
 		    (service->srvstate == VCHIQ_SRVSTATE_OPEN)) {
-			header->msgid = msgid | VCHIQ_MSGID_CLAIMED;
-			claim_slot(state->rx_info);
-			DEBUG_TRACE(PARSE_LINE);
-			if (make_service_callback(service, VCHIQ_MESSAGE_AVAILABLE, header,
-						  NULL) == -EAGAIN) {
+			if (service_rx_deferred(service)) {
+				if (!queue_rx_callback(service, header,
+						       state->rx_info)) {
+					DEBUG_TRACE(PARSE_LINE);
+					goto bail_not_ready;
+				}
+			} else {
+				header->msgid = msgid | VCHIQ_MSGID_CLAIMED;
+				claim_slot(state->rx_info);
 				DEBUG_TRACE(PARSE_LINE);
-				goto bail_not_ready;
+				if (make_service_callback(service, VCHIQ_MESSAGE_AVAILABLE,
+							  header, NULL) == -EAGAIN) {
+					DEBUG_TRACE(PARSE_LINE);
+					goto bail_not_ready;
+				}
 			}
 			VCHIQ_SERVICE_STATS_INC(service, ctrl_rx_count);
 			VCHIQ_SERVICE_STATS_ADD(service, ctrl_rx_bytes, size);
@@ -1777,6 +1981,17 @@ parse_message(struct vchiq_state *state, struct vchiq_header *header)
 			bulk->actual = *(int *)header->data;
 			queue->remote_insert++;
 
+			if (bulk->submit_ns) {
+				u64 delta_ns = ktime_get_ns() - bulk->submit_ns;
+
+				if (READ_ONCE(vchiq_latency_stats))
+					latency_hist_add(&service->latency.bulk_complete,
+							 delta_ns);
+				trace_vchiq_bulk_complete(service->base.fourcc,
+							  service->localport, bulk->dir,
+							  bulk->actual, delta_ns);
+			}
+
 			vchiq_log_info(vchiq_core_log_level, "%d: prs %s@%pK (%d->%d) %x@%pad",
 				       state->id, msg_type_str(type), header, remoteport, localport,
 				       bulk->actual, &bulk->data);
@@ -2230,6 +2445,7 @@ vchiq_init_state(struct vchiq_state *state, struct vchiq_slot_zero *slot_zero, s
 	state->previous_data_index = -1;
 	state->data_use_count = 0;
 	state->data_quota = state->slot_queue_available - 1;
+	state->stats.min_slots_available = vchiq_slots_available(state, 0);
 
 	remote_event_create(&state->trigger_event, &local->trigger);
 	local->tx_pos = 0;
@@ -2250,6 +2466,11 @@ vchiq_init_state(struct vchiq_state *state, struct vchiq_slot_zero *slot_zero, s
 	if (ret)
 		return ret;
 
+	state->rx_wq = alloc_workqueue("vchiq-rx/%d", WQ_HIGHPRI | WQ_MEM_RECLAIM,
+				       0, state->id);
+	if (!state->rx_wq)
+		return -ENOMEM;
+
 	/*
 	 * bring up slot handler thread
 	 */
@@ -2260,7 +2481,8 @@ vchiq_init_state(struct vchiq_state *state, struct vchiq_slot_zero *slot_zero, s
 		vchiq_loud_error_header();
 		vchiq_loud_error("couldn't create thread %s", threadname);
 		vchiq_loud_error_footer();
-		return PTR_ERR(state->slot_handler_thread);
+		ret = PTR_ERR(state->slot_handler_thread);
+		goto fail_free_rx_wq;
 	}
 	set_user_nice(state->slot_handler_thread, -19);
 
@@ -2299,10 +2521,22 @@ vchiq_init_state(struct vchiq_state *state, struct vchiq_slot_zero *slot_zero, s
 	kthread_stop(state->recycle_thread);
 fail_free_handler_thread:
 	kthread_stop(state->slot_handler_thread);
+fail_free_rx_wq:
+	destroy_workqueue(state->rx_wq);
+	state->rx_wq = NULL;
 
 	return ret;
 }
 
+void
+vchiq_deinit_state(struct vchiq_state *state)
+{
+	if (state->rx_wq) {
+		destroy_workqueue(state->rx_wq);
+		state->rx_wq = NULL;
+	}
+}
+
 void vchiq_msg_queue_push(struct vchiq_instance *instance, unsigned int handle,
 			  struct vchiq_header *header)
 {
@@ -2407,6 +2641,9 @@ vchiq_add_service_internal(struct vchiq_state *state,
 	init_completion(&service->msg_queue_pop);
 	init_completion(&service->msg_queue_push);
 	mutex_init(&service->bulk_mutex);
+	spin_lock_init(&service->rx_lock);
+	INIT_WORK(&service->rx_work, rx_callback_work);
+	service->rx_cpu = service_rx_cpu();
 
 	/*
 	 * Although it is perfectly possible to use a spinlock
@@ -2651,6 +2888,7 @@ close_service_complete(struct vchiq_service *service, int failstate)
 		return -EINVAL;
 	}
 
+	cancel_rx_callbacks(service);
 	status = make_service_callback(service, VCHIQ_SERVICE_CLOSED, NULL, NULL);
 
 	if (status != -EAGAIN) {
@@ -2737,6 +2975,7 @@ vchiq_close_service_internal(struct vchiq_service *service, int close_recvd)
 				status = -EAGAIN;
 		}
 
+		cancel_rx_callbacks(service);
 		release_service_messages(service);
 
 		if (!status)
@@ -2833,6 +3072,7 @@ vchiq_free_service_internal(struct vchiq_service *service)
 		return;
 	}
 
+	cancel_rx_callbacks(service);
 	set_service_state(service, VCHIQ_SRVSTATE_FREE);
 
 	complete(&service->remove_event);
@@ -3090,10 +3330,14 @@ int vchiq_bulk_transfer(struct vchiq_instance *instance, unsigned int handle,
 	bulk->userdata = userdata;
 	bulk->size = size;
 	bulk->actual = VCHIQ_BULK_ACTUAL_ABORTED;
+	bulk->submit_ns = latency_start(trace_vchiq_bulk_complete_enabled());
 
 	if (vchiq_prepare_bulk_data(instance, bulk, offset, uoffset, size, dir))
 		goto unlock_error_exit;
 
+	trace_vchiq_bulk_submit(service->base.fourcc, service->localport, dir,
+				size);
+
 	/*
 	 * Ensure that the bulk data record is visible to the peer
 	 * before proceeding.
@@ -10,6 +10,7 @@
 #include <linux/kref.h>
 #include <linux/rcupdate.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include "../../include/linux/raspberrypi/vchiq.h"
 #include "vchiq_cfg.h"
@@ -65,6 +66,13 @@
 
 #define VCHIQ_SLOT_MASK        (VCHIQ_SLOT_SIZE - 1)
 #define VCHIQ_SLOT_QUEUE_MASK  (VCHIQ_MAX_SLOTS_PER_SIDE - 1)
+
+#define VCHIQ_RX_QUEUE_SIZE    64 /* Must be a power of 2 */
+#define VCHIQ_RX_QUEUE_MASK    (VCHIQ_RX_QUEUE_SIZE - 1)
+
+#define VCHIQ_RX_CPU_NONE      (-2) /* Callbacks run on the slot handler */
+#define VCHIQ_RX_CPU_ANY       (-1) /* Deferred, on any CPU */
+
 #define VCHIQ_SLOT_ZERO_SLOTS  DIV_ROUND_UP(sizeof(struct vchiq_slot_zero), \
 					    VCHIQ_SLOT_SIZE)
 
@@ -155,6 +163,27 @@ struct vchiq_bulk {
 	void *remote_data;
 	int remote_size;
 	int actual;
+	u64 submit_ns;
+};
+
+/*
+ * Latency histograms use power-of-two microsecond buckets: bucket 0 counts
+ * samples below 1us, bucket n counts samples in [2^(n-1), 2^n) us and the
+ * last bucket also absorbs everything larger.
+ */
+#define VCHIQ_LATENCY_BUCKETS 20
+
+struct vchiq_latency_hist {
+	u32 buckets[VCHIQ_LATENCY_BUCKETS];
+	u32 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+struct vchiq_service_latency {
+	struct vchiq_latency_hist msg_signal;
+	struct vchiq_latency_hist bulk_complete;
+	struct vchiq_latency_hist callback;
 };
 
 struct vchiq_bulk_queue {
@@ -250,11 +279,25 @@ struct vchiq_service {
 		u64 bulk_rx_bytes;
 	} stats;
 
+	struct vchiq_service_latency latency;
+
 	int msg_queue_read;
 	int msg_queue_write;
 	struct completion msg_queue_pop;
 	struct completion msg_queue_push;
 	struct vchiq_header *msg_queue[VCHIQ_MAX_SLOTS];
+
+	/*
+	 * Optional deferred delivery of DATA messages, so that the service
+	 * callback runs on a worker rather than on the slot handler thread.
+	 */
+	int rx_cpu;
+	char rx_stalled;
+	spinlock_t rx_lock;
+	struct work_struct rx_work;
+	unsigned int rx_insert;
+	unsigned int rx_remove;
+	struct vchiq_header *rx_queue[VCHIQ_RX_QUEUE_SIZE];
 };
 
 /*
@@ -361,6 +404,9 @@ struct vchiq_state {
 	/* Processes synchronous messages */
 	struct task_struct *sync_thread;
 
+	/* Runs deferred service callbacks */
+	struct workqueue_struct *rx_wq;
+
 	/* Local implementation of the trigger remote event */
 	wait_queue_head_t trigger_event;
 
@@ -431,6 +477,8 @@ struct vchiq_state {
 	struct state_stats_struct {
 		int slot_stalls;
 		int data_stalls;
+		/* Fewest free slots seen when moving to a new tx slot */
+		int min_slots_available;
 		int ctrl_tx_count;
 		int ctrl_rx_count;
 		int error_count;
@@ -443,6 +491,12 @@ struct vchiq_state {
 	struct opaque_platform_state *platform_state;
 };
 
+/* Free local slots after the one @tx_pos falls in */
+static inline int vchiq_slots_available(struct vchiq_state *state, int tx_pos)
+{
+	return state->slot_queue_available - tx_pos / VCHIQ_SLOT_SIZE - 1;
+}
+
 struct bulk_waiter {
 	struct vchiq_bulk *bulk;
 	struct completion event;
@@ -466,6 +520,9 @@ extern spinlock_t bulk_waiter_spinlock;
 extern int vchiq_core_log_level;
 extern int vchiq_core_msg_log_level;
 extern int vchiq_sync_log_level;
+extern bool vchiq_rx_workers;
+extern int vchiq_rx_worker_cpu;
+extern bool vchiq_latency_stats;
 
 extern const char *
 get_conn_state_name(enum vchiq_connstate conn_state);
@@ -476,6 +533,9 @@ vchiq_init_slots(void *mem_base, int mem_size);
 extern int
 vchiq_init_state(struct vchiq_state *state, struct vchiq_slot_zero *slot_zero, struct device *dev);
 
+extern void
+vchiq_deinit_state(struct vchiq_state *state);
+
 extern int
 vchiq_connect_internal(struct vchiq_state *state, struct vchiq_instance *instance);
 
@@ -570,6 +630,8 @@ void remote_event_signal(struct remote_event *event);
 
 int vchiq_dump(void *dump_context, const char *str, int len);
 
+void vchiq_reset_service_latency(struct vchiq_service *service);
+
 int vchiq_dump_platform_state(void *dump_context);
 
 int vchiq_dump_platform_instances(void *dump_context);
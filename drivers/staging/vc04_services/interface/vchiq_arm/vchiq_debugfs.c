@@ -5,6 +5,7 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/math64.h>
 #include "vchiq_core.h"
 #include "vchiq_arm.h"
 #include "vchiq_debugfs.h"
@@ -177,6 +178,186 @@ static const struct file_operations debugfs_trace_fops = {
 	.release	= single_release,
 };
 
+static void debugfs_latency_hist_show(struct seq_file *f, const char *name,
+				      const struct vchiq_latency_hist *hist)
+{
+	int i;
+
+	if (!hist->count)
+		return;
+
+	seq_printf(f, "  %s: count=%u avg=%lluus max=%lluus\n", name,
+		   hist->count,
+		   div_u64(div_u64(hist->total_ns, hist->count), NSEC_PER_USEC),
+		   div_u64(hist->max_ns, NSEC_PER_USEC));
+
+	for (i = 0; i < VCHIQ_LATENCY_BUCKETS; i++) {
+		if (!hist->buckets[i])
+			continue;
+		if (!i)
+			seq_puts(f, "    <1us");
+		else if (i == VCHIQ_LATENCY_BUCKETS - 1)
+			seq_printf(f, "    >=%luus", 1UL << (i - 1));
+		else
+			seq_printf(f, "    <%luus", 1UL << i);
+		seq_printf(f, ": %u\n", hist->buckets[i]);
+	}
+}
+
+static int debugfs_latency_show(struct seq_file *f, void *offset)
+{
+	struct vchiq_state *state = vchiq_get_state();
+	int i;
+
+	if (!state)
+		return -ENOTCONN;
+
+	rcu_read_lock();
+	for (i = 0; i < state->unused_service; i++) {
+		struct vchiq_service *service = rcu_dereference(state->services[i]);
+		struct vchiq_service_latency *latency;
+
+		if (!service || service->srvstate == VCHIQ_SRVSTATE_FREE)
+			continue;
+
+		latency = &service->latency;
+		if (!latency->msg_signal.count && !latency->bulk_complete.count &&
+		    !latency->callback.count)
+			continue;
+
+		seq_printf(f, "%c%c%c%c:%d\n",
+			   VCHIQ_FOURCC_AS_4CHARS(service->base.fourcc),
+			   service->localport);
+		debugfs_latency_hist_show(f, "queue_to_signal",
+					  &latency->msg_signal);
+		debugfs_latency_hist_show(f, "bulk_submit_to_complete",
+					  &latency->bulk_complete);
+		debugfs_latency_hist_show(f, "callback",
+					  &latency->callback);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int debugfs_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, debugfs_latency_show, inode->i_private);
+}
+
+/* Any write resets the histograms of all services */
+static ssize_t debugfs_latency_write(struct file *file,
+	const char __user *buffer,
+	size_t count, loff_t *ppos)
+{
+	struct vchiq_state *state = vchiq_get_state();
+	int i;
+
+	if (!state)
+		return -ENOTCONN;
+
+	rcu_read_lock();
+	for (i = 0; i < state->unused_service; i++) {
+		struct vchiq_service *service = rcu_dereference(state->services[i]);
+
+		if (service)
+			vchiq_reset_service_latency(service);
+	}
+	rcu_read_unlock();
+
+	*ppos += count;
+
+	return count;
+}
+
+static const struct file_operations debugfs_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= debugfs_latency_open,
+	.write		= debugfs_latency_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int debugfs_slots_show(struct seq_file *f, void *offset)
+{
+	struct vchiq_state *state = vchiq_get_state();
+	struct vchiq_shared_state *local;
+	int i;
+
+	if (!state)
+		return -ENOTCONN;
+
+	local = state->local;
+	seq_printf(f, "data_slots=%d available=%d recyclable=%d min_available=%d\n",
+		   local->slot_last - local->slot_first + 1,
+		   vchiq_slots_available(state, state->local_tx_pos),
+		   local->slot_queue_recycle - state->slot_queue_available,
+		   state->stats.min_slots_available);
+	seq_printf(f, "slot_stalls=%d data_stalls=%d data_use=%d/%d\n",
+		   state->stats.slot_stalls, state->stats.data_stalls,
+		   state->data_use_count, state->data_quota);
+
+	/* Who is holding on to slots, and who had to wait for them */
+	rcu_read_lock();
+	for (i = 0; i < state->unused_service; i++) {
+		struct vchiq_service *service = rcu_dereference(state->services[i]);
+		struct vchiq_service_quota *quota;
+
+		if (!service || service->srvstate == VCHIQ_SRVSTATE_FREE)
+			continue;
+
+		quota = &state->service_quotas[service->localport];
+		seq_printf(f, "%c%c%c%c:%d slots=%d/%d msgs=%d/%d quota_stalls=%d slot_stalls=%d\n",
+			   VCHIQ_FOURCC_AS_4CHARS(service->base.fourcc),
+			   service->localport,
+			   quota->slot_use_count, quota->slot_quota,
+			   quota->message_use_count, quota->message_quota,
+			   service->stats.quota_stalls,
+			   service->stats.slot_stalls);
+	}
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static int debugfs_slots_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, debugfs_slots_show, inode->i_private);
+}
+
+/* Any write restarts the low-water mark and the stall counts */
+static ssize_t debugfs_slots_write(struct file *file,
+	const char __user *buffer,
+	size_t count, loff_t *ppos)
+{
+	struct vchiq_state *state = vchiq_get_state();
+
+	if (!state)
+		return -ENOTCONN;
+
+	if (mutex_lock_killable(&state->slot_mutex))
+		return -EINTR;
+	state->stats.min_slots_available =
+		vchiq_slots_available(state, state->local_tx_pos);
+	state->stats.slot_stalls = 0;
+	state->stats.data_stalls = 0;
+	mutex_unlock(&state->slot_mutex);
+
+	*ppos += count;
+
+	return count;
+}
+
+static const struct file_operations debugfs_slots_fops = {
+	.owner		= THIS_MODULE,
+	.open		= debugfs_slots_open,
+	.write		= debugfs_slots_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /* add an instance (process) to the debugfs entries */
 void vchiq_debugfs_add_instance(struct vchiq_instance *instance)
 {
@@ -218,6 +399,16 @@ void vchiq_debugfs_init(void)
 		debugfs_create_file(vchiq_debugfs_log_entries[i].name, 0644,
 				    dir, vchiq_debugfs_log_entries[i].plevel,
 				    &debugfs_log_fops);
+
+	/* per-service latency histograms, collected while enabled */
+	debugfs_create_bool("latency_enable", 0644, vchiq_dbg_dir,
+			    &vchiq_latency_stats);
+	debugfs_create_file("latency", 0644, vchiq_dbg_dir, NULL,
+			    &debugfs_latency_fops);
+
+	/* slot usage and pressure of the local (ARM) side */
+	debugfs_create_file("slots", 0644, vchiq_dbg_dir, NULL,
+			    &debugfs_slots_fops);
 }
 
 /* remove all the debugfs entries */
@@ -34,7 +34,9 @@ static const char *const ioctl_names[] = {
 	"SET_SERVICE_OPTION",
 	"DUMP_PHYS_MEM",
 	"LIB_VERSION",
-	"CLOSE_DELIVERED"
+	"CLOSE_DELIVERED",
+	"REGISTER_BULK_BUFFER",
+	"UNREGISTER_BULK_BUFFER"
 };
 
 static_assert(ARRAY_SIZE(ioctl_names) == (VCHIQ_IOC_MAX + 1));
@@ -853,6 +855,24 @@ vchiq_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 	} break;
 
+	case VCHIQ_IOC_REGISTER_BULK_BUFFER:
+	case VCHIQ_IOC_UNREGISTER_BULK_BUFFER: {
+		struct vchiq_bulk_buffer args;
+
+		if (copy_from_user(&args, (const void __user *)arg,
+				   sizeof(args))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		if (cmd == VCHIQ_IOC_REGISTER_BULK_BUFFER)
+			ret = vchiq_register_bulk_buffer(instance, args.data,
+							 args.size, args.dir);
+		else
+			ret = vchiq_unregister_bulk_buffer(instance, args.data,
+							   args.size, args.dir);
+	} break;
+
 	default:
 		ret = -ENOTTY;
 		break;
@@ -1139,6 +1159,36 @@ vchiq_compat_ioctl_get_config(struct file *file,
 	return 0;
 }
 
+struct vchiq_bulk_buffer32 {
+	compat_uptr_t data;
+	unsigned int size;
+	enum vchiq_bulk_dir dir;
+};
+
+#define VCHIQ_IOC_REGISTER_BULK_BUFFER32 \
+	_IOW(VCHIQ_IOC_MAGIC, 18, struct vchiq_bulk_buffer32)
+#define VCHIQ_IOC_UNREGISTER_BULK_BUFFER32 \
+	_IOW(VCHIQ_IOC_MAGIC, 19, struct vchiq_bulk_buffer32)
+
+static long
+vchiq_compat_ioctl_bulk_buffer(struct file *file, unsigned int cmd,
+			       struct vchiq_bulk_buffer32 __user *arg)
+{
+	struct vchiq_instance *instance = file->private_data;
+	struct vchiq_bulk_buffer32 args32;
+
+	if (copy_from_user(&args32, arg, sizeof(args32)))
+		return -EFAULT;
+
+	if (cmd == VCHIQ_IOC_REGISTER_BULK_BUFFER32)
+		return vchiq_register_bulk_buffer(instance,
+						  compat_ptr(args32.data),
+						  args32.size, args32.dir);
+
+	return vchiq_unregister_bulk_buffer(instance, compat_ptr(args32.data),
+					    args32.size, args32.dir);
+}
+
 static long
 vchiq_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
@@ -1158,6 +1208,9 @@ vchiq_compat_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		return vchiq_compat_ioctl_dequeue_message(file, cmd, argp);
 	case VCHIQ_IOC_GET_CONFIG32:
 		return vchiq_compat_ioctl_get_config(file, cmd, argp);
+	case VCHIQ_IOC_REGISTER_BULK_BUFFER32:
+	case VCHIQ_IOC_UNREGISTER_BULK_BUFFER32:
+		return vchiq_compat_ioctl_bulk_buffer(file, cmd, argp);
 	default:
 		return vchiq_ioctl(file, cmd, (unsigned long)argp);
 	}
@@ -1192,6 +1245,8 @@ static int vchiq_open(struct inode *inode, struct file *file)
 	mutex_init(&instance->completion_mutex);
 	mutex_init(&instance->bulk_waiter_list_mutex);
 	INIT_LIST_HEAD(&instance->bulk_waiter_list);
+	mutex_init(&instance->pagelist_cache_mutex);
+	INIT_LIST_HEAD(&instance->pagelist_cache);
 
 	file->private_data = instance;
 
@@ -1296,6 +1351,7 @@ static int vchiq_release(struct inode *inode, struct file *file)
 	vchiq_release_internal(instance->state, NULL);
 
 	free_bulk_waiter(instance);
+	vchiq_free_bulk_buffers(instance);
 
 	vchiq_debugfs_remove_instance(instance);
 
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0 OR BSD-3-Clause */
+/*
+ * Copyright (c) 2014 Raspberry Pi (Trading) Ltd. All rights reserved.
+ */
+
+#if !defined(_VCHIQ_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _VCHIQ_TRACE_H_
+
+#include <linux/stringify.h>
+#include <linux/types.h>
+#include <linux/tracepoint.h>
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM vchiq
+#define TRACE_INCLUDE_FILE vchiq_trace
+
+TRACE_EVENT(vchiq_msg_signal,
+	    TP_PROTO(u32 fourcc, unsigned int port, size_t size, u64 delta_ns),
+	    TP_ARGS(fourcc, port, size, delta_ns),
+
+	    TP_STRUCT__entry(
+			     __field(u32, fourcc)
+			     __field(unsigned int, port)
+			     __field(size_t, size)
+			     __field(u64, delta_ns)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->fourcc = fourcc;
+			   __entry->port = port;
+			   __entry->size = size;
+			   __entry->delta_ns = delta_ns;
+			   ),
+
+	    TP_printk("service=%c%c%c%c port=%u size=%zu queue_to_signal=%lluns",
+		      (__entry->fourcc >> 24) & 0xff,
+		      (__entry->fourcc >> 16) & 0xff,
+		      (__entry->fourcc >> 8) & 0xff,
+		      __entry->fourcc & 0xff,
+		      __entry->port, __entry->size, __entry->delta_ns)
+);
+
+TRACE_EVENT(vchiq_bulk_submit,
+	    TP_PROTO(u32 fourcc, unsigned int port, int dir, int size),
+	    TP_ARGS(fourcc, port, dir, size),
+
+	    TP_STRUCT__entry(
+			     __field(u32, fourcc)
+			     __field(unsigned int, port)
+			     __field(int, dir)
+			     __field(int, size)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->fourcc = fourcc;
+			   __entry->port = port;
+			   __entry->dir = dir;
+			   __entry->size = size;
+			   ),
+
+	    TP_printk("service=%c%c%c%c port=%u %cx size=%d",
+		      (__entry->fourcc >> 24) & 0xff,
+		      (__entry->fourcc >> 16) & 0xff,
+		      (__entry->fourcc >> 8) & 0xff,
+		      __entry->fourcc & 0xff,
+		      __entry->port, __entry->dir ? 'r' : 't', __entry->size)
+);
+
+TRACE_EVENT(vchiq_bulk_complete,
+	    TP_PROTO(u32 fourcc, unsigned int port, int dir, int actual,
+		     u64 delta_ns),
+	    TP_ARGS(fourcc, port, dir, actual, delta_ns),
+
+	    TP_STRUCT__entry(
+			     __field(u32, fourcc)
+			     __field(unsigned int, port)
+			     __field(int, dir)
+			     __field(int, actual)
+			     __field(u64, delta_ns)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->fourcc = fourcc;
+			   __entry->port = port;
+			   __entry->dir = dir;
+			   __entry->actual = actual;
+			   __entry->delta_ns = delta_ns;
+			   ),
+
+	    TP_printk("service=%c%c%c%c port=%u %cx actual=%d submit_to_complete=%lluns",
+		      (__entry->fourcc >> 24) & 0xff,
+		      (__entry->fourcc >> 16) & 0xff,
+		      (__entry->fourcc >> 8) & 0xff,
+		      __entry->fourcc & 0xff,
+		      __entry->port, __entry->dir ? 'r' : 't',
+		      __entry->actual, __entry->delta_ns)
+);
+
+TRACE_EVENT(vchiq_callback,
+	    TP_PROTO(u32 fourcc, unsigned int port, int reason, u64 delta_ns),
+	    TP_ARGS(fourcc, port, reason, delta_ns),
+
+	    TP_STRUCT__entry(
+			     __field(u32, fourcc)
+			     __field(unsigned int, port)
+			     __field(int, reason)
+			     __field(u64, delta_ns)
+			     ),
+
+	    TP_fast_assign(
+			   __entry->fourcc = fourcc;
+			   __entry->port = port;
+			   __entry->reason = reason;
+			   __entry->delta_ns = delta_ns;
+			   ),
+
+	    TP_printk("service=%c%c%c%c port=%u reason=%d duration=%lluns",
+		      (__entry->fourcc >> 24) & 0xff,
+		      (__entry->fourcc >> 16) & 0xff,
+		      (__entry->fourcc >> 8) & 0xff,
+		      __entry->fourcc & 0xff,
+		      __entry->port, __entry->reason, __entry->delta_ns)
+);
+
+#endif /* _VCHIQ_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../drivers/staging/vc04_services/interface/vchiq_arm
+#include <trace/define_trace.h>
@@ -590,6 +590,49 @@ static int vc_sm_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 	return 0;
 }
 
+static int vc_sm_dma_buf_sync_partial(struct dma_buf *dmabuf,
+				      enum dma_data_direction direction,
+				      unsigned int offset, unsigned int len,
+				      bool for_cpu)
+{
+	struct vc_sm_buffer *buf;
+	struct vc_sm_dma_buf_attachment *a;
+
+	if (!dmabuf)
+		return -EFAULT;
+	buf = dmabuf->priv;
+	if (!buf)
+		return -EFAULT;
+
+	mutex_lock(&buf->lock);
+
+	list_for_each_entry(a, &buf->attachments, list) {
+		dma_buf_sync_sgtable_range(a->dev, &a->sg_table, direction,
+					   offset, len, for_cpu);
+	}
+	mutex_unlock(&buf->lock);
+
+	return 0;
+}
+
+static int vc_sm_dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+						  enum dma_data_direction direction,
+						  unsigned int offset,
+						  unsigned int len)
+{
+	return vc_sm_dma_buf_sync_partial(dmabuf, direction, offset, len,
+					  true);
+}
+
+static int vc_sm_dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+						enum dma_data_direction direction,
+						unsigned int offset,
+						unsigned int len)
+{
+	return vc_sm_dma_buf_sync_partial(dmabuf, direction, offset, len,
+					  false);
+}
+
 static const struct dma_buf_ops dma_buf_ops = {
 	.map_dma_buf = vc_sm_map_dma_buf,
 	.unmap_dma_buf = vc_sm_unmap_dma_buf,
@@ -599,6 +642,8 @@ static const struct dma_buf_ops dma_buf_ops = {
 	.detach = vc_sm_dma_buf_detach,
 	.begin_cpu_access = vc_sm_dma_buf_begin_cpu_access,
 	.end_cpu_access = vc_sm_dma_buf_end_cpu_access,
+	.begin_cpu_access_partial = vc_sm_dma_buf_begin_cpu_access_partial,
+	.end_cpu_access_partial = vc_sm_dma_buf_end_cpu_access_partial,
 };
 
 /* Dma_buf operations for chaining through to an imported dma_buf */
@@ -689,6 +734,40 @@ int vc_sm_import_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 							  direction);
 }
 
+static
+int vc_sm_import_dma_buf_begin_cpu_access_partial(struct dma_buf *dmabuf,
+						  enum dma_data_direction direction,
+						  unsigned int offset,
+						  unsigned int len)
+{
+	struct vc_sm_buffer *buf = dmabuf->priv;
+	struct dma_buf *import = buf->import.dma_buf;
+
+	if (!buf->imported)
+		return -EINVAL;
+	if (!import->ops->begin_cpu_access_partial)
+		return import->ops->begin_cpu_access(import, direction);
+	return import->ops->begin_cpu_access_partial(import, direction,
+						     offset, len);
+}
+
+static
+int vc_sm_import_dma_buf_end_cpu_access_partial(struct dma_buf *dmabuf,
+						enum dma_data_direction direction,
+						unsigned int offset,
+						unsigned int len)
+{
+	struct vc_sm_buffer *buf = dmabuf->priv;
+	struct dma_buf *import = buf->import.dma_buf;
+
+	if (!buf->imported)
+		return -EINVAL;
+	if (!import->ops->end_cpu_access_partial)
+		return import->ops->end_cpu_access(import, direction);
+	return import->ops->end_cpu_access_partial(import, direction,
+						   offset, len);
+}
+
 static const struct dma_buf_ops dma_buf_import_ops = {
 	.map_dma_buf = vc_sm_import_map_dma_buf,
 	.unmap_dma_buf = vc_sm_import_unmap_dma_buf,
@@ -698,6 +777,8 @@ static const struct dma_buf_ops dma_buf_import_ops = {
 	.detach = vc_sm_import_dma_buf_detatch,
 	.begin_cpu_access = vc_sm_import_dma_buf_begin_cpu_access,
 	.end_cpu_access = vc_sm_import_dma_buf_end_cpu_access,
+	.begin_cpu_access_partial = vc_sm_import_dma_buf_begin_cpu_access_partial,
+	.end_cpu_access_partial = vc_sm_import_dma_buf_end_cpu_access_partial,
 };
 
 /* Import a dma_buf to be shared with VC. */
@@ -1323,6 +1404,150 @@ static int vc_sm_cma_clean_invalid2(unsigned int cmdnr, unsigned long arg)
 
 	return ret;
 }
+
+/* Maximum number of operations accepted in one CLEAN_INVALID_VEC call */
+#define VC_SM_MAX_CACHE_OPS	4096
+/* Operations copied from user space at a time */
+#define VC_SM_CACHE_OP_BATCH	64
+
+/* A range waiting to have its cache operation applied. */
+struct vc_sm_cache_range {
+	unsigned int cache_op;
+	unsigned long start;
+	unsigned long end;
+};
+
+/* Whether cache_op a already covers everything cache_op b would do. */
+static bool cache_op_covers(unsigned int a, unsigned int b)
+{
+	return a == b || a == VC_SM_CACHE_OP_FLUSH;
+}
+
+static void cache_range_apply(struct vc_sm_cache_range *range)
+{
+	void (*op_fn)(const void *start, const void *end);
+
+	if (range->end == range->start)
+		return;
+
+	op_fn = cache_op_to_func(range->cache_op);
+	if (op_fn)
+		op_fn((const void *)range->start, (const void *)range->end);
+	range->end = range->start;
+}
+
+/*
+ * Add a range to the pending one where possible, otherwise apply the pending
+ * range and replace it. Clean and flush may be widened over a gap of less
+ * than a cache line, as that only writes back lines in the gap. Invalidate
+ * must never touch bytes outside the ranges asked for.
+ */
+static void cache_range_add(struct vc_sm_cache_range *pending,
+			    unsigned int cache_op,
+			    unsigned long start, unsigned long end)
+{
+	unsigned long slack = cache_op == VC_SM_CACHE_OP_INV ?
+			      0 : L1_CACHE_BYTES;
+
+	if (pending->end != pending->start) {
+		/* Already covered by the pending range */
+		if (cache_op_covers(pending->cache_op, cache_op) &&
+		    start >= pending->start && end <= pending->end)
+			return;
+
+		if (pending->cache_op == cache_op &&
+		    start >= pending->start && start <= pending->end + slack) {
+			pending->end = max(pending->end, end);
+			return;
+		}
+
+		cache_range_apply(pending);
+	}
+
+	pending->cache_op = cache_op;
+	pending->start = start;
+	pending->end = end;
+}
+
+static int cache_op_add(struct vc_sm_cache_range *pending,
+			const struct vc_sm_cma_ioctl_clean_invalid_op *op)
+{
+	unsigned long addr = (unsigned long)op->start_address;
+	u32 i;
+
+	if (op->invalidate_mode == VC_SM_CACHE_OP_NOP || !op->block_count)
+		return 0;
+
+	if (!op->block_size || op->invalidate_mode > VC_SM_CACHE_OP_FLUSH) {
+		pr_err("[%s]: invalid op, mode %u size %u\n", __func__,
+		       op->invalidate_mode, op->block_size);
+		return -EINVAL;
+	}
+
+	/* Lines that are back to back are one range */
+	if (op->block_count == 1 || op->inter_block_stride == op->block_size) {
+		cache_range_add(pending, op->invalidate_mode, addr,
+				addr + (unsigned long)op->block_count *
+				       op->block_size);
+		return 0;
+	}
+
+	for (i = 0; i < op->block_count; i++, addr += op->inter_block_stride)
+		cache_range_add(pending, op->invalidate_mode, addr,
+				addr + op->block_size);
+
+	return 0;
+}
+
+static int vc_sm_cma_clean_invalid_vec(unsigned int cmdnr, unsigned long arg)
+{
+	struct vc_sm_cma_ioctl_clean_invalid_vec ioparam;
+	struct vc_sm_cma_ioctl_clean_invalid_op *ops;
+	struct vc_sm_cma_ioctl_clean_invalid_op __user *uops;
+	struct vc_sm_cache_range pending = { };
+	u32 done, count, i;
+	int ret = 0;
+
+	if (copy_from_user(&ioparam, (void __user *)arg, sizeof(ioparam))) {
+		pr_err("[%s]: failed to copy-from-user header for cmd %x\n",
+		       __func__, cmdnr);
+		return -EFAULT;
+	}
+
+	if (ioparam.op_count > VC_SM_MAX_CACHE_OPS)
+		return -EINVAL;
+
+	ops = kmalloc_array(VC_SM_CACHE_OP_BATCH, sizeof(*ops), GFP_KERNEL);
+	if (!ops)
+		return -ENOMEM;
+
+	uops = u64_to_user_ptr(ioparam.ops);
+	for (done = 0; done < ioparam.op_count; done += count) {
+		count = min_t(u32, ioparam.op_count - done,
+			      VC_SM_CACHE_OP_BATCH);
+
+		if (copy_from_user(ops, uops + done, count * sizeof(*ops))) {
+			pr_err("[%s]: failed to copy-from-user payload for cmd %x\n",
+			       __func__, cmdnr);
+			ret = -EFAULT;
+			break;
+		}
+
+		for (i = 0; i < count; i++) {
+			ret = cache_op_add(&pending, &ops[i]);
+			if (ret)
+				break;
+		}
+		if (ret)
+			break;
+	}
+
+	/* Operations accepted before any error are still carried out */
+	cache_range_apply(&pending);
+	kfree(ops);
+
+	return ret;
+}
 #endif
 
 static long vc_sm_cma_ioctl(struct file *file, unsigned int cmd,
@@ -1424,6 +1649,14 @@ static long vc_sm_cma_ioctl(struct file *file, unsigned int cmd,
 	case VC_SM_CMA_CMD_CLEAN_INVALID2:
 		ret = vc_sm_cma_clean_invalid2(cmdnr, arg);
 		break;
+
+	/*
+	 * As CLEAN_INVALID2, but with the operations passed by pointer so that
+	 * any number of buffers can be handled in one call.
+	 */
+	case VC_SM_CMA_CMD_CLEAN_INVALID_VEC:
+		ret = vc_sm_cma_clean_invalid_vec(cmdnr, arg);
+		break;
 #endif
 
 	default:
@@ -23,6 +23,7 @@
 #include <linux/slab.h>
 #include <linux/completion.h>
 #include <linux/vmalloc.h>
+#include <linux/dma-buf.h>
 #include <media/videobuf2-vmalloc.h>
 
 #include "../include/linux/raspberrypi/vchiq.h"
@@ -55,6 +56,12 @@ MODULE_PARM_DESC(debug, "activates debug info (0-3)");
  */
 #define SYNC_MSG_TIMEOUT       3
 
+/*
+ * Imported dmabufs cached per port beyond the port's buffer count, as
+ * headroom for clients that rotate dmabufs between buffer indices.
+ */
+#define MMAL_DMABUF_CACHE_HEADROOM 4
+
 /*#define FULL_MSG_DUMP 1*/
 
 #ifdef DEBUG
@@ -128,14 +135,31 @@ static const char *const port_action_type_names[] = {
 
 struct vchiq_mmal_instance;
 
+/* a dmabuf imported into vc_sm_cma, cached against the port */
+struct mmal_dmabuf_entry {
+	struct list_head list;
+	struct dma_buf *dma_buf;
+	void *vcsm_handle;
+	u32 vc_handle;
+	/* number of buffers using this import that are with the VPU */
+	atomic_t users;
+};
+
+/* number of message contexts preallocated per instance */
+#define MMAL_MSG_CONTEXT_IDX_BITS 10
+#define MMAL_MAX_MSG_CONTEXTS BIT(MMAL_MSG_CONTEXT_IDX_BITS)
+#define MMAL_MSG_CONTEXT_GEN_MASK GENMASK(31 - MMAL_MSG_CONTEXT_IDX_BITS, 0)
+
 /* normal message context */
 struct mmal_msg_context {
 	struct vchiq_mmal_instance *instance;
 
-	/* Index in the context_map idr so that we can find the
-	 * mmal_msg_context again when servicing the VCHI reply.
+	/* Index in the context table plus a generation count so that we
+	 * can find the mmal_msg_context again when servicing the VCHI
+	 * reply, and reject replies for a context that has been reused.
 	 */
-	int handle;
+	u32 handle;
+	u32 generation;
 
 	union {
 		struct {
@@ -158,6 +182,8 @@ struct mmal_msg_context {
 			s64 dts;
 			/* MMAL buffer command flag */
 			u32 cmd;
+			/* cached dmabuf import in use, if any */
+			struct mmal_dmabuf_entry *dmabuf_entry;
 
 			int status;	/* context status */
 
@@ -183,9 +209,11 @@ struct vchiq_mmal_instance {
 	/* ensure serialised access to service */
 	struct mutex vchiq_mutex;
 
-	struct idr context_map;
-	/* protect accesses to context_map */
-	struct mutex context_map_lock;
+	/* preallocated message contexts, and which of them are in use */
+	struct mmal_msg_context *contexts;
+	DECLARE_BITMAP(context_map, MMAL_MAX_MSG_CONTEXTS);
+	/* where to start looking for a free context */
+	atomic_t context_hint;
 
 	struct vchiq_mmal_component component[VCHIQ_MMAL_MAX_COMPONENTS];
 
@@ -200,49 +228,71 @@ static struct mmal_msg_context *
 get_msg_context(struct vchiq_mmal_instance *instance)
 {
 	struct mmal_msg_context *msg_context;
-	int handle;
-
-	/* todo: should this be allocated from a pool to avoid kzalloc */
-	msg_context = kzalloc(sizeof(*msg_context), GFP_KERNEL);
-
-	if (!msg_context)
-		return ERR_PTR(-ENOMEM);
+	unsigned int start, idx;
 
-	/* Create an ID that will be passed along with our message so
-	 * that when we service the VCHI reply, we can look up what
-	 * message is being replied to.
+	/* Contexts come from a table allocated with the instance, claimed
+	 * with an atomic bit so that no lock is needed to submit a buffer
+	 * or send a message. Start the search after the last allocation
+	 * so a context is not immediately reused.
 	 */
-	mutex_lock(&instance->context_map_lock);
-	handle = idr_alloc(&instance->context_map, msg_context,
-			   0, 0, GFP_KERNEL);
-	mutex_unlock(&instance->context_map_lock);
-
-	if (handle < 0) {
-		kfree(msg_context);
-		return ERR_PTR(handle);
-	}
-
+	start = (unsigned int)atomic_inc_return(&instance->context_hint) %
+		MMAL_MAX_MSG_CONTEXTS;
+	idx = start;
+	do {
+		if (!test_and_set_bit_lock(idx, instance->context_map))
+			goto found;
+		idx = find_next_zero_bit(instance->context_map,
+					 MMAL_MAX_MSG_CONTEXTS, idx + 1);
+		if (idx >= MMAL_MAX_MSG_CONTEXTS)
+			idx = find_first_zero_bit(instance->context_map,
+						  MMAL_MAX_MSG_CONTEXTS);
+	} while (idx < MMAL_MAX_MSG_CONTEXTS && idx != start);
+
+	pr_err("%s: all %d message contexts in use\n", __func__,
+	       MMAL_MAX_MSG_CONTEXTS);
+	return ERR_PTR(-ENOMEM);
+
+found:
+	msg_context = &instance->contexts[idx];
+	memset(&msg_context->u, 0, sizeof(msg_context->u));
 	msg_context->instance = instance;
-	msg_context->handle = handle;
+
+	/* The handle is passed along with our message so that when we
+	 * service the VCHI reply, we can look up what message is being
+	 * replied to. It is never 0 as that means no context.
+	 */
+	msg_context->generation++;
+	if (!(msg_context->generation & MMAL_MSG_CONTEXT_GEN_MASK))
+		msg_context->generation = 1;
+	WRITE_ONCE(msg_context->handle,
+		   (msg_context->generation << MMAL_MSG_CONTEXT_IDX_BITS) |
+		   idx);
 
 	return msg_context;
 }
 
 static struct mmal_msg_context *
-lookup_msg_context(struct vchiq_mmal_instance *instance, int handle)
+lookup_msg_context(struct vchiq_mmal_instance *instance, u32 handle)
 {
-	return idr_find(&instance->context_map, handle);
+	struct mmal_msg_context *msg_context;
+	unsigned int idx = handle & (MMAL_MAX_MSG_CONTEXTS - 1);
+
+	msg_context = &instance->contexts[idx];
+	if (!test_bit(idx, instance->context_map) ||
+	    READ_ONCE(msg_context->handle) != handle)
+		return NULL;
+
+	return msg_context;
 }
 
 static void
 release_msg_context(struct mmal_msg_context *msg_context)
 {
 	struct vchiq_mmal_instance *instance = msg_context->instance;
+	unsigned int idx = msg_context - instance->contexts;
 
-	mutex_lock(&instance->context_map_lock);
-	idr_remove(&instance->context_map, msg_context->handle);
-	mutex_unlock(&instance->context_map_lock);
-	kfree(msg_context);
+	WRITE_ONCE(msg_context->handle, 0);
+	clear_bit_unlock(idx, instance->context_map);
 }
 
 /* workqueue scheduled callback
@@ -271,6 +321,11 @@ static void buffer_work_cb(struct work_struct *work)
 	if (!buffer->cmd)
 		atomic_dec(&msg_context->u.bulk.port->buffers_with_vpu);
 
+	if (msg_context->u.bulk.dmabuf_entry) {
+		atomic_dec(&msg_context->u.bulk.dmabuf_entry->users);
+		msg_context->u.bulk.dmabuf_entry = NULL;
+	}
+
 	msg_context->u.bulk.port->buffer_cb(msg_context->u.bulk.instance,
 					    msg_context->u.bulk.port,
 					    msg_context->u.bulk.status,
@@ -378,12 +433,161 @@ static int inline_receive(struct vchiq_mmal_instance *instance,
 	return 0;
 }
 
+static void free_dmabuf_entry(struct vchiq_mmal_port *port,
+			      struct mmal_dmabuf_entry *entry)
+{
+	list_del(&entry->list);
+	port->dmabuf_cache_count--;
+	vc_sm_cma_free(entry->vcsm_handle);
+	dma_buf_put(entry->dma_buf);
+	kfree(entry);
+}
+
+/*
+ * Look up, or import and add, the vc_sm_cma handle for a dmabuf. The cache
+ * holds its own reference on the dmabuf, so an entry stays valid even after
+ * the client has dropped the buffer. When the cache is full, the least
+ * recently used entry that is not with the VPU is evicted.
+ */
+static struct mmal_dmabuf_entry *
+port_dmabuf_cache_get(struct vchiq_mmal_port *port, struct dma_buf *dma_buf)
+{
+	struct mmal_dmabuf_entry *entry, *victim = NULL;
+	int ret;
+
+	mutex_lock(&port->dmabuf_cache_lock);
+
+	list_for_each_entry(entry, &port->dmabuf_cache, list) {
+		if (entry->dma_buf == dma_buf) {
+			list_move(&entry->list, &port->dmabuf_cache);
+			goto out;
+		}
+	}
+
+	if (port->dmabuf_cache_count >=
+	    port->current_buffer.num + MMAL_DMABUF_CACHE_HEADROOM) {
+		list_for_each_entry_reverse(entry, &port->dmabuf_cache, list) {
+			if (!atomic_read(&entry->users)) {
+				victim = entry;
+				break;
+			}
+		}
+		if (!victim) {
+			entry = NULL;
+			goto out;
+		}
+		free_dmabuf_entry(port, victim);
+	}
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		goto out;
+
+	ret = vc_sm_cma_import_dmabuf(dma_buf, &entry->vcsm_handle);
+	if (ret) {
+		pr_err("%s: vc_sm_import_dmabuf_fd failed, ret %d\n",
+		       __func__, ret);
+		kfree(entry);
+		entry = NULL;
+		goto out;
+	}
+
+	entry->vc_handle = vc_sm_cma_int_handle(entry->vcsm_handle);
+	if (!entry->vc_handle) {
+		pr_err("%s: vc_sm_int_handle failed\n", __func__);
+		vc_sm_cma_free(entry->vcsm_handle);
+		kfree(entry);
+		entry = NULL;
+		goto out;
+	}
+
+	get_dma_buf(dma_buf);
+	entry->dma_buf = dma_buf;
+	atomic_set(&entry->users, 0);
+	list_add(&entry->list, &port->dmabuf_cache);
+	port->dmabuf_cache_count++;
+
+	pr_dbg_lvl(2, debug, "%s: import dmabuf %p - got vc handle %08X\n",
+		   __func__, dma_buf, entry->vc_handle);
+
+out:
+	if (entry)
+		atomic_inc(&entry->users);
+	mutex_unlock(&port->dmabuf_cache_lock);
+
+	return entry;
+}
+
+static void init_port_dmabuf_cache(struct vchiq_mmal_port *port)
+{
+	INIT_LIST_HEAD(&port->dmabuf_cache);
+	port->dmabuf_cache_count = 0;
+	mutex_init(&port->dmabuf_cache_lock);
+}
+
+static void free_port_dmabuf_cache(struct vchiq_mmal_port *port)
+{
+	struct mmal_dmabuf_entry *entry, *next;
+
+	mutex_lock(&port->dmabuf_cache_lock);
+	list_for_each_entry_safe(entry, next, &port->dmabuf_cache, list) {
+		WARN_ON(atomic_read(&entry->users));
+		free_dmabuf_entry(port, entry);
+	}
+	mutex_unlock(&port->dmabuf_cache_lock);
+}
+
+/*
+ * Get the VC handle to pass for a zero copy dmabuf, preferring the port's
+ * import cache. If the cache is full of buffers that are with the VPU, fall
+ * back to importing against the buffer itself.
+ */
+static int port_import_dmabuf(struct vchiq_mmal_port *port,
+			      struct mmal_buffer *buf,
+			      struct mmal_dmabuf_entry **entry_out)
+{
+	struct mmal_dmabuf_entry *entry;
+	int ret;
+
+	*entry_out = NULL;
+
+	if (!port->zero_copy || !buf->dma_buf || buf->vcsm_handle)
+		return 0;
+
+	entry = port_dmabuf_cache_get(port, buf->dma_buf);
+	if (entry) {
+		buf->vc_handle = entry->vc_handle;
+		*entry_out = entry;
+		return 0;
+	}
+
+	pr_dbg_lvl(2, debug, "%s: import dmabuf %p\n",
+		   __func__, buf->dma_buf);
+	ret = vc_sm_cma_import_dmabuf(buf->dma_buf, &buf->vcsm_handle);
+	if (ret) {
+		pr_err("%s: vc_sm_import_dmabuf_fd failed, ret %d\n",
+		       __func__, ret);
+		return ret;
+	}
+
+	buf->vc_handle = vc_sm_cma_int_handle(buf->vcsm_handle);
+	if (!buf->vc_handle) {
+		pr_err("%s: vc_sm_int_handle failed\n", __func__);
+		vc_sm_cma_free(buf->vcsm_handle);
+		buf->vcsm_handle = NULL;
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 /* queue the buffer availability with MMAL_MSG_TYPE_BUFFER_FROM_HOST */
 static int
 buffer_from_host(struct vchiq_mmal_instance *instance,
 		 struct vchiq_mmal_port *port, struct mmal_buffer *buf)
 {
 	struct mmal_msg_context *msg_context;
+	struct mmal_dmabuf_entry *entry;
 	struct mmal_msg m;
 	int ret;
 
@@ -401,11 +605,16 @@ buffer_from_host(struct vchiq_mmal_instance *instance,
 	}
 	msg_context = buf->msg_context;
 
+	ret = port_import_dmabuf(port, buf, &entry);
+	if (ret)
+		return ret;
+
 	/* store bulk message context for when data arrives */
 	msg_context->u.bulk.instance = instance;
 	msg_context->u.bulk.port = port;
 	msg_context->u.bulk.buffer = buf;
 	msg_context->u.bulk.buffer_used = 0;
+	msg_context->u.bulk.dmabuf_entry = entry;
 
 	/* initialise work structure ready to schedule callback */
 	INIT_WORK(&msg_context->u.bulk.work, buffer_work_cb);
@@ -464,8 +673,13 @@ buffer_from_host(struct vchiq_mmal_instance *instance,
 	ret = vchiq_queue_kernel_message(instance->vchiq_instance, instance->service_handle, &m,
 					 sizeof(struct mmal_msg_header) +
 					 sizeof(m.u.buffer_from_host));
-	if (ret)
+	if (ret) {
 		atomic_dec(&port->buffers_with_vpu);
+		if (entry) {
+			atomic_dec(&entry->users);
+			msg_context->u.bulk.dmabuf_entry = NULL;
+		}
+	}
 
 	vchiq_release_service(instance->vchiq_instance, instance->service_handle);
 
@@ -1639,6 +1853,12 @@ int vchiq_mmal_port_disable(struct vchiq_mmal_instance *instance,
 
 	mutex_unlock(&instance->vchiq_mutex);
 
+	/*
+	 * Drop the imports that are not with the VPU, rather than holding
+	 * the client's dmabufs until it next streams on this port.
+	 */
+	vchiq_mmal_port_dmabuf_cache_prune(port, NULL, 0);
+
 	return ret;
 }
 EXPORT_SYMBOL_GPL(vchiq_mmal_port_disable);
@@ -1738,32 +1958,6 @@ int vchiq_mmal_submit_buffer(struct vchiq_mmal_instance *instance,
 	unsigned long flags = 0;
 	int ret;
 
-	/*
-	 * We really want to do this in mmal_vchi_buffer_init but can't as
-	 * videobuf2 won't let us have the dmabuf there.
-	 */
-	if (port->zero_copy && buffer->dma_buf && !buffer->vcsm_handle) {
-		pr_dbg_lvl(2, debug, "%s: import dmabuf %p\n",
-			   __func__, buffer->dma_buf);
-		ret = vc_sm_cma_import_dmabuf(buffer->dma_buf,
-					      &buffer->vcsm_handle);
-		if (ret) {
-			pr_err("%s: vc_sm_import_dmabuf_fd failed, ret %d\n",
-			       __func__, ret);
-			return ret;
-		}
-
-		buffer->vc_handle = vc_sm_cma_int_handle(buffer->vcsm_handle);
-		if (!buffer->vc_handle) {
-			pr_err("%s: vc_sm_int_handle failed %d\n",
-			       __func__, ret);
-			vc_sm_cma_free(buffer->vcsm_handle);
-			return ret;
-		}
-		pr_dbg_lvl(2, debug, "%s: import dmabuf %p - got vc handle %08X\n",
-			   __func__, buffer->dma_buf, buffer->vc_handle);
-	}
-
 	ret = buffer_from_host(instance, port, buffer);
 	if (ret == -EINVAL) {
 		/* Port is disabled. Queue for when it is enabled. */
@@ -1776,6 +1970,77 @@ int vchiq_mmal_submit_buffer(struct vchiq_mmal_instance *instance,
 }
 EXPORT_SYMBOL_GPL(vchiq_mmal_submit_buffer);
 
+/*
+ * Submit a set of buffers that make up one operation, in array order.
+ * The VCHIQ service is held across the whole set so the VPU does not see
+ * the service go idle between the individual messages.
+ *
+ * Returns the number of buffers submitted. If that is less than @num,
+ * sending the next buffer failed and it and all that follow it are still
+ * owned by the caller.
+ */
+unsigned int vchiq_mmal_submit_buffers(struct vchiq_mmal_instance *instance,
+				       struct vchiq_mmal_port * const *ports,
+				       struct mmal_buffer * const *bufs,
+				       unsigned int num)
+{
+	unsigned long flags;
+	unsigned int i;
+	int ret;
+
+	vchiq_use_service(instance->vchiq_instance, instance->service_handle);
+	for (i = 0; i < num; i++) {
+		ret = buffer_from_host(instance, ports[i], bufs[i]);
+		if (ret == -EINVAL) {
+			/* Port is disabled. Queue for when it is enabled. */
+			spin_lock_irqsave(&ports[i]->slock, flags);
+			list_add_tail(&bufs[i]->list, &ports[i]->buffers);
+			spin_unlock_irqrestore(&ports[i]->slock, flags);
+		} else if (ret) {
+			pr_err("%s: failed to submit buffer %u of %u: %d\n",
+			       __func__, i, num, ret);
+			break;
+		}
+	}
+	vchiq_release_service(instance->vchiq_instance,
+			      instance->service_handle);
+
+	return i;
+}
+EXPORT_SYMBOL_GPL(vchiq_mmal_submit_buffers);
+
+/*
+ * Drop the cached imports of a port that are not in the keep list and are
+ * not with the VPU, so that dmabufs the client has finished with are not
+ * held until they age out of the cache.
+ */
+void vchiq_mmal_port_dmabuf_cache_prune(struct vchiq_mmal_port *port,
+					struct dma_buf * const *keep,
+					unsigned int num_keep)
+{
+	struct mmal_dmabuf_entry *entry, *next;
+	unsigned int i;
+
+	mutex_lock(&port->dmabuf_cache_lock);
+	list_for_each_entry_safe(entry, next, &port->dmabuf_cache, list) {
+		if (atomic_read(&entry->users))
+			continue;
+
+		for (i = 0; i < num_keep; i++) {
+			if (keep[i] == entry->dma_buf)
+				break;
+		}
+		if (i < num_keep)
+			continue;
+
+		pr_dbg_lvl(2, debug, "%s: drop dmabuf %p, vc handle %08X\n",
+			   __func__, entry->dma_buf, entry->vc_handle);
+		free_dmabuf_entry(port, entry);
+	}
+	mutex_unlock(&port->dmabuf_cache_lock);
+}
+EXPORT_SYMBOL_GPL(vchiq_mmal_port_dmabuf_cache_prune);
+
 int mmal_vchi_buffer_init(struct vchiq_mmal_instance *instance,
 			  struct mmal_buffer *buf)
 {
@@ -1852,6 +2117,19 @@ static void free_event_context(struct vchiq_mmal_port *port)
 	port->event_context = NULL;
 }
 
+static void release_all_dmabuf_caches(struct vchiq_mmal_component *component)
+{
+	int idx;
+
+	for (idx = 0; idx < component->inputs; idx++)
+		free_port_dmabuf_cache(&component->input[idx]);
+	for (idx = 0; idx < component->outputs; idx++)
+		free_port_dmabuf_cache(&component->output[idx]);
+	for (idx = 0; idx < component->clocks; idx++)
+		free_port_dmabuf_cache(&component->clock[idx]);
+	free_port_dmabuf_cache(&component->control);
+}
+
 static void release_all_event_contexts(struct vchiq_mmal_component *component)
 {
 	int idx;
@@ -1910,6 +2188,7 @@ int vchiq_mmal_component_init(struct vchiq_mmal_instance *instance,
 	component->control.index = 0;
 	component->control.component = component;
 	spin_lock_init(&component->control.slock);
+	init_port_dmabuf_cache(&component->control);
 	INIT_LIST_HEAD(&component->control.buffers);
 	ret = port_info_get(instance, &component->control);
 	if (ret < 0)
@@ -1921,6 +2200,7 @@ int vchiq_mmal_component_init(struct vchiq_mmal_instance *instance,
 		component->input[idx].index = idx;
 		component->input[idx].component = component;
 		spin_lock_init(&component->input[idx].slock);
+		init_port_dmabuf_cache(&component->input[idx]);
 		INIT_LIST_HEAD(&component->input[idx].buffers);
 		ret = port_info_get(instance, &component->input[idx]);
 		if (ret < 0)
@@ -1933,6 +2213,7 @@ int vchiq_mmal_component_init(struct vchiq_mmal_instance *instance,
 		component->output[idx].index = idx;
 		component->output[idx].component = component;
 		spin_lock_init(&component->output[idx].slock);
+		init_port_dmabuf_cache(&component->output[idx]);
 		INIT_LIST_HEAD(&component->output[idx].buffers);
 		ret = port_info_get(instance, &component->output[idx]);
 		if (ret < 0)
@@ -1945,6 +2226,7 @@ int vchiq_mmal_component_init(struct vchiq_mmal_instance *instance,
 		component->clock[idx].index = idx;
 		component->clock[idx].component = component;
 		spin_lock_init(&component->clock[idx].slock);
+		init_port_dmabuf_cache(&component->clock[idx]);
 		INIT_LIST_HEAD(&component->clock[idx].buffers);
 		ret = port_info_get(instance, &component->clock[idx]);
 		if (ret < 0)
@@ -1961,6 +2243,7 @@ int vchiq_mmal_component_init(struct vchiq_mmal_instance *instance,
 release_component:
 	destroy_component(instance, component);
 	release_all_event_contexts(component);
+	release_all_dmabuf_caches(component);
 unlock:
 	if (component)
 		component->in_use = false;
@@ -1989,6 +2272,7 @@ int vchiq_mmal_component_finalise(struct vchiq_mmal_instance *instance,
 	component->in_use = false;
 
 	release_all_event_contexts(component);
+	release_all_dmabuf_caches(component);
 
 	mutex_unlock(&instance->vchiq_mutex);
 
@@ -2085,7 +2369,7 @@ int vchiq_mmal_finalise(struct vchiq_mmal_instance *instance)
 	vchiq_shutdown(instance->vchiq_instance);
 	destroy_workqueue(instance->bulk_wq);
 
-	idr_destroy(&instance->context_map);
+	kvfree(instance->contexts);
 
 	kfree(instance);
 
@@ -2146,8 +2430,12 @@ int vchiq_mmal_init(struct vchiq_mmal_instance **out_instance)
 
 	instance->vchiq_instance = vchiq_instance;
 
-	mutex_init(&instance->context_map_lock);
-	idr_init_base(&instance->context_map, 1);
+	instance->contexts = kvcalloc(MMAL_MAX_MSG_CONTEXTS,
+				      sizeof(*instance->contexts), GFP_KERNEL);
+	if (!instance->contexts) {
+		err = -ENOMEM;
+		goto err_free;
+	}
 
 	params.userdata = instance;
 
@@ -2174,6 +2462,7 @@ int vchiq_mmal_init(struct vchiq_mmal_instance **out_instance)
 	vchiq_close_service(instance->vchiq_instance, instance->service_handle);
 	destroy_workqueue(instance->bulk_wq);
 err_free:
+	kvfree(instance->contexts);
 	kfree(instance);
 err_shutdown_vchiq:
 	vchiq_shutdown(vchiq_instance);
@@ -25,6 +25,7 @@
 #define MMAL_FORMAT_EXTRADATA_MAX_SIZE 128
 
 struct vchiq_mmal_instance;
+struct dma_buf;
 
 enum vchiq_mmal_es_type {
 	MMAL_ES_TYPE_UNKNOWN,     /**< Unknown elementary stream type */
@@ -84,6 +85,12 @@ struct vchiq_mmal_port {
 	/* ensure serialised use of the one event context structure */
 	struct mutex event_context_mutex;
 	struct mmal_msg_context *event_context;
+
+	/* dmabufs imported into vc_sm_cma for zero copy, most recent first */
+	struct list_head dmabuf_cache;
+	unsigned int dmabuf_cache_count;
+	/* protect accesses to dmabuf_cache */
+	struct mutex dmabuf_cache_lock;
 };
 
 struct vchiq_mmal_component {
@@ -167,6 +174,15 @@ int vchiq_mmal_submit_buffer(struct vchiq_mmal_instance *instance,
 			     struct vchiq_mmal_port *port,
 			     struct mmal_buffer *buf);
 
+unsigned int vchiq_mmal_submit_buffers(struct vchiq_mmal_instance *instance,
+				       struct vchiq_mmal_port * const *ports,
+				       struct mmal_buffer * const *bufs,
+				       unsigned int num);
+
+void vchiq_mmal_port_dmabuf_cache_prune(struct vchiq_mmal_port *port,
+					struct dma_buf * const *keep,
+					unsigned int num_keep);
+
 int mmal_vchi_buffer_init(struct vchiq_mmal_instance *instance,
 			  struct mmal_buffer *buf);
 int mmal_vchi_buffer_cleanup(struct mmal_buffer *buf);
@@ -37,6 +37,7 @@
 #include <linux/delay.h>
 #include <linux/types.h>
 #include <linux/of.h>
+#include <linux/of_address.h>
 #include <linux/pinctrl/consumer.h>
 #include <linux/sizes.h>
 #include <linux/io.h>
@@ -252,6 +253,8 @@ struct pl011_dmarx_data {
 	bool auto_poll_rate;
 	unsigned int poll_rate;
 	unsigned int poll_timeout;
+	bool			cyclic;
+	unsigned int		ring_pos;
 };
 
 struct pl011_dmatx_data {
@@ -285,6 +288,8 @@ struct uart_amba_port {
 	struct pl011_dmarx_data dmarx;
 	struct pl011_dmatx_data	dmatx;
 	bool			dma_probed;
+	/* where the DMA controller sees the registers, if not at mapbase */
+	dma_addr_t		dma_mapbase;
 #endif
 };
 
@@ -381,15 +386,17 @@ static int pl011_fifo_to_tty(struct uart_amba_port *uap)
 #ifdef CONFIG_DMA_ENGINE
 
 #define PL011_DMA_BUFFER_SIZE PAGE_SIZE
+/* Cyclic RX: a ring of several periods, each completing with a callback */
+#define PL011_DMA_RING_SIZE (4 * PL011_DMA_BUFFER_SIZE)
 
 static int pl011_dmabuf_init(struct dma_chan *chan, struct pl011_dmabuf *db,
-	enum dma_data_direction dir)
+	size_t len, enum dma_data_direction dir)
 {
-	db->buf = dma_alloc_coherent(chan->device->dev, PL011_DMA_BUFFER_SIZE,
+	db->buf = dma_alloc_coherent(chan->device->dev, len,
 				     &db->dma, GFP_KERNEL);
 	if (!db->buf)
 		return -ENOMEM;
-	db->len = PL011_DMA_BUFFER_SIZE;
+	db->len = len;
 
 	return 0;
 }
@@ -399,18 +406,42 @@ static void pl011_dmabuf_free(struct dma_chan *chan, struct pl011_dmabuf *db,
 {
 	if (db->buf) {
 		dma_free_coherent(chan->device->dev,
-				  PL011_DMA_BUFFER_SIZE, db->buf, db->dma);
+				  db->len, db->buf, db->dma);
 	}
 }
 
+/*
+ * Behind a bridge such as RP1 the DMA controller addresses the registers
+ * by their bus address rather than by the CPU's view of them.
+ */
+static void pl011_dma_set_mapbase(struct uart_amba_port *uap,
+				  struct device_node *np)
+{
+	const __be32 *addr = of_get_address(np, 0, NULL, NULL);
+	u64 dma_addr;
+
+	if (!addr)
+		return;
+
+	dma_addr = of_translate_dma_address(np, addr);
+	if (dma_addr != OF_BAD_ADDR)
+		uap->dma_mapbase = dma_addr;
+}
+
+static dma_addr_t pl011_dma_dr_addr(struct uart_amba_port *uap)
+{
+	dma_addr_t base = uap->dma_mapbase ? : uap->port.mapbase;
+
+	return base + pl011_reg_to_offset(uap, REG_DR);
+}
+
 static void pl011_dma_probe(struct uart_amba_port *uap)
 {
 	/* DMA is the sole user of the platform data right now */
 	struct amba_pl011_data *plat = dev_get_platdata(uap->port.dev);
 	struct device *dev = uap->port.dev;
 	struct dma_slave_config tx_conf = {
-		.dst_addr = uap->port.mapbase +
-				 pl011_reg_to_offset(uap, REG_DR),
+		.dst_addr = pl011_dma_dr_addr(uap),
 		.dst_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
 		.direction = DMA_MEM_TO_DEV,
 		.dst_maxburst = uap->fifosize >> 1,
@@ -465,8 +496,7 @@ static void pl011_dma_probe(struct uart_amba_port *uap)
 
 	if (chan) {
 		struct dma_slave_config rx_conf = {
-			.src_addr = uap->port.mapbase +
-				pl011_reg_to_offset(uap, REG_DR),
+			.src_addr = pl011_dma_dr_addr(uap),
 			.src_addr_width = DMA_SLAVE_BUSWIDTH_1_BYTE,
 			.direction = DMA_DEV_TO_MEM,
 			.src_maxburst = uap->fifosize >> 2,
@@ -530,8 +560,22 @@ static void pl011_dma_probe(struct uart_amba_port *uap)
 					uap->dmarx.poll_timeout = 3000;
 			}
 		}
-		dev_info(uap->port.dev, "DMA channel RX %s\n",
-			 dma_chan_name(uap->dmarx.chan));
+
+		/*
+		 * Without polling, prefer one cyclic job over a ring buffer:
+		 * it never stops between buffers, so nothing piles up in the
+		 * FIFO while the next job is being set up at high baud rates.
+		 */
+		uap->dmarx.cyclic = !uap->dmarx.poll_rate &&
+			dma_has_cap(DMA_CYCLIC, chan->device->cap_mask) &&
+			!dma_get_slave_caps(chan, &caps) &&
+			caps.residue_granularity >=
+				DMA_RESIDUE_GRANULARITY_BURST &&
+			caps.cmd_pause;
+
+		dev_info(uap->port.dev, "DMA channel RX %s%s\n",
+			 dma_chan_name(uap->dmarx.chan),
+			 uap->dmarx.cyclic ? " (cyclic)" : "");
 	}
 }
 
@@ -831,6 +875,7 @@ __acquires(&uap->port.lock)
 }
 
 static void pl011_dma_rx_callback(void *data);
+static void pl011_dma_rx_cyclic_callback(void *data);
 
 static int pl011_dma_rx_trigger_dma(struct uart_amba_port *uap)
 {
@@ -845,9 +890,19 @@ static int pl011_dma_rx_trigger_dma(struct uart_amba_port *uap)
 	/* Start the RX DMA job */
 	dbuf = uap->dmarx.use_buf_b ?
 		&uap->dmarx.dbuf_b : &uap->dmarx.dbuf_a;
-	desc = dmaengine_prep_slave_single(rxchan, dbuf->dma, dbuf->len,
-					DMA_DEV_TO_MEM,
-					DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	if (dmarx->cyclic) {
+		/* The ring only ever lives in buffer A */
+		dbuf = &dmarx->dbuf_a;
+		dmarx->ring_pos = 0;
+		desc = dmaengine_prep_dma_cyclic(rxchan, dbuf->dma, dbuf->len,
+						 PL011_DMA_BUFFER_SIZE,
+						 DMA_DEV_TO_MEM,
+						 DMA_PREP_INTERRUPT);
+	} else {
+		desc = dmaengine_prep_slave_single(rxchan, dbuf->dma, dbuf->len,
+						DMA_DEV_TO_MEM,
+						DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+	}
 	/*
 	 * If the DMA engine is busy and cannot prepare a
 	 * channel, no big deal, the driver will fall back
@@ -860,7 +915,8 @@ static int pl011_dma_rx_trigger_dma(struct uart_amba_port *uap)
 	}
 
 	/* Some data to go along to the callback */
-	desc->callback = pl011_dma_rx_callback;
+	desc->callback = dmarx->cyclic ? pl011_dma_rx_cyclic_callback :
+					 pl011_dma_rx_callback;
 	desc->callback_param = uap;
 	dmarx->cookie = dmaengine_submit(desc);
 	dma_async_issue_pending(rxchan);
@@ -951,6 +1007,82 @@ static void pl011_dma_rx_chars(struct uart_amba_port *uap,
 	tty_flip_buffer_push(port);
 }
 
+/*
+ * Hand everything the cyclic job has written since the last call to the
+ * TTY layer, in at most two chunks either side of the ring's wrap point.
+ * This must be called with the port spinlock uap->port.lock held.
+ */
+static void pl011_dma_rx_ring_push(struct uart_amba_port *uap)
+{
+	struct tty_port *port = &uap->port.state->port;
+	struct pl011_dmarx_data *dmarx = &uap->dmarx;
+	struct pl011_dmabuf *dbuf = &dmarx->dbuf_a;
+	struct dma_tx_state state;
+	unsigned int pos, count, len;
+
+	dmaengine_tx_status(dmarx->chan, dmarx->cookie, &state);
+	if (state.residue > dbuf->len)
+		return;
+	pos = dbuf->len - state.residue;
+	if (pos == dbuf->len)
+		pos = 0;
+
+	while (dmarx->ring_pos != pos) {
+		len = (pos > dmarx->ring_pos ? pos : dbuf->len) -
+		      dmarx->ring_pos;
+		count = tty_insert_flip_string(port,
+					       dbuf->buf + dmarx->ring_pos,
+					       len);
+		uap->port.icount.rx += count;
+		if (count < len) {
+			uap->port.icount.buf_overrun += len - count;
+			dev_warn_ratelimited(uap->port.dev,
+					     "couldn't insert all characters (TTY is full?)\n");
+		}
+		/* Whatever did not fit is dropped, the ring moves on */
+		dmarx->ring_pos = (dmarx->ring_pos + len) % dbuf->len;
+	}
+}
+
+static void pl011_dma_rx_cyclic_callback(void *data)
+{
+	struct uart_amba_port *uap = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&uap->port.lock, flags);
+	pl011_dma_rx_ring_push(uap);
+	spin_unlock_irqrestore(&uap->port.lock, flags);
+
+	tty_flip_buffer_push(&uap->port.state->port);
+}
+
+/*
+ * The receive timeout fired: the line has gone idle with a few characters
+ * left below the DMA burst threshold. Stop the DMA long enough to take
+ * them from the FIFO in order, along with any error status.
+ */
+static void pl011_dma_rx_cyclic_irq(struct uart_amba_port *uap)
+{
+	struct dma_chan *rxchan = uap->dmarx.chan;
+	bool paused = !dmaengine_pause(rxchan);
+
+	/* Keep the UART from raising requests while the FIFO is drained */
+	pl011_write(uap->dmacr & ~UART011_RXDMAE, uap, REG_DMACR);
+
+	pl011_dma_rx_ring_push(uap);
+
+	/* Clear any error flags */
+	pl011_write(UART011_OEIS | UART011_BEIS | UART011_PEIS |
+		    UART011_FEIS, uap, REG_ICR);
+	pl011_fifo_to_tty(uap);
+
+	pl011_write(uap->dmacr, uap, REG_DMACR);
+	if (paused)
+		dmaengine_resume(rxchan);
+
+	tty_flip_buffer_push(&uap->port.state->port);
+}
+
 static void pl011_dma_rx_irq(struct uart_amba_port *uap)
 {
 	struct pl011_dmarx_data *dmarx = &uap->dmarx;
@@ -961,6 +1093,11 @@ static void pl011_dma_rx_irq(struct uart_amba_port *uap)
 	struct dma_tx_state state;
 	enum dma_status dmastat;
 
+	if (dmarx->cyclic) {
+		pl011_dma_rx_cyclic_irq(uap);
+		return;
+	}
+
 	/*
 	 * Pause the transfer so we can trust the current counter,
 	 * do this before we pause the PL011 block, else we may
@@ -1143,6 +1280,8 @@ static void pl011_dma_startup(struct uart_amba_port *uap)
 
 	/* Allocate and map DMA RX buffers */
 	ret = pl011_dmabuf_init(uap->dmarx.chan, &uap->dmarx.dbuf_a,
+			       uap->dmarx.cyclic ? PL011_DMA_RING_SIZE :
+						   PL011_DMA_BUFFER_SIZE,
 			       DMA_FROM_DEVICE);
 	if (ret) {
 		dev_err(uap->port.dev, "failed to init DMA %s: %d\n",
@@ -1150,8 +1289,11 @@ static void pl011_dma_startup(struct uart_amba_port *uap)
 		goto skip_rx;
 	}
 
+	if (uap->dmarx.cyclic)
+		goto rx_ready;
+
 	ret = pl011_dmabuf_init(uap->dmarx.chan, &uap->dmarx.dbuf_b,
-			       DMA_FROM_DEVICE);
+			       PL011_DMA_BUFFER_SIZE, DMA_FROM_DEVICE);
 	if (ret) {
 		dev_err(uap->port.dev, "failed to init DMA %s: %d\n",
 			"RX buffer B", ret);
@@ -1160,6 +1302,7 @@ static void pl011_dma_startup(struct uart_amba_port *uap)
 		goto skip_rx;
 	}
 
+rx_ready:
 	uap->using_rx_dma = true;
 
 skip_rx:
@@ -1242,6 +1385,11 @@ static inline bool pl011_dma_rx_running(struct uart_amba_port *uap)
 
 #else
 /* Blank functions if the DMA engine is not available */
+static inline void pl011_dma_set_mapbase(struct uart_amba_port *uap,
+					 struct device_node *np)
+{
+}
+
 static inline void pl011_dma_remove(struct uart_amba_port *uap)
 {
 }
@@ -3044,6 +3192,8 @@ static int pl011_axi_probe(struct platform_device *pdev)
 	if (ret)
 		return ret;
 
+	pl011_dma_set_mapbase(uap, pdev->dev.of_node);
+
 	platform_set_drvdata(pdev, uap);
 
 	return pl011_register_port(uap);
@@ -330,6 +330,7 @@ struct sc16is7xx_one {
 	struct kthread_delayed_work	ms_work;
 	struct sc16is7xx_one_config	config;
 	bool				irda_mode;
+	bool				active;	/* interrupts enabled */
 	unsigned int			old_mctrl;
 };
 
@@ -631,7 +632,7 @@ static void sc16is7xx_handle_tx(struct uart_port *port)
 {
 	struct sc16is7xx_port *s = dev_get_drvdata(port->dev);
 	struct circ_buf *xmit = &port->state->xmit;
-	unsigned int txlen, to_send, i;
+	unsigned int txlen, to_send, i, len;
 	unsigned long flags;
 
 	if (unlikely(port->x_char)) {
@@ -661,10 +662,13 @@ static void sc16is7xx_handle_tx(struct uart_port *port)
 		}
 		to_send = (to_send > txlen) ? txlen : to_send;
 
-		/* Convert to linear buffer */
-		for (i = 0; i < to_send; ++i) {
-			s->buf[i] = xmit->buf[xmit->tail];
-			uart_xmit_advance(port, 1);
+		/* Convert to linear buffer, in at most two pieces */
+		for (i = 0; i < to_send; i += len) {
+			len = min_t(unsigned int, to_send - i,
+				    CIRC_CNT_TO_END(xmit->head, xmit->tail,
+						    UART_XMIT_SIZE));
+			memcpy(s->buf + i, xmit->buf + xmit->tail, len);
+			uart_xmit_advance(port, len);
 		}
 
 		sc16is7xx_fifo_write(port, to_send);
@@ -795,8 +799,13 @@ static irqreturn_t sc16is7xx_irq(int irq, void *dev_id)
 
 		keep_polling = false;
 
+		/*
+		 * Every IIR poll is a bus transaction, don't spend them on
+		 * channels that are closed and cannot be interrupting.
+		 */
 		for (i = 0; i < s->devtype->nr_uart; ++i)
-			keep_polling |= sc16is7xx_port_irq(s, i);
+			if (READ_ONCE(s->p[i].active))
+				keep_polling |= sc16is7xx_port_irq(s, i);
 	} while (keep_polling);
 
 	return IRQ_HANDLED;
@@ -1188,7 +1197,12 @@ static int sc16is7xx_startup(struct uart_port *port)
 			      SC16IS7XX_EFCR_TXDISABLE_BIT,
 			      0);
 
-	/* Enable RX, CTS change and modem lines interrupts */
+	/*
+	 * Enable RX, CTS change and modem lines interrupts. The IRQ loop only
+	 * polls active ports, so mark the port first or an interrupt raised
+	 * straight away would never be serviced.
+	 */
+	WRITE_ONCE(one->active, true);
 	val = SC16IS7XX_IER_RDI_BIT | SC16IS7XX_IER_CTSI_BIT |
 	      SC16IS7XX_IER_MSI_BIT;
 	sc16is7xx_port_write(port, SC16IS7XX_IER_REG, val);
@@ -1213,6 +1227,7 @@ static void sc16is7xx_shutdown(struct uart_port *port)
 
 	/* Disable all interrupts */
 	sc16is7xx_port_write(port, SC16IS7XX_IER_REG, 0);
+	WRITE_ONCE(one->active, false);
 	/* Disable TX/RX */
 	sc16is7xx_port_update(port, SC16IS7XX_EFCR_REG,
 			      SC16IS7XX_EFCR_RXDISABLE_BIT |
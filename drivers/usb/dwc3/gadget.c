@@ -1996,6 +1996,15 @@ static int __dwc3_gadget_ep_queue(struct dwc3_ep *dep, struct dwc3_request *req)
 		}
 	}
 
+	/*
+	 * Requests queued from a completion handler are picked up by the
+	 * kick at the end of dwc3_gadget_endpoint_trbs_complete(), so that
+	 * all of them get their TRBs prepared with a single UPDATE_TRANSFER
+	 * instead of one doorbell per request.
+	 */
+	if (dep->flags & DWC3_EP_DEFER_KICK)
+		return 0;
+
 	__dwc3_gadget_kick_transfer(dep);
 
 	return 0;
@@ -3581,10 +3590,20 @@ static bool dwc3_gadget_endpoint_trbs_complete(struct dwc3_ep *dep,
 	struct dwc3		*dwc = dep->dwc;
 	bool			no_started_trb = true;
 
+	if ((dep->flags & DWC3_EP_TRANSFER_STARTED) && !dep->stream_capable &&
+	    dep->endpoint.desc && !usb_endpoint_xfer_isoc(dep->endpoint.desc))
+		dep->flags |= DWC3_EP_DEFER_KICK;
+
 	dwc3_gadget_ep_cleanup_completed_requests(dep, event, status);
 
-	if (dep->flags & DWC3_EP_END_TRANSFER_PENDING)
+	dep->flags &= ~DWC3_EP_DEFER_KICK;
+
+	if (dep->flags & DWC3_EP_END_TRANSFER_PENDING) {
+		/* Restart with whatever got queued once END_TRANSFER is done */
+		if (!list_empty(&dep->pending_list))
+			dep->flags |= DWC3_EP_DELAY_START;
 		goto out;
+	}
 
 	if (!dep->endpoint.desc)
 		return no_started_trb;
@@ -173,6 +173,7 @@
 #include <linux/dcache.h>
 #include <linux/delay.h>
 #include <linux/device.h>
+#include <linux/fadvise.h>
 #include <linux/fcntl.h>
 #include <linux/file.h>
 #include <linux/fs.h>
@@ -647,6 +648,15 @@ static int do_read(struct fsg_common *common)
 	if (unlikely(amount_left == 0))
 		return -EIO;		/* No default reply */
 
+	/*
+	 * Get the backing storage reading the whole command up front, so
+	 * the later buffers are (being) filled while the earlier ones are
+	 * still going out over USB.
+	 */
+	if (amount_left > FSG_BUFLEN)
+		vfs_fadvise(curlun->filp, file_offset, amount_left,
+			    POSIX_FADV_WILLNEED);
+
 	for (;;) {
 		/*
 		 * Figure out how much we need to read:
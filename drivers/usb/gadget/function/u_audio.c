@@ -13,6 +13,7 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
@@ -84,6 +85,13 @@ struct snd_uac_chip {
 	unsigned long long p_residue_mil;
 	unsigned int p_interval;
 	unsigned int p_framesize;
+
+	/* packet size schedule, recomputed when pitch or rate change */
+	unsigned int p_pitch;
+	unsigned int p_srate;
+	unsigned int p_frames;
+	unsigned long long p_frames_residue_mil;
+	unsigned long long p_interval_mil;
 };
 
 static const struct snd_pcm_hardware uac_pcm_hardware = {
@@ -146,6 +154,29 @@ static void u_audio_set_fback_frequency(enum usb_device_speed speed,
 	*(__le32 *)buf = cpu_to_le32(ff);
 }
 
+/*
+ * Split the pitched rate into whole frames per packet plus a residue, so
+ * the completion handler only has to accumulate the residue and add one
+ * frame whenever it exceeds a full frame.
+ */
+static void u_audio_update_p_schedule(struct snd_uac_chip *uac,
+				      struct uac_rtd_params *prm)
+{
+	unsigned long long pitched_rate_mil;
+
+	uac->p_pitch = prm->pitch;
+	uac->p_srate = prm->srate;
+	uac->p_interval_mil = uac->p_interval * 1000000ULL;
+
+	pitched_rate_mil = (unsigned long long) prm->srate * prm->pitch;
+	uac->p_frames = div64_u64_rem(pitched_rate_mil, uac->p_interval_mil,
+				      &uac->p_frames_residue_mil);
+
+	pr_debug("p_srate %d, pitch %d, interval_mil %llu, frames %d\n",
+			prm->srate, prm->pitch, uac->p_interval_mil,
+			uac->p_frames);
+}
+
 static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	unsigned int pending;
@@ -155,9 +186,7 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 	struct snd_pcm_runtime *runtime;
 	struct uac_rtd_params *prm = req->context;
 	struct snd_uac_chip *uac = prm->uac;
-	unsigned int frames, p_pktsize;
-	unsigned long long pitched_rate_mil, p_pktsize_residue_mil,
-			residue_frames_mil, div_result;
+	unsigned int p_pktsize;
 
 	/* i/f shutting down */
 	if (!prm->ep_enabled) {
@@ -197,42 +226,27 @@ static void u_audio_iso_complete(struct usb_ep *ep, struct usb_request *req)
 		 * If there is a residue from this division, add it to the
 		 * residue accumulator.
 		 */
-		unsigned long long p_interval_mil = uac->p_interval * 1000000ULL;
-
-		pitched_rate_mil = (unsigned long long) prm->srate * prm->pitch;
-		div_result = pitched_rate_mil;
-		do_div(div_result, uac->p_interval);
-		do_div(div_result, 1000000);
-		frames = (unsigned int) div_result;
-
-		pr_debug("p_srate %d, pitch %d, interval_mil %llu, frames %d\n",
-				prm->srate, prm->pitch, p_interval_mil, frames);
+		if (uac->p_pitch != prm->pitch || uac->p_srate != prm->srate)
+			u_audio_update_p_schedule(uac, prm);
 
 		p_pktsize = min_t(unsigned int,
-					uac->p_framesize * frames,
+					uac->p_framesize * uac->p_frames,
 					ep->maxpacket);
-
-		if (p_pktsize < ep->maxpacket) {
-			residue_frames_mil = pitched_rate_mil - frames * p_interval_mil;
-			p_pktsize_residue_mil = uac->p_framesize * residue_frames_mil;
-		} else
-			p_pktsize_residue_mil = 0;
-
 		req->length = p_pktsize;
-		uac->p_residue_mil += p_pktsize_residue_mil;
 
 		/*
-		 * Whenever there are more bytes in the accumulator p_residue_mil than we
-		 * need to add one more sample frame, increase this packet's
-		 * size and decrease the accumulator.
+		 * Whenever the accumulator holds a whole frame, increase
+		 * this packet's size by one frame and decrease the
+		 * accumulator.
 		 */
-		div_result = uac->p_residue_mil;
-		do_div(div_result, uac->p_interval);
-		do_div(div_result, 1000000);
-		if ((unsigned int) div_result >= uac->p_framesize) {
-			req->length += uac->p_framesize;
-			uac->p_residue_mil -= uac->p_framesize * p_interval_mil;
-			pr_debug("increased req length to %d\n", req->length);
+		if (p_pktsize < ep->maxpacket) {
+			uac->p_residue_mil += uac->p_frames_residue_mil;
+			if (uac->p_residue_mil >= uac->p_interval_mil) {
+				req->length += uac->p_framesize;
+				uac->p_residue_mil -= uac->p_interval_mil;
+				pr_debug("increased req length to %d\n",
+					 req->length);
+			}
 		}
 		pr_debug("remains uac->p_residue_mil %llu\n", uac->p_residue_mil);
 
@@ -719,6 +733,7 @@ int u_audio_start_playback(struct g_audio *audio_dev)
 
 	req_len = p_pktsize;
 	uac->p_residue_mil = 0;
+	u_audio_update_p_schedule(uac, prm);
 
 	prm->ep_enabled = true;
 	usb_ep_enable(ep);
@@ -66,6 +66,7 @@ struct eth_dev {
 	atomic_t		tx_qlen;
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
 
 	unsigned		qmult;
 
@@ -91,6 +92,8 @@ struct eth_dev {
 
 #define RX_EXTRA	20	/* bytes guarding against rx overflows */
 
+#define RX_FRAMES_MAX	1000	/* frames waiting for the NAPI poll */
+
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
 /* use deeper queues at high/super speed */
@@ -218,58 +221,116 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	return retval;
 }
 
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work_done = 0;
+
+	while (work_done < budget) {
+		skb = skb_dequeue(&dev->rx_frames);
+		if (!skb)
+			break;
+		work_done++;
+
+		if (ETH_HLEN > skb->len
+				|| skb->len > GETHER_MAX_ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb_any(skb);
+			continue;
+		}
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		/* no buffer copies needed, unless hardware can't
+		 * use skb buffers.
+		 */
+		napi_gro_receive(napi, skb);
+	}
+
+	if (work_done < budget)
+		napi_complete_done(napi, work_done);
+
+	return work_done;
+}
+
+/* Some UDCs complete OUT requests from a thread rather than from their
+ * interrupt handler. There, bottom halves have to be disabled around
+ * napi_schedule() so that the softirq it raises runs when they are
+ * enabled again, instead of waiting for the next interrupt to come by.
+ */
+static void eth_napi_schedule(struct eth_dev *dev)
+{
+	if (in_hardirq() || irqs_disabled()) {
+		napi_schedule(&dev->napi);
+		return;
+	}
+
+	local_bh_disable();
+	napi_schedule(&dev->napi);
+	local_bh_enable();
+}
+
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb = req->context, *skb2;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
+	struct sk_buff_head frames;
+	unsigned long	flags;
 
 	switch (status) {
 
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
+		skb_queue_head_init(&frames);
 
 		if (dev->unwrap) {
-			unsigned long	flags;
-
 			spin_lock_irqsave(&dev->lock, flags);
 			if (dev->port_usb) {
 				status = dev->unwrap(dev->port_usb,
 							skb,
-							&dev->rx_frames);
+							&frames);
 			} else {
 				dev_kfree_skb_any(skb);
 				status = -ENOTCONN;
 			}
 			spin_unlock_irqrestore(&dev->lock, flags);
 		} else {
-			skb_queue_tail(&dev->rx_frames, skb);
+			__skb_queue_tail(&frames, skb);
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > GETHER_MAX_ETH_FRAME_LEN) {
+		if (status < 0) {
+			while ((skb2 = __skb_dequeue(&frames))) {
 				dev->net->stats.rx_errors++;
 				dev->net->stats.rx_length_errors++;
 				DBG(dev, "rx length %d\n", skb2->len);
 				dev_kfree_skb_any(skb2);
-				goto next_frame;
 			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
+			break;
+		}
 
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
+		/* hand the frames over to the NAPI poll, which batches
+		 * them into the stack and lets GRO coalesce them. At most
+		 * RX_FRAMES_MAX wait for it, the rest are dropped.
+		 */
+		spin_lock_irqsave(&dev->rx_frames.lock, flags);
+		while (netif_running(dev->net)
+				&& skb_queue_len(&dev->rx_frames) < RX_FRAMES_MAX
+				&& (skb2 = __skb_dequeue(&frames)))
+			__skb_queue_tail(&dev->rx_frames, skb2);
+		spin_unlock_irqrestore(&dev->rx_frames.lock, flags);
+
+		while ((skb2 = __skb_dequeue(&frames))) {
+			dev->net->stats.rx_dropped++;
+			dev_kfree_skb_any(skb2);
 		}
+		eth_napi_schedule(dev);
 		break;
 
 	/* software-driven interface shutdown */
@@ -617,6 +678,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -675,6 +737,9 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -757,6 +822,7 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	netif_napi_add(net, &dev->napi, eth_poll);
 
 	/* network device setup */
 	dev->net = net;
@@ -828,6 +894,7 @@ struct net_device *gether_setup_name_default(const char *netname)
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	netif_napi_add(net, &dev->napi, eth_poll);
 
 	/* network device setup */
 	dev->net = net;
@@ -1091,6 +1158,7 @@ void gether_cleanup(struct eth_dev *dev)
 
 	unregister_netdev(dev->net);
 	flush_work(&dev->work);
+	skb_queue_purge(&dev->rx_frames);
 	free_netdev(dev->net);
 }
 EXPORT_SYMBOL_GPL(gether_cleanup);
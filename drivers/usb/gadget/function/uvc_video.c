@@ -337,9 +337,16 @@ uvc_video_alloc_requests(struct uvc_video *video)
 		return -ENOMEM;
 
 	for (i = 0; i < video->uvc_num_requests; ++i) {
-		video->ureq[i].req_buffer = kmalloc(req_size, GFP_KERNEL);
-		if (video->ureq[i].req_buffer == NULL)
-			goto error;
+		/*
+		 * The isochronous scatter-gather encoder points the request
+		 * straight at the video buffer pages, only the copying
+		 * encoders need a bounce buffer.
+		 */
+		if (!video->queue.use_sg || video->max_payload_size) {
+			video->ureq[i].req_buffer = kmalloc(req_size, GFP_KERNEL);
+			if (video->ureq[i].req_buffer == NULL)
+				goto error;
+		}
 
 		video->ureq[i].req = usb_ep_alloc_request(video->ep, GFP_KERNEL);
 		if (video->ureq[i].req == NULL)
@@ -523,6 +530,10 @@ int uvcg_video_enable(struct uvc_video *video, int enable)
 		video->encode = video->queue.use_sg ?
 			uvc_video_encode_isoc_sg : uvc_video_encode_isoc;
 
+	uvcg_dbg(&video->uvc->func, "streaming with %s payload encoding\n",
+		 video->encode == uvc_video_encode_isoc_sg ?
+		 "zero-copy scatter-gather" : "copying");
+
 	video->req_int_count = 0;
 
 	queue_work(video->async_wq, &video->pump);
@@ -403,6 +403,71 @@ static const struct file_operations port_fops = {
 	.release		= single_release,
 };
 
+static int xhci_imod_interval_show(struct seq_file *s, void *unused)
+{
+	struct xhci_hcd		*xhci = s->private;
+
+	seq_printf(s, "%u\n", xhci->imod_interval);
+
+	return 0;
+}
+
+static int xhci_imod_interval_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, xhci_imod_interval_show, inode->i_private);
+}
+
+/*
+ * Change the primary interrupter's moderation interval (in ns, rounded down
+ * to the 250ns units of the IMOD register) while the host is running, to
+ * trade interrupt rate against latency for the devices attached.
+ */
+static ssize_t xhci_imod_interval_write(struct file *file,
+					const char __user *ubuf,
+					size_t count, loff_t *ppos)
+{
+	struct seq_file		*s = file->private_data;
+	struct xhci_hcd		*xhci = s->private;
+	struct xhci_interrupter	*ir = xhci->interrupter;
+	struct usb_hcd		*hcd = xhci_to_hcd(xhci);
+	unsigned long		flags;
+	unsigned int		interval;
+	u32			temp;
+	int			ret;
+
+	ret = kstrtouint_from_user(ubuf, count, 0, &interval);
+	if (ret)
+		return ret;
+
+	if (interval / 250 > ER_IRQ_INTERVAL_MASK)
+		return -EINVAL;
+
+	spin_lock_irqsave(&xhci->lock, flags);
+	xhci->imod_interval = interval;
+	if (ir) {
+		/* Also patch what a resume will restore */
+		ir->s3_irq_control &= ~ER_IRQ_INTERVAL_MASK;
+		ir->s3_irq_control |= interval / 250;
+		if (HCD_HW_ACCESSIBLE(hcd)) {
+			temp = readl(&ir->ir_set->irq_control);
+			temp &= ~ER_IRQ_INTERVAL_MASK;
+			temp |= interval / 250;
+			writel(temp, &ir->ir_set->irq_control);
+		}
+	}
+	spin_unlock_irqrestore(&xhci->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations imod_interval_fops = {
+	.open			= xhci_imod_interval_open,
+	.write			= xhci_imod_interval_write,
+	.read			= seq_read,
+	.llseek			= seq_lseek,
+	.release		= single_release,
+};
+
 static void xhci_debugfs_create_files(struct xhci_hcd *xhci,
 				      struct xhci_file_map *files,
 				      size_t nentries, void *data,
@@ -697,6 +762,9 @@ void xhci_debugfs_init(struct xhci_hcd *xhci)
 				     "event-ring",
 				     xhci->debugfs_root);
 
+	debugfs_create_file("imod_interval", 0644, xhci->debugfs_root, xhci,
+			    &imod_interval_fops);
+
 	xhci->debugfs_slots = debugfs_create_dir("devices", xhci->debugfs_root);
 
 	xhci_debugfs_create_ports(xhci, xhci->debugfs_root);
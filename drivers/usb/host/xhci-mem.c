@@ -408,11 +408,128 @@ struct xhci_ring *xhci_ring_alloc(struct xhci_hcd *xhci,
 	return NULL;
 }
 
+/*
+ * Endpoint rings are freed and allocated again every time an interface changes
+ * alt setting or a device is reset, so keep a few around for reuse instead of
+ * going back to the DMA pool each time. A ring that was expanded while in use
+ * stays expanded, so an endpoint that reuses it starts out at the queue depth
+ * that was needed last time rather than having to grow again.
+ */
+static bool xhci_ring_cacheable(struct xhci_ring *ring)
+{
+	switch (ring->type) {
+	case TYPE_CTRL:
+	case TYPE_ISOC:
+	case TYPE_BULK:
+	case TYPE_INTR:
+		return ring->first_seg &&
+		       ring->num_segs <= XHCI_RING_CACHE_MAX_SEGS;
+	default:
+		return false;
+	}
+}
+
+/* Give a ring to the cache, or free it if it can't be kept. */
+void xhci_ring_cache_put(struct xhci_hcd *xhci, struct xhci_ring *ring)
+{
+	unsigned long flags;
+
+	if (!ring)
+		return;
+
+	if (xhci_ring_cacheable(ring)) {
+		spin_lock_irqsave(&xhci->ring_cache_lock, flags);
+		if (xhci->ring_cache_count < XHCI_RING_CACHE_SIZE) {
+			xhci->ring_cache[xhci->ring_cache_count++] = ring;
+			ring = NULL;
+		}
+		spin_unlock_irqrestore(&xhci->ring_cache_lock, flags);
+	}
+
+	xhci_ring_free(xhci, ring);
+}
+
+/* Reset a cached ring's TRBs and state to those of a newly allocated one. */
+static void xhci_reinit_cached_ring(struct xhci_hcd *xhci,
+				    struct xhci_ring *ring)
+{
+	struct xhci_segment *first = ring->first_seg;
+	struct xhci_segment *last = ring->last_seg;
+	unsigned int num_segs = ring->num_segs;
+	unsigned int bounce_buf_len = ring->bounce_buf_len;
+	enum xhci_ring_type type = ring->type;
+	struct xhci_segment *seg = first;
+	bool chain_links;
+
+	chain_links = !!(xhci_link_trb_quirk(xhci) ||
+			 (type == TYPE_ISOC &&
+			  (xhci->quirks & XHCI_AMD_0x96_HOST)));
+
+	do {
+		memset(seg->trbs, 0, TRB_SEGMENT_SIZE);
+		xhci_link_segments(seg, seg->next, type, chain_links);
+		seg = seg->next;
+	} while (seg != first);
+	last->trbs[TRBS_PER_SEGMENT - 1].link.control |=
+		cpu_to_le32(LINK_TOGGLE);
+
+	memset(ring, 0, sizeof(*ring));
+	ring->first_seg = first;
+	ring->last_seg = last;
+	ring->num_segs = num_segs;
+	ring->bounce_buf_len = bounce_buf_len;
+	ring->type = type;
+	INIT_LIST_HEAD(&ring->td_list);
+	xhci_initialize_ring_info(ring, 1);
+}
+
+/*
+ * Take the largest cached ring of the given type and bounce buffer size, or
+ * return NULL if there isn't one.
+ */
+static struct xhci_ring *xhci_ring_cache_get(struct xhci_hcd *xhci,
+					     enum xhci_ring_type type,
+					     unsigned int max_packet)
+{
+	struct xhci_ring *ring = NULL;
+	unsigned long flags;
+	unsigned int i, best = 0;
+
+	spin_lock_irqsave(&xhci->ring_cache_lock, flags);
+	for (i = 0; i < xhci->ring_cache_count; i++) {
+		struct xhci_ring *r = xhci->ring_cache[i];
+
+		if (r->type != type || r->bounce_buf_len != max_packet)
+			continue;
+		if (!ring || r->num_segs > ring->num_segs) {
+			ring = r;
+			best = i;
+		}
+	}
+	if (ring)
+		xhci->ring_cache[best] =
+			xhci->ring_cache[--xhci->ring_cache_count];
+	spin_unlock_irqrestore(&xhci->ring_cache_lock, flags);
+
+	if (ring) {
+		xhci_reinit_cached_ring(xhci, ring);
+		trace_xhci_ring_alloc(ring);
+	}
+
+	return ring;
+}
+
+static void xhci_ring_cache_drain(struct xhci_hcd *xhci)
+{
+	while (xhci->ring_cache_count)
+		xhci_ring_free(xhci, xhci->ring_cache[--xhci->ring_cache_count]);
+}
+
 void xhci_free_endpoint_ring(struct xhci_hcd *xhci,
 		struct xhci_virt_device *virt_dev,
 		unsigned int ep_index)
 {
-	xhci_ring_free(xhci, virt_dev->eps[ep_index].ring);
+	xhci_ring_cache_put(xhci, virt_dev->eps[ep_index].ring);
 	virt_dev->eps[ep_index].ring = NULL;
 }
 
@@ -1495,7 +1612,11 @@ int xhci_endpoint_init(struct xhci_hcd *xhci,
 
 	/* Set up the endpoint ring */
 	virt_dev->eps[ep_index].new_ring =
-		xhci_ring_alloc(xhci, 2, 1, ring_type, max_packet, mem_flags);
+		xhci_ring_cache_get(xhci, ring_type, max_packet);
+	if (!virt_dev->eps[ep_index].new_ring)
+		virt_dev->eps[ep_index].new_ring =
+			xhci_ring_alloc(xhci, 2, 1, ring_type, max_packet,
+					mem_flags);
 	if (!virt_dev->eps[ep_index].new_ring)
 		return -ENOMEM;
 
@@ -1896,6 +2017,8 @@ void xhci_mem_cleanup(struct xhci_hcd *xhci)
 	for (i = HCS_MAX_SLOTS(xhci->hcs_params1); i > 0; i--)
 		xhci_free_virt_devices_depth_first(xhci, i);
 
+	xhci_ring_cache_drain(xhci);
+
 	dma_pool_destroy(xhci->segment_pool);
 	xhci->segment_pool = NULL;
 	xhci_dbg_trace(xhci, trace_xhci_dbg_init, "Freed segment pool");
@@ -2393,6 +2516,8 @@ int xhci_mem_init(struct xhci_hcd *xhci, gfp_t flags)
 	 * and our use of dma addresses in the trb_address_map radix tree needs
 	 * TRB_SEGMENT_SIZE alignment, so we pick the greater alignment need.
 	 */
+	spin_lock_init(&xhci->ring_cache_lock);
+
 	if (xhci->quirks & XHCI_ZHAOXIN_TRB_FETCH)
 		xhci->segment_pool = dma_pool_create("xHCI ring segments", dev,
 				TRB_SEGMENT_SIZE * 2, TRB_SEGMENT_SIZE * 2, xhci->page_size * 2);
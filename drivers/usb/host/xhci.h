@@ -1830,6 +1830,13 @@ struct xhci_hcd {
 	struct dma_pool	*small_streams_pool;
 	struct dma_pool	*medium_streams_pool;
 
+	/* Endpoint rings kept for reuse, see xhci_ring_cache_put() */
+#define XHCI_RING_CACHE_SIZE		8
+#define XHCI_RING_CACHE_MAX_SEGS	16
+	spinlock_t		ring_cache_lock;
+	struct xhci_ring	*ring_cache[XHCI_RING_CACHE_SIZE];
+	unsigned int		ring_cache_count;
+
 	/* Host controller watchdog timer structures */
 	unsigned int		xhc_state;
 	unsigned long		run_graceperiod;
@@ -2083,6 +2090,7 @@ struct xhci_ring *xhci_ring_alloc(struct xhci_hcd *xhci,
 		unsigned int num_segs, unsigned int cycle_state,
 		enum xhci_ring_type type, unsigned int max_packet, gfp_t flags);
 void xhci_ring_free(struct xhci_hcd *xhci, struct xhci_ring *ring);
+void xhci_ring_cache_put(struct xhci_hcd *xhci, struct xhci_ring *ring);
 int xhci_ring_expansion(struct xhci_hcd *xhci, struct xhci_ring *ring,
 		unsigned int num_trbs, gfp_t flags);
 int xhci_alloc_erst(struct xhci_hcd *xhci,
@@ -0,0 +1,319 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * w1-uart - UART 1-Wire bus master driver
+ *
+ * The 1-Wire time slots are generated by the UART itself: the RX and TX
+ * lines are wired together onto the bus through an open-drain buffer, and
+ * every character sent produces one slot whose echo is the sampled level.
+ *
+ * - reset: send 0xf0 at 9600 baud, a presence pulse corrupts the echo
+ * - write-0 / write-1 / read: send 0x00 or 0xff at 115200 baud, a slave
+ *   pulling the line low during a read turns the echoed 0xff into
+ *   something else
+ *
+ * Byte and block transfers send all their slots in one write and wait
+ * once for the echo, so the CPU sleeps for the duration of the transfer
+ * instead of timing each bit with udelay().
+ */
+
+#include <linux/completion.h>
+#include <linux/jiffies.h>
+#include <linux/math.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/serdev.h>
+#include <linux/string.h>
+
+#include <linux/w1.h>
+
+#define W1_UART_RESET_BAUD	9600
+#define W1_UART_BIT_BAUD	115200
+
+#define W1_UART_RESET_BYTE	0xf0
+#define W1_UART_WRITE_0		0x00
+#define W1_UART_WRITE_1		0xff
+
+/* 1-Wire bytes per UART transfer, each takes eight UART characters */
+#define W1_UART_MAX_BYTES	16
+#define W1_UART_BUF_SIZE	(W1_UART_MAX_BYTES * 8)
+
+#define W1_UART_TIMEOUT		msecs_to_jiffies(500)
+
+struct w1_uart_device {
+	struct serdev_device *serdev;
+	struct w1_bus_master bus;
+
+	/* serialises transfers against the receive callback */
+	struct mutex rx_mutex;
+	struct completion rx_done;
+
+	unsigned int baud;
+	size_t rx_len;
+	size_t rx_expected;
+
+	u8 tx_buf[W1_UART_BUF_SIZE];
+	u8 rx_buf[W1_UART_BUF_SIZE];
+};
+
+static int w1_uart_set_baud(struct w1_uart_device *wdev, unsigned int baud)
+{
+	unsigned int actual;
+
+	if (wdev->baud == baud)
+		return 0;
+
+	actual = serdev_device_set_baudrate(wdev->serdev, baud);
+	/* The slot timings tolerate a few percent of baud rate error */
+	if (abs_diff(actual, baud) > baud / 20) {
+		dev_err(&wdev->serdev->dev, "baud rate %u not supported (got %u)\n",
+			baud, actual);
+		wdev->baud = 0;
+		return -EINVAL;
+	}
+
+	wdev->baud = baud;
+
+	return 0;
+}
+
+/*
+ * Send @len characters from tx_buf at @baud and wait until all of their
+ * echoes have arrived in rx_buf.
+ */
+static int w1_uart_xfer(struct w1_uart_device *wdev, unsigned int baud,
+			size_t len)
+{
+	int ret;
+
+	ret = w1_uart_set_baud(wdev, baud);
+	if (ret)
+		return ret;
+
+	mutex_lock(&wdev->rx_mutex);
+	wdev->rx_len = 0;
+	wdev->rx_expected = len;
+	reinit_completion(&wdev->rx_done);
+	mutex_unlock(&wdev->rx_mutex);
+
+	ret = serdev_device_write(wdev->serdev, wdev->tx_buf, len,
+				  W1_UART_TIMEOUT);
+	if (ret < 0)
+		goto out;
+
+	if (!wait_for_completion_timeout(&wdev->rx_done, W1_UART_TIMEOUT)) {
+		dev_dbg(&wdev->serdev->dev, "echo timeout (%zu of %zu)\n",
+			wdev->rx_len, len);
+		ret = -ETIMEDOUT;
+		goto out;
+	}
+
+	ret = 0;
+out:
+	mutex_lock(&wdev->rx_mutex);
+	wdev->rx_expected = 0;
+	mutex_unlock(&wdev->rx_mutex);
+
+	return ret;
+}
+
+static int w1_uart_receive_buf(struct serdev_device *serdev,
+			       const unsigned char *buf, size_t count)
+{
+	struct w1_uart_device *wdev = serdev_device_get_drvdata(serdev);
+	size_t n;
+
+	mutex_lock(&wdev->rx_mutex);
+
+	/* Anything outside a transfer is line noise and is dropped */
+	if (wdev->rx_len < wdev->rx_expected) {
+		n = min(count, wdev->rx_expected - wdev->rx_len);
+		memcpy(wdev->rx_buf + wdev->rx_len, buf, n);
+		wdev->rx_len += n;
+
+		if (wdev->rx_len == wdev->rx_expected)
+			complete(&wdev->rx_done);
+	}
+
+	mutex_unlock(&wdev->rx_mutex);
+
+	return count;
+}
+
+static const struct serdev_device_ops w1_uart_serdev_ops = {
+	.receive_buf	= w1_uart_receive_buf,
+	.write_wakeup	= serdev_device_write_wakeup,
+};
+
+/**
+ * w1_uart_reset_bus() - Generate a reset and presence detect cycle
+ * @data: the w1_uart_device
+ *
+ * Return: 0 if a device answered with a presence pulse, 1 otherwise.
+ */
+static u8 w1_uart_reset_bus(void *data)
+{
+	struct w1_uart_device *wdev = data;
+
+	wdev->tx_buf[0] = W1_UART_RESET_BYTE;
+	if (w1_uart_xfer(wdev, W1_UART_RESET_BAUD, 1))
+		return 1;
+
+	return wdev->rx_buf[0] == W1_UART_RESET_BYTE;
+}
+
+static u8 w1_uart_touch_bit(void *data, u8 bit)
+{
+	struct w1_uart_device *wdev = data;
+
+	wdev->tx_buf[0] = bit ? W1_UART_WRITE_1 : W1_UART_WRITE_0;
+	if (w1_uart_xfer(wdev, W1_UART_BIT_BAUD, 1))
+		return 1;
+
+	return wdev->rx_buf[0] == W1_UART_WRITE_1;
+}
+
+/*
+ * Run up to W1_UART_MAX_BYTES 1-Wire bytes through the bus in a single
+ * transfer, LSB first. @out may be NULL to read (all write-1 slots), @in
+ * may be NULL to discard what was sampled.
+ */
+static int w1_uart_touch_bytes(struct w1_uart_device *wdev, const u8 *out,
+			       u8 *in, int len)
+{
+	int i, b, ret;
+
+	for (i = 0; i < len; i++)
+		for (b = 0; b < 8; b++)
+			wdev->tx_buf[i * 8 + b] =
+				(!out || (out[i] & BIT(b))) ?
+				W1_UART_WRITE_1 : W1_UART_WRITE_0;
+
+	ret = w1_uart_xfer(wdev, W1_UART_BIT_BAUD, len * 8);
+	if (ret)
+		return ret;
+
+	if (!in)
+		return 0;
+
+	for (i = 0; i < len; i++) {
+		in[i] = 0;
+		for (b = 0; b < 8; b++)
+			if (wdev->rx_buf[i * 8 + b] == W1_UART_WRITE_1)
+				in[i] |= BIT(b);
+	}
+
+	return 0;
+}
+
+static u8 w1_uart_read_byte(void *data)
+{
+	u8 byte;
+
+	if (w1_uart_touch_bytes(data, NULL, &byte, 1))
+		return 0xff;
+
+	return byte;
+}
+
+static void w1_uart_write_byte(void *data, u8 byte)
+{
+	w1_uart_touch_bytes(data, &byte, NULL, 1);
+}
+
+static u8 w1_uart_read_block(void *data, u8 *buf, int len)
+{
+	int done, n;
+
+	for (done = 0; done < len; done += n) {
+		n = min(len - done, W1_UART_MAX_BYTES);
+		if (w1_uart_touch_bytes(data, NULL, buf + done, n))
+			break;
+	}
+
+	return done;
+}
+
+static void w1_uart_write_block(void *data, const u8 *buf, int len)
+{
+	int done, n;
+
+	for (done = 0; done < len; done += n) {
+		n = min(len - done, W1_UART_MAX_BYTES);
+		if (w1_uart_touch_bytes(data, buf + done, NULL, n))
+			break;
+	}
+}
+
+static int w1_uart_probe(struct serdev_device *serdev)
+{
+	struct device *dev = &serdev->dev;
+	struct w1_uart_device *wdev;
+	int ret;
+
+	wdev = devm_kzalloc(dev, sizeof(*wdev), GFP_KERNEL);
+	if (!wdev)
+		return -ENOMEM;
+
+	wdev->serdev = serdev;
+	mutex_init(&wdev->rx_mutex);
+	init_completion(&wdev->rx_done);
+
+	serdev_device_set_drvdata(serdev, wdev);
+	serdev_device_set_client_ops(serdev, &w1_uart_serdev_ops);
+
+	ret = devm_serdev_device_open(dev, serdev);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to open serial port\n");
+
+	serdev_device_set_flow_control(serdev, false);
+	ret = serdev_device_set_parity(serdev, SERDEV_PARITY_NONE);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to disable parity\n");
+
+	ret = w1_uart_set_baud(wdev, W1_UART_BIT_BAUD);
+	if (ret)
+		return ret;
+
+	wdev->bus.data = wdev;
+	wdev->bus.reset_bus = w1_uart_reset_bus;
+	wdev->bus.touch_bit = w1_uart_touch_bit;
+	wdev->bus.read_byte = w1_uart_read_byte;
+	wdev->bus.write_byte = w1_uart_write_byte;
+	wdev->bus.read_block = w1_uart_read_block;
+	wdev->bus.write_block = w1_uart_write_block;
+	wdev->bus.dev_id = "w1-uart";
+
+	ret = w1_add_master_device(&wdev->bus);
+	if (ret)
+		return dev_err_probe(dev, ret, "failed to register master\n");
+
+	return 0;
+}
+
+static void w1_uart_remove(struct serdev_device *serdev)
+{
+	struct w1_uart_device *wdev = serdev_device_get_drvdata(serdev);
+
+	w1_remove_master_device(&wdev->bus);
+}
+
+static const struct of_device_id w1_uart_of_match[] = {
+	{ .compatible = "w1-uart" },
+	{ /* sentinel */ }
+};
+MODULE_DEVICE_TABLE(of, w1_uart_of_match);
+
+static struct serdev_device_driver w1_uart_driver = {
+	.driver = {
+		.name		= "w1-uart",
+		.of_match_table	= w1_uart_of_match,
+	},
+	.probe	= w1_uart_probe,
+	.remove	= w1_uart_remove,
+};
+
+module_serdev_device_driver(w1_uart_driver);
+
+MODULE_DESCRIPTION("UART w1 bus master driver");
+MODULE_LICENSE("GPL");
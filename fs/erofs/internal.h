@@ -70,6 +70,9 @@ struct erofs_mount_opts {
 
 	/* threshold for decompression synchronously */
 	unsigned int max_sync_decompress_pages;
+
+	/* max threads to decompress independent pclusters of one request */
+	unsigned int max_decompress_threads;
 #endif
 	unsigned int mount_opt;
 };
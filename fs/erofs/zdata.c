@@ -336,6 +336,8 @@ static void z_erofs_free_pcluster(struct z_erofs_pcluster *pcl)
 }
 
 static struct workqueue_struct *z_erofs_workqueue __read_mostly;
+/* leaf workqueue for parallel decompression, its work never waits */
+static struct workqueue_struct *z_erofs_decomp_wq __read_mostly;
 
 #ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
 static struct kthread_worker __rcu **z_erofs_pcpu_workers;
@@ -455,6 +457,7 @@ void z_erofs_exit_zip_subsystem(void)
 {
 	erofs_cpu_hotplug_destroy();
 	erofs_destroy_percpu_workers();
+	destroy_workqueue(z_erofs_decomp_wq);
 	destroy_workqueue(z_erofs_workqueue);
 	z_erofs_destroy_pcluster_pool();
 }
@@ -473,6 +476,13 @@ int __init z_erofs_init_zip_subsystem(void)
 		goto out_error_workqueue_init;
 	}
 
+	z_erofs_decomp_wq = alloc_workqueue("erofs_decompress",
+			WQ_UNBOUND | WQ_HIGHPRI, num_possible_cpus());
+	if (!z_erofs_decomp_wq) {
+		err = -ENOMEM;
+		goto out_error_decomp_wq_init;
+	}
+
 	err = erofs_init_percpu_workers();
 	if (err)
 		goto out_error_pcpu_worker;
@@ -485,6 +495,8 @@ int __init z_erofs_init_zip_subsystem(void)
 out_error_cpuhp_init:
 	erofs_destroy_percpu_workers();
 out_error_pcpu_worker:
+	destroy_workqueue(z_erofs_decomp_wq);
+out_error_decomp_wq_init:
 	destroy_workqueue(z_erofs_workqueue);
 out_error_workqueue_init:
 	z_erofs_destroy_pcluster_pool();
@@ -1248,6 +1260,7 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 	int err2;
 	struct page *page;
 	bool overlapped;
+	u64 start = 0;
 
 	mutex_lock(&pcl->lock);
 	be->nr_pages = PAGE_ALIGN(pcl->length + pcl->pageofs_out) >> PAGE_SHIFT;
@@ -1287,6 +1300,8 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 	else
 		inputsize = pclusterpages * PAGE_SIZE;
 
+	if (trace_z_erofs_decompress_pcluster_enabled())
+		start = ktime_get_ns();
 	err = decompressor->decompress(&(struct z_erofs_decompress_req) {
 					.sb = be->sb,
 					.in = be->compressed_pages,
@@ -1300,6 +1315,10 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 					.partial_decoding = pcl->partial,
 					.fillgaps = pcl->multibases,
 				 }, be->pagepool);
+	if (start)
+		trace_z_erofs_decompress_pcluster(be->sb, pcl->obj.index,
+				pcl->algorithmformat, inputsize, pcl->length,
+				ktime_get_ns() - start, err);
 
 out:
 	/* must handle all compressed pages before actual file pages */
@@ -1351,16 +1370,16 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 	return err;
 }
 
-static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
+static void z_erofs_decompress_chain(struct super_block *sb,
+				     z_erofs_next_pcluster_t owned, bool eio,
 				     struct page **pagepool)
 {
 	struct z_erofs_decompress_backend be = {
-		.sb = io->sb,
+		.sb = sb,
 		.pagepool = pagepool,
 		.decompressed_secondary_bvecs =
 			LIST_HEAD_INIT(be.decompressed_secondary_bvecs),
 	};
-	z_erofs_next_pcluster_t owned = io->head;
 
 	while (owned != Z_EROFS_PCLUSTER_TAIL) {
 		DBG_BUGON(owned == Z_EROFS_PCLUSTER_NIL);
@@ -1368,7 +1387,7 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 		be.pcl = container_of(owned, struct z_erofs_pcluster, next);
 		owned = READ_ONCE(be.pcl->next);
 
-		z_erofs_decompress_pcluster(&be, io->eio ? -EIO : 0);
+		z_erofs_decompress_pcluster(&be, eio ? -EIO : 0);
 		if (z_erofs_is_inline_pcluster(be.pcl))
 			z_erofs_free_pcluster(be.pcl);
 		else
@@ -1376,6 +1395,96 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	}
 }
 
+/* upper bound of chains split from one queue, each needs a stack slot */
+#define Z_EROFS_MAX_DECOMPRESS_THREADS	8
+
+struct z_erofs_decompress_job {
+	struct work_struct work;
+	struct super_block *sb;
+	z_erofs_next_pcluster_t head;
+	bool eio;
+};
+
+static void z_erofs_decompress_chain_work(struct work_struct *work)
+{
+	struct z_erofs_decompress_job *job =
+		container_of(work, struct z_erofs_decompress_job, work);
+	struct page *pagepool = NULL;
+
+	z_erofs_decompress_chain(job->sb, job->head, job->eio,
+				 &pagepool);
+	erofs_release_pages(&pagepool);
+}
+
+/*
+ * Pclusters of one queue are independent of each other (pages shared by two
+ * pclusters are completed with atomic counters), so split the owned chain
+ * into contiguous sub-chains and decompress them on several CPUs.  The first
+ * sub-chain is handled by the caller, which then waits for the others.
+ */
+static bool z_erofs_decompress_parallel(const struct z_erofs_decompressqueue *io,
+					struct page **pagepool)
+{
+	struct z_erofs_decompress_job jobs[Z_EROFS_MAX_DECOMPRESS_THREADS];
+	unsigned int nr = min3(EROFS_SB(io->sb)->opt.max_decompress_threads,
+			       num_online_cpus(),
+			       (unsigned int)Z_EROFS_MAX_DECOMPRESS_THREADS);
+	z_erofs_next_pcluster_t owned = io->head;
+	struct z_erofs_pcluster *pcl;
+	unsigned int count = 0, per, i, j;
+
+	if (nr < 2)
+		return false;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		++count;
+	}
+	if (count < 2)
+		return false;
+
+	nr = min(nr, count);
+	per = DIV_ROUND_UP(count, nr);
+	owned = io->head;
+	for (i = 0; owned != Z_EROFS_PCLUSTER_TAIL; ++i) {
+		jobs[i].sb = io->sb;
+		jobs[i].head = owned;
+		jobs[i].eio = io->eio;
+
+		/* cut the chain after @per pclusters */
+		for (j = 0; j < per; ++j) {
+			pcl = container_of(owned, struct z_erofs_pcluster, next);
+			owned = READ_ONCE(pcl->next);
+			if (owned == Z_EROFS_PCLUSTER_TAIL)
+				break;
+		}
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL);
+
+		if (i) {
+			INIT_WORK_ONSTACK(&jobs[i].work,
+					  z_erofs_decompress_chain_work);
+			queue_work(z_erofs_decomp_wq, &jobs[i].work);
+		}
+	}
+	nr = i;
+
+	z_erofs_decompress_chain(io->sb, jobs[0].head, io->eio, pagepool);
+	for (i = 1; i < nr; ++i) {
+		flush_work(&jobs[i].work);
+		destroy_work_on_stack(&jobs[i].work);
+	}
+	return true;
+}
+
+static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
+				     struct page **pagepool)
+{
+	if (z_erofs_decompress_parallel(io, pagepool))
+		return;
+	z_erofs_decompress_chain(io->sb, io->head, io->eio, pagepool);
+}
+
 static void z_erofs_decompressqueue_work(struct work_struct *work)
 {
 	struct z_erofs_decompressqueue *bgq =
@@ -10,22 +10,6 @@
 #include "exfat_raw.h"
 #include "exfat_fs.h"
 
-static const unsigned char free_bit[] = {
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2,/*  0 ~  19*/
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3,/* 20 ~  39*/
-	0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2,/* 40 ~  59*/
-	0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4,/* 60 ~  79*/
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5, 0, 1, 0, 2,/* 80 ~  99*/
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3,/*100 ~ 119*/
-	0, 1, 0, 2, 0, 1, 0, 7, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2,/*120 ~ 139*/
-	0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 5,/*140 ~ 159*/
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2,/*160 ~ 179*/
-	0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 6, 0, 1, 0, 2, 0, 1, 0, 3,/*180 ~ 199*/
-	0, 1, 0, 2, 0, 1, 0, 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2,/*200 ~ 219*/
-	0, 1, 0, 5, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0, 4,/*220 ~ 239*/
-	0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0                /*240 ~ 254*/
-};
-
 static const unsigned char used_bit[] = {
 	0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3,/*  0 ~  19*/
 	2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4,/* 20 ~  39*/
@@ -74,6 +58,14 @@ static int exfat_allocate_bitmap(struct super_block *sb,
 	if (!sbi->vol_amap)
 		return -ENOMEM;
 
+	sbi->map_free = kvcalloc(sbi->map_sectors, sizeof(unsigned int),
+				 GFP_KERNEL);
+	if (!sbi->map_free) {
+		kvfree(sbi->vol_amap);
+		sbi->vol_amap = NULL;
+		return -ENOMEM;
+	}
+
 	sector = exfat_cluster_to_sector(sbi, sbi->map_clu);
 	for (i = 0; i < sbi->map_sectors; i++) {
 		sbi->vol_amap[i] = sb_bread(sb, sector + i);
@@ -86,6 +78,8 @@ static int exfat_allocate_bitmap(struct super_block *sb,
 
 			kvfree(sbi->vol_amap);
 			sbi->vol_amap = NULL;
+			kvfree(sbi->map_free);
+			sbi->map_free = NULL;
 			return -EIO;
 		}
 	}
@@ -139,6 +133,7 @@ void exfat_free_bitmap(struct exfat_sb_info *sbi)
 		__brelse(sbi->vol_amap[i]);
 
 	kvfree(sbi->vol_amap);
+	kvfree(sbi->map_free);
 }
 
 int exfat_set_bitmap(struct inode *inode, unsigned int clu, bool sync)
@@ -155,7 +150,8 @@ int exfat_set_bitmap(struct inode *inode, unsigned int clu, bool sync)
 	i = BITMAP_OFFSET_SECTOR_INDEX(sb, ent_idx);
 	b = BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent_idx);
 
-	set_bit_le(b, sbi->vol_amap[i]->b_data);
+	if (!test_and_set_bit_le(b, sbi->vol_amap[i]->b_data))
+		sbi->map_free[i]--;
 	exfat_update_bh(sbi->vol_amap[i], sync);
 	return 0;
 }
@@ -175,7 +171,8 @@ void exfat_clear_bitmap(struct inode *inode, unsigned int clu, bool sync)
 	i = BITMAP_OFFSET_SECTOR_INDEX(sb, ent_idx);
 	b = BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent_idx);
 
-	clear_bit_le(b, sbi->vol_amap[i]->b_data);
+	if (test_and_clear_bit_le(b, sbi->vol_amap[i]->b_data))
+		sbi->map_free[i]++;
 	exfat_update_bh(sbi->vol_amap[i], sync);
 
 	if (opts->discard) {
@@ -198,51 +195,53 @@ void exfat_clear_bitmap(struct inode *inode, unsigned int clu, bool sync)
  */
 unsigned int exfat_find_free_bitmap(struct super_block *sb, unsigned int clu)
 {
-	unsigned int i, map_i, map_b, ent_idx;
-	unsigned int clu_base, clu_free;
-	unsigned char k, clu_mask;
+	unsigned int i, map_i, ent_idx, start, limit, b;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int total_clus = EXFAT_DATA_CLUSTER_COUNT(sbi);
+	unsigned int bits_per_sector = BITS_PER_SECTOR(sb);
 
 	WARN_ON(clu < EXFAT_FIRST_CLUSTER);
 	ent_idx = CLUSTER_TO_BITMAP_ENT(clu);
-	clu_base = BITMAP_ENT_TO_CLUSTER(ent_idx & ~(BITS_PER_BYTE_MASK));
-	clu_mask = IGNORED_BITS_REMAINED(clu, clu_base);
+	if (ent_idx >= total_clus)
+		ent_idx = 0;
 
 	map_i = BITMAP_OFFSET_SECTOR_INDEX(sb, ent_idx);
-	map_b = BITMAP_OFFSET_BYTE_IN_SECTOR(sb, ent_idx);
-
-	for (i = EXFAT_FIRST_CLUSTER; i < sbi->num_clusters;
-	     i += BITS_PER_BYTE) {
-		k = *(sbi->vol_amap[map_i]->b_data + map_b);
-		if (clu_mask > 0) {
-			k |= clu_mask;
-			clu_mask = 0;
-		}
-		if (k < 0xFF) {
-			clu_free = clu_base + free_bit[k];
-			if (clu_free < sbi->num_clusters)
-				return clu_free;
+	start = BITMAP_OFFSET_BIT_IN_SECTOR(sb, ent_idx);
+
+	/*
+	 * Sectors of the bitmap with no free cluster left are skipped without
+	 * being looked at, the others are searched a word at a time. The
+	 * sector holding the hint is visited twice, so that the clusters
+	 * before the hint are searched last once the search has wrapped.
+	 */
+	for (i = 0; i <= sbi->map_sectors; i++) {
+		if (sbi->map_free[map_i]) {
+			limit = min(bits_per_sector,
+				    total_clus - map_i * bits_per_sector);
+			b = find_next_zero_bit_le(sbi->vol_amap[map_i]->b_data,
+						  limit, start);
+			if (b < limit)
+				return BITMAP_ENT_TO_CLUSTER(map_i *
+							     bits_per_sector + b);
 		}
-		clu_base += BITS_PER_BYTE;
 
-		if (++map_b >= sb->s_blocksize ||
-		    clu_base >= sbi->num_clusters) {
-			if (++map_i >= sbi->map_sectors) {
-				clu_base = EXFAT_FIRST_CLUSTER;
-				map_i = 0;
-			}
-			map_b = 0;
-		}
+		start = 0;
+		if (++map_i >= sbi->map_sectors)
+			map_i = 0;
 	}
 
 	return EXFAT_EOF_CLUSTER;
 }
 
+/*
+ * Count the used clusters, and at the same time fill in how many free ones
+ * each sector of the bitmap holds for exfat_find_free_bitmap().
+ */
 int exfat_count_used_clusters(struct super_block *sb, unsigned int *ret_count)
 {
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
 	unsigned int count = 0;
-	unsigned int i, map_i = 0, map_b = 0;
+	unsigned int i, map_i = 0, map_b = 0, sect_used = 0;
 	unsigned int total_clus = EXFAT_DATA_CLUSTER_COUNT(sbi);
 	unsigned int last_mask = total_clus & BITS_PER_BYTE_MASK;
 	unsigned char clu_bits;
@@ -252,8 +251,11 @@ int exfat_count_used_clusters(struct super_block *sb, unsigned int *ret_count)
 	total_clus &= ~last_mask;
 	for (i = 0; i < total_clus; i += BITS_PER_BYTE) {
 		clu_bits = *(sbi->vol_amap[map_i]->b_data + map_b);
-		count += used_bit[clu_bits];
+		sect_used += used_bit[clu_bits];
 		if (++map_b >= (unsigned int)sb->s_blocksize) {
+			sbi->map_free[map_i] = BITS_PER_SECTOR(sb) - sect_used;
+			count += sect_used;
+			sect_used = 0;
 			map_i++;
 			map_b = 0;
 		}
@@ -262,7 +264,15 @@ int exfat_count_used_clusters(struct super_block *sb, unsigned int *ret_count)
 	if (last_mask) {
 		clu_bits = *(sbi->vol_amap[map_i]->b_data + map_b);
 		clu_bits &= last_bit_mask[last_mask];
-		count += used_bit[clu_bits];
+		sect_used += used_bit[clu_bits];
+		map_b++;
+	}
+
+	/* The last sector is only partly covered by the cluster heap */
+	if (map_b) {
+		sbi->map_free[map_i] = (map_b - 1) * BITS_PER_BYTE +
+			(last_mask ? last_mask : BITS_PER_BYTE) - sect_used;
+		count += sect_used;
 	}
 
 	*ret_count = count;
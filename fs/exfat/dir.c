@@ -6,6 +6,7 @@
 #include <linux/slab.h>
 #include <linux/compat.h>
 #include <linux/bio.h>
+#include <linux/blkdev.h>
 #include <linux/buffer_head.h>
 
 #include "exfat_raw.h"
@@ -774,6 +775,74 @@ struct exfat_dentry *exfat_get_dentry(struct super_block *sb,
 	return (struct exfat_dentry *)((*bh)->b_data + off);
 }
 
+/*
+ * Like exfat_get_dentry(), but keeps *bh across calls: the buffer is only
+ * released and looked up again when @entry lives in a different sector.
+ * The caller releases the last buffer once it is done.
+ */
+static struct exfat_dentry *exfat_get_dentry_reuse(struct super_block *sb,
+		struct exfat_chain *p_dir, int entry, struct buffer_head **bh)
+{
+	int off;
+	sector_t sec;
+
+	if (*bh) {
+		if (!exfat_find_location(sb, p_dir, entry, &sec, &off) &&
+		    (*bh)->b_blocknr == sec)
+			return (struct exfat_dentry *)((*bh)->b_data + off);
+
+		brelse(*bh);
+		*bh = NULL;
+	}
+
+	return exfat_get_dentry(sb, p_dir, entry, bh);
+}
+
+/*
+ * exfat_dir_readahead() only covers the cluster being read. A contiguous
+ * directory can be read ahead across clusters too, since the following
+ * clusters are known without consulting the FAT. @clu is the cluster being
+ * read within @p_dir, the whole directory.
+ */
+static void exfat_dir_readahead_contig(struct super_block *sb,
+		struct exfat_chain *p_dir, unsigned int clu)
+{
+	struct exfat_sb_info *sbi = EXFAT_SB(sb);
+	unsigned int max_ra_count = EXFAT_MAX_RA_SIZE >> sb->s_blocksize_bits;
+	unsigned int ra_count, remaining, i;
+	struct buffer_head *bh;
+	struct blk_plug plug;
+	sector_t sec;
+
+	if (p_dir->flags != ALLOC_NO_FAT_CHAIN || clu < p_dir->dir ||
+	    clu - p_dir->dir >= p_dir->size)
+		return;
+
+	/* Clusters of the directory after the current one */
+	remaining = p_dir->size - (clu - p_dir->dir) - 1;
+	if (!remaining)
+		return;
+
+	ra_count = min_t(unsigned long long,
+			 (unsigned long long)remaining <<
+				sbi->sect_per_clus_bits,
+			 max_ra_count);
+	sec = exfat_cluster_to_sector(sbi, clu + 1);
+
+	/* Already read ahead by an earlier cluster */
+	bh = sb_find_get_block(sb, sec);
+	if (bh && buffer_uptodate(bh)) {
+		brelse(bh);
+		return;
+	}
+	brelse(bh);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < ra_count; i++)
+		sb_breadahead(sb, sec + i);
+	blk_finish_plug(&plug);
+}
+
 enum exfat_validate_dentry_mode {
 	ES_MODE_STARTED,
 	ES_MODE_GET_FILE_ENTRY,
@@ -989,6 +1058,7 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 	unsigned int entry_type;
 	unsigned short *uniname = NULL;
 	struct exfat_chain clu;
+	struct buffer_head *bh = NULL;
 	struct exfat_hint *hint_stat = &ei->hint_stat;
 	struct exfat_hint_femp candi_empty;
 	struct exfat_sb_info *sbi = EXFAT_SB(sb);
@@ -1015,15 +1085,16 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 	exfat_reset_empty_hint(&candi_empty);
 
 	while (clu.dir != EXFAT_EOF_CLUSTER) {
+		exfat_dir_readahead_contig(sb, p_dir, clu.dir);
+
 		i = dentry & (dentries_per_clu - 1);
 		for (; i < dentries_per_clu; i++, dentry++) {
 			struct exfat_dentry *ep;
-			struct buffer_head *bh;
 
 			if (rewind && dentry == end_eidx)
 				goto not_found;
 
-			ep = exfat_get_dentry(sb, &clu, i, &bh);
+			ep = exfat_get_dentry_reuse(sb, &clu, i, &bh);
 			if (!ep)
 				return -EIO;
 
@@ -1037,7 +1108,6 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 						dentry, num_entries,
 						entry_type);
 
-				brelse(bh);
 				if (entry_type == TYPE_UNUSED)
 					goto not_found;
 				continue;
@@ -1051,7 +1121,6 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 				hint_opt->eidx = i;
 				num_ext = ep->dentry.file.num_ext;
 				step = DIRENT_STEP_STRM;
-				brelse(bh);
 				continue;
 			}
 
@@ -1060,7 +1129,6 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 
 				if (step != DIRENT_STEP_STRM) {
 					step = DIRENT_STEP_FILE;
-					brelse(bh);
 					continue;
 				}
 				step = DIRENT_STEP_FILE;
@@ -1073,11 +1141,9 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 					order = 1;
 					name_len = 0;
 				}
-				brelse(bh);
 				continue;
 			}
 
-			brelse(bh);
 			if (entry_type == TYPE_EXTEND) {
 				unsigned short entry_uniname[16], unichar;
 
@@ -1128,8 +1194,10 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 			else
 				clu.dir = EXFAT_EOF_CLUSTER;
 		} else {
-			if (exfat_get_next_cluster(sb, &clu.dir))
+			if (exfat_get_next_cluster(sb, &clu.dir)) {
+				brelse(bh);
 				return -EIO;
+			}
 		}
 	}
 
@@ -1158,9 +1226,12 @@ int exfat_find_dir_entry(struct super_block *sb, struct exfat_inode_info *ei,
 	/* initialized hint_stat */
 	hint_stat->clu = p_dir->dir;
 	hint_stat->eidx = 0;
+	brelse(bh);
 	return -ENOENT;
 
 found:
+	brelse(bh);
+
 	/* next dentry we'll find is out of this cluster */
 	if (!((dentry + 1) & (dentries_per_clu - 1))) {
 		int ret = 0;
@@ -14,6 +14,9 @@
 
 /* this must be > 0. */
 #define FAT_MAX_CACHE	8
+/* upper bound for large files, and how many clusters earn one more entry */
+#define FAT_MAX_CACHE_LARGE	64
+#define FAT_CACHE_CLUS_SHIFT	10
 
 struct fat_cache {
 	struct list_head cache_list;
@@ -31,7 +34,18 @@ struct fat_cache_id {
 
 static inline int fat_max_cache(struct inode *inode)
 {
-	return FAT_MAX_CACHE;
+	struct msdos_sb_info *sbi = MSDOS_SB(inode->i_sb);
+	unsigned long nr_clus;
+
+	/*
+	 * A large file written to a fragmented volume has more extents than
+	 * a handful of entries can hold, and every miss walks the FAT from
+	 * the nearest cached extent. Grow the cache with the file size.
+	 */
+	nr_clus = inode->i_blocks >> (sbi->cluster_bits - 9);
+	return FAT_MAX_CACHE + min_t(unsigned long,
+				     nr_clus >> FAT_CACHE_CLUS_SHIFT,
+				     FAT_MAX_CACHE_LARGE - FAT_MAX_CACHE);
 }
 
 static struct kmem_cache *fat_cache_cachep;
@@ -91,6 +91,8 @@ struct msdos_sb_info {
 	const struct fatent_operations *fatent_ops;
 	struct inode *fat_inode;
 	struct inode *fsinfo_inode;
+	/* FAT blocks not yet copied to the other FATs, or NULL if unused */
+	unsigned long *fat_mirror_dirty;
 
 	struct ratelimit_state ratelimit;
 
@@ -391,6 +393,7 @@ extern int fat_alloc_clusters(struct inode *inode, int *cluster,
 			      int nr_cluster);
 extern int fat_free_clusters(struct inode *inode, int cluster);
 extern int fat_count_free_clusters(struct super_block *sb);
+extern int fat_mirror_flush(struct super_block *sb);
 extern int fat_trim_fs(struct inode *inode, struct fstrim_range *range);
 
 /* fat/file.c */
@@ -372,39 +372,103 @@ int fat_ent_read(struct inode *inode, struct fat_entry *fatent, int entry)
 	return ops->ent_get(fatent);
 }
 
-/* FIXME: We can write the blocks as more big chunk. */
-static int fat_mirror_bhs(struct super_block *sb, struct buffer_head **bhs,
-			  int nr_bhs)
+static int fat_mirror_bh(struct super_block *sb, struct buffer_head *bh)
 {
 	struct msdos_sb_info *sbi = MSDOS_SB(sb);
 	struct buffer_head *c_bh;
-	int err, n, copy;
+	int err = 0, copy;
 
-	err = 0;
 	for (copy = 1; copy < sbi->fats; copy++) {
 		sector_t backup_fat = sbi->fat_length * copy;
 
-		for (n = 0; n < nr_bhs; n++) {
-			c_bh = sb_getblk(sb, backup_fat + bhs[n]->b_blocknr);
-			if (!c_bh) {
-				err = -ENOMEM;
-				goto error;
+		c_bh = sb_getblk(sb, backup_fat + bh->b_blocknr);
+		if (!c_bh)
+			return -ENOMEM;
+		/* Avoid race with userspace read via bdev */
+		lock_buffer(c_bh);
+		memcpy(c_bh->b_data, bh->b_data, sb->s_blocksize);
+		set_buffer_uptodate(c_bh);
+		unlock_buffer(c_bh);
+		mark_buffer_dirty_inode(c_bh, sbi->fat_inode);
+		if (sb->s_flags & SB_SYNCHRONOUS)
+			err = sync_dirty_buffer(c_bh);
+		brelse(c_bh);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * Copy the modified FAT blocks to the other FATs. Unless the filesystem
+ * is synchronous, this only records the blocks; the copies are made in
+ * one pass by fat_mirror_flush() when the FSINFO inode is written back
+ * or the filesystem is synced, so a large write that keeps touching the
+ * same few FAT blocks dirties each backup block once per writeback
+ * rather than once per cluster.
+ */
+static int fat_mirror_bhs(struct super_block *sb, struct buffer_head **bhs,
+			  int nr_bhs)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	int err, n;
+
+	if (sbi->fat_mirror_dirty && !(sb->s_flags & SB_SYNCHRONOUS)) {
+		/* Order the FAT update before the flusher can see the bit */
+		smp_mb__before_atomic();
+		for (n = 0; n < nr_bhs; n++)
+			set_bit(bhs[n]->b_blocknr - sbi->fat_start,
+				sbi->fat_mirror_dirty);
+		__mark_inode_dirty(sbi->fsinfo_inode, I_DIRTY_SYNC);
+		return 0;
+	}
+
+	for (n = 0; n < nr_bhs; n++) {
+		err = fat_mirror_bh(sb, bhs[n]);
+		if (err)
+			return err;
+	}
+	return 0;
+}
+
+/*
+ * Copy every FAT block recorded by fat_mirror_bhs() to the other FATs.
+ * The dirty blocks are walked as contiguous ranges so the backup copies
+ * are dirtied, and later written, in the same order as the primary.
+ */
+int fat_mirror_flush(struct super_block *sb)
+{
+	struct msdos_sb_info *sbi = MSDOS_SB(sb);
+	unsigned int start, end, i;
+	struct buffer_head *bh;
+	int err = 0;
+
+	if (!sbi->fat_mirror_dirty)
+		return 0;
+
+	for_each_set_bitrange(start, end, sbi->fat_mirror_dirty,
+			      sbi->fat_length) {
+		for (i = start; i < end; i++) {
+			if (!test_and_clear_bit(i, sbi->fat_mirror_dirty))
+				continue;
+
+			bh = sb_bread(sb, sbi->fat_start + i);
+			if (!bh) {
+				fat_msg_ratelimit(sb, KERN_ERR,
+					"FAT read failed (blocknr %lu)",
+					(unsigned long)sbi->fat_start + i);
+				set_bit(i, sbi->fat_mirror_dirty);
+				return -EIO;
+			}
+			err = fat_mirror_bh(sb, bh);
+			brelse(bh);
+			if (err) {
+				set_bit(i, sbi->fat_mirror_dirty);
+				return err;
 			}
-			/* Avoid race with userspace read via bdev */
-			lock_buffer(c_bh);
-			memcpy(c_bh->b_data, bhs[n]->b_data, sb->s_blocksize);
-			set_buffer_uptodate(c_bh);
-			unlock_buffer(c_bh);
-			mark_buffer_dirty_inode(c_bh, sbi->fat_inode);
-			if (sb->s_flags & SB_SYNCHRONOUS)
-				err = sync_dirty_buffer(c_bh);
-			brelse(c_bh);
-			if (err)
-				goto error;
 		}
 	}
-error:
-	return err;
+	return 0;
 }
 
 int fat_ent_write(struct inode *inode, struct fat_entry *fatent,
@@ -733,6 +733,7 @@ static void fat_put_super(struct super_block *sb)
 
 	iput(sbi->fsinfo_inode);
 	iput(sbi->fat_inode);
+	kvfree(sbi->fat_mirror_dirty);
 
 	call_rcu(&sbi->rcu, delayed_free);
 }
@@ -907,6 +908,10 @@ static int fat_write_inode(struct inode *inode, struct writeback_control *wbc)
 	if (inode->i_ino == MSDOS_FSINFO_INO) {
 		struct super_block *sb = inode->i_sb;
 
+		err = fat_mirror_flush(sb);
+		if (err)
+			return err;
+
 		mutex_lock(&MSDOS_SB(sb)->s_lock);
 		err = fat_clusters_flush(sb);
 		mutex_unlock(&MSDOS_SB(sb)->s_lock);
@@ -1850,6 +1855,15 @@ int fat_fill_super(struct super_block *sb, void *data, int silent, int isvfat,
 	sbi->fsinfo_inode = fsinfo_inode;
 	insert_inode_hash(fsinfo_inode);
 
+	/*
+	 * Defer copying FAT updates to the backup FATs to FSINFO writeback.
+	 * Without the map every update is mirrored immediately, as before.
+	 */
+	if (sbi->fats > 1)
+		sbi->fat_mirror_dirty = kvcalloc(BITS_TO_LONGS(sbi->fat_length),
+						 sizeof(unsigned long),
+						 GFP_KERNEL);
+
 	root_inode = new_inode(sb);
 	if (!root_inode)
 		goto out_fail;
@@ -1884,6 +1898,7 @@ int fat_fill_super(struct super_block *sb, void *data, int silent, int isvfat,
 out_fail:
 	iput(fsinfo_inode);
 	iput(fat_inode);
+	kvfree(sbi->fat_mirror_dirty);
 	unload_nls(sbi->nls_io);
 	unload_nls(sbi->nls_disk);
 	fat_reset_iocharset(&sbi->options);
@@ -241,6 +241,7 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 	loff_t data_pos = -1;
 	loff_t hole_len;
 	bool skip_hole = false;
+	bool copy_range = false;
 	int error = 0;
 
 	ovl_path_lowerdata(dentry, &datapath);
@@ -257,6 +258,17 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 		goto out_fput;
 	/* Couldn't clone, so now we try to copy the data */
 
+	/*
+	 * Let the filesystem copy the data itself if it can (e.g. server side
+	 * copy on network filesystems).  Like do_clone_file_range() this goes
+	 * to ->copy_file_range() directly, we already hold freeze protection
+	 * on the upper sb.
+	 */
+	if (new_file->f_op->copy_file_range &&
+	    new_file->f_op->copy_file_range == old_file->f_op->copy_file_range &&
+	    file_inode(old_file)->i_sb == file_inode(new_file)->i_sb)
+		copy_range = true;
+
 	/* Check if lower fs supports seek operation */
 	if (old_file->f_mode & FMODE_LSEEK)
 		skip_hole = true;
@@ -303,6 +315,20 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 			}
 		}
 
+		if (copy_range) {
+			bytes = new_file->f_op->copy_file_range(old_file,
+					old_pos, new_file, new_pos, this_len, 0);
+			/* Fall back to splice after a short or failed call */
+			if (bytes != this_len)
+				copy_range = false;
+			if (bytes > 0) {
+				old_pos += bytes;
+				new_pos += bytes;
+				len -= bytes;
+				continue;
+			}
+		}
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
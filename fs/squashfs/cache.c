@@ -94,6 +94,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 			cache->next_blk = (i + 1) % cache->entries;
 			entry = &cache->entry[i];
+			cache->misses++;
 
 			/*
 			 * Initialise chosen cache entry, and fill it in from
@@ -141,6 +142,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 		if (entry->refcount == 0)
 			cache->unused--;
 		entry->refcount++;
+		cache->hits++;
 
 		/*
 		 * If the entry is currently being filled in by another process
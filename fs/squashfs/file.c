@@ -34,6 +34,7 @@
 #include <linux/string.h>
 #include <linux/pagemap.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
@@ -533,6 +534,88 @@ static int squashfs_readahead_fragment(struct page **page,
 	return error;
 }
 
+/*
+ * A data block read by readahead.  Up to SQUASHFS_READAHEAD_BLOCKS of these
+ * are read and decompressed in parallel, one on the reading CPU and the rest
+ * on unbound workers, so a single sequential reader isn't limited to the
+ * decompression speed of one core.
+ */
+#define SQUASHFS_READAHEAD_BLOCKS	8
+
+struct squashfs_readahead_block {
+	struct work_struct	work;
+	struct inode		*inode;
+	struct page		**pages;
+	unsigned int		nr_pages;
+	u64			block;
+	int			bsize;
+	unsigned int		expected;
+	bool			last;
+};
+
+static void squashfs_readahead_block(struct squashfs_readahead_block *rb)
+{
+	struct squashfs_sb_info *msblk = rb->inode->i_sb->s_fs_info;
+	struct squashfs_page_actor *actor;
+	struct page *last_page;
+	int i, res;
+
+	actor = squashfs_page_actor_init_special(msblk, rb->pages, rb->nr_pages,
+						 rb->expected);
+	if (!actor)
+		goto out;
+
+	res = squashfs_read_data(rb->inode->i_sb, rb->block, rb->bsize, NULL,
+				 actor);
+
+	last_page = squashfs_page_actor_free(actor);
+
+	if (res == rb->expected) {
+		int bytes;
+
+		/* Last page (if present) may have trailing bytes not filled */
+		bytes = res % PAGE_SIZE;
+		if (rb->last && bytes && last_page)
+			memzero_page(last_page, bytes, PAGE_SIZE - bytes);
+
+		for (i = 0; i < rb->nr_pages; i++) {
+			flush_dcache_page(rb->pages[i]);
+			SetPageUptodate(rb->pages[i]);
+		}
+	}
+
+out:
+	for (i = 0; i < rb->nr_pages; i++) {
+		unlock_page(rb->pages[i]);
+		put_page(rb->pages[i]);
+	}
+}
+
+static void squashfs_readahead_work(struct work_struct *work)
+{
+	squashfs_readahead_block(container_of(work,
+				 struct squashfs_readahead_block, work));
+}
+
+static void squashfs_readahead_blocks(struct squashfs_readahead_block *rb,
+				      unsigned int nr_blocks)
+{
+	unsigned int i;
+
+	if (!nr_blocks)
+		return;
+
+	for (i = 1; i < nr_blocks; i++) {
+		INIT_WORK(&rb[i].work, squashfs_readahead_work);
+		queue_work(system_unbound_wq, &rb[i].work);
+	}
+
+	squashfs_readahead_block(&rb[0]);
+
+	for (i = 1; i < nr_blocks; i++)
+		flush_work(&rb[i].work);
+}
+
 static void squashfs_readahead(struct readahead_control *ractl)
 {
 	struct inode *inode = ractl->mapping->host;
@@ -541,24 +624,39 @@ static void squashfs_readahead(struct readahead_control *ractl)
 	unsigned short shift = msblk->block_log - PAGE_SHIFT;
 	loff_t start = readahead_pos(ractl) & ~mask;
 	size_t len = readahead_length(ractl) + readahead_pos(ractl) - start;
-	struct squashfs_page_actor *actor;
-	unsigned int nr_pages = 0;
-	struct page **pages;
+	struct squashfs_readahead_block *rb;
+	unsigned int nr_pages = 0, nr_blocks = 0, max_blocks;
+	struct page **pages, **block_pages = NULL;
 	int i, file_end = i_size_read(inode) >> msblk->block_log;
 	unsigned int max_pages = 1UL << shift;
+	unsigned int block_pages_max = max_pages;
 
 	readahead_expand(ractl, start, (len | mask) + 1);
 
-	pages = kmalloc_array(max_pages, sizeof(void *), GFP_KERNEL);
-	if (!pages)
-		return;
+	/*
+	 * There is no point in reading more blocks at once than can be
+	 * decompressed concurrently, or than the readahead window holds.
+	 */
+	max_blocks = min_t(unsigned int, msblk->max_thread_num,
+			   num_online_cpus());
+	max_blocks = min_t(unsigned int, max_blocks, SQUASHFS_READAHEAD_BLOCKS);
+	max_blocks = clamp_t(unsigned int, max_blocks, 1,
+		DIV_ROUND_UP(readahead_length(ractl), msblk->block_size));
+
+	rb = kcalloc(max_blocks, sizeof(*rb), GFP_KERNEL);
+	pages = kmalloc_array(max_blocks * block_pages_max, sizeof(void *),
+			      GFP_KERNEL);
+	if (!rb || !pages)
+		goto out;
 
 	for (;;) {
+		struct squashfs_readahead_block *b = &rb[nr_blocks];
 		pgoff_t index;
 		int res, bsize;
 		u64 block = 0;
 		unsigned int expected;
-		struct page *last_page;
+
+		block_pages = pages + nr_blocks * block_pages_max;
 
 		expected = start >> msblk->block_log == file_end ?
 			   (i_size_read(inode) & (msblk->block_size - 1)) :
@@ -566,21 +664,21 @@ static void squashfs_readahead(struct readahead_control *ractl)
 
 		max_pages = (expected + PAGE_SIZE - 1) >> PAGE_SHIFT;
 
-		nr_pages = __readahead_batch(ractl, pages, max_pages);
+		nr_pages = __readahead_batch(ractl, block_pages, max_pages);
 		if (!nr_pages)
 			break;
 
 		if (readahead_pos(ractl) >= i_size_read(inode))
 			goto skip_pages;
 
-		index = pages[0]->index >> shift;
+		index = block_pages[0]->index >> shift;
 
-		if ((pages[nr_pages - 1]->index >> shift) != index)
+		if ((block_pages[nr_pages - 1]->index >> shift) != index)
 			goto skip_pages;
 
 		if (index == file_end && squashfs_i(inode)->fragment_block !=
 						SQUASHFS_INVALID_BLK) {
-			res = squashfs_readahead_fragment(pages, nr_pages,
+			res = squashfs_readahead_fragment(block_pages, nr_pages,
 							  expected);
 			if (res)
 				goto skip_pages;
@@ -591,45 +689,32 @@ static void squashfs_readahead(struct readahead_control *ractl)
 		if (bsize == 0)
 			goto skip_pages;
 
-		actor = squashfs_page_actor_init_special(msblk, pages, nr_pages,
-							 expected);
-		if (!actor)
-			goto skip_pages;
-
-		res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
-
-		last_page = squashfs_page_actor_free(actor);
-
-		if (res == expected) {
-			int bytes;
-
-			/* Last page (if present) may have trailing bytes not filled */
-			bytes = res % PAGE_SIZE;
-			if (index == file_end && bytes && last_page)
-				memzero_page(last_page, bytes,
-					     PAGE_SIZE - bytes);
-
-			for (i = 0; i < nr_pages; i++) {
-				flush_dcache_page(pages[i]);
-				SetPageUptodate(pages[i]);
-			}
-		}
-
-		for (i = 0; i < nr_pages; i++) {
-			unlock_page(pages[i]);
-			put_page(pages[i]);
+		b->inode = inode;
+		b->pages = block_pages;
+		b->nr_pages = nr_pages;
+		b->block = block;
+		b->bsize = bsize;
+		b->expected = expected;
+		b->last = index == file_end;
+
+		if (++nr_blocks == max_blocks) {
+			squashfs_readahead_blocks(rb, nr_blocks);
+			nr_blocks = 0;
 		}
 	}
 
-	kfree(pages);
-	return;
+	squashfs_readahead_blocks(rb, nr_blocks);
+	goto out;
 
 skip_pages:
 	for (i = 0; i < nr_pages; i++) {
-		unlock_page(pages[i]);
-		put_page(pages[i]);
+		unlock_page(block_pages[i]);
+		put_page(block_pages[i]);
 	}
+	squashfs_readahead_blocks(rb, nr_blocks);
+out:
 	kfree(pages);
+	kfree(rb);
 }
 
 const struct address_space_operations squashfs_aops = {
@@ -79,6 +79,12 @@ extern int squashfs_get_id(struct super_block *, unsigned int, unsigned int *);
 extern __le64 *squashfs_read_id_index_table(struct super_block *, u64, u64,
 				unsigned short);
 
+/* sysfs.c */
+extern int squashfs_register_sysfs(struct super_block *);
+extern void squashfs_unregister_sysfs(struct super_block *);
+extern int squashfs_init_sysfs(void);
+extern void squashfs_exit_sysfs(void);
+
 /* inode.c */
 extern struct inode *squashfs_iget(struct super_block *, long long,
 				unsigned int);
@@ -11,6 +11,9 @@
  */
 
 #define SQUASHFS_CACHED_FRAGMENTS	CONFIG_SQUASHFS_FRAGMENT_CACHE_SIZE
+#define SQUASHFS_MAX_CACHED_FRAGMENTS	64
+/* Let the fragment cache grow to use 1/2^n of RAM */
+#define SQUASHFS_FRAGMENT_CACHE_SHIFT	11
 #define SQUASHFS_MAJOR			4
 #define SQUASHFS_MINOR			0
 #define SQUASHFS_START			0
@@ -28,6 +28,7 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/magic.h>
+#include <linux/mm.h>
 #include <linux/xattr.h>
 
 #include "squashfs_fs.h"
@@ -177,6 +178,23 @@ static const struct squashfs_decompressor *supported_squashfs_filesystem(
 }
 
 
+/*
+ * Size the fragment cache to the machine.  A small cache thrashes when many
+ * files sharing a handful of fragment blocks are read concurrently, so allow
+ * it to use up to 1/2^SQUASHFS_FRAGMENT_CACHE_SHIFT of RAM, treating the
+ * configured size as a minimum.
+ */
+static int squashfs_fragment_cache_entries(int block_log)
+{
+	u64 entries = ((u64)totalram_pages() << PAGE_SHIFT >>
+		       SQUASHFS_FRAGMENT_CACHE_SHIFT) >> block_log;
+
+	entries = min_t(u64, entries, SQUASHFS_MAX_CACHED_FRAGMENTS);
+
+	return max_t(int, entries, SQUASHFS_CACHED_FRAGMENTS);
+}
+
+
 static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 {
 	struct squashfs_mount_opts *opts = fc->fs_private;
@@ -405,7 +423,8 @@ static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 		goto check_directory_table;
 
 	msblk->fragment_cache = squashfs_cache_init("fragment",
-		SQUASHFS_CACHED_FRAGMENTS, msblk->block_size);
+		squashfs_fragment_cache_entries(msblk->block_log),
+		msblk->block_size);
 	if (msblk->fragment_cache == NULL) {
 		err = -ENOMEM;
 		goto failed_mount;
@@ -457,6 +476,9 @@ static int squashfs_fill_super(struct super_block *sb, struct fs_context *fc)
 		goto failed_mount;
 	}
 
+	if (squashfs_register_sysfs(sb))
+		WARNING("Failed to register sysfs entries\n");
+
 	TRACE("Leaving squashfs_fill_super\n");
 	kfree(sblk);
 	return 0;
@@ -584,6 +606,7 @@ static void squashfs_put_super(struct super_block *sb)
 {
 	if (sb->s_fs_info) {
 		struct squashfs_sb_info *sbi = sb->s_fs_info;
+		squashfs_unregister_sysfs(sb);
 		squashfs_cache_delete(sbi->block_cache);
 		squashfs_cache_delete(sbi->fragment_cache);
 		squashfs_cache_delete(sbi->read_page);
@@ -640,8 +663,15 @@ static int __init init_squashfs_fs(void)
 	if (err)
 		return err;
 
+	err = squashfs_init_sysfs();
+	if (err) {
+		destroy_inodecache();
+		return err;
+	}
+
 	err = register_filesystem(&squashfs_fs_type);
 	if (err) {
+		squashfs_exit_sysfs();
 		destroy_inodecache();
 		return err;
 	}
@@ -655,6 +685,7 @@ static int __init init_squashfs_fs(void)
 static void __exit exit_squashfs_fs(void)
 {
 	unregister_filesystem(&squashfs_fs_type);
+	squashfs_exit_sysfs();
 	destroy_inodecache();
 }
 
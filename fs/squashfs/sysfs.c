@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * sysfs.c
+ */
+
+/*
+ * This file exports per-filesystem statistics under /sys/fs/squashfs/<dev>/.
+ */
+
+#include <linux/fs.h>
+#include <linux/kobject.h>
+#include <linux/slab.h>
+#include <linux/sysfs.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs.h"
+
+static struct kobject *squashfs_root;
+
+struct squashfs_attr {
+	struct attribute attr;
+	unsigned long (*get)(struct squashfs_cache *cache);
+};
+
+static unsigned long squashfs_cache_entries(struct squashfs_cache *cache)
+{
+	return cache->entries;
+}
+
+static unsigned long squashfs_cache_hits(struct squashfs_cache *cache)
+{
+	return READ_ONCE(cache->hits);
+}
+
+static unsigned long squashfs_cache_misses(struct squashfs_cache *cache)
+{
+	return READ_ONCE(cache->misses);
+}
+
+#define SQUASHFS_ATTR(_name, _get)					\
+static struct squashfs_attr squashfs_attr_##_name = {			\
+	.attr = { .name = __stringify(_name), .mode = 0444 },		\
+	.get = _get,							\
+}
+
+SQUASHFS_ATTR(fragment_cache_entries, squashfs_cache_entries);
+SQUASHFS_ATTR(fragment_cache_hits, squashfs_cache_hits);
+SQUASHFS_ATTR(fragment_cache_misses, squashfs_cache_misses);
+
+static struct attribute *squashfs_attrs[] = {
+	&squashfs_attr_fragment_cache_entries.attr,
+	&squashfs_attr_fragment_cache_hits.attr,
+	&squashfs_attr_fragment_cache_misses.attr,
+	NULL,
+};
+ATTRIBUTE_GROUPS(squashfs);
+
+static ssize_t squashfs_attr_show(struct kobject *kobj,
+				  struct attribute *attr, char *buf)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, s_kobj);
+	struct squashfs_attr *a = container_of(attr, struct squashfs_attr,
+					       attr);
+
+	/* Filesystems without fragments have no fragment cache */
+	if (!msblk->fragment_cache)
+		return sysfs_emit(buf, "0\n");
+
+	return sysfs_emit(buf, "%lu\n", a->get(msblk->fragment_cache));
+}
+
+static const struct sysfs_ops squashfs_attr_ops = {
+	.show	= squashfs_attr_show,
+};
+
+static void squashfs_sb_release(struct kobject *kobj)
+{
+	struct squashfs_sb_info *msblk = container_of(kobj,
+					struct squashfs_sb_info, s_kobj);
+
+	complete(&msblk->s_kobj_unregister);
+}
+
+static const struct kobj_type squashfs_sb_ktype = {
+	.default_groups	= squashfs_groups,
+	.sysfs_ops	= &squashfs_attr_ops,
+	.release	= squashfs_sb_release,
+};
+
+/*
+ * Failing to register only loses the statistics, so callers carry on with
+ * the mount regardless.
+ */
+int squashfs_register_sysfs(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+	int err;
+
+	init_completion(&msblk->s_kobj_unregister);
+	err = kobject_init_and_add(&msblk->s_kobj, &squashfs_sb_ktype,
+				   squashfs_root, "%s", sb->s_id);
+	if (err) {
+		kobject_put(&msblk->s_kobj);
+		wait_for_completion(&msblk->s_kobj_unregister);
+	}
+
+	return err;
+}
+
+void squashfs_unregister_sysfs(struct super_block *sb)
+{
+	struct squashfs_sb_info *msblk = sb->s_fs_info;
+
+	if (!msblk->s_kobj.state_in_sysfs)
+		return;
+
+	kobject_del(&msblk->s_kobj);
+	kobject_put(&msblk->s_kobj);
+	wait_for_completion(&msblk->s_kobj_unregister);
+}
+
+int __init squashfs_init_sysfs(void)
+{
+	squashfs_root = kobject_create_and_add("squashfs", fs_kobj);
+
+	return squashfs_root ? 0 : -ENOMEM;
+}
+
+void squashfs_exit_sysfs(void)
+{
+	kobject_put(squashfs_root);
+}
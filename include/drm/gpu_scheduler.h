@@ -29,6 +29,8 @@
 #include <linux/completion.h>
 #include <linux/xarray.h>
 #include <linux/workqueue.h>
+#include <linux/kref.h>
+#include <linux/spinlock.h>
 
 #define MAX_WAIT_SCHED_ENTITY_Q_EMPTY msecs_to_jiffies(1000)
 
@@ -58,6 +60,7 @@ struct drm_gpu_scheduler;
 struct drm_sched_rq;
 
 struct drm_file;
+struct drm_printer;
 
 /* These are often used as an (initial) index
  * to an array, and as such should start at 0.
@@ -77,6 +80,56 @@ extern int drm_sched_policy;
 #define DRM_SCHED_POLICY_RR    0
 #define DRM_SCHED_POLICY_FIFO  1
 
+/* Number of log2(usecs) buckets in a &struct drm_sched_hist */
+#define DRM_SCHED_HIST_BUCKETS	24
+
+/**
+ * struct drm_sched_hist - latency histogram
+ *
+ * Bucket 0 counts samples below 1us, bucket n counts samples in
+ * [2^(n-1), 2^n) us and the last bucket collects everything above.
+ */
+struct drm_sched_hist {
+	/** @buckets: sample counts per log2(usecs) bucket */
+	u64	buckets[DRM_SCHED_HIST_BUCKETS];
+	/** @total_ns: sum of all samples */
+	u64	total_ns;
+	/** @max_ns: largest sample seen */
+	u64	max_ns;
+};
+
+/**
+ * struct drm_sched_stats - job latency statistics
+ *
+ * Splits the life of a job into the time spent waiting for its
+ * dependencies to signal, the time spent queued behind other work once
+ * runnable, and the time between &drm_sched_backend_ops.run_job and the
+ * hardware fence signalling.
+ */
+struct drm_sched_stats {
+	/** @lock: protects the histograms, taken from fence callbacks */
+	spinlock_t		lock;
+	/** @dep_wait: time blocked on dependencies */
+	struct drm_sched_hist	dep_wait;
+	/** @queue_wait: time runnable but not yet handed to the hardware */
+	struct drm_sched_hist	queue_wait;
+	/** @exec: time between run_job and the hardware fence signalling */
+	struct drm_sched_hist	exec;
+};
+
+/**
+ * struct drm_sched_entity_stats - refcounted per-entity statistics
+ *
+ * Jobs outlive the entity they were pushed to, so each armed job holds
+ * a reference to keep the statistics around until it completes.
+ */
+struct drm_sched_entity_stats {
+	/** @kref: one reference for the entity plus one per armed job */
+	struct kref		kref;
+	/** @stats: the histograms */
+	struct drm_sched_stats	stats;
+};
+
 /**
  * struct drm_sched_entity - A wrapper around a job queue (typically
  * attached to the DRM file_priv).
@@ -238,6 +291,13 @@ struct drm_sched_entity {
 	 */
 	struct rb_node			rb_tree_node;
 
+	/**
+	 * @stats:
+	 *
+	 * Job latency statistics for this entity, see
+	 * drm_sched_entity_print_stats().
+	 */
+	struct drm_sched_entity_stats	*stats;
 };
 
 /**
@@ -371,6 +431,29 @@ struct drm_sched_job {
 	 * When the job was pushed into the entity queue.
 	 */
 	ktime_t                         submit_ts;
+
+	/**
+	 * @dep_ts:
+	 *
+	 * When the job was first found blocked on a dependency, zero if it
+	 * never was.
+	 */
+	ktime_t				dep_ts;
+
+	/**
+	 * @run_ts:
+	 *
+	 * When the job was handed to &drm_sched_backend_ops.run_job.
+	 */
+	ktime_t				run_ts;
+
+	/**
+	 * @entity_stats:
+	 *
+	 * Reference to the statistics of the entity the job was armed on,
+	 * valid from drm_sched_job_arm() to drm_sched_job_cleanup().
+	 */
+	struct drm_sched_entity_stats	*entity_stats;
 };
 
 static inline bool drm_sched_invalidate_job(struct drm_sched_job *s_job,
@@ -492,6 +575,7 @@ struct drm_sched_backend_ops {
  * @ready: marks if the underlying HW is ready to work
  * @free_guilty: A hit to time out handler to free the guilty job.
  * @dev: system &struct device
+ * @stats: job latency statistics aggregated over all entities
  *
  * One scheduler is implemented for each hardware ring.
  */
@@ -516,6 +600,7 @@ struct drm_gpu_scheduler {
 	bool				ready;
 	bool				free_guilty;
 	struct device			*dev;
+	struct drm_sched_stats		stats;
 };
 
 int drm_sched_init(struct drm_gpu_scheduler *sched,
@@ -558,6 +643,8 @@ void drm_sched_increase_karma_ext(struct drm_sched_job *bad, int type);
 bool drm_sched_dependency_optimized(struct dma_fence* fence,
 				    struct drm_sched_entity *entity);
 void drm_sched_fault(struct drm_gpu_scheduler *sched);
+void drm_sched_print_stats(struct drm_gpu_scheduler *sched,
+			   struct drm_printer *p, const char *prefix);
 
 void drm_sched_rq_add_entity(struct drm_sched_rq *rq,
 			     struct drm_sched_entity *entity);
@@ -581,6 +668,15 @@ void drm_sched_entity_set_priority(struct drm_sched_entity *entity,
 				   enum drm_sched_priority priority);
 bool drm_sched_entity_is_ready(struct drm_sched_entity *entity);
 int drm_sched_entity_error(struct drm_sched_entity *entity);
+void drm_sched_entity_print_stats(struct drm_sched_entity *entity,
+				  struct drm_printer *p, const char *prefix);
+
+void drm_sched_stats_init(struct drm_sched_stats *stats);
+void drm_sched_stats_add(struct drm_sched_stats *stats,
+			 struct drm_sched_hist *hist, u64 ns);
+void drm_sched_stats_print(struct drm_sched_stats *stats,
+			   struct drm_printer *p, const char *prefix);
+void drm_sched_entity_stats_put(struct drm_sched_entity_stats *stats);
 
 struct drm_sched_fence *drm_sched_fence_alloc(
 	struct drm_sched_entity *s_entity, void *owner);
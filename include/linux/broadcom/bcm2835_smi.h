@@ -52,7 +52,21 @@
 #define BCM2835_SMI_IOC_GET_SETTINGS    _IO(BCM2835_SMI_IOC_MAGIC, 0)
 #define BCM2835_SMI_IOC_WRITE_SETTINGS  _IO(BCM2835_SMI_IOC_MAGIC, 1)
 #define BCM2835_SMI_IOC_ADDRESS	 _IO(BCM2835_SMI_IOC_MAGIC, 2)
-#define BCM2835_SMI_IOC_MAX	     2
+/* Zero-copy DMA directly to/from (pinned) user buffers */
+#define BCM2835_SMI_IOC_SUBMIT	 _IOW(BCM2835_SMI_IOC_MAGIC, 3, \
+				      struct smi_user_xfer)
+#define BCM2835_SMI_IOC_COMPLETE _IOR(BCM2835_SMI_IOC_MAGIC, 4, \
+				      struct smi_user_done)
+/* Continuous capture into an mmap-able ring */
+#define BCM2835_SMI_IOC_STREAM_SETUP _IOW(BCM2835_SMI_IOC_MAGIC, 5, \
+					  struct smi_stream_config)
+#define BCM2835_SMI_IOC_STREAM_START _IO(BCM2835_SMI_IOC_MAGIC, 6)
+#define BCM2835_SMI_IOC_STREAM_STOP  _IO(BCM2835_SMI_IOC_MAGIC, 7)
+#define BCM2835_SMI_IOC_MAX	     7
+
+/* mmap offsets of the streaming status page and data ring */
+#define BCM2835_SMI_STREAM_STATUS_OFFSET 0
+#define BCM2835_SMI_STREAM_RING_OFFSET	 0x10000 /* any page size */
 
 #define SMI_WIDTH_8BIT 0
 #define SMI_WIDTH_16BIT 1
@@ -99,6 +113,46 @@ struct smi_settings {
 	int dma_panic_write_thresh;
 };
 
+/* Max number of buffers in one BCM2835_SMI_IOC_SUBMIT. With two, user space
+ * can process the first buffer while the second one is still in flight. */
+#define SMI_USER_XFER_MAX_BUFS 2
+
+struct smi_user_buf {
+	uint64_t ptr;		/* 32 bit aligned */
+	uint32_t len;		/* multiple of 4 bytes */
+	uint32_t id;		/* returned by BCM2835_SMI_IOC_COMPLETE */
+};
+
+struct smi_user_xfer {
+	uint32_t write;		/* 0 = read from SMI, 1 = write to SMI */
+	uint32_t num_bufs;
+	struct smi_user_buf bufs[SMI_USER_XFER_MAX_BUFS];
+};
+
+/* Completion of the oldest outstanding buffer */
+struct smi_user_done {
+	uint32_t id;
+	uint32_t len;
+	int32_t status;
+	uint32_t pad;
+};
+
+struct smi_stream_config {
+	uint32_t ring_size;	/* multiple of the page size */
+	uint32_t chunk_size;	/* poll() wakeup granularity, divides ring */
+};
+
+/* Shared with user space through the status page. The kernel advances
+ * head by chunk_size as each chunk lands; user space advances tail as it
+ * consumes data. Both are byte offsets into the ring. */
+struct smi_stream_status {
+	uint32_t head;
+	uint32_t tail;
+	uint32_t overruns;	/* chunks written while the ring was full */
+	uint32_t ring_size;
+	uint32_t chunk_size;
+};
+
 /****************************************************************************
 *
 *   Declare exported SMI functions
@@ -109,9 +163,11 @@ struct smi_settings {
 
 #include <linux/dmaengine.h> /* for enum dma_transfer_direction */
 #include <linux/of.h>
+#include <linux/scatterlist.h>
 #include <linux/semaphore.h>
 
 struct bcm2835_smi_instance;
+struct vm_area_struct;
 
 struct bcm2835_smi_bounce_info {
 	struct semaphore callback_sem;
@@ -120,6 +176,23 @@ struct bcm2835_smi_bounce_info {
 	struct scatterlist sgl[DMA_BOUNCE_BUFFER_COUNT];
 };
 
+struct bcm2835_smi_stream {
+	void *ring;
+	dma_addr_t ring_phys;
+	size_t ring_size;
+	size_t chunk_size;
+	/* Called from the DMA callback as each chunk completes */
+	void (*chunk_done)(struct bcm2835_smi_stream *stream);
+};
+
+struct bcm2835_smi_pinned_buf {
+	struct page **pages;
+	unsigned int n_pages;
+	struct sg_table sgt;
+	enum dma_transfer_direction dir;
+	size_t len;
+};
+
 
 void bcm2835_smi_set_regs_from_settings(struct bcm2835_smi_instance *);
 
@@ -146,6 +219,46 @@ ssize_t bcm2835_smi_user_dma(
 	size_t count,
 	struct bcm2835_smi_bounce_info **bounce);
 
+int bcm2835_smi_pin_user_buf(
+	struct bcm2835_smi_instance *inst,
+	enum dma_transfer_direction dma_dir,
+	char __user *user_ptr,
+	size_t count,
+	struct bcm2835_smi_pinned_buf *buf);
+
+void bcm2835_smi_unpin_user_buf(
+	struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_pinned_buf *buf);
+
+int bcm2835_smi_user_dma_pinned(
+	struct bcm2835_smi_instance *inst,
+	enum dma_transfer_direction dma_dir,
+	struct bcm2835_smi_pinned_buf **bufs,
+	unsigned int n_bufs,
+	dma_async_tx_callback callback);
+
+int bcm2835_smi_user_dma_wait_done(struct bcm2835_smi_instance *inst);
+
+void bcm2835_smi_user_dma_abort(struct bcm2835_smi_instance *inst);
+
+int bcm2835_smi_stream_alloc(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream);
+
+void bcm2835_smi_stream_free(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream);
+
+int bcm2835_smi_stream_mmap(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream,
+	struct vm_area_struct *vma);
+
+int bcm2835_smi_stream_start(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream);
+
+void bcm2835_smi_stream_stop(struct bcm2835_smi_instance *inst,
+	struct bcm2835_smi_stream *stream);
+
+bool bcm2835_smi_stream_active(struct bcm2835_smi_instance *inst);
+
 struct bcm2835_smi_instance *bcm2835_smi_get(struct device_node *node);
 
 #endif /* __KERNEL__ */
@@ -270,11 +270,17 @@ void cpufreq_stats_create_table(struct cpufreq_policy *policy);
 void cpufreq_stats_free_table(struct cpufreq_policy *policy);
 void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 				     unsigned int new_freq);
+void cpufreq_stats_record_request(struct cpufreq_policy *policy);
+void cpufreq_stats_record_begin(struct cpufreq_policy *policy);
+void cpufreq_stats_record_end(struct cpufreq_policy *policy);
 #else
 static inline void cpufreq_stats_create_table(struct cpufreq_policy *policy) { }
 static inline void cpufreq_stats_free_table(struct cpufreq_policy *policy) { }
 static inline void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 						   unsigned int new_freq) { }
+static inline void cpufreq_stats_record_request(struct cpufreq_policy *policy) { }
+static inline void cpufreq_stats_record_begin(struct cpufreq_policy *policy) { }
+static inline void cpufreq_stats_record_end(struct cpufreq_policy *policy) { }
 #endif /* CONFIG_CPU_FREQ_STAT */
 
 /*********************************************************************
@@ -33,6 +33,9 @@ struct cpuidle_driver;
 #define CPUIDLE_STATE_DISABLED_BY_USER		BIT(0)
 #define CPUIDLE_STATE_DISABLED_BY_DRIVER	BIT(1)
 
+/* Number of log2(usecs) buckets in cpuidle_state_usage::exit_hist */
+#define CPUIDLE_EXIT_HIST_BUCKETS	12
+
 struct cpuidle_state_usage {
 	unsigned long long	disable;
 	unsigned long long	usage;
@@ -44,6 +47,10 @@ struct cpuidle_state_usage {
 	unsigned long long	s2idle_usage;
 	unsigned long long	s2idle_time; /* in US */
 #endif
+#ifdef CONFIG_CPU_IDLE_EXIT_LATENCY_STATS
+	u64			exit_hist[CPUIDLE_EXIT_HIST_BUCKETS]; /* log2(us) buckets */
+	u64			exit_max_ns;
+#endif
 };
 
 struct cpuidle_state {
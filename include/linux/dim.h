@@ -98,6 +98,7 @@ struct dim_stats {
  * @steps_right: Number of steps taken towards higher moderation
  * @steps_left: Number of steps taken towards lower moderation
  * @tired: Parking depth counter
+ * @profile_set: Net DIM profile table in use (see enum net_dim_profile_set)
  */
 struct dim {
 	u8 state;
@@ -112,6 +113,7 @@ struct dim {
 	u8 steps_right;
 	u8 steps_left;
 	u8 tired;
+	u8 profile_set;
 };
 
 /**
@@ -276,6 +278,55 @@ dim_update_sample_with_comps(u16 event_ctr, u64 packets, u64 bytes, u64 comps,
 
 /* Net DIM */
 
+/**
+ * enum net_dim_profile_set - Net DIM moderation profile tables
+ *
+ * @NET_DIM_PROFILE_SET_DEFAULT: Profiles tuned for high rate datacenter NICs
+ * @NET_DIM_PROFILE_SET_LOW_POWER: Profiles for small SoCs, where an interrupt
+ * and NAPI round trip costs several microseconds of a slow core. They never
+ * go below 8us and favour packet batching over latency.
+ * @NET_DIM_NUM_PROFILE_SETS: Number of profile tables
+ */
+enum net_dim_profile_set {
+	NET_DIM_PROFILE_SET_DEFAULT,
+	NET_DIM_PROFILE_SET_LOW_POWER,
+	NET_DIM_NUM_PROFILE_SETS
+};
+
+/**
+ *	net_dim_get_rx_moderation_set - RX profile from a given profile table
+ *	@profile_set: Profile table, see enum net_dim_profile_set
+ *	@cq_period_mode: CQ period mode
+ *	@ix: Profile index
+ */
+struct dim_cq_moder net_dim_get_rx_moderation_set(u8 profile_set,
+						  u8 cq_period_mode, int ix);
+
+/**
+ *	net_dim_get_def_rx_moderation_set - default RX moderation of a profile table
+ *	@profile_set: Profile table, see enum net_dim_profile_set
+ *	@cq_period_mode: CQ period mode
+ */
+struct dim_cq_moder net_dim_get_def_rx_moderation_set(u8 profile_set,
+						      u8 cq_period_mode);
+
+/**
+ *	net_dim_get_tx_moderation_set - TX profile from a given profile table
+ *	@profile_set: Profile table, see enum net_dim_profile_set
+ *	@cq_period_mode: CQ period mode
+ *	@ix: Profile index
+ */
+struct dim_cq_moder net_dim_get_tx_moderation_set(u8 profile_set,
+						  u8 cq_period_mode, int ix);
+
+/**
+ *	net_dim_get_def_tx_moderation_set - default TX moderation of a profile table
+ *	@profile_set: Profile table, see enum net_dim_profile_set
+ *	@cq_period_mode: CQ period mode
+ */
+struct dim_cq_moder net_dim_get_def_tx_moderation_set(u8 profile_set,
+						      u8 cq_period_mode);
+
 /**
  *	net_dim_get_rx_moderation - provide a CQ moderation object for the given RX profile
  *	@cq_period_mode: CQ period mode
@@ -11,6 +11,7 @@
 
 struct iio_dev;
 struct iio_buffer;
+struct vm_area_struct;
 
 /**
  * INDIO_BUFFER_FLAG_FIXED_WATERMARK - Watermark level of the buffer can not be
@@ -39,6 +40,14 @@ struct iio_buffer;
  *                      device stops sampling. Calles are balanced with @enable.
  * @release:		called when the last reference to the buffer is dropped,
  *			should free all resources allocated by the buffer.
+ * @alloc_blocks:	allocate blocks for the mmap block interface. Switches
+ *			the buffer from read()/write() to block based access.
+ * @free_blocks:	free all blocks of the mmap block interface.
+ * @query_block:	fill in the descriptor of the block with the given id.
+ * @enqueue_block:	hand a block owned by the application to the buffer.
+ * @dequeue_block:	take a completed block from the buffer, or return
+ *			-EAGAIN if there is none.
+ * @mmap:		map a block into the address space of the application.
  * @modes:		Supported operating modes by this buffer type
  * @flags:		A bitmask combination of INDIO_BUFFER_FLAG_*
  *
@@ -68,6 +77,17 @@ struct iio_buffer_access_funcs {
 
 	void (*release)(struct iio_buffer *buffer);
 
+	int (*alloc_blocks)(struct iio_buffer *buffer,
+			    struct iio_buffer_block_alloc_req *req);
+	int (*free_blocks)(struct iio_buffer *buffer);
+	int (*query_block)(struct iio_buffer *buffer,
+			   struct iio_buffer_block *block);
+	int (*enqueue_block)(struct iio_buffer *buffer,
+			     struct iio_buffer_block *block);
+	int (*dequeue_block)(struct iio_buffer *buffer,
+			     struct iio_buffer_block *block);
+	int (*mmap)(struct iio_buffer *buffer, struct vm_area_struct *vma);
+
 	unsigned int modes;
 	unsigned int flags;
 };
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Power of two histograms, as used for latency statistics in debugfs and
+ * sysfs: cheap to update from hot paths and compact to print.
+ */
+#ifndef _LINUX_LOG2_HIST_H
+#define _LINUX_LOG2_HIST_H
+
+#include <linux/bitops.h>
+#include <linux/minmax.h>
+#include <linux/types.h>
+
+/**
+ * log2_hist_bucket() - bucket of a power of two histogram for a value
+ * @val: value to account, e.g. a latency
+ * @shift: log2 of the limit of the first bucket
+ * @nr_buckets: number of buckets in the histogram
+ *
+ * Bucket 0 counts values below 2^@shift. Each further bucket i counts values
+ * below 2^(@shift + i), and the last one everything from
+ * 2^(@shift + @nr_buckets - 2) up.
+ *
+ * Return: the bucket index, less than @nr_buckets.
+ */
+static inline unsigned int log2_hist_bucket(u64 val, unsigned int shift,
+					    unsigned int nr_buckets)
+{
+	return min_t(unsigned int, fls64(val >> shift), nr_buckets - 1);
+}
+
+#endif /* _LINUX_LOG2_HIST_H */
@@ -339,6 +339,9 @@ struct mmc_card {
 	unsigned int		drive_strength;	/* for UHS-I, HS200 or HS400 */
 
 	struct dentry		*debugfs_root;
+#ifdef CONFIG_DEBUG_FS
+	struct mmc_io_stats	io_stats;
+#endif
 	struct mmc_part	part[MMC_NUM_PHY_PARTITION]; /* physical partitions */
 	unsigned int    nr_parts;
 
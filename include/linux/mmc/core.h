@@ -167,6 +167,22 @@ struct mmc_request {
 	const struct bio_crypt_ctx *crypto_ctx;
 	int			crypto_key_slot;
 #endif
+#ifdef CONFIG_DEBUG_FS
+	u64			io_start_ns;	/* for the debugfs io_stats */
+#endif
+};
+
+/* Request statistics exposed through debugfs, see mmc_io_stats_show() */
+#define MMC_IO_STATS_SIZES	4	/* up to 4k, 64k, 512k and larger */
+#define MMC_IO_STATS_LAT	16	/* power of two buckets from 16us */
+#define MMC_IO_STATS_DEPTH	32
+
+struct mmc_io_stats {
+	u32	read_lat[MMC_IO_STATS_SIZES][MMC_IO_STATS_LAT];
+	u32	write_lat[MMC_IO_STATS_SIZES][MMC_IO_STATS_LAT];
+	u32	busy_lat[MMC_IO_STATS_LAT];
+	u32	cqe_depth[MMC_IO_STATS_DEPTH + 1];
+	u32	retune;
 };
 
 struct mmc_card;
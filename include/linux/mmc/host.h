@@ -528,6 +528,10 @@ struct mmc_host {
 	bool			hsq_enabled;
 
 	u32			err_stats[MMC_ERR_MAX];
+#ifdef CONFIG_DEBUG_FS
+	struct mmc_io_stats	io_stats;
+	atomic_t		cqe_in_flight;	/* CQE requests, for io_stats */
+#endif
 	unsigned long		private[] ____cacheline_aligned;
 };
 
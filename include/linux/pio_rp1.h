@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2024 Raspberry Pi Ltd.
+ * All rights reserved.
+ */
+
+#ifndef _PIO_RP1_H
+#define _PIO_RP1_H
+
+#include <uapi/misc/rp1_pio_if.h>
+
+struct rp1_pio_client;
+
+struct rp1_pio_client *rp1_pio_open(void);
+void rp1_pio_close(struct rp1_pio_client *client);
+
+int rp1_pio_add_program(struct rp1_pio_client *client,
+			const struct rp1_pio_add_program_args *args);
+int rp1_pio_remove_program(struct rp1_pio_client *client,
+			   const struct rp1_pio_remove_program_args *args);
+int rp1_pio_sm_claim(struct rp1_pio_client *client, unsigned int sm);
+int rp1_pio_sm_unclaim(struct rp1_pio_client *client, unsigned int sm);
+int rp1_pio_sm_config(struct rp1_pio_client *client,
+		      const struct rp1_pio_sm_config_args *args);
+int rp1_pio_sm_set_enabled(struct rp1_pio_client *client, unsigned int sm,
+			   bool enable);
+int rp1_pio_sm_exec(struct rp1_pio_client *client, unsigned int sm, u16 instr);
+int rp1_pio_sm_xfer_data(struct rp1_pio_client *client, unsigned int sm,
+			 unsigned int dir, void *data, size_t len);
+
+#endif
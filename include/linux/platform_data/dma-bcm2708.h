@@ -140,4 +140,22 @@ static inline int bcm_dmaman_remove(struct platform_device *pdev)
 
 #endif /* CONFIG_DMA_BCM2708 || CONFIG_DMA_BCM2708_MODULE */
 
+struct dma_chan;
+
+#if IS_ENABLED(CONFIG_DMA_BCM2835)
+
+/* return a memcpy/memset capable dmaengine channel suited to the copy */
+struct dma_chan *bcm2835_dma_request_memcpy_chan(size_t len,
+						 dma_addr_t max_addr);
+
+#else /* CONFIG_DMA_BCM2835 */
+
+static inline struct dma_chan *bcm2835_dma_request_memcpy_chan(size_t len,
+							       dma_addr_t max_addr)
+{
+	return NULL;
+}
+
+#endif /* CONFIG_DMA_BCM2835 */
+
 #endif /* _PLAT_BCM2708_DMA_H */
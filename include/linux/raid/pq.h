@@ -173,6 +173,7 @@ void raid6_dual_recov(int disks, size_t bytes, int faila, int failb,
 						     MAP_PRIVATE|MAP_ANONYMOUS,\
 						     0, 0))
 # define free_pages(x, y)	munmap((void *)(x), PAGE_SIZE << (y))
+# define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
 
 static inline void cpu_relax(void)
 {
@@ -7,6 +7,7 @@
 #ifndef _RP1_PLATFORM_H
 #define _RP1_PLATFORM_H
 
+#include <linux/types.h>
 #include <vdso/bits.h>
 
 #define RP1_B0_CHIP_ID 0x10001927
@@ -17,4 +18,18 @@
 
 void rp1_get_platform(u32 *chip_id, u32 *platform);
 
+#if IS_REACHABLE(CONFIG_MFD_RP1)
+void __iomem *rp1_sram_alloc(size_t size, dma_addr_t *dma_addr);
+void rp1_sram_free(void __iomem *vaddr, size_t size);
+#else
+static inline void __iomem *rp1_sram_alloc(size_t size, dma_addr_t *dma_addr)
+{
+	return NULL;
+}
+
+static inline void rp1_sram_free(void __iomem *vaddr, size_t size)
+{
+}
+#endif
+
 #endif
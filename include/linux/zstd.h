@@ -180,6 +180,49 @@ zstd_cctx *zstd_init_cctx(void *workspace, size_t workspace_size);
 size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size, const zstd_parameters *parameters);
 
+/* ======   Block-parallel Compression   ====== */
+
+/**
+ * zstd_compress_parallel_bound() - dst size needed by zstd_compress_parallel()
+ * @src_size:   The size of the data to compress.
+ * @chunk_size: The size of the independently compressed chunks.
+ *
+ * The chunks are compressed into worst case sized slots of dst before being
+ * packed together, so this is the sum of the chunks' compress bounds rather
+ * than zstd_compress_bound(src_size).
+ *
+ * Return:      The minimum dst_capacity to pass to zstd_compress_parallel().
+ */
+size_t zstd_compress_parallel_bound(size_t src_size, size_t chunk_size);
+
+/**
+ * zstd_compress_parallel() - compress src as independent frames in parallel
+ * @cctxs:        Compression contexts, one per concurrent worker. Each must
+ *                have been initialized with zstd_init_cctx() for parameters.
+ * @nr_cctxs:     The number of contexts, and so of concurrent workers. The
+ *                calling thread is one of them.
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of dst, at least zstd_compress_parallel_bound().
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ * @chunk_size:   The size of each independently compressed chunk, the last
+ *                one may be shorter.
+ * @parameters:   The compression parameters to be used.
+ *
+ * src is split into chunk_size pieces, each compressed as a separate zstd
+ * frame, with the work spread over nr_cctxs - 1 unbound workqueue items plus
+ * the caller. The frames are concatenated in order in dst, which any zstd
+ * decompressor, including zstd_decompress_dctx(), accepts as a single input.
+ * Matches never cross chunk boundaries, so the ratio is slightly worse than
+ * for zstd_compress_cctx() on the whole input. May sleep.
+ *
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_compress_parallel(zstd_cctx **cctxs, unsigned int nr_cctxs,
+	void *dst, size_t dst_capacity, const void *src, size_t src_size,
+	size_t chunk_size, const zstd_parameters *parameters);
+
 /* ======   Single-pass Decompression   ====== */
 
 typedef ZSTD_DCtx zstd_dctx;
@@ -27,6 +27,23 @@ struct cci_reg_sequence {
 	u64 val;
 };
 
+/* Number of register writes a struct cci_reg_batch holds before flushing */
+#define CCI_REG_BATCH_SIZE		16
+
+/**
+ * struct cci_reg_batch - CCI register writes deferred to be sent together
+ *
+ * @regs: Queued register-address, -value pairs, in the order they were queued
+ * @num_regs: Number of entries of @regs in use
+ *
+ * Initialise with cci_batch_init(), queue writes with cci_batch_write() and
+ * send them with cci_batch_flush().
+ */
+struct cci_reg_batch {
+	struct cci_reg_sequence regs[CCI_REG_BATCH_SIZE];
+	unsigned int num_regs;
+};
+
 /*
  * Macros to define register address with the register width encoded
  * into the higher bits.
@@ -117,6 +134,72 @@ int cci_update_bits(struct regmap *map, u32 reg, u64 mask, u64 val, int *err);
 int cci_multi_reg_write(struct regmap *map, const struct cci_reg_sequence *regs,
 			unsigned int num_regs, int *err);
 
+/**
+ * cci_multi_reg_write_merged() - Write multiple registers to the device,
+ *                                merging consecutive addresses
+ *
+ * @map: Register map to write to
+ * @regs: Array of structures containing register-address, -value pairs to be
+ *        written, register-addresses use CCI_REG#() macros to encode reg width
+ * @num_regs: Number of registers to write
+ * @err: Optional pointer to store errors, if a previous error is set
+ *       then the write will be skipped
+ *
+ * Like cci_multi_reg_write(), but runs of entries with consecutive register
+ * addresses are written with a single bulk transfer of up to 32 bytes. Only
+ * use this for devices known to auto-increment the register address on
+ * multi-byte writes.
+ *
+ * Return: %0 on success or a negative error code on failure.
+ */
+int cci_multi_reg_write_merged(struct regmap *map,
+			       const struct cci_reg_sequence *regs,
+			       unsigned int num_regs, int *err);
+
+/**
+ * cci_batch_init() - Initialise an empty batch of CCI register writes
+ *
+ * @batch: Batch to initialise
+ */
+static inline void cci_batch_init(struct cci_reg_batch *batch)
+{
+	batch->num_regs = 0;
+}
+
+/**
+ * cci_batch_write() - Queue a register write in a batch
+ *
+ * @map: Register map the batch will be written to
+ * @batch: Batch to queue the write in
+ * @reg: Register address, use CCI_REG#() macros to encode reg width
+ * @val: Value to be written
+ * @err: Optional pointer to store errors, if a previous error is set
+ *       then the write will be skipped
+ *
+ * The write is not sent to the device until cci_batch_flush() is called,
+ * unless @batch is full, in which case the queued writes are flushed first.
+ *
+ * Return: %0 on success or a negative error code on failure.
+ */
+int cci_batch_write(struct regmap *map, struct cci_reg_batch *batch, u32 reg,
+		    u64 val, int *err);
+
+/**
+ * cci_batch_flush() - Send the register writes queued in a batch
+ *
+ * @map: Register map to write to
+ * @batch: Batch to send, left empty on return
+ * @err: Optional pointer to store errors, if a previous error is set
+ *       then the write will be skipped
+ *
+ * The queued writes are sent in order with cci_multi_reg_write_merged(), so
+ * writes to consecutive registers go out in a single transfer. The same
+ * restriction to devices that auto-increment the register address applies.
+ *
+ * Return: %0 on success or a negative error code on failure.
+ */
+int cci_batch_flush(struct regmap *map, struct cci_reg_batch *batch, int *err);
+
 #if IS_ENABLED(CONFIG_V4L2_CCI_I2C)
 /**
  * devm_cci_regmap_init_i2c() - Create regmap to use with cci_*() register
@@ -90,6 +90,8 @@ struct v4l2_m2m_queue_ctx {
  * @queue: List of memory to memory contexts
  * @job_flags: Job queue flags, used internally by v4l2-mem2mem.c:
  *		%TRANS_QUEUED, %TRANS_RUNNING and %TRANS_ABORT.
+ * @jobs_running: Number of jobs of this context dispatched to the driver and
+ *		not finished yet, see v4l2_m2m_set_max_jobs().
  * @finished: Wait queue used to signalize when a job queue finished.
  * @priv: Instance private data
  *
@@ -117,6 +119,7 @@ struct v4l2_m2m_ctx {
 	/* For device job queue */
 	struct list_head		queue;
 	unsigned long			job_flags;
+	unsigned int			jobs_running;
 	wait_queue_head_t		finished;
 
 	void				*priv;
@@ -511,6 +514,31 @@ unsigned long v4l2_m2m_get_unmapped_area(struct file *file, unsigned long addr,
  */
 struct v4l2_m2m_dev *v4l2_m2m_init(const struct v4l2_m2m_ops *m2m_ops);
 
+/**
+ * v4l2_m2m_set_max_jobs() - let the device run several jobs at once
+ *
+ * @m2m_dev: opaque pointer to the internal data to handle M2M context
+ * @max_jobs: number of jobs the hardware can have in flight
+ *
+ * By default only one job runs at a time, and the next one is dispatched
+ * when v4l2_m2m_job_finish() is called. For hardware with an internal job
+ * queue, this allows up to @max_jobs calls to &v4l2_m2m_ops->device_run
+ * before the first job finishes. Jobs of one context are dispatched in
+ * order, and several may be in flight for the same context.
+ *
+ * With @max_jobs larger than 1 the driver must remove the buffers a job
+ * uses from the ready queues in &v4l2_m2m_ops->device_run, track its jobs
+ * itself, and complete each of them with v4l2_m2m_job_finish(), in the
+ * order they were dispatched for a given context.
+ * v4l2_m2m_get_curr_priv() and v4l2_m2m_buf_done_and_job_finish() cannot be
+ * used in that mode.
+ *
+ * Must be called before any context is created, usually right after
+ * v4l2_m2m_init().
+ */
+void v4l2_m2m_set_max_jobs(struct v4l2_m2m_dev *m2m_dev,
+			   unsigned int max_jobs);
+
 #if defined(CONFIG_MEDIA_CONTROLLER)
 void v4l2_m2m_unregister_media_controller(struct v4l2_m2m_dev *m2m_dev);
 int v4l2_m2m_register_media_controller(struct v4l2_m2m_dev *m2m_dev,
@@ -579,6 +579,9 @@ struct vb2_buf_ops {
  *		when a buffer with the %V4L2_BUF_FLAG_LAST is dequeued.
  * @fileio:	file io emulator internal data, used only if emulator is active
  * @threadio:	thread io internal data, used only if thread is active
+ * @stock_dqbuf: address of the stock VIDIOC_DQBUF handler, set by the V4L2
+ *		queue init so that the V4L2 core can tell whether a video
+ *		device dequeues through it without linking against videobuf2
  * @name:	queue name, used for logging purpose. Initialized automatically
  *		if left empty by drivers.
  */
@@ -643,6 +646,8 @@ struct vb2_queue {
 	struct vb2_fileio_data		*fileio;
 	struct vb2_threadio_data	*threadio;
 
+	const void			*stock_dqbuf;
+
 	char				name[32];
 
 #ifdef CONFIG_VIDEO_ADV_DEBUG
@@ -1136,6 +1141,24 @@ static inline bool vb2_is_streaming(struct vb2_queue *q)
 	return q->streaming;
 }
 
+/**
+ * vb2_dqbuf_would_block() - check, without the queue lock, whether a
+ *	non-blocking dequeue would find no buffer.
+ * @q:		pointer to &struct vb2_queue with videobuf2 queue.
+ *
+ * Returns true only when the queue is streaming normally and its done list is
+ * empty, in which case a non-blocking DQBUF would fail with -EAGAIN. As the
+ * lock is not held the answer may be stale by the time it is returned, but
+ * that is no different to the DQBUF having been issued a moment earlier. Any
+ * other state (not streaming, error, last buffer) returns false, so that the
+ * caller goes through the locked path and reports it properly.
+ */
+static inline bool vb2_dqbuf_would_block(struct vb2_queue *q)
+{
+	return q->streaming && !q->error && !q->waiting_in_dqbuf &&
+	       !q->last_buffer_dequeued && list_empty(&q->done_list);
+}
+
 /**
  * vb2_fileio_is_active() - return true if fileio is active.
  * @q:		pointer to &struct vb2_queue with videobuf2 queue.
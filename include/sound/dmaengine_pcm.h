@@ -36,6 +36,7 @@ snd_pcm_uframes_t snd_dmaengine_pcm_pointer_no_residue(struct snd_pcm_substream
 int snd_dmaengine_pcm_open(struct snd_pcm_substream *substream,
 	struct dma_chan *chan);
 int snd_dmaengine_pcm_close(struct snd_pcm_substream *substream);
+void snd_dmaengine_pcm_enable_timer_wakeup(struct snd_pcm_substream *substream);
 
 int snd_dmaengine_pcm_open_request_chan(struct snd_pcm_substream *substream,
 	dma_filter_fn filter_fn, void *filter_data);
@@ -109,6 +110,11 @@ int snd_dmaengine_pcm_refine_runtime_hwparams(
  * playback.
  */
 #define SND_DMAENGINE_PCM_FLAG_HALF_DUPLEX BIT(3)
+/*
+ * Generate period wakeups from a hrtimer rather than from DMA interrupts.
+ * Ignored if the DMA channels can't report the residue.
+ */
+#define SND_DMAENGINE_PCM_FLAG_TIMER_WAKEUP BIT(4)
 
 /**
  * struct snd_dmaengine_pcm_config - Configuration data for dmaengine based PCM
@@ -237,6 +237,47 @@ DEFINE_EVENT(erofs__map_blocks_exit, z_erofs_map_blocks_iter_exit,
 	TP_ARGS(inode, map, flags, ret)
 );
 
+TRACE_EVENT(z_erofs_decompress_pcluster,
+	TP_PROTO(struct super_block *sb, pgoff_t index, unsigned int alg,
+		 unsigned int inputsize, unsigned int outputsize,
+		 u64 duration, int err),
+
+	TP_ARGS(sb, index, alg, inputsize, outputsize, duration, err),
+
+	TP_STRUCT__entry(
+		__field(dev_t,		dev		)
+		__field(pgoff_t,	index		)
+		__field(unsigned int,	alg		)
+		__field(unsigned int,	inputsize	)
+		__field(unsigned int,	outputsize	)
+		__field(u64,		duration	)
+		__field(int,		cpu		)
+		__field(int,		err		)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= sb->s_dev;
+		__entry->index		= index;
+		__entry->alg		= alg;
+		__entry->inputsize	= inputsize;
+		__entry->outputsize	= outputsize;
+		__entry->duration	= duration;
+		__entry->cpu		= raw_smp_processor_id();
+		__entry->err		= err;
+	),
+
+	TP_printk("dev = (%d,%d), index = %lu, alg = %u, inputsize = %u, "
+		  "outputsize = %u, cpu = %d, duration = %llu ns, err = %d",
+		show_dev(__entry->dev),
+		(unsigned long)__entry->index,
+		__entry->alg,
+		__entry->inputsize,
+		__entry->outputsize,
+		__entry->cpu,
+		__entry->duration,
+		__entry->err)
+);
+
 TRACE_EVENT(erofs_destroy_inode,
 	TP_PROTO(struct inode *inode),
 
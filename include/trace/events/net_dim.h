@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM net_dim
+
+#if !defined(_TRACE_NET_DIM_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_NET_DIM_H
+
+#include <linux/dim.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(net_dim_decision,
+	TP_PROTO(struct dim *dim, struct dim_stats *stats, int prev_state,
+		 int prev_ix),
+
+	TP_ARGS(dim, stats, prev_state, prev_ix),
+
+	TP_STRUCT__entry(
+		__field(const void *, dim)
+		__field(u8, profile_set)
+		__field(u8, mode)
+		__field(u8, prev_state)
+		__field(u8, state)
+		__field(u8, prev_ix)
+		__field(u8, ix)
+		__field(u8, tired)
+		__field(int, ppms)
+		__field(int, bpms)
+		__field(int, epms)
+	),
+
+	TP_fast_assign(
+		__entry->dim = dim;
+		__entry->profile_set = dim->profile_set;
+		__entry->mode = dim->mode;
+		__entry->prev_state = prev_state;
+		__entry->state = dim->tune_state;
+		__entry->prev_ix = prev_ix;
+		__entry->ix = dim->profile_ix;
+		__entry->tired = dim->tired;
+		__entry->ppms = stats->ppms;
+		__entry->bpms = stats->bpms;
+		__entry->epms = stats->epms;
+	),
+
+	TP_printk("dim=%p set=%u mode=%u state=%s->%s profile=%u->%u tired=%u ppms=%d bpms=%d epms=%d",
+		  __entry->dim, __entry->profile_set, __entry->mode,
+		  __print_symbolic(__entry->prev_state,
+				   { DIM_PARKING_ON_TOP, "parked_top" },
+				   { DIM_PARKING_TIRED, "parked_tired" },
+				   { DIM_GOING_RIGHT, "right" },
+				   { DIM_GOING_LEFT, "left" }),
+		  __print_symbolic(__entry->state,
+				   { DIM_PARKING_ON_TOP, "parked_top" },
+				   { DIM_PARKING_TIRED, "parked_tired" },
+				   { DIM_GOING_RIGHT, "right" },
+				   { DIM_GOING_LEFT, "left" }),
+		  __entry->prev_ix, __entry->ix, __entry->tired,
+		  __entry->ppms, __entry->bpms, __entry->epms)
+);
+
+#endif /* _TRACE_NET_DIM_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -5,6 +5,50 @@
 #ifndef _UAPI_IIO_BUFFER_H_
 #define _UAPI_IIO_BUFFER_H_
 
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/**
+ * struct iio_buffer_block_alloc_req - Descriptor for allocating IIO buffer blocks
+ * @type:	Type of block(s), reserved, must be 0
+ * @size:	The size of a single block in bytes
+ * @count:	Number of blocks to allocate, updated with the number allocated
+ * @id:		Reserved, must be 0
+ */
+struct iio_buffer_block_alloc_req {
+	__u32 type;
+	__u32 size;
+	__u32 count;
+	__u32 id;
+};
+
+/**
+ * struct iio_buffer_block - Descriptor for a single IIO buffer block
+ * @id:		Identifier of the block, 0 .. count - 1
+ * @size:	Total size of the block in bytes
+ * @bytes_used:	Number of bytes that contain valid data
+ * @type:	Type of the block, reserved, must be 0
+ * @flags:	Block flags, reserved, must be 0
+ * @offset:	Offset to pass to mmap() to map the block
+ * @reserved:	Reserved, must be 0
+ */
+struct iio_buffer_block {
+	__u32 id;
+	__u32 size;
+	__u32 bytes_used;
+	__u32 type;
+	__u32 flags;
+	__u32 offset;
+	__u64 reserved;
+};
+
 #define IIO_BUFFER_GET_FD_IOCTL			_IOWR('i', 0x91, int)
 
+#define IIO_BUFFER_BLOCK_ALLOC_IOCTL \
+	_IOWR('i', 0xa0, struct iio_buffer_block_alloc_req)
+#define IIO_BUFFER_BLOCK_FREE_IOCTL		_IO('i', 0xa1)
+#define IIO_BUFFER_BLOCK_QUERY_IOCTL		_IOWR('i', 0xa2, struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_ENQUEUE_IOCTL		_IOWR('i', 0xa3, struct iio_buffer_block)
+#define IIO_BUFFER_BLOCK_DEQUEUE_IOCTL		_IOWR('i', 0xa4, struct iio_buffer_block)
+
 #endif /* _UAPI_IIO_BUFFER_H_ */
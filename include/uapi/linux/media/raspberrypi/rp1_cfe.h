@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-only WITH Linux-syscall-note */
+/*
+ * RP1 Camera Front End driver API
+ *
+ * Copyright (C) 2021-2022 - Raspberry Pi Ltd.
+ */
+
+#ifndef _UAPI_LINUX_MEDIA_RASPBERRYPI_RP1_CFE_H_
+#define _UAPI_LINUX_MEDIA_RASPBERRYPI_RP1_CFE_H_
+
+#include <linux/types.h>
+#include <linux/videodev2.h>
+
+/*
+ * Driver private event, sent once the first lines of a frame have been written
+ * to the buffer so that processing can start before the frame is complete.
+ * Subscribe with the id set to the number of lines, which takes effect from the
+ * next STREAMON. Only one line count can be in use on a node at a time. The
+ * payload is a struct rp1_cfe_line_event in u.data.
+ */
+#define V4L2_EVENT_RP1_CFE_LINE		(V4L2_EVENT_PRIVATE_START + 0x1000)
+
+/**
+ * struct rp1_cfe_line_event - payload of V4L2_EVENT_RP1_CFE_LINE
+ * @line: number of lines written, the id the event was subscribed with
+ * @sequence: sequence number of the frame being written
+ */
+struct rp1_cfe_line_event {
+	__u32 line;
+	__u32 sequence;
+};
+
+#endif /* _UAPI_LINUX_MEDIA_RASPBERRYPI_RP1_CFE_H_ */
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0+ WITH Linux-syscall-note */
+/*
+ * Raspberry Pi RP1 PIO block interface
+ *
+ * Copyright (c) 2024 Raspberry Pi Ltd.
+ *
+ * The PIO block is exposed as /dev/pio0. A client loads programs into the
+ * shared instruction memory, claims state machines, configures and starts
+ * them, and feeds or drains their FIFOs with DMA. Everything a file handle
+ * claimed is released again when it is closed.
+ */
+#ifndef _UAPI_MISC_RP1_PIO_IF_H
+#define _UAPI_MISC_RP1_PIO_IF_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+#define RP1_PIO_INSTRUCTION_COUNT	32
+#define RP1_PIO_SM_COUNT		4
+
+#define RP1_PIO_ORIGIN_ANY		((__u16)(~0))
+#define RP1_PIO_SM_ANY			((__u16)(~0))
+
+#define RP1_PIO_DIR_TO_SM		0
+#define RP1_PIO_DIR_FROM_SM		1
+
+/* Returns the offset the program was loaded at */
+struct rp1_pio_add_program_args {
+	__u16 num_instrs;
+	__u16 origin;		/* or RP1_PIO_ORIGIN_ANY */
+	__u16 instrs[RP1_PIO_INSTRUCTION_COUNT];
+};
+
+struct rp1_pio_remove_program_args {
+	__u16 num_instrs;
+	__u16 origin;
+};
+
+/* Returns the claimed state machine */
+struct rp1_pio_sm_claim_args {
+	__u16 sm;		/* or RP1_PIO_SM_ANY */
+	__u16 rsvd;
+};
+
+/*
+ * The register values use the hardware layout of SMx_CLKDIV, SMx_EXECCTRL,
+ * SMx_SHIFTCTRL and SMx_PINCTRL. Configuring a state machine stops it,
+ * clears its FIFOs and makes it jump to initial_pc.
+ */
+struct rp1_pio_sm_config_args {
+	__u16 sm;
+	__u16 initial_pc;
+	__u32 clkdiv;
+	__u32 execctrl;
+	__u32 shiftctrl;
+	__u32 pinctrl;
+};
+
+struct rp1_pio_sm_set_enabled_args {
+	__u16 sm;
+	__u8 enable;
+	__u8 rsvd;
+};
+
+struct rp1_pio_sm_exec_args {
+	__u16 sm;
+	__u16 instr;
+};
+
+/* data_bytes must be a multiple of 4, the FIFOs are 32 bits wide */
+struct rp1_pio_sm_xfer_data_args {
+	__u16 sm;
+	__u16 dir;		/* RP1_PIO_DIR_* */
+	__u32 data_bytes;
+	__u64 data;		/* user pointer */
+};
+
+#define PIO_IOC_MAGIC 102
+
+#define PIO_IOC_ADD_PROGRAM \
+	_IOW(PIO_IOC_MAGIC, 0, struct rp1_pio_add_program_args)
+#define PIO_IOC_REMOVE_PROGRAM \
+	_IOW(PIO_IOC_MAGIC, 1, struct rp1_pio_remove_program_args)
+#define PIO_IOC_SM_CLAIM \
+	_IOW(PIO_IOC_MAGIC, 2, struct rp1_pio_sm_claim_args)
+#define PIO_IOC_SM_UNCLAIM \
+	_IOW(PIO_IOC_MAGIC, 3, struct rp1_pio_sm_claim_args)
+#define PIO_IOC_SM_CONFIG \
+	_IOW(PIO_IOC_MAGIC, 4, struct rp1_pio_sm_config_args)
+#define PIO_IOC_SM_SET_ENABLED \
+	_IOW(PIO_IOC_MAGIC, 5, struct rp1_pio_sm_set_enabled_args)
+#define PIO_IOC_SM_EXEC \
+	_IOW(PIO_IOC_MAGIC, 6, struct rp1_pio_sm_exec_args)
+#define PIO_IOC_SM_XFER_DATA \
+	_IOW(PIO_IOC_MAGIC, 7, struct rp1_pio_sm_xfer_data_args)
+
+#endif /* _UAPI_MISC_RP1_PIO_IF_H */
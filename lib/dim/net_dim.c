@@ -5,6 +5,9 @@
 
 #include <linux/dim.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/net_dim.h>
+
 /*
  * Net DIM profiles:
  *        There are different set of profiles for each CQ period mode.
@@ -49,55 +52,142 @@
 	{.usec = 64, .pkts = 32,}   \
 }
 
+/*
+ * Low power profiles: on a Cortex-A53/A72 class core an interrupt plus NAPI
+ * poll costs several microseconds, so start at 8us and batch harder as the
+ * load goes up rather than chasing the last microsecond of latency.
+ */
+#define NET_DIM_LP_RX_EQE_PROFILES { \
+	{.usec = 8,   .pkts = 32,},  \
+	{.usec = 16,  .pkts = 64,},  \
+	{.usec = 32,  .pkts = 128,}, \
+	{.usec = 64,  .pkts = 256,}, \
+	{.usec = 128, .pkts = 256,}  \
+}
+
+#define NET_DIM_LP_RX_CQE_PROFILES { \
+	{.usec = 8,   .pkts = 32,},  \
+	{.usec = 16,  .pkts = 32,},  \
+	{.usec = 32,  .pkts = 64,},  \
+	{.usec = 64,  .pkts = 64,},  \
+	{.usec = 128, .pkts = 128,}  \
+}
+
+#define NET_DIM_LP_TX_EQE_PROFILES { \
+	{.usec = 16,  .pkts = 64,},  \
+	{.usec = 32,  .pkts = 128,}, \
+	{.usec = 64,  .pkts = 128,}, \
+	{.usec = 128, .pkts = 128,}, \
+	{.usec = 256, .pkts = 128,}  \
+}
+
+#define NET_DIM_LP_TX_CQE_PROFILES { \
+	{.usec = 16,  .pkts = 32,},  \
+	{.usec = 32,  .pkts = 32,},  \
+	{.usec = 64,  .pkts = 64,},  \
+	{.usec = 128, .pkts = 64,},  \
+	{.usec = 256, .pkts = 64,}   \
+}
+
 static const struct dim_cq_moder
-rx_profile[DIM_CQ_PERIOD_NUM_MODES][NET_DIM_PARAMS_NUM_PROFILES] = {
-	NET_DIM_RX_EQE_PROFILES,
-	NET_DIM_RX_CQE_PROFILES,
+rx_profile[NET_DIM_NUM_PROFILE_SETS][DIM_CQ_PERIOD_NUM_MODES]
+	  [NET_DIM_PARAMS_NUM_PROFILES] = {
+	[NET_DIM_PROFILE_SET_DEFAULT] = {
+		NET_DIM_RX_EQE_PROFILES,
+		NET_DIM_RX_CQE_PROFILES,
+	},
+	[NET_DIM_PROFILE_SET_LOW_POWER] = {
+		NET_DIM_LP_RX_EQE_PROFILES,
+		NET_DIM_LP_RX_CQE_PROFILES,
+	},
 };
 
 static const struct dim_cq_moder
-tx_profile[DIM_CQ_PERIOD_NUM_MODES][NET_DIM_PARAMS_NUM_PROFILES] = {
-	NET_DIM_TX_EQE_PROFILES,
-	NET_DIM_TX_CQE_PROFILES,
+tx_profile[NET_DIM_NUM_PROFILE_SETS][DIM_CQ_PERIOD_NUM_MODES]
+	  [NET_DIM_PARAMS_NUM_PROFILES] = {
+	[NET_DIM_PROFILE_SET_DEFAULT] = {
+		NET_DIM_TX_EQE_PROFILES,
+		NET_DIM_TX_CQE_PROFILES,
+	},
+	[NET_DIM_PROFILE_SET_LOW_POWER] = {
+		NET_DIM_LP_TX_EQE_PROFILES,
+		NET_DIM_LP_TX_CQE_PROFILES,
+	},
 };
 
+static u8 net_dim_def_profile_ix(u8 cq_period_mode)
+{
+	return cq_period_mode == DIM_CQ_PERIOD_MODE_START_FROM_CQE ?
+	       NET_DIM_DEF_PROFILE_CQE : NET_DIM_DEF_PROFILE_EQE;
+}
+
 struct dim_cq_moder
-net_dim_get_rx_moderation(u8 cq_period_mode, int ix)
+net_dim_get_rx_moderation_set(u8 profile_set, u8 cq_period_mode, int ix)
 {
-	struct dim_cq_moder cq_moder = rx_profile[cq_period_mode][ix];
+	struct dim_cq_moder cq_moder =
+		rx_profile[profile_set][cq_period_mode][ix];
 
 	cq_moder.cq_period_mode = cq_period_mode;
 	return cq_moder;
 }
+EXPORT_SYMBOL(net_dim_get_rx_moderation_set);
+
+struct dim_cq_moder
+net_dim_get_def_rx_moderation_set(u8 profile_set, u8 cq_period_mode)
+{
+	return net_dim_get_rx_moderation_set(profile_set, cq_period_mode,
+					     net_dim_def_profile_ix(cq_period_mode));
+}
+EXPORT_SYMBOL(net_dim_get_def_rx_moderation_set);
+
+struct dim_cq_moder
+net_dim_get_tx_moderation_set(u8 profile_set, u8 cq_period_mode, int ix)
+{
+	struct dim_cq_moder cq_moder =
+		tx_profile[profile_set][cq_period_mode][ix];
+
+	cq_moder.cq_period_mode = cq_period_mode;
+	return cq_moder;
+}
+EXPORT_SYMBOL(net_dim_get_tx_moderation_set);
+
+struct dim_cq_moder
+net_dim_get_def_tx_moderation_set(u8 profile_set, u8 cq_period_mode)
+{
+	return net_dim_get_tx_moderation_set(profile_set, cq_period_mode,
+					     net_dim_def_profile_ix(cq_period_mode));
+}
+EXPORT_SYMBOL(net_dim_get_def_tx_moderation_set);
+
+struct dim_cq_moder
+net_dim_get_rx_moderation(u8 cq_period_mode, int ix)
+{
+	return net_dim_get_rx_moderation_set(NET_DIM_PROFILE_SET_DEFAULT,
+					     cq_period_mode, ix);
+}
 EXPORT_SYMBOL(net_dim_get_rx_moderation);
 
 struct dim_cq_moder
 net_dim_get_def_rx_moderation(u8 cq_period_mode)
 {
-	u8 profile_ix = cq_period_mode == DIM_CQ_PERIOD_MODE_START_FROM_CQE ?
-			NET_DIM_DEF_PROFILE_CQE : NET_DIM_DEF_PROFILE_EQE;
-
-	return net_dim_get_rx_moderation(cq_period_mode, profile_ix);
+	return net_dim_get_def_rx_moderation_set(NET_DIM_PROFILE_SET_DEFAULT,
+						 cq_period_mode);
 }
 EXPORT_SYMBOL(net_dim_get_def_rx_moderation);
 
 struct dim_cq_moder
 net_dim_get_tx_moderation(u8 cq_period_mode, int ix)
 {
-	struct dim_cq_moder cq_moder = tx_profile[cq_period_mode][ix];
-
-	cq_moder.cq_period_mode = cq_period_mode;
-	return cq_moder;
+	return net_dim_get_tx_moderation_set(NET_DIM_PROFILE_SET_DEFAULT,
+					     cq_period_mode, ix);
 }
 EXPORT_SYMBOL(net_dim_get_tx_moderation);
 
 struct dim_cq_moder
 net_dim_get_def_tx_moderation(u8 cq_period_mode)
 {
-	u8 profile_ix = cq_period_mode == DIM_CQ_PERIOD_MODE_START_FROM_CQE ?
-			NET_DIM_DEF_PROFILE_CQE : NET_DIM_DEF_PROFILE_EQE;
-
-	return net_dim_get_tx_moderation(cq_period_mode, profile_ix);
+	return net_dim_get_def_tx_moderation_set(NET_DIM_PROFILE_SET_DEFAULT,
+						 cq_period_mode);
 }
 EXPORT_SYMBOL(net_dim_get_def_tx_moderation);
 
@@ -208,6 +298,8 @@ static bool net_dim_decision(struct dim_stats *curr_stats, struct dim *dim)
 		break;
 	}
 
+	trace_net_dim_decision(dim, curr_stats, prev_state, prev_ix);
+
 	if (prev_state != DIM_PARKING_ON_TOP ||
 	    dim->tune_state != DIM_PARKING_ON_TOP)
 		dim->prev_stats = *curr_stats;
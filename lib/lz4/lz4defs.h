@@ -183,6 +183,38 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	} while (d < e);
 }
 
+/*
+ * Same contract as LZ4_wildCopy(), moving 16 bytes per step while at least
+ * that much is left and finishing with 8 byte steps, so it never writes
+ * further past dstEnd than LZ4_wildCopy() does. Both words of a step are
+ * loaded before either is stored, so the source may overlap the destination
+ * as long as it is ahead of it or at least 16 bytes behind it. On arm64 a
+ * step is a single ldp/stp pair.
+ */
+static FORCE_INLINE void LZ4_wildCopy16(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+#if LZ4_ARCH64
+	BYTE *d = (BYTE *)dstPtr;
+	const BYTE *s = (const BYTE *)srcPtr;
+	BYTE *const e = (BYTE *)dstEnd;
+
+	while (e - d >= 16) {
+		U64 a = get_unaligned((const U64 *)s);
+		U64 b = get_unaligned((const U64 *)s + 1);
+
+		put_unaligned(a, (U64 *)d);
+		put_unaligned(b, (U64 *)d + 1);
+		d += 16;
+		s += 16;
+	}
+	if (d < e)
+		LZ4_wildCopy(d, s, e);
+#else
+	LZ4_wildCopy(dstPtr, srcPtr, dstEnd);
+#endif
+}
+
 static FORCE_INLINE unsigned int LZ4_NbCommonBytes(register size_t val)
 {
 #if LZ4_LITTLE_ENDIAN
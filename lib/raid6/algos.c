@@ -18,6 +18,7 @@
 #else
 #include <linux/module.h>
 #include <linux/gfp.h>
+#include <linux/sysfs.h>
 /* In .bss so it's zeroed */
 const char raid6_empty_zero_page[PAGE_SIZE] __attribute__((aligned(256)));
 EXPORT_SYMBOL(raid6_empty_zero_page);
@@ -135,6 +136,37 @@ const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #define RAID6_TEST_DISKS	8
 #define RAID6_TEST_DISKS_ORDER	3
 
+/* Boot time benchmark results in MB/s, 0 when not measured */
+static unsigned long raid6_gen_mbps[ARRAY_SIZE(raid6_algos)];
+static unsigned long raid6_xor_mbps;
+
+#ifdef __KERNEL__
+static int raid6_benchmark_get(char *buf, const struct kernel_param *kp)
+{
+	int i, len = 0;
+
+	for (i = 0; raid6_algos[i]; i++) {
+		if (!raid6_gen_mbps[i])
+			continue;
+		len += sysfs_emit_at(buf, len, "%s gen %lu%s\n",
+				     raid6_algos[i]->name, raid6_gen_mbps[i],
+				     raid6_algos[i]->name == raid6_call.name ?
+				     " *" : "");
+	}
+	if (raid6_xor_mbps)
+		len += sysfs_emit_at(buf, len, "%s xor %lu\n", raid6_call.name,
+				     raid6_xor_mbps);
+
+	return len;
+}
+
+static const struct kernel_param_ops raid6_benchmark_ops = {
+	.get = raid6_benchmark_get,
+};
+module_param_cb(benchmark, &raid6_benchmark_ops, NULL, 0444);
+MODULE_PARM_DESC(benchmark, "Boot time gen()/xor() throughput in MB/s, the selected algorithm is marked with *");
+#endif
+
 static inline const struct raid6_recov_calls *raid6_choose_recov(void)
 {
 	const struct raid6_recov_calls *const *algo;
@@ -191,9 +223,10 @@ static inline const struct raid6_calls *raid6_choose_gen(
 				bestgenperf = perf;
 				best = *algo;
 			}
+			raid6_gen_mbps[algo - raid6_algos] = (perf * HZ * (disks-2)) >>
+				(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2);
 			pr_info("raid6: %-8s gen() %5ld MB/s\n", (*algo)->name,
-				(perf * HZ * (disks-2)) >>
-				(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2));
+				raid6_gen_mbps[algo - raid6_algos]);
 		}
 	}
 
@@ -230,9 +263,10 @@ static inline const struct raid6_calls *raid6_choose_gen(
 		}
 		preempt_enable();
 
+		raid6_xor_mbps = (perf * HZ * (disks - 2)) >>
+			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2 + 1);
 		pr_info("raid6: .... xor() %ld MB/s, rmw enabled\n",
-			(perf * HZ * (disks - 2)) >>
-			(20 - PAGE_SHIFT + RAID6_TIME_JIFFIES_LG2 + 1));
+			raid6_xor_mbps);
 	}
 
 out:
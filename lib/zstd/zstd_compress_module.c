@@ -11,7 +11,9 @@
 
 #include <linux/kernel.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/workqueue.h>
 #include <linux/zstd.h>
 
 #include "common/zstd_deps.h"
@@ -101,6 +103,119 @@ size_t zstd_compress_cctx(zstd_cctx *cctx, void *dst, size_t dst_capacity,
 }
 EXPORT_SYMBOL(zstd_compress_cctx);
 
+struct zstd_parallel_worker {
+	struct work_struct work;
+	zstd_cctx *cctx;
+	unsigned int first;
+	/* Shared description of the job */
+	unsigned int stride;
+	unsigned int nr_chunks;
+	void *dst;
+	size_t slot_size;
+	const void *src;
+	size_t src_size;
+	size_t chunk_size;
+	const zstd_parameters *parameters;
+	size_t *sizes;
+};
+
+/* Compress chunks first, first + stride, ... each into its own dst slot */
+static void zstd_parallel_compress_chunks(struct zstd_parallel_worker *w)
+{
+	unsigned int i;
+
+	for (i = w->first; i < w->nr_chunks; i += w->stride) {
+		size_t const offset = (size_t)i * w->chunk_size;
+		size_t const len = min(w->chunk_size, w->src_size - offset);
+
+		w->sizes[i] = zstd_compress_cctx(w->cctx,
+			(char *)w->dst + (size_t)i * w->slot_size, w->slot_size,
+			(const char *)w->src + offset, len, w->parameters);
+	}
+}
+
+static void zstd_parallel_work(struct work_struct *work)
+{
+	zstd_parallel_compress_chunks(
+		container_of(work, struct zstd_parallel_worker, work));
+}
+
+size_t zstd_compress_parallel_bound(size_t src_size, size_t chunk_size)
+{
+	size_t const nr_chunks = DIV_ROUND_UP(src_size, chunk_size);
+
+	return nr_chunks * ZSTD_compressBound(chunk_size);
+}
+
+size_t zstd_compress_parallel(zstd_cctx **cctxs, unsigned int nr_cctxs,
+	void *dst, size_t dst_capacity, const void *src, size_t src_size,
+	size_t chunk_size, const zstd_parameters *parameters)
+{
+	struct zstd_parallel_worker *workers;
+	unsigned int nr_chunks, i;
+	size_t *sizes;
+	size_t total = 0;
+
+	if (!nr_cctxs || !chunk_size)
+		return ERROR(parameter_outOfBound);
+	if (nr_cctxs == 1 || src_size <= chunk_size)
+		return zstd_compress_cctx(cctxs[0], dst, dst_capacity, src,
+			src_size, parameters);
+	if (dst_capacity < zstd_compress_parallel_bound(src_size, chunk_size))
+		return ERROR(dstSize_tooSmall);
+
+	nr_chunks = DIV_ROUND_UP(src_size, chunk_size);
+	nr_cctxs = min(nr_cctxs, nr_chunks);
+
+	workers = kcalloc(nr_cctxs, sizeof(*workers), GFP_KERNEL);
+	sizes = kcalloc(nr_chunks, sizeof(*sizes), GFP_KERNEL);
+	if (!workers || !sizes) {
+		total = ERROR(memory_allocation);
+		goto out;
+	}
+
+	for (i = 0; i < nr_cctxs; i++) {
+		struct zstd_parallel_worker *w = &workers[i];
+
+		w->cctx = cctxs[i];
+		w->first = i;
+		w->stride = nr_cctxs;
+		w->nr_chunks = nr_chunks;
+		w->dst = dst;
+		w->slot_size = ZSTD_compressBound(chunk_size);
+		w->src = src;
+		w->src_size = src_size;
+		w->chunk_size = chunk_size;
+		w->parameters = parameters;
+		w->sizes = sizes;
+		INIT_WORK(&w->work, zstd_parallel_work);
+		if (i)
+			queue_work(system_unbound_wq, &w->work);
+	}
+
+	zstd_parallel_compress_chunks(&workers[0]);
+	for (i = 1; i < nr_cctxs; i++)
+		flush_work(&workers[i].work);
+
+	/* Pack the frames; slot i never starts before the packed offset */
+	for (i = 0; i < nr_chunks; i++) {
+		if (ZSTD_isError(sizes[i])) {
+			total = sizes[i];
+			goto out;
+		}
+		if (total != (size_t)i * workers[0].slot_size)
+			memmove((char *)dst + total,
+				(char *)dst + (size_t)i * workers[0].slot_size,
+				sizes[i]);
+		total += sizes[i];
+	}
+
+out:
+	kfree(sizes);
+	kfree(workers);
+	return total;
+}
+
 size_t zstd_cstream_workspace_bound(const zstd_compression_parameters *cparams)
 {
 	return ZSTD_estimateCStreamSize_usingCParams(*cparams);
@@ -10,6 +10,7 @@
 #include <linux/damon.h>
 #include <linux/kstrtox.h>
 #include <linux/module.h>
+#include <linux/psi.h>
 
 #include "modules-common.h"
 
@@ -107,6 +108,38 @@ module_param(monitor_region_end, ulong, 0600);
 static bool skip_anon __read_mostly;
 module_param(skip_anon, bool, 0600);
 
+/*
+ * Reclaim anonymous pages only.
+ *
+ * If this parameter is set as ``Y``, DAMON_RECLAIM pages out only anonymous
+ * pages, leaving the page cache to the regular reclaim.  On systems swapping
+ * to zram this turns cold anonymous memory into compressed memory ahead of
+ * demand.  Ignored if ``skip_anon`` is set.  By default, ``N``.
+ */
+static bool anon_only __read_mostly;
+module_param(anon_only, bool, 0600);
+
+/*
+ * Desired level of memory pressure, in microseconds per second.
+ *
+ * If this is non-zero, DAMON_RECLAIM tunes its size quota every few seconds
+ * so that the system-wide "some" memory pressure stall time stays around this
+ * value: the quota grows, up to ``quota_sz``, while the measured stall is
+ * lower, and shrinks proportionally while it is higher.  This lets it free
+ * memory as aggressively as the workload tolerates before direct reclaim
+ * stalls kick in.  Needs CONFIG_PSI.  0 (disabled) by default.
+ */
+static unsigned long quota_mem_pressure_us __read_mostly;
+module_param(quota_mem_pressure_us, ulong, 0600);
+
+/*
+ * Size quota currently applied by the memory pressure feedback.
+ *
+ * Read only.  0 while the feedback is disabled.
+ */
+static unsigned long quota_mem_pressure_sz __read_mostly;
+module_param(quota_mem_pressure_sz, ulong, 0400);
+
 /*
  * PID of the DAMON thread
  *
@@ -178,8 +211,11 @@ static int damon_reclaim_apply_parameters(void)
 			damon_reclaim_copy_quota_status(&scheme->quota,
 					&old_scheme->quota);
 	}
-	if (skip_anon) {
-		filter = damos_new_filter(DAMOS_FILTER_TYPE_ANON, true);
+	if (quota_mem_pressure_us && quota_mem_pressure_sz)
+		scheme->quota.sz = quota_mem_pressure_sz;
+	if (skip_anon || anon_only) {
+		/* matching anon pages are excluded, non-matching ones for anon_only */
+		filter = damos_new_filter(DAMOS_FILTER_TYPE_ANON, skip_anon);
 		if (!filter) {
 			/* Will be freed by next 'damon_set_schemes()' below */
 			damon_destroy_scheme(scheme);
@@ -264,13 +300,70 @@ static int damon_reclaim_handle_commit_inputs(void)
 	return err;
 }
 
+#ifdef CONFIG_PSI
+/* PSI totals only advance every 2 seconds, look at a few of those at once */
+#define DAMON_RECLAIM_PSI_WINDOW_MS	6000
+
+static unsigned long psi_window_start;
+static u64 psi_window_total;
+
+static void damon_reclaim_psi_feedback(struct damos *s)
+{
+	unsigned long max_sz = damon_reclaim_quota.sz ?: ULONG_MAX;
+	unsigned long target = quota_mem_pressure_us;
+	unsigned long sz, stall;
+	u64 total;
+
+	if (!target) {
+		quota_mem_pressure_sz = 0;
+		return;
+	}
+
+	if (!quota_mem_pressure_sz) {
+		/* Start from the static quota, or 128 MiB if there is none */
+		quota_mem_pressure_sz = damon_reclaim_quota.sz ?:
+					128 * 1024 * 1024;
+		psi_window_start = jiffies;
+		psi_window_total = psi_system.total[PSI_AVGS][PSI_MEM_SOME];
+		s->quota.sz = quota_mem_pressure_sz;
+		return;
+	}
+
+	if (time_before(jiffies, psi_window_start +
+			msecs_to_jiffies(DAMON_RECLAIM_PSI_WINDOW_MS)))
+		return;
+
+	total = psi_system.total[PSI_AVGS][PSI_MEM_SOME];
+	stall = div_u64(total - psi_window_total,
+			NSEC_PER_USEC * (DAMON_RECLAIM_PSI_WINDOW_MS / 1000));
+	psi_window_total = total;
+	psi_window_start = jiffies;
+
+	sz = quota_mem_pressure_sz;
+	if (stall < target)
+		/* Up to double when there is no pressure at all */
+		sz += max(mult_frac(sz, target - stall, target), PAGE_SIZE);
+	else
+		sz = mult_frac(sz, target, stall);
+
+	quota_mem_pressure_sz = clamp(sz, PAGE_SIZE, max_sz);
+	s->quota.sz = quota_mem_pressure_sz;
+}
+#else
+static void damon_reclaim_psi_feedback(struct damos *s)
+{
+}
+#endif
+
 static int damon_reclaim_after_aggregation(struct damon_ctx *c)
 {
 	struct damos *s;
 
 	/* update the stats parameter */
-	damon_for_each_scheme(s, c)
+	damon_for_each_scheme(s, c) {
 		damon_reclaim_stat = s->stat;
+		damon_reclaim_psi_feedback(s);
+	}
 
 	return damon_reclaim_handle_commit_inputs();
 }
@@ -95,8 +95,8 @@ struct cf_mod {
 		u8 xor;
 		u8 set;
 	} modtype;
-	void (*modfunc[MAX_MODFUNCTIONS])(struct canfd_frame *cf,
-					  struct cf_mod *mod);
+	u8 modop[MAX_MODFUNCTIONS];
+	u8 modops;
 
 	/* CAN frame checksum calculation after CAN frame modifications */
 	struct {
@@ -104,14 +104,50 @@ struct cf_mod {
 		struct cgw_csum_crc8 crc8;
 	} csum;
 	struct {
-		void (*xor)(struct canfd_frame *cf,
-			    struct cgw_csum_xor *xor);
-		void (*crc8)(struct canfd_frame *cf,
-			     struct cgw_csum_crc8 *crc8);
-	} csumfunc;
+		u8 xor;
+		u8 crc8;
+	} csumop;
 	u32 uid;
 };
 
+/* Modification and checksum operations, selected when the job is created.
+ * can_can_gw_rcv() dispatches them through a switch statement instead of
+ * function pointers to avoid an indirect call per operation and frame.
+ */
+enum {
+	CGW_MODOP_AND_ID,
+	CGW_MODOP_AND_LEN,
+	CGW_MODOP_AND_FLAGS,
+	CGW_MODOP_AND_DATA,
+	CGW_MODOP_AND_FDDATA,
+	CGW_MODOP_AND_CCDLC,
+	CGW_MODOP_OR_ID,
+	CGW_MODOP_OR_LEN,
+	CGW_MODOP_OR_FLAGS,
+	CGW_MODOP_OR_DATA,
+	CGW_MODOP_OR_FDDATA,
+	CGW_MODOP_OR_CCDLC,
+	CGW_MODOP_XOR_ID,
+	CGW_MODOP_XOR_LEN,
+	CGW_MODOP_XOR_FLAGS,
+	CGW_MODOP_XOR_DATA,
+	CGW_MODOP_XOR_FDDATA,
+	CGW_MODOP_XOR_CCDLC,
+	CGW_MODOP_SET_ID,
+	CGW_MODOP_SET_LEN,
+	CGW_MODOP_SET_FLAGS,
+	CGW_MODOP_SET_DATA,
+	CGW_MODOP_SET_FDDATA,
+	CGW_MODOP_SET_CCDLC,
+};
+
+enum {
+	CGW_CSOP_NONE,
+	CGW_CSOP_REL,	/* relative (negative) indices */
+	CGW_CSOP_POS,	/* absolute indices, from_idx <= to_idx */
+	CGW_CSOP_NEG,	/* absolute indices, from_idx > to_idx */
+};
+
 /* So far we just support CAN -> CAN routing and frame modifications.
  *
  * The internal can_can_gw structure contains data and attributes for
@@ -453,13 +489,121 @@ static void cgw_csum_crc8_neg(struct canfd_frame *cf,
 	cf->data[crc8->result_idx] = crc ^ crc8->final_xor_val;
 }
 
+static void cgw_mod_apply(struct canfd_frame *cf, struct cf_mod *mod)
+{
+	int i;
+
+	for (i = 0; i < mod->modops; i++) {
+		switch (mod->modop[i]) {
+		case CGW_MODOP_AND_ID:
+			mod_and_id(cf, mod);
+			break;
+		case CGW_MODOP_AND_LEN:
+			mod_and_len(cf, mod);
+			break;
+		case CGW_MODOP_AND_FLAGS:
+			mod_and_flags(cf, mod);
+			break;
+		case CGW_MODOP_AND_DATA:
+			mod_and_data(cf, mod);
+			break;
+		case CGW_MODOP_AND_FDDATA:
+			mod_and_fddata(cf, mod);
+			break;
+		case CGW_MODOP_AND_CCDLC:
+			mod_and_ccdlc(cf, mod);
+			break;
+		case CGW_MODOP_OR_ID:
+			mod_or_id(cf, mod);
+			break;
+		case CGW_MODOP_OR_LEN:
+			mod_or_len(cf, mod);
+			break;
+		case CGW_MODOP_OR_FLAGS:
+			mod_or_flags(cf, mod);
+			break;
+		case CGW_MODOP_OR_DATA:
+			mod_or_data(cf, mod);
+			break;
+		case CGW_MODOP_OR_FDDATA:
+			mod_or_fddata(cf, mod);
+			break;
+		case CGW_MODOP_OR_CCDLC:
+			mod_or_ccdlc(cf, mod);
+			break;
+		case CGW_MODOP_XOR_ID:
+			mod_xor_id(cf, mod);
+			break;
+		case CGW_MODOP_XOR_LEN:
+			mod_xor_len(cf, mod);
+			break;
+		case CGW_MODOP_XOR_FLAGS:
+			mod_xor_flags(cf, mod);
+			break;
+		case CGW_MODOP_XOR_DATA:
+			mod_xor_data(cf, mod);
+			break;
+		case CGW_MODOP_XOR_FDDATA:
+			mod_xor_fddata(cf, mod);
+			break;
+		case CGW_MODOP_XOR_CCDLC:
+			mod_xor_ccdlc(cf, mod);
+			break;
+		case CGW_MODOP_SET_ID:
+			mod_set_id(cf, mod);
+			break;
+		case CGW_MODOP_SET_LEN:
+			mod_set_len(cf, mod);
+			break;
+		case CGW_MODOP_SET_FLAGS:
+			mod_set_flags(cf, mod);
+			break;
+		case CGW_MODOP_SET_DATA:
+			mod_set_data(cf, mod);
+			break;
+		case CGW_MODOP_SET_FDDATA:
+			mod_set_fddata(cf, mod);
+			break;
+		case CGW_MODOP_SET_CCDLC:
+			mod_set_ccdlc(cf, mod);
+			break;
+		}
+	}
+}
+
+static void cgw_csum_apply(struct canfd_frame *cf, struct cf_mod *mod)
+{
+	switch (mod->csumop.crc8) {
+	case CGW_CSOP_REL:
+		cgw_csum_crc8_rel(cf, &mod->csum.crc8);
+		break;
+	case CGW_CSOP_POS:
+		cgw_csum_crc8_pos(cf, &mod->csum.crc8);
+		break;
+	case CGW_CSOP_NEG:
+		cgw_csum_crc8_neg(cf, &mod->csum.crc8);
+		break;
+	}
+
+	switch (mod->csumop.xor) {
+	case CGW_CSOP_REL:
+		cgw_csum_xor_rel(cf, &mod->csum.xor);
+		break;
+	case CGW_CSOP_POS:
+		cgw_csum_xor_pos(cf, &mod->csum.xor);
+		break;
+	case CGW_CSOP_NEG:
+		cgw_csum_xor_neg(cf, &mod->csum.xor);
+		break;
+	}
+}
+
 /* the receive & process & send function */
 static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 {
 	struct cgw_job *gwj = (struct cgw_job *)data;
 	struct canfd_frame *cf;
 	struct sk_buff *nskb;
-	int modidx = 0;
 
 	/* process strictly Classic CAN or CAN FD frames */
 	if (gwj->flags & CGW_FLAGS_CAN_FD) {
@@ -506,7 +650,7 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 	 * When there is at least one modification function activated,
 	 * we need to copy the skb as we want to modify skb->data.
 	 */
-	if (gwj->mod.modfunc[0])
+	if (gwj->mod.modops)
 		nskb = skb_copy(skb, GFP_ATOMIC);
 	else
 		nskb = skb_clone(skb, GFP_ATOMIC);
@@ -528,15 +672,14 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 	/* pointer to modifiable CAN frame */
 	cf = (struct canfd_frame *)nskb->data;
 
-	/* perform preprocessed modification functions if there are any */
-	while (modidx < MAX_MODFUNCTIONS && gwj->mod.modfunc[modidx])
-		(*gwj->mod.modfunc[modidx++])(cf, &gwj->mod);
-
 	/* Has the CAN frame been modified? */
-	if (modidx) {
+	if (gwj->mod.modops) {
 		/* get available space for the processed CAN frame type */
 		int max_len = nskb->len - offsetof(struct canfd_frame, data);
 
+		/* perform the preprocessed modification operations */
+		cgw_mod_apply(cf, &gwj->mod);
+
 		/* dlc may have changed, make sure it fits to the CAN frame */
 		if (cf->len > max_len) {
 			/* delete frame due to misconfiguration */
@@ -546,11 +689,7 @@ static void can_can_gw_rcv(struct sk_buff *skb, void *data)
 		}
 
 		/* check for checksum updates */
-		if (gwj->mod.csumfunc.crc8)
-			(*gwj->mod.csumfunc.crc8)(cf, &gwj->mod.csum.crc8);
-
-		if (gwj->mod.csumfunc.xor)
-			(*gwj->mod.csumfunc.xor)(cf, &gwj->mod.csum.xor);
+		cgw_csum_apply(cf, &gwj->mod);
 	}
 
 	/* clear the skb timestamp if not configured the other way */
@@ -717,13 +856,13 @@ static int cgw_put_job(struct sk_buff *skb, struct cgw_job *gwj, int type,
 			goto cancel;
 	}
 
-	if (gwj->mod.csumfunc.crc8) {
+	if (gwj->mod.csumop.crc8) {
 		if (nla_put(skb, CGW_CS_CRC8, CGW_CS_CRC8_LEN,
 			    &gwj->mod.csum.crc8) < 0)
 			goto cancel;
 	}
 
-	if (gwj->mod.csumfunc.xor) {
+	if (gwj->mod.csumop.xor) {
 		if (nla_put(skb, CGW_CS_XOR, CGW_CS_XOR_LEN,
 			    &gwj->mod.csum.xor) < 0)
 			goto cancel;
@@ -831,16 +970,16 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.and = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_and_id;
+				mod->modop[modidx++] = CGW_MODOP_AND_ID;
 
 			if (mb.modtype & CGW_MOD_LEN)
-				mod->modfunc[modidx++] = mod_and_len;
+				mod->modop[modidx++] = CGW_MODOP_AND_LEN;
 
 			if (mb.modtype & CGW_MOD_FLAGS)
-				mod->modfunc[modidx++] = mod_and_flags;
+				mod->modop[modidx++] = CGW_MODOP_AND_FLAGS;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_and_fddata;
+				mod->modop[modidx++] = CGW_MODOP_AND_FDDATA;
 		}
 
 		if (tb[CGW_FDMOD_OR]) {
@@ -850,16 +989,16 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.or = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_or_id;
+				mod->modop[modidx++] = CGW_MODOP_OR_ID;
 
 			if (mb.modtype & CGW_MOD_LEN)
-				mod->modfunc[modidx++] = mod_or_len;
+				mod->modop[modidx++] = CGW_MODOP_OR_LEN;
 
 			if (mb.modtype & CGW_MOD_FLAGS)
-				mod->modfunc[modidx++] = mod_or_flags;
+				mod->modop[modidx++] = CGW_MODOP_OR_FLAGS;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_or_fddata;
+				mod->modop[modidx++] = CGW_MODOP_OR_FDDATA;
 		}
 
 		if (tb[CGW_FDMOD_XOR]) {
@@ -869,16 +1008,16 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.xor = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_xor_id;
+				mod->modop[modidx++] = CGW_MODOP_XOR_ID;
 
 			if (mb.modtype & CGW_MOD_LEN)
-				mod->modfunc[modidx++] = mod_xor_len;
+				mod->modop[modidx++] = CGW_MODOP_XOR_LEN;
 
 			if (mb.modtype & CGW_MOD_FLAGS)
-				mod->modfunc[modidx++] = mod_xor_flags;
+				mod->modop[modidx++] = CGW_MODOP_XOR_FLAGS;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_xor_fddata;
+				mod->modop[modidx++] = CGW_MODOP_XOR_FDDATA;
 		}
 
 		if (tb[CGW_FDMOD_SET]) {
@@ -888,16 +1027,16 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.set = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_set_id;
+				mod->modop[modidx++] = CGW_MODOP_SET_ID;
 
 			if (mb.modtype & CGW_MOD_LEN)
-				mod->modfunc[modidx++] = mod_set_len;
+				mod->modop[modidx++] = CGW_MODOP_SET_LEN;
 
 			if (mb.modtype & CGW_MOD_FLAGS)
-				mod->modfunc[modidx++] = mod_set_flags;
+				mod->modop[modidx++] = CGW_MODOP_SET_FLAGS;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_set_fddata;
+				mod->modop[modidx++] = CGW_MODOP_SET_FDDATA;
 		}
 	} else {
 		struct cgw_frame_mod mb;
@@ -909,13 +1048,13 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.and = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_and_id;
+				mod->modop[modidx++] = CGW_MODOP_AND_ID;
 
 			if (mb.modtype & CGW_MOD_DLC)
-				mod->modfunc[modidx++] = mod_and_ccdlc;
+				mod->modop[modidx++] = CGW_MODOP_AND_CCDLC;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_and_data;
+				mod->modop[modidx++] = CGW_MODOP_AND_DATA;
 		}
 
 		if (tb[CGW_MOD_OR]) {
@@ -925,13 +1064,13 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.or = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_or_id;
+				mod->modop[modidx++] = CGW_MODOP_OR_ID;
 
 			if (mb.modtype & CGW_MOD_DLC)
-				mod->modfunc[modidx++] = mod_or_ccdlc;
+				mod->modop[modidx++] = CGW_MODOP_OR_CCDLC;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_or_data;
+				mod->modop[modidx++] = CGW_MODOP_OR_DATA;
 		}
 
 		if (tb[CGW_MOD_XOR]) {
@@ -941,13 +1080,13 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.xor = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_xor_id;
+				mod->modop[modidx++] = CGW_MODOP_XOR_ID;
 
 			if (mb.modtype & CGW_MOD_DLC)
-				mod->modfunc[modidx++] = mod_xor_ccdlc;
+				mod->modop[modidx++] = CGW_MODOP_XOR_CCDLC;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_xor_data;
+				mod->modop[modidx++] = CGW_MODOP_XOR_DATA;
 		}
 
 		if (tb[CGW_MOD_SET]) {
@@ -957,16 +1096,18 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			mod->modtype.set = mb.modtype;
 
 			if (mb.modtype & CGW_MOD_ID)
-				mod->modfunc[modidx++] = mod_set_id;
+				mod->modop[modidx++] = CGW_MODOP_SET_ID;
 
 			if (mb.modtype & CGW_MOD_DLC)
-				mod->modfunc[modidx++] = mod_set_ccdlc;
+				mod->modop[modidx++] = CGW_MODOP_SET_CCDLC;
 
 			if (mb.modtype & CGW_MOD_DATA)
-				mod->modfunc[modidx++] = mod_set_data;
+				mod->modop[modidx++] = CGW_MODOP_SET_DATA;
 		}
 	}
 
+	mod->modops = modidx;
+
 	/* check for checksum operations after CAN frame modifications */
 	if (modidx) {
 		if (tb[CGW_CS_CRC8]) {
@@ -985,11 +1126,11 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			 */
 			if (c->from_idx < 0 || c->to_idx < 0 ||
 			    c->result_idx < 0)
-				mod->csumfunc.crc8 = cgw_csum_crc8_rel;
+				mod->csumop.crc8 = CGW_CSOP_REL;
 			else if (c->from_idx <= c->to_idx)
-				mod->csumfunc.crc8 = cgw_csum_crc8_pos;
+				mod->csumop.crc8 = CGW_CSOP_POS;
 			else
-				mod->csumfunc.crc8 = cgw_csum_crc8_neg;
+				mod->csumop.crc8 = CGW_CSOP_NEG;
 		}
 
 		if (tb[CGW_CS_XOR]) {
@@ -1008,11 +1149,11 @@ static int cgw_parse_attr(struct nlmsghdr *nlh, struct cf_mod *mod,
 			 */
 			if (c->from_idx < 0 || c->to_idx < 0 ||
 			    c->result_idx < 0)
-				mod->csumfunc.xor = cgw_csum_xor_rel;
+				mod->csumop.xor = CGW_CSOP_REL;
 			else if (c->from_idx <= c->to_idx)
-				mod->csumfunc.xor = cgw_csum_xor_pos;
+				mod->csumop.xor = CGW_CSOP_POS;
 			else
-				mod->csumfunc.xor = cgw_csum_xor_neg;
+				mod->csumop.xor = CGW_CSOP_NEG;
 		}
 
 		if (tb[CGW_MOD_UID])
@@ -157,6 +157,14 @@ static void raw_rcv(struct sk_buff *oskb, void *data)
 			return;
 	}
 
+	/* a full receive queue would drop the clone anyway, and a logging
+	 * socket that falls behind sees this for every following frame
+	 */
+	if (atomic_read(&sk->sk_rmem_alloc) >= READ_ONCE(sk->sk_rcvbuf)) {
+		atomic_inc(&sk->sk_drops);
+		return;
+	}
+
 	/* clone the given skb to be able to enqueue it into the rcv queue */
 	skb = skb_clone(oskb, GFP_ATOMIC);
 	if (!skb)
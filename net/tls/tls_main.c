@@ -189,6 +189,11 @@ int tls_push_sg(struct sock *sk,
 		/* is sending application-limited? */
 		tcp_rate_check_app_limited(sk);
 		p = sg_page(sg);
+		/* Only the last fragment of the record may push the queue */
+		if (sg_is_last(sg))
+			msg.msg_flags = MSG_SPLICE_PAGES | flags;
+		else
+			msg.msg_flags = MSG_SPLICE_PAGES | MSG_MORE | flags;
 retry:
 		bvec_set_page(&bvec, p, size, offset);
 		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, &bvec, 1, size);
@@ -1002,6 +1002,19 @@ static int tls_sw_sendmsg_splice(struct sock *sk, struct msghdr *msg,
 	return 0;
 }
 
+/*
+ * A full record with more of the same sendmsg() still to come is queued to
+ * TCP with MSG_MORE, so that a multi-record write goes out as one push of
+ * back to back records instead of one push per 16K record.
+ */
+static int tls_sw_record_flags(struct msghdr *msg, bool full_record)
+{
+	if (full_record && msg_data_left(msg))
+		return msg->msg_flags | MSG_MORE;
+
+	return msg->msg_flags;
+}
+
 static int tls_sw_sendmsg_locked(struct sock *sk, struct msghdr *msg,
 				 size_t size)
 {
@@ -1114,7 +1127,8 @@ static int tls_sw_sendmsg_locked(struct sock *sk, struct msghdr *msg,
 			sk_msg_sg_copy_set(msg_pl, first);
 			ret = bpf_exec_tx_verdict(msg_pl, sk, full_record,
 						  record_type, &copied,
-						  msg->msg_flags);
+						  tls_sw_record_flags(msg,
+								      full_record));
 			if (ret) {
 				if (ret == -EINPROGRESS)
 					num_async++;
@@ -1168,7 +1182,8 @@ static int tls_sw_sendmsg_locked(struct sock *sk, struct msghdr *msg,
 		if (full_record || eor) {
 			ret = bpf_exec_tx_verdict(msg_pl, sk, full_record,
 						  record_type, &copied,
-						  msg->msg_flags);
+						  tls_sw_record_flags(msg,
+								      full_record));
 			if (ret) {
 				if (ret == -EINPROGRESS)
 					num_async++;
@@ -928,7 +928,15 @@ static __poll_t xsk_poll(struct file *file, struct socket *sock,
 
 	pool = xs->pool;
 
-	if (pool->cached_need_wakeup) {
+	if (xs->zc && xsk_no_wakeup(sk)) {
+		/*
+		 * Preferred busy-polling: drive the NAPI context from here, as
+		 * sendmsg()/recvmsg() do, instead of kicking the driver into
+		 * rescheduling it from an interrupt.
+		 */
+		if (sk_can_busy_loop(sk))
+			sk_busy_loop(sk, 1);
+	} else if (pool->cached_need_wakeup) {
 		if (xs->zc)
 			xsk_wakeup(xs, pool->cached_need_wakeup);
 		else if (xs->tx)
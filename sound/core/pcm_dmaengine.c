@@ -12,6 +12,7 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/dmaengine.h>
+#include <linux/hrtimer.h>
 #include <linux/slab.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -24,6 +25,13 @@ struct dmaengine_pcm_runtime_data {
 	dma_cookie_t cookie;
 
 	unsigned int pos;
+
+	/* period wakeups from a timer instead of DMA interrupts */
+	struct snd_pcm_substream *substream;
+	struct hrtimer timer;
+	ktime_t period_time;
+	bool use_timer;
+	bool timer_running;
 };
 
 static inline struct dmaengine_pcm_runtime_data *substream_to_prtd(
@@ -145,6 +153,63 @@ static void dmaengine_pcm_dma_complete(void *arg)
 	snd_pcm_period_elapsed(substream);
 }
 
+static enum hrtimer_restart dmaengine_pcm_timer_callback(struct hrtimer *timer)
+{
+	struct dmaengine_pcm_runtime_data *prtd =
+		container_of(timer, struct dmaengine_pcm_runtime_data, timer);
+
+	if (!READ_ONCE(prtd->timer_running))
+		return HRTIMER_NORESTART;
+
+	/* The pointer is read back from the DMA residue */
+	snd_pcm_period_elapsed(prtd->substream);
+
+	/*
+	 * A STOP that raced with us, or one issued by
+	 * snd_pcm_period_elapsed() itself, could not cancel the running
+	 * callback, so don't re-arm behind its back.
+	 */
+	if (!READ_ONCE(prtd->timer_running))
+		return HRTIMER_NORESTART;
+
+	hrtimer_forward_now(timer, prtd->period_time);
+
+	return HRTIMER_RESTART;
+}
+
+static bool dmaengine_pcm_timer_wakeup(struct snd_pcm_substream *substream)
+{
+	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
+
+	return prtd->use_timer && !substream->runtime->no_period_wakeup;
+}
+
+static void dmaengine_pcm_timer_start(struct snd_pcm_substream *substream)
+{
+	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+
+	if (!dmaengine_pcm_timer_wakeup(substream))
+		return;
+
+	prtd->period_time = ns_to_ktime(div_u64((u64)runtime->period_size *
+						NSEC_PER_SEC, runtime->rate));
+	WRITE_ONCE(prtd->timer_running, true);
+	hrtimer_start(&prtd->timer, prtd->period_time, HRTIMER_MODE_REL_SOFT);
+}
+
+/* Called with the stream lock held, the callback may be waiting for it */
+static void dmaengine_pcm_timer_stop(struct snd_pcm_substream *substream)
+{
+	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
+
+	if (!prtd->use_timer)
+		return;
+
+	WRITE_ONCE(prtd->timer_running, false);
+	hrtimer_try_to_cancel(&prtd->timer);
+}
+
 static int dmaengine_pcm_prepare_and_submit(struct snd_pcm_substream *substream)
 {
 	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
@@ -155,7 +220,8 @@ static int dmaengine_pcm_prepare_and_submit(struct snd_pcm_substream *substream)
 
 	direction = snd_pcm_substream_to_dma_direction(substream);
 
-	if (!substream->runtime->no_period_wakeup)
+	if (!substream->runtime->no_period_wakeup &&
+	    !dmaengine_pcm_timer_wakeup(substream))
 		flags |= DMA_PREP_INTERRUPT;
 
 	prtd->pos = 0;
@@ -196,21 +262,26 @@ int snd_dmaengine_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		if (ret)
 			return ret;
 		dma_async_issue_pending(prtd->dma_chan);
+		dmaengine_pcm_timer_start(substream);
 		break;
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 		dmaengine_resume(prtd->dma_chan);
+		dmaengine_pcm_timer_start(substream);
 		break;
 	case SNDRV_PCM_TRIGGER_SUSPEND:
+		dmaengine_pcm_timer_stop(substream);
 		if (runtime->info & SNDRV_PCM_INFO_PAUSE)
 			dmaengine_pause(prtd->dma_chan);
 		else
 			dmaengine_terminate_async(prtd->dma_chan);
 		break;
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		dmaengine_pcm_timer_stop(substream);
 		dmaengine_pause(prtd->dma_chan);
 		break;
 	case SNDRV_PCM_TRIGGER_STOP:
+		dmaengine_pcm_timer_stop(substream);
 		dmaengine_terminate_async(prtd->dma_chan);
 		break;
 	default:
@@ -321,6 +392,9 @@ int snd_dmaengine_pcm_open(struct snd_pcm_substream *substream,
 		return -ENOMEM;
 
 	prtd->dma_chan = chan;
+	prtd->substream = substream;
+	hrtimer_init(&prtd->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	prtd->timer.function = dmaengine_pcm_timer_callback;
 
 	substream->runtime->private_data = prtd;
 
@@ -328,6 +402,24 @@ int snd_dmaengine_pcm_open(struct snd_pcm_substream *substream,
 }
 EXPORT_SYMBOL_GPL(snd_dmaengine_pcm_open);
 
+/**
+ * snd_dmaengine_pcm_enable_timer_wakeup - Drive period wakeups from a timer
+ * @substream: PCM substream
+ *
+ * Submit the cyclic DMA transfer without per period interrupts and call
+ * snd_pcm_period_elapsed() from a hrtimer running at the period rate instead.
+ * Only use this if the DMA channel reports an accurate residue, since the PCM
+ * pointer is then solely based on it. Must be called after
+ * snd_dmaengine_pcm_open().
+ */
+void snd_dmaengine_pcm_enable_timer_wakeup(struct snd_pcm_substream *substream)
+{
+	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
+
+	prtd->use_timer = true;
+}
+EXPORT_SYMBOL_GPL(snd_dmaengine_pcm_enable_timer_wakeup);
+
 /**
  * snd_dmaengine_pcm_open_request_chan - Open a dmaengine based PCM substream and request channel
  * @substream: PCM substream
@@ -359,6 +451,7 @@ int snd_dmaengine_pcm_close(struct snd_pcm_substream *substream)
 {
 	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
 
+	hrtimer_cancel(&prtd->timer);
 	dmaengine_synchronize(prtd->dma_chan);
 	kfree(prtd);
 
@@ -379,6 +472,7 @@ int snd_dmaengine_pcm_close_release_chan(struct snd_pcm_substream *substream)
 {
 	struct dmaengine_pcm_runtime_data *prtd = substream_to_prtd(substream);
 
+	hrtimer_cancel(&prtd->timer);
 	dmaengine_synchronize(prtd->dma_chan);
 	dma_release_channel(prtd->dma_chan);
 	kfree(prtd);
@@ -421,6 +515,9 @@ int snd_dmaengine_pcm_refine_runtime_hwparams(
 			hw->info |= SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME;
 		if (dma_caps.residue_granularity <= DMA_RESIDUE_GRANULARITY_SEGMENT)
 			hw->info |= SNDRV_PCM_INFO_BATCH;
+		/* The pointer is exact without period interrupts */
+		if (dma_caps.residue_granularity == DMA_RESIDUE_GRANULARITY_BURST)
+			hw->info |= SNDRV_PCM_INFO_NO_PERIOD_WAKEUP;
 
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 			addr_widths = dma_caps.dst_addr_widths;
@@ -2300,8 +2300,6 @@ snd_pcm_sframes_t __snd_pcm_lib_xfer(struct snd_pcm_substream *substream,
 		appl_ptr = READ_ONCE(runtime->control->appl_ptr);
 		appl_ofs = appl_ptr % runtime->buffer_size;
 		cont = runtime->buffer_size - appl_ofs;
-		if (frames > cont)
-			frames = cont;
 		if (snd_BUG_ON(!frames)) {
 			err = -EINVAL;
 			goto _end_unlock;
@@ -2313,8 +2311,17 @@ snd_pcm_sframes_t __snd_pcm_lib_xfer(struct snd_pcm_substream *substream,
 		snd_pcm_stream_unlock_irq(substream);
 		if (!is_playback)
 			snd_pcm_dma_buffer_sync(substream, SNDRV_DMA_SYNC_CPU);
-		err = writer(substream, appl_ofs, data, offset, frames,
-			     transfer, in_kernel);
+		/*
+		 * Copy across the end of the buffer in the same round, so
+		 * that the lock, buffer sync and appl_ptr update are only
+		 * paid once per wrap around.  frames <= avail guarantees
+		 * the second part fits.
+		 */
+		err = writer(substream, appl_ofs, data, offset,
+			     min(frames, cont), transfer, in_kernel);
+		if (!err && frames > cont)
+			err = writer(substream, 0, data, offset + cont,
+				     frames - cont, transfer, in_kernel);
 		if (is_playback)
 			snd_pcm_dma_buffer_sync(substream, SNDRV_DMA_SYNC_DEVICE);
 		snd_pcm_stream_lock_irq(substream);
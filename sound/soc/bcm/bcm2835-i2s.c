@@ -107,12 +107,17 @@
 /* Frame length register is 10 bit, maximum length 1024 */
 #define BCM2835_I2S_MAX_FRAME_LENGTH	1024
 
+/* Channels are at most 32 bit wide, so two 16 bit slots fit in one */
+#define BCM2835_I2S_MAX_CHANNEL_WIDTH	32
+#define BCM2835_I2S_PAIRED_CHANNELS	4
+
 /* General device struct */
 struct bcm2835_i2s_dev {
 	struct device				*dev;
 	struct snd_dmaengine_dai_dma_data	dma_data[2];
 	unsigned int				fmt;
 	unsigned int				tdm_slots;
+	unsigned int				channels;
 	unsigned int				rx_mask;
 	unsigned int				tx_mask;
 	unsigned int				slot_width;
@@ -230,6 +235,7 @@ static int bcm2835_i2s_set_dai_bclk_ratio(struct snd_soc_dai *dai,
 
 	if (!ratio) {
 		dev->tdm_slots = 0;
+		dev->channels = 2;
 		return 0;
 	}
 
@@ -237,6 +243,7 @@ static int bcm2835_i2s_set_dai_bclk_ratio(struct snd_soc_dai *dai,
 		return -EINVAL;
 
 	dev->tdm_slots = 2;
+	dev->channels = 2;
 	dev->rx_mask = 0x03;
 	dev->tx_mask = 0x03;
 	dev->slot_width = ratio / 2;
@@ -245,6 +252,24 @@ static int bcm2835_i2s_set_dai_bclk_ratio(struct snd_soc_dai *dai,
 	return 0;
 }
 
+/*
+ * Check that the 4 bits set in mask form two pairs of adjacent
+ * slots, e.g. 0-1 and 2-3, or 0-1 and 4-5.
+ */
+static bool bcm2835_i2s_paired_slots(unsigned int mask)
+{
+	unsigned int first = ffs(mask) - 1;
+	unsigned int second;
+
+	if (hweight_long((unsigned long) mask) != 4)
+		return false;
+
+	mask &= ~(BIT(first) | BIT(first + 1));
+	second = ffs(mask) - 1;
+
+	return mask == (BIT(second) | BIT(second + 1));
+}
+
 static int bcm2835_i2s_set_dai_tdm_slot(struct snd_soc_dai *dai,
 	unsigned int tx_mask, unsigned int rx_mask,
 	int slots, int width)
@@ -260,11 +285,26 @@ static int bcm2835_i2s_set_dai_tdm_slot(struct snd_soc_dai *dai,
 		tx_mask &= GENMASK(slots - 1, 0);
 
 		/*
-		 * The driver is limited to 2-channel setups.
-		 * Check that exactly 2 bits are set in the masks.
+		 * The hardware has 2 channels per frame. Either 2 slots
+		 * are used, or 4 slots grouped into two pairs of adjacent
+		 * slots, each pair carried by one 32 bit wide channel.
 		 */
-		if (hweight_long((unsigned long) rx_mask) != 2
-		    || hweight_long((unsigned long) tx_mask) != 2)
+		switch (hweight_long((unsigned long) tx_mask)) {
+		case 2:
+			break;
+		case BCM2835_I2S_PAIRED_CHANNELS:
+			if (2 * width > BCM2835_I2S_MAX_CHANNEL_WIDTH
+			    || !bcm2835_i2s_paired_slots(rx_mask)
+			    || !bcm2835_i2s_paired_slots(tx_mask))
+				return -EINVAL;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		/* Both directions share the channel format */
+		if (hweight_long((unsigned long) rx_mask)
+		    != hweight_long((unsigned long) tx_mask))
 			return -EINVAL;
 
 		if (slots * width > BCM2835_I2S_MAX_FRAME_LENGTH)
@@ -272,6 +312,7 @@ static int bcm2835_i2s_set_dai_tdm_slot(struct snd_soc_dai *dai,
 	}
 
 	dev->tdm_slots = slots;
+	dev->channels = slots ? hweight_long((unsigned long) tx_mask) : 2;
 
 	dev->rx_mask = rx_mask;
 	dev->tx_mask = tx_mask;
@@ -335,7 +376,8 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 	int frame_length, bclk_rate;
 	unsigned int rx_mask, tx_mask;
 	unsigned int rx_ch1_pos, rx_ch2_pos, tx_ch1_pos, tx_ch2_pos;
-	unsigned int mode, format;
+	unsigned int mode, format, channel_length;
+	bool paired;
 	bool bit_clock_provider = false;
 	bool frame_sync_provider = false;
 	bool frame_start_falling_edge = false;
@@ -382,6 +424,27 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 	if (data_length > slot_width)
 		return -EINVAL;
 
+	/*
+	 * With paired slots one channel covers two adjacent slots, so
+	 * the data has to fill its slot completely. The 32 bit FIFO word
+	 * is shifted out MSB first, so the second sample of each word in
+	 * memory goes out in the first slot of the pair.
+	 */
+	paired = dev->tdm_slots && dev->channels == BCM2835_I2S_PAIRED_CHANNELS;
+	if (paired) {
+		if (data_length != slot_width)
+			return -EINVAL;
+		channel_length = 2 * data_length;
+		/* Use the lower slot of each pair for the channel position */
+		rx_mask &= ~(BIT(ffs(rx_mask)) | BIT(fls(rx_mask) - 1));
+		tx_mask &= ~(BIT(ffs(tx_mask)) | BIT(fls(tx_mask) - 1));
+	} else {
+		channel_length = data_length;
+	}
+
+	if (params_channels(params) != dev->channels)
+		return -EINVAL;
+
 	/* Check if CPU is bit clock provider */
 	switch (dev->fmt & SND_SOC_DAIFMT_CLOCK_PROVIDER_MASK) {
 	case SND_SOC_DAIFMT_BP_FP:
@@ -429,10 +492,10 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 	/* Setup the frame format */
 	format = BCM2835_I2S_CHEN;
 
-	if (data_length >= 24)
+	if (channel_length >= 24)
 		format |= BCM2835_I2S_CHWEX;
 
-	format |= BCM2835_I2S_CHWID((data_length-8)&0xf);
+	format |= BCM2835_I2S_CHWID((channel_length-8)&0xf);
 
 	/* CH2 format is the same as for CH1 */
 	format = BCM2835_I2S_CH1(format) | BCM2835_I2S_CH2(format);
@@ -443,6 +506,10 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 		if (slots & 1)
 			return -EINVAL;
 
+		/* Paired slots need sequential slot numbering */
+		if (paired)
+			return -EINVAL;
+
 		/*
 		 * Use I2S-style logical slot numbering: even slots
 		 * are in first half of frame, odd slots in second half.
@@ -457,7 +524,7 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 		frame_start_falling_edge = true;
 		break;
 	case SND_SOC_DAIFMT_LEFT_J:
-		if (slots & 1)
+		if ((slots & 1) || paired)
 			return -EINVAL;
 
 		odd_slot_offset = slots >> 1;
@@ -466,7 +533,7 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 		frame_start_falling_edge = false;
 		break;
 	case SND_SOC_DAIFMT_RIGHT_J:
-		if (slots & 1)
+		if ((slots & 1) || paired)
 			return -EINVAL;
 
 		/* Odd frame lengths aren't supported */
@@ -523,7 +590,7 @@ static int bcm2835_i2s_hw_params(struct snd_pcm_substream *substream,
 
 	/* Setup the I2S mode */
 
-	if (data_length <= 16) {
+	if (channel_length <= 16) {
 		/*
 		 * Use frame packed mode (2 channels per 32 bit word)
 		 * We cannot set another frame length in the second stream
@@ -693,6 +760,23 @@ static int bcm2835_i2s_startup(struct snd_pcm_substream *substream,
 			       struct snd_soc_dai *dai)
 {
 	struct bcm2835_i2s_dev *dev = snd_soc_dai_get_drvdata(dai);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	int ret;
+
+	ret = snd_pcm_hw_constraint_single(runtime,
+					   SNDRV_PCM_HW_PARAM_CHANNELS,
+					   dev->channels);
+	if (ret < 0)
+		return ret;
+
+	/* Paired slots pack two 16 bit samples into one 32 bit channel */
+	if (dev->channels == BCM2835_I2S_PAIRED_CHANNELS) {
+		ret = snd_pcm_hw_constraint_mask64(runtime,
+						   SNDRV_PCM_HW_PARAM_FORMAT,
+						   SNDRV_PCM_FMTBIT_S16_LE);
+		if (ret < 0)
+			return ret;
+	}
 
 	if (snd_soc_dai_active(dai))
 		return 0;
@@ -763,7 +847,7 @@ static struct snd_soc_dai_driver bcm2835_i2s_dai = {
 	.name	= "bcm2835-i2s",
 	.playback = {
 		.channels_min = 2,
-		.channels_max = 2,
+		.channels_max = BCM2835_I2S_PAIRED_CHANNELS,
 		.rates =	SNDRV_PCM_RATE_CONTINUOUS,
 		.rate_min =	8000,
 		.rate_max =	384000,
@@ -773,7 +857,7 @@ static struct snd_soc_dai_driver bcm2835_i2s_dai = {
 		},
 	.capture = {
 		.channels_min = 2,
-		.channels_max = 2,
+		.channels_max = BCM2835_I2S_PAIRED_CHANNELS,
 		.rates =	SNDRV_PCM_RATE_CONTINUOUS,
 		.rate_min =	8000,
 		.rate_max =	384000,
@@ -836,6 +920,8 @@ static int bcm2835_i2s_probe(struct platform_device *pdev)
 	if (!dev)
 		return -ENOMEM;
 
+	dev->channels = 2;
+
 	/* get the clock */
 	dev->clk_prepared = false;
 	dev->clk = devm_clk_get(&pdev->dev, NULL);
@@ -889,7 +975,9 @@ static int bcm2835_i2s_probe(struct platform_device *pdev)
 		return ret;
 	}
 
-	ret = devm_snd_dmaengine_pcm_register(&pdev->dev, NULL, 0);
+	/* bcm2835-dma reports the residue, so no period interrupts needed */
+	ret = devm_snd_dmaengine_pcm_register(&pdev->dev, NULL,
+					      SND_DMAENGINE_PCM_FLAG_TIMER_WAKEUP);
 	if (ret) {
 		dev_err(&pdev->dev, "Could not register PCM: %d\n", ret);
 		return ret;
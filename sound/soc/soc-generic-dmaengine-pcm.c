@@ -156,7 +156,15 @@ static int dmaengine_pcm_open(struct snd_soc_component *component,
 	if (ret)
 		return ret;
 
-	return snd_dmaengine_pcm_open(substream, chan);
+	ret = snd_dmaengine_pcm_open(substream, chan);
+	if (ret)
+		return ret;
+
+	if ((pcm->flags & SND_DMAENGINE_PCM_FLAG_TIMER_WAKEUP) &&
+	    !(pcm->flags & SND_DMAENGINE_PCM_FLAG_NO_RESIDUE))
+		snd_dmaengine_pcm_enable_timer_wakeup(substream);
+
+	return 0;
 }
 
 static int dmaengine_pcm_close(struct snd_soc_component *component,
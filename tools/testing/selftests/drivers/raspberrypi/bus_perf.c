@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Throughput, latency and CPU cost of the SPI, I2C and GPIO drivers of a
+ * Raspberry Pi as seen through their character devices, so that driver
+ * changes can be compared on real boards.
+ *
+ * Each test needs a fixture and is skipped unless it is configured in the
+ * environment:
+ *
+ *   SPI_DEV=/dev/spidevB.C [SPI_HZ=n]
+ *	MOSI wired to MISO; any spidev overlay (e.g. spi0-1cs) will do.
+ *	Every transfer size is checked to loop back unchanged.
+ *   I2C_DEV=/dev/i2c-N I2C_ADDR=0xNN
+ *	Any device that acknowledges reads at I2C_ADDR.
+ *   GPIO_CHIP=/dev/gpiochipN GPIO_OUT=line [GPIO_IN=line]
+ *	GPIO_OUT is toggled; if GPIO_IN is wired to it, every edge is read
+ *	back and checked.
+ *
+ * PERF_COUNT sets the operations per measurement (default 1000).
+ *
+ * Results are KTAP, with one "# <test> key=value ..." line for each
+ * measurement. Latencies are per operation, in microseconds. cpu_us is the
+ * busy time of all CPUs, interrupts and kernel threads included, divided
+ * by the number of operations, so run on an otherwise idle system.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <linux/spi/spidev.h>
+
+#include "../../kselftest.h"
+
+#define SPI_MAX_LEN	4096	/* spidev's default bufsiz */
+#define I2C_MAX_LEN	32
+
+static unsigned int count = 1000;
+static double *lat;
+
+struct perf {
+	double start_us;
+	unsigned long long start_busy;
+};
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Busy clock ticks summed over all CPUs, from the first line of /proc/stat */
+static unsigned long long cpu_busy_ticks(void)
+{
+	unsigned long long user, nice, sys, idle, iowait, irq, softirq, steal;
+	FILE *f;
+	int n;
+
+	f = fopen("/proc/stat", "r");
+	if (!f)
+		return 0;
+
+	n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &user, &nice, &sys, &idle, &iowait, &irq, &softirq, &steal);
+	fclose(f);
+	if (n != 8)
+		return 0;
+
+	return user + nice + sys + irq + softirq + steal;
+}
+
+static void perf_start(struct perf *p)
+{
+	p->start_busy = cpu_busy_ticks();
+	p->start_us = now_us();
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double percentile(unsigned int pct)
+{
+	return lat[(count - 1) * pct / 100];
+}
+
+/* Print one measurement of count operations moving @bytes bytes each */
+static void perf_report(struct perf *p, const char *test, const char *param,
+			size_t bytes)
+{
+	double elapsed_us = now_us() - p->start_us;
+	unsigned long long busy = cpu_busy_ticks() - p->start_busy;
+	double cpu_us = busy * 1e6 / sysconf(_SC_CLK_TCK) / count;
+
+	qsort(lat, count, sizeof(*lat), cmp_double);
+
+	ksft_print_msg("%s %s ops=%u ops_per_s=%.0f MBps=%.3f p50_us=%.1f p90_us=%.1f p99_us=%.1f max_us=%.1f cpu_us=%.1f\n",
+		       test, param, count, count * 1e6 / elapsed_us,
+		       bytes * count / elapsed_us, percentile(50),
+		       percentile(90), percentile(99), lat[count - 1], cpu_us);
+}
+
+static void test_spi(void)
+{
+	static const size_t sizes[] = { 4, 64, 1024, SPI_MAX_LEN };
+	const char *dev = getenv("SPI_DEV");
+	const char *hz = getenv("SPI_HZ");
+	struct spi_ioc_transfer xfer = { 0 };
+	uint8_t tx[SPI_MAX_LEN], rx[SPI_MAX_LEN];
+	char param[32];
+	struct perf p;
+	unsigned int i, s;
+	int fd;
+
+	if (!dev) {
+		ksft_test_result_skip("spi: SPI_DEV not set\n");
+		return;
+	}
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		ksft_test_result_fail("spi: open %s: %s\n", dev, strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < SPI_MAX_LEN; i++)
+		tx[i] = rand();
+
+	xfer.tx_buf = (uintptr_t)tx;
+	xfer.rx_buf = (uintptr_t)rx;
+	xfer.speed_hz = hz ? strtoul(hz, NULL, 0) : 0;
+	xfer.bits_per_word = 8;
+
+	for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+		xfer.len = sizes[s];
+		memset(rx, 0, sizeof(rx));
+
+		perf_start(&p);
+		for (i = 0; i < count; i++) {
+			double t = now_us();
+
+			if (ioctl(fd, SPI_IOC_MESSAGE(1), &xfer) < 0) {
+				ksft_test_result_fail("spi: len %zu: %s\n",
+						      sizes[s], strerror(errno));
+				goto out;
+			}
+			lat[i] = now_us() - t;
+		}
+		snprintf(param, sizeof(param), "len=%zu", sizes[s]);
+		perf_report(&p, "spi", param, sizes[s]);
+
+		if (memcmp(tx, rx, sizes[s])) {
+			ksft_test_result_fail("spi: len %zu did not loop back\n",
+					      sizes[s]);
+			goto out;
+		}
+	}
+
+	ksft_test_result_pass("spi\n");
+out:
+	close(fd);
+}
+
+static void test_i2c(void)
+{
+	static const size_t sizes[] = { 1, I2C_MAX_LEN };
+	const char *dev = getenv("I2C_DEV");
+	const char *addr = getenv("I2C_ADDR");
+	struct i2c_rdwr_ioctl_data data;
+	struct i2c_msg msg = { 0 };
+	uint8_t buf[I2C_MAX_LEN];
+	char param[32];
+	struct perf p;
+	unsigned int i, s;
+	int fd;
+
+	if (!dev || !addr) {
+		ksft_test_result_skip("i2c: I2C_DEV or I2C_ADDR not set\n");
+		return;
+	}
+
+	fd = open(dev, O_RDWR);
+	if (fd < 0) {
+		ksft_test_result_fail("i2c: open %s: %s\n", dev, strerror(errno));
+		return;
+	}
+
+	msg.addr = strtoul(addr, NULL, 0);
+	msg.flags = I2C_M_RD;
+	msg.buf = buf;
+	data.msgs = &msg;
+	data.nmsgs = 1;
+
+	for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+		msg.len = sizes[s];
+
+		perf_start(&p);
+		for (i = 0; i < count; i++) {
+			double t = now_us();
+
+			if (ioctl(fd, I2C_RDWR, &data) < 0) {
+				ksft_test_result_fail("i2c: read %zu at 0x%02x: %s\n",
+						      sizes[s], msg.addr,
+						      strerror(errno));
+				goto out;
+			}
+			lat[i] = now_us() - t;
+		}
+		snprintf(param, sizeof(param), "read=%zu", sizes[s]);
+		perf_report(&p, "i2c", param, sizes[s]);
+	}
+
+	ksft_test_result_pass("i2c\n");
+out:
+	close(fd);
+}
+
+static int gpio_request(int chip_fd, unsigned int line, uint64_t flags)
+{
+	struct gpio_v2_line_request req = { 0 };
+
+	req.offsets[0] = line;
+	req.num_lines = 1;
+	req.config.flags = flags;
+	strcpy(req.consumer, "bus_perf");
+
+	if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+		return -1;
+
+	return req.fd;
+}
+
+static void test_gpio(void)
+{
+	const char *dev = getenv("GPIO_CHIP");
+	const char *out = getenv("GPIO_OUT");
+	const char *in = getenv("GPIO_IN");
+	struct gpio_v2_line_values val = { .mask = 1 };
+	int chip_fd, out_fd = -1, in_fd = -1;
+	struct perf p;
+	unsigned int i;
+
+	if (!dev || !out) {
+		ksft_test_result_skip("gpio: GPIO_CHIP or GPIO_OUT not set\n");
+		return;
+	}
+
+	chip_fd = open(dev, O_RDWR);
+	if (chip_fd < 0) {
+		ksft_test_result_fail("gpio: open %s: %s\n", dev, strerror(errno));
+		return;
+	}
+
+	out_fd = gpio_request(chip_fd, strtoul(out, NULL, 0),
+			      GPIO_V2_LINE_FLAG_OUTPUT);
+	if (in)
+		in_fd = gpio_request(chip_fd, strtoul(in, NULL, 0),
+				     GPIO_V2_LINE_FLAG_INPUT);
+	if (out_fd < 0 || (in && in_fd < 0)) {
+		ksft_test_result_fail("gpio: request lines: %s\n",
+				      strerror(errno));
+		goto out;
+	}
+
+	perf_start(&p);
+	for (i = 0; i < count; i++) {
+		uint64_t bit = i & 1;
+		double t = now_us();
+
+		val.bits = bit;
+		if (ioctl(out_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &val) < 0) {
+			ksft_test_result_fail("gpio: set: %s\n", strerror(errno));
+			goto out;
+		}
+
+		if (in_fd >= 0) {
+			val.bits = 0;
+			if (ioctl(in_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &val) < 0) {
+				ksft_test_result_fail("gpio: get: %s\n",
+						      strerror(errno));
+				goto out;
+			}
+			if ((val.bits & 1) != bit) {
+				ksft_test_result_fail("gpio: edge %u not read back\n",
+						      i);
+				goto out;
+			}
+		}
+		lat[i] = now_us() - t;
+	}
+	perf_report(&p, "gpio", in_fd >= 0 ? "op=set+get" : "op=set", 0);
+
+	ksft_test_result_pass("gpio\n");
+out:
+	if (in_fd >= 0)
+		close(in_fd);
+	if (out_fd >= 0)
+		close(out_fd);
+	close(chip_fd);
+}
+
+int main(void)
+{
+	const char *c = getenv("PERF_COUNT");
+
+	if (c)
+		count = strtoul(c, NULL, 0);
+	if (!count)
+		ksft_exit_fail_msg("PERF_COUNT must be at least 1\n");
+
+	lat = calloc(count, sizeof(*lat));
+	if (!lat)
+		ksft_exit_fail_msg("out of memory\n");
+
+	ksft_print_header();
+	ksft_set_plan(3);
+
+	test_spi();
+	test_i2c();
+	test_gpio();
+
+	free(lat);
+
+	ksft_finished();
+}
@@ -0,0 +1,62 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Memory-to-memory throughput of a DMA engine channel (bcm2835-dma,
+# dw-axi-dmac, ...) as measured by dmatest, plus the CPU time spent per
+# transfer. Skipped unless DMA_CHAN names a channel, e.g. dma0chan4 from
+# /sys/class/dma. DMA_SIZES lists the buffer sizes to test and PERF_COUNT
+# the transfers per size.
+#
+# Prints one "# dma key=value ..." line per size.
+
+PARAMS=/sys/module/dmatest/parameters
+SIZES=${DMA_SIZES:-"4096 65536 1048576"}
+COUNT=${PERF_COUNT:-1000}
+
+fail() {
+	echo "$*" >&2
+	echo "DMA dmatest FAIL"
+	exit 1
+}
+
+skip() {
+	echo "$*" >&2
+	echo "DMA dmatest SKIP"
+	exit 4
+}
+
+# Busy clock ticks summed over all CPUs
+cpu_busy() {
+	awk '/^cpu / { print $2 + $3 + $4 + $7 + $8 + $9; exit }' /proc/stat
+}
+
+[ -n "$DMA_CHAN" ] || skip "DMA_CHAN not set"
+[ -d /sys/class/dma/$DMA_CHAN ] || skip "no DMA channel $DMA_CHAN"
+modprobe -q dmatest
+[ -d $PARAMS ] || skip "dmatest not available"
+
+TCK=`getconf CLK_TCK`
+
+for SIZE in $SIZES; do
+	echo $COUNT > $PARAMS/iterations
+	echo $SIZE > $PARAMS/test_buf_size
+	echo 1 > $PARAMS/noverify
+	echo 1 > $PARAMS/norandom
+	echo $DMA_CHAN > $PARAMS/channel || fail "cannot use $DMA_CHAN"
+
+	BUSY=`cpu_busy`
+	echo 1 > $PARAMS/run
+	cat $PARAMS/wait > /dev/null
+	BUSY=$((`cpu_busy` - BUSY))
+
+	# "<thread>: summary N tests, F failures I iops K KB/s (E)"
+	LINE=`dmesg | grep "$DMA_CHAN-.*: summary" | tail -n 1`
+	set -- ${LINE#*summary }
+	[ $# -ge 8 ] || fail "no dmatest summary for $DMA_CHAN"
+	[ "$3" = 0 ] || fail "$3 of $1 transfers failed at size $SIZE"
+
+	echo "# dma chan=$DMA_CHAN size=$SIZE ops=$1 ops_per_s=$5 KBps=$7" \
+	     "cpu_us=$((BUSY * 1000000 / TCK / $1))"
+done
+
+echo "DMA dmatest PASS"
@@ -0,0 +1,735 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * pipeline_bench - Camera pipeline latency and throughput benchmark
+ *
+ * This test should not be included in the Kselftest run. It needs the
+ * Raspberry Pi 5 camera hardware and should be run when rp1-cfe, pisp_be
+ * and optionally a V4L2 memory to memory encoder are present.
+ *
+ * Frames are captured from a CFE video node, passed by dmabuf to the PiSP
+ * Back End input, and the Back End output0 is passed by dmabuf to the
+ * encoder. The Back End and encoder stages are optional. For repeatable
+ * numbers put the sensor into a test pattern mode, either with -t/-T or
+ * beforehand with v4l2-ctl, and set up the media links with media-ctl.
+ *
+ * The Back End needs a valid pisp_be_tiles_config for the chosen formats.
+ * It is read from the file given with -C, which can be dumped from a
+ * libcamera run, and is queued unchanged with every frame.
+ *
+ * Per stage latencies are taken from the vb2 timestamps:
+ *	capture	 sensor start of frame to dequeue from CFE
+ *	backend	 queue to the Back End to its job done timestamp
+ *	deliver	 Back End job done to dequeue from output0
+ *	encode	 queue to the encoder to dequeue of the encoded frame
+ *	total	 start of frame to the last stage dequeue
+ *
+ * Dropped frames are counted from gaps in the CFE sequence numbers and
+ * from buffers returned with V4L2_BUF_FLAG_ERROR. CPU time is reported for
+ * this process and, from /proc/stat, for the whole system.
+ *
+ * Usage:
+ *	sudo ./pipeline_bench -c /dev/videoX [-i /dev/videoY -o /dev/videoZ
+ *		-g /dev/videoW -C be_config.bin] [-e /dev/videoV]
+ *		[-w width] [-h height] [-f fourcc] [-F be_fourcc]
+ *		[-E enc_fourcc] [-b buffers] [-n frames]
+ *		[-t /dev/v4l-subdevN -T pattern]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+
+#define MAX_BUFFERS	32
+#define RING_SIZE	256
+
+struct buffer {
+	void *map;
+	size_t length;
+	int dmabuf;
+};
+
+struct queue {
+	const char *name;
+	int fd;
+	enum v4l2_buf_type type;
+	unsigned int memory;
+	unsigned int count;
+	struct buffer bufs[MAX_BUFFERS];
+};
+
+struct frame {
+	uint64_t sof;
+	uint64_t cap_dq;
+	uint64_t be_q;
+	uint64_t be_done;
+	uint64_t be_dq;
+	uint64_t enc_q;
+	uint64_t enc_dq;
+};
+
+struct stage {
+	const char *name;
+	uint64_t *samples;
+	unsigned int count;
+	unsigned int size;
+};
+
+enum {
+	STAGE_CAPTURE,
+	STAGE_BACKEND,
+	STAGE_DELIVER,
+	STAGE_ENCODE,
+	STAGE_TOTAL,
+	NUM_STAGES
+};
+
+static struct stage stages[NUM_STAGES] = {
+	[STAGE_CAPTURE] = { .name = "capture" },
+	[STAGE_BACKEND] = { .name = "backend" },
+	[STAGE_DELIVER] = { .name = "deliver" },
+	[STAGE_ENCODE] = { .name = "encode" },
+	[STAGE_TOTAL] = { .name = "total" },
+};
+
+static struct frame ring[RING_SIZE];
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint64_t tv_to_ns(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000000000ull + tv->tv_usec * 1000ull;
+}
+
+static void add_sample(unsigned int stage, uint64_t from, uint64_t to)
+{
+	struct stage *s = &stages[stage];
+
+	/*
+	 * Frames still in flight when the last one is counted can complete
+	 * an earlier stage, so more samples than frames may arrive.
+	 */
+	if (!from || to < from || s->count == s->size)
+		return;
+	s->samples[s->count++] = to - from;
+}
+
+static bool is_mplane(enum v4l2_buf_type type)
+{
+	return type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE ||
+	       type == V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+}
+
+static int open_dev(const char *path)
+{
+	int fd = open(path, O_RDWR | O_NONBLOCK);
+
+	if (fd < 0) {
+		printf("Failed to open %s: %s\n", path, strerror(errno));
+		exit(-1);
+	}
+	return fd;
+}
+
+static void xioctl(struct queue *q, unsigned long req, void *arg,
+		   const char *what)
+{
+	if (ioctl(q->fd, req, arg) < 0) {
+		printf("%s: %s failed: %s\n", q->name, what, strerror(errno));
+		exit(-1);
+	}
+}
+
+static void set_fmt(struct queue *q, unsigned int width, unsigned int height,
+		    unsigned int fourcc, struct v4l2_format *out)
+{
+	struct v4l2_format fmt;
+
+	memset(&fmt, 0, sizeof(fmt));
+	fmt.type = q->type;
+	xioctl(q, VIDIOC_G_FMT, &fmt, "G_FMT");
+
+	if (is_mplane(q->type)) {
+		fmt.fmt.pix_mp.width = width;
+		fmt.fmt.pix_mp.height = height;
+		fmt.fmt.pix_mp.pixelformat = fourcc;
+		fmt.fmt.pix_mp.num_planes = 1;
+		fmt.fmt.pix_mp.plane_fmt[0].bytesperline = 0;
+		fmt.fmt.pix_mp.plane_fmt[0].sizeimage = 0;
+	} else {
+		fmt.fmt.pix.width = width;
+		fmt.fmt.pix.height = height;
+		fmt.fmt.pix.pixelformat = fourcc;
+		fmt.fmt.pix.bytesperline = 0;
+		fmt.fmt.pix.sizeimage = 0;
+	}
+	xioctl(q, VIDIOC_S_FMT, &fmt, "S_FMT");
+
+	if (out)
+		*out = fmt;
+}
+
+static void init_queue(struct queue *q, unsigned int count)
+{
+	struct v4l2_requestbuffers rb;
+	unsigned int i;
+
+	memset(&rb, 0, sizeof(rb));
+	rb.count = count;
+	rb.type = q->type;
+	rb.memory = q->memory;
+	xioctl(q, VIDIOC_REQBUFS, &rb, "REQBUFS");
+	if (rb.count > MAX_BUFFERS) {
+		printf("%s: too many buffers (%u)\n", q->name, rb.count);
+		exit(-1);
+	}
+	q->count = rb.count;
+
+	for (i = 0; i < q->count; i++) {
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+		struct v4l2_exportbuffer eb;
+		struct v4l2_buffer buf;
+		unsigned int offset;
+
+		q->bufs[i].dmabuf = -1;
+		if (q->memory != V4L2_MEMORY_MMAP)
+			continue;
+
+		memset(&buf, 0, sizeof(buf));
+		memset(planes, 0, sizeof(planes));
+		buf.type = q->type;
+		buf.memory = q->memory;
+		buf.index = i;
+		if (is_mplane(q->type)) {
+			buf.m.planes = planes;
+			buf.length = VIDEO_MAX_PLANES;
+		}
+		xioctl(q, VIDIOC_QUERYBUF, &buf, "QUERYBUF");
+
+		if (is_mplane(q->type)) {
+			q->bufs[i].length = planes[0].length;
+			offset = planes[0].m.mem_offset;
+		} else {
+			q->bufs[i].length = buf.length;
+			offset = buf.m.offset;
+		}
+
+		q->bufs[i].map = mmap(NULL, q->bufs[i].length,
+				      PROT_READ | PROT_WRITE, MAP_SHARED,
+				      q->fd, offset);
+		if (q->bufs[i].map == MAP_FAILED) {
+			printf("%s: mmap failed: %s\n", q->name,
+			       strerror(errno));
+			exit(-1);
+		}
+
+		memset(&eb, 0, sizeof(eb));
+		eb.type = q->type;
+		eb.index = i;
+		eb.flags = O_CLOEXEC;
+		/* Meta queues don't need to be shared, so don't insist */
+		if (!ioctl(q->fd, VIDIOC_EXPBUF, &eb))
+			q->bufs[i].dmabuf = eb.fd;
+	}
+}
+
+/* Queue buffer index, importing dmabuf if the queue is a DMABUF one */
+static void queue_buf(struct queue *q, unsigned int index, int dmabuf,
+		      size_t length, size_t bytesused, uint64_t id)
+{
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	struct v4l2_buffer buf;
+
+	memset(&buf, 0, sizeof(buf));
+	memset(planes, 0, sizeof(planes));
+	buf.type = q->type;
+	buf.memory = q->memory;
+	buf.index = index;
+	/* Carried through memory to memory devices that copy timestamps */
+	buf.timestamp.tv_sec = id / 1000000;
+	buf.timestamp.tv_usec = id % 1000000;
+
+	if (is_mplane(q->type)) {
+		buf.m.planes = planes;
+		buf.length = 1;
+		planes[0].bytesused = bytesused;
+		if (q->memory == V4L2_MEMORY_DMABUF) {
+			planes[0].m.fd = dmabuf;
+			planes[0].length = length;
+		}
+	} else {
+		buf.bytesused = bytesused;
+		if (q->memory == V4L2_MEMORY_DMABUF) {
+			buf.m.fd = dmabuf;
+			buf.length = length;
+		}
+	}
+	xioctl(q, VIDIOC_QBUF, &buf, "QBUF");
+}
+
+/* Returns the index dequeued, or -1 if nothing is ready */
+static int dequeue_buf(struct queue *q, struct v4l2_buffer *buf,
+		       size_t *bytesused)
+{
+	struct v4l2_plane planes[VIDEO_MAX_PLANES];
+
+	memset(buf, 0, sizeof(*buf));
+	memset(planes, 0, sizeof(planes));
+	buf->type = q->type;
+	buf->memory = q->memory;
+	if (is_mplane(q->type)) {
+		buf->m.planes = planes;
+		buf->length = VIDEO_MAX_PLANES;
+	}
+
+	if (ioctl(q->fd, VIDIOC_DQBUF, buf) < 0) {
+		if (errno == EAGAIN)
+			return -1;
+		printf("%s: DQBUF failed: %s\n", q->name, strerror(errno));
+		exit(-1);
+	}
+
+	if (bytesused)
+		*bytesused = is_mplane(q->type) ? planes[0].bytesused :
+						  buf->bytesused;
+	buf->m.planes = NULL;
+	return buf->index;
+}
+
+static void stream(struct queue *q, bool on)
+{
+	int type = q->type;
+
+	if (q->fd < 0)
+		return;
+	xioctl(q, on ? VIDIOC_STREAMON : VIDIOC_STREAMOFF, &type,
+	       on ? "STREAMON" : "STREAMOFF");
+}
+
+static uint64_t system_busy_ticks(uint64_t *total)
+{
+	unsigned long long v[8];
+	FILE *f = fopen("/proc/stat", "r");
+
+	memset(v, 0, sizeof(v));
+	if (!f || fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+			 &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6],
+			 &v[7]) != 8) {
+		if (f)
+			fclose(f);
+		*total = 0;
+		return 0;
+	}
+	fclose(f);
+
+	*total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+	/* Everything but idle and iowait */
+	return *total - v[3] - v[4];
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void report_stage(struct stage *s)
+{
+	uint64_t sum = 0;
+	unsigned int i;
+
+	if (!s->count)
+		return;
+
+	qsort(s->samples, s->count, sizeof(*s->samples), cmp_u64);
+	for (i = 0; i < s->count; i++)
+		sum += s->samples[i];
+
+	printf("%-8s frames %6u  min %8.3f  avg %8.3f  p99 %8.3f  max %8.3f ms\n",
+	       s->name, s->count, s->samples[0] / 1e6,
+	       (double)sum / s->count / 1e6,
+	       s->samples[(s->count - 1) * 99 / 100] / 1e6,
+	       s->samples[s->count - 1] / 1e6);
+}
+
+static unsigned int fourcc_arg(const char *s)
+{
+	if (strlen(s) != 4) {
+		printf("Bad fourcc %s\n", s);
+		exit(-1);
+	}
+	return v4l2_fourcc(s[0], s[1], s[2], s[3]);
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s -c </dev/videoX> [-i </dev/videoY> -o </dev/videoZ>\n"
+	       "\t-g </dev/videoW> -C <be_config>] [-e </dev/videoV>]\n"
+	       "\t[-w width] [-h height] [-f fourcc] [-F be_fourcc]\n"
+	       "\t[-E enc_fourcc] [-b buffers] [-n frames]\n"
+	       "\t[-t </dev/v4l-subdevN> -T pattern]\n", prog);
+	exit(-1);
+}
+
+int main(int argc, char **argv)
+{
+	struct queue cap = { .name = "cfe", .fd = -1,
+			     .type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+			     .memory = V4L2_MEMORY_MMAP };
+	struct queue be_in = { .name = "be-input", .fd = -1,
+			       .type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE,
+			       .memory = V4L2_MEMORY_DMABUF };
+	struct queue be_out = { .name = "be-output0", .fd = -1,
+				.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE,
+				.memory = V4L2_MEMORY_MMAP };
+	struct queue be_cfg = { .name = "be-config", .fd = -1,
+				.type = V4L2_BUF_TYPE_META_OUTPUT,
+				.memory = V4L2_MEMORY_MMAP };
+	struct queue enc_in = { .name = "enc-output", .fd = -1,
+				.memory = V4L2_MEMORY_DMABUF };
+	struct queue enc_out = { .name = "enc-capture", .fd = -1,
+				 .memory = V4L2_MEMORY_MMAP };
+	const char *cap_dev = NULL, *be_in_dev = NULL, *be_out_dev = NULL;
+	const char *be_cfg_dev = NULL, *enc_dev = NULL, *cfg_file = NULL;
+	const char *tp_dev = NULL;
+	unsigned int width = 1920, height = 1080, nbufs = 4, nframes = 300;
+	unsigned int fourcc = V4L2_PIX_FMT_SRGGB10P;
+	unsigned int be_fourcc = V4L2_PIX_FMT_YUV420;
+	unsigned int enc_fourcc = V4L2_PIX_FMT_H264;
+	unsigned int be_fifo[MAX_BUFFERS], be_fifo_head = 0, be_fifo_tail = 0;
+	unsigned int done = 0, dropped = 0, errors = 0;
+	int tp_pattern = -1;
+	int64_t last_seq = -1;
+	uint64_t frame_id = 0, start, elapsed;
+	uint64_t busy0, total0, busy1, total1;
+	struct v4l2_format cap_fmt, be_fmt, meta_fmt;
+	struct rusage ru;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "c:i:o:g:C:e:w:h:f:F:E:b:n:t:T:")) != -1) {
+		switch (opt) {
+		case 'c':
+			cap_dev = optarg;
+			break;
+		case 'i':
+			be_in_dev = optarg;
+			break;
+		case 'o':
+			be_out_dev = optarg;
+			break;
+		case 'g':
+			be_cfg_dev = optarg;
+			break;
+		case 'C':
+			cfg_file = optarg;
+			break;
+		case 'e':
+			enc_dev = optarg;
+			break;
+		case 'w':
+			width = atoi(optarg);
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		case 'f':
+			fourcc = fourcc_arg(optarg);
+			break;
+		case 'F':
+			be_fourcc = fourcc_arg(optarg);
+			break;
+		case 'E':
+			enc_fourcc = fourcc_arg(optarg);
+			break;
+		case 'b':
+			nbufs = atoi(optarg);
+			break;
+		case 'n':
+			nframes = atoi(optarg);
+			break;
+		case 't':
+			tp_dev = optarg;
+			break;
+		case 'T':
+			tp_pattern = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!cap_dev || !nframes || !nbufs || nbufs > MAX_BUFFERS ||
+	    (be_in_dev && (!be_out_dev || !be_cfg_dev || !cfg_file)))
+		usage(argv[0]);
+
+	for (i = 0; i < NUM_STAGES; i++) {
+		stages[i].samples = calloc(nframes, sizeof(uint64_t));
+		if (!stages[i].samples) {
+			printf("Out of memory\n");
+			exit(-1);
+		}
+		stages[i].size = nframes;
+	}
+
+	if (tp_dev && tp_pattern >= 0) {
+		struct v4l2_control ctrl = {
+			.id = V4L2_CID_TEST_PATTERN,
+			.value = tp_pattern,
+		};
+		struct queue tp = { .name = "sensor", .fd = open_dev(tp_dev) };
+
+		xioctl(&tp, VIDIOC_S_CTRL, &ctrl, "S_CTRL(TEST_PATTERN)");
+		close(tp.fd);
+	}
+
+	/* CFE capture */
+	cap.fd = open_dev(cap_dev);
+	set_fmt(&cap, width, height, fourcc, &cap_fmt);
+	init_queue(&cap, nbufs);
+
+	/* Back End: input imports the CFE buffers, output0 is exported */
+	if (be_in_dev) {
+		unsigned char *cfg;
+		size_t cfg_len;
+		FILE *f;
+
+		be_in.fd = open_dev(be_in_dev);
+		be_out.fd = open_dev(be_out_dev);
+		be_cfg.fd = open_dev(be_cfg_dev);
+
+		set_fmt(&be_in, cap_fmt.fmt.pix.width, cap_fmt.fmt.pix.height,
+			cap_fmt.fmt.pix.pixelformat, NULL);
+		set_fmt(&be_out, width, height, be_fourcc, &be_fmt);
+		init_queue(&be_in, cap.count);
+		init_queue(&be_out, nbufs);
+
+		memset(&meta_fmt, 0, sizeof(meta_fmt));
+		meta_fmt.type = be_cfg.type;
+		xioctl(&be_cfg, VIDIOC_G_FMT, &meta_fmt, "G_FMT");
+		init_queue(&be_cfg, cap.count);
+
+		cfg = malloc(meta_fmt.fmt.meta.buffersize);
+		f = fopen(cfg_file, "rb");
+		if (!cfg || !f) {
+			printf("Cannot read %s\n", cfg_file);
+			exit(-1);
+		}
+		cfg_len = fread(cfg, 1, meta_fmt.fmt.meta.buffersize, f);
+		fclose(f);
+		for (i = 0; i < be_cfg.count; i++)
+			memcpy(be_cfg.bufs[i].map, cfg, cfg_len);
+		free(cfg);
+		meta_fmt.fmt.meta.buffersize = cfg_len;
+	}
+
+	/* Encoder: output queue imports whatever the previous stage made */
+	if (enc_dev) {
+		struct v4l2_capability caps;
+		const struct queue *src = be_in_dev ? &be_out : &cap;
+		const struct v4l2_format *sfmt = be_in_dev ? &be_fmt : &cap_fmt;
+		unsigned int w, h, pf;
+
+		enc_in.fd = enc_out.fd = open_dev(enc_dev);
+		xioctl(&enc_in, VIDIOC_QUERYCAP, &caps, "QUERYCAP");
+		if (caps.device_caps & V4L2_CAP_VIDEO_M2M_MPLANE) {
+			enc_in.type = V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE;
+			enc_out.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+		} else {
+			enc_in.type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
+			enc_out.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		}
+
+		if (is_mplane(sfmt->type)) {
+			w = sfmt->fmt.pix_mp.width;
+			h = sfmt->fmt.pix_mp.height;
+			pf = sfmt->fmt.pix_mp.pixelformat;
+		} else {
+			w = sfmt->fmt.pix.width;
+			h = sfmt->fmt.pix.height;
+			pf = sfmt->fmt.pix.pixelformat;
+		}
+		set_fmt(&enc_in, w, h, pf, NULL);
+		set_fmt(&enc_out, w, h, enc_fourcc, NULL);
+		init_queue(&enc_in, src->count);
+		init_queue(&enc_out, nbufs);
+	}
+
+	/* Prime the queues that the pipeline starts from */
+	for (i = 0; i < cap.count; i++)
+		queue_buf(&cap, i, -1, 0, 0, 0);
+	for (i = 0; i < be_out.count && be_out.fd >= 0; i++)
+		queue_buf(&be_out, i, -1, 0, 0, 0);
+	for (i = 0; i < enc_out.count && enc_out.fd >= 0; i++)
+		queue_buf(&enc_out, i, -1, 0, 0, 0);
+
+	busy0 = system_busy_ticks(&total0);
+	start = now_ns();
+
+	stream(&enc_out, true);
+	stream(&enc_in, true);
+	stream(&be_out, true);
+	stream(&be_cfg, true);
+	stream(&be_in, true);
+	stream(&cap, true);
+
+	while (done < nframes) {
+		struct pollfd fds[4];
+		struct v4l2_buffer buf;
+		unsigned int nfds = 0;
+		size_t used;
+		int idx;
+
+		fds[nfds++] = (struct pollfd){ .fd = cap.fd, .events = POLLIN };
+		if (be_in.fd >= 0) {
+			fds[nfds++] = (struct pollfd){ .fd = be_in.fd, .events = POLLOUT };
+			fds[nfds++] = (struct pollfd){ .fd = be_out.fd, .events = POLLIN };
+		}
+		if (enc_in.fd >= 0)
+			fds[nfds++] = (struct pollfd){ .fd = enc_in.fd,
+						       .events = POLLIN | POLLOUT };
+
+		if (poll(fds, nfds, 2000) <= 0) {
+			printf("Timeout waiting for frames\n");
+			break;
+		}
+
+		/* CFE -> Back End, encoder or straight back */
+		while ((idx = dequeue_buf(&cap, &buf, &used)) >= 0) {
+			struct frame *fr;
+			uint64_t t = now_ns();
+
+			if (last_seq >= 0 && buf.sequence > last_seq + 1)
+				dropped += buf.sequence - last_seq - 1;
+			last_seq = buf.sequence;
+			if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+				errors++;
+				queue_buf(&cap, idx, -1, 0, 0, 0);
+				continue;
+			}
+
+			fr = &ring[frame_id % RING_SIZE];
+			memset(fr, 0, sizeof(*fr));
+			fr->sof = tv_to_ns(&buf.timestamp);
+			fr->cap_dq = t;
+			add_sample(STAGE_CAPTURE, fr->sof, t);
+
+			if (be_in.fd >= 0) {
+				fr->be_q = now_ns();
+				be_fifo[be_fifo_tail++ % MAX_BUFFERS] = frame_id;
+				queue_buf(&be_cfg, idx, -1, 0,
+					  meta_fmt.fmt.meta.buffersize, 0);
+				queue_buf(&be_in, idx, cap.bufs[idx].dmabuf,
+					  cap.bufs[idx].length, used, frame_id);
+			} else if (enc_in.fd >= 0) {
+				fr->enc_q = now_ns();
+				queue_buf(&enc_in, idx, cap.bufs[idx].dmabuf,
+					  cap.bufs[idx].length, used, frame_id);
+			} else {
+				add_sample(STAGE_TOTAL, fr->sof, t);
+				queue_buf(&cap, idx, -1, 0, 0, 0);
+				done++;
+			}
+			frame_id++;
+		}
+
+		if (be_in.fd >= 0) {
+			/* Inputs and configs are done with once the job is */
+			while ((idx = dequeue_buf(&be_in, &buf, NULL)) >= 0)
+				queue_buf(&cap, idx, -1, 0, 0, 0);
+			while (dequeue_buf(&be_cfg, &buf, NULL) >= 0)
+				;
+
+			while ((idx = dequeue_buf(&be_out, &buf, &used)) >= 0) {
+				uint64_t id = be_fifo[be_fifo_head++ % MAX_BUFFERS];
+				struct frame *fr = &ring[id % RING_SIZE];
+				uint64_t t = now_ns();
+
+				fr->be_done = tv_to_ns(&buf.timestamp);
+				fr->be_dq = t;
+				add_sample(STAGE_BACKEND, fr->be_q, fr->be_done);
+				add_sample(STAGE_DELIVER, fr->be_done, t);
+
+				if (enc_in.fd >= 0) {
+					fr->enc_q = now_ns();
+					queue_buf(&enc_in, idx,
+						  be_out.bufs[idx].dmabuf,
+						  be_out.bufs[idx].length, used,
+						  id);
+				} else {
+					add_sample(STAGE_TOTAL, fr->sof, t);
+					queue_buf(&be_out, idx, -1, 0, 0, 0);
+					done++;
+				}
+			}
+		}
+
+		if (enc_in.fd >= 0) {
+			/* Return the raw frame to the stage it came from */
+			while ((idx = dequeue_buf(&enc_in, &buf, NULL)) >= 0) {
+				if (be_in.fd >= 0)
+					queue_buf(&be_out, idx, -1, 0, 0, 0);
+				else
+					queue_buf(&cap, idx, -1, 0, 0, 0);
+			}
+
+			while ((idx = dequeue_buf(&enc_out, &buf, &used)) >= 0) {
+				uint64_t id = buf.timestamp.tv_sec * 1000000ull +
+					      buf.timestamp.tv_usec;
+				struct frame *fr = &ring[id % RING_SIZE];
+				uint64_t t = now_ns();
+
+				if (buf.flags & V4L2_BUF_FLAG_ERROR)
+					errors++;
+				fr->enc_dq = t;
+				add_sample(STAGE_ENCODE, fr->enc_q, t);
+				add_sample(STAGE_TOTAL, fr->sof, t);
+				queue_buf(&enc_out, idx, -1, 0, 0, 0);
+				done++;
+			}
+		}
+	}
+
+	elapsed = now_ns() - start;
+	busy1 = system_busy_ticks(&total1);
+	getrusage(RUSAGE_SELF, &ru);
+
+	stream(&cap, false);
+	stream(&be_in, false);
+	stream(&be_cfg, false);
+	stream(&be_out, false);
+	stream(&enc_in, false);
+	stream(&enc_out, false);
+
+	printf("%u frames in %.3f s: %.2f fps, %u dropped, %u errors\n",
+	       done, elapsed / 1e9, done * 1e9 / elapsed, dropped, errors);
+	for (i = 0; i < NUM_STAGES; i++)
+		report_stage(&stages[i]);
+	printf("cpu: process user %.3f s sys %.3f s, system busy %.1f%%\n",
+	       ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6,
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6,
+	       total1 > total0 ?
+	       100.0 * (busy1 - busy0) / (total1 - total0) : 0.0);
+
+	return done == nframes ? 0 : 1;
+}